@@ -0,0 +1,75 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+
+#include "common/Breakpoints.h"
+
+namespace Common {
+
+void Breakpoints::Add(u32 addr, Type type) {
+    points[addr] |= type;
+    page_tags[PageIndex(addr)] |= type;
+}
+
+void Breakpoints::Remove(u32 addr, Type type) {
+    const auto it = points.find(addr);
+    if (it == points.end()) {
+        return;
+    }
+
+    it->second &= ~type;
+    if (it->second == 0) {
+        points.erase(it);
+    }
+
+    RetagPages();
+}
+
+void Breakpoints::RetagPages() {
+    std::fill(page_tags.begin(), page_tags.end(), 0);
+    for (const auto& point : points) {
+        page_tags[PageIndex(point.first)] |= point.second;
+    }
+}
+
+void Breakpoints::Check(u32 addr, u32 size, Type type) const {
+    for (auto it = points.lower_bound(addr); it != points.end() && it->first - addr < size; ++it) {
+        if (it->second & type) {
+            hits.push_back({it->first, type});
+        }
+    }
+}
+
+const char* Breakpoints::TypeName(Type type) {
+    switch (type) {
+    case Exec:
+        return "Breakpoint";
+    case Read:
+        return "Read watchpoint";
+    default:
+        return "Write watchpoint";
+    }
+}
+
+std::vector<Breakpoints::Hit> Breakpoints::TakeHits() {
+    std::vector<Hit> taken;
+    taken.swap(hits);
+    return taken;
+}
+
+} // End namespace Common
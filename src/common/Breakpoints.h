@@ -0,0 +1,73 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Execution breakpoints and read/write watchpoints. Each core's memory tags the pages holding any of them and drops
+// those pages from its page tables, so only accesses to tagged pages reach the slow path which checks them, and
+// debugging costs nothing elsewhere. Addresses are matched exactly, not through their mirrors.
+class Breakpoints {
+public:
+    enum Type : u8 {Exec  = 0x1,
+                    Read  = 0x2,
+                    Write = 0x4};
+
+    struct Hit {
+        u32 addr;
+        Type type;
+    };
+
+    // The number of pages must be a power of two. Addresses beyond them wrap around, as in the page tables.
+    Breakpoints(unsigned int page_shift, std::size_t num_pages)
+            : shift(page_shift), page_tags(num_pages, 0) {}
+
+    void Add(u32 addr, Type type);
+    void Remove(u32 addr, Type type);
+    bool Empty() const { return points.empty(); }
+
+    std::size_t PageIndex(u32 addr) const { return (addr >> shift) & (page_tags.size() - 1); }
+    bool Tagged(std::size_t page, u8 types) const { return page_tags[page] & types; }
+
+    // Records a hit if any byte of the access has a breakpoint of the given type. Const so that it can be called
+    // from const memory reads.
+    void Check(u32 addr, u32 size, Type type) const;
+    bool Triggered() const { return !hits.empty(); }
+    // Returns the hits recorded since the last call.
+    std::vector<Hit> TakeHits();
+
+    static const char* TypeName(Type type);
+
+private:
+    const unsigned int shift;
+    std::vector<u8> page_tags;
+    // The types of breakpoint at each address.
+    std::map<u32, u8> points;
+
+    mutable std::vector<Hit> hits;
+
+    void RetagPages();
+};
+
+} // End namespace Common
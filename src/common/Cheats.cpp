@@ -0,0 +1,146 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <stdexcept>
+
+#include "common/Cheats.h"
+
+namespace Common {
+
+namespace {
+
+// Strips the separators which codes are usually written with, and checks that what's left is all hex digits.
+std::string HexDigits(const std::string& code) {
+    std::string digits;
+    for (const char c : code) {
+        if (c == '-' || c == ' ' || c == ':') {
+            continue;
+        }
+        if (!std::isxdigit(static_cast<unsigned char>(c))) {
+            throw std::runtime_error("Invalid cheat code: " + code);
+        }
+        digits.push_back(c);
+    }
+
+    return digits;
+}
+
+u32 HexValue(const std::string& digits, std::size_t first, std::size_t count) {
+    return static_cast<u32>(std::stoul(digits.substr(first, count), nullptr, 16));
+}
+
+// GameShark v1/v2 codes are encrypted with TEA, using a fixed key unless a DEADFACE code changes it.
+void DecryptGameShark(u32& addr, u32& value) {
+    static constexpr std::array<u32, 4> seeds{{0x09F4'FBBD, 0x9681'884A, 0x3520'27E9, 0xF3DE'E5A7}};
+
+    u32 sum = 0xC6EF'3720;
+    for (int round = 0; round < 32; ++round) {
+        value -= ((addr << 4) + seeds[2]) ^ (addr + sum) ^ ((addr >> 5) + seeds[3]);
+        addr -= ((value << 4) + seeds[0]) ^ (value + sum) ^ ((value >> 5) + seeds[1]);
+        sum -= 0x9E37'79B9;
+    }
+}
+
+} // End anonymous namespace
+
+void Cheats::AddRomPatch(u32 addr, u8 value, bool has_compare, u8 compare) {
+    rom_patches[addr] = {value, has_compare, compare};
+    patched_pages[PageIndex(addr)] = true;
+}
+
+void Cheats::AddGbCode(const std::string& code) {
+    const std::string digits{HexDigits(code)};
+
+    if (digits.size() == 8 && code.find('-') == std::string::npos) {
+        // GameShark: type, value, then the address low byte first. Types 8x and 9x select WRAM bank x.
+        const u32 type = HexValue(digits, 0, 2);
+        const u32 value = HexValue(digits, 2, 2);
+        const u32 addr = HexValue(digits, 4, 2) | (HexValue(digits, 6, 2) << 8);
+        u8 bank = 0;
+        if ((type & 0xE8) == 0x80) {
+            bank = std::max(type & 0x07, 1u);
+        } else if (type > 0x01) {
+            throw std::runtime_error("Unsupported GameShark code type: " + code);
+        }
+
+        AddRamWrite({addr, value, 1, bank});
+    } else if (digits.size() == 6 || digits.size() == 9) {
+        // Game Genie: the new value, then the address with its top digit moved to the end and inverted. The
+        // optional compare value is digits 7 and 9, rotated right by two and XORed with 0xBA. Digit 8 is unused.
+        const u8 value = static_cast<u8>(HexValue(digits, 0, 2));
+        const u32 addr = ((HexValue(digits, 5, 1) ^ 0xF) << 12) | HexValue(digits, 2, 3);
+        if (addr >= 0x8000) {
+            throw std::runtime_error("Game Genie code doesn't patch the ROM: " + code);
+        }
+
+        if (digits.size() == 6) {
+            AddRomPatch(addr, value);
+        } else {
+            const u32 packed = (HexValue(digits, 6, 1) << 4) | HexValue(digits, 8, 1);
+            const u8 compare = static_cast<u8>(((packed >> 2) | (packed << 6)) ^ 0xBA);
+            AddRomPatch(addr, value, true, compare);
+        }
+    } else {
+        throw std::runtime_error("Invalid cheat code: " + code);
+    }
+}
+
+void Cheats::AddGbaCode(const std::string& code) {
+    const std::string digits{HexDigits(code)};
+    if (digits.size() != 16) {
+        throw std::runtime_error("Invalid cheat code: " + code);
+    }
+
+    u32 addr = HexValue(digits, 0, 8);
+    u32 value = HexValue(digits, 8, 8);
+    DecryptGameShark(addr, value);
+
+    if (addr == 0xDEAD'FACE) {
+        throw std::runtime_error("GameShark codes which change the encryption key are unsupported: " + code);
+    }
+
+    switch (addr >> 28) {
+    case 0x0:
+        AddRamWrite({addr & 0x0FFF'FFFF, value & 0xFF, 1, 0});
+        break;
+    case 0x1:
+        AddRamWrite({addr & 0x0FFF'FFFF, value & 0xFFFF, 2, 0});
+        break;
+    case 0x2:
+        AddRamWrite({addr & 0x0FFF'FFFF, value, 4, 0});
+        break;
+    case 0x6: {
+        // The address is in halfwords from the start of the ROM. Patch every wait state mirror of it.
+        const u32 rom_offset = (addr & 0x00FF'FFFF) << 1;
+        for (u32 mirror = 0x0800'0000; mirror <= 0x0C00'0000; mirror += 0x0200'0000) {
+            AddRomPatch(mirror + rom_offset, static_cast<u8>(value));
+            AddRomPatch(mirror + rom_offset + 1, static_cast<u8>(value >> 8));
+        }
+        break;
+    }
+    case 0xF:
+        // Master codes tell the device where to hook the game, which isn't needed here.
+        break;
+    default:
+        throw std::runtime_error("Unsupported GameShark code type: " + code);
+    }
+}
+
+} // End namespace Common
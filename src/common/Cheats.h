@@ -0,0 +1,100 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Cheat codes, decoded into ROM patches and RAM writes. ROM patches change what reads of the patched bytes return.
+// As with breakpoints, each core's memory drops the pages holding them from its read page table, so only reads of
+// those pages look the patches up and cheats cost nothing elsewhere. RAM writes are applied by the core once a
+// frame, on entering VBlank, which is when the cheat devices themselves applied them.
+class Cheats {
+public:
+    struct RamWrite {
+        u32 addr;
+        u32 value;
+        u8 size;
+        // The Game Boy Color WRAM bank to write to, for addresses in the switchable bank. Zero means whichever bank
+        // is currently mapped.
+        u8 bank;
+    };
+
+    // The number of pages must be a power of two. Addresses beyond them wrap around, as in the page tables.
+    Cheats(unsigned int page_shift, std::size_t num_pages)
+            : shift(page_shift), patched_pages(num_pages, false) {}
+
+    // Game Boy Game Genie codes (ABC-DEF or ABC-DEF-GHI) patch the ROM, and GameShark codes (ttvvllhh) write to
+    // RAM. Throws if the code is neither.
+    void AddGbCode(const std::string& code);
+    // GBA GameShark and Action Replay v1/v2 codes (XXXXXXXX YYYYYYYY, encrypted). Constant RAM writes and ROM
+    // patches are supported. Throws for malformed codes and other code types.
+    void AddGbaCode(const std::string& code);
+
+    // With has_compare set, the byte is only replaced if it would otherwise read as compare.
+    void AddRomPatch(u32 addr, u8 value, bool has_compare = false, u8 compare = 0x00);
+    void AddRamWrite(const RamWrite& write) { ram_writes.push_back(write); }
+
+    bool Empty() const { return rom_patches.empty() && ram_writes.empty(); }
+    bool HasRomPatches() const { return !rom_patches.empty(); }
+
+    std::size_t PageIndex(u32 addr) const { return (addr >> shift) & (patched_pages.size() - 1); }
+    bool Patched(std::size_t page) const { return patched_pages[page]; }
+
+    // Applies any patches to a read of value from the aligned address addr. Values are little-endian.
+    template<typename T>
+    T PatchRead(u32 addr, T value) const {
+        if (!Patched(PageIndex(addr))) {
+            return value;
+        }
+
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            const auto patch = rom_patches.find(addr + i);
+            const u8 original = static_cast<u8>(value >> (8 * i));
+            if (patch == rom_patches.cend() || (patch->second.has_compare && patch->second.compare != original)) {
+                continue;
+            }
+
+            value = static_cast<T>((value & ~(T{0xFF} << (8 * i))) | (T{patch->second.value} << (8 * i)));
+        }
+
+        return value;
+    }
+
+    const std::vector<RamWrite>& RamWrites() const { return ram_writes; }
+
+private:
+    struct RomPatch {
+        u8 value;
+        bool has_compare;
+        u8 compare;
+    };
+
+    unsigned int shift;
+    std::vector<bool> patched_pages;
+    std::unordered_map<u32, RomPatch> rom_patches;
+    std::vector<RamWrite> ram_writes;
+};
+
+} // End namespace Common
@@ -16,4 +16,7 @@
 
 #pragma once
 
-enum class LogLevel {None, Trace, Registers, Timer, LCD};
+enum class LogLevel {None, Trace, Registers, Timer, LCD, Binary};
+enum class AudioFilter {Nearest, Iir, Polyphase, BandLimited};
+// Fast drops timing details finer than an instruction, which few games depend on, for batch runs.
+enum class Accuracy {Accurate, Fast};
@@ -0,0 +1,46 @@
+// This file is a part of Chroma.
+// Copyright (C) 2016-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "common/FileUtils.h"
+
+namespace Common {
+
+std::size_t GetFileSize(std::ifstream& filestream) {
+    filestream.seekg(0, std::ios_base::end);
+    auto size = filestream.tellg();
+    filestream.seekg(0, std::ios_base::beg);
+
+    return size;
+}
+
+void CheckPathIsRegularFile(const std::string& filename) {
+    // Check that the path points to a regular file.
+    struct stat stat_info;
+    if (stat(filename.c_str(), &stat_info) == 0) {
+        if (stat_info.st_mode & S_IFDIR) {
+            throw std::runtime_error("Provided path is a directory: " + filename);
+        } else if (!(stat_info.st_mode & S_IFREG)) {
+            throw std::runtime_error("Provided path is not a regular file: " + filename);
+        }
+    }
+}
+
+} // End namespace Common
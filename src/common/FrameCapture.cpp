@@ -0,0 +1,108 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdexcept>
+#include <utility>
+#include <fmt/format.h>
+
+#include "common/FrameCapture.h"
+#include "common/Screenshot.h"
+
+namespace Common {
+
+FrameCapture::FrameCapture(const std::string& path_prefix, Format _format, int _width, int _height)
+        : prefix(path_prefix)
+        , format(_format)
+        , width(_width)
+        , height(_height) {
+    if (format == Format::Raw) {
+        raw_stream.open(prefix + ".rgb", std::ios::binary | std::ios::trunc);
+        if (!raw_stream) {
+            throw std::runtime_error(fmt::format("Could not open {}.rgb for frame capture.", prefix));
+        }
+    }
+
+    writer = std::thread{&FrameCapture::WriterLoop, this};
+}
+
+FrameCapture::~FrameCapture() {
+    {
+        std::lock_guard<std::mutex> lock{queue_mutex};
+        quit = true;
+    }
+
+    work_available.notify_one();
+    writer.join();
+}
+
+void FrameCapture::Submit(const std::vector<u16>& frame) {
+    {
+        std::unique_lock<std::mutex> lock{queue_mutex};
+        space_available.wait(lock, [this] { return queued.size() < max_queued_frames; });
+
+        if (free_frames.empty()) {
+            queued.emplace_back(frame);
+        } else {
+            queued.push_back(std::move(free_frames.back()));
+            free_frames.pop_back();
+            queued.back().assign(frame.cbegin(), frame.cend());
+        }
+    }
+
+    work_available.notify_one();
+}
+
+void FrameCapture::WriterLoop() {
+    std::vector<u16> frame;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{queue_mutex};
+            if (!frame.empty()) {
+                free_frames.push_back(std::move(frame));
+                frame.clear();
+            }
+
+            work_available.wait(lock, [this] { return quit || !queued.empty(); });
+
+            if (queued.empty()) {
+                // Quitting, and every submitted frame has been written.
+                return;
+            }
+
+            frame = std::move(queued.front());
+            queued.pop_front();
+        }
+
+        space_available.notify_one();
+        WriteFrame(frame);
+    }
+}
+
+void FrameCapture::WriteFrame(const std::vector<u16>& frame) {
+    BGR5ToRGB8(frame, rgb8_buffer);
+
+    if (format == Format::Png) {
+        WritePNGFile(rgb8_buffer, fmt::format("{}_{:06}.png", prefix, frame_number), width, height);
+    } else {
+        raw_stream.write(reinterpret_cast<const char*>(rgb8_buffer.data()), rgb8_buffer.size());
+    }
+
+    ++frame_number;
+}
+
+} // End namespace Common
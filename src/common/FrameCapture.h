@@ -0,0 +1,73 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Writes every frame the core finishes to disk on a background thread, either as numbered PNG files or as one raw
+// RGB24 stream which can be fed straight to ffmpeg with "-f rawvideo -pix_fmt rgb24 -s WxH -r 59.7275".
+// Capture never drops frames: if the writer falls behind by more than a few frames, Submit waits for it.
+class FrameCapture {
+public:
+    enum class Format {Png, Raw};
+
+    // Frames are written to <path_prefix>_000000.png onwards, or appended to <path_prefix>.rgb.
+    FrameCapture(const std::string& path_prefix, Format format, int width, int height);
+    // Writes any frames still queued.
+    ~FrameCapture();
+
+    void Submit(const std::vector<u16>& frame);
+
+private:
+    static constexpr std::size_t max_queued_frames = 8;
+
+    const std::string prefix;
+    const Format format;
+    const int width;
+    const int height;
+    std::ofstream raw_stream;
+
+    std::deque<std::vector<u16>> queued;
+    // Frames which have been written, kept so that Submit doesn't allocate.
+    std::vector<std::vector<u16>> free_frames;
+    bool quit = false;
+    std::mutex queue_mutex;
+    std::condition_variable work_available;
+    std::condition_variable space_available;
+
+    // Only accessed by the writer thread.
+    int frame_number = 0;
+    std::vector<u8> rgb8_buffer;
+
+    std::thread writer;
+
+    void WriterLoop();
+    void WriteFrame(const std::vector<u16>& frame);
+};
+
+} // End namespace Common
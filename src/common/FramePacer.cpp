@@ -0,0 +1,77 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <thread>
+
+#include "common/FramePacer.h"
+
+namespace Common {
+
+constexpr double FramePacer::refresh_rate;
+
+void FramePacer::WaitForNextFrame() {
+    using namespace std::chrono;
+
+    const auto now = Clock::now();
+    if (settings.unthrottled) {
+        started = false;
+        return;
+    }
+
+    const double speed = (turbo) ? settings.turbo_multiplier : 1.0;
+    const auto period = duration_cast<Clock::duration>(duration<double>(1.0 / (refresh_rate * speed)));
+
+    if (started) {
+        deadline += period;
+    } else {
+        deadline = now + period;
+        started = true;
+    }
+
+    if (now - deadline > period) {
+        // Too far behind to catch up, e.g. after a pause or a stall. Start counting from now instead of running
+        // fast until the lost time has been made up.
+        deadline = now;
+    }
+
+    const auto spin_start = deadline - settings.spin_window;
+    if (now < spin_start) {
+        std::this_thread::sleep_until(spin_start);
+    }
+
+    auto wake_time = Clock::now();
+    while (wake_time < deadline) {
+        std::this_thread::yield();
+        wake_time = Clock::now();
+    }
+
+    total_error += wake_time - deadline;
+    ++num_frames;
+}
+
+float FramePacer::TakeAverageError() {
+    using namespace std::chrono;
+
+    const float error = (num_frames == 0) ? 0.0f
+                                          : duration<float, std::micro>(total_error).count() / num_frames;
+    total_error = Clock::duration{0};
+    num_frames = 0;
+
+    return error;
+}
+
+} // End namespace Common
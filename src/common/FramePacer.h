@@ -0,0 +1,65 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <chrono>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Paces emulation to the consoles' real refresh rate, independently of the display's. Sleeps often overshoot by a
+// millisecond or more, so it sleeps until shortly before each frame is due and spins for the rest.
+class FramePacer {
+public:
+    struct Settings {
+        // The speed multiplier while turbo is held.
+        int turbo_multiplier = 4;
+        // How long before each frame is due to stop sleeping and spin instead.
+        std::chrono::microseconds spin_window{1500};
+        // Never wait, and run as fast as possible.
+        bool unthrottled = false;
+    };
+
+    // Both consoles draw a frame every 280896 cycles of a 2^24Hz clock, or about 59.73Hz.
+    static constexpr double refresh_rate = 16777216.0 / 280896.0;
+
+    void SetSettings(const Settings& new_settings) { settings = new_settings; }
+    void SetTurbo(bool enable) { turbo = enable; }
+    // Audio isn't played while running faster than real time.
+    bool FastForwarding() const { return turbo || settings.unthrottled; }
+
+    // Waits until the next frame is due, counting from when the last one was.
+    void WaitForNextFrame();
+    // The average time the frames since the last call started after they were due, in microseconds.
+    float TakeAverageError();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Settings settings;
+    bool turbo = false;
+
+    bool started = false;
+    Clock::time_point deadline;
+
+    Clock::duration total_error{0};
+    int num_frames = 0;
+};
+
+} // End namespace Common
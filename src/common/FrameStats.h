@@ -0,0 +1,34 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Results of running a core unthrottled, without presenting any frames.
+struct FrameStats {
+    int frames = 0;
+    double total_seconds = 0.0;
+    double avg_frame_time_us = 0.0;
+    double max_frame_time_us = 0.0;
+    // Identifies the last frame drawn, so runs can be checked against a known good result.
+    u64 framebuffer_hash = 0;
+};
+
+} // End namespace Common
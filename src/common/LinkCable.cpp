@@ -0,0 +1,246 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define CHROMA_SOCKETS
+#endif
+
+#include "common/LinkCable.h"
+
+namespace Common {
+
+constexpr std::chrono::milliseconds LinkCable::resend_interval;
+constexpr std::chrono::milliseconds LinkCable::transfer_timeout;
+
+u32 LinkCable::Transfer(u32 data) {
+    using namespace std::chrono;
+
+    const u32 seq = next_seq++;
+    const auto deadline = steady_clock::now() + transfer_timeout;
+
+    while (steady_clock::now() < deadline) {
+        Send({Packet::Type::Start, seq, data});
+
+        const auto resend_time = std::min(steady_clock::now() + resend_interval, deadline);
+        Packet packet;
+        for (auto now = steady_clock::now(); now < resend_time; now = steady_clock::now()) {
+            if (!Receive(packet, duration_cast<milliseconds>(resend_time - now))) {
+                break;
+            }
+
+            if (packet.type == Packet::Type::Reply && packet.seq == seq) {
+                return packet.data;
+            } else if (packet.type == Packet::Type::Start) {
+                // The other side is supplying a clock as well, so neither side gets clocked by the other.
+                Reply(packet.seq, disconnected_data);
+            }
+
+            // Anything else is a late reply to a transfer which already timed out.
+        }
+    }
+
+    return disconnected_data;
+}
+
+bool LinkCable::Respond(u32 reply, u32& received) {
+    Packet packet;
+    while (Receive(packet, std::chrono::milliseconds{0})) {
+        if (packet.type == Packet::Type::Start && Reply(packet.seq, reply)) {
+            received = packet.data;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool LinkCable::Reply(u32 seq, u32 data) {
+    if (replied && seq == replied_seq) {
+        Send({Packet::Type::Reply, seq, replied_data});
+        return false;
+    }
+
+    replied = true;
+    replied_seq = seq;
+    replied_data = data;
+    Send({Packet::Type::Reply, seq, data});
+    return true;
+}
+
+std::pair<std::unique_ptr<LinkCable>, std::unique_ptr<LinkCable>> LocalLinkCable::CreatePair() {
+    auto a_to_b = std::make_shared<Wire>();
+    auto b_to_a = std::make_shared<Wire>();
+
+    return {std::unique_ptr<LinkCable>(new LocalLinkCable(b_to_a, a_to_b)),
+            std::unique_ptr<LinkCable>(new LocalLinkCable(a_to_b, b_to_a))};
+}
+
+void LocalLinkCable::Send(const Packet& packet) {
+    {
+        std::lock_guard<std::mutex> lock{outgoing->mutex};
+        outgoing->packets.push_back(packet);
+    }
+    outgoing->packet_sent.notify_one();
+}
+
+bool LocalLinkCable::Receive(Packet& packet, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock{incoming->mutex};
+    if (!incoming->packet_sent.wait_for(lock, timeout, [this] { return !incoming->packets.empty(); })) {
+        return false;
+    }
+
+    packet = incoming->packets.front();
+    incoming->packets.pop_front();
+    return true;
+}
+
+#ifdef CHROMA_SOCKETS
+
+namespace {
+
+// Packets are sent as the type byte, then the little-endian sequence number and data.
+constexpr std::size_t packet_size = 9;
+
+int OpenSocket(u16 port) {
+    const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        throw std::runtime_error("Failed to open link cable socket.");
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sock, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1) {
+        close(sock);
+        throw std::runtime_error("Failed to bind link cable socket to port " + std::to_string(port) + ".");
+    }
+
+    return sock;
+}
+
+} // End anonymous namespace
+
+struct UdpLinkCable::Peer {
+    sockaddr_storage addr{};
+    socklen_t len = 0;
+};
+
+UdpLinkCable::UdpLinkCable(u16 listen_port)
+        : sock(OpenSocket(listen_port))
+        , peer(std::make_unique<Peer>()) {}
+
+UdpLinkCable::UdpLinkCable(const std::string& host, u16 port)
+        : peer(std::make_unique<Peer>()) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* result;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+        throw std::runtime_error("Failed to look up link cable host " + host + ".");
+    }
+
+    std::copy_n(reinterpret_cast<const u8*>(result->ai_addr), result->ai_addrlen,
+                reinterpret_cast<u8*>(&peer->addr));
+    peer->len = result->ai_addrlen;
+    freeaddrinfo(result);
+
+    // Any free port will do for this end.
+    sock = OpenSocket(0);
+}
+
+UdpLinkCable::~UdpLinkCable() {
+    close(sock);
+}
+
+void UdpLinkCable::Send(const Packet& packet) {
+    if (peer->len == 0) {
+        // Nobody has connected yet, which looks the same as a lost packet to the sender.
+        return;
+    }
+
+    std::array<u8, packet_size> buffer;
+    buffer[0] = static_cast<u8>(packet.type);
+    for (std::size_t i = 0; i < 4; ++i) {
+        buffer[1 + i] = packet.seq >> (i * 8);
+        buffer[5 + i] = packet.data >> (i * 8);
+    }
+
+    // Errors are treated as lost packets, which get resent.
+    sendto(sock, buffer.data(), buffer.size(), 0, reinterpret_cast<const sockaddr*>(&peer->addr), peer->len);
+}
+
+bool UdpLinkCable::Receive(Packet& packet, std::chrono::milliseconds timeout) {
+    pollfd fd{sock, POLLIN, 0};
+    if (poll(&fd, 1, static_cast<int>(timeout.count())) <= 0) {
+        return false;
+    }
+
+    std::array<u8, packet_size> buffer;
+    sockaddr_storage sender_addr{};
+    socklen_t sender_len = sizeof(sender_addr);
+    const ssize_t size = recvfrom(sock, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&sender_addr),
+                               &sender_len);
+    if (size != static_cast<ssize_t>(packet_size) || buffer[0] > static_cast<u8>(Packet::Type::Reply)) {
+        return false;
+    }
+
+    // A listening cable replies to whoever last sent it a packet.
+    peer->addr = sender_addr;
+    peer->len = sender_len;
+
+    packet.type = static_cast<Packet::Type>(buffer[0]);
+    packet.seq = 0;
+    packet.data = 0;
+    for (std::size_t i = 0; i < 4; ++i) {
+        packet.seq |= static_cast<u32>(buffer[1 + i]) << (i * 8);
+        packet.data |= static_cast<u32>(buffer[5 + i]) << (i * 8);
+    }
+
+    return true;
+}
+
+#else
+
+struct UdpLinkCable::Peer {};
+
+UdpLinkCable::UdpLinkCable(u16) {
+    throw std::runtime_error("Link cables over UDP aren't supported on this platform.");
+}
+
+UdpLinkCable::UdpLinkCable(const std::string&, u16) {
+    throw std::runtime_error("Link cables over UDP aren't supported on this platform.");
+}
+
+UdpLinkCable::~UdpLinkCable() = default;
+
+void UdpLinkCable::Send(const Packet&) {}
+
+bool UdpLinkCable::Receive(Packet&, std::chrono::milliseconds) { return false; }
+
+#endif
+
+} // End namespace Common
@@ -0,0 +1,122 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// One end of a link cable between two emulator instances. Rather than running both instances in lockstep, they only
+// synchronise at transfer boundaries. The side supplying the clock sends a whole transfer when it starts one, and
+// waits for the other side's data. The clocked side checks for incoming transfers every so often, replying with the
+// data it has ready. In between transfers, each instance runs ahead as far as it likes.
+class LinkCable {
+public:
+    virtual ~LinkCable() = default;
+
+    // Called by the clocking side when it starts a transfer. Returns the other side's data, or disconnected_data if
+    // it doesn't reply in time.
+    u32 Transfer(u32 data);
+    // Called by the clocked side. If the other side has started a transfer, replies with the given data and
+    // returns true, with the incoming data in received. Never waits.
+    bool Respond(u32 reply, u32& received);
+
+    // A disconnected serial port reads all 1s.
+    static constexpr u32 disconnected_data = 0xFFFF'FFFF;
+
+protected:
+    struct Packet {
+        enum class Type : u8 {Start, Reply};
+
+        Type type;
+        u32 seq;
+        u32 data;
+    };
+
+    // Packets may be dropped or duplicated, so starts are resent until they're replied to.
+    virtual void Send(const Packet& packet) = 0;
+    // Waits up to timeout for a packet. A zero timeout only checks for a packet which has already arrived.
+    virtual bool Receive(Packet& packet, std::chrono::milliseconds timeout) = 0;
+
+private:
+    static constexpr std::chrono::milliseconds resend_interval{16};
+    static constexpr std::chrono::milliseconds transfer_timeout{500};
+
+    u32 next_seq = 0;
+
+    // The last start we replied to. If it's resent because our reply was lost, it gets the same reply again
+    // instead of being taken as a new transfer.
+    bool replied = false;
+    u32 replied_seq = 0;
+    u32 replied_data = 0;
+
+    // Returns false if this start was already replied to.
+    bool Reply(u32 seq, u32 data);
+};
+
+// Links two instances in the same process, running on different threads.
+class LocalLinkCable : public LinkCable {
+public:
+    // Returns both ends of a new cable.
+    static std::pair<std::unique_ptr<LinkCable>, std::unique_ptr<LinkCable>> CreatePair();
+
+protected:
+    void Send(const Packet& packet) override;
+    bool Receive(Packet& packet, std::chrono::milliseconds timeout) override;
+
+private:
+    struct Wire {
+        std::mutex mutex;
+        std::condition_variable packet_sent;
+        std::deque<Packet> packets;
+    };
+
+    LocalLinkCable(std::shared_ptr<Wire> in, std::shared_ptr<Wire> out) : incoming(in), outgoing(out) {}
+
+    std::shared_ptr<Wire> incoming;
+    std::shared_ptr<Wire> outgoing;
+};
+
+// Links two instances over UDP. Only available on Unix-like platforms.
+class UdpLinkCable : public LinkCable {
+public:
+    // Waits on the given port. The other side's address is taken from the packets it sends.
+    explicit UdpLinkCable(u16 listen_port);
+    // Connects to an instance listening on host:port.
+    UdpLinkCable(const std::string& host, u16 port);
+    ~UdpLinkCable();
+
+protected:
+    void Send(const Packet& packet) override;
+    bool Receive(Packet& packet, std::chrono::milliseconds timeout) override;
+
+private:
+    struct Peer;
+
+    int sock = -1;
+    std::unique_ptr<Peer> peer;
+};
+
+} // End namespace Common
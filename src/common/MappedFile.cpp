@@ -0,0 +1,105 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define CHROMA_MMAP
+#endif
+
+#include "common/MappedFile.h"
+
+namespace Common {
+
+MappedFile::MappedFile(const std::string& filename, std::size_t file_size, std::size_t view_size)
+        : size(std::max(file_size, view_size)) {
+#ifdef CHROMA_MMAP
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd != -1) {
+        // Reserve the whole view as anonymous zero pages, then map the file over the start of it. The tail of the
+        // last file page past the end of the file reads as zeroes too.
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (view != MAP_FAILED) {
+            if (file_size == 0 || mmap(view, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED) {
+                data = static_cast<const u8*>(view);
+                mapped = true;
+            } else {
+                munmap(view, size);
+            }
+        }
+
+        close(fd);
+    }
+
+    if (mapped) {
+        return;
+    }
+#endif
+
+    fallback.resize(size);
+    std::ifstream file(filename, std::ios::binary);
+    file.read(reinterpret_cast<char*>(fallback.data()), file_size);
+    if (!file || static_cast<std::size_t>(file.gcount()) != file_size) {
+        throw std::runtime_error("Error when attempting to read " + filename);
+    }
+    data = fallback.data();
+}
+
+MappedFile::~MappedFile() {
+    Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+        : data(other.data)
+        , size(other.size)
+        , mapped(other.mapped)
+        , fallback(std::move(other.fallback)) {
+    other.data = nullptr;
+    other.size = 0;
+    other.mapped = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Unmap();
+
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        mapped = std::exchange(other.mapped, false);
+        fallback = std::move(other.fallback);
+    }
+
+    return *this;
+}
+
+void MappedFile::Unmap() {
+#ifdef CHROMA_MMAP
+    if (mapped) {
+        munmap(const_cast<u8*>(data), size);
+    }
+#endif
+
+    mapped = false;
+}
+
+} // End namespace Common
@@ -0,0 +1,77 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// A read-only view of a file which is mapped into memory where the platform supports it, and read into a buffer
+// otherwise. Mapping avoids copying the file at startup, and lets every emulator instance running the same file
+// share one copy of it in the page cache. The view can be longer than the file, in which case the rest reads as
+// zeroes without taking up any memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const std::string& filename, std::size_t file_size, std::size_t view_size);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const u8* Data() const { return data; }
+    std::size_t Size() const { return size; }
+
+private:
+    const u8* data = nullptr;
+    std::size_t size = 0;
+    bool mapped = false;
+    std::vector<u8> fallback;
+
+    void Unmap();
+};
+
+// A ROM or BIOS image, viewed as an array of the bus width of the system that reads it.
+template<typename T>
+class RomView {
+public:
+    RomView() = default;
+    explicit RomView(MappedFile&& file) : mapping(std::move(file)) {}
+
+    const T* data() const { return reinterpret_cast<const T*>(mapping.Data()); }
+    std::size_t size() const { return mapping.Size() / sizeof(T); }
+    bool empty() const { return size() == 0; }
+
+    const T& operator[](std::size_t index) const { return data()[index]; }
+
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+    const T* cbegin() const { return begin(); }
+    const T* cend() const { return end(); }
+
+private:
+    MappedFile mapping;
+};
+
+} // End namespace Common
@@ -0,0 +1,149 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define CHROMA_MMAP
+#endif
+
+#if defined(__linux__)
+#include <unistd.h>
+#define CHROMA_MEMFD
+#endif
+
+#include "common/MemoryArena.h"
+
+namespace Common {
+
+constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+#ifdef CHROMA_MEMFD
+namespace {
+
+bool WriteAll(int fd, const u8* data, std::size_t size) {
+    std::size_t written = 0;
+    while (written < size) {
+        const ssize_t result = pwrite(fd, data + written, size - written, written);
+        if (result <= 0) {
+            return false;
+        }
+        written += result;
+    }
+
+    return true;
+}
+
+// Moving the new mapping over the old one replaces it in one step, so the arena is never left unmapped.
+bool MapSnapshot(int fd, u8* base, std::size_t size, bool huge_pages) {
+    void* snapshot = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (snapshot == MAP_FAILED) {
+        return false;
+    }
+
+    if (mremap(snapshot, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, base) == MAP_FAILED) {
+        munmap(snapshot, size);
+        return false;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) {
+        madvise(base, size, MADV_HUGEPAGE);
+    }
+#else
+    (void)huge_pages;
+#endif
+
+    return true;
+}
+
+} // End anonymous namespace
+#endif
+
+MemoryArena::MemoryArena(std::size_t arena_capacity, bool huge_pages)
+        : capacity(Align(arena_capacity)) {
+#ifdef CHROMA_MMAP
+    // Anonymous mappings are zero-filled and page aligned. Huge pages also have to be aligned to their own size,
+    // so map an extra huge page and trim the ends off.
+    const std::size_t alignment = (huge_pages) ? huge_page_size : 0;
+    const std::size_t size = (huge_pages) ? (capacity + huge_page_size - 1) & ~(huge_page_size - 1) : capacity;
+    void* region = mmap(nullptr, size + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region != MAP_FAILED) {
+        u8* start = static_cast<u8*>(region);
+        if (huge_pages) {
+            const auto addr = reinterpret_cast<std::uintptr_t>(start);
+            const std::size_t lead = ((addr + alignment - 1) & ~(alignment - 1)) - addr;
+            if (lead != 0) {
+                munmap(start, lead);
+            }
+            if (alignment - lead != 0) {
+                munmap(start + lead + size, alignment - lead);
+            }
+            start += lead;
+
+#ifdef MADV_HUGEPAGE
+            madvise(start, size, MADV_HUGEPAGE);
+#endif
+        }
+
+        base = start;
+        mapped = true;
+        huge = huge_pages;
+        mapped_size = size;
+        return;
+    }
+#else
+    (void)huge_pages;
+#endif
+
+    // Leave room to align the start to a cache line.
+    fallback.resize(capacity + 63);
+    const auto addr = reinterpret_cast<std::uintptr_t>(fallback.data());
+    base = fallback.data() + (Align(addr) - addr);
+}
+
+void MemoryArena::ShareCopyOnWrite(MemoryArena& other) {
+#ifdef CHROMA_MEMFD
+    if (mapped && other.mapped && mapped_size == other.mapped_size && used == other.used) {
+        const int fd = memfd_create("chroma-arena", MFD_CLOEXEC);
+        if (fd != -1) {
+            // The other arena is mapped first, so if mapping this one fails its contents are still right.
+            const bool shared = ftruncate(fd, mapped_size) == 0 && WriteAll(fd, base, used)
+                                && MapSnapshot(fd, other.base, mapped_size, other.huge)
+                                && MapSnapshot(fd, base, mapped_size, huge);
+            // The mappings keep the snapshot alive.
+            close(fd);
+            if (shared) {
+                return;
+            }
+        }
+    }
+#endif
+
+    std::copy_n(base, std::min(used, other.used), other.base);
+}
+
+MemoryArena::~MemoryArena() {
+#ifdef CHROMA_MMAP
+    if (mapped) {
+        munmap(base, mapped_size);
+    }
+#endif
+}
+
+} // End namespace Common
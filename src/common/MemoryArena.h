@@ -0,0 +1,117 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// A fixed-size array carved out of a MemoryArena. Like RomView, it has just enough of the std::vector interface for
+// the code which reads and writes guest memory.
+template<typename T>
+class ArenaArray {
+public:
+    ArenaArray() = default;
+    ArenaArray(T* first, std::size_t count) : elements(first), length(count) {}
+
+    T* data() { return elements; }
+    const T* data() const { return elements; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    T& operator[](std::size_t index) { return elements[index]; }
+    const T& operator[](std::size_t index) const { return elements[index]; }
+
+    T* begin() { return elements; }
+    T* end() { return elements + length; }
+    const T* begin() const { return elements; }
+    const T* end() const { return elements + length; }
+    const T* cbegin() const { return elements; }
+    const T* cend() const { return elements + length; }
+
+private:
+    T* elements = nullptr;
+    std::size_t length = 0;
+};
+
+// One zero-filled block which all of a core's mutable guest memory is allocated from, at fixed offsets. Snapshots
+// can copy, compare or XOR the whole of it in one go, and it's a single allocation to account for per instance.
+// Each allocation starts on a cache line. With huge_pages set, the arena is rounded up to a whole 2MB page and the
+// OS is asked to back it with a huge page where it can (transparent huge pages on Linux), which saves TLB entries
+// when many instances run at once.
+class MemoryArena {
+public:
+    MemoryArena(std::size_t capacity, bool huge_pages);
+    ~MemoryArena();
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    static constexpr std::size_t Align(std::size_t bytes) { return (bytes + 63) & ~std::size_t{63}; }
+    // The capacity needed to allocate count elements of T.
+    template<typename T>
+    static constexpr std::size_t BytesFor(std::size_t count) { return Align(count * sizeof(T)); }
+
+    template<typename T>
+    ArenaArray<T> Allocate(std::size_t count) {
+        const std::size_t bytes = BytesFor<T>(count);
+        if (bytes > capacity - used) {
+            throw std::runtime_error("Memory arena is full.");
+        }
+
+        T* first = reinterpret_cast<T*>(base + used);
+        used += bytes;
+        return {first, count};
+    }
+
+    // Allocates a region holding a copy of another.
+    template<typename T>
+    ArenaArray<T> Copy(const ArenaArray<T>& source) {
+        auto region = Allocate<T>(source.size());
+        std::copy(source.cbegin(), source.cend(), region.begin());
+        return region;
+    }
+
+    // Replaces the contents of other, an arena of the same capacity, with this one's. On Linux both arenas then map
+    // the same snapshot copy-on-write, so pages neither of them writes afterwards are shared rather than duplicated
+    // by every clone. Elsewhere, or if the snapshot can't be mapped, the contents are simply copied.
+    void ShareCopyOnWrite(MemoryArena& other);
+
+    // The allocated part of the arena, which covers every region.
+    u8* Data() { return base; }
+    const u8* Data() const { return base; }
+    std::size_t Size() const { return used; }
+
+private:
+    u8* base = nullptr;
+    std::size_t capacity;
+    std::size_t used = 0;
+
+    bool mapped = false;
+    bool huge = false;
+    std::size_t mapped_size = 0;
+    // Only used when the arena can't be mapped.
+    std::vector<u8> fallback;
+};
+
+} // End namespace Common
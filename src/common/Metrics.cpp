@@ -0,0 +1,213 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fmt/format.h>
+
+#include "common/Metrics.h"
+
+namespace Common {
+
+void FrameTimeHistogram::Record(double frame_time_us) {
+    const u64 value = (frame_time_us > 0.0) ? static_cast<u64>(std::llround(frame_time_us)) : 0;
+    ++buckets[BucketIndex(value)];
+    ++count;
+}
+
+double FrameTimeHistogram::Percentile(double fraction) const {
+    if (count == 0) {
+        return 0.0;
+    }
+
+    const u64 rank = std::max<u64>(1, static_cast<u64>(std::ceil(fraction * count)));
+    u64 seen = 0;
+    for (std::size_t i = 0; i < num_buckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return BucketMidpoint(i);
+        }
+    }
+
+    return BucketMidpoint(num_buckets - 1);
+}
+
+void FrameTimeHistogram::Reset() {
+    buckets.fill(0);
+    count = 0;
+}
+
+std::size_t FrameTimeHistogram::BucketIndex(u64 value) {
+    if (value < sub_buckets) {
+        return value;
+    }
+
+    constexpr u64 max_value = (u64{1} << (max_exponent + 1)) - 1;
+    value = std::min(value, max_value);
+
+    int exponent = sub_bucket_bits;
+    while ((value >> (exponent + 1)) != 0) {
+        ++exponent;
+    }
+
+    // The top sub_bucket_bits + 1 bits of the value, where the leading one picks the power of two.
+    const std::size_t sub_bucket = (value >> (exponent - sub_bucket_bits)) & (sub_buckets - 1);
+    return (exponent - sub_bucket_bits + 1) * sub_buckets + sub_bucket;
+}
+
+double FrameTimeHistogram::BucketMidpoint(std::size_t index) {
+    if (index < sub_buckets) {
+        return static_cast<double>(index);
+    }
+
+    const int shift = static_cast<int>(index / sub_buckets) - 1;
+    const u64 lower = (sub_buckets + index % sub_buckets) << shift;
+    const u64 width = u64{1} << shift;
+    return lower + (width - 1) / 2.0;
+}
+
+Metrics::Metrics(const Settings& metrics_settings, const std::string& console_name, double emulated_frame_rate)
+        : settings(metrics_settings)
+        , console(console_name)
+        , frame_rate(emulated_frame_rate)
+        , last_dump_time(Clock::now()) {}
+
+Metrics::~Metrics() {
+    Dump();
+}
+
+void Metrics::RecordFrame(double frame_time_us, const CpuCounters& cpu, u64 audio_underruns,
+                          std::size_t audio_queued) {
+    frame_times.Record(frame_time_us);
+    ++frames;
+    totals = cpu;
+    underruns = audio_underruns;
+    queued = audio_queued;
+
+    if (Clock::now() - last_dump_time >= settings.interval) {
+        Dump();
+    }
+}
+
+void Metrics::Dump() {
+    const auto now = Clock::now();
+    const double interval_seconds = std::chrono::duration<double>(now - last_dump_time).count();
+    const std::string text = (settings.format == Format::Prometheus) ? FormatPrometheus(interval_seconds)
+                                                                       : FormatJson(interval_seconds);
+
+    // Written to a temporary file and renamed over the last dump, so readers never see half of one. A failed dump
+    // is dropped rather than stopping the emulator; the next one will try again.
+    const std::string temp_path = settings.path + ".tmp";
+    std::FILE* temp_file = std::fopen(temp_path.c_str(), "wb");
+    if (temp_file != nullptr) {
+        bool success = std::fwrite(text.data(), 1, text.size(), temp_file) == text.size();
+        success = std::fclose(temp_file) == 0 && success;
+
+        if (!success || std::rename(temp_path.c_str(), settings.path.c_str()) != 0) {
+            std::remove(temp_path.c_str());
+        }
+    }
+
+    frame_times.Reset();
+    last_dump_time = now;
+    last_dump_frames = frames;
+    last_dump_totals = totals;
+}
+
+namespace {
+
+struct Rates {
+    double speed_ratio = 0.0;
+    double instructions_per_second = 0.0;
+    double cycles_per_second = 0.0;
+    double halt_fraction = 0.0;
+};
+
+Rates IntervalRates(u64 frames, const CpuCounters& cpu, double frame_rate, double interval_seconds) {
+    Rates rates;
+    if (interval_seconds > 0.0) {
+        rates.speed_ratio = frames / frame_rate / interval_seconds;
+        rates.instructions_per_second = cpu.instructions / interval_seconds;
+        rates.cycles_per_second = cpu.cycles / interval_seconds;
+    }
+    if (cpu.cycles != 0) {
+        rates.halt_fraction = static_cast<double>(cpu.halted_cycles) / cpu.cycles;
+    }
+
+    return rates;
+}
+
+CpuCounters Difference(const CpuCounters& now, const CpuCounters& then) {
+    return {now.instructions - then.instructions, now.cycles - then.cycles, now.halted_cycles - then.halted_cycles};
+}
+
+} // End anonymous namespace
+
+std::string Metrics::FormatPrometheus(double interval_seconds) const {
+    const Rates rates = IntervalRates(frames - last_dump_frames, Difference(totals, last_dump_totals), frame_rate,
+                                      interval_seconds);
+    const std::string label = fmt::format("console=\"{}\"", console);
+
+    std::string text;
+    const auto metric = [&](const char* name, const char* type, const char* help, const std::string& value) {
+        text += fmt::format("# HELP chroma_{} {}\n# TYPE chroma_{} {}\nchroma_{}{{{}}} {}\n", name, help, name, type,
+                            name, label, value);
+    };
+
+    metric("frames_total", "counter", "Frames emulated.", std::to_string(frames));
+    metric("instructions_total", "counter", "Guest instructions executed.", std::to_string(totals.instructions));
+    metric("cycles_total", "counter", "Guest CPU cycles emulated.", std::to_string(totals.cycles));
+    metric("halted_cycles_total", "counter", "Guest CPU cycles spent halted or in skipped idle loops.",
+           std::to_string(totals.halted_cycles));
+    metric("audio_underruns_total", "counter", "Audio callbacks which ran out of samples.", std::to_string(underruns));
+    metric("audio_queued_frames", "gauge", "Stereo audio frames waiting to be played.", std::to_string(queued));
+    metric("speed_ratio", "gauge", "Emulated time over wall time since the last dump.",
+           fmt::format("{:.4f}", rates.speed_ratio));
+    metric("instructions_per_second", "gauge", "Guest instructions per wall second since the last dump.",
+           fmt::format("{:.0f}", rates.instructions_per_second));
+    metric("cycles_per_second", "gauge", "Guest CPU cycles per wall second since the last dump.",
+           fmt::format("{:.0f}", rates.cycles_per_second));
+    metric("halt_fraction", "gauge", "Fraction of guest CPU cycles spent halted since the last dump.",
+           fmt::format("{:.4f}", rates.halt_fraction));
+
+    text += "# HELP chroma_frame_time_microseconds Wall time spent emulating each frame since the last dump.\n";
+    text += "# TYPE chroma_frame_time_microseconds gauge\n";
+    for (const auto& quantile : {std::make_pair("0.5", 0.5), std::make_pair("0.99", 0.99),
+                                 std::make_pair("0.999", 0.999)}) {
+        text += fmt::format("chroma_frame_time_microseconds{{{},quantile=\"{}\"}} {:.1f}\n", label, quantile.first,
+                            frame_times.Percentile(quantile.second));
+    }
+
+    return text;
+}
+
+std::string Metrics::FormatJson(double interval_seconds) const {
+    const Rates rates = IntervalRates(frames - last_dump_frames, Difference(totals, last_dump_totals), frame_rate,
+                                      interval_seconds);
+
+    return fmt::format("{{\"console\": \"{}\", \"frames\": {}, \"instructions\": {}, \"cycles\": {}, "
+                       "\"halted_cycles\": {}, \"audio_underruns\": {}, \"audio_queued_frames\": {}, "
+                       "\"speed_ratio\": {:.4f}, \"instructions_per_second\": {:.0f}, \"cycles_per_second\": {:.0f}, "
+                       "\"halt_fraction\": {:.4f}, \"frame_time_us\": {{\"p50\": {:.1f}, \"p99\": {:.1f}, "
+                       "\"p999\": {:.1f}}}}}\n",
+                       console, frames, totals.instructions, totals.cycles, totals.halted_cycles, underruns, queued,
+                       rates.speed_ratio, rates.instructions_per_second, rates.cycles_per_second, rates.halt_fraction,
+                       frame_times.Percentile(0.5), frame_times.Percentile(0.99), frame_times.Percentile(0.999));
+}
+
+} // End namespace Common
@@ -0,0 +1,105 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Running totals kept by each CPU. They aren't part of save states, so they only ever count up.
+struct CpuCounters {
+    u64 instructions = 0;
+    u64 cycles = 0;
+    // Cycles spent halted, or skipped over in idle loops.
+    u64 halted_cycles = 0;
+};
+
+// Frame times in microseconds, in buckets a sixteenth of a power of two wide. Percentiles come out within about 3%
+// of the true value, and the histogram stays the same size however many frames it records.
+class FrameTimeHistogram {
+public:
+    void Record(double frame_time_us);
+    // The frame time which the given fraction of frames took no longer than, e.g. 0.99 for p99.
+    double Percentile(double fraction) const;
+    u64 Count() const { return count; }
+    void Reset();
+
+private:
+    static constexpr int sub_bucket_bits = 4;
+    static constexpr int sub_buckets = 1 << sub_bucket_bits;
+    // Values below sub_buckets are recorded exactly. Anything from 2^(max_exponent + 1)us (a couple of hours) up
+    // lands in the last bucket.
+    static constexpr int max_exponent = 32;
+    static constexpr std::size_t num_buckets = (max_exponent - sub_bucket_bits + 2) * sub_buckets;
+
+    std::array<u64, num_buckets> buckets{};
+    u64 count = 0;
+
+    static std::size_t BucketIndex(u64 value);
+    static double BucketMidpoint(std::size_t index);
+};
+
+// Collects a core's performance counters every frame, and periodically writes them to a file as Prometheus text
+// or JSON, for a node exporter or log shipper to pick up when running many instances. Counters are totals since
+// the core started; the rates and the frame time percentiles cover the time since the last dump.
+class Metrics {
+public:
+    enum class Format {Prometheus, Json};
+    struct Settings {
+        // No metrics are collected if the path is empty.
+        std::string path;
+        Format format = Format::Prometheus;
+        std::chrono::seconds interval{10};
+    };
+
+    // The console label tells GB and GBA instances apart.
+    Metrics(const Settings& metrics_settings, const std::string& console_name, double emulated_frame_rate);
+    // Writes a final dump.
+    ~Metrics();
+
+    // Called once per real frame. Speculative run-ahead frames count towards the CPU counters but not the frames.
+    void RecordFrame(double frame_time_us, const CpuCounters& cpu, u64 audio_underruns, std::size_t audio_queued);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const Settings settings;
+    const std::string console;
+    const double frame_rate;
+
+    FrameTimeHistogram frame_times;
+    u64 frames = 0;
+    CpuCounters totals;
+    u64 underruns = 0;
+    std::size_t queued = 0;
+
+    // Totals and time as of the last dump, to work out the rates over the interval since.
+    Clock::time_point last_dump_time;
+    u64 last_dump_frames = 0;
+    CpuCounters last_dump_totals;
+
+    void Dump();
+    std::string FormatPrometheus(double interval_seconds) const;
+    std::string FormatJson(double interval_seconds) const;
+};
+
+} // End namespace Common
@@ -0,0 +1,184 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <stdexcept>
+#include <fmt/format.h>
+
+#include "common/Movie.h"
+
+namespace Common {
+
+namespace {
+
+constexpr u16 movie_version = 1;
+
+template<typename T>
+void WriteLE(std::ofstream& file, T value) {
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        file.put(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+template<typename T>
+T ReadLE(std::ifstream& file) {
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<T>(static_cast<u8>(file.get())) << (8 * i);
+    }
+
+    if (!file) {
+        throw std::runtime_error("Movie file is truncated.");
+    }
+
+    return value;
+}
+
+} // End anonymous namespace
+
+Movie::Movie(const std::string& _filename, Console _console, std::vector<u8> _start_state)
+        : filename(_filename)
+        , recording(true)
+        , console(_console)
+        , start_state(std::move(_start_state)) {
+    // Make sure the movie can be written before recording anything into it.
+    std::ofstream movie_file{filename, std::ios::binary | std::ios::trunc};
+    if (!movie_file) {
+        throw std::runtime_error("Error when attempting to open " + filename);
+    }
+}
+
+Movie::Movie(const std::string& _filename)
+        : filename(_filename)
+        , recording(false) {
+    std::ifstream movie_file{filename, std::ios::binary};
+    if (!movie_file) {
+        throw std::runtime_error("Error when attempting to open " + filename);
+    }
+
+    if (ReadLE<u32>(movie_file) != 0x564D'4843) {
+        throw std::runtime_error(filename + " is not a movie file.");
+    }
+
+    const u16 version = ReadLE<u16>(movie_file);
+    if (version != movie_version) {
+        throw std::runtime_error(fmt::format("Movie version {} is not supported.", version));
+    }
+
+    const u8 console_id = ReadLE<u8>(movie_file);
+    if (console_id > static_cast<u8>(Console::Gba)) {
+        throw std::runtime_error("Movie is for an unknown console.");
+    }
+    console = static_cast<Console>(console_id);
+
+    const bool has_start_state = ReadLE<u8>(movie_file);
+    if (ReadLE<u32>(movie_file) != checkpoint_interval) {
+        throw std::runtime_error("Movie has an unsupported checkpoint interval.");
+    }
+    const u32 num_frames = ReadLE<u32>(movie_file);
+    const u32 num_checkpoints = ReadLE<u32>(movie_file);
+
+    if (has_start_state) {
+        start_state.resize(ReadLE<u32>(movie_file));
+        movie_file.read(reinterpret_cast<char*>(start_state.data()), start_state.size());
+    }
+
+    inputs.resize(num_frames);
+    for (auto& input : inputs) {
+        input = ReadLE<u16>(movie_file);
+    }
+
+    checkpoints.resize(num_checkpoints);
+    for (auto& checkpoint : checkpoints) {
+        checkpoint.first = ReadLE<u32>(movie_file);
+        checkpoint.second = ReadLE<u64>(movie_file);
+    }
+}
+
+Movie::~Movie() {
+    if (recording) {
+        Save();
+    }
+}
+
+u16 Movie::NextFrame(u16 held_buttons) {
+    if (recording) {
+        inputs.push_back(held_buttons);
+    } else {
+        held_buttons = (frame < inputs.size()) ? inputs[frame] : 0x0000;
+    }
+
+    ++frame;
+    return held_buttons;
+}
+
+void Movie::Checkpoint(u64 state_hash) {
+    if (recording) {
+        checkpoints.emplace_back(static_cast<u32>(frame), state_hash);
+        return;
+    }
+
+    if (next_checkpoint == checkpoints.size() || checkpoints[next_checkpoint].first != frame) {
+        return;
+    }
+
+    if (checkpoints[next_checkpoint++].second != state_hash) {
+        throw std::runtime_error(fmt::format("Movie desynced by frame {}.", frame));
+    }
+}
+
+u64 Movie::HashState(const std::vector<u8>& state) {
+    // FNV-1a, as for framebuffer hashes.
+    u64 hash = 0xCBF2'9CE4'8422'2325;
+    for (const u8 byte : state) {
+        hash ^= byte;
+        hash *= 0x0000'0100'0000'01B3;
+    }
+
+    return hash;
+}
+
+void Movie::Save() const {
+    std::ofstream movie_file{filename, std::ios::binary | std::ios::trunc};
+
+    WriteLE<u32>(movie_file, 0x564D'4843);
+    WriteLE<u16>(movie_file, movie_version);
+    WriteLE<u8>(movie_file, static_cast<u8>(console));
+    WriteLE<u8>(movie_file, !start_state.empty());
+    WriteLE<u32>(movie_file, checkpoint_interval);
+    WriteLE<u32>(movie_file, static_cast<u32>(inputs.size()));
+    WriteLE<u32>(movie_file, static_cast<u32>(checkpoints.size()));
+
+    if (!start_state.empty()) {
+        WriteLE<u32>(movie_file, static_cast<u32>(start_state.size()));
+        movie_file.write(reinterpret_cast<const char*>(start_state.data()), start_state.size());
+    }
+
+    for (const u16 input : inputs) {
+        WriteLE<u16>(movie_file, input);
+    }
+
+    for (const auto& checkpoint : checkpoints) {
+        WriteLE<u32>(movie_file, checkpoint.first);
+        WriteLE<u64>(movie_file, checkpoint.second);
+    }
+
+    if (!movie_file) {
+        fmt::print("Error when attempting to write {}\n", filename);
+    }
+}
+
+} // End namespace Common
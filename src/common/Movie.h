@@ -0,0 +1,83 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// An input movie holds the buttons held on each frame, from power-on or from an embedded save state. Every
+// checkpoint_interval frames it also holds a hash of the whole machine state, so that playback can tell as soon as it
+// has desynced from the recording.
+//
+// The file is little-endian: the "CHMV" magic, a u16 version, a u8 console, a u8 start type (0 for power-on, 1 for a
+// save state), the u32 checkpoint interval, u32 frame count and u32 checkpoint count, then the u32 size and bytes of
+// the start state (if any), a u16 button mask per frame, and finally a u32 frame number and u64 hash per checkpoint.
+class Movie {
+public:
+    enum class Console : u8 {Gb, Gba};
+
+    static constexpr u32 checkpoint_interval = 60;
+
+    // Starts recording a new movie, which begins at power-on if start_state is empty.
+    Movie(const std::string& filename, Console console, std::vector<u8> start_state);
+    // Opens a movie for playback.
+    explicit Movie(const std::string& filename);
+    // Writes out a movie being recorded.
+    ~Movie();
+
+    Movie(const Movie&) = delete;
+    Movie& operator=(const Movie&) = delete;
+
+    bool Recording() const { return recording; }
+    Console GetConsole() const { return console; }
+    const std::vector<u8>& StartState() const { return start_state; }
+    std::size_t Length() const { return inputs.size(); }
+    // A movie being played back has finished once every recorded frame has been played.
+    bool Finished() const { return !recording && frame >= inputs.size(); }
+
+    // Called at the start of every frame. Returns the buttons to hold for the frame: held_buttons while recording,
+    // and the recorded buttons while playing back (none once the movie has finished).
+    u16 NextFrame(u16 held_buttons);
+
+    // Called at the end of every frame. Says whether a checkpoint falls on this frame.
+    bool CheckpointDue() const { return frame % checkpoint_interval == 0; }
+    // Records the hash of the state at a checkpoint, or checks it against the recording. Throws if they differ.
+    void Checkpoint(u64 state_hash);
+
+    static u64 HashState(const std::vector<u8>& state);
+
+private:
+    const std::string filename;
+    const bool recording;
+    Console console;
+    std::vector<u8> start_state;
+
+    std::vector<u16> inputs;
+    std::vector<std::pair<u32, u64>> checkpoints;
+
+    std::size_t frame = 0;
+    std::size_t next_checkpoint = 0;
+
+    void Save() const;
+};
+
+} // End namespace Common
@@ -0,0 +1,168 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <fmt/format.h>
+
+#include "common/Profiler.h"
+
+namespace Common {
+
+Profiler::Profiler(int _sample_period)
+        : sample_period(_sample_period)
+        , countdown(_sample_period) {
+    stack.reserve(max_depth);
+    sample_key.reserve(max_depth + 1);
+}
+
+void Profiler::PushFrame(u32 entry) {
+    pending_call = false;
+
+    // Past the depth limit, calls are attributed to the deepest frame that fit.
+    if (stack.size() < max_depth) {
+        stack.push_back({entry, pending_return_addr});
+    }
+}
+
+void Profiler::TakeSample(u32 leaf) {
+    countdown += sample_period;
+
+    sample_key.clear();
+    for (const auto& frame : stack) {
+        sample_key.push_back(frame.entry);
+    }
+    sample_key.push_back(leaf);
+
+    // Only allocates the first time a stack is seen.
+    auto sample = samples.find(sample_key);
+    if (sample == samples.end()) {
+        samples.emplace(sample_key, 1);
+    } else {
+        ++sample->second;
+    }
+}
+
+namespace {
+
+// Stands in for the function entry of samples taken outside of any call.
+constexpr u32 root_entry = 0xFFFF'FFFE;
+
+std::string AddrString(u32 addr) {
+    switch (addr) {
+    case 0xFFFF'FFFF:
+        return "[halted]";
+    case root_entry:
+        return "[root]";
+    default:
+        return fmt::format("0x{:0>8X}", addr);
+    }
+}
+
+template<typename Map>
+std::vector<std::pair<u32, u64>> SortedByCount(const Map& counts) {
+    std::vector<std::pair<u32, u64>> sorted{counts.cbegin(), counts.cend()};
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    });
+    return sorted;
+}
+
+} // End anonymous namespace
+
+void Profiler::WriteProfile(const std::string& base_path) const {
+    std::ofstream folded_file{base_path + ".folded"};
+    std::ofstream text_file{base_path + ".txt"};
+    if (!folded_file || !text_file) {
+        throw std::runtime_error("Error when attempting to write profile to " + base_path + ".");
+    }
+
+    std::unordered_map<u32, u64> pc_samples;
+    std::unordered_map<u32, u64> range_samples;
+    std::unordered_map<u32, u64> self_samples;
+    std::unordered_map<u32, u64> total_samples;
+    u64 num_samples = 0;
+
+    for (const auto& sample : samples) {
+        const std::vector<u32>& key = sample.first;
+        const u64 count = sample.second;
+        const u32 leaf = key.back();
+
+        fmt::MemoryWriter stack_str;
+        stack_str << "[root]";
+        for (u32 addr : key) {
+            stack_str << ";" << AddrString(addr);
+        }
+        folded_file << stack_str.str() << " " << count * sample_period << "\n";
+
+        num_samples += count;
+        pc_samples[leaf] += count;
+        if (leaf != halted_leaf) {
+            range_samples[leaf >> range_shift] += count;
+        }
+
+        // The function the PC is in is the innermost frame.
+        self_samples[(key.size() > 1) ? key[key.size() - 2] : root_entry] += count;
+
+        // Recursive functions only count once per sample towards their inclusive total.
+        std::unordered_set<u32> seen{key.cbegin(), key.cend() - 1};
+        for (u32 entry : seen) {
+            total_samples[entry] += count;
+        }
+    }
+
+    auto Percent = [num_samples](u64 count) { return (num_samples) ? 100.0 * count / num_samples : 0.0; };
+
+    fmt::MemoryWriter text;
+    text.write("{} samples, one every {} cycles\n", num_samples, sample_period);
+    text.write("{} cycles run, {} halted ({:.2f}%)\n", total_cycles, halted_cycles,
+               (total_cycles) ? 100.0 * halted_cycles / total_cycles : 0.0);
+
+    constexpr std::size_t max_rows = 50;
+
+    text.write("\nFlat profile by PC:\n{:>10} {:>8}  {}\n", "samples", "percent", "pc");
+    const auto pcs = SortedByCount(pc_samples);
+    for (std::size_t i = 0; i < std::min(pcs.size(), max_rows); ++i) {
+        text.write("{:>10} {:>7.2f}%  {}\n", pcs[i].second, Percent(pcs[i].second), AddrString(pcs[i].first));
+    }
+
+    text.write("\nFunctions by self samples:\n{:>10} {:>8} {:>10} {:>8}  {}\n", "self", "percent", "total",
+               "percent", "entry");
+    const auto functions = SortedByCount(self_samples);
+    for (std::size_t i = 0; i < std::min(functions.size(), max_rows); ++i) {
+        const u32 entry = functions[i].first;
+        const u64 self = functions[i].second;
+        const u64 total = (total_samples.count(entry)) ? total_samples.at(entry) : self;
+        text.write("{:>10} {:>7.2f}% {:>10} {:>7.2f}%  {}\n", self, Percent(self), total, Percent(total),
+                   AddrString(entry));
+    }
+
+    text.write("\nAddress ranges ({} bytes):\n{:>10} {:>8}  {}\n", 1 << range_shift, "samples", "percent", "range");
+    const auto ranges = SortedByCount(range_samples);
+    for (std::size_t i = 0; i < std::min(ranges.size(), max_rows); ++i) {
+        const u32 base = ranges[i].first << range_shift;
+        text.write("{:>10} {:>7.2f}%  0x{:0>8X}-0x{:0>8X}\n", ranges[i].second, Percent(ranges[i].second), base,
+                   base + (1 << range_shift) - 1);
+    }
+
+    text_file << text.str();
+}
+
+} // End namespace Common
@@ -0,0 +1,106 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Samples the guest PC every fixed number of emulated cycles, along with a shadow call stack built from the calls,
+// interrupts and returns the core reports. Stacks are keyed by function entry addresses, since ROMs rarely come
+// with symbols. The shadow stack is a heuristic: code which never returns to its caller's return address (task
+// switchers, longjmp, manual stack tricks) leaves frames behind until the depth limit is reached.
+class Profiler {
+public:
+    explicit Profiler(int _sample_period);
+
+    // Called after each instruction with its address and the cycles it took.
+    void Run(u32 pc, int cycles) {
+        if (pending_call) {
+            PushFrame(pc);
+        }
+
+        if (!stack.empty() && pc == stack.back().return_addr) {
+            stack.pop_back();
+        }
+
+        total_cycles += cycles;
+        countdown -= cycles;
+        if (countdown <= 0) {
+            TakeSample(pc);
+        }
+    }
+
+    // The next address passed to Run is taken as the entry point of the called function.
+    void Call(u32 return_addr) {
+        pending_call = true;
+        pending_return_addr = return_addr;
+    }
+
+    void Halt(int cycles) {
+        total_cycles += cycles;
+        halted_cycles += cycles;
+        countdown -= cycles;
+        if (countdown <= 0) {
+            TakeSample(halted_leaf);
+        }
+    }
+
+    // The shadow stack means nothing after loading a state.
+    void ResetStack() {
+        stack.clear();
+        pending_call = false;
+    }
+
+    // Writes <base_path>.folded, in the collapsed stack format used by flamegraph.pl and speedscope, and
+    // <base_path>.txt, with flat per-PC, per-function and per-address-range histograms.
+    void WriteProfile(const std::string& base_path) const;
+
+private:
+    struct Frame {
+        u32 entry;
+        u32 return_addr;
+    };
+
+    static constexpr std::size_t max_depth = 128;
+    static constexpr u32 halted_leaf = 0xFFFF'FFFF;
+    static constexpr int range_shift = 8;
+
+    const int sample_period;
+    int countdown;
+
+    std::vector<Frame> stack;
+    bool pending_call = false;
+    u32 pending_return_addr = 0;
+
+    u64 total_cycles = 0;
+    u64 halted_cycles = 0;
+
+    // Keyed by the function entries on the stack, outermost first, followed by the sampled PC.
+    std::map<std::vector<u32>, u64> samples;
+    std::vector<u32> sample_key;
+
+    void PushFrame(u32 entry);
+    void TakeSample(u32 leaf);
+};
+
+} // End namespace Common
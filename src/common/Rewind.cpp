@@ -0,0 +1,220 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/Rewind.h"
+
+namespace Common {
+
+namespace {
+
+u8* WriteVarint(u8* out, std::size_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<u8>(value) | 0x80;
+        value >>= 7;
+    }
+    *out++ = static_cast<u8>(value);
+
+    return out;
+}
+
+std::size_t ReadVarint(const u8*& in) {
+    std::size_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        const u8 byte = *in++;
+        value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+} // End anonymous namespace
+
+RewindBuffer::RewindBuffer(std::size_t capacity_bytes)
+        : ring(capacity_bytes)
+        // Even an unchanged frame costs a few bytes, so bound the number of entries as well.
+        , entries(std::max<std::size_t>(capacity_bytes / 1024, 2)) {}
+
+void RewindBuffer::Push(const std::vector<u8>& state) {
+    // A run of zeros only ends a literal once it's min_zero_run long, so the encoding is never much larger than
+    // the state itself.
+    const std::size_t max_encoded_size = state.size() + state.size() / 32 + 32;
+    if (encode_buffer.size() < max_encoded_size) {
+        encode_buffer.resize(max_encoded_size);
+    }
+
+    const bool make_keyframe = num_entries == 0 || frames_since_keyframe >= keyframe_interval;
+    std::size_t size;
+    if (make_keyframe) {
+        keyframe = state;
+        frames_since_keyframe = 0;
+        size = Encode(state, nullptr, 0, encode_buffer.data());
+    } else {
+        frames_since_keyframe += 1;
+        size = Encode(state, keyframe.data(), keyframe.size(), encode_buffer.data());
+    }
+
+    if (size > ring.size()) {
+        // It's not possible to keep even a single state in the buffer.
+        Clear();
+        return;
+    }
+
+    if (write_pos + size > ring.size()) {
+        // Skip the end of the ring, dropping the oldest entries which were stored there.
+        while (num_entries != 0 && Oldest().offset >= write_pos) {
+            EvictOldest();
+        }
+        write_pos = 0;
+    }
+
+    while (num_entries != 0 && Oldest().offset >= write_pos && Oldest().offset < write_pos + size) {
+        EvictOldest();
+    }
+
+    if (num_entries == entries.size()) {
+        EvictOldest();
+    }
+
+    std::memcpy(ring.data() + write_pos, encode_buffer.data(), size);
+    num_entries += 1;
+    Newest() = {write_pos, size, make_keyframe};
+    write_pos += size;
+}
+
+bool RewindBuffer::Pop(std::vector<u8>& state) {
+    if (num_entries == 0) {
+        return false;
+    }
+
+    const Entry entry = Newest();
+    num_entries -= 1;
+    write_pos = entry.offset;
+
+    if (!entry.keyframe) {
+        Decode(ring.data() + entry.offset, entry.size, keyframe.data(), keyframe.size(), state);
+        frames_since_keyframe -= 1;
+        return true;
+    }
+
+    state = keyframe;
+
+    // The deltas before this keyframe were taken against the previous one.
+    std::size_t i = num_entries;
+    while (i != 0 && !EntryAt(i - 1).keyframe) {
+        i -= 1;
+    }
+
+    if (i == 0) {
+        // The previous keyframe has already been evicted, so the remaining deltas can't be decoded.
+        num_entries = 0;
+    } else {
+        const Entry& previous = EntryAt(i - 1);
+        Decode(ring.data() + previous.offset, previous.size, nullptr, 0, keyframe);
+        frames_since_keyframe = num_entries - i;
+    }
+
+    return true;
+}
+
+void RewindBuffer::EvictOldest() {
+    first_entry = (first_entry + 1) % entries.size();
+    num_entries -= 1;
+
+    // Deltas are useless without their keyframe.
+    while (num_entries != 0 && !Oldest().keyframe) {
+        first_entry = (first_entry + 1) % entries.size();
+        num_entries -= 1;
+    }
+}
+
+void RewindBuffer::Clear() {
+    first_entry = 0;
+    num_entries = 0;
+    write_pos = 0;
+    frames_since_keyframe = 0;
+}
+
+// The encoded data is a sequence of (zero run length, literal length, literal bytes) tokens, describing the XOR of
+// the state with the reference state. Bytes past the end of the reference are XORed with zero.
+std::size_t RewindBuffer::Encode(const std::vector<u8>& state, const u8* reference, std::size_t reference_size,
+                                 u8* out) {
+    const u8* const start = out;
+    const std::size_t size = state.size();
+    const std::size_t common_size = std::min(size, reference_size);
+    auto Xor = [&](std::size_t j) { return static_cast<u8>(state[j] ^ ((j < reference_size) ? reference[j] : 0)); };
+
+    std::size_t i = 0;
+    while (i < size) {
+        const std::size_t zeros_start = i;
+        // Unchanged memory is skipped eight bytes at a time.
+        while (i + 8 <= common_size && std::memcmp(&state[i], reference + i, 8) == 0) {
+            i += 8;
+        }
+        while (i < size && Xor(i) == 0) {
+            ++i;
+        }
+
+        const std::size_t literal_start = i;
+        std::size_t literal_end = i;
+        std::size_t zero_count = 0;
+        while (i < size) {
+            if (Xor(i) != 0) {
+                zero_count = 0;
+                literal_end = ++i;
+            } else if (++zero_count == min_zero_run) {
+                break;
+            } else {
+                ++i;
+            }
+        }
+        i = literal_end;
+
+        out = WriteVarint(out, literal_start - zeros_start);
+        out = WriteVarint(out, literal_end - literal_start);
+        for (std::size_t j = literal_start; j < literal_end; ++j) {
+            *out++ = Xor(j);
+        }
+    }
+
+    return out - start;
+}
+
+void RewindBuffer::Decode(const u8* in, std::size_t size, const u8* reference, std::size_t reference_size,
+                          std::vector<u8>& state) {
+    const u8* const end = in + size;
+    std::size_t i = 0;
+    while (in < end) {
+        const std::size_t zeros = ReadVarint(in);
+        const std::size_t literals = ReadVarint(in);
+
+        state.resize(std::max(state.size(), i + zeros + literals));
+        for (const std::size_t zeros_end = i + zeros; i < zeros_end; ++i) {
+            state[i] = (i < reference_size) ? reference[i] : 0;
+        }
+        for (const std::size_t literals_end = i + literals; i < literals_end; ++i) {
+            state[i] = *in++ ^ ((i < reference_size) ? reference[i] : 0);
+        }
+    }
+
+    state.resize(i);
+}
+
+} // End namespace Common
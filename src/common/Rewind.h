@@ -0,0 +1,77 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Keeps the most recent save states in a fixed amount of memory, so emulation can be stepped backwards one frame
+// at a time. Every keyframe_interval frames a full state is stored; the states in between are stored as the XOR
+// of the state with its keyframe. Consecutive frames differ in very few bytes, so the XOR is mostly long runs of
+// zeros, which are run-length encoded. The oldest states are discarded once the buffer is full.
+//
+// Nothing is allocated after the first few frames, as long as the size of the states doesn't change.
+class RewindBuffer {
+public:
+    explicit RewindBuffer(std::size_t capacity_bytes);
+
+    void Push(const std::vector<u8>& state);
+    // Restores the most recently pushed state and removes it from the buffer. Returns false if the buffer is empty.
+    bool Pop(std::vector<u8>& state);
+
+private:
+    struct Entry {
+        std::size_t offset;
+        std::size_t size;
+        bool keyframe;
+    };
+
+    static constexpr int keyframe_interval = 60;
+    // Shorter runs of zeros are kept inside literals, since they would cost more to encode separately.
+    static constexpr std::size_t min_zero_run = 4;
+
+    std::vector<u8> ring;
+    std::size_t write_pos = 0;
+
+    // Entries are kept in a circular array, oldest first.
+    std::vector<Entry> entries;
+    std::size_t first_entry = 0;
+    std::size_t num_entries = 0;
+
+    // The decoded keyframe which the newest deltas were taken against.
+    std::vector<u8> keyframe;
+    int frames_since_keyframe = 0;
+
+    std::vector<u8> encode_buffer;
+
+    Entry& EntryAt(std::size_t i) { return entries[(first_entry + i) % entries.size()]; }
+    Entry& Oldest() { return EntryAt(0); }
+    Entry& Newest() { return EntryAt(num_entries - 1); }
+    void EvictOldest();
+    void Clear();
+
+    static std::size_t Encode(const std::vector<u8>& state, const u8* reference, std::size_t reference_size,
+                              u8* out);
+    static void Decode(const u8* in, std::size_t size, const u8* reference, std::size_t reference_size,
+                       std::vector<u8>& state);
+};
+
+} // End namespace Common
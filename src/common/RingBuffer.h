@@ -0,0 +1,92 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// A lock-free ring buffer for one producer thread and one consumer thread, such as the emulation thread and an
+// audio callback. Each position is only written by one side, so plain acquire/release ordering is enough. The
+// capacity is rounded up to a power of two, and one slot is always left empty to tell a full buffer from an empty one.
+template<typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(std::size_t min_capacity) : buffer(RoundUpToPowerOfTwo(min_capacity + 1)) {}
+
+    // Called from the producer. Returns the number of elements written, which is less than count when full.
+    std::size_t Push(const T* data, std::size_t count) {
+        const std::size_t write = write_pos.load(std::memory_order_relaxed);
+        const std::size_t read = read_pos.load(std::memory_order_acquire);
+        const std::size_t free_space = (read - write - 1) & Mask();
+        if (count > free_space) {
+            count = free_space;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            buffer[(write + i) & Mask()] = data[i];
+        }
+        write_pos.store((write + count) & Mask(), std::memory_order_release);
+
+        return count;
+    }
+
+    // Called from the consumer. Returns the number of elements read, which is less than count when empty.
+    std::size_t Pop(T* data, std::size_t count) {
+        const std::size_t read = read_pos.load(std::memory_order_relaxed);
+        const std::size_t write = write_pos.load(std::memory_order_acquire);
+        const std::size_t available = (write - read) & Mask();
+        if (count > available) {
+            count = available;
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            data[i] = buffer[(read + i) & Mask()];
+        }
+        read_pos.store((read + count) & Mask(), std::memory_order_release);
+
+        return count;
+    }
+
+    // Safe to call from either side, although the result may be stale by the time it's used.
+    std::size_t Size() const {
+        return (write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire)) & Mask();
+    }
+
+    std::size_t Capacity() const { return buffer.size() - 1; }
+
+private:
+    std::vector<T> buffer;
+    std::atomic<std::size_t> write_pos{0};
+    std::atomic<std::size_t> read_pos{0};
+
+    std::size_t Mask() const { return buffer.size() - 1; }
+
+    static std::size_t RoundUpToPowerOfTwo(std::size_t value) {
+        std::size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+};
+
+} // End namespace Common
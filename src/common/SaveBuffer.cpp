@@ -0,0 +1,117 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdexcept>
+#include <utility>
+#include <fmt/format.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CHROMA_MMAP
+#endif
+
+#include "common/SaveBuffer.h"
+
+namespace Common {
+
+SharedFileMapping::~SharedFileMapping() {
+    Unmap();
+}
+
+SharedFileMapping::SharedFileMapping(SharedFileMapping&& other) noexcept
+        : data(std::exchange(other.data, nullptr))
+        , size(std::exchange(other.size, 0)) {}
+
+SharedFileMapping& SharedFileMapping::operator=(SharedFileMapping&& other) noexcept {
+    if (this != &other) {
+        Unmap();
+
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+    }
+
+    return *this;
+}
+
+bool SharedFileMapping::Supported() {
+#ifdef CHROMA_MMAP
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::size_t SharedFileMapping::Map(const std::string& filename, std::size_t num_bytes) {
+    Unmap();
+
+    if (num_bytes == 0) {
+        return 0;
+    }
+
+#ifdef CHROMA_MMAP
+    const int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        throw std::runtime_error(fmt::format("Could not open save file {}.", filename));
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1
+            || (static_cast<std::size_t>(file_stat.st_size) < num_bytes && ftruncate(fd, num_bytes) == -1)) {
+        close(fd);
+        throw std::runtime_error(fmt::format("Could not resize save file {}.", filename));
+    }
+
+    void* view = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error(fmt::format("Could not map save file {}.", filename));
+    }
+
+    data = static_cast<u8*>(view);
+    size = num_bytes;
+
+    return std::min(static_cast<std::size_t>(file_stat.st_size), num_bytes);
+#else
+    throw std::runtime_error(fmt::format("Could not map save file {}.", filename));
+#endif
+}
+
+void SharedFileMapping::Sync() {
+#ifdef CHROMA_MMAP
+    if (data != nullptr) {
+        msync(data, size, MS_ASYNC);
+    }
+#endif
+}
+
+void SharedFileMapping::Unmap() {
+#ifdef CHROMA_MMAP
+    if (data != nullptr) {
+        msync(data, size, MS_SYNC);
+        munmap(data, size);
+    }
+#endif
+
+    data = nullptr;
+    size = 0;
+}
+
+} // End namespace Common
@@ -0,0 +1,124 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// A read-write MAP_SHARED mapping of the start of a file. Writes to the mapping are written back to the file by the
+// OS, so its contents survive the emulator crashing without any copying or extra threads.
+class SharedFileMapping {
+public:
+    SharedFileMapping() = default;
+    ~SharedFileMapping();
+
+    SharedFileMapping(const SharedFileMapping&) = delete;
+    SharedFileMapping& operator=(const SharedFileMapping&) = delete;
+    SharedFileMapping(SharedFileMapping&& other) noexcept;
+    SharedFileMapping& operator=(SharedFileMapping&& other) noexcept;
+
+    static bool Supported();
+
+    // Maps the first num_bytes of the file, creating it or extending it with zeroes if it is too short. The file is
+    // never shrunk, so a bad save state can't truncate a save. Returns how many of the mapped bytes were already in
+    // the file. Throws if the file can't be mapped.
+    std::size_t Map(const std::string& filename, std::size_t num_bytes);
+    // Starts writing back any modified pages. Called at frame boundaries.
+    void Sync();
+
+    u8* Data() const { return data; }
+    std::size_t Size() const { return size; }
+
+private:
+    u8* data = nullptr;
+    std::size_t size = 0;
+
+    void Unmap();
+};
+
+// Battery-backed save memory. By default this is an ordinary buffer which the owner loads from and writes to the
+// save file, but where the platform supports it the buffer can instead be the save file itself.
+template<typename T>
+class SaveBuffer {
+public:
+    SaveBuffer() = default;
+    explicit SaveBuffer(std::vector<T> contents) : storage(std::move(contents)) {}
+
+    // From the next resize onwards, the buffer maps the given file instead of holding its own copy. Returns false
+    // if the platform can't map files, in which case the buffer stays in memory.
+    bool BackWithFile(const std::string& filename) {
+        if (!SharedFileMapping::Supported()) {
+            return false;
+        }
+
+        path = filename;
+        return true;
+    }
+    bool FileBacked() const { return !path.empty(); }
+
+    // As with std::vector, existing elements are kept and new elements are set to value. When file backed, the
+    // existing elements are whatever is already in the file.
+    void resize(std::size_t count, T value = T{}) {
+        if (!FileBacked()) {
+            storage.resize(count, value);
+            return;
+        }
+
+        if (count == size()) {
+            // Loading a save state resizes to the current size, which shouldn't remap the file.
+            return;
+        }
+
+        const std::size_t old_count = mapping.Map(path, count * sizeof(T)) / sizeof(T);
+        std::fill(begin() + std::min(old_count, count), end(), value);
+    }
+
+    void Sync() {
+        if (FileBacked()) {
+            mapping.Sync();
+        }
+    }
+
+    T* data() { return FileBacked() ? reinterpret_cast<T*>(mapping.Data()) : storage.data(); }
+    const T* data() const { return FileBacked() ? reinterpret_cast<const T*>(mapping.Data()) : storage.data(); }
+    std::size_t size() const { return FileBacked() ? mapping.Size() / sizeof(T) : storage.size(); }
+    bool empty() const { return size() == 0; }
+
+    T& operator[](std::size_t index) { return data()[index]; }
+    const T& operator[](std::size_t index) const { return data()[index]; }
+
+    T* begin() { return data(); }
+    T* end() { return data() + size(); }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+    const T* cbegin() const { return begin(); }
+    const T* cend() const { return end(); }
+
+private:
+    std::vector<T> storage;
+    std::string path;
+    SharedFileMapping mapping;
+};
+
+} // End namespace Common
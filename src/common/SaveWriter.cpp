@@ -0,0 +1,157 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <fmt/format.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define CHROMA_FSYNC
+#endif
+
+#include "common/SaveWriter.h"
+
+namespace Common {
+
+SaveWriter::SaveWriter(const std::string& _save_path)
+        : save_path(_save_path) {
+    if (!save_path.empty()) {
+        writer = std::thread{&SaveWriter::WriterLoop, this};
+    }
+}
+
+SaveWriter::~SaveWriter() {
+    if (!writer.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{pending_mutex};
+        quit = true;
+    }
+
+    work_available.notify_one();
+    writer.join();
+}
+
+void SaveWriter::SetWritten(std::vector<u8> contents) {
+    std::lock_guard<std::mutex> lock{pending_mutex};
+    on_disk = std::move(contents);
+    has_on_disk = true;
+}
+
+void SaveWriter::Submit(std::vector<u8> snapshot) {
+    if (!writer.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{pending_mutex};
+        pending = std::move(snapshot);
+        has_pending = true;
+    }
+
+    work_available.notify_one();
+}
+
+void SaveWriter::WriterLoop() {
+    std::vector<u8> snapshot;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{pending_mutex};
+            work_available.wait(lock, [this] { return quit || has_pending; });
+
+            if (!has_pending) {
+                // Quitting, and everything submitted has been written.
+                return;
+            }
+
+            if (has_on_disk) {
+                written.swap(on_disk);
+                written_valid = true;
+                has_on_disk = false;
+            }
+
+            snapshot.swap(pending);
+            has_pending = false;
+        }
+
+        if (!Changed(snapshot)) {
+            continue;
+        }
+
+        if (WriteAtomically(snapshot)) {
+            written.swap(snapshot);
+            written_valid = true;
+        } else {
+            fmt::print("Error: could not write save file {} to disk.\n", save_path);
+        }
+    }
+}
+
+bool SaveWriter::Changed(const std::vector<u8>& snapshot) const {
+    if (!written_valid || snapshot.size() != written.size()) {
+        return true;
+    }
+
+    for (std::size_t offset = 0; offset < snapshot.size(); offset += page_size) {
+        const std::size_t length = std::min(page_size, snapshot.size() - offset);
+        if (!std::equal(snapshot.cbegin() + offset, snapshot.cbegin() + offset + length, written.cbegin() + offset)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool SaveWriter::WriteAtomically(const std::vector<u8>& snapshot) const {
+    const std::string temp_path = save_path + ".tmp";
+
+    std::FILE* temp_file = std::fopen(temp_path.c_str(), "wb");
+    if (temp_file == nullptr) {
+        return false;
+    }
+
+    bool success = std::fwrite(snapshot.data(), 1, snapshot.size(), temp_file) == snapshot.size();
+    success = std::fflush(temp_file) == 0 && success;
+#ifdef CHROMA_FSYNC
+    // Make sure the data has reached the disk before the rename makes it the save file.
+    success = fsync(fileno(temp_file)) == 0 && success;
+#endif
+    success = std::fclose(temp_file) == 0 && success;
+
+    if (!success) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    if (std::rename(temp_path.c_str(), save_path.c_str()) != 0) {
+        // Renaming over an existing file fails on Windows. The old save is lost if we crash right here, but the
+        // new one is still complete in the temporary file.
+        std::remove(save_path.c_str());
+        if (std::rename(temp_path.c_str(), save_path.c_str()) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // End namespace Common
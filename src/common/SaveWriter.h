@@ -0,0 +1,71 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Writes battery saves to disk on a background thread, so the emulation thread only ever copies the save data.
+// A snapshot submitted while another is still waiting replaces it, so bursts of writes are coalesced into one.
+// Each file is written in full to a temporary file which is then renamed over the save, so a crash at any point
+// leaves either the old or the new save on disk, never a mix of the two.
+// With an empty path, every snapshot is discarded and no thread is started, for instances which mustn't touch the
+// save file, such as clones.
+class SaveWriter {
+public:
+    explicit SaveWriter(const std::string& _save_path);
+    // Writes the last submitted snapshot, if it hasn't been written yet.
+    ~SaveWriter();
+
+    // Records what's already on disk, so an unchanged snapshot isn't written again.
+    void SetWritten(std::vector<u8> contents);
+    void Submit(std::vector<u8> snapshot);
+
+private:
+    // Snapshots are compared against the last write a page at a time, which finds changes in a large save quickly.
+    static constexpr std::size_t page_size = 0x1000;
+
+    const std::string save_path;
+
+    std::vector<u8> pending;
+    bool has_pending = false;
+    std::vector<u8> on_disk;
+    bool has_on_disk = false;
+    bool quit = false;
+    std::mutex pending_mutex;
+    std::condition_variable work_available;
+
+    // Only accessed by the writer thread.
+    std::vector<u8> written;
+    bool written_valid = false;
+
+    std::thread writer;
+
+    void WriterLoop();
+    bool Changed(const std::vector<u8>& snapshot) const;
+    bool WriteAtomically(const std::vector<u8>& snapshot) const;
+};
+
+} // End namespace Common
@@ -14,37 +14,162 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <array>
 #include <fstream>
 
 #include "common/Screenshot.h"
 
 namespace Common {
 
+namespace {
+
+// Scales a 5-bit channel to 8 bits, rounding down like (c * 255) / 31.
+const std::array<u8, 32> expand5 = [] {
+    std::array<u8, 32> table{};
+    for (unsigned int c = 0; c < table.size(); ++c) {
+        table[c] = (c * 255) / 31;
+    }
+    return table;
+}();
+
+const std::array<u32, 256> crc_table = [] {
+    std::array<u32, 256> table{};
+    for (u32 n = 0; n < table.size(); ++n) {
+        u32 c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? (0xEDB8'8320 ^ (c >> 1)) : (c >> 1);
+        }
+        table[n] = c;
+    }
+    return table;
+}();
+
+u32 Crc32(const u8* data, std::size_t length, u32 crc = 0) {
+    crc = ~crc;
+    for (std::size_t i = 0; i < length; ++i) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void PushBackBE32(std::vector<u8>& buffer, u32 value) {
+    buffer.push_back(value >> 24);
+    buffer.push_back(value >> 16);
+    buffer.push_back(value >> 8);
+    buffer.push_back(value);
+}
+
+void WritePNGChunk(std::ofstream& file, const char* type, const std::vector<u8>& contents) {
+    std::vector<u8> chunk;
+    chunk.reserve(contents.size() + 12);
+    PushBackBE32(chunk, contents.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), contents.cbegin(), contents.cend());
+    // The CRC covers the type and the contents, but not the length.
+    PushBackBE32(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+
+    file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+} // End anonymous namespace
+
 void WritePPMFile(const std::vector<u8>& buffer, const std::string& filename, int width, int height) {
-    std::ofstream output_image(filename);
+    std::ofstream output_image(filename, std::ios::binary);
 
     output_image << "P6\n";
     output_image << width << " " << height << "\n";
     output_image << 255 << "\n";
-    output_image.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * 3);
+    output_image.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
 }
 
-std::vector<u8> BGR5ToRGB8(const std::vector<u16>& bgr5_buffer) {
-    std::vector<u8> rgb8_buffer;
+void WritePNGFile(const std::vector<u8>& buffer, const std::string& filename, int width, int height) {
+    std::ofstream output_image(filename, std::ios::binary);
+
+    static constexpr u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    output_image.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<u8> header;
+    PushBackBE32(header, width);
+    PushBackBE32(header, height);
+    // 8 bits per channel, truecolour, default compression and filtering, not interlaced.
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    WritePNGChunk(output_image, "IHDR", header);
+
+    // Each row starts with its filter type, which is always none.
+    const std::size_t row_bytes = width * 3;
+    std::vector<u8> rows;
+    rows.reserve((row_bytes + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        rows.push_back(0);
+        rows.insert(rows.end(), buffer.cbegin() + y * row_bytes, buffer.cbegin() + (y + 1) * row_bytes);
+    }
+
+    // A zlib stream made of stored deflate blocks, which hold at most 64KB each.
+    constexpr std::size_t max_block_size = 0xFFFF;
+    std::vector<u8> image_data{0x78, 0x01};
+    image_data.reserve(rows.size() + rows.size() / max_block_size * 5 + 11);
+    u32 adler_a = 1, adler_b = 0;
+    for (std::size_t offset = 0; offset < rows.size() || offset == 0; offset += max_block_size) {
+        const std::size_t length = std::min(max_block_size, rows.size() - offset);
+        const bool final_block = offset + length == rows.size();
+        image_data.insert(image_data.end(), {static_cast<u8>(final_block), static_cast<u8>(length),
+                                             static_cast<u8>(length >> 8), static_cast<u8>(~length),
+                                             static_cast<u8>(~length >> 8)});
+        image_data.insert(image_data.end(), rows.cbegin() + offset, rows.cbegin() + offset + length);
+
+        for (std::size_t i = offset; i < offset + length; ++i) {
+            adler_a = (adler_a + rows[i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+    PushBackBE32(image_data, (adler_b << 16) | adler_a);
+    WritePNGChunk(output_image, "IDAT", image_data);
+
+    WritePNGChunk(output_image, "IEND", {});
+}
+
+void BGR5ToRGB8(const std::vector<u16>& bgr5_buffer, std::vector<u8>& rgb8_buffer) {
+    rgb8_buffer.resize(bgr5_buffer.size() * 3);
+
+    u8* dest = rgb8_buffer.data();
     for (const u16 c : bgr5_buffer) {
-        u8 blue = (c & 0x7C00) >> 10;
-        blue = (blue * 255) / 31;
-        u8 green = (c & 0x03E0) >> 5;
-        green = (green * 255) / 31;
-        u8 red = (c & 0x001F);
-        red = (red * 255) / 31;
+        dest[0] = expand5[c & 0x1F];
+        dest[1] = expand5[(c >> 5) & 0x1F];
+        dest[2] = expand5[(c >> 10) & 0x1F];
+        dest += 3;
+    }
+}
 
-        rgb8_buffer.push_back(red);
-        rgb8_buffer.push_back(green);
-        rgb8_buffer.push_back(blue);
+void BGR5ToRGBA8(const std::vector<u16>& bgr5_buffer, std::vector<u8>& rgba8_buffer) {
+    rgba8_buffer.resize(bgr5_buffer.size() * 4);
+
+    u8* dest = rgba8_buffer.data();
+    for (const u16 c : bgr5_buffer) {
+        dest[0] = expand5[c & 0x1F];
+        dest[1] = expand5[(c >> 5) & 0x1F];
+        dest[2] = expand5[(c >> 10) & 0x1F];
+        dest[3] = 0xFF;
+        dest += 4;
     }
+}
 
+std::vector<u8> BGR5ToRGB8(const std::vector<u16>& bgr5_buffer) {
+    std::vector<u8> rgb8_buffer;
+    BGR5ToRGB8(bgr5_buffer, rgb8_buffer);
     return rgb8_buffer;
 }
 
+u64 HashFrameBuffer(const std::vector<u16>& frame_buffer) {
+    u64 hash = 0xCBF2'9CE4'8422'2325;
+    for (const u16 c : frame_buffer) {
+        for (const u8 byte : {static_cast<u8>(c), static_cast<u8>(c >> 8)}) {
+            hash ^= byte;
+            hash *= 0x0000'0100'0000'01B3;
+        }
+    }
+
+    return hash;
+}
+
 } // End namespace Common
@@ -23,7 +23,16 @@
 
 namespace Common {
 
+// Both take tightly packed 8-bit RGB pixels. PNGs are lossless, but written uncompressed so that capturing a frame
+// costs little more than copying it.
 void WritePPMFile(const std::vector<u8>& buffer, const std::string& filename, int width, int height);
+void WritePNGFile(const std::vector<u8>& buffer, const std::string& filename, int width, int height);
+
+// The converters resize the destination to fit, so reusing it for every frame doesn't allocate.
+void BGR5ToRGB8(const std::vector<u16>& bgr5_buffer, std::vector<u8>& rgb8_buffer);
+void BGR5ToRGBA8(const std::vector<u16>& bgr5_buffer, std::vector<u8>& rgba8_buffer);
 std::vector<u8> BGR5ToRGB8(const std::vector<u16>& bgr5_buffer);
+// 64-bit FNV-1a hash of the frame buffer contents.
+u64 HashFrameBuffer(const std::vector<u16>& frame_buffer);
 
 } // End namespace Common
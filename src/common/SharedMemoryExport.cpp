@@ -0,0 +1,159 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define CHROMA_SHM
+#endif
+
+#include "common/SharedMemoryExport.h"
+
+namespace Common {
+
+// The other process maps the same atomics, so they can't be implemented with a lock local to this one.
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory atomics must be lock-free.");
+
+constexpr u32 SharedMemoryExport::magic;
+constexpr u32 SharedMemoryExport::version;
+constexpr std::size_t SharedMemoryExport::max_regions;
+
+namespace {
+
+// Keeps each slot on its own cache lines, so the slot being written doesn't slow down reads of the other.
+constexpr std::size_t CacheLineAlign(std::size_t size) { return (size + 63) & ~std::size_t{63}; }
+
+} // End anonymous namespace
+
+bool SharedMemoryExport::Buttons(u32& buttons) const {
+    if (layout->input_enabled.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    buttons = layout->input_buttons.load(std::memory_order_relaxed);
+    return true;
+}
+
+void SharedMemoryExport::Publish(const std::vector<u16>& frame, std::initializer_list<Region> regions) {
+    // Write to the slot readers aren't being pointed to.
+    const u32 slot = layout->latest_slot.load(std::memory_order_relaxed) ^ 1;
+    u8* slot_base = segment + layout->slot_offset + slot * layout->slot_size;
+    auto& header = *reinterpret_cast<SlotHeader*>(slot_base);
+
+    const u64 sequence = header.sequence.load(std::memory_order_relaxed);
+    header.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    u8* dest = slot_base + sizeof(SlotHeader);
+    std::memcpy(dest, frame.data(), std::min(frame.size() * sizeof(u16), frame_bytes));
+    dest += frame_bytes;
+
+    auto size = sizes.cbegin();
+    for (const auto& region : regions) {
+        if (size == sizes.cend()) {
+            break;
+        }
+        std::memcpy(dest, region.data, std::min(region.size, *size));
+        dest += *size++;
+    }
+
+    header.frame_number = frame_number++;
+    header.sequence.store(sequence + 2, std::memory_order_release);
+    layout->latest_slot.store(slot, std::memory_order_release);
+}
+
+#ifdef CHROMA_SHM
+
+SharedMemoryExport::SharedMemoryExport(const std::string& name, int width, int height,
+                                       const std::vector<std::size_t>& region_sizes)
+        : shm_name((name.front() == '/') ? name : "/" + name)
+        , frame_bytes(width * height * sizeof(u16))
+        , sizes(region_sizes) {
+    if (sizes.size() > max_regions) {
+        throw std::runtime_error("Too many shared memory regions.");
+    }
+
+    std::size_t slot_size = sizeof(SlotHeader) + frame_bytes;
+    for (const auto size : sizes) {
+        slot_size += size;
+    }
+    slot_size = CacheLineAlign(slot_size);
+    const std::size_t slot_offset = CacheLineAlign(sizeof(Layout));
+    segment_size = slot_offset + 2 * slot_size;
+
+    const int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to create shared memory segment " + shm_name + ".");
+    }
+
+    if (ftruncate(fd, segment_size) == -1) {
+        close(fd);
+        shm_unlink(shm_name.c_str());
+        throw std::runtime_error("Failed to resize shared memory segment " + shm_name + ".");
+    }
+
+    void* mapping = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(shm_name.c_str());
+        throw std::runtime_error("Failed to map shared memory segment " + shm_name + ".");
+    }
+
+    // A new segment is zero-filled, so every slot starts with an even sequence.
+    segment = static_cast<u8*>(mapping);
+    layout = new (segment) Layout{};
+    for (u32 slot = 0; slot < 2; ++slot) {
+        new (segment + slot_offset + slot * slot_size) SlotHeader{};
+    }
+
+    layout->width = width;
+    layout->height = height;
+    layout->num_regions = static_cast<u32>(sizes.size());
+    std::copy(sizes.cbegin(), sizes.cend(), layout->region_sizes.begin());
+    layout->slot_offset = static_cast<u32>(slot_offset);
+    layout->slot_size = static_cast<u32>(slot_size);
+    layout->latest_slot.store(1, std::memory_order_relaxed);
+    layout->version = version;
+    // Readers check the magic last, so they never see a half-initialised layout.
+    std::atomic_thread_fence(std::memory_order_release);
+    layout->magic = magic;
+}
+
+SharedMemoryExport::~SharedMemoryExport() {
+    munmap(segment, segment_size);
+    shm_unlink(shm_name.c_str());
+}
+
+#else
+
+SharedMemoryExport::SharedMemoryExport(const std::string&, int, int, const std::vector<std::size_t>&)
+        : frame_bytes(0) {
+    throw std::runtime_error("Shared memory export isn't supported on this platform.");
+}
+
+SharedMemoryExport::~SharedMemoryExport() = default;
+
+#endif
+
+} // End namespace Common
@@ -0,0 +1,98 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+// Publishes every finished frame, along with some of the guest's RAM, in a POSIX shared memory segment, so that
+// other processes (bots, trainers, overlays) can read them without copying them through a pipe or socket. The other
+// process can also take over the buttons. Only available on Unix-like platforms.
+//
+// The segment (/dev/shm/<name> on Linux) starts with a Layout, followed by two slots which frames are written to in
+// turn. Each slot holds a SlotHeader, then the frame as width * height BGR555 pixels, then each region in order. A
+// slot's sequence is odd while it's being written. To read a frame, read latest_slot, then that slot's sequence,
+// then the data, and keep the data if the sequence is even and still the same.
+class SharedMemoryExport {
+public:
+    static constexpr u32 magic = 0x4D48'5343; // "CSHM"
+    static constexpr u32 version = 1;
+    static constexpr std::size_t max_regions = 8;
+
+    struct Layout {
+        u32 magic;
+        u32 version;
+        u32 width;
+        u32 height;
+        u32 num_regions;
+        std::array<u32, max_regions> region_sizes;
+        // Both from the start of the segment.
+        u32 slot_offset;
+        u32 slot_size;
+
+        std::atomic<u32> latest_slot;
+        // Written by the other process. While input_enabled is non-zero, input_buttons are held in place of the
+        // frontend's buttons, in the same bit order as movies use.
+        std::atomic<u32> input_enabled;
+        std::atomic<u32> input_buttons;
+    };
+
+    struct SlotHeader {
+        std::atomic<u64> sequence;
+        u64 frame_number;
+    };
+
+    struct Region {
+        const void* data;
+        std::size_t size;
+    };
+
+    template<typename Container>
+    static Region View(const Container& region) { return {region.data(), region.size() * sizeof(*region.data())}; }
+
+    // The regions passed to every Publish call must have the sizes given here.
+    SharedMemoryExport(const std::string& name, int width, int height, const std::vector<std::size_t>& region_sizes);
+    ~SharedMemoryExport();
+
+    SharedMemoryExport(const SharedMemoryExport&) = delete;
+    SharedMemoryExport& operator=(const SharedMemoryExport&) = delete;
+
+    void Publish(const std::vector<u16>& frame, std::initializer_list<Region> regions);
+    // Returns true, with the buttons held, if the other process has taken over input.
+    bool Buttons(u32& buttons) const;
+
+private:
+    std::string shm_name;
+    std::size_t segment_size = 0;
+    u8* segment = nullptr;
+    Layout* layout = nullptr;
+
+    std::size_t frame_bytes;
+    std::vector<std::size_t> sizes;
+    u64 frame_number = 0;
+};
+
+} // End namespace Common
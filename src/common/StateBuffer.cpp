@@ -0,0 +1,81 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdexcept>
+#include <string>
+
+#include "common/StateBuffer.h"
+
+namespace Common {
+
+void StateBuffer::BeginChunk(const char* tag, u16 version) {
+    std::array<u8, 4> saved_tag;
+    std::memcpy(saved_tag.data(), tag, saved_tag.size());
+    SyncBytes(saved_tag.data(), saved_tag.size());
+
+    u16 saved_version = version;
+    SyncInteger(saved_version);
+
+    u32 length = 0;
+    if (!loading) {
+        chunk_stack.push_back(data.size());
+    }
+    SyncInteger(length);
+
+    if (loading) {
+        if (std::memcmp(saved_tag.data(), tag, saved_tag.size()) != 0) {
+            throw std::runtime_error("Save state is missing the " + std::string(tag, 4) + " chunk.");
+        }
+
+        if (saved_version != version) {
+            throw std::runtime_error("Save state " + std::string(tag, 4) + " chunk has version "
+                                     + std::to_string(saved_version) + ", expected " + std::to_string(version) + ".");
+        }
+
+        if (length > ChunkLimit() - read_pos) {
+            throw std::runtime_error("Save state is truncated.");
+        }
+
+        chunk_stack.push_back(read_pos + length);
+    }
+}
+
+void StateBuffer::EndChunk() {
+    const std::size_t chunk_offset = chunk_stack.back();
+    chunk_stack.pop_back();
+
+    if (loading) {
+        read_pos = chunk_offset;
+    } else {
+        // Patch the length field now that the size of the chunk is known.
+        const u32 length = data.size() - (chunk_offset + sizeof(u32));
+        for (std::size_t i = 0; i < sizeof(u32); ++i) {
+            data[chunk_offset + i] = static_cast<u8>(length >> (8 * i));
+        }
+    }
+}
+
+const u8* StateBuffer::Read(std::size_t num_bytes) {
+    if (num_bytes > ChunkLimit() - read_pos) {
+        throw std::runtime_error("Save state is truncated.");
+    }
+
+    const u8* bytes = data.data() + read_pos;
+    read_pos += num_bytes;
+    return bytes;
+}
+
+} // End namespace Common
@@ -0,0 +1,217 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "common/CommonTypes.h"
+#include "common/SaveBuffer.h"
+
+namespace Common {
+
+// Save states are a single contiguous little-endian buffer made of tagged chunks. Each component has one
+// Serialize(StateBuffer&) function which is used for both saving and loading, so the two can't get out of step.
+class StateBuffer {
+public:
+    // An empty buffer to save a state into.
+    StateBuffer() = default;
+    // A buffer to load a previously saved state from.
+    explicit StateBuffer(std::vector<u8> saved_data) : data(std::move(saved_data)), loading(true) {}
+
+    bool Loading() const { return loading; }
+    const std::vector<u8>& Data() const { return data; }
+    std::vector<u8>& Data() { return data; }
+
+    // Reuse the buffer for another save or load, keeping its storage, so that states can be taken every frame
+    // without allocating. BeginLoad reads whatever is currently in Data().
+    void BeginSave() {
+        data.clear();
+        Reset(false);
+    }
+    void BeginLoad() { Reset(true); }
+
+    // Chunks begin with a four character tag, a version, and the length of the chunk. When loading, the tag and
+    // version must match what the running emulator would have saved.
+    void BeginChunk(const char* tag, u16 version);
+    void EndChunk();
+
+    template <typename T>
+    std::enable_if_t<std::is_integral<T>::value> Sync(T& value) { SyncInteger(value); }
+
+    template <typename T>
+    std::enable_if_t<std::is_enum<T>::value> Sync(T& value) {
+        auto raw = static_cast<std::underlying_type_t<T>>(value);
+        SyncInteger(raw);
+        value = static_cast<T>(raw);
+    }
+
+    void Sync(bool& value) {
+        u8 raw = value;
+        SyncInteger(raw);
+        value = raw != 0;
+    }
+
+    void Sync(double& value) {
+        u64 raw;
+        std::memcpy(&raw, &value, sizeof(raw));
+        SyncInteger(raw);
+        std::memcpy(&value, &raw, sizeof(raw));
+    }
+
+    void Sync(float& value) {
+        u32 raw;
+        std::memcpy(&raw, &value, sizeof(raw));
+        SyncInteger(raw);
+        std::memcpy(&value, &raw, sizeof(raw));
+    }
+
+    template <typename T, std::size_t N>
+    std::enable_if_t<!std::is_integral<T>::value || std::is_same<T, bool>::value> Sync(std::array<T, N>& values) {
+        for (auto& value : values) {
+            Sync(value);
+        }
+    }
+
+    // Integer arrays such as OAM and wave RAM are saved every frame, so they're converted in one pass as well.
+    template <typename T, std::size_t N>
+    std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value> Sync(std::array<T, N>& values) {
+        SyncIntegers(values.data(), N);
+    }
+
+    // Vectors are prefixed with their length, and are resized to the saved length when loading.
+    template <typename T>
+    std::enable_if_t<!std::is_integral<T>::value> Sync(std::vector<T>& values) {
+        SyncLength(values);
+        for (auto& value : values) {
+            Sync(value);
+        }
+    }
+
+    // Memory regions are the bulk of a state, so integer vectors are converted in one pass.
+    template <typename T>
+    std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value> Sync(std::vector<T>& values) {
+        SyncLength(values);
+        SyncIntegers(values.data(), values.size());
+    }
+
+    // Save memory is stored the same way as an integer vector, whether or not it's backed by the save file.
+    template <typename T>
+    std::enable_if_t<std::is_integral<T>::value> Sync(SaveBuffer<T>& values) {
+        SyncLength(values);
+        SyncIntegers(values.data(), values.size());
+    }
+
+    void Sync(std::vector<u8>& values) {
+        SyncLength(values);
+        SyncBytes(values.data(), values.size());
+    }
+
+    // A block of raw bytes whose length is fixed, so it isn't stored.
+    void SyncBytes(u8* bytes, std::size_t num_bytes) {
+        if (loading) {
+            std::memcpy(bytes, Read(num_bytes), num_bytes);
+        } else {
+            std::memcpy(Append(num_bytes), bytes, num_bytes);
+        }
+    }
+
+private:
+    std::vector<u8> data;
+    bool loading = false;
+    std::size_t read_pos = 0;
+
+    // Offsets of the length fields of the open chunks when saving, or the end offsets of the open chunks when
+    // loading.
+    std::vector<std::size_t> chunk_stack;
+
+    u8* Append(std::size_t num_bytes) {
+        data.resize(data.size() + num_bytes);
+        return data.data() + data.size() - num_bytes;
+    }
+
+    const u8* Read(std::size_t num_bytes);
+    void Reset(bool load) {
+        loading = load;
+        read_pos = 0;
+        chunk_stack.clear();
+    }
+    std::size_t ChunkLimit() const { return chunk_stack.empty() ? data.size() : chunk_stack.back(); }
+
+    template <typename T>
+    void SyncInteger(T& value) {
+        using Unsigned = std::make_unsigned_t<T>;
+        if (loading) {
+            const u8* bytes = Read(sizeof(T));
+            Unsigned raw = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i) {
+                raw |= static_cast<Unsigned>(bytes[i]) << (8 * i);
+            }
+            value = static_cast<T>(raw);
+        } else {
+            u8* bytes = Append(sizeof(T));
+            const Unsigned raw = static_cast<Unsigned>(value);
+            for (std::size_t i = 0; i < sizeof(T); ++i) {
+                bytes[i] = static_cast<u8>(raw >> (8 * i));
+            }
+        }
+    }
+
+    template <typename T>
+    void SyncIntegers(T* values, std::size_t count) {
+        using Unsigned = std::make_unsigned_t<T>;
+        if (loading) {
+            const u8* bytes = Read(count * sizeof(T));
+            for (std::size_t n = 0; n < count; ++n) {
+                Unsigned raw = 0;
+                for (std::size_t i = 0; i < sizeof(T); ++i) {
+                    raw |= static_cast<Unsigned>(bytes[i]) << (8 * i);
+                }
+                values[n] = static_cast<T>(raw);
+                bytes += sizeof(T);
+            }
+        } else {
+            u8* bytes = Append(count * sizeof(T));
+            for (std::size_t n = 0; n < count; ++n) {
+                const Unsigned raw = static_cast<Unsigned>(values[n]);
+                for (std::size_t i = 0; i < sizeof(T); ++i) {
+                    bytes[i] = static_cast<u8>(raw >> (8 * i));
+                }
+                bytes += sizeof(T);
+            }
+        }
+    }
+
+    template <typename Container>
+    void SyncLength(Container& values) {
+        u32 length = values.size();
+        SyncInteger(length);
+        if (loading) {
+            // Every element takes at least one byte, so a longer length can only come from a corrupt state.
+            if (length > ChunkLimit() - read_pos) {
+                throw std::runtime_error("Save state is truncated.");
+            }
+
+            values.resize(length);
+        }
+    }
+};
+
+} // End namespace Common
@@ -0,0 +1,100 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <exception>
+#include <thread>
+#include <utility>
+
+#include "common/ThreadPool.h"
+
+namespace Common {
+
+WorkStealingPool::WorkStealingPool(unsigned int num_threads) {
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        queues.emplace_back(std::make_unique<WorkQueue>());
+    }
+}
+
+void WorkStealingPool::Run(std::vector<Task> tasks) {
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+        queues[i % queues.size()]->tasks.emplace_back(std::move(tasks[i]));
+    }
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    // The calling thread acts as the first worker.
+    std::vector<std::thread> threads;
+    for (std::size_t id = 1; id < queues.size(); ++id) {
+        threads.emplace_back(&WorkStealingPool::WorkerLoop, this, id, std::ref(error), std::ref(error_mutex));
+    }
+    WorkerLoop(0, error, error_mutex);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void WorkStealingPool::WorkerLoop(std::size_t id, std::exception_ptr& error, std::mutex& error_mutex) {
+    Task task;
+    // No tasks are added while running, so a worker is finished once there is nothing left to steal.
+    while (PopTask(id, task) || StealTask(id, task)) {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock{error_mutex};
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+}
+
+bool WorkStealingPool::PopTask(std::size_t id, Task& task) {
+    WorkQueue& queue = *queues[id];
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    if (queue.tasks.empty()) {
+        return false;
+    }
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::StealTask(std::size_t thief_id, Task& task) {
+    for (std::size_t i = 1; i < queues.size(); ++i) {
+        WorkQueue& victim = *queues[(thief_id + i) % queues.size()];
+        std::lock_guard<std::mutex> lock{victim.mutex};
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // End namespace Common
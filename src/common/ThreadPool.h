@@ -0,0 +1,54 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Common {
+
+// Runs a fixed set of independent tasks across several threads. Tasks are dealt out to each worker's queue in turn.
+// A worker takes tasks from the back of its own queue, and once that is empty, steals from the front of the other
+// workers' queues, so threads which draw short tasks don't sit idle while others still have a backlog.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(unsigned int num_threads);
+
+    // Returns once every task has finished. If any task throws, the first exception is rethrown after the rest
+    // have run.
+    void Run(std::vector<Task> tasks);
+
+private:
+    struct WorkQueue {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    void WorkerLoop(std::size_t id, std::exception_ptr& error, std::mutex& error_mutex);
+    bool PopTask(std::size_t id, Task& task);
+    bool StealTask(std::size_t thief_id, Task& task);
+};
+
+} // End namespace Common
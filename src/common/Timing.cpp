@@ -0,0 +1,89 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "common/Timing.h"
+
+#ifdef CHROMA_TIMING
+
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <fmt/format.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Common {
+
+std::array<std::atomic<u64>, static_cast<std::size_t>(Subsystem::NumSubsystems)> subsystem_ticks{};
+
+thread_local TimingScope* TimingScope::current = nullptr;
+
+u64 ReadTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void EndTimingFrame() {
+    using namespace std::chrono;
+
+    static std::ofstream timing_file;
+    static u64 frame_num = 0;
+    static u64 frame_start_ticks = 0;
+    static steady_clock::time_point frame_start_time;
+
+    const u64 now_ticks = ReadTicks();
+    const auto now_time = steady_clock::now();
+
+    if (!timing_file.is_open()) {
+        timing_file.open("timing.csv");
+        if (!timing_file) {
+            throw std::runtime_error("Error when attempting to open ./timing.csv for writing.");
+        }
+        timing_file << "frame,frame_us,cpu_us,lcd_us,bg_us,sprites_us,dma_us,timers_us,audio_us,present_us\n";
+
+        // Anything counted before the first frame boundary belongs to startup, not to a frame.
+        for (auto& ticks : subsystem_ticks) {
+            ticks.store(0, std::memory_order_relaxed);
+        }
+    } else {
+        // The tick rate isn't known up front when using the TSC, so calibrate it against the clock every frame.
+        const double frame_us = duration<double, std::micro>(now_time - frame_start_time).count();
+        const u64 frame_ticks = now_ticks - frame_start_ticks;
+        const double us_per_tick = (frame_ticks) ? frame_us / frame_ticks : 0.0;
+
+        fmt::MemoryWriter row;
+        row.write("{},{:.1f}", frame_num, frame_us);
+        for (auto& ticks : subsystem_ticks) {
+            row.write(",{:.1f}", ticks.exchange(0, std::memory_order_relaxed) * us_per_tick);
+        }
+        timing_file << row.str() << "\n";
+        ++frame_num;
+    }
+
+    frame_start_ticks = now_ticks;
+    frame_start_time = now_time;
+}
+
+} // End namespace Common
+
+#endif
@@ -0,0 +1,86 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+// Host-side timing counters for each emulated subsystem, for finding which one is responsible when frame times
+// spike. They only exist in builds configured with -DCHROMA_TIMING=ON; otherwise the macros expand to nothing.
+// Each frame is appended to timing.csv as the microseconds spent in each subsystem.
+
+#ifdef CHROMA_TIMING
+
+#include <array>
+#include <atomic>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+enum class Subsystem {Cpu, Lcd, Bg, Sprites, Dma, Timers, Audio, Present, NumSubsystems};
+
+u64 ReadTicks();
+
+extern std::array<std::atomic<u64>, static_cast<std::size_t>(Subsystem::NumSubsystems)> subsystem_ticks;
+
+// Times are exclusive: a scope nested inside another (e.g. a DMA started by a CPU write) is subtracted from the
+// enclosing one, so each subsystem's time in a frame is its own.
+class TimingScope {
+public:
+    explicit TimingScope(Subsystem _subsystem)
+            : subsystem(_subsystem)
+            , parent(current)
+            , start(ReadTicks()) {
+        current = this;
+    }
+
+    ~TimingScope() {
+        const u64 elapsed = ReadTicks() - start;
+        subsystem_ticks[static_cast<std::size_t>(subsystem)].fetch_add(elapsed - child_ticks,
+                                                                       std::memory_order_relaxed);
+        if (parent) {
+            parent->child_ticks += elapsed;
+        }
+        current = parent;
+    }
+
+    TimingScope(const TimingScope&) = delete;
+    TimingScope& operator=(const TimingScope&) = delete;
+
+private:
+    const Subsystem subsystem;
+    TimingScope* const parent;
+    const u64 start;
+    u64 child_ticks = 0;
+
+    // Scopes nest separately on each thread, so the render thread's scopes don't steal from the CPU's.
+    static thread_local TimingScope* current;
+};
+
+// Converts this frame's ticks to microseconds and writes them out, then starts counting the next frame.
+void EndTimingFrame();
+
+} // End namespace Common
+
+#define TIMING_SCOPE(subsystem) const Common::TimingScope timing_scope{Common::Subsystem::subsystem}
+#define TIMING_END_FRAME() Common::EndTimingFrame()
+
+#else
+
+#define TIMING_SCOPE(subsystem)
+#define TIMING_END_FRAME()
+
+#endif
@@ -0,0 +1,92 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "common/Trace.h"
+
+namespace Common {
+
+TraceWriter::TraceWriter(const std::string& filename, TraceSystem system, std::size_t _record_size)
+        : record_size(_record_size)
+        , ring(ring_records * record_size)
+        , trace_file(filename, std::ios_base::binary) {
+    if (!trace_file) {
+        throw std::runtime_error("Error when attempting to open " + filename + " for writing.");
+    }
+
+    TraceHeader header;
+    header.system = system;
+    header.record_size = record_size;
+    trace_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    writer = std::thread{&TraceWriter::WriterLoop, this};
+}
+
+TraceWriter::~TraceWriter() {
+    finished.store(true, std::memory_order_release);
+    writer.join();
+}
+
+void TraceWriter::WriterLoop() {
+    while (true) {
+        // Check for shutdown before looking at the head, so records pushed just before shutdown are still written.
+        const bool shutting_down = finished.load(std::memory_order_acquire);
+        const u64 write_index = head.load(std::memory_order_acquire);
+        u64 read_index = tail.load(std::memory_order_relaxed);
+
+        if (read_index == write_index) {
+            if (shutting_down) {
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        while (read_index != write_index) {
+            // Write up to the end of the ring in one go, then wrap around.
+            const u64 slot = read_index & (ring_records - 1);
+            const u64 count = std::min(write_index - read_index, ring_records - slot);
+            trace_file.write(reinterpret_cast<const char*>(ring.data() + slot * record_size), count * record_size);
+            read_index += count;
+        }
+
+        tail.store(read_index, std::memory_order_release);
+    }
+
+    trace_file.flush();
+}
+
+TraceHeader ReadTraceHeader(std::ifstream& trace_file) {
+    TraceHeader header;
+    trace_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (!trace_file || header.magic != TraceHeader::trace_magic) {
+        throw std::runtime_error("Not a Chroma trace file.");
+    }
+
+    if (header.version != TraceHeader::trace_version) {
+        throw std::runtime_error("Unsupported trace version " + std::to_string(header.version) + ".");
+    }
+
+    return header;
+}
+
+} // End namespace Common
@@ -0,0 +1,91 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+#include "common/CommonTypes.h"
+
+namespace Common {
+
+enum class TraceSystem : u8 {Gb, Gba};
+
+// Binary traces start with this header, followed by fixed-size records written in host byte order. The magic is
+// stored as a u32 so a trace read back on a machine with the other byte order is rejected rather than misparsed.
+struct TraceHeader {
+    static constexpr u32 trace_magic = 0x5452'4843; // "CHRT"
+    static constexpr u16 trace_version = 1;
+
+    u32 magic = trace_magic;
+    u16 version = trace_version;
+    TraceSystem system;
+    u8 reserved = 0;
+    u32 record_size;
+};
+
+// Appends fixed-size trace records to a single-producer single-consumer ring, which a background thread drains to
+// disk in large contiguous writes. The emulation thread only ever copies a record into the ring; it waits only if
+// the writer falls a whole ring behind, so no records are ever dropped.
+class TraceWriter {
+public:
+    TraceWriter(const std::string& filename, TraceSystem system, std::size_t _record_size);
+    ~TraceWriter();
+
+    template<typename Record>
+    void Push(const Record& record) {
+        static_assert(std::is_trivially_copyable<Record>::value, "Trace records are copied as raw bytes.");
+        PushBytes(&record);
+    }
+
+private:
+    // Must be a power of two.
+    static constexpr u64 ring_records = 0x1'0000;
+
+    const std::size_t record_size;
+    std::vector<u8> ring;
+    std::ofstream trace_file;
+
+    // Both indices only ever increase; the slot is the index modulo the ring size.
+    std::atomic<u64> head{0};
+    std::atomic<u64> tail{0};
+    std::atomic<bool> finished{false};
+    std::thread writer;
+
+    void PushBytes(const void* record) {
+        const u64 write_index = head.load(std::memory_order_relaxed);
+        while (write_index - tail.load(std::memory_order_acquire) == ring_records) {
+            std::this_thread::yield();
+        }
+
+        std::memcpy(ring.data() + (write_index & (ring_records - 1)) * record_size, record, record_size);
+        head.store(write_index + 1, std::memory_order_release);
+    }
+
+    void WriterLoop();
+};
+
+// Reads and validates the header of a trace file, leaving the stream at the first record.
+TraceHeader ReadTraceHeader(std::ifstream& trace_file);
+
+} // End namespace Common
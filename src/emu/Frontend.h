@@ -0,0 +1,97 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+#include "common/CommonTypes.h"
+
+namespace Emu {
+
+enum class InputEvent {Quit,
+                       Pause,
+                       LogLevel,
+                       Fullscreen,
+                       Screenshot,
+                       LcdDebug,
+                       HideWindow,
+                       ShowWindow,
+                       FrameAdvance,
+                       SaveState,
+                       LoadState,
+                       Rewind,
+                       Turbo,
+                       Up,
+                       Left,
+                       Down,
+                       Right,
+                       A,
+                       B,
+                       L,
+                       R,
+                       Start,
+                       Select};
+
+// On adaptive sync displays, a late frame is presented immediately instead of waiting for the next refresh.
+enum class VSyncMode {On, Off, Adaptive};
+
+// Everything a core needs from the outside world: somewhere to present frames and play audio, and a source of
+// input events. The cores only talk to this interface, so they never touch global state like SDL does, and any
+// number of them can run in one process.
+class Frontend {
+public:
+    virtual ~Frontend() = default;
+
+    virtual void RenderFrame(const u16* fb_ptr) = 0;
+    virtual void ToggleFullscreen() {}
+
+    virtual void PushBackAudio(const std::array<s16, 1600>& sample_buffer) = 0;
+    virtual void UnpauseAudio() {}
+    virtual void PauseAudio() {}
+    // For the metrics export: how many times audio playback ran out of samples, and how many stereo frames are
+    // waiting to be played.
+    virtual u64 AudioUnderruns() const { return 0; }
+    virtual std::size_t QueuedAudioFrames() const { return 0; }
+
+    // Input callbacks are invoked from PollEvents, on the thread running the core.
+    void RegisterCallback(InputEvent event, std::function<void(bool)> callback) {
+        input_callbacks[event] = std::move(callback);
+    }
+    virtual void PollEvents() = 0;
+
+    // Pacing error is how late frames started on average, compared to when they were due.
+    virtual void UpdateFrameTimes(float /*avg_frame_time*/, float /*max_frame_time*/, float /*pacing_error*/) {}
+    virtual void Delay(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+protected:
+    std::unordered_map<InputEvent, std::function<void(bool)>> input_callbacks;
+};
+
+// Discards all video and audio, and never produces any input.
+class NullFrontend : public Frontend {
+public:
+    void RenderFrame(const u16*) override {}
+    void PushBackAudio(const std::array<s16, 1600>&) override {}
+    void PollEvents() override {}
+};
+
+} // End namespace Emu
@@ -18,11 +18,11 @@
 #include <stdexcept>
 #include <algorithm>
 #include <fmt/format.h>
-#include <sys/stat.h>
 
 #include "gb/memory/CartridgeHeader.h"
 #include "gba/memory/Memory.h"
 #include "emu/ParseOptions.h"
+#include "common/FileUtils.h"
 
 namespace Emu {
 
@@ -54,12 +54,64 @@ void DisplayHelp() {
     fmt::print("  -h                           display help\n");
     fmt::print("  -m [dmg, cgb, agb]           specify device to emulate\n");
     fmt::print("  -l [trace, regs, timer, lcd] specify log level (default: none)\n");
+    fmt::print("  -l binary                    write a compact binary trace to trace.bin, which can be\n");
+    fmt::print("                                   decoded with chroma_trace\n");
     fmt::print("  -s [1-15]                    specify resolution scale (default: 2)\n");
     fmt::print("  -f                           activate fullscreen mode\n");
-    fmt::print("  --filter [iir, nearest]      choose audio filtering method (default: iir)\n");
-    fmt::print("                                   IIR (slow, better quality)\n");
+    fmt::print("  --filter [iir, polyphase,    choose audio filtering method (default: iir)\n");
+    fmt::print("            blip, nearest]         IIR (slow, better quality)\n");
+    fmt::print("                                   polyphase FIR (fast, better quality)\n");
+    fmt::print("                                   band-limited steps, only running the APU when a channel\n");
+    fmt::print("                                       changes (fastest, better quality)\n");
     fmt::print("                                   nearest-neighbour (fast, lesser quality)\n");
+    fmt::print("  --vsync [on, off, adaptive]  wait for the display's refresh before presenting a frame\n");
+    fmt::print("                                   (default: on), adaptive presents late frames immediately\n");
+    fmt::print("  --turbo [2-16]               speed multiplier while Tab is held (default: 4)\n");
+    fmt::print("  --spin-window [0-16000]      microseconds before each frame is due to stop sleeping and spin,\n");
+    fmt::print("                                   for more even pacing at the cost of CPU time (default: 1500)\n");
+    fmt::print("  --unthrottled                run as fast as possible, without audio\n");
+    fmt::print("  --accuracy [accurate, fast]  fast drops the GBA prefetch buffer model, GB OAM DMA bus conflicts\n");
+    fmt::print("                                   and IF write timing, for batch runs (default: accurate)\n");
     fmt::print("  --multicart                  emulate this game using an MBC1M\n");
+    fmt::print("  --block-cache                run GBA code from a cache of pre-decoded blocks\n");
+    fmt::print("                                   (faster, hardware only synced between blocks)\n");
+    fmt::print("  --render-thread              draw scanlines on a separate thread\n");
+    fmt::print("  --hle-bios                   run the slowest GBA BIOS calls natively (faster, approximate\n");
+    fmt::print("                                   timing, and approximate BgAffineSet/ObjAffineSet results)\n");
+    fmt::print("  --skip-bios                  start GBA games at the cartridge entry point, without running\n");
+    fmt::print("                                   the BIOS boot animation\n");
+    fmt::print("  --rewind [1-4096]            keep up to this many MB of states to rewind through\n");
+    fmt::print("  --render-skip [1-60]         only draw every Nth frame, to speed up fast-forwarding\n");
+    fmt::print("  --run-ahead [1-4]            emulate N frames ahead every frame and show the last one, to hide\n");
+    fmt::print("                                   the game's own input lag (costs N+1x the emulation time)\n");
+    fmt::print("  --idle-skip                  fast-forward through loops which poll memory without side effects\n");
+    fmt::print("  --mmap-saves                 map battery saves straight into memory, so the OS writes them\n");
+    fmt::print("                                   back as the game saves (not for GB carts with an RTC)\n");
+    fmt::print("  --huge-pages                 back GBA memory with a huge page where the OS allows it\n");
+    fmt::print("  --profile                    sample the guest PC and call stack, and write profile.txt and\n");
+    fmt::print("                                   profile.folded (flamegraph input) on exit\n");
+    fmt::print("  --capture [png, raw]         write every frame to <rom>_NNNNNN.png, or to <rom>.rgb as raw\n");
+    fmt::print("                                   RGB24 video for ffmpeg\n");
+    fmt::print("  --headless --frames <N>      run N frames unthrottled without a window or audio, then print\n");
+    fmt::print("                                   the frame times and a hash of the final frame\n");
+    fmt::print("  --record <file>              record the buttons held on every frame to a movie file\n");
+    fmt::print("  --record-from-state          load the save state first, and start the movie from it\n");
+    fmt::print("  --play <file>                play back a movie, stopping if it desyncs from the recording\n");
+    fmt::print("                                   (headless without --frames runs for the movie's length)\n");
+    fmt::print("  --link-listen <port>         wait for another instance to connect a link cable over UDP\n");
+    fmt::print("  --link-connect <host:port>   connect a link cable to an instance listening at this address\n");
+    fmt::print("  --shm <name>                 publish frames and work RAM to a shared memory segment, which\n");
+    fmt::print("                                   other processes can also send buttons through\n");
+    fmt::print("  --break <addr,...>           pause after any frame which executes one of these hex addresses\n");
+    fmt::print("  --watch-read <addr,...>      pause after any frame which reads one of these hex addresses\n");
+    fmt::print("  --watch-write <addr,...>     pause after any frame which writes one of these hex addresses\n");
+    fmt::print("  --cheats <file>              apply the Game Genie, GameShark or Action Replay codes in this\n");
+    fmt::print("                                   file, one per line (lines starting with # are ignored)\n");
+    fmt::print("  --metrics <file>             periodically write frame time percentiles, emulation speed, and\n");
+    fmt::print("                                   CPU and audio counters to this file\n");
+    fmt::print("  --metrics-format [json,      write metrics as JSON or Prometheus text (default: prometheus)\n");
+    fmt::print("                   prometheus]\n");
+    fmt::print("  --metrics-interval [1-3600]  seconds between metrics dumps (default: 10)\n");
 }
 
 Gb::Console GetGameBoyType(const std::vector<std::string>& tokens) {
@@ -91,6 +143,8 @@ LogLevel GetLogLevel(const std::vector<std::string>& tokens) {
             return LogLevel::Timer;
         } else if (log_string == "lcd") {
             return LogLevel::LCD;
+        } else if (log_string == "binary") {
+            return LogLevel::Binary;
         } else {
             // Passing the "-l" argument by itself defaults to instruction trace logging.
             return LogLevel::Trace;
@@ -116,28 +170,287 @@ unsigned int GetPixelScale(const std::vector<std::string>& tokens) {
     }
 }
 
-bool GetFilterEnable(const std::vector<std::string>& tokens) {
+AudioFilter GetAudioFilter(const std::vector<std::string>& tokens) {
     const std::string filter_string = Emu::GetOptionParam(tokens, "--filter");
     if (!filter_string.empty()) {
         if (filter_string == "iir") {
-            return true;
+            return AudioFilter::Iir;
+        } else if (filter_string == "polyphase") {
+            return AudioFilter::Polyphase;
+        } else if (filter_string == "blip") {
+            return AudioFilter::BandLimited;
         } else if (filter_string == "nearest") {
-            return false;
+            return AudioFilter::Nearest;
         } else {
             throw std::invalid_argument("Invalid filter method specified: " + filter_string);
         }
     } else {
         // If no filter specified, default to using IIR filter.
-        return true;
+        return AudioFilter::Iir;
     }
 }
 
-std::size_t GetFileSize(std::ifstream& filestream) {
-    filestream.seekg(0, std::ios_base::end);
-    auto size = filestream.tellg();
-    filestream.seekg(0, std::ios_base::beg);
+Accuracy GetAccuracy(const std::vector<std::string>& tokens) {
+    const std::string accuracy_string = Emu::GetOptionParam(tokens, "--accuracy");
+    if (accuracy_string.empty() || accuracy_string == "accurate") {
+        return Accuracy::Accurate;
+    } else if (accuracy_string == "fast") {
+        return Accuracy::Fast;
+    } else {
+        throw std::invalid_argument("Invalid accuracy profile specified: " + accuracy_string);
+    }
+}
+
+Common::FrameCapture::Format GetCaptureFormat(const std::vector<std::string>& tokens) {
+    const std::string format_string = Emu::GetOptionParam(tokens, "--capture");
+    if (format_string == "png") {
+        return Common::FrameCapture::Format::Png;
+    } else if (format_string == "raw") {
+        return Common::FrameCapture::Format::Raw;
+    } else {
+        throw std::invalid_argument("Invalid capture format specified: " + format_string);
+    }
+}
+
+VSyncMode GetVSyncMode(const std::vector<std::string>& tokens) {
+    const std::string vsync_string = Emu::GetOptionParam(tokens, "--vsync");
+    if (!vsync_string.empty()) {
+        if (vsync_string == "on") {
+            return VSyncMode::On;
+        } else if (vsync_string == "off") {
+            return VSyncMode::Off;
+        } else if (vsync_string == "adaptive") {
+            return VSyncMode::Adaptive;
+        } else {
+            throw std::invalid_argument("Invalid vsync mode specified: " + vsync_string);
+        }
+    } else {
+        return VSyncMode::On;
+    }
+}
+
+std::size_t GetRewindCapacity(const std::vector<std::string>& tokens) {
+    const std::string rewind_string = Emu::GetOptionParam(tokens, "--rewind");
+    if (!rewind_string.empty()) {
+        int megabytes;
+        try {
+            megabytes = std::stoi(rewind_string);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid rewind buffer size specified: " + rewind_string);
+        }
+
+        if (megabytes < 1 || megabytes > 4096) {
+            throw std::invalid_argument("Invalid rewind buffer size specified: " + rewind_string);
+        }
+
+        return static_cast<std::size_t>(megabytes) * 1024 * 1024;
+    } else {
+        // Rewinding is disabled by default, since saving a state every frame isn't free.
+        return 0;
+    }
+}
+
+int GetRenderSkip(const std::vector<std::string>& tokens) {
+    const std::string skip_string = Emu::GetOptionParam(tokens, "--render-skip");
+    if (!skip_string.empty()) {
+        int n;
+        try {
+            n = std::stoi(skip_string);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid render skip specified: " + skip_string);
+        }
+
+        if (n < 1 || n > 60) {
+            throw std::invalid_argument("Invalid render skip specified: " + skip_string);
+        }
+
+        return n;
+    } else {
+        // Draw every frame.
+        return 1;
+    }
+}
+
+int GetRunAhead(const std::vector<std::string>& tokens) {
+    const std::string frames_string = Emu::GetOptionParam(tokens, "--run-ahead");
+    if (!frames_string.empty()) {
+        int frames;
+        try {
+            frames = std::stoi(frames_string);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid run-ahead specified: " + frames_string);
+        }
+
+        if (frames < 1 || frames > 4) {
+            throw std::invalid_argument("Invalid run-ahead specified: " + frames_string);
+        }
+
+        return frames;
+    } else {
+        // Run-ahead disabled.
+        return 0;
+    }
+}
+
+std::vector<BreakpointOption> GetBreakpoints(const std::vector<std::string>& tokens) {
+    std::vector<BreakpointOption> breakpoints;
+    auto parse_list = [&tokens, &breakpoints](const std::string& option, Common::Breakpoints::Type type) {
+        const std::string list_string = Emu::GetOptionParam(tokens, option);
+        std::size_t start = 0;
+        while (start < list_string.size()) {
+            const std::size_t end = std::min(list_string.find(',', start), list_string.size());
+            const std::string addr_string = list_string.substr(start, end - start);
+            try {
+                std::size_t parsed;
+                const unsigned long addr = std::stoul(addr_string, &parsed, 16);
+                if (parsed != addr_string.size() || addr > 0xFFFF'FFFF) {
+                    throw std::invalid_argument("");
+                }
+                breakpoints.push_back({static_cast<u32>(addr), type});
+            } catch (const std::logic_error&) {
+                throw std::invalid_argument("Invalid address specified for " + option + ": " + addr_string);
+            }
+            start = end + 1;
+        }
+    };
+
+    parse_list("--break", Common::Breakpoints::Exec);
+    parse_list("--watch-read", Common::Breakpoints::Read);
+    parse_list("--watch-write", Common::Breakpoints::Write);
+
+    return breakpoints;
+}
+
+Common::FramePacer::Settings GetPacingSettings(const std::vector<std::string>& tokens) {
+    Common::FramePacer::Settings settings;
+
+    const std::string turbo_string = Emu::GetOptionParam(tokens, "--turbo");
+    if (!turbo_string.empty()) {
+        try {
+            settings.turbo_multiplier = std::stoi(turbo_string);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid turbo multiplier specified: " + turbo_string);
+        }
+
+        if (settings.turbo_multiplier < 2 || settings.turbo_multiplier > 16) {
+            throw std::invalid_argument("Invalid turbo multiplier specified: " + turbo_string);
+        }
+    }
+
+    const std::string spin_string = Emu::GetOptionParam(tokens, "--spin-window");
+    if (!spin_string.empty()) {
+        int spin_us;
+        try {
+            spin_us = std::stoi(spin_string);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid spin window specified: " + spin_string);
+        }
+
+        if (spin_us < 0 || spin_us > 16000) {
+            throw std::invalid_argument("Invalid spin window specified: " + spin_string);
+        }
+
+        settings.spin_window = std::chrono::microseconds{spin_us};
+    }
 
-    return size;
+    settings.unthrottled = Emu::ContainsOption(tokens, "--unthrottled");
+
+    return settings;
+}
+
+Common::Metrics::Settings GetMetricsSettings(const std::vector<std::string>& tokens) {
+    Common::Metrics::Settings settings;
+
+    settings.path = Emu::GetOptionParam(tokens, "--metrics");
+
+    const std::string format_string = Emu::GetOptionParam(tokens, "--metrics-format");
+    if (!format_string.empty()) {
+        if (format_string == "prometheus") {
+            settings.format = Common::Metrics::Format::Prometheus;
+        } else if (format_string == "json") {
+            settings.format = Common::Metrics::Format::Json;
+        } else {
+            throw std::invalid_argument("Invalid metrics format specified: " + format_string);
+        }
+    }
+
+    const std::string interval_string = Emu::GetOptionParam(tokens, "--metrics-interval");
+    if (!interval_string.empty()) {
+        int interval;
+        try {
+            interval = std::stoi(interval_string);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid metrics interval specified: " + interval_string);
+        }
+
+        if (interval < 1 || interval > 3600) {
+            throw std::invalid_argument("Invalid metrics interval specified: " + interval_string);
+        }
+
+        settings.interval = std::chrono::seconds{interval};
+    }
+
+    return settings;
+}
+
+LinkOptions GetLinkOptions(const std::vector<std::string>& tokens) {
+    const std::string listen_string = Emu::GetOptionParam(tokens, "--link-listen");
+    const std::string connect_string = Emu::GetOptionParam(tokens, "--link-connect");
+    if (!listen_string.empty() && !connect_string.empty()) {
+        throw std::invalid_argument("Can't both listen for and connect a link cable.");
+    }
+
+    const auto parse_port = [](const std::string& port_string) {
+        int port;
+        try {
+            port = std::stoi(port_string);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Invalid link cable port specified: " + port_string);
+        }
+
+        if (port < 1 || port > 0xFFFF) {
+            throw std::invalid_argument("Invalid link cable port specified: " + port_string);
+        }
+
+        return static_cast<u16>(port);
+    };
+
+    LinkOptions link_options;
+    if (!listen_string.empty()) {
+        link_options.listen = true;
+        link_options.port = parse_port(listen_string);
+    } else if (!connect_string.empty()) {
+        const auto colon = connect_string.rfind(':');
+        if (colon == std::string::npos || colon == 0) {
+            throw std::invalid_argument("Link cable address must be given as host:port, not " + connect_string);
+        }
+
+        link_options.host = connect_string.substr(0, colon);
+        link_options.port = parse_port(connect_string.substr(colon + 1));
+    }
+
+    // Otherwise, no cable is attached.
+    return link_options;
+}
+
+int GetFrameCount(const std::vector<std::string>& tokens) {
+    const std::string frames_string = Emu::GetOptionParam(tokens, "--frames");
+    if (frames_string.empty()) {
+        throw std::invalid_argument("Headless mode requires the number of frames to run, given with --frames.");
+    }
+
+    int frames;
+    try {
+        frames = std::stoi(frames_string);
+    } catch (const std::logic_error&) {
+        throw std::invalid_argument("Invalid frame count specified: " + frames_string);
+    }
+
+    if (frames < 1) {
+        throw std::invalid_argument("Invalid frame count specified: " + frames_string);
+    }
+
+    return frames;
 }
 
 Gb::Console CheckRomFile(const std::string& filename) {
@@ -146,9 +459,9 @@ Gb::Console CheckRomFile(const std::string& filename) {
         throw std::runtime_error("Error when attempting to open " + filename);
     }
 
-    CheckPathIsRegularFile(filename);
+    Common::CheckPathIsRegularFile(filename);
 
-    const auto rom_size = GetFileSize(rom_file);
+    const auto rom_size = Common::GetFileSize(rom_file);
 
     if (rom_size > 0x2000000) {
         // 32MB is the largest possible GBA game.
@@ -166,7 +479,7 @@ Gb::Console CheckRomFile(const std::string& filename) {
 
     if (Gba::Memory::CheckNintendoLogo(rom_header)) {
         return Gb::Console::AGB;
-    } else if (Gb::CartridgeHeader::CheckNintendoLogo(Gb::Console::CGB, rom_header)) {
+    } else if (Gb::CartridgeHeader::CheckNintendoLogo(Gb::Console::CGB, rom_header.data())) {
         if (rom_size < 0x8000) {
             // 32KB is the smallest possible GB game.
             throw std::runtime_error("Rom size of " + std::to_string(rom_size)
@@ -182,26 +495,24 @@ Gb::Console CheckRomFile(const std::string& filename) {
 }
 
 template<typename T>
-std::vector<T> LoadRom(const std::string& filename, Gb::Console console) {
+Common::RomView<T> LoadRom(const std::string& filename, Gb::Console console) {
     std::ifstream rom_file(filename);
     if (!rom_file) {
         throw std::runtime_error("Error when attempting to open " + filename);
     }
 
-    const auto rom_size = GetFileSize(rom_file);
+    const auto rom_size = Common::GetFileSize(rom_file);
 
     // AGB ROMs vary between 1 to 32MB in size. We expand all ROMs to at least 16MB to avoid requiring a bounds
     // check before every low ROM access. This isn't an issue on CGB because only 32KB of ROM is mapped at a time.
-    const auto rom_vector_size = (console == Gb::Console::AGB) ? std::max(rom_size, 0x0100'0000ul) : rom_size;
+    // The padding is mapped as zero pages, which don't take up any memory.
+    const auto rom_view_size = (console == Gb::Console::AGB) ? std::max(rom_size, 0x0100'0000ul) : rom_size;
 
-    std::vector<T> rom_contents(rom_vector_size / sizeof(T));
-    rom_file.read(reinterpret_cast<char*>(rom_contents.data()), rom_size);
-
-    return rom_contents;
+    return Common::RomView<T>{Common::MappedFile{filename, rom_size, rom_view_size}};
 }
 
-template std::vector<u8> LoadRom<u8>(const std::string& filename, Gb::Console console);
-template std::vector<u16> LoadRom<u16>(const std::string& filename, Gb::Console console);
+template Common::RomView<u8> LoadRom<u8>(const std::string& filename, Gb::Console console);
+template Common::RomView<u16> LoadRom<u16>(const std::string& filename, Gb::Console console);
 
 std::string SaveGamePath(const std::string& rom_path) {
     std::size_t last_dot = rom_path.rfind('.');
@@ -217,7 +528,24 @@ std::string SaveGamePath(const std::string& rom_path) {
     return rom_path.substr(0, last_dot) + ".sav";
 }
 
-std::vector<u8> LoadSaveGame(const Gb::CartridgeHeader& cart_header, const std::string& save_path) {
+Common::SaveBuffer<u8> LoadSaveGame(const Gb::CartridgeHeader& cart_header, const std::string& save_path,
+                                    bool mmap_saves) {
+    // The RTC state is appended to the save file when it's written, so saves with an RTC stay in memory.
+    Common::SaveBuffer<u8> mapped_save;
+    if (cart_header.ext_ram_present && !cart_header.rtc_present && mmap_saves
+            && mapped_save.BackWithFile(save_path)) {
+        std::ifstream save_file(save_path);
+        if (save_file) {
+            Common::CheckPathIsRegularFile(save_path);
+            if (Common::GetFileSize(save_file) != cart_header.ram_size) {
+                throw std::runtime_error("Save game size does not match external RAM size given in cartridge header.");
+            }
+        }
+
+        mapped_save.resize(cart_header.ram_size);
+        return mapped_save;
+    }
+
     std::vector<u8> save_game;
     if (cart_header.ext_ram_present) {
         save_game = Emu::ReadSaveFile(save_path);
@@ -240,7 +568,7 @@ std::vector<u8> LoadSaveGame(const Gb::CartridgeHeader& cart_header, const std::
         }
     }
 
-    return save_game;
+    return Common::SaveBuffer<u8>{std::move(save_game)};
 }
 
 std::vector<u8> ReadSaveFile(const std::string& filename) {
@@ -250,9 +578,9 @@ std::vector<u8> ReadSaveFile(const std::string& filename) {
         return std::vector<u8>();
     }
 
-    CheckPathIsRegularFile(filename);
+    Common::CheckPathIsRegularFile(filename);
 
-    const auto save_size = GetFileSize(save_file);
+    const auto save_size = Common::GetFileSize(save_file);
 
     if (save_size > 0x20030) {
         throw std::runtime_error("Save game size of " + std::to_string(save_size)
@@ -265,7 +593,28 @@ std::vector<u8> ReadSaveFile(const std::string& filename) {
     return save_contents;
 }
 
-std::vector<u32> LoadGbaBios() {
+std::vector<std::string> ReadCheatFile(const std::string& filename) {
+    std::ifstream cheat_file(filename);
+    if (!cheat_file) {
+        throw std::runtime_error("Error when attempting to open " + filename);
+    }
+
+    std::vector<std::string> codes;
+    std::string line;
+    while (std::getline(cheat_file, line)) {
+        const std::size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        const std::size_t last = line.find_last_not_of(" \t\r");
+        codes.push_back(line.substr(first, last - first + 1));
+    }
+
+    return codes;
+}
+
+Common::RomView<u32> LoadGbaBios() {
     std::string bios_path = "gba_bios.bin";
     std::ifstream bios_file(bios_path);
     for (int i = 0; i < 2; ++i) {
@@ -282,30 +631,15 @@ std::vector<u32> LoadGbaBios() {
         throw std::runtime_error("Error when attempting to open gba_bios.bin");
     }
 
-    CheckPathIsRegularFile(bios_path);
+    Common::CheckPathIsRegularFile(bios_path);
 
-    const auto bios_size = GetFileSize(bios_file);
+    const auto bios_size = Common::GetFileSize(bios_file);
 
     if (bios_size != 0x4000) {
         throw std::runtime_error("GBA BIOS must be 16KB. Provided file is " + std::to_string(bios_size) + " bytes.");
     }
 
-    std::vector<u32> bios_contents(bios_size / sizeof(u32));
-    bios_file.read(reinterpret_cast<char*>(bios_contents.data()), bios_size);
-
-    return bios_contents;
-}
-
-void CheckPathIsRegularFile(const std::string& filename) {
-    // Check that the path points to a regular file.
-    struct stat stat_info;
-    if (stat(filename.c_str(), &stat_info) == 0) {
-        if (stat_info.st_mode & S_IFDIR) {
-            throw std::runtime_error("Provided path is a directory: " + filename);
-        } else if (!(stat_info.st_mode & S_IFREG)) {
-            throw std::runtime_error("Provided path is not a regular file: " + filename);
-        }
-    }
+    return Common::RomView<u32>{Common::MappedFile{bios_path, bios_size, bios_size}};
 }
 
 } // End namespace Emu
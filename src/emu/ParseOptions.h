@@ -21,7 +21,14 @@
 
 #include "common/CommonTypes.h"
 #include "common/CommonEnums.h"
+#include "common/MappedFile.h"
+#include "common/SaveBuffer.h"
+#include "common/FrameCapture.h"
+#include "common/Breakpoints.h"
+#include "common/FramePacer.h"
+#include "common/Metrics.h"
 #include "gb/core/Enums.h"
+#include "emu/Frontend.h"
 
 namespace Gb { class CartridgeHeader; }
 
@@ -35,16 +42,41 @@ void DisplayHelp();
 Gb::Console GetGameBoyType(const std::vector<std::string>& tokens);
 LogLevel GetLogLevel(const std::vector<std::string>& tokens);
 unsigned int GetPixelScale(const std::vector<std::string>& tokens);
-bool GetFilterEnable(const std::vector<std::string>& tokens);
+AudioFilter GetAudioFilter(const std::vector<std::string>& tokens);
+Accuracy GetAccuracy(const std::vector<std::string>& tokens);
+VSyncMode GetVSyncMode(const std::vector<std::string>& tokens);
+std::size_t GetRewindCapacity(const std::vector<std::string>& tokens);
+int GetFrameCount(const std::vector<std::string>& tokens);
+int GetRenderSkip(const std::vector<std::string>& tokens);
+int GetRunAhead(const std::vector<std::string>& tokens);
+Common::FramePacer::Settings GetPacingSettings(const std::vector<std::string>& tokens);
+Common::Metrics::Settings GetMetricsSettings(const std::vector<std::string>& tokens);
+
+// Where to connect a UDP link cable. With listen set, waits for the other side on port instead. A port of 0 means
+// no cable is attached.
+struct LinkOptions {
+    bool listen = false;
+    std::string host;
+    u16 port = 0;
+};
+LinkOptions GetLinkOptions(const std::vector<std::string>& tokens);
+Common::FrameCapture::Format GetCaptureFormat(const std::vector<std::string>& tokens);
+
+struct BreakpointOption {
+    u32 addr;
+    Common::Breakpoints::Type type;
+};
+std::vector<BreakpointOption> GetBreakpoints(const std::vector<std::string>& tokens);
 
-std::size_t GetFileSize(std::ifstream& filestream);
 Gb::Console CheckRomFile(const std::string& filename);
 template<typename T>
-std::vector<T> LoadRom(const std::string& filename, Gb::Console console);
+Common::RomView<T> LoadRom(const std::string& filename, Gb::Console console);
 std::string SaveGamePath(const std::string& rom_path);
-std::vector<u8> LoadSaveGame(const Gb::CartridgeHeader& cart_header, const std::string& save_path);
+Common::SaveBuffer<u8> LoadSaveGame(const Gb::CartridgeHeader& cart_header, const std::string& save_path,
+                                    bool mmap_saves);
 std::vector<u8> ReadSaveFile(const std::string& filename);
-std::vector<u32> LoadGbaBios();
-void CheckPathIsRegularFile(const std::string& filename);
+// The non-empty, non-comment lines of a cheat file, with surrounding whitespace removed.
+std::vector<std::string> ReadCheatFile(const std::string& filename);
+Common::RomView<u32> LoadGbaBios();
 
 } // End namespace Emu
@@ -14,16 +14,23 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <utility>
 #include <stdexcept>
 #include <fmt/format.h>
 
 #include "emu/SDLContext.h"
+#include "common/Timing.h"
 
 namespace Emu {
 
-SDLContext::SDLContext(int _width, int _height, unsigned int scale, bool fullscreen)
+SDLContext::SDLContext(int _width, int _height, unsigned int scale, bool fullscreen, VSyncMode _vsync)
         : width(_width)
-        , height(_height) {
+        , height(_height)
+        , vsync(_vsync) {
 
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
         throw std::runtime_error(GetSDLErrorString("Init"));
@@ -40,47 +47,38 @@ SDLContext::SDLContext(int _width, int _height, unsigned int scale, bool fullscr
         throw std::runtime_error(GetSDLErrorString("CreateWindow"));
     }
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    if (renderer == nullptr) {
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        throw std::runtime_error(GetSDLErrorString("CreateRenderer"));
+    for (auto& buffer : frame_buffers) {
+        buffer.resize(width * height);
     }
 
-    SDL_RenderSetLogicalSize(renderer, width, height);
-    SDL_RenderSetIntegerScale(renderer, SDL_TRUE);
-
-    texture = SDL_CreateTexture(renderer,
-                                SDL_PIXELFORMAT_ABGR1555,
-                                SDL_TEXTUREACCESS_STREAMING,
-                                width,
-                                height);
-    if (texture == nullptr) {
-        SDL_DestroyRenderer(renderer);
+    std::promise<std::string> init_error;
+    presenter = std::thread{&SDLContext::PresenterThread, this, std::ref(init_error)};
+    const std::string error{init_error.get_future().get()};
+    if (!error.empty()) {
+        presenter.join();
         SDL_DestroyWindow(window);
         SDL_Quit();
-        throw std::runtime_error(GetSDLErrorString("CreateTexture"));
+        throw std::runtime_error(error);
     }
 
-    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
-
     if (fullscreen) {
         SDL_ShowCursor(SDL_DISABLE);
         SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
     }
 
     SDL_AudioSpec want, have;
-    want.freq = 48000;
+    want.freq = sample_rate;
     want.format = AUDIO_S16;
     want.channels = 2;
-    want.samples = 1600;
-    want.callback = nullptr; // nullptr for using a queue instead.
+    // About 10ms, a third of the target latency.
+    want.samples = 512;
+    want.callback = AudioCallback;
+    want.userdata = this;
 
     audio_device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
 
     if (audio_device == 0) {
-        SDL_DestroyTexture(texture);
-        SDL_DestroyRenderer(renderer);
+        StopPresenter();
         SDL_DestroyWindow(window);
         SDL_Quit();
         throw std::runtime_error(GetSDLErrorString("OpenAudioDevice"));
@@ -94,20 +92,106 @@ SDLContext::~SDLContext() {
     }
 
     SDL_CloseAudioDevice(audio_device);
-    SDL_DestroyTexture(texture);
-    SDL_DestroyRenderer(renderer);
+    StopPresenter();
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
 
+void SDLContext::PresenterThread(std::promise<std::string>& init_error) {
+    // The renderer is only ever used from this thread.
+    const Uint32 vsync_flag = (vsync == VSyncMode::Off) ? 0 : SDL_RENDERER_PRESENTVSYNC;
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | vsync_flag);
+    if (renderer == nullptr) {
+        init_error.set_value(GetSDLErrorString("CreateRenderer"));
+        return;
+    }
+
+    if (vsync == VSyncMode::Adaptive && SDL_GL_SetSwapInterval(-1) != 0) {
+        // Late swap tearing isn't supported, so fall back to plain vsync.
+        SDL_GL_SetSwapInterval(1);
+    }
+
+    SDL_RenderSetLogicalSize(renderer, width, height);
+    SDL_RenderSetIntegerScale(renderer, SDL_TRUE);
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer,
+                                             SDL_PIXELFORMAT_ABGR1555,
+                                             SDL_TEXTUREACCESS_STREAMING,
+                                             width,
+                                             height);
+    if (texture == nullptr) {
+        init_error.set_value(GetSDLErrorString("CreateTexture"));
+        SDL_DestroyRenderer(renderer);
+        return;
+    }
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+    init_error.set_value("");
+
+    PresentLoop(renderer, texture);
+
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+}
+
+void SDLContext::PresentLoop(SDL_Renderer* renderer, SDL_Texture* texture) {
+    // Without new frames, the last one is presented again every so often in case the window needs redrawing.
+    constexpr auto redraw_interval = std::chrono::milliseconds(100);
+
+    while (true) {
+        bool new_frame = false;
+        {
+            std::unique_lock<std::mutex> lock{present_mutex};
+            frame_available.wait_for(lock, redraw_interval, [this] { return quit_presenter || frame_ready; });
+
+            if (quit_presenter) {
+                return;
+            }
+
+            if (frame_ready) {
+                std::swap(ready_index, display_index);
+                frame_ready = false;
+                new_frame = true;
+            }
+        }
+
+        if (new_frame) {
+            SDL_UpdateTexture(texture, nullptr, frame_buffers[display_index].data(), width * sizeof(u16));
+        }
+
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+    }
+}
+
+void SDLContext::StopPresenter() {
+    {
+        std::lock_guard<std::mutex> lock{present_mutex};
+        quit_presenter = true;
+    }
+
+    frame_available.notify_one();
+    presenter.join();
+}
+
 void SDLContext::RenderFrame(const u16* fb_ptr) noexcept {
-    SDL_LockTexture(texture, nullptr, &texture_pixels, &texture_pitch);
-    memcpy(texture_pixels, fb_ptr, width * height * sizeof(u16));
-    SDL_UnlockTexture(texture);
+    TIMING_SCOPE(Present);
+    const std::size_t num_pixels = width * height;
+    if (!last_frame.empty() && std::equal(fb_ptr, fb_ptr + num_pixels, last_frame.cbegin())) {
+        return;
+    }
+    last_frame.assign(fb_ptr, fb_ptr + num_pixels);
+
+    // Nothing else touches the write buffer, so it can be filled without holding the lock.
+    std::copy_n(fb_ptr, num_pixels, frame_buffers[write_index].begin());
+    {
+        std::lock_guard<std::mutex> lock{present_mutex};
+        std::swap(write_index, ready_index);
+        frame_ready = true;
+    }
 
-    SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-    SDL_RenderPresent(renderer);
+    frame_available.notify_one();
 }
 
 void SDLContext::ToggleFullscreen() noexcept {
@@ -128,7 +212,52 @@ void SDLContext::ToggleFullscreen() noexcept {
 }
 
 void SDLContext::PushBackAudio(const std::array<s16, 1600>& sample_buffer) noexcept {
-    SDL_QueueAudio(audio_device, sample_buffer.data(), sample_buffer.size() * sizeof(s16));
+    // Play slightly slower when the buffer is running low, and slightly faster when it's filling up.
+    const double fill = audio_ring.Size() / 2.0;
+    const double fill_error = std::max(-1.0, std::min(1.0, (fill - target_latency_frames) / target_latency_frames));
+    const double step = 1.0 + fill_error * max_rate_delta;
+
+    // Linear interpolation, where position 0 is the last frame of the previous buffer.
+    constexpr std::size_t input_frames = std::tuple_size<std::array<s16, 1600>>::value / 2;
+    const auto input = [&](std::size_t frame, std::size_t channel) {
+        return (frame == 0) ? last_input_frame[channel] : sample_buffer[(frame - 1) * 2 + channel];
+    };
+
+    resampled.clear();
+    for (; resample_pos < input_frames; resample_pos += step) {
+        const std::size_t frame = static_cast<std::size_t>(resample_pos);
+        const double frac = resample_pos - frame;
+        for (std::size_t channel = 0; channel < 2; ++channel) {
+            const double sample = input(frame, channel) + (input(frame + 1, channel) - input(frame, channel)) * frac;
+            resampled.push_back(static_cast<s16>(std::lround(sample)));
+        }
+    }
+    resample_pos -= input_frames;
+    last_input_frame = {{sample_buffer[input_frames * 2 - 2], sample_buffer[input_frames * 2 - 1]}};
+
+    // Anything which doesn't fit is dropped, which only happens if the callback stops running.
+    audio_ring.Push(resampled.data(), resampled.size());
+}
+
+void SDLContext::AudioCallback(void* userdata, Uint8* stream, int len) {
+    auto& context = *static_cast<SDLContext*>(userdata);
+    s16* out = reinterpret_cast<s16*>(stream);
+    const std::size_t samples = len / sizeof(s16);
+
+    // Pop whole frames, so the channels can't become swapped.
+    const std::size_t available = context.audio_ring.Size() & ~std::size_t{1};
+    const std::size_t popped = context.audio_ring.Pop(out, std::min(samples, available));
+    if (popped != 0) {
+        context.last_output_frame = {{out[popped - 2], out[popped - 1]}};
+    }
+    if (popped < samples) {
+        ++context.audio_underruns;
+    }
+
+    for (std::size_t i = popped; i < samples; i += 2) {
+        out[i] = context.last_output_frame[0];
+        out[i + 1] = context.last_output_frame[1];
+    }
 }
 
 void SDLContext::UnpauseAudio() noexcept {
@@ -139,13 +268,9 @@ void SDLContext::PauseAudio() noexcept {
     SDL_PauseAudioDevice(audio_device, 1);
 }
 
-void SDLContext::RegisterCallback(InputEvent event, std::function<void(bool)> callback) {
-    input_callbacks.insert({event, callback});
-}
-
-void SDLContext::UpdateFrameTimes(float avg_time_us, float max_time_us) {
-    SDL_SetWindowTitle(window, fmt::format("Chroma - avg {:0>4.1f}ms - max {:0>4.1f}ms",
-                                           avg_time_us / 1000, max_time_us / 1000).data());
+void SDLContext::UpdateFrameTimes(float avg_time_us, float max_time_us, float pacing_error_us) {
+    SDL_SetWindowTitle(window, fmt::format("Chroma - avg {:0>4.1f}ms - max {:0>4.1f}ms - pacing {:0>4.2f}ms",
+                                           avg_time_us / 1000, max_time_us / 1000, pacing_error_us / 1000).data());
 }
 
 void SDLContext::PollEvents() {
@@ -182,6 +307,12 @@ void SDLContext::PollEvents() {
             case SDLK_n:
                 input_callbacks[InputEvent::FrameAdvance](true);
                 break;
+            case SDLK_F5:
+                input_callbacks[InputEvent::SaveState](true);
+                break;
+            case SDLK_F8:
+                input_callbacks[InputEvent::LoadState](true);
+                break;
 
             case SDLK_w:
                 input_callbacks[InputEvent::Up](true);
@@ -216,6 +347,12 @@ void SDLContext::PollEvents() {
             case SDLK_u:
                 input_callbacks[InputEvent::Select](true);
                 break;
+            case SDLK_BACKSPACE:
+                input_callbacks[InputEvent::Rewind](true);
+                break;
+            case SDLK_TAB:
+                input_callbacks[InputEvent::Turbo](true);
+                break;
             default:
                 break;
             }
@@ -258,6 +395,12 @@ void SDLContext::PollEvents() {
             case SDLK_u:
                 input_callbacks[InputEvent::Select](false);
                 break;
+            case SDLK_BACKSPACE:
+                input_callbacks[InputEvent::Rewind](false);
+                break;
+            case SDLK_TAB:
+                input_callbacks[InputEvent::Turbo](false);
+                break;
             default:
                 break;
             }
@@ -18,64 +18,81 @@
 
 #include <string>
 #include <array>
-#include <unordered_map>
-#include <functional>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
 #include <SDL.h>
 
 #include "common/CommonTypes.h"
+#include "common/RingBuffer.h"
+#include "emu/Frontend.h"
 
 namespace Emu {
 
-enum class InputEvent {Quit,
-                       Pause,
-                       LogLevel,
-                       Fullscreen,
-                       Screenshot,
-                       LcdDebug,
-                       HideWindow,
-                       ShowWindow,
-                       FrameAdvance,
-                       Up,
-                       Left,
-                       Down,
-                       Right,
-                       A,
-                       B,
-                       L,
-                       R,
-                       Start,
-                       Select};
-
-class SDLContext {
+class SDLContext : public Frontend {
 public:
-    SDLContext(int _width, int _height, unsigned int scale, bool fullscreen);
-    ~SDLContext();
+    SDLContext(int _width, int _height, unsigned int scale, bool fullscreen, VSyncMode _vsync);
+    ~SDLContext() override;
 
-    void RenderFrame(const u16* fb_ptr) noexcept;
-    void ToggleFullscreen() noexcept;
+    void RenderFrame(const u16* fb_ptr) noexcept override;
+    void ToggleFullscreen() noexcept override;
 
-    void PushBackAudio(const std::array<s16, 1600>& sample_buffer) noexcept;
-    void UnpauseAudio() noexcept;
-    void PauseAudio() noexcept;
+    void PushBackAudio(const std::array<s16, 1600>& sample_buffer) noexcept override;
+    void UnpauseAudio() noexcept override;
+    void PauseAudio() noexcept override;
+    u64 AudioUnderruns() const override { return audio_underruns; }
+    std::size_t QueuedAudioFrames() const override { return audio_ring.Size() / 2; }
 
-    void RegisterCallback(InputEvent event, std::function<void(bool)> callback);
-    void PollEvents();
+    void PollEvents() override;
 
-    void UpdateFrameTimes(float avg_frame_time, float max_frame_time);
+    void UpdateFrameTimes(float avg_frame_time, float max_frame_time, float pacing_error) override;
+    void Delay(int ms) override { SDL_Delay(ms); }
 
 private:
     SDL_Window* window;
-    SDL_Renderer* renderer;
-    SDL_Texture* texture;
     SDL_AudioDeviceID audio_device;
 
     const int width;
     const int height;
-
-    int texture_pitch;
-    void* texture_pixels;
-
-    std::unordered_map<InputEvent, std::function<void(bool)>> input_callbacks;
+    const VSyncMode vsync;
+
+    // The renderer belongs to a presenter thread, so waiting for vsync never stalls emulation. Frames go through
+    // three buffers: the one RenderFrame fills, the newest finished frame, and the one on screen. The cores pace
+    // themselves, so RenderFrame never waits, and a new frame replaces one the presenter hasn't got to yet.
+    std::array<std::vector<u16>, 3> frame_buffers;
+    std::size_t write_index = 0, ready_index = 1, display_index = 2;
+    bool frame_ready = false;
+    bool quit_presenter = false;
+    std::mutex present_mutex;
+    std::condition_variable frame_available;
+    std::thread presenter;
+    // Frames which are identical to the last one, e.g. while paused, aren't uploaded again.
+    std::vector<u16> last_frame;
+
+    // Creates the renderer and reports any error through init_error before presenting frames until quit.
+    void PresenterThread(std::promise<std::string>& init_error);
+    void PresentLoop(SDL_Renderer* renderer, SDL_Texture* texture);
+    void StopPresenter();
+
+    // Audio is pulled by the SDL callback from a ring buffer which the emulation thread fills once a frame. Each
+    // frame is resampled by a ratio within max_rate_delta of 1, which is nudged to keep the buffer close to
+    // target_latency_frames of audio, so the queue neither drains nor grows when the video and audio clocks drift.
+    static constexpr int sample_rate = 48000;
+    static constexpr std::size_t target_latency_frames = sample_rate * 30 / 1000;
+    static constexpr double max_rate_delta = 0.005;
+    Common::RingBuffer<s16> audio_ring{target_latency_frames * 2 * 4};
+    double resample_pos = 0.0;
+    std::array<s16, 2> last_input_frame{};
+    std::vector<s16> resampled;
+    // Only touched by the callback, to hold the last sample through an underrun instead of clicking.
+    std::array<s16, 2> last_output_frame{};
+    // Counted by the callback, read by the emulation thread.
+    std::atomic<u64> audio_underruns{0};
+
+    static void AudioCallback(void* userdata, Uint8* stream, int len);
 
     bool FullscreenEnabled() const noexcept { return SDL_GetWindowFlags(window) & SDL_WINDOW_FULLSCREEN_DESKTOP; }
     static const std::string GetSDLErrorString(const std::string& error_function) {
@@ -15,11 +15,18 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <string>
+#include <memory>
 #include <vector>
 #include <stdexcept>
 #include <fmt/format.h>
 
 #include "common/CommonTypes.h"
+#include "common/CommonEnums.h"
+#include "common/FrameStats.h"
+#include "common/MappedFile.h"
+#include "common/Movie.h"
+#include "common/Metrics.h"
+#include "common/LinkCable.h"
 #include "gb/core/Enums.h"
 #include "gb/core/GameBoy.h"
 #include "gb/logging/Logging.h"
@@ -27,8 +34,61 @@
 #include "gba/core/Core.h"
 #include "gba/memory/Memory.h"
 #include "emu/ParseOptions.h"
+#include "emu/Frontend.h"
 #include "emu/SDLContext.h"
 
+namespace {
+
+std::unique_ptr<Emu::Frontend> CreateFrontend(int width, int height, unsigned int scale, bool fullscreen,
+                                              Emu::VSyncMode vsync, bool headless) {
+    if (headless) {
+        return std::make_unique<Emu::NullFrontend>();
+    } else {
+        return std::make_unique<Emu::SDLContext>(width, height, scale, fullscreen, vsync);
+    }
+}
+
+void PrintFrameStats(const Common::FrameStats& stats) {
+    fmt::print("{} frames in {:.3f}s ({:.1f} fps)\n", stats.frames, stats.total_seconds,
+               stats.frames / stats.total_seconds);
+    fmt::print("avg frame time {:.1f}us, max frame time {:.1f}us\n", stats.avg_frame_time_us, stats.max_frame_time_us);
+    fmt::print("framebuffer hash {:016x}\n", stats.framebuffer_hash);
+}
+
+std::string CapturePrefix(const std::string& rom_path) {
+    return rom_path.substr(0, rom_path.rfind('.'));
+}
+
+// Headless playback with no frame count given runs for the length of the movie.
+template<typename Core>
+void StartMovie(Core& core, const std::string& record_path, bool record_from_state, const std::string& play_path,
+                int& headless_frames) {
+    if (!play_path.empty()) {
+        auto movie = std::make_unique<Common::Movie>(play_path);
+        if (headless_frames == 0) {
+            headless_frames = static_cast<int>(movie->Length());
+        }
+        core.PlayMovie(std::move(movie));
+    } else if (!record_path.empty()) {
+        if (record_from_state) {
+            core.LoadState();
+        }
+        core.RecordMovie(record_path, record_from_state);
+    }
+}
+
+std::unique_ptr<Common::LinkCable> CreateLinkCable(const Emu::LinkOptions& link_options) {
+    if (link_options.port == 0) {
+        return nullptr;
+    } else if (link_options.listen) {
+        return std::make_unique<Common::UdpLinkCable>(link_options.port);
+    } else {
+        return std::make_unique<Common::UdpLinkCable>(link_options.host, link_options.port);
+    }
+}
+
+} // End anonymous namespace
+
 int main(int argc, char** argv) {
     std::vector<std::string> tokens = Emu::GetTokens(argv, argv + argc);
 
@@ -40,16 +100,79 @@ int main(int argc, char** argv) {
     Gb::Console gameboy_type;
     LogLevel log_level;
     unsigned int pixel_scale;
-    bool enable_iir;
+    AudioFilter audio_filter;
+    Accuracy accuracy;
+    Emu::VSyncMode vsync;
     bool fullscreen;
     bool multicart;
+    bool block_cache;
+    bool hle_bios;
+    bool skip_bios;
+    bool threaded_render;
+    std::size_t rewind_capacity;
+    int render_skip;
+    int run_ahead;
+    Common::FramePacer::Settings pacing;
+    bool headless;
+    int headless_frames = 0;
+    bool profile;
+    bool idle_skip;
+    bool mmap_saves;
+    bool huge_pages;
+    bool capture;
+    Common::FrameCapture::Format capture_format = Common::FrameCapture::Format::Png;
+    std::string record_path;
+    bool record_from_state;
+    std::string play_path;
+    Emu::LinkOptions link_options;
+    std::string shm_name;
+    std::vector<Emu::BreakpointOption> breakpoints;
+    std::string cheat_path;
+    Common::Metrics::Settings metrics_settings;
     try {
         gameboy_type = Emu::GetGameBoyType(tokens);
         log_level = Emu::GetLogLevel(tokens);
         pixel_scale = Emu::GetPixelScale(tokens);
-        enable_iir = Emu::GetFilterEnable(tokens);
+        audio_filter = Emu::GetAudioFilter(tokens);
+        accuracy = Emu::GetAccuracy(tokens);
+        vsync = Emu::GetVSyncMode(tokens);
         fullscreen = Emu::ContainsOption(tokens, "-f");
         multicart = Emu::ContainsOption(tokens, "--multicart");
+        block_cache = Emu::ContainsOption(tokens, "--block-cache");
+        hle_bios = Emu::ContainsOption(tokens, "--hle-bios");
+        skip_bios = Emu::ContainsOption(tokens, "--skip-bios");
+        threaded_render = Emu::ContainsOption(tokens, "--render-thread");
+        rewind_capacity = Emu::GetRewindCapacity(tokens);
+        render_skip = Emu::GetRenderSkip(tokens);
+        run_ahead = Emu::GetRunAhead(tokens);
+        pacing = Emu::GetPacingSettings(tokens);
+        profile = Emu::ContainsOption(tokens, "--profile");
+        idle_skip = Emu::ContainsOption(tokens, "--idle-skip");
+        mmap_saves = Emu::ContainsOption(tokens, "--mmap-saves");
+        huge_pages = Emu::ContainsOption(tokens, "--huge-pages");
+        capture = Emu::ContainsOption(tokens, "--capture");
+        if (capture) {
+            capture_format = Emu::GetCaptureFormat(tokens);
+        }
+        record_path = Emu::GetOptionParam(tokens, "--record");
+        record_from_state = Emu::ContainsOption(tokens, "--record-from-state");
+        play_path = Emu::GetOptionParam(tokens, "--play");
+        if (!record_path.empty() && !play_path.empty()) {
+            throw std::invalid_argument("Can't record and play back a movie at the same time.");
+        }
+        link_options = Emu::GetLinkOptions(tokens);
+        shm_name = Emu::GetOptionParam(tokens, "--shm");
+        breakpoints = Emu::GetBreakpoints(tokens);
+        cheat_path = Emu::GetOptionParam(tokens, "--cheats");
+        metrics_settings = Emu::GetMetricsSettings(tokens);
+        if (link_options.port != 0 && run_ahead != 0) {
+            // Speculative frames would send transfers to the other side which then get rolled back.
+            throw std::invalid_argument("Run-ahead can't be used with a link cable.");
+        }
+        headless = Emu::ContainsOption(tokens, "--headless");
+        if (headless && (play_path.empty() || Emu::ContainsOption(tokens, "--frames"))) {
+            headless_frames = Emu::GetFrameCount(tokens);
+        }
     } catch (const std::invalid_argument& e) {
         fmt::print("{}\n\n", e.what());
         Emu::DisplayHelp();
@@ -58,31 +181,89 @@ int main(int argc, char** argv) {
 
     try {
         const std::string rom_path{tokens.back()};
+        const auto link = CreateLinkCable(link_options);
+        const std::vector<std::string> cheats{(cheat_path.empty()) ? std::vector<std::string>{}
+                                                                   : Emu::ReadCheatFile(cheat_path)};
 
         if (Emu::CheckRomFile(rom_path) == Gb::Console::AGB) {
-            const std::vector<u32> bios{Emu::LoadGbaBios()};
-            const std::vector<u16> rom{Emu::LoadRom<u16>(rom_path, Gb::Console::AGB)};
+            const Common::RomView<u32> bios{Emu::LoadGbaBios()};
+            const Common::RomView<u16> rom{Emu::LoadRom<u16>(rom_path, Gb::Console::AGB)};
             Gba::Memory::CheckHeader(rom);
 
             const std::string save_path{Emu::SaveGamePath(rom_path)};
 
-            Emu::SDLContext sdl_context{240, 160, pixel_scale, fullscreen};
-            Gba::Core gba_core{sdl_context, bios, rom, save_path, log_level};
+            auto frontend = CreateFrontend(240, 160, pixel_scale, fullscreen, vsync, headless);
+            Gba::Core gba_core{*frontend, bios, rom, save_path, log_level, block_cache, threaded_render,
+                               rewind_capacity, profile, idle_skip, mmap_saves, huge_pages};
+            gba_core.SetRenderSkip(render_skip);
+            gba_core.SetFramePacing(pacing);
+            gba_core.SetRunAhead(run_ahead);
+            gba_core.SetHleBios(hle_bios);
+            gba_core.SetAccuracy(accuracy);
+            if (skip_bios) {
+                gba_core.SkipBios();
+            }
+            gba_core.AttachLinkCable(link.get());
+            if (!shm_name.empty()) {
+                gba_core.ExportSharedMemory(shm_name);
+            }
+            for (const auto& breakpoint : breakpoints) {
+                gba_core.AddBreakpoint(breakpoint.addr, breakpoint.type);
+            }
+            for (const auto& cheat : cheats) {
+                gba_core.AddCheat(cheat);
+            }
+            if (capture) {
+                gba_core.StartCapture(CapturePrefix(rom_path), capture_format);
+            }
+            if (!metrics_settings.path.empty()) {
+                gba_core.ExportMetrics(metrics_settings);
+            }
+            StartMovie(gba_core, record_path, record_from_state, play_path, headless_frames);
 
-            gba_core.EmulatorLoop();
+            if (headless) {
+                PrintFrameStats(gba_core.RunHeadless(headless_frames));
+            } else {
+                gba_core.EmulatorLoop();
+            }
         } else {
-            const std::vector<u8> rom{Emu::LoadRom<u8>(rom_path, Gb::Console::CGB)};
+            const Common::RomView<u8> rom{Emu::LoadRom<u8>(rom_path, Gb::Console::CGB)};
             const Gb::CartridgeHeader cart_header{gameboy_type, rom, multicart};
 
             const std::string save_path{Emu::SaveGamePath(rom_path)};
-            std::vector<u8> save_game{Emu::LoadSaveGame(cart_header, save_path)};
+            Common::SaveBuffer<u8> save_game{Emu::LoadSaveGame(cart_header, save_path, mmap_saves)};
 
             Gb::Logging logger{log_level};
-            Emu::SDLContext sdl_context{160, 144, pixel_scale, fullscreen};
-            Gb::GameBoy gameboy_core{gameboy_type, cart_header, logger, sdl_context, save_path, rom, save_game,
-                                     enable_iir};
+            auto frontend = CreateFrontend(160, 144, pixel_scale, fullscreen, vsync, headless);
+            Gb::GameBoy gameboy_core{gameboy_type, cart_header, logger, *frontend, save_path, rom, save_game,
+                                     audio_filter, threaded_render, rewind_capacity, profile, idle_skip};
+            gameboy_core.SetRenderSkip(render_skip);
+            gameboy_core.SetFramePacing(pacing);
+            gameboy_core.SetRunAhead(run_ahead);
+            gameboy_core.SetAccuracy(accuracy);
+            gameboy_core.AttachLinkCable(link.get());
+            if (!shm_name.empty()) {
+                gameboy_core.ExportSharedMemory(shm_name);
+            }
+            for (const auto& breakpoint : breakpoints) {
+                gameboy_core.AddBreakpoint(static_cast<u16>(breakpoint.addr), breakpoint.type);
+            }
+            for (const auto& cheat : cheats) {
+                gameboy_core.AddCheat(cheat);
+            }
+            if (capture) {
+                gameboy_core.StartCapture(CapturePrefix(rom_path), capture_format);
+            }
+            if (!metrics_settings.path.empty()) {
+                gameboy_core.ExportMetrics(metrics_settings);
+            }
+            StartMovie(gameboy_core, record_path, record_from_state, play_path, headless_frames);
 
-            gameboy_core.EmulatorLoop();
+            if (headless) {
+                PrintFrameStats(gameboy_core.RunHeadless(headless_frames));
+            } else {
+                gameboy_core.EmulatorLoop();
+            }
         }
     } catch (const std::runtime_error& e) {
         fmt::print("{}\n", e.what());
@@ -14,15 +14,41 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <stdexcept>
+
 #include "gb/audio/Audio.h"
-#include "gb/memory/Memory.h"
+#include "common/StateBuffer.h"
+#include "common/Timing.h"
 
 namespace Gb {
 
-Audio::Audio(bool enable_filter)
-        : enable_iir(enable_filter)
-        , left_upsampled((enable_filter) ? interpolated_buffer_size : 0)
-        , right_upsampled((enable_filter) ? interpolated_buffer_size : 0) {
+namespace {
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+} // End anonymous namespace
+
+Audio::Audio(AudioFilter audio_filter)
+        : filter(audio_filter)
+        , left_upsampled((filter == AudioFilter::Iir) ? interpolated_buffer_size : 0)
+        , right_upsampled((filter == AudioFilter::Iir) ? interpolated_buffer_size : 0) {
+
+    if (filter == AudioFilter::Polyphase) {
+        InitPolyphaseKernel();
+    } else if (filter == AudioFilter::BandLimited) {
+        InitBandLimitedKernel();
+    }
 
     square1.LinkToAudio(this);
     square2.LinkToAudio(this);
@@ -31,6 +57,7 @@ Audio::Audio(bool enable_filter)
 }
 
 void Audio::UpdateAudio() {
+    TIMING_SCOPE(Audio);
     FrameSequencerTick();
 
     UpdatePowerOnState();
@@ -40,10 +67,10 @@ void Audio::UpdateAudio() {
         return;
     }
 
-    square1.CheckTrigger(mem->console);
-    square2.CheckTrigger(mem->console);
-    wave.CheckTrigger(mem->console);
-    noise.CheckTrigger(mem->console);
+    square1.CheckTrigger(console);
+    square2.CheckTrigger(console);
+    wave.CheckTrigger(console);
+    noise.CheckTrigger(console);
 
     square1.SweepTick();
 
@@ -133,10 +160,10 @@ void Audio::UpdatePowerOnState() {
 }
 
 void Audio::ClearRegisters() {
-    square1.ClearRegisters(mem->console);
-    square2.ClearRegisters(mem->console);
-    wave.ClearRegisters(mem->console);
-    noise.ClearRegisters(mem->console);
+    square1.ClearRegisters(console);
+    square2.ClearRegisters(console);
+    wave.ClearRegisters(console);
+    noise.ClearRegisters(console);
 
     master_volume = 0x00;
     sound_select = 0x00;
@@ -144,7 +171,30 @@ void Audio::ClearRegisters() {
 }
 
 void Audio::QueueSample(u8 left_sample, u8 right_sample) {
-    if (enable_iir) {
+    if (filter == AudioFilter::BandLimited) {
+        // Multiply the samples by the master volume. This is done after the DAC and after the channels have been
+        // mixed, and so can be greater than 0x0F.
+        AddBandLimitedSample(left_sample * (((master_volume & 0x70) >> 4) + 1),
+                             right_sample * ((master_volume & 0x07) + 1));
+    } else if (filter == AudioFilter::Polyphase) {
+        sample_counter += 1;
+
+        // Multiply the samples by the master volume before averaging them, so volume changes mid-frame are kept.
+        left_accumulator += left_sample * (((master_volume & 0x70) >> 4) + 1);
+        right_accumulator += right_sample * ((master_volume & 0x07) + 1);
+
+        if (sample_counter % divisor == 0) {
+            sample_buffer.push_back(left_accumulator);
+            sample_buffer.push_back(right_accumulator);
+            left_accumulator = 0;
+            right_accumulator = 0;
+        }
+
+        if (sample_buffer.size() == num_samples * 2) {
+            Resample();
+            sample_buffer.clear();
+        }
+    } else if (filter == AudioFilter::Iir) {
         sample_counter += 1;
 
         // We pre-downsample the signal by 7 so the IIR filter can run in real time. So technically aliasing can still
@@ -186,12 +236,281 @@ u8 Audio::ReadNR52() const {
     return sound_on | 0x70 | square1.EnabledFlag() | square2.EnabledFlag() | wave.EnabledFlag() | noise.EnabledFlag();
 }
 
+u8 Audio::ReadRegister(const u16 addr) {
+    Sync();
+
+    switch (addr) {
+    // NR10 -- Channel 1 Sweep
+    case 0xFF10:
+        return square1.sweep | 0x80;
+    // NR11 -- Channel 1 Wave Duty & Sound Length
+    case 0xFF11:
+        return square1.sound_length | 0x3F;
+    // NR12 -- Channel 1 Volume Envelope
+    case 0xFF12:
+        return square1.volume_envelope;
+    // NR13 -- Channel 1 Low Frequency
+    case 0xFF13:
+        // This register is write-only.
+        return 0xFF;
+    // NR14 -- Channel 1 Trigger & High Frequency
+    case 0xFF14:
+        return square1.frequency_hi | 0xBF;
+    // NR21 --  Channel 2 Wave Duty & Sound Length
+    case 0xFF16:
+        return square2.sound_length | 0x3F;
+    // NR22 --  Channel 2 Volume Envelope
+    case 0xFF17:
+        return square2.volume_envelope;
+    // NR23 -- Channel 2 Low Frequency
+    case 0xFF18:
+        // This register is write-only.
+        return 0xFF;
+    // NR24 -- Channel 2 Trigger & High Frequency
+    case 0xFF19:
+        return square2.frequency_hi | 0xBF;
+    // NR30 -- Channel 3 On/Off
+    case 0xFF1A:
+        return wave.channel_on | 0x7F;
+    // NR31 -- Channel 3 Sound Length
+    case 0xFF1B:
+        // This register is write-only.
+        return 0xFF;
+    // NR32 -- Channel 3 Volume Shift
+    case 0xFF1C:
+        return wave.volume_envelope | 0x9F;
+    // NR33 -- Channel 3 Low Frequency
+    case 0xFF1D:
+        // This register is write-only.
+        return 0xFF;
+    // NR34 -- Channel 3 Trigger & High Frequency
+    case 0xFF1E:
+        return wave.frequency_hi | 0xBF;
+    // NR41 -- Channel 4 Sound Length
+    case 0xFF20:
+        // This register is write-only.
+        return 0xFF;
+    // NR42 -- Channel 4 Volume Envelope
+    case 0xFF21:
+        return noise.volume_envelope;
+    // NR43 -- Channel 4 Polynomial Counter
+    case 0xFF22:
+        return noise.frequency_lo;
+    // NR44 -- Channel 4 Trigger
+    case 0xFF23:
+        return noise.frequency_hi | 0xBF;
+    // NR50 -- Master Volume
+    case 0xFF24:
+        return master_volume;
+    // NR51 -- Sound Output Terminal Selection
+    case 0xFF25:
+        return sound_select;
+    // NR52 -- Sound On/Off
+    case 0xFF26:
+        return ReadNR52();
+    // Wave Pattern RAM
+    case 0xFF30: case 0xFF31: case 0xFF32: case 0xFF33: case 0xFF34: case 0xFF35: case 0xFF36: case 0xFF37:
+    case 0xFF38: case 0xFF39: case 0xFF3A: case 0xFF3B: case 0xFF3C: case 0xFF3D: case 0xFF3E: case 0xFF3F:
+        if (wave.channel_on) {
+            // While the wave channel is enabled, reads to wave RAM return the byte containing the sample
+            // currently being played.
+            if (console != Console::DMG || wave.reading_sample) {
+                return wave_ram[wave.wave_pos >> 1];
+            } else {
+                // On DMG, the wave RAM can only be accessed within 2 cycles after the sample position has been
+                // incremented, while the APU is reading the sample.
+                return 0xFF;
+            }
+        } else {
+            return wave_ram[addr - 0xFF30];
+        }
+    // Unused registers return 0xFF when read.
+    default:
+        return 0xFF;
+    }
+}
+
+void Audio::WriteRegister(const u16 addr, const u8 data) {
+    Sync();
+
+    switch (addr) {
+    // NR10 -- Channel 1 Sweep
+    case 0xFF10:
+        if (IsPoweredOn()) {
+            square1.sweep = data & 0x7F;
+            square1.SweepWriteHandler();
+        }
+        break;
+    // NR11 -- Channel 1 Wave Pattern & Sound Length
+    case 0xFF11:
+        if (IsPoweredOn() || console == Console::DMG) {
+            square1.sound_length = data;
+            square1.ReloadLengthCounter();
+            square1.SetDutyCycle();
+        }
+        break;
+    // NR12 -- Channel 1 Volume Envelope
+    case 0xFF12:
+        if (IsPoweredOn()) {
+            square1.volume_envelope = data;
+            if ((square1.volume_envelope & 0xF0) == 0) {
+                square1.channel_enabled = false;
+            }
+        }
+        break;
+    // NR13 -- Channel 1 Low Frequency
+    case 0xFF13:
+        if (IsPoweredOn()) {
+            square1.frequency_lo = data;
+        }
+        break;
+    // NR14 -- Channel 1 Trigger & High Frequency
+    case 0xFF14:
+        if (IsPoweredOn()) {
+            square1.ExtraLengthClocking(data & 0xC7);
+            square1.frequency_hi = data & 0xC7;
+        }
+        break;
+    // NR21 --  Channel 2 Wave Pattern & Sound Length
+    case 0xFF16:
+        if (IsPoweredOn() || console == Console::DMG) {
+            square2.sound_length = data;
+            square2.ReloadLengthCounter();
+            square2.SetDutyCycle();
+        }
+        break;
+    // NR22 --  Channel 2 Volume Envelope
+    case 0xFF17:
+        if (IsPoweredOn()) {
+            square2.volume_envelope = data;
+            if ((square2.volume_envelope & 0xF0) == 0) {
+                square2.channel_enabled = false;
+            }
+        }
+        break;
+    // NR23 -- Channel 2 Low Frequency
+    case 0xFF18:
+        if (IsPoweredOn()) {
+            square2.frequency_lo = data;
+        }
+        break;
+    // NR24 -- Channel 2 Trigger & High Frequency
+    case 0xFF19:
+        if (IsPoweredOn()) {
+            square2.ExtraLengthClocking(data & 0xC7);
+            square2.frequency_hi = data & 0xC7;
+        }
+        break;
+    // NR30 -- Channel 3 On/Off
+    case 0xFF1A:
+        if (IsPoweredOn()) {
+            wave.channel_on = data & 0x80;
+            if ((wave.channel_on & 0x80) == 0) {
+                wave.channel_enabled = false;
+            }
+        }
+        break;
+    // NR31 -- Channel 3 Sound Length
+    case 0xFF1B:
+        if (IsPoweredOn() || console == Console::DMG) {
+            wave.sound_length = data;
+            wave.ReloadLengthCounter();
+        }
+        break;
+    // NR32 -- Channel 3 Volume Shift
+    case 0xFF1C:
+        if (IsPoweredOn()) {
+            wave.volume_envelope = data & ((console == Console::AGB) ? 0xE0 : 0x60);
+        }
+        break;
+    // NR33 -- Channel 3 Low Frequency
+    case 0xFF1D:
+        if (IsPoweredOn()) {
+            wave.frequency_lo = data;
+        }
+        break;
+    // NR34 -- Channel 3 Trigger & High Frequency
+    case 0xFF1E:
+        if (IsPoweredOn()) {
+            wave.ExtraLengthClocking(data & 0xC7);
+            wave.frequency_hi = data & 0xC7;
+        }
+        break;
+    // NR41 -- Channel 4 Sound Length
+    case 0xFF20:
+        if (IsPoweredOn() || console == Console::DMG) {
+            noise.sound_length = data & 0x3F;
+            noise.ReloadLengthCounter();
+        }
+        break;
+    // NR42 -- Channel 4 Volume Envelope
+    case 0xFF21:
+        if (IsPoweredOn()) {
+            noise.volume_envelope = data;
+            if ((noise.volume_envelope & 0xF0) == 0) {
+                noise.channel_enabled = false;
+            }
+        }
+        break;
+    // NR43 -- Channel 4 Polynomial Counter
+    case 0xFF22:
+        if (IsPoweredOn()) {
+            noise.frequency_lo = data;
+        }
+        break;
+    // NR44 -- Channel 4 Trigger
+    case 0xFF23:
+        if (IsPoweredOn()) {
+            noise.ExtraLengthClocking(data & 0xC0);
+            noise.frequency_hi = data & 0xC0;
+        }
+        break;
+    // NR50 -- Master Volume
+    case 0xFF24:
+        if (IsPoweredOn()) {
+            master_volume = data;
+        }
+        break;
+    // NR51 -- Sound Output Terminal Selection
+    case 0xFF25:
+        if (IsPoweredOn()) {
+            sound_select = data;
+        }
+        break;
+    // NR52 -- Sound On/Off
+    case 0xFF26:
+        sound_on = (sound_on & 0x0F) | (data & 0x80);
+        break;
+    // Wave Pattern RAM
+    case 0xFF30: case 0xFF31: case 0xFF32: case 0xFF33: case 0xFF34: case 0xFF35: case 0xFF36: case 0xFF37:
+    case 0xFF38: case 0xFF39: case 0xFF3A: case 0xFF3B: case 0xFF3C: case 0xFF3D: case 0xFF3E: case 0xFF3F:
+        if (wave.channel_on) {
+            // While the wave channel is enabled, writes to wave RAM write the byte containing the sample
+            // currently being played.
+            if (console != Console::DMG || wave.reading_sample) {
+                // On DMG, the wave RAM can only be accessed within 2 cycles after the sample position has been
+                // incremented, while the APU is reading the sample.
+                wave_ram[wave.wave_pos >> 1] = data;
+            }
+        } else {
+            wave_ram[addr - 0xFF30] = data;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
 void Audio::Resample() {
     // The Game Boy generates 35112 samples per channel per frame, which we pre-downsample to 5016. We then resample
     // to 800 samples per channel by interpolating by a factor of 100 and decimating by a factor of 627.
-    Upsample();
-    LowPassIIRFilter();
-    Downsample();
+    if (filter == AudioFilter::Polyphase) {
+        PolyphaseFilter();
+    } else {
+        Upsample();
+        LowPassIIRFilter();
+        Downsample();
+    }
 }
 
 void Audio::Upsample() {
@@ -265,4 +584,253 @@ void Audio::LowPassIIRFilter() {
     }
 }
 
+void Audio::InitPolyphaseKernel() {
+    // Kaiser-windowed sinc lowpass, designed at the interpolated sample rate. The transition band is wide enough
+    // that anything aliased by decimation lands above 20kHz.
+    const std::size_t length = interpolation_factor * polyphase_taps;
+    const double cutoff = polyphase_cutoff / (interpolated_buffer_size * 60.0);
+    const double centre = (length - 1) / 2.0;
+
+    polyphase_kernel.resize(length);
+    for (std::size_t n = 0; n < length; ++n) {
+        const double t = n - centre;
+        const double sinc = (t == 0.0) ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+        const double x = 2.0 * n / (length - 1) - 1.0;
+        const double window = BesselI0(kaiser_beta * std::sqrt(1.0 - x * x)) / BesselI0(kaiser_beta);
+
+        // Scale by the interpolation factor to make up for the zeroes placed between samples.
+        const std::size_t phase = n % interpolation_factor;
+        const std::size_t tap = n / interpolation_factor;
+        polyphase_kernel[phase * polyphase_taps + (polyphase_taps - 1 - tap)] =
+                static_cast<float>(interpolation_factor * sinc * window);
+    }
+
+    left_input.resize(polyphase_taps - 1 + num_samples);
+    right_input.resize(polyphase_taps - 1 + num_samples);
+}
+
+void Audio::PolyphaseFilter() {
+    std::copy(left_history.cbegin(), left_history.cend(), left_input.begin());
+    std::copy(right_history.cbegin(), right_history.cend(), right_input.begin());
+    for (std::size_t i = 0; i < num_samples; ++i) {
+        left_input[polyphase_taps - 1 + i] = static_cast<float>(sample_buffer[i * 2]);
+        right_input[polyphase_taps - 1 + i] = static_cast<float>(sample_buffer[i * 2 + 1]);
+    }
+
+    // Average the pre-downsampled samples, and multiply by 64 to scale the volume for s16 samples.
+    constexpr float scale = 64.0f / divisor;
+    const auto to_s16 = [](float sample) {
+        return static_cast<s16>(std::max(-32768.0f, std::min(32767.0f, sample)));
+    };
+
+    for (std::size_t i = 0; i < output_buffer.size() / 2; ++i) {
+        // Position of this output sample in the interpolated signal.
+        const std::size_t pos = i * decimation_factor;
+        const float* coeffs = &polyphase_kernel[(pos % interpolation_factor) * polyphase_taps];
+        const float* left = &left_input[pos / interpolation_factor];
+        const float* right = &right_input[pos / interpolation_factor];
+
+        float left_out = 0.0f;
+        float right_out = 0.0f;
+        for (std::size_t tap = 0; tap < polyphase_taps; ++tap) {
+            left_out += coeffs[tap] * left[tap];
+            right_out += coeffs[tap] * right[tap];
+        }
+
+        output_buffer[i * 2] = to_s16(left_out * scale);
+        output_buffer[i * 2 + 1] = to_s16(right_out * scale);
+    }
+
+    std::copy(left_input.cend() - left_history.size(), left_input.cend(), left_history.begin());
+    std::copy(right_input.cend() - right_history.size(), right_input.cend(), right_history.begin());
+}
+
+void Audio::Sync() {
+    registers_accessed = true;
+    if (pending_ticks != 0) {
+        TIMING_SCOPE(Audio);
+        RunBandLimited(pending_ticks);
+        pending_ticks = 0;
+    }
+}
+
+void Audio::InitBandLimitedKernel() {
+    // Each phase is a Blackman-windowed sinc impulse, offset by a fraction of an output sample and normalized so
+    // that its taps add up to 1. Summing the impulses at frame end then gives band-limited steps.
+    blip_kernel.resize(blip_phases * blip_width);
+    for (std::size_t phase = 0; phase < blip_phases; ++phase) {
+        const double offset = static_cast<double>(phase) / blip_phases;
+        double sum = 0.0;
+        for (std::size_t tap = 0; tap < blip_width; ++tap) {
+            const double t = tap - (blip_width / 2.0) - offset;
+            const double sinc = (t == 0.0) ? 2.0 * blip_cutoff
+                                           : std::sin(2.0 * M_PI * blip_cutoff * t) / (M_PI * t);
+            const double x = (t + blip_width / 2.0) / blip_width;
+            const double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * x) + 0.08 * std::cos(4.0 * M_PI * x);
+
+            blip_kernel[phase * blip_width + tap] = static_cast<float>(sinc * window);
+            sum += sinc * window;
+        }
+
+        for (std::size_t tap = 0; tap < blip_width; ++tap) {
+            blip_kernel[phase * blip_width + tap] /= static_cast<float>(sum);
+        }
+    }
+
+    blip_left.resize(output_buffer.size() / 2 + blip_width);
+    blip_right.resize(output_buffer.size() / 2 + blip_width);
+}
+
+void Audio::RunBandLimited(unsigned int ticks) {
+    while (ticks != 0) {
+        unsigned int skip = std::min({TicksUntilEvent() - 1, ticks, ticks_per_frame - blip_time});
+        if (skip != 0) {
+            // Nothing which affects the output happens until the next event, so only the timers need to advance.
+            frame_seq_clock += 2 * skip;
+            prev_frame_seq_inc = frame_seq_clock & 0x1000;
+            if (audio_on) {
+                for (auto channel : {&square1, &square2, &wave, &noise}) {
+                    channel->SkipTimerTicks(skip);
+                }
+            }
+
+            ticks -= skip;
+            blip_time += skip;
+            if (blip_time == ticks_per_frame) {
+                EndBandLimitedFrame();
+            }
+        } else {
+            UpdateAudio();
+            registers_accessed = false;
+            ticks -= 1;
+        }
+    }
+}
+
+unsigned int Audio::TicksUntilEvent() const {
+    // Register writes take effect on the following tick, and the wave channel's sample read flag is cleared on the
+    // tick after it was set.
+    if (registers_accessed || wave.reading_sample) {
+        return 1;
+    }
+
+    // The frame sequencer steps when bit 12 of its clock goes low.
+    unsigned int ticks = (0x2000 - (frame_seq_clock & 0x1FFF)) / 2;
+    if (audio_on) {
+        for (auto channel : {&square1, &square2, &wave, &noise}) {
+            if (channel->TriggerPending()) {
+                return 1;
+            }
+            ticks = std::min(ticks, channel->TicksUntilTimerEvent());
+        }
+    }
+
+    return ticks;
+}
+
+void Audio::AddBandLimitedSample(int left_level, int right_level) {
+    if (left_level != blip_left_level) {
+        AddStep(blip_left, left_level - blip_left_level);
+        blip_left_level = left_level;
+    }
+
+    if (right_level != blip_right_level) {
+        AddStep(blip_right, right_level - blip_right_level);
+        blip_right_level = right_level;
+    }
+
+    if (++blip_time == ticks_per_frame) {
+        EndBandLimitedFrame();
+    }
+}
+
+void Audio::AddStep(std::vector<float>& buffer, int delta) const {
+    // Position of this tick in output samples, in units of 1/ticks_per_frame of a sample.
+    const unsigned int pos = blip_time * (output_buffer.size() / 2);
+    const std::size_t index = pos / ticks_per_frame;
+    const std::size_t phase = (pos % ticks_per_frame) * blip_phases / ticks_per_frame;
+
+    const float* coeffs = &blip_kernel[phase * blip_width];
+    for (std::size_t tap = 0; tap < blip_width; ++tap) {
+        buffer[index + tap] += coeffs[tap] * delta;
+    }
+}
+
+void Audio::EndBandLimitedFrame() {
+    const auto to_s16 = [](float sample) {
+        return static_cast<s16>(std::max(-32768.0f, std::min(32767.0f, sample)));
+    };
+
+    const std::size_t frame_samples = output_buffer.size() / 2;
+    for (std::size_t i = 0; i < frame_samples; ++i) {
+        blip_left_sum += blip_left[i];
+        blip_right_sum += blip_right[i];
+
+        // Multiply by 64 to scale the volume for s16 samples.
+        output_buffer[i * 2] = to_s16(blip_left_sum * 64.0f);
+        output_buffer[i * 2 + 1] = to_s16(blip_right_sum * 64.0f);
+    }
+
+    // Keep the tails of steps which extend into the next frame.
+    for (auto buffer : {&blip_left, &blip_right}) {
+        std::copy(buffer->cbegin() + frame_samples, buffer->cend(), buffer->begin());
+        std::fill(buffer->begin() + blip_width, buffer->end(), 0.0f);
+    }
+
+    blip_time = 0;
+}
+
+void Audio::Serialize(Common::StateBuffer& state) {
+    Sync();
+
+    state.BeginChunk("APU ", 3);
+    state.Sync(frame_seq_counter);
+    state.Sync(master_volume);
+    state.Sync(sound_select);
+    state.Sync(sound_on);
+    state.Sync(wave_ram);
+    state.Sync(audio_on);
+    state.Sync(frame_seq_clock);
+    state.Sync(prev_frame_seq_inc);
+
+    // Samples for the current frame, and the filter history, so the output doesn't pop after loading.
+    state.Sync(sample_counter);
+    state.Sync(sample_buffer);
+    const std::size_t full_buffer_size = (filter != AudioFilter::Nearest) ? num_samples * 2 : output_buffer.size();
+    if (state.Loading() && sample_buffer.size() >= full_buffer_size) {
+        throw std::runtime_error("Save state has too many queued audio samples.");
+    }
+
+    for (auto biquad : {&left_biquad1, &left_biquad2, &right_biquad1, &right_biquad2}) {
+        state.Sync(biquad->z1);
+        state.Sync(biquad->z2);
+    }
+    state.Sync(left_history);
+    state.Sync(right_history);
+    state.Sync(left_accumulator);
+    state.Sync(right_accumulator);
+    state.Sync(blip_time);
+    state.Sync(blip_left_level);
+    state.Sync(blip_right_level);
+    state.Sync(blip_left_sum);
+    state.Sync(blip_right_sum);
+    state.Sync(blip_left);
+    state.Sync(blip_right);
+    if (state.Loading()) {
+        if (blip_time >= ticks_per_frame) {
+            throw std::runtime_error("Save state has an invalid audio frame position.");
+        }
+
+        // The step buffers only exist with band-limited synthesis, which may not have been used when saving.
+        const std::size_t blip_size = (filter == AudioFilter::BandLimited) ? output_buffer.size() / 2 + blip_width : 0;
+        blip_left.resize(blip_size);
+        blip_right.resize(blip_size);
+    }
+
+    for (auto channel : {&square1, &square2, &wave, &noise}) {
+        channel->Serialize(state);
+    }
+    state.EndChunk();
+}
+
 } // End namespace Gb
@@ -21,13 +21,12 @@
 #include <cmath>
 
 #include "common/CommonTypes.h"
+#include "common/CommonEnums.h"
 #include "gb/core/Enums.h"
 #include "gb/audio/Channel.h"
 
 namespace Gb {
 
-class Memory;
-
 struct Biquad {
     Biquad(std::size_t interpolated_buffer_size, double fc, double qu)
         : sampling_frequency(interpolated_buffer_size * 60.0)
@@ -59,15 +58,33 @@ struct Biquad {
 };
 
 class Audio {
+    friend class Benchmark;
 public:
-    Audio(bool enable_filter);
+    Audio(AudioFilter audio_filter);
+
+    // Runs the APU for the given number of 2MHz ticks. With band-limited synthesis, the ticks are only counted here,
+    // and are run when the sound registers are next accessed, when a state is saved, or at the end of a frame.
+    void Tick(unsigned int ticks) {
+        if (filter == AudioFilter::BandLimited) {
+            pending_ticks += ticks;
+        } else {
+            for (; ticks != 0; --ticks) {
+                UpdateAudio();
+            }
+        }
+    }
+    void Sync();
 
     void UpdateAudio();
 
-    void LinkToMemory(Memory* memory) { mem = memory; }
+    void SetConsole(Console gb_type) { console = gb_type; }
 
     bool IsPoweredOn() const { return audio_on; }
     u8 ReadNR52() const;
+    u8 ReadRegister(const u16 addr);
+    void WriteRegister(const u16 addr, const u8 data);
+
+    void Serialize(Common::StateBuffer& state);
 
     std::array<s16, 1600> output_buffer;
 
@@ -183,7 +200,7 @@ public:
     std::array<u8, 0x10> wave_ram{{0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF,
                                    0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF}};
 private:
-    const Memory* mem;
+    Console console = Console::DMG;
 
     bool audio_on = true;
 
@@ -192,7 +209,7 @@ private:
     bool prev_frame_seq_inc = false;
 
     // IIR filter
-    const bool enable_iir;
+    const AudioFilter filter;
     unsigned int sample_counter = 0;
     static constexpr unsigned int divisor = 7;
     static constexpr unsigned int num_samples = 35112 / divisor;
@@ -211,6 +228,45 @@ private:
     Biquad right_biquad1 {interpolated_buffer_size, 24000.0, 0.54119610};
     Biquad right_biquad2 {interpolated_buffer_size, 24000.0, 1.3065630};
 
+    // Polyphase FIR filter
+    // Each output sample only needs the polyphase_taps coefficients of the windowed-sinc lowpass which line up with
+    // nonzero samples of the interpolated signal, so only the 800 output samples are computed. The coefficients for
+    // each phase are stored contiguously and in reverse, and the input is stored per channel, so the inner loop is a
+    // dot product over two contiguous arrays.
+    static constexpr std::size_t polyphase_taps = 128;
+    static constexpr double polyphase_cutoff = 22000.0;
+    static constexpr double kaiser_beta = 7.0;
+    std::vector<float> polyphase_kernel;
+    // The last polyphase_taps-1 samples of the previous frame, followed by the samples for the current frame.
+    std::vector<float> left_input;
+    std::vector<float> right_input;
+    std::array<float, polyphase_taps - 1> left_history{};
+    std::array<float, polyphase_taps - 1> right_history{};
+    // Averaging the samples which are dropped when pre-downsampling, instead of taking every 7th sample, reduces
+    // aliasing for close to no cost.
+    int left_accumulator = 0;
+    int right_accumulator = 0;
+
+    // Band-limited synthesis
+    // Rather than generating a sample every tick, only the ticks on which a channel's period timer expires, the
+    // frame sequencer steps or a register was accessed are run. Every change in the output level is added to the
+    // output as a band-limited step, whose difference is stored in blip_left/blip_right and summed at frame end.
+    static constexpr unsigned int ticks_per_frame = num_samples * divisor;
+    static constexpr std::size_t blip_width = 32;
+    static constexpr std::size_t blip_phases = 64;
+    // In cycles per output sample, so 18kHz.
+    static constexpr double blip_cutoff = 0.375;
+    unsigned int pending_ticks = 0;
+    bool registers_accessed = true;
+    unsigned int blip_time = 0;
+    int blip_left_level = 0;
+    int blip_right_level = 0;
+    float blip_left_sum = 0.0f;
+    float blip_right_sum = 0.0f;
+    std::vector<float> blip_kernel;
+    std::vector<float> blip_left;
+    std::vector<float> blip_right;
+
     void FrameSequencerTick();
     void UpdatePowerOnState();
     void ClearRegisters();
@@ -220,6 +276,14 @@ private:
     void Upsample();
     void Downsample();
     void LowPassIIRFilter();
+    void InitPolyphaseKernel();
+    void PolyphaseFilter();
+    void InitBandLimitedKernel();
+    void RunBandLimited(unsigned int ticks);
+    unsigned int TicksUntilEvent() const;
+    void AddBandLimitedSample(int left_level, int right_level);
+    void AddStep(std::vector<float>& buffer, int delta) const;
+    void EndBandLimitedFrame();
 };
 
 } // End namespace Gb
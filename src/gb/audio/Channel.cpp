@@ -16,6 +16,7 @@
 
 #include "gb/audio/Channel.h"
 #include "gb/audio/Audio.h"
+#include "common/StateBuffer.h"
 
 namespace Gb {
 
@@ -36,6 +37,11 @@ Channel::Channel(Generator gen, std::array<u8, 0x10>& wave_ram_ref, u8 NRx0, u8
 
 u8 Channel::GenSample() const {
     if (gen_type == Generator::Wave) {
+        // Bit 7 of NR32 only exists on the GBA, and forces the output to 75% volume.
+        if (volume_envelope & 0x80) {
+            return (current_sample * 3) >> 2;
+        }
+
         u8 volume_shift = (WaveVolumeShift()) ? WaveVolumeShift() - 1 : 4;
         return current_sample >> volume_shift;
     } else if (gen_type == Generator::Noise) {
@@ -356,4 +362,34 @@ void Channel::SetDutyCycle() {
     }
 }
 
+void Channel::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("CHAN", 1);
+    state.Sync(sweep);
+    state.Sync(sound_length);
+    state.Sync(volume_envelope);
+    state.Sync(frequency_lo);
+    state.Sync(frequency_hi);
+    state.Sync(channel_enabled);
+    state.Sync(wave_pos);
+    state.Sync(reading_sample);
+
+    state.Sync(period_timer);
+    state.Sync(length_counter);
+    state.Sync(prev_length_counter_dec);
+    state.Sync(volume);
+    state.Sync(envelope_counter);
+    state.Sync(prev_envelope_inc);
+    state.Sync(envelope_enabled);
+    state.Sync(shadow_frequency);
+    state.Sync(sweep_counter);
+    state.Sync(prev_sweep_inc);
+    state.Sync(sweep_enabled);
+    state.Sync(performed_negative_calculation);
+    state.Sync(current_sample);
+    state.Sync(last_played_sample);
+    state.Sync(lfsr);
+    state.Sync(duty_cycle);
+    state.EndChunk();
+}
+
 } // End namespace Gb
@@ -21,6 +21,8 @@
 #include "common/CommonTypes.h"
 #include "gb/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gb {
 
 enum class Generator : u8 {Square1=0x01, Square2=0x02, Wave=0x04, Noise=0x08};
@@ -55,6 +57,11 @@ public:
 
     void PowerOn() { wave_pos = 0x00; current_sample = 0x00; }
 
+    // For band-limited synthesis, which only runs the ticks on which a channel's output can change.
+    bool TriggerPending() const { return frequency_hi & 0x80; }
+    unsigned int TicksUntilTimerEvent() const { return period_timer + 1; }
+    void SkipTimerTicks(unsigned int ticks) { period_timer -= ticks; }
+
     void ExtraLengthClocking(u8 new_frequency_hi);
     void SweepWriteHandler();
 
@@ -66,6 +73,8 @@ public:
     void ReloadLengthCounter();
     void SetDutyCycle();
     void ClearRegisters(const Console console);
+
+    void Serialize(Common::StateBuffer& state);
 private:
     const Audio* audio;
 
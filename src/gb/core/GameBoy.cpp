@@ -15,35 +15,57 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fmt/format.h>
 
 #include "gb/core/GameBoy.h"
 #include "gb/cpu/CPU.h"
 #include "gb/memory/Memory.h"
 #include "gb/memory/CartridgeHeader.h"
 #include "gb/lcd/LCD.h"
+#include "gb/lcd/RenderThread.h"
 #include "gb/audio/Audio.h"
 #include "gb/hardware/Timer.h"
 #include "gb/hardware/Serial.h"
 #include "gb/hardware/Joypad.h"
 #include "gb/logging/Logging.h"
-#include "emu/SDLContext.h"
+#include "emu/Frontend.h"
 #include "common/Screenshot.h"
+#include "common/StateBuffer.h"
+#include "common/Rewind.h"
+#include "common/FrameStats.h"
+#include "common/Movie.h"
+#include "common/SharedMemoryExport.h"
+#include "common/Profiler.h"
+#include "common/Timing.h"
 
 namespace Gb {
 
-GameBoy::GameBoy(const Console gb_type, const CartridgeHeader& header, Logging& logger, Emu::SDLContext& context,
-                 const std::string& save_file, const std::vector<u8>& rom, std::vector<u8>& save_game, bool enable_iir)
+// Roughly 270 samples per frame.
+constexpr int profile_sample_period = 256;
+
+GameBoy::GameBoy(const Console gb_type, const CartridgeHeader& header, Logging& logger, Emu::Frontend& context,
+                 const std::string& save_file, const Common::RomView<u8>& rom, Common::SaveBuffer<u8>& save_game,
+                 AudioFilter audio_filter, bool threaded_render, std::size_t rewind_capacity, bool enable_profiler,
+                 bool idle_skip)
         : logging(logger)
-        , sdl_context(context)
+        , profiler(enable_profiler ? std::make_unique<Common::Profiler>(profile_sample_period) : nullptr)
+        , clone_settings{gb_type, header, rom, audio_filter, threaded_render, idle_skip}
+        , frontend(context)
         , front_buffer(160*144)
         , save_path(save_file)
+        , state_path(save_file.substr(0, save_file.rfind('.')) + ".state")
+        , save_writer(save_path)
+        , rewind_buffer(rewind_capacity ? std::make_unique<Common::RewindBuffer>(rewind_capacity) : nullptr)
         , timer(std::make_unique<Timer>())
         , serial(std::make_unique<Serial>())
         , lcd(std::make_unique<LCD>())
         , joypad(std::make_unique<Joypad>())
-        , audio(std::make_unique<Audio>(enable_iir))
+        , audio(std::make_unique<Audio>(audio_filter))
         , mem(std::make_unique<Memory>(gb_type, header, *timer, *serial, *lcd, *joypad, *audio, rom, save_game))
-        , cpu(std::make_unique<CPU>(*mem)) {
+        , cpu(std::make_unique<CPU>(*mem, idle_skip)) {
 
     // Link together circular dependencies after all components are constructed.
     lcd->LinkToGameBoy(this);
@@ -52,20 +74,29 @@ GameBoy::GameBoy(const Console gb_type, const CartridgeHeader& header, Logging&
     serial->LinkToMemory(mem.get());
     lcd->LinkToMemory(mem.get());
     joypad->LinkToMemory(mem.get());
-    audio->LinkToMemory(mem.get());
+    audio->SetConsole(mem->console);
+
+    if (threaded_render) {
+        render_thread = std::make_unique<RenderThread>(*mem, *lcd, *this);
+        lcd->LinkToRenderThread(render_thread.get());
+    }
 
     RegisterCallbacks();
 }
 
 GameBoy::~GameBoy() {
-    mem->SaveExternalRAM(save_path);
+    if (mem->ExtRAMFileBacked()) {
+        return;
+    }
+
+    std::vector<u8> snapshot{mem->SaveSnapshot()};
+    if (!snapshot.empty()) {
+        save_writer.Submit(std::move(snapshot));
+    }
 }
 
 void GameBoy::EmulatorLoop() {
-    constexpr int cycles_per_frame = 70224;
-    int overspent_cycles = 0;
-
-    sdl_context.UnpauseAudio();
+    frontend.UnpauseAudio();
 
     using namespace std::chrono;
     auto max_frame_time = 0us;
@@ -75,73 +106,415 @@ void GameBoy::EmulatorLoop() {
     while (!quit) {
         const auto start_time = steady_clock::now();
 
-        sdl_context.PollEvents();
+        frontend.PollEvents();
 
         if (pause && !frame_advance) {
-            SDL_Delay(48);
-            sdl_context.RenderFrame(front_buffer.data());
+            frontend.Delay(48);
+            frontend.RenderFrame(front_buffer.data());
             continue;
         }
 
         frame_advance = false;
 
-        joypad->UpdateJoypad();
+        if (rewinding) {
+            if (!rewind_buffer->Pop(rewind_state.Data())) {
+                // Nothing older to go back to.
+                frontend.Delay(16);
+                frontend.RenderFrame(front_buffer.data());
+                continue;
+            }
+
+            // Rerun the restored frame to draw it.
+            rewind_state.BeginLoad();
+            Serialize(rewind_state);
+        } else if (rewind_buffer) {
+            rewind_state.BeginSave();
+            Serialize(rewind_state);
+            rewind_buffer->Push(rewind_state.Data());
+        }
 
-        // Overspent cycles is always zero or negative.
-        int target_cycles = (cycles_per_frame << mem->double_speed) + overspent_cycles;
-        overspent_cycles = cpu->RunFor(target_cycles);
+        if (run_ahead && !rewinding) {
+            RunAheadFrame();
+        } else {
+            RunFrame();
+            if (!rewinding && !pacer.FastForwarding()) {
+                frontend.PushBackAudio(audio->output_buffer);
+            }
+        }
 
         auto frame_time = duration_cast<microseconds>(steady_clock::now() - start_time);
+        RecordMetrics(frame_time.count());
         max_frame_time = std::max(max_frame_time, frame_time);
         avg_frame_time += frame_time;
         if (++frame_count == 60) {
-            sdl_context.UpdateFrameTimes(avg_frame_time.count() / 60, max_frame_time.count());
+            frontend.UpdateFrameTimes(avg_frame_time.count() / 60, max_frame_time.count(), pacer.TakeAverageError());
             max_frame_time = 0us;
             avg_frame_time = 0us;
             frame_count = 0;
         }
 
-        sdl_context.PushBackAudio(audio->output_buffer);
-        sdl_context.RenderFrame(front_buffer.data());
+        frontend.RenderFrame(front_buffer.data());
+        pacer.WaitForNextFrame();
     }
 
-    sdl_context.PauseAudio();
+    frontend.PauseAudio();
+
+    WriteProfile();
+}
+
+Common::FrameStats GameBoy::RunHeadless(int num_frames) {
+    using namespace std::chrono;
+    Common::FrameStats stats;
+
+    const auto run_start_time = steady_clock::now();
+    for (; stats.frames < num_frames; ++stats.frames) {
+        const auto start_time = steady_clock::now();
+        RunFrame();
+        const double frame_time = duration<double, std::micro>(steady_clock::now() - start_time).count();
+        RecordMetrics(frame_time);
+        stats.max_frame_time_us = std::max(stats.max_frame_time_us, frame_time);
+    }
+
+    stats.total_seconds = duration<double>(steady_clock::now() - run_start_time).count();
+    if (num_frames > 0) {
+        stats.avg_frame_time_us = stats.total_seconds * 1e6 / num_frames;
+    }
+    stats.framebuffer_hash = Common::HashFrameBuffer(front_buffer);
+
+    WriteProfile();
+
+    return stats;
+}
+
+void GameBoy::RunFrame() {
+    constexpr int cycles_per_frame = 70224;
+
+    if (movie && !speculative) {
+        UpdateMovie();
+    } else if (shm_export && !speculative) {
+        UpdateExternalInput();
+    }
+
+    joypad->UpdateJoypad();
+
+    // Overspent cycles is always zero or negative.
+    int target_cycles = (cycles_per_frame << mem->double_speed) + overspent_cycles;
+    {
+        TIMING_SCOPE(Cpu);
+        overspent_cycles = cpu->RunFor(target_cycles);
+    }
+    audio->Sync();
+
+    if (speculative) {
+        return;
+    }
+
+    if (mem->BreakpointTriggered()) {
+        ReportBreakpoints();
+    }
+
+    if (mem->ExtRAMFileBacked()) {
+        mem->SyncExtRAM();
+    } else if (mem->ExtRAMIdle()) {
+        save_writer.Submit(mem->SaveSnapshot());
+    }
+
+    if (capture) {
+        capture->Submit(front_buffer);
+    }
+
+    if (shm_export) {
+        shm_export->Publish(front_buffer, {Common::SharedMemoryExport::View(mem->WramReference()),
+                                           Common::SharedMemoryExport::View(mem->HramReference())});
+    }
+
+    if (movie && movie->CheckpointDue()) {
+        MovieCheckpoint();
+    }
+
+    TIMING_END_FRAME();
 }
 
 void GameBoy::RegisterCallbacks() {
     using Emu::InputEvent;
 
-    sdl_context.RegisterCallback(InputEvent::Quit,         [this](bool) { quit = true; });
-    sdl_context.RegisterCallback(InputEvent::Pause,        [this](bool) { pause = !pause; });
-    sdl_context.RegisterCallback(InputEvent::LogLevel,     [this](bool) { logging.SwitchLogLevel(); });
-    sdl_context.RegisterCallback(InputEvent::Fullscreen,   [this](bool) { sdl_context.ToggleFullscreen(); });
-    sdl_context.RegisterCallback(InputEvent::Screenshot,   [this](bool) { Screenshot(); });
-    sdl_context.RegisterCallback(InputEvent::LcdDebug,     [this](bool) { lcd->DumpEverything(); });
-    sdl_context.RegisterCallback(InputEvent::HideWindow,   [this](bool) { old_pause = pause; pause = true; });
-    sdl_context.RegisterCallback(InputEvent::ShowWindow,   [this](bool) { pause = old_pause; });
-    sdl_context.RegisterCallback(InputEvent::FrameAdvance, [this](bool) { frame_advance = true; });
-
-    sdl_context.RegisterCallback(InputEvent::Up,     [this](bool press) { joypad->Press(Joypad::Up, press); });
-    sdl_context.RegisterCallback(InputEvent::Left,   [this](bool press) { joypad->Press(Joypad::Left, press); });
-    sdl_context.RegisterCallback(InputEvent::Down,   [this](bool press) { joypad->Press(Joypad::Down, press); });
-    sdl_context.RegisterCallback(InputEvent::Right,  [this](bool press) { joypad->Press(Joypad::Right, press); });
-    sdl_context.RegisterCallback(InputEvent::A,      [this](bool press) { joypad->Press(Joypad::A, press); });
-    sdl_context.RegisterCallback(InputEvent::B,      [this](bool press) { joypad->Press(Joypad::B, press); });
-    sdl_context.RegisterCallback(InputEvent::L,      [](bool) { });
-    sdl_context.RegisterCallback(InputEvent::R,      [](bool) { });
-    sdl_context.RegisterCallback(InputEvent::Start,  [this](bool press) { joypad->Press(Joypad::Start, press); });
-    sdl_context.RegisterCallback(InputEvent::Select, [this](bool press) { joypad->Press(Joypad::Select, press); });
+    frontend.RegisterCallback(InputEvent::Quit,         [this](bool) { quit = true; });
+    frontend.RegisterCallback(InputEvent::Pause,        [this](bool) { pause = !pause; });
+    frontend.RegisterCallback(InputEvent::LogLevel,     [this](bool) { logging.SwitchLogLevel(); });
+    frontend.RegisterCallback(InputEvent::Fullscreen,   [this](bool) { frontend.ToggleFullscreen(); });
+    frontend.RegisterCallback(InputEvent::Screenshot,   [this](bool) { Screenshot(); });
+    frontend.RegisterCallback(InputEvent::LcdDebug,     [this](bool) { lcd->DumpEverything(); });
+    frontend.RegisterCallback(InputEvent::HideWindow,   [this](bool) { old_pause = pause; pause = true; });
+    frontend.RegisterCallback(InputEvent::ShowWindow,   [this](bool) { pause = old_pause; });
+    frontend.RegisterCallback(InputEvent::FrameAdvance, [this](bool) { frame_advance = true; });
+    frontend.RegisterCallback(InputEvent::SaveState,    [this](bool) { SaveState(); });
+    frontend.RegisterCallback(InputEvent::LoadState,    [this](bool) { LoadState(); });
+    frontend.RegisterCallback(InputEvent::Turbo,        [this](bool press) { pacer.SetTurbo(press); });
+    frontend.RegisterCallback(InputEvent::Rewind,       [this](bool press) {
+        // Rewinding would make a movie's inputs go out of step with its frames.
+        rewinding = press && rewind_buffer && !movie;
+    });
+
+    frontend.RegisterCallback(InputEvent::Up,     [this](bool press) { PressButton(Joypad::Up, press); });
+    frontend.RegisterCallback(InputEvent::Left,   [this](bool press) { PressButton(Joypad::Left, press); });
+    frontend.RegisterCallback(InputEvent::Down,   [this](bool press) { PressButton(Joypad::Down, press); });
+    frontend.RegisterCallback(InputEvent::Right,  [this](bool press) { PressButton(Joypad::Right, press); });
+    frontend.RegisterCallback(InputEvent::A,      [this](bool press) { PressButton(Joypad::A, press); });
+    frontend.RegisterCallback(InputEvent::B,      [this](bool press) { PressButton(Joypad::B, press); });
+    frontend.RegisterCallback(InputEvent::L,      [](bool) { });
+    frontend.RegisterCallback(InputEvent::R,      [](bool) { });
+    frontend.RegisterCallback(InputEvent::Start,  [this](bool press) { PressButton(Joypad::Start, press); });
+    frontend.RegisterCallback(InputEvent::Select, [this](bool press) { PressButton(Joypad::Select, press); });
 }
 
 void GameBoy::SwapBuffers(std::vector<u16>& back_buffer) {
     front_buffer.swap(back_buffer);
 }
 
-void GameBoy::Screenshot() const {
-    Common::WritePPMFile(Common::BGR5ToRGB8(front_buffer), "screenshot.ppm", 160, 144);
+void GameBoy::Screenshot(const std::string& filename) const {
+    Common::WritePNGFile(Common::BGR5ToRGB8(front_buffer), filename, 160, 144);
+}
+
+void GameBoy::SetRenderSkip(int n) {
+    lcd->render_skip = n;
+}
+
+void GameBoy::StartCapture(const std::string& path_prefix, Common::FrameCapture::Format format) {
+    capture = std::make_unique<Common::FrameCapture>(path_prefix, format, 160, 144);
+}
+
+void GameBoy::ExportMetrics(const Common::Metrics::Settings& settings) {
+    metrics = std::make_unique<Common::Metrics>(settings, "gb", Common::FramePacer::refresh_rate);
+}
+
+void GameBoy::RecordMetrics(double frame_time_us) {
+    if (metrics) {
+        metrics->RecordFrame(frame_time_us, cpu->counters, frontend.AudioUnderruns(), frontend.QueuedAudioFrames());
+    }
+}
+
+void GameBoy::SetRunAhead(int frames) {
+    run_ahead = frames;
+}
+
+void GameBoy::RunAheadFrame() {
+    // The real frame is drawn as usual, so captures and screenshots still show what the game really displayed.
+    RunFrame();
+    if (!pacer.FastForwarding()) {
+        frontend.PushBackAudio(audio->output_buffer);
+    }
+
+    run_ahead_state.BeginSave();
+    Serialize(run_ahead_state);
+
+    // Run ahead with the same input, only drawing the last frame, which is the one presented.
+    speculative = true;
+    for (int i = 1; i <= run_ahead; ++i) {
+        lcd->SetSkipFrame(i < run_ahead);
+        RunFrame();
+    }
+    speculative = false;
+    mem->TakeBreakpointHits();
+
+    // The front buffer isn't part of the state, so it keeps the frame from the future.
+    run_ahead_state.BeginLoad();
+    Serialize(run_ahead_state);
+}
+
+void GameBoy::RecordMovie(const std::string& filename, bool from_current_state) {
+    std::vector<u8> start_state;
+    if (from_current_state) {
+        movie_state.BeginSave();
+        Serialize(movie_state);
+        start_state = movie_state.Data();
+    }
+
+    movie = std::make_unique<Common::Movie>(filename, Common::Movie::Console::Gb, std::move(start_state));
+    rewinding = false;
+    applied_buttons = 0x00;
+}
+
+void GameBoy::PlayMovie(std::unique_ptr<Common::Movie> movie_to_play) {
+    if (movie_to_play->GetConsole() != Common::Movie::Console::Gb) {
+        throw std::runtime_error("Movie was recorded on a different console.");
+    }
+
+    if (!movie_to_play->StartState().empty()) {
+        Common::StateBuffer state{movie_to_play->StartState()};
+        Serialize(state);
+    }
+
+    movie = std::move(movie_to_play);
+    rewinding = false;
+    applied_buttons = 0x00;
+}
+
+void GameBoy::AttachLinkCable(Common::LinkCable* cable) {
+    serial->AttachLinkCable(cable);
+}
+
+void GameBoy::ExportSharedMemory(const std::string& name) {
+    const std::vector<std::size_t> region_sizes{mem->WramReference().size(), mem->HramReference().size()};
+    shm_export = std::make_unique<Common::SharedMemoryExport>(name, 160, 144, region_sizes);
+    held_buttons = applied_buttons;
+}
+
+void GameBoy::AddBreakpoint(u16 addr, Common::Breakpoints::Type type) {
+    mem->AddBreakpoint(addr, type);
+}
+
+std::unique_ptr<GameBoy> GameBoy::Clone(Emu::Frontend& context, Logging& logger) {
+    const auto& settings = clone_settings;
+    // The clone's save memory starts out as it would be loaded from a save file, including the RTC.
+    auto save_game = std::make_unique<Common::SaveBuffer<u8>>(mem->SaveSnapshot());
+
+    auto clone = std::make_unique<GameBoy>(settings.gb_type, settings.header, logger, context, "", settings.rom,
+                                           *save_game, settings.audio_filter, settings.threaded_render, 0, false,
+                                           settings.idle_skip);
+    clone->owned_save = std::move(save_game);
+    clone->SetRenderSkip(lcd->render_skip);
+    clone->mem->SetCheats(mem->CheatList());
+    clone->SetAccuracy(mem->GetAccuracy());
+    clone->held_buttons = held_buttons;
+    clone->applied_buttons = applied_buttons;
+    clone->front_buffer = front_buffer;
+
+    Common::StateBuffer clone_state;
+    Serialize(clone_state);
+    clone_state.BeginLoad();
+    clone->Serialize(clone_state);
+
+    return clone;
+}
+
+void GameBoy::SetAccuracy(Accuracy profile) {
+    mem->SetAccuracy(profile);
+}
+
+void GameBoy::AddCheat(const std::string& code) {
+    mem->AddCheat(code);
+}
+
+void GameBoy::ReportBreakpoints() {
+    for (const auto& hit : mem->TakeBreakpointHits()) {
+        fmt::print("{} hit at 0x{:0>4X}\n", Common::Breakpoints::TypeName(hit.type), hit.addr);
+    }
+    fmt::print("Paused at PC 0x{:0>4X}\n", cpu->GetPc());
+    pause = true;
+}
+
+void GameBoy::PressButton(u8 button, bool pressed) {
+    if (movie || shm_export) {
+        held_buttons = (pressed) ? (held_buttons | button) : (held_buttons & ~button);
+    } else {
+        joypad->Press(static_cast<Joypad::Button>(button), pressed);
+    }
+}
+
+void GameBoy::SetButtons(u8 buttons) {
+    // Buttons are always applied in the same order, so that playback changes the joypad state exactly as
+    // recording did.
+    for (unsigned int i = 0; i < 8; ++i) {
+        const u8 button = 1 << i;
+        if ((buttons ^ applied_buttons) & button) {
+            joypad->Press(static_cast<Joypad::Button>(button), buttons & button);
+        }
+    }
+
+    applied_buttons = buttons;
+}
+
+void GameBoy::UpdateExternalInput() {
+    u32 buttons;
+    SetButtons(shm_export->Buttons(buttons) ? static_cast<u8>(buttons) : held_buttons);
+}
+
+void GameBoy::UpdateMovie() {
+    if (movie->Finished()) {
+        // Hand the joypad back to the frontend.
+        fmt::print("Movie finished after {} frames\n", movie->Length());
+        movie.reset();
+        SetButtons(held_buttons);
+        return;
+    }
+
+    SetButtons(static_cast<u8>(movie->NextFrame(held_buttons)));
+}
+
+void GameBoy::MovieCheckpoint() {
+    movie_state.BeginSave();
+    Serialize(movie_state);
+    movie->Checkpoint(Common::Movie::HashState(movie_state.Data()));
+}
+
+void GameBoy::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("GB  ", 1);
+    state.Sync(overspent_cycles);
+    state.Sync(lcd_on_when_stopped);
+    cpu->Serialize(state);
+    mem->Serialize(state);
+    lcd->Serialize(state);
+    timer->Serialize(state);
+    serial->Serialize(state);
+    joypad->Serialize(state);
+    audio->Serialize(state);
+    state.EndChunk();
+
+    if (state.Loading() && render_thread) {
+        render_thread->Resync(*mem, *lcd);
+    }
+
+    if (state.Loading() && profiler) {
+        profiler->ResetStack();
+    }
+}
+
+void GameBoy::WriteProfile() const {
+    if (profiler) {
+        profiler->WriteProfile("profile");
+        fmt::print("Wrote guest profile to profile.txt and profile.folded\n");
+    }
+}
+
+void GameBoy::SaveState() {
+    Common::StateBuffer state;
+    Serialize(state);
+
+    std::ofstream state_file(state_path, std::ios::binary);
+    state_file.write(reinterpret_cast<const char*>(state.Data().data()), state.Data().size());
+    if (!state_file) {
+        fmt::print("Error when attempting to write {}\n", state_path);
+    }
+}
+
+void GameBoy::LoadState() {
+    std::ifstream state_file(state_path, std::ios::binary);
+    if (!state_file) {
+        fmt::print("No save state found at {}\n", state_path);
+        return;
+    }
+
+    std::vector<u8> saved_data{std::istreambuf_iterator<char>(state_file), std::istreambuf_iterator<char>()};
+
+    // A bad state is rejected partway through loading, so keep the current state around to go back to.
+    Common::StateBuffer backup;
+    Serialize(backup);
+
+    try {
+        Common::StateBuffer state{std::move(saved_data)};
+        Serialize(state);
+    } catch (const std::runtime_error& e) {
+        fmt::print("{}\n", e.what());
+        Common::StateBuffer restore{backup.Data()};
+        Serialize(restore);
+    }
 }
 
 void GameBoy::HardwareTick(unsigned int cycles) {
+    const bool batch_timer = BatchTimer(cycles);
+    const bool batch_serial = BatchSerial(cycles);
+    const bool batch_lcd = BatchLCD(cycles);
+
     for (; cycles != 0; cycles -= 4) {
         // Log I/O registers if logging enabled.
         if (logging.log_level == LogLevel::Timer) {
@@ -156,21 +529,29 @@ void GameBoy::HardwareTick(unsigned int cycles) {
         // Update the rest of the system hardware.
         mem->UpdateOAM_DMA();
         mem->UpdateHDMA();
-        timer->UpdateTimer();
-        serial->UpdateSerial();
-        lcd->UpdateLCD();
+        if (!batch_timer) {
+            timer->UpdateTimer();
+        }
+        if (!batch_serial) {
+            serial->UpdateSerial();
+        }
+        if (!batch_lcd) {
+            lcd->UpdateLCD();
+        }
 
         // The APU always updates at 2MHz, regardless of double speed mode. So we need to update it twice an M-cycle
         // in single-speed mode.
-        for (int i = 0; i < (2 >> mem->double_speed); ++i) {
-            audio->UpdateAudio();
-        }
+        audio->Tick(2 >> mem->double_speed);
 
         mem->IF_written_this_cycle = false;
     }
 }
 
 void GameBoy::HaltedTick(unsigned int cycles) {
+    const bool batch_timer = BatchTimer(cycles);
+    const bool batch_serial = BatchSerial(cycles);
+    const bool batch_lcd = BatchLCD(cycles);
+
     for (; cycles != 0; cycles -= 4) {
         // Log I/O registers if logging enabled.
         if (logging.log_level == LogLevel::Timer) {
@@ -180,16 +561,49 @@ void GameBoy::HaltedTick(unsigned int cycles) {
         }
 
         // Update the rest of the system hardware.
-        timer->UpdateTimer();
-        serial->UpdateSerial();
-        lcd->UpdateLCD();
+        if (!batch_timer) {
+            timer->UpdateTimer();
+        }
+        if (!batch_serial) {
+            serial->UpdateSerial();
+        }
+        if (!batch_lcd) {
+            lcd->UpdateLCD();
+        }
 
         // The APU always updates at 2MHz, regardless of double speed mode. So we need to update it twice an M-cycle
         // in single-speed mode.
-        for (int i = 0; i < (2 >> mem->double_speed); ++i) {
-            audio->UpdateAudio();
-        }
+        audio->Tick(2 >> mem->double_speed);
+    }
+}
+
+bool GameBoy::BatchTimer(unsigned int cycles) {
+    // If the timer won't change state in any way the rest of the system can observe before the given number of
+    // cycles has passed, defer it until it is next accessed instead of updating it every machine cycle.
+    if (logging.log_level == LogLevel::Timer) {
+        timer->Sync();
+        return false;
+    }
+
+    return timer->Defer(cycles);
+}
+
+bool GameBoy::BatchSerial(unsigned int cycles) {
+    if (serial->CyclesUntilEvent() <= cycles) {
+        return false;
     }
+
+    serial->FastForward(cycles);
+    return true;
+}
+
+bool GameBoy::BatchLCD(unsigned int cycles) {
+    if (logging.log_level == LogLevel::LCD) {
+        lcd->Sync();
+        return false;
+    }
+
+    return lcd->Defer(cycles);
 }
 
 bool GameBoy::JoypadPress() const {
@@ -197,6 +611,8 @@ bool GameBoy::JoypadPress() const {
 }
 
 void GameBoy::StopLCD() {
+    lcd->Sync();
+
     // Record the current LCD power state for when we exit stop mode.
     lcd_on_when_stopped = lcd->lcdc & 0x80;
 
@@ -205,6 +621,7 @@ void GameBoy::StopLCD() {
 }
 
 void GameBoy::SpeedSwitch() {
+    lcd->Sync();
     mem->ToggleCPUSpeed();
 
     // If the LCD was on when we entered STOP mode, turn it back on.
@@ -18,11 +18,23 @@
 
 #include <memory>
 #include <vector>
+#include <string>
 
 #include "common/CommonTypes.h"
+#include "common/CommonEnums.h"
+#include "common/StateBuffer.h"
+#include "common/MappedFile.h"
+#include "common/SaveWriter.h"
+#include "common/SaveBuffer.h"
+#include "common/FrameCapture.h"
+#include "common/Movie.h"
+#include "common/Breakpoints.h"
+#include "common/FramePacer.h"
+#include "common/Metrics.h"
 #include "gb/core/Enums.h"
 
-namespace Emu { class SDLContext; }
+namespace Emu { class Frontend; }
+namespace Common { class RewindBuffer; class Profiler; struct FrameStats; class LinkCable; class SharedMemoryExport; }
 
 namespace Gb {
 
@@ -35,18 +47,65 @@ class Audio;
 class Memory;
 class CPU;
 class Logging;
+class RenderThread;
 
 class GameBoy {
+    friend class Benchmark;
 public:
     Logging& logging;
+    // Only present when profiling.
+    std::unique_ptr<Common::Profiler> profiler;
 
-    GameBoy(const Console gb_type, const CartridgeHeader& header, Logging& logger, Emu::SDLContext& context,
-            const std::string& save_file, const std::vector<u8>& rom, std::vector<u8>& save_game, bool enable_iir);
+    GameBoy(const Console gb_type, const CartridgeHeader& header, Logging& logger, Emu::Frontend& context,
+            const std::string& save_file, const Common::RomView<u8>& rom, Common::SaveBuffer<u8>& save_game,
+            AudioFilter audio_filter, bool threaded_render, std::size_t rewind_capacity, bool enable_profiler,
+            bool idle_skip);
     ~GameBoy();
 
     void EmulatorLoop();
+    // Runs the given number of frames as fast as possible, without presenting frames or playing audio.
+    Common::FrameStats RunHeadless(int num_frames);
     void SwapBuffers(std::vector<u16>& back_buffer);
-    void Screenshot() const;
+    void Screenshot(const std::string& filename = "screenshot.png") const;
+    // Writes every frame from now on to disk, for video capture and screenshot comparison.
+    void StartCapture(const std::string& path_prefix, Common::FrameCapture::Format format);
+    // Periodically writes frame time percentiles, emulation speed, CPU and audio counters to a file.
+    void ExportMetrics(const Common::Metrics::Settings& settings);
+    // Only draws and presents every nth frame, to speed up fast-forwarding.
+    void SetRenderSkip(int n);
+    void SetFramePacing(const Common::FramePacer::Settings& settings) { pacer.SetSettings(settings); }
+    // Emulates this many frames ahead of the real one every frame and presents the last of them, then rolls back.
+    // This hides the game's own input lag.
+    void SetRunAhead(int frames);
+    // Chooses between the accurate and fast timing profiles. See Memory::SetAccuracy.
+    void SetAccuracy(Accuracy profile);
+    // Records the buttons held on every frame from now on. The movie starts from the current state if
+    // from_current_state is set, or from power-on otherwise (so no frames must have run yet).
+    void RecordMovie(const std::string& filename, bool from_current_state);
+    // Replays a movie's buttons in place of the frontend's, starting from its save state if it has one.
+    void PlayMovie(std::unique_ptr<Common::Movie> movie_to_play);
+    // Connects the serial port to another instance. The cable has to outlive the core.
+    void AttachLinkCable(Common::LinkCable* cable);
+    // Publishes every frame and the work RAM to the named shared memory segment, and lets other processes hold
+    // buttons through it.
+    void ExportSharedMemory(const std::string& name);
+    // Pauses at the end of any frame which hits the breakpoint or watchpoint. Speculative run-ahead frames never
+    // hit them.
+    void AddBreakpoint(u16 addr, Common::Breakpoints::Type type);
+    // Applies a Game Genie or GameShark code from now on. Throws if the code can't be decoded.
+    void AddCheat(const std::string& code);
+
+    // Creates an independent copy of the emulated machine, as of the end of the last frame, which presents to the
+    // given frontend and logs to the given logger. The clone shares this core's ROM and cartridge header, and owns
+    // a copy of the save memory. Only the machine is copied: the clone never writes the save file, and has no
+    // rewind buffer, profiler, movie, capture, metrics export, link cable, shared memory export or breakpoints.
+    // Cheats are kept.
+    std::unique_ptr<GameBoy> Clone(Emu::Frontend& context, Logging& logger);
+
+    // Covers the whole emulated machine. States are only saved and loaded between frames.
+    void Serialize(Common::StateBuffer& state);
+    void SaveState();
+    void LoadState();
 
     void HardwareTick(unsigned int cycles);
     void HaltedTick(unsigned int cycles);
@@ -56,10 +115,60 @@ public:
     void StopLCD();
     void SpeedSwitch();
 private:
-    Emu::SDLContext& sdl_context;
+    // What a clone is constructed with.
+    struct CloneSettings {
+        Console gb_type;
+        const CartridgeHeader& header;
+        const Common::RomView<u8>& rom;
+        AudioFilter audio_filter;
+        bool threaded_render;
+        bool idle_skip;
+    };
+    const CloneSettings clone_settings;
+
+    Emu::Frontend& frontend;
     std::vector<u16> front_buffer;
 
     const std::string save_path;
+    const std::string state_path;
+    Common::SaveWriter save_writer;
+    // Only present when capturing frames.
+    std::unique_ptr<Common::FrameCapture> capture;
+    // Only present when exporting metrics.
+    std::unique_ptr<Common::Metrics> metrics;
+    void RecordMetrics(double frame_time_us);
+    // Only present when exporting to shared memory. While it is, the frontend's buttons are collected in
+    // held_buttons, as with movies.
+    std::unique_ptr<Common::SharedMemoryExport> shm_export;
+
+    // Frames to run ahead of the real frame, if run-ahead is enabled. Speculative frames don't touch anything
+    // outside the emulated machine: saves, movies and captures.
+    int run_ahead = 0;
+    bool speculative = false;
+    Common::StateBuffer run_ahead_state;
+    void RunAheadFrame();
+
+    // Only present while recording or playing back a movie. While it is, the frontend's buttons are collected in
+    // held_buttons and only applied to the joypad at the start of each frame.
+    std::unique_ptr<Common::Movie> movie;
+    Common::StateBuffer movie_state;
+    u8 held_buttons = 0x00;
+    u8 applied_buttons = 0x00;
+    void PressButton(u8 button, bool pressed);
+    void SetButtons(u8 buttons);
+    void UpdateExternalInput();
+    void UpdateMovie();
+    void MovieCheckpoint();
+
+    int overspent_cycles = 0;
+
+    // Only present when rewinding is enabled.
+    std::unique_ptr<Common::RewindBuffer> rewind_buffer;
+    Common::StateBuffer rewind_state;
+    bool rewinding = false;
+
+    // Only present in clones, which own their save memory rather than sharing the caller's.
+    std::unique_ptr<Common::SaveBuffer<u8>> owned_save;
 
     // Game Boy hardware components.
     std::unique_ptr<Timer> timer;
@@ -69,6 +178,11 @@ private:
     std::unique_ptr<Audio> audio;
     std::unique_ptr<Memory> mem;
     std::unique_ptr<CPU> cpu;
+    // Only present when drawing on a separate thread.
+    std::unique_ptr<RenderThread> render_thread;
+
+    // Paces EmulatorLoop. Headless runs are never paced.
+    Common::FramePacer pacer;
 
     bool quit = false;
     bool pause = false;
@@ -78,6 +192,13 @@ private:
     u8 lcd_on_when_stopped = 0x00;
 
     void RegisterCallbacks();
+    void RunFrame();
+    void ReportBreakpoints();
+    void WriteProfile() const;
+
+    bool BatchTimer(unsigned int cycles);
+    bool BatchSerial(unsigned int cycles);
+    bool BatchLCD(unsigned int cycles);
 };
 
 } // End namespace Gb
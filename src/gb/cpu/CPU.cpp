@@ -14,16 +14,21 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <iterator>
 #include <stdexcept>
+#include <utility>
 
 #include "gb/logging/Logging.h"
 #include "gb/cpu/CPU.h"
 #include "gb/memory/Memory.h"
 #include "gb/core/GameBoy.h"
+#include "common/StateBuffer.h"
+#include "common/Profiler.h"
 
 namespace Gb {
 
-CPU::CPU(Memory& memory) : mem(memory) {
+CPU::CPU(Memory& memory, bool enable_idle_skip) : mem(memory), idle_skip(enable_idle_skip) {
     // Initial register values
     if (mem.game_mode == GameMode::DMG) {
         if (mem.console == Console::DMG) {
@@ -61,6 +66,9 @@ CPU::CPU(Memory& memory) : mem(memory) {
 
 u8 CPU::ReadMemAndTick(const u16 addr) {
     const u8 data = mem.ReadMem(addr);
+    if (idle_snapshot_valid) {
+        RecordIdleRead(addr, data);
+    }
     gameboy->HardwareTick(4);
     return data;
 }
@@ -82,6 +90,8 @@ u16 CPU::GetImmediateWord() {
 }
 
 int CPU::RunFor(int cycles) {
+    const int start_cycles = cycles;
+
     // Execute instructions until the specified number of cycles has passed.
     while (cycles > 0) {
         if (cpu_mode == CPUMode::Stopped) {
@@ -98,33 +108,91 @@ int CPU::RunFor(int cycles) {
         cycles -= HandleInterrupts();
 
         if (gameboy->logging.log_level != LogLevel::None) {
+            MaterializeFlags();
+        }
+        if (gameboy->logging.log_level == LogLevel::Binary) {
+            gameboy->logging.TraceCPU(mem, *this, trace_timestamp + (start_cycles - cycles));
+        } else if (gameboy->logging.log_level != LogLevel::None) {
             gameboy->logging.LogCPURegisterState(mem, *this);
         }
 
         if (cpu_mode == CPUMode::Running) {
-            cycles -= ExecuteNext(mem.ReadMem(pc++));
+            const u16 instr_pc = pc;
+            const u8 opcode = mem.FetchOpcode(pc++);
+            const unsigned int instr_cycles = ExecuteNext(opcode);
+            cycles -= instr_cycles;
+            ++counters.instructions;
+
+            if (gameboy->profiler) {
+                Profile(opcode, instr_pc, instr_cycles);
+            }
+
+            if (idle_skip) {
+                const int idle_cycles = IdleLoop(opcode, instr_pc, cycles, trace_timestamp + (start_cycles - cycles));
+                cycles -= idle_cycles;
+                counters.halted_cycles += idle_cycles;
+            }
         } else if (cpu_mode == CPUMode::HaltBug) {
-            cycles -= ExecuteNext(mem.ReadMem(pc));
+            const u16 instr_pc = pc;
+            const u8 opcode = mem.FetchOpcode(pc);
+            const unsigned int instr_cycles = ExecuteNext(opcode);
+            cycles -= instr_cycles;
+            ++counters.instructions;
             cpu_mode = CPUMode::Running;
+
+            if (gameboy->profiler) {
+                Profile(opcode, instr_pc, instr_cycles);
+            }
         } else if (cpu_mode == CPUMode::Halted) {
             gameboy->HaltedTick(4);
             cycles -= 4;
+            counters.halted_cycles += 4;
+
+            if (gameboy->profiler) {
+                gameboy->profiler->Halt(4);
+            }
         }
     }
 
+    trace_timestamp += start_cycles - cycles;
+    counters.cycles += start_cycles - cycles;
+
     // Return the number of overspent cycles.
     return cycles;
 }
 
+u32 CPU::ProfileAddr(u16 addr) const {
+    // Tag addresses in the switchable ROM bank with the bank number, so code from different banks is kept apart.
+    if (addr >= 0x4000 && addr < 0x8000) {
+        return (static_cast<u32>(mem.RomBank()) << 16) | addr;
+    }
+    return addr;
+}
+
+void CPU::Profile(u8 opcode, u16 addr, unsigned int cycles) {
+    gameboy->profiler->Run(ProfileAddr(addr), cycles);
+
+    const bool is_call = opcode == 0xCD || opcode == 0xC4 || opcode == 0xCC || opcode == 0xD4 || opcode == 0xDC;
+    const bool is_rst = (opcode & 0xC7) == 0xC7;
+    if (is_call || is_rst) {
+        // Conditional calls which weren't taken fall through to the next instruction.
+        const u16 return_addr = addr + ((is_call) ? 3 : 1);
+        if (pc != return_addr) {
+            gameboy->profiler->Call(ProfileAddr(return_addr));
+        }
+    }
+}
+
 int CPU::HandleInterrupts() {
     if (interrupt_master_enable) {
         if (mem.RequestedEnabledInterrupts()) {
-            if (gameboy->logging.log_level != LogLevel::None) {
+            if (gameboy->logging.log_level != LogLevel::None && gameboy->logging.log_level != LogLevel::Binary) {
                 gameboy->logging.LogInterrupt(mem);
             }
 
             // Disable interrupts.
             interrupt_master_enable = false;
+            idle_snapshot_valid = false;
 
             // The Game Boy reads IF & IE once to check for pending interrupts. Then it pushes the high byte of PC
             // and waits a total of 4 M-cycles before it reads IF & IE again to see which interrupt to service. As
@@ -153,6 +221,9 @@ int CPU::HandleInterrupts() {
             }
 
             WriteMemAndTick(--regs.reg16[SP], static_cast<u8>(pc));
+            if (gameboy->profiler) {
+                gameboy->profiler->Call(ProfileAddr(pc));
+            }
             pc = interrupt_vector;
 
             if (cpu_mode == CPUMode::Halted) {
@@ -173,6 +244,147 @@ int CPU::HandleInterrupts() {
     return 0;
 }
 
+int CPU::IdleLoop(u8 opcode, u16 instr_pc, int remaining_cycles, u64 timestamp) {
+    if (instr_pc < idle_loop_start || instr_pc > idle_branch_addr) {
+        // Outside of the loop being watched.
+        idle_snapshot_valid = false;
+    }
+
+    const bool is_jr = opcode == 0x18 || (opcode & 0xE7) == 0x20;
+    const bool is_jp = opcode == 0xC3 || (opcode & 0xE7) == 0xC2;
+    if (!is_jr && !is_jp) {
+        return 0;
+    }
+
+    // The flags are compared as part of AF.
+    MaterializeFlags();
+
+    const u16 target = pc;
+    if (target == static_cast<u16>(instr_pc + ((is_jr) ? 2 : 3))) {
+        // Branch not taken.
+        return 0;
+    }
+
+    if (instr_pc == idle_branch_addr && target == idle_loop_start) {
+        if (idle_snapshot_valid && !idle_reads_overflow && !enable_interrupts_delayed
+                && std::equal(idle_regs.cbegin(), idle_regs.cend(), std::cbegin(regs.reg16))
+                && IdleReadsUnchanged()) {
+            return SkipIdleLoop(remaining_cycles, static_cast<unsigned int>(timestamp - idle_snapshot_time));
+        }
+    } else if (idle_snapshot_valid && instr_pc >= idle_loop_start && instr_pc < idle_branch_addr
+                                   && target >= idle_loop_start && target <= idle_branch_addr) {
+        // A branch within the body of the loop being watched.
+        return 0;
+    } else if (target <= instr_pc && instr_pc - target <= max_idle_loop_bytes) {
+        idle_branch_addr = instr_pc;
+        idle_loop_start = target;
+        idle_body_ok = IdleLoopBody(target, instr_pc);
+    } else {
+        idle_snapshot_valid = false;
+        return 0;
+    }
+
+    // Take a snapshot to compare against at the end of the next iteration.
+    idle_snapshot_valid = idle_body_ok;
+    std::copy(std::cbegin(regs.reg16), std::cend(regs.reg16), idle_regs.begin());
+    idle_snapshot_time = timestamp;
+    num_idle_reads = 0;
+    idle_reads_overflow = false;
+
+    return 0;
+}
+
+bool CPU::IdleLoopBody(u16 start_addr, u16 branch_addr) const {
+    u16 addr = start_addr;
+    while (addr < branch_addr) {
+        const unsigned int length = IdleLoopInstructionLength(mem.ReadMem(addr), mem.ReadMem(addr + 1));
+        if (length == 0) {
+            return false;
+        }
+        addr += length;
+    }
+
+    // The instructions must decode to the branch, rather than jumping into the middle of one.
+    return addr == branch_addr;
+}
+
+unsigned int CPU::IdleLoopInstructionLength(u8 opcode, u8 cb_opcode) {
+    // Returns the length of an instruction which may appear in an idle loop, or 0 if it has side effects. Loads
+    // into registers, ALU operations and branches are allowed. Stores, stack operations, calls, returns, HALT, STOP,
+    // and changes to IME are not.
+    if (opcode >= 0x40 && opcode < 0x80) {
+        // LD r, r' and LD r, (HL). Stores to (HL) and HALT are not allowed.
+        return (opcode < 0x70 || opcode > 0x77) ? 1 : 0;
+    } else if (opcode >= 0x80 && opcode < 0xC0) {
+        // ALU operations on A.
+        return 1;
+    }
+
+    switch (opcode) {
+    case 0x00: // NOP
+    case 0x03: case 0x13: case 0x23: case 0x33: // INC rr
+    case 0x0B: case 0x1B: case 0x2B: case 0x3B: // DEC rr
+    case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C: // INC r
+    case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D: // DEC r
+    case 0x07: case 0x0F: case 0x17: case 0x1F: // Rotate A
+    case 0x27: case 0x2F: case 0x37: case 0x3F: // DAA, CPL, SCF, CCF
+    case 0x09: case 0x19: case 0x29: case 0x39: // ADD HL, rr
+    case 0x0A: case 0x1A: case 0x2A: case 0x3A: // LD A, (BC), LD A, (DE), LDI A, (HL), LDD A, (HL)
+    case 0xF2: // LD A, (C)
+        return 1;
+    case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E: // LD r, n
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+    case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: // ALU immediate
+    case 0xF0: // LDH A, (n)
+        return 2;
+    case 0x01: case 0x11: case 0x21: case 0x31: // LD rr, nn
+    case 0xC3: case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP
+    case 0xFA: // LD A, (nn)
+        return 3;
+    case 0xCB:
+        // Only BIT is allowed to operate on (HL).
+        return ((cb_opcode & 0x07) != 0x06 || (cb_opcode >= 0x40 && cb_opcode < 0x80)) ? 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+bool CPU::IdleReadsUnchanged() const {
+    for (std::size_t i = 0; i < num_idle_reads; ++i) {
+        if (mem.ReadMem(idle_reads[i].addr) != idle_reads[i].value) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CPU::RecordIdleRead(u16 addr, u8 value) {
+    // ROM can't change without a store to an MBC register, which an idle loop can't contain.
+    if (addr < 0x8000) {
+        return;
+    }
+
+    if (num_idle_reads == max_idle_reads) {
+        idle_reads_overflow = true;
+        return;
+    }
+
+    idle_reads[num_idle_reads++] = {addr, value};
+}
+
+int CPU::SkipIdleLoop(int remaining_cycles, unsigned int iteration_cycles) {
+    // Run the hardware one iteration at a time, so the loop exits at most one iteration late.
+    int skipped_cycles = 0;
+    while (skipped_cycles < remaining_cycles && IdleReadsUnchanged() && !mem.HDMAInProgress()
+           && !(interrupt_master_enable && mem.RequestedEnabledInterrupts())) {
+        gameboy->HaltedTick(iteration_cycles);
+        skipped_cycles += iteration_cycles;
+    }
+
+    return skipped_cycles;
+}
+
 void CPU::EnableInterruptsDelayed() {
     interrupt_master_enable = interrupt_master_enable || enable_interrupts_delayed;
     enable_interrupts_delayed = false;
@@ -205,7 +417,8 @@ void CPU::StoppedTick() {
     }
 }
 
-unsigned int CPU::ExecuteNext(const u8 opcode) {
+template<u8 opcode>
+unsigned int CPU::ExecuteOpcode() {
     gameboy->HardwareTick(4);
 
     switch (opcode) {
@@ -1271,841 +1484,7 @@ unsigned int CPU::ExecuteNext(const u8 opcode) {
     // ******** CB prefix opcodes ********
     case 0xCB:
         // Get opcode suffix from next byte.
-        switch (GetImmediateByte()) {
-        // ******** Rotates and Shifts ********
-        // RLC R -- Left rotate the value in register R.
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Set to value in bit 7 before the rotate
-        case 0x00:
-            RotateLeft(B);
-            return 8;
-        case 0x01:
-            RotateLeft(C);
-            return 8;
-        case 0x02:
-            RotateLeft(D);
-            return 8;
-        case 0x03:
-            RotateLeft(E);
-            return 8;
-        case 0x04:
-            RotateLeft(H);
-            return 8;
-        case 0x05:
-            RotateLeft(L);
-            return 8;
-        case 0x06:
-            RotateLeftMemAtHL();
-            return 16;
-        case 0x07:
-            RotateLeft(A);
-            return 8;
-        // RL R -- Left rotate the value in register R through the carry flag.
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Set to value in bit 7 before the rotate
-        case 0x10:
-            RotateLeftThroughCarry(B);
-            return 8;
-        case 0x11:
-            RotateLeftThroughCarry(C);
-            return 8;
-        case 0x12:
-            RotateLeftThroughCarry(D);
-            return 8;
-        case 0x13:
-            RotateLeftThroughCarry(E);
-            return 8;
-        case 0x14:
-            RotateLeftThroughCarry(H);
-            return 8;
-        case 0x15:
-            RotateLeftThroughCarry(L);
-            return 8;
-        case 0x16:
-            RotateLeftMemAtHLThroughCarry();
-            return 16;
-        case 0x17:
-            RotateLeftThroughCarry(A);
-            return 8;
-        // RRC R -- Right rotate the value in register R.
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Set to value in bit 0 before the rotate
-        case 0x08:
-            RotateRight(B);
-            return 8;
-        case 0x09:
-            RotateRight(C);
-            return 8;
-        case 0x0A:
-            RotateRight(D);
-            return 8;
-        case 0x0B:
-            RotateRight(E);
-            return 8;
-        case 0x0C:
-            RotateRight(H);
-            return 8;
-        case 0x0D:
-            RotateRight(L);
-            return 8;
-        case 0x0E:
-            RotateRightMemAtHL();
-            return 16;
-        case 0x0F:
-            RotateRight(A);
-            return 8;
-        // RR R -- Right rotate the value in register R through the carry flag.
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Set to value in bit 0 before the rotate
-        case 0x18:
-            RotateRightThroughCarry(B);
-            return 8;
-        case 0x19:
-            RotateRightThroughCarry(C);
-            return 8;
-        case 0x1A:
-            RotateRightThroughCarry(D);
-            return 8;
-        case 0x1B:
-            RotateRightThroughCarry(E);
-            return 8;
-        case 0x1C:
-            RotateRightThroughCarry(H);
-            return 8;
-        case 0x1D:
-            RotateRightThroughCarry(L);
-            return 8;
-        case 0x1E:
-            RotateRightMemAtHLThroughCarry();
-            return 16;
-        case 0x1F:
-            RotateRightThroughCarry(A);
-            return 8;
-        // SLA R -- Left shift the value in register R into the carry flag.
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Set to value in bit 0 before the rotate
-        case 0x20:
-            ShiftLeft(B);
-            return 8;
-        case 0x21:
-            ShiftLeft(C);
-            return 8;
-        case 0x22:
-            ShiftLeft(D);
-            return 8;
-        case 0x23:
-            ShiftLeft(E);
-            return 8;
-        case 0x24:
-            ShiftLeft(H);
-            return 8;
-        case 0x25:
-            ShiftLeft(L);
-            return 8;
-        case 0x26:
-            ShiftLeftMemAtHL();
-            return 16;
-        case 0x27:
-            ShiftLeft(A);
-            return 8;
-        // SRA R -- Arithmetic right shift the value in register R into the carry flag.
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Set to value in bit 0 before the rotate
-        case 0x28:
-            ShiftRightArithmetic(B);
-            return 8;
-        case 0x29:
-            ShiftRightArithmetic(C);
-            return 8;
-        case 0x2A:
-            ShiftRightArithmetic(D);
-            return 8;
-        case 0x2B:
-            ShiftRightArithmetic(E);
-            return 8;
-        case 0x2C:
-            ShiftRightArithmetic(H);
-            return 8;
-        case 0x2D:
-            ShiftRightArithmetic(L);
-            return 8;
-        case 0x2E:
-            ShiftRightArithmeticMemAtHL();
-            return 16;
-        case 0x2F:
-            ShiftRightArithmetic(A);
-            return 8;
-        // SWAP R -- Swap upper and lower nybbles of register R (rotate by 4).
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Reset
-        case 0x30:
-            SwapNybbles(B);
-            return 8;
-        case 0x31:
-            SwapNybbles(C);
-            return 8;
-        case 0x32:
-            SwapNybbles(D);
-            return 8;
-        case 0x33:
-            SwapNybbles(E);
-            return 8;
-        case 0x34:
-            SwapNybbles(H);
-            return 8;
-        case 0x35:
-            SwapNybbles(L);
-            return 8;
-        case 0x36:
-            SwapMemAtHL();
-            return 16;
-        case 0x37:
-            SwapNybbles(A);
-            return 8;
-        // SRL R -- Logical right shift the value in register R into the carry flag.
-        // Flags:
-        //     Z: Set if result is zero
-        //     N: Reset
-        //     H: Reset
-        //     C: Set to value in bit 0 before the rotate
-        case 0x38:
-            ShiftRightLogical(B);
-            return 8;
-        case 0x39:
-            ShiftRightLogical(C);
-            return 8;
-        case 0x3A:
-            ShiftRightLogical(D);
-            return 8;
-        case 0x3B:
-            ShiftRightLogical(E);
-            return 8;
-        case 0x3C:
-            ShiftRightLogical(H);
-            return 8;
-        case 0x3D:
-            ShiftRightLogical(L);
-            return 8;
-        case 0x3E:
-            ShiftRightLogicalMemAtHL();
-            return 16;
-        case 0x3F:
-            ShiftRightLogical(A);
-            return 8;
-
-        // ******** Bit Manipulation ********
-        // BIT b, R -- test bit b of the value in register R.
-        // Flags:
-        //     Z: Set if bit b of R is zero
-        //     N: Reset
-        //     H: Set
-        //     C: Unchanged
-        case 0x40:
-            TestBit(0, B);
-            return 8;
-        case 0x41:
-            TestBit(0, C);
-            return 8;
-        case 0x42:
-            TestBit(0, D);
-            return 8;
-        case 0x43:
-            TestBit(0, E);
-            return 8;
-        case 0x44:
-            TestBit(0, H);
-            return 8;
-        case 0x45:
-            TestBit(0, L);
-            return 8;
-        case 0x46:
-            TestBitOfMemAtHL(0);
-            return 12;
-        case 0x47:
-            TestBit(0, A);
-            return 8;
-        case 0x48:
-            TestBit(1, B);
-            return 8;
-        case 0x49:
-            TestBit(1, C);
-            return 8;
-        case 0x4A:
-            TestBit(1, D);
-            return 8;
-        case 0x4B:
-            TestBit(1, E);
-            return 8;
-        case 0x4C:
-            TestBit(1, H);
-            return 8;
-        case 0x4D:
-            TestBit(1, L);
-            return 8;
-        case 0x4E:
-            TestBitOfMemAtHL(1);
-            return 12;
-        case 0x4F:
-            TestBit(1, A);
-            return 8;
-        case 0x50:
-            TestBit(2, B);
-            return 8;
-        case 0x51:
-            TestBit(2, C);
-            return 8;
-        case 0x52:
-            TestBit(2, D);
-            return 8;
-        case 0x53:
-            TestBit(2, E);
-            return 8;
-        case 0x54:
-            TestBit(2, H);
-            return 8;
-        case 0x55:
-            TestBit(2, L);
-            return 8;
-        case 0x56:
-            TestBitOfMemAtHL(2);
-            return 12;
-        case 0x57:
-            TestBit(2, A);
-            return 8;
-        case 0x58:
-            TestBit(3, B);
-            return 8;
-        case 0x59:
-            TestBit(3, C);
-            return 8;
-        case 0x5A:
-            TestBit(3, D);
-            return 8;
-        case 0x5B:
-            TestBit(3, E);
-            return 8;
-        case 0x5C:
-            TestBit(3, H);
-            return 8;
-        case 0x5D:
-            TestBit(3, L);
-            return 8;
-        case 0x5E:
-            TestBitOfMemAtHL(3);
-            return 12;
-        case 0x5F:
-            TestBit(3, A);
-            return 8;
-        case 0x60:
-            TestBit(4, B);
-            return 8;
-        case 0x61:
-            TestBit(4, C);
-            return 8;
-        case 0x62:
-            TestBit(4, D);
-            return 8;
-        case 0x63:
-            TestBit(4, E);
-            return 8;
-        case 0x64:
-            TestBit(4, H);
-            return 8;
-        case 0x65:
-            TestBit(4, L);
-            return 8;
-        case 0x66:
-            TestBitOfMemAtHL(4);
-            return 12;
-        case 0x67:
-            TestBit(4, A);
-            return 8;
-        case 0x68:
-            TestBit(5, B);
-            return 8;
-        case 0x69:
-            TestBit(5, C);
-            return 8;
-        case 0x6A:
-            TestBit(5, D);
-            return 8;
-        case 0x6B:
-            TestBit(5, E);
-            return 8;
-        case 0x6C:
-            TestBit(5, H);
-            return 8;
-        case 0x6D:
-            TestBit(5, L);
-            return 8;
-        case 0x6E:
-            TestBitOfMemAtHL(5);
-            return 12;
-        case 0x6F:
-            TestBit(5, A);
-            return 8;
-        case 0x70:
-            TestBit(6, B);
-            return 8;
-        case 0x71:
-            TestBit(6, C);
-            return 8;
-        case 0x72:
-            TestBit(6, D);
-            return 8;
-        case 0x73:
-            TestBit(6, E);
-            return 8;
-        case 0x74:
-            TestBit(6, H);
-            return 8;
-        case 0x75:
-            TestBit(6, L);
-            return 8;
-        case 0x76:
-            TestBitOfMemAtHL(6);
-            return 12;
-        case 0x77:
-            TestBit(6, A);
-            return 8;
-        case 0x78:
-            TestBit(7, B);
-            return 8;
-        case 0x79:
-            TestBit(7, C);
-            return 8;
-        case 0x7A:
-            TestBit(7, D);
-            return 8;
-        case 0x7B:
-            TestBit(7, E);
-            return 8;
-        case 0x7C:
-            TestBit(7, H);
-            return 8;
-        case 0x7D:
-            TestBit(7, L);
-            return 8;
-        case 0x7E:
-            TestBitOfMemAtHL(7);
-            return 12;
-        case 0x7F:
-            TestBit(7, A);
-            return 8;
-        // RES b, R -- reset bit b of the value in register R.
-        // Flags unchanged
-        case 0x80:
-            ResetBit(0, B);
-            return 8;
-        case 0x81:
-            ResetBit(0, C);
-            return 8;
-        case 0x82:
-            ResetBit(0, D);
-            return 8;
-        case 0x83:
-            ResetBit(0, E);
-            return 8;
-        case 0x84:
-            ResetBit(0, H);
-            return 8;
-        case 0x85:
-            ResetBit(0, L);
-            return 8;
-        case 0x86:
-            ResetBitOfMemAtHL(0);
-            return 16;
-        case 0x87:
-            ResetBit(0, A);
-            return 8;
-        case 0x88:
-            ResetBit(1, B);
-            return 8;
-        case 0x89:
-            ResetBit(1, C);
-            return 8;
-        case 0x8A:
-            ResetBit(1, D);
-            return 8;
-        case 0x8B:
-            ResetBit(1, E);
-            return 8;
-        case 0x8C:
-            ResetBit(1, H);
-            return 8;
-        case 0x8D:
-            ResetBit(1, L);
-            return 8;
-        case 0x8E:
-            ResetBitOfMemAtHL(1);
-            return 16;
-        case 0x8F:
-            ResetBit(1, A);
-            return 8;
-        case 0x90:
-            ResetBit(2, B);
-            return 8;
-        case 0x91:
-            ResetBit(2, C);
-            return 8;
-        case 0x92:
-            ResetBit(2, D);
-            return 8;
-        case 0x93:
-            ResetBit(2, E);
-            return 8;
-        case 0x94:
-            ResetBit(2, H);
-            return 8;
-        case 0x95:
-            ResetBit(2, L);
-            return 8;
-        case 0x96:
-            ResetBitOfMemAtHL(2);
-            return 16;
-        case 0x97:
-            ResetBit(2, A);
-            return 8;
-        case 0x98:
-            ResetBit(3, B);
-            return 8;
-        case 0x99:
-            ResetBit(3, C);
-            return 8;
-        case 0x9A:
-            ResetBit(3, D);
-            return 8;
-        case 0x9B:
-            ResetBit(3, E);
-            return 8;
-        case 0x9C:
-            ResetBit(3, H);
-            return 8;
-        case 0x9D:
-            ResetBit(3, L);
-            return 8;
-        case 0x9E:
-            ResetBitOfMemAtHL(3);
-            return 16;
-        case 0x9F:
-            ResetBit(3, A);
-            return 8;
-        case 0xA0:
-            ResetBit(4, B);
-            return 8;
-        case 0xA1:
-            ResetBit(4, C);
-            return 8;
-        case 0xA2:
-            ResetBit(4, D);
-            return 8;
-        case 0xA3:
-            ResetBit(4, E);
-            return 8;
-        case 0xA4:
-            ResetBit(4, H);
-            return 8;
-        case 0xA5:
-            ResetBit(4, L);
-            return 8;
-        case 0xA6:
-            ResetBitOfMemAtHL(4);
-            return 16;
-        case 0xA7:
-            ResetBit(4, A);
-            return 8;
-        case 0xA8:
-            ResetBit(5, B);
-            return 8;
-        case 0xA9:
-            ResetBit(5, C);
-            return 8;
-        case 0xAA:
-            ResetBit(5, D);
-            return 8;
-        case 0xAB:
-            ResetBit(5, E);
-            return 8;
-        case 0xAC:
-            ResetBit(5, H);
-            return 8;
-        case 0xAD:
-            ResetBit(5, L);
-            return 8;
-        case 0xAE:
-            ResetBitOfMemAtHL(5);
-            return 16;
-        case 0xAF:
-            ResetBit(5, A);
-            return 8;
-        case 0xB0:
-            ResetBit(6, B);
-            return 8;
-        case 0xB1:
-            ResetBit(6, C);
-            return 8;
-        case 0xB2:
-            ResetBit(6, D);
-            return 8;
-        case 0xB3:
-            ResetBit(6, E);
-            return 8;
-        case 0xB4:
-            ResetBit(6, H);
-            return 8;
-        case 0xB5:
-            ResetBit(6, L);
-            return 8;
-        case 0xB6:
-            ResetBitOfMemAtHL(6);
-            return 16;
-        case 0xB7:
-            ResetBit(6, A);
-            return 8;
-        case 0xB8:
-            ResetBit(7, B);
-            return 8;
-        case 0xB9:
-            ResetBit(7, C);
-            return 8;
-        case 0xBA:
-            ResetBit(7, D);
-            return 8;
-        case 0xBB:
-            ResetBit(7, E);
-            return 8;
-        case 0xBC:
-            ResetBit(7, H);
-            return 8;
-        case 0xBD:
-            ResetBit(7, L);
-            return 8;
-        case 0xBE:
-            ResetBitOfMemAtHL(7);
-            return 16;
-        case 0xBF:
-            ResetBit(7, A);
-            return 8;
-        // SET b, R -- set bit b of the value in register R.
-        // Flags unchanged
-        case 0xC0:
-            SetBit(0, B);
-            return 8;
-        case 0xC1:
-            SetBit(0, C);
-            return 8;
-        case 0xC2:
-            SetBit(0, D);
-            return 8;
-        case 0xC3:
-            SetBit(0, E);
-            return 8;
-        case 0xC4:
-            SetBit(0, H);
-            return 8;
-        case 0xC5:
-            SetBit(0, L);
-            return 8;
-        case 0xC6:
-            SetBitOfMemAtHL(0);
-            return 16;
-        case 0xC7:
-            SetBit(0, A);
-            return 8;
-        case 0xC8:
-            SetBit(1, B);
-            return 8;
-        case 0xC9:
-            SetBit(1, C);
-            return 8;
-        case 0xCA:
-            SetBit(1, D);
-            return 8;
-        case 0xCB:
-            SetBit(1, E);
-            return 8;
-        case 0xCC:
-            SetBit(1, H);
-            return 8;
-        case 0xCD:
-            SetBit(1, L);
-            return 8;
-        case 0xCE:
-            SetBitOfMemAtHL(1);
-            return 16;
-        case 0xCF:
-            SetBit(1, A);
-            return 8;
-        case 0xD0:
-            SetBit(2, B);
-            return 8;
-        case 0xD1:
-            SetBit(2, C);
-            return 8;
-        case 0xD2:
-            SetBit(2, D);
-            return 8;
-        case 0xD3:
-            SetBit(2, E);
-            return 8;
-        case 0xD4:
-            SetBit(2, H);
-            return 8;
-        case 0xD5:
-            SetBit(2, L);
-            return 8;
-        case 0xD6:
-            SetBitOfMemAtHL(2);
-            return 16;
-        case 0xD7:
-            SetBit(2, A);
-            return 8;
-        case 0xD8:
-            SetBit(3, B);
-            return 8;
-        case 0xD9:
-            SetBit(3, C);
-            return 8;
-        case 0xDA:
-            SetBit(3, D);
-            return 8;
-        case 0xDB:
-            SetBit(3, E);
-            return 8;
-        case 0xDC:
-            SetBit(3, H);
-            return 8;
-        case 0xDD:
-            SetBit(3, L);
-            return 8;
-        case 0xDE:
-            SetBitOfMemAtHL(3);
-            return 16;
-        case 0xDF:
-            SetBit(3, A);
-            return 8;
-        case 0xE0:
-            SetBit(4, B);
-            return 8;
-        case 0xE1:
-            SetBit(4, C);
-            return 8;
-        case 0xE2:
-            SetBit(4, D);
-            return 8;
-        case 0xE3:
-            SetBit(4, E);
-            return 8;
-        case 0xE4:
-            SetBit(4, H);
-            return 8;
-        case 0xE5:
-            SetBit(4, L);
-            return 8;
-        case 0xE6:
-            SetBitOfMemAtHL(4);
-            return 16;
-        case 0xE7:
-            SetBit(4, A);
-            return 8;
-        case 0xE8:
-            SetBit(5, B);
-            return 8;
-        case 0xE9:
-            SetBit(5, C);
-            return 8;
-        case 0xEA:
-            SetBit(5, D);
-            return 8;
-        case 0xEB:
-            SetBit(5, E);
-            return 8;
-        case 0xEC:
-            SetBit(5, H);
-            return 8;
-        case 0xED:
-            SetBit(5, L);
-            return 8;
-        case 0xEE:
-            SetBitOfMemAtHL(5);
-            return 16;
-        case 0xEF:
-            SetBit(5, A);
-            return 8;
-        case 0xF0:
-            SetBit(6, B);
-            return 8;
-        case 0xF1:
-            SetBit(6, C);
-            return 8;
-        case 0xF2:
-            SetBit(6, D);
-            return 8;
-        case 0xF3:
-            SetBit(6, E);
-            return 8;
-        case 0xF4:
-            SetBit(6, H);
-            return 8;
-        case 0xF5:
-            SetBit(6, L);
-            return 8;
-        case 0xF6:
-            SetBitOfMemAtHL(6);
-            return 16;
-        case 0xF7:
-            SetBit(6, A);
-            return 8;
-        case 0xF8:
-            SetBit(7, B);
-            return 8;
-        case 0xF9:
-            SetBit(7, C);
-            return 8;
-        case 0xFA:
-            SetBit(7, D);
-            return 8;
-        case 0xFB:
-            SetBit(7, E);
-            return 8;
-        case 0xFC:
-            SetBit(7, H);
-            return 8;
-        case 0xFD:
-            SetBit(7, L);
-            return 8;
-        case 0xFE:
-            SetBitOfMemAtHL(7);
-            return 16;
-        case 0xFF:
-            SetBit(7, A);
-            return 8;
-
-        default:
-            // Unreachable, every possible case is specified above.
-            return 8;
-        }
+        return (this->*cb_opcode_table[GetImmediateByte()])();
 
     default:
         throw std::runtime_error("The CPU has hung. Reason: unknown opcode.");
@@ -2113,4 +1492,879 @@ unsigned int CPU::ExecuteNext(const u8 opcode) {
     }
 }
 
+template<u8 cb_opcode>
+unsigned int CPU::ExecuteCBOpcode() {
+    switch (cb_opcode) {
+    // ******** Rotates and Shifts ********
+    // RLC R -- Left rotate the value in register R.
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Set to value in bit 7 before the rotate
+    case 0x00:
+        RotateLeft(B);
+        return 8;
+    case 0x01:
+        RotateLeft(C);
+        return 8;
+    case 0x02:
+        RotateLeft(D);
+        return 8;
+    case 0x03:
+        RotateLeft(E);
+        return 8;
+    case 0x04:
+        RotateLeft(H);
+        return 8;
+    case 0x05:
+        RotateLeft(L);
+        return 8;
+    case 0x06:
+        RotateLeftMemAtHL();
+        return 16;
+    case 0x07:
+        RotateLeft(A);
+        return 8;
+    // RL R -- Left rotate the value in register R through the carry flag.
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Set to value in bit 7 before the rotate
+    case 0x10:
+        RotateLeftThroughCarry(B);
+        return 8;
+    case 0x11:
+        RotateLeftThroughCarry(C);
+        return 8;
+    case 0x12:
+        RotateLeftThroughCarry(D);
+        return 8;
+    case 0x13:
+        RotateLeftThroughCarry(E);
+        return 8;
+    case 0x14:
+        RotateLeftThroughCarry(H);
+        return 8;
+    case 0x15:
+        RotateLeftThroughCarry(L);
+        return 8;
+    case 0x16:
+        RotateLeftMemAtHLThroughCarry();
+        return 16;
+    case 0x17:
+        RotateLeftThroughCarry(A);
+        return 8;
+    // RRC R -- Right rotate the value in register R.
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Set to value in bit 0 before the rotate
+    case 0x08:
+        RotateRight(B);
+        return 8;
+    case 0x09:
+        RotateRight(C);
+        return 8;
+    case 0x0A:
+        RotateRight(D);
+        return 8;
+    case 0x0B:
+        RotateRight(E);
+        return 8;
+    case 0x0C:
+        RotateRight(H);
+        return 8;
+    case 0x0D:
+        RotateRight(L);
+        return 8;
+    case 0x0E:
+        RotateRightMemAtHL();
+        return 16;
+    case 0x0F:
+        RotateRight(A);
+        return 8;
+    // RR R -- Right rotate the value in register R through the carry flag.
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Set to value in bit 0 before the rotate
+    case 0x18:
+        RotateRightThroughCarry(B);
+        return 8;
+    case 0x19:
+        RotateRightThroughCarry(C);
+        return 8;
+    case 0x1A:
+        RotateRightThroughCarry(D);
+        return 8;
+    case 0x1B:
+        RotateRightThroughCarry(E);
+        return 8;
+    case 0x1C:
+        RotateRightThroughCarry(H);
+        return 8;
+    case 0x1D:
+        RotateRightThroughCarry(L);
+        return 8;
+    case 0x1E:
+        RotateRightMemAtHLThroughCarry();
+        return 16;
+    case 0x1F:
+        RotateRightThroughCarry(A);
+        return 8;
+    // SLA R -- Left shift the value in register R into the carry flag.
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Set to value in bit 0 before the rotate
+    case 0x20:
+        ShiftLeft(B);
+        return 8;
+    case 0x21:
+        ShiftLeft(C);
+        return 8;
+    case 0x22:
+        ShiftLeft(D);
+        return 8;
+    case 0x23:
+        ShiftLeft(E);
+        return 8;
+    case 0x24:
+        ShiftLeft(H);
+        return 8;
+    case 0x25:
+        ShiftLeft(L);
+        return 8;
+    case 0x26:
+        ShiftLeftMemAtHL();
+        return 16;
+    case 0x27:
+        ShiftLeft(A);
+        return 8;
+    // SRA R -- Arithmetic right shift the value in register R into the carry flag.
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Set to value in bit 0 before the rotate
+    case 0x28:
+        ShiftRightArithmetic(B);
+        return 8;
+    case 0x29:
+        ShiftRightArithmetic(C);
+        return 8;
+    case 0x2A:
+        ShiftRightArithmetic(D);
+        return 8;
+    case 0x2B:
+        ShiftRightArithmetic(E);
+        return 8;
+    case 0x2C:
+        ShiftRightArithmetic(H);
+        return 8;
+    case 0x2D:
+        ShiftRightArithmetic(L);
+        return 8;
+    case 0x2E:
+        ShiftRightArithmeticMemAtHL();
+        return 16;
+    case 0x2F:
+        ShiftRightArithmetic(A);
+        return 8;
+    // SWAP R -- Swap upper and lower nybbles of register R (rotate by 4).
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Reset
+    case 0x30:
+        SwapNybbles(B);
+        return 8;
+    case 0x31:
+        SwapNybbles(C);
+        return 8;
+    case 0x32:
+        SwapNybbles(D);
+        return 8;
+    case 0x33:
+        SwapNybbles(E);
+        return 8;
+    case 0x34:
+        SwapNybbles(H);
+        return 8;
+    case 0x35:
+        SwapNybbles(L);
+        return 8;
+    case 0x36:
+        SwapMemAtHL();
+        return 16;
+    case 0x37:
+        SwapNybbles(A);
+        return 8;
+    // SRL R -- Logical right shift the value in register R into the carry flag.
+    // Flags:
+    //     Z: Set if result is zero
+    //     N: Reset
+    //     H: Reset
+    //     C: Set to value in bit 0 before the rotate
+    case 0x38:
+        ShiftRightLogical(B);
+        return 8;
+    case 0x39:
+        ShiftRightLogical(C);
+        return 8;
+    case 0x3A:
+        ShiftRightLogical(D);
+        return 8;
+    case 0x3B:
+        ShiftRightLogical(E);
+        return 8;
+    case 0x3C:
+        ShiftRightLogical(H);
+        return 8;
+    case 0x3D:
+        ShiftRightLogical(L);
+        return 8;
+    case 0x3E:
+        ShiftRightLogicalMemAtHL();
+        return 16;
+    case 0x3F:
+        ShiftRightLogical(A);
+        return 8;
+
+    // ******** Bit Manipulation ********
+    // BIT b, R -- test bit b of the value in register R.
+    // Flags:
+    //     Z: Set if bit b of R is zero
+    //     N: Reset
+    //     H: Set
+    //     C: Unchanged
+    case 0x40:
+        TestBit(0, B);
+        return 8;
+    case 0x41:
+        TestBit(0, C);
+        return 8;
+    case 0x42:
+        TestBit(0, D);
+        return 8;
+    case 0x43:
+        TestBit(0, E);
+        return 8;
+    case 0x44:
+        TestBit(0, H);
+        return 8;
+    case 0x45:
+        TestBit(0, L);
+        return 8;
+    case 0x46:
+        TestBitOfMemAtHL(0);
+        return 12;
+    case 0x47:
+        TestBit(0, A);
+        return 8;
+    case 0x48:
+        TestBit(1, B);
+        return 8;
+    case 0x49:
+        TestBit(1, C);
+        return 8;
+    case 0x4A:
+        TestBit(1, D);
+        return 8;
+    case 0x4B:
+        TestBit(1, E);
+        return 8;
+    case 0x4C:
+        TestBit(1, H);
+        return 8;
+    case 0x4D:
+        TestBit(1, L);
+        return 8;
+    case 0x4E:
+        TestBitOfMemAtHL(1);
+        return 12;
+    case 0x4F:
+        TestBit(1, A);
+        return 8;
+    case 0x50:
+        TestBit(2, B);
+        return 8;
+    case 0x51:
+        TestBit(2, C);
+        return 8;
+    case 0x52:
+        TestBit(2, D);
+        return 8;
+    case 0x53:
+        TestBit(2, E);
+        return 8;
+    case 0x54:
+        TestBit(2, H);
+        return 8;
+    case 0x55:
+        TestBit(2, L);
+        return 8;
+    case 0x56:
+        TestBitOfMemAtHL(2);
+        return 12;
+    case 0x57:
+        TestBit(2, A);
+        return 8;
+    case 0x58:
+        TestBit(3, B);
+        return 8;
+    case 0x59:
+        TestBit(3, C);
+        return 8;
+    case 0x5A:
+        TestBit(3, D);
+        return 8;
+    case 0x5B:
+        TestBit(3, E);
+        return 8;
+    case 0x5C:
+        TestBit(3, H);
+        return 8;
+    case 0x5D:
+        TestBit(3, L);
+        return 8;
+    case 0x5E:
+        TestBitOfMemAtHL(3);
+        return 12;
+    case 0x5F:
+        TestBit(3, A);
+        return 8;
+    case 0x60:
+        TestBit(4, B);
+        return 8;
+    case 0x61:
+        TestBit(4, C);
+        return 8;
+    case 0x62:
+        TestBit(4, D);
+        return 8;
+    case 0x63:
+        TestBit(4, E);
+        return 8;
+    case 0x64:
+        TestBit(4, H);
+        return 8;
+    case 0x65:
+        TestBit(4, L);
+        return 8;
+    case 0x66:
+        TestBitOfMemAtHL(4);
+        return 12;
+    case 0x67:
+        TestBit(4, A);
+        return 8;
+    case 0x68:
+        TestBit(5, B);
+        return 8;
+    case 0x69:
+        TestBit(5, C);
+        return 8;
+    case 0x6A:
+        TestBit(5, D);
+        return 8;
+    case 0x6B:
+        TestBit(5, E);
+        return 8;
+    case 0x6C:
+        TestBit(5, H);
+        return 8;
+    case 0x6D:
+        TestBit(5, L);
+        return 8;
+    case 0x6E:
+        TestBitOfMemAtHL(5);
+        return 12;
+    case 0x6F:
+        TestBit(5, A);
+        return 8;
+    case 0x70:
+        TestBit(6, B);
+        return 8;
+    case 0x71:
+        TestBit(6, C);
+        return 8;
+    case 0x72:
+        TestBit(6, D);
+        return 8;
+    case 0x73:
+        TestBit(6, E);
+        return 8;
+    case 0x74:
+        TestBit(6, H);
+        return 8;
+    case 0x75:
+        TestBit(6, L);
+        return 8;
+    case 0x76:
+        TestBitOfMemAtHL(6);
+        return 12;
+    case 0x77:
+        TestBit(6, A);
+        return 8;
+    case 0x78:
+        TestBit(7, B);
+        return 8;
+    case 0x79:
+        TestBit(7, C);
+        return 8;
+    case 0x7A:
+        TestBit(7, D);
+        return 8;
+    case 0x7B:
+        TestBit(7, E);
+        return 8;
+    case 0x7C:
+        TestBit(7, H);
+        return 8;
+    case 0x7D:
+        TestBit(7, L);
+        return 8;
+    case 0x7E:
+        TestBitOfMemAtHL(7);
+        return 12;
+    case 0x7F:
+        TestBit(7, A);
+        return 8;
+    // RES b, R -- reset bit b of the value in register R.
+    // Flags unchanged
+    case 0x80:
+        ResetBit(0, B);
+        return 8;
+    case 0x81:
+        ResetBit(0, C);
+        return 8;
+    case 0x82:
+        ResetBit(0, D);
+        return 8;
+    case 0x83:
+        ResetBit(0, E);
+        return 8;
+    case 0x84:
+        ResetBit(0, H);
+        return 8;
+    case 0x85:
+        ResetBit(0, L);
+        return 8;
+    case 0x86:
+        ResetBitOfMemAtHL(0);
+        return 16;
+    case 0x87:
+        ResetBit(0, A);
+        return 8;
+    case 0x88:
+        ResetBit(1, B);
+        return 8;
+    case 0x89:
+        ResetBit(1, C);
+        return 8;
+    case 0x8A:
+        ResetBit(1, D);
+        return 8;
+    case 0x8B:
+        ResetBit(1, E);
+        return 8;
+    case 0x8C:
+        ResetBit(1, H);
+        return 8;
+    case 0x8D:
+        ResetBit(1, L);
+        return 8;
+    case 0x8E:
+        ResetBitOfMemAtHL(1);
+        return 16;
+    case 0x8F:
+        ResetBit(1, A);
+        return 8;
+    case 0x90:
+        ResetBit(2, B);
+        return 8;
+    case 0x91:
+        ResetBit(2, C);
+        return 8;
+    case 0x92:
+        ResetBit(2, D);
+        return 8;
+    case 0x93:
+        ResetBit(2, E);
+        return 8;
+    case 0x94:
+        ResetBit(2, H);
+        return 8;
+    case 0x95:
+        ResetBit(2, L);
+        return 8;
+    case 0x96:
+        ResetBitOfMemAtHL(2);
+        return 16;
+    case 0x97:
+        ResetBit(2, A);
+        return 8;
+    case 0x98:
+        ResetBit(3, B);
+        return 8;
+    case 0x99:
+        ResetBit(3, C);
+        return 8;
+    case 0x9A:
+        ResetBit(3, D);
+        return 8;
+    case 0x9B:
+        ResetBit(3, E);
+        return 8;
+    case 0x9C:
+        ResetBit(3, H);
+        return 8;
+    case 0x9D:
+        ResetBit(3, L);
+        return 8;
+    case 0x9E:
+        ResetBitOfMemAtHL(3);
+        return 16;
+    case 0x9F:
+        ResetBit(3, A);
+        return 8;
+    case 0xA0:
+        ResetBit(4, B);
+        return 8;
+    case 0xA1:
+        ResetBit(4, C);
+        return 8;
+    case 0xA2:
+        ResetBit(4, D);
+        return 8;
+    case 0xA3:
+        ResetBit(4, E);
+        return 8;
+    case 0xA4:
+        ResetBit(4, H);
+        return 8;
+    case 0xA5:
+        ResetBit(4, L);
+        return 8;
+    case 0xA6:
+        ResetBitOfMemAtHL(4);
+        return 16;
+    case 0xA7:
+        ResetBit(4, A);
+        return 8;
+    case 0xA8:
+        ResetBit(5, B);
+        return 8;
+    case 0xA9:
+        ResetBit(5, C);
+        return 8;
+    case 0xAA:
+        ResetBit(5, D);
+        return 8;
+    case 0xAB:
+        ResetBit(5, E);
+        return 8;
+    case 0xAC:
+        ResetBit(5, H);
+        return 8;
+    case 0xAD:
+        ResetBit(5, L);
+        return 8;
+    case 0xAE:
+        ResetBitOfMemAtHL(5);
+        return 16;
+    case 0xAF:
+        ResetBit(5, A);
+        return 8;
+    case 0xB0:
+        ResetBit(6, B);
+        return 8;
+    case 0xB1:
+        ResetBit(6, C);
+        return 8;
+    case 0xB2:
+        ResetBit(6, D);
+        return 8;
+    case 0xB3:
+        ResetBit(6, E);
+        return 8;
+    case 0xB4:
+        ResetBit(6, H);
+        return 8;
+    case 0xB5:
+        ResetBit(6, L);
+        return 8;
+    case 0xB6:
+        ResetBitOfMemAtHL(6);
+        return 16;
+    case 0xB7:
+        ResetBit(6, A);
+        return 8;
+    case 0xB8:
+        ResetBit(7, B);
+        return 8;
+    case 0xB9:
+        ResetBit(7, C);
+        return 8;
+    case 0xBA:
+        ResetBit(7, D);
+        return 8;
+    case 0xBB:
+        ResetBit(7, E);
+        return 8;
+    case 0xBC:
+        ResetBit(7, H);
+        return 8;
+    case 0xBD:
+        ResetBit(7, L);
+        return 8;
+    case 0xBE:
+        ResetBitOfMemAtHL(7);
+        return 16;
+    case 0xBF:
+        ResetBit(7, A);
+        return 8;
+    // SET b, R -- set bit b of the value in register R.
+    // Flags unchanged
+    case 0xC0:
+        SetBit(0, B);
+        return 8;
+    case 0xC1:
+        SetBit(0, C);
+        return 8;
+    case 0xC2:
+        SetBit(0, D);
+        return 8;
+    case 0xC3:
+        SetBit(0, E);
+        return 8;
+    case 0xC4:
+        SetBit(0, H);
+        return 8;
+    case 0xC5:
+        SetBit(0, L);
+        return 8;
+    case 0xC6:
+        SetBitOfMemAtHL(0);
+        return 16;
+    case 0xC7:
+        SetBit(0, A);
+        return 8;
+    case 0xC8:
+        SetBit(1, B);
+        return 8;
+    case 0xC9:
+        SetBit(1, C);
+        return 8;
+    case 0xCA:
+        SetBit(1, D);
+        return 8;
+    case 0xCB:
+        SetBit(1, E);
+        return 8;
+    case 0xCC:
+        SetBit(1, H);
+        return 8;
+    case 0xCD:
+        SetBit(1, L);
+        return 8;
+    case 0xCE:
+        SetBitOfMemAtHL(1);
+        return 16;
+    case 0xCF:
+        SetBit(1, A);
+        return 8;
+    case 0xD0:
+        SetBit(2, B);
+        return 8;
+    case 0xD1:
+        SetBit(2, C);
+        return 8;
+    case 0xD2:
+        SetBit(2, D);
+        return 8;
+    case 0xD3:
+        SetBit(2, E);
+        return 8;
+    case 0xD4:
+        SetBit(2, H);
+        return 8;
+    case 0xD5:
+        SetBit(2, L);
+        return 8;
+    case 0xD6:
+        SetBitOfMemAtHL(2);
+        return 16;
+    case 0xD7:
+        SetBit(2, A);
+        return 8;
+    case 0xD8:
+        SetBit(3, B);
+        return 8;
+    case 0xD9:
+        SetBit(3, C);
+        return 8;
+    case 0xDA:
+        SetBit(3, D);
+        return 8;
+    case 0xDB:
+        SetBit(3, E);
+        return 8;
+    case 0xDC:
+        SetBit(3, H);
+        return 8;
+    case 0xDD:
+        SetBit(3, L);
+        return 8;
+    case 0xDE:
+        SetBitOfMemAtHL(3);
+        return 16;
+    case 0xDF:
+        SetBit(3, A);
+        return 8;
+    case 0xE0:
+        SetBit(4, B);
+        return 8;
+    case 0xE1:
+        SetBit(4, C);
+        return 8;
+    case 0xE2:
+        SetBit(4, D);
+        return 8;
+    case 0xE3:
+        SetBit(4, E);
+        return 8;
+    case 0xE4:
+        SetBit(4, H);
+        return 8;
+    case 0xE5:
+        SetBit(4, L);
+        return 8;
+    case 0xE6:
+        SetBitOfMemAtHL(4);
+        return 16;
+    case 0xE7:
+        SetBit(4, A);
+        return 8;
+    case 0xE8:
+        SetBit(5, B);
+        return 8;
+    case 0xE9:
+        SetBit(5, C);
+        return 8;
+    case 0xEA:
+        SetBit(5, D);
+        return 8;
+    case 0xEB:
+        SetBit(5, E);
+        return 8;
+    case 0xEC:
+        SetBit(5, H);
+        return 8;
+    case 0xED:
+        SetBit(5, L);
+        return 8;
+    case 0xEE:
+        SetBitOfMemAtHL(5);
+        return 16;
+    case 0xEF:
+        SetBit(5, A);
+        return 8;
+    case 0xF0:
+        SetBit(6, B);
+        return 8;
+    case 0xF1:
+        SetBit(6, C);
+        return 8;
+    case 0xF2:
+        SetBit(6, D);
+        return 8;
+    case 0xF3:
+        SetBit(6, E);
+        return 8;
+    case 0xF4:
+        SetBit(6, H);
+        return 8;
+    case 0xF5:
+        SetBit(6, L);
+        return 8;
+    case 0xF6:
+        SetBitOfMemAtHL(6);
+        return 16;
+    case 0xF7:
+        SetBit(6, A);
+        return 8;
+    case 0xF8:
+        SetBit(7, B);
+        return 8;
+    case 0xF9:
+        SetBit(7, C);
+        return 8;
+    case 0xFA:
+        SetBit(7, D);
+        return 8;
+    case 0xFB:
+        SetBit(7, E);
+        return 8;
+    case 0xFC:
+        SetBit(7, H);
+        return 8;
+    case 0xFD:
+        SetBit(7, L);
+        return 8;
+    case 0xFE:
+        SetBitOfMemAtHL(7);
+        return 16;
+    case 0xFF:
+        SetBit(7, A);
+        return 8;
+
+    default:
+        // Unreachable, every possible case is specified above.
+        return 8;
+    }
+}
+
+unsigned int CPU::ExecuteNext(const u8 opcode) {
+    return (this->*opcode_table[opcode])();
+}
+
+template<std::size_t... opcodes>
+constexpr CPU::OpcodeTable CPU::MakeOpcodeTable(std::index_sequence<opcodes...>) {
+    return {{&CPU::ExecuteOpcode<opcodes>...}};
+}
+
+template<std::size_t... opcodes>
+constexpr CPU::OpcodeTable CPU::MakeCBOpcodeTable(std::index_sequence<opcodes...>) {
+    return {{&CPU::ExecuteCBOpcode<opcodes>...}};
+}
+
+const CPU::OpcodeTable CPU::opcode_table = MakeOpcodeTable(std::make_index_sequence<256>{});
+const CPU::OpcodeTable CPU::cb_opcode_table = MakeCBOpcodeTable(std::make_index_sequence<256>{});
+
+void CPU::Serialize(Common::StateBuffer& state) {
+    MaterializeFlags();
+
+    state.BeginChunk("CPU ", 1);
+    state.Sync(pc);
+    for (auto& reg : regs.reg16) {
+        state.Sync(reg);
+    }
+    state.Sync(cpu_mode);
+    state.Sync(speed_switch_cycles);
+    state.Sync(interrupt_master_enable);
+    state.Sync(enable_interrupts_delayed);
+    state.EndChunk();
+
+    if (state.Loading()) {
+        idle_snapshot_valid = false;
+    }
+}
+
 } // End namespace Gb
@@ -16,9 +16,15 @@
 
 #pragma once
 
+#include <array>
+#include <utility>
+
 #include "common/CommonTypes.h"
+#include "common/Metrics.h"
 #include "gb/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gb {
 
 class Memory;
@@ -28,7 +34,7 @@ class Logging;
 class CPU {
     friend class Logging;
 public:
-    CPU(Memory& memory);
+    CPU(Memory& memory, bool enable_idle_skip);
 
     int RunFor(int cycles);
 
@@ -36,6 +42,12 @@ public:
     void EnableInterruptsDelayed();
 
     bool IsHalted() const { return cpu_mode == CPUMode::Halted; }
+    u16 GetPc() const { return pc; }
+
+    // Totals for the metrics export.
+    Common::CpuCounters counters;
+
+    void Serialize(Common::StateBuffer& state);
 private:
     Memory& mem;
     GameBoy* gameboy;
@@ -60,7 +72,24 @@ private:
     enum class CPUMode {Running, Halted, HaltBug, Stopped};
     CPUMode cpu_mode = CPUMode::Running;
     unsigned int speed_switch_cycles = 0;
+    // Cycles run since power on, to timestamp binary trace records.
+    u64 trace_timestamp = 0;
     unsigned int ExecuteNext(const u8 opcode);
+
+    // Each opcode is handled by its own instantiation of the opcode switch, which the compiler reduces to the
+    // single case. ExecuteNext and the CB prefix dispatch through tables of these built at compile time.
+    using OpcodeTable = std::array<unsigned int (CPU::*)(), 256>;
+    static const OpcodeTable opcode_table;
+    static const OpcodeTable cb_opcode_table;
+
+    template<u8 opcode>
+    unsigned int ExecuteOpcode();
+    template<u8 cb_opcode>
+    unsigned int ExecuteCBOpcode();
+    template<std::size_t... opcodes>
+    static constexpr OpcodeTable MakeOpcodeTable(std::index_sequence<opcodes...>);
+    template<std::size_t... opcodes>
+    static constexpr OpcodeTable MakeCBOpcodeTable(std::index_sequence<opcodes...>);
     void StoppedTick();
 
     // Interrupts
@@ -69,6 +98,37 @@ private:
 
     int HandleInterrupts();
 
+    // Idle loop detection. A short backward loop which only reads memory is idle if one iteration leaves the
+    // registers exactly as they were and everything it read still holds the same value. Such a loop can be
+    // fast-forwarded an iteration at a time until one of those values changes or an interrupt is due.
+    static constexpr u16 max_idle_loop_bytes = 0x10;
+    static constexpr std::size_t max_idle_reads = 8;
+    const bool idle_skip;
+    u16 idle_branch_addr = 0xFFFF;
+    u16 idle_loop_start = 0xFFFF;
+    bool idle_body_ok = false;
+    bool idle_snapshot_valid = false;
+    std::array<u16, 5> idle_regs{};
+    u64 idle_snapshot_time = 0;
+    struct IdleRead {
+        u16 addr;
+        u8 value;
+    };
+    std::array<IdleRead, max_idle_reads> idle_reads{};
+    std::size_t num_idle_reads = 0;
+    bool idle_reads_overflow = false;
+
+    int IdleLoop(u8 opcode, u16 instr_pc, int remaining_cycles, u64 timestamp);
+    bool IdleLoopBody(u16 start_addr, u16 branch_addr) const;
+    static unsigned int IdleLoopInstructionLength(u8 opcode, u8 cb_opcode);
+    bool IdleReadsUnchanged() const;
+    void RecordIdleRead(u16 addr, u8 value);
+    int SkipIdleLoop(int remaining_cycles, unsigned int iteration_cycles);
+
+    // Guest profiling
+    u32 ProfileAddr(u16 addr) const;
+    void Profile(u8 opcode, u16 addr, unsigned int cycles);
+
     // Memory access
     u8 ReadMemAndTick(const u16 addr);
     void WriteMemAndTick(const u16 addr, const u8 val);
@@ -185,15 +245,37 @@ private:
     // Flags
     static constexpr u8 zero = 0x80, sub = 0x40, half = 0x20, carry = 0x10;
 
-    void SetZero(bool val)  { (val) ? (regs.reg8[F] |= zero)  : (regs.reg8[F] &= ~zero);  }
-    void SetSub(bool val)   { (val) ? (regs.reg8[F] |= sub)   : (regs.reg8[F] &= ~sub);   }
-    void SetHalf(bool val)  { (val) ? (regs.reg8[F] |= half)  : (regs.reg8[F] &= ~half);  }
-    void SetCarry(bool val) { (val) ? (regs.reg8[F] |= carry) : (regs.reg8[F] &= ~carry); }
-
-    u8 Zero()  const { return (regs.reg8[F] & zero)  >> 7; }
-    u8 Sub()   const { return (regs.reg8[F] & sub)   >> 6; }
-    u8 Half()  const { return (regs.reg8[F] & half)  >> 5; }
-    u8 Carry() const { return (regs.reg8[F] & carry) >> 4; }
+    // The 8-bit ALU operations only record their operation and operands, and the F register is brought up to date
+    // when an instruction, PUSH AF, or a register dump reads it. Xor shares FlagOp::Or, and for And/Or flag_lhs
+    // holds the result.
+    enum class FlagOp : u8 {None, Add, Sub, And, Or, Inc, Dec};
+    FlagOp flag_op = FlagOp::None;
+    u8 flag_lhs = 0;
+    u8 flag_rhs = 0;
+    u8 flag_carry_in = 0;
+
+    void MaterializeFlags() {
+        if (flag_op != FlagOp::None) {
+            ComputeFlags();
+        }
+    }
+    void ComputeFlags();
+    void DeferFlags(FlagOp op, u8 lhs, u8 rhs, u8 carry_in) {
+        flag_op = op;
+        flag_lhs = lhs;
+        flag_rhs = rhs;
+        flag_carry_in = carry_in;
+    }
+
+    void SetZero(bool val)  { MaterializeFlags(); (val) ? (regs.reg8[F] |= zero)  : (regs.reg8[F] &= ~zero);  }
+    void SetSub(bool val)   { MaterializeFlags(); (val) ? (regs.reg8[F] |= sub)   : (regs.reg8[F] &= ~sub);   }
+    void SetHalf(bool val)  { MaterializeFlags(); (val) ? (regs.reg8[F] |= half)  : (regs.reg8[F] &= ~half);  }
+    void SetCarry(bool val) { MaterializeFlags(); (val) ? (regs.reg8[F] |= carry) : (regs.reg8[F] &= ~carry); }
+
+    u8 Zero()  { MaterializeFlags(); return (regs.reg8[F] & zero)  >> 7; }
+    u8 Sub()   { MaterializeFlags(); return (regs.reg8[F] & sub)   >> 6; }
+    u8 Half()  { MaterializeFlags(); return (regs.reg8[F] & half)  >> 5; }
+    u8 Carry() { MaterializeFlags(); return (regs.reg8[F] & carry) >> 4; }
 };
 
 } // End namespace Gb
@@ -74,6 +74,10 @@ void CPU::LoadSPIntoMem(u16 addr) {
 }
 
 void CPU::Push(Reg16Addr r) {
+    if (r == AF) {
+        MaterializeFlags();
+    }
+
     // Internal delay
     gameboy->HardwareTick(4);
 
@@ -82,6 +86,10 @@ void CPU::Push(Reg16Addr r) {
 }
 
 void CPU::Pop(Reg16Addr r) {
+    if (r == AF) {
+        flag_op = FlagOp::None;
+    }
+
     regs.reg8[ToReg8AddrLo(r)] = ReadMemAndTick(regs.reg16[SP]++);
     regs.reg8[ToReg8AddrHi(r)] = ReadMemAndTick(regs.reg16[SP]++);
 
@@ -93,13 +101,8 @@ void CPU::Pop(Reg16Addr r) {
 
 // 8-bit Add operations
 void CPU::AddImmediate(u8 val) {
-    u16 tmp16 = regs.reg8[A] + val;
-    SetHalf(((regs.reg8[A] & 0x0F) + (val & 0x0F)) & 0x10);
-    SetCarry(tmp16 & 0x0100);
-    SetZero(!(tmp16 & 0x00FF));
-    SetSub(false);
-
-    regs.reg8[A] = static_cast<u8>(tmp16);
+    DeferFlags(FlagOp::Add, regs.reg8[A], val, 0);
+    regs.reg8[A] += val;
 }
 
 void CPU::Add(Reg8Addr r) {
@@ -111,13 +114,9 @@ void CPU::AddFromMemAtHL() {
 }
 
 void CPU::AddImmediateWithCarry(u8 val) {
-    u16 tmp16 = regs.reg8[A] + val + Carry();
-    SetHalf(((regs.reg8[A] & 0x0F) + (val & 0x0F) + Carry()) & 0x10);
-    SetCarry(tmp16 & 0x0100);
-    SetZero(!(tmp16 & 0x00FF));
-    SetSub(false);
-
-    regs.reg8[A] = static_cast<u8>(tmp16);
+    const u8 carry_val = Carry();
+    DeferFlags(FlagOp::Add, regs.reg8[A], val, carry_val);
+    regs.reg8[A] += val + carry_val;
 }
 
 void CPU::AddWithCarry(Reg8Addr r) {
@@ -130,12 +129,8 @@ void CPU::AddFromMemAtHLWithCarry() {
 
 // 8-bit Subtract operations
 void CPU::SubImmediate(u8 val) {
-    SetHalf((regs.reg8[A] & 0x0F) < (val & 0x0F));
-    SetCarry(regs.reg8[A] < val);
-    SetSub(true);
-
+    DeferFlags(FlagOp::Sub, regs.reg8[A], val, 0);
     regs.reg8[A] -= val;
-    SetZero(!regs.reg8[A]);
 }
 
 void CPU::Sub(Reg8Addr r) {
@@ -147,13 +142,9 @@ void CPU::SubFromMemAtHL() {
 }
 
 void CPU::SubImmediateWithCarry(u8 val) {
-    u8 carry_val = Carry();
-    SetHalf((regs.reg8[A] & 0x0F) < (val & 0x0F) + carry_val);
-    SetCarry(regs.reg8[A] < val + carry_val);
-    SetSub(true);
-
+    const u8 carry_val = Carry();
+    DeferFlags(FlagOp::Sub, regs.reg8[A], val, carry_val);
     regs.reg8[A] -= val + carry_val;
-    SetZero(!regs.reg8[A]);
 }
 
 void CPU::SubWithCarry(Reg8Addr r) {
@@ -164,38 +155,35 @@ void CPU::SubFromMemAtHLWithCarry() {
     SubImmediateWithCarry(ReadMemAndTick(regs.reg16[HL]));
 }
 
+// INC and DEC leave the carry flag unchanged, so any pending flags are brought up to date first.
 void CPU::IncReg8(Reg8Addr r) {
-    SetHalf((regs.reg8[r] & 0x0F) == 0x0F);
+    MaterializeFlags();
+    DeferFlags(FlagOp::Inc, regs.reg8[r], 0, 0);
     ++regs.reg8[r];
-    SetZero(!regs.reg8[r]);
-    SetSub(false);
 }
 
 void CPU::IncMemAtHL() {
     u8 val = ReadMemAndTick(regs.reg16[HL]);
 
-    SetHalf((val & 0x0F) == 0x0F);
+    MaterializeFlags();
+    DeferFlags(FlagOp::Inc, val, 0, 0);
     ++val;
-    SetZero(!val);
-    SetSub(false);
 
     WriteMemAndTick(regs.reg16[HL], val);
 }
 
 void CPU::DecReg8(Reg8Addr r) {
-    SetHalf((regs.reg8[r] & 0x0F) == 0x00);
+    MaterializeFlags();
+    DeferFlags(FlagOp::Dec, regs.reg8[r], 0, 0);
     --regs.reg8[r];
-    SetZero(!regs.reg8[r]);
-    SetSub(true);
 }
 
 void CPU::DecMemAtHL() {
     u8 val = ReadMemAndTick(regs.reg16[HL]);
 
-    SetHalf((val & 0x0F) == 0x00);
+    MaterializeFlags();
+    DeferFlags(FlagOp::Dec, val, 0, 0);
     --val;
-    SetZero(!val);
-    SetSub(true);
 
     WriteMemAndTick(regs.reg16[HL], val);
 }
@@ -203,11 +191,7 @@ void CPU::DecMemAtHL() {
 // Logical operations
 void CPU::AndImmediate(u8 val) {
     regs.reg8[A] &= val;
-
-    SetZero(!regs.reg8[A]);
-    SetSub(false);
-    SetHalf(true);
-    SetCarry(false);
+    DeferFlags(FlagOp::And, regs.reg8[A], 0, 0);
 }
 
 void CPU::And(Reg8Addr r) {
@@ -221,11 +205,7 @@ void CPU::AndFromMemAtHL() {
 // Bitwise Or operations
 void CPU::OrImmediate(u8 val) {
     regs.reg8[A] |= val;
-
-    SetZero(!regs.reg8[A]);
-    SetSub(false);
-    SetHalf(false);
-    SetCarry(false);
+    DeferFlags(FlagOp::Or, regs.reg8[A], 0, 0);
 }
 
 void CPU::Or(Reg8Addr r) {
@@ -239,11 +219,7 @@ void CPU::OrFromMemAtHL() {
 // Bitwise Xor operations
 void CPU::XorImmediate(u8 val) {
     regs.reg8[A] ^= val;
-
-    SetZero(!regs.reg8[A]);
-    SetSub(false);
-    SetHalf(false);
-    SetCarry(false);
+    DeferFlags(FlagOp::Or, regs.reg8[A], 0, 0);
 }
 
 void CPU::Xor(Reg8Addr r) {
@@ -256,10 +232,7 @@ void CPU::XorFromMemAtHL() {
 
 // Compare operations
 void CPU::CompareImmediate(u8 val) {
-    SetZero(!(regs.reg8[A] - val));
-    SetSub(true);
-    SetHalf((regs.reg8[A] & 0x0F) < (val & 0x0F));
-    SetCarry(regs.reg8[A] < val);
+    DeferFlags(FlagOp::Sub, regs.reg8[A], val, 0);
 }
 
 void CPU::Compare(Reg8Addr r) {
@@ -645,4 +618,47 @@ void CPU::Stop() {
     cpu_mode = CPUMode::Stopped;
 }
 
+// Lazy flags
+void CPU::ComputeFlags() {
+    const unsigned int lhs = flag_lhs, rhs = flag_rhs, carry_in = flag_carry_in;
+    u8 flags = 0;
+
+    switch (flag_op) {
+    case FlagOp::Add:
+        flags |= (((lhs + rhs + carry_in) & 0xFF) == 0) ? zero : 0;
+        flags |= (((lhs & 0x0F) + (rhs & 0x0F) + carry_in) & 0x10) ? half : 0;
+        flags |= ((lhs + rhs + carry_in) & 0x100) ? carry : 0;
+        break;
+    case FlagOp::Sub:
+        flags |= sub;
+        flags |= (((lhs - rhs - carry_in) & 0xFF) == 0) ? zero : 0;
+        flags |= ((lhs & 0x0F) < (rhs & 0x0F) + carry_in) ? half : 0;
+        flags |= (lhs < rhs + carry_in) ? carry : 0;
+        break;
+    case FlagOp::And:
+        flags |= half;
+        flags |= (lhs == 0) ? zero : 0;
+        break;
+    case FlagOp::Or:
+        flags |= (lhs == 0) ? zero : 0;
+        break;
+    case FlagOp::Inc:
+        flags |= regs.reg8[F] & carry;
+        flags |= (lhs == 0xFF) ? zero : 0;
+        flags |= ((lhs & 0x0F) == 0x0F) ? half : 0;
+        break;
+    case FlagOp::Dec:
+        flags |= regs.reg8[F] & carry;
+        flags |= sub;
+        flags |= (lhs == 0x01) ? zero : 0;
+        flags |= ((lhs & 0x0F) == 0x00) ? half : 0;
+        break;
+    case FlagOp::None:
+        return;
+    }
+
+    regs.reg8[F] = flags;
+    flag_op = FlagOp::None;
+}
+
 } // End namespace Gb
@@ -16,6 +16,7 @@
 
 #include "gb/hardware/Joypad.h"
 #include "gb/memory/Memory.h"
+#include "common/StateBuffer.h"
 
 namespace Gb {
 
@@ -42,4 +43,13 @@ void Joypad::UpdateJoypad() {
     prev_interrupt_signal = interrupt_signal;
 }
 
+void Joypad::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("JOYP", 1);
+    state.Sync(p1);
+    state.Sync(button_states);
+    state.Sync(was_unset);
+    state.Sync(prev_interrupt_signal);
+    state.EndChunk();
+}
+
 } // End namespace Gb
@@ -19,6 +19,8 @@
 #include "common/CommonTypes.h"
 #include "gb/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gb {
 
 class Memory;
@@ -35,6 +37,7 @@ public:
                       Start  = 0x80};
 
     void UpdateJoypad();
+    void Serialize(Common::StateBuffer& state);
     void Press(Button button, bool pressed) {
         if (pressed) {
             // When pressing a directional button, record if the opposite direction was currently pressed and
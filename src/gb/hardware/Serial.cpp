@@ -14,8 +14,12 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+
 #include "gb/hardware/Serial.h"
 #include "gb/memory/Memory.h"
+#include "common/StateBuffer.h"
+#include "common/LinkCable.h"
 
 namespace Gb {
 
@@ -26,6 +30,18 @@ void Serial::UpdateSerial() {
     // Check if a transfer has been initiated.
     if (bits_to_shift == 0 && (serial_control & 0x80)) {
         bits_to_shift = 8;
+
+        // When we supply the clock, the other side's byte is exchanged for ours as the transfer starts, and then
+        // shifted in a bit at a time as usual.
+        incoming_data = (link != nullptr && UsingInternalClock()) ? link->Transfer(serial_data) : 0xFF;
+    }
+
+    if (link != nullptr) {
+        if (link_poll_countdown <= 4) {
+            PollLink();
+        } else {
+            link_poll_countdown -= 4;
+        }
     }
 
     // A falling edge on the internal transfer signal causes a bit to be shifted out/in.
@@ -35,7 +51,7 @@ void Serial::UpdateSerial() {
 
     prev_transfer_signal = transfer_signal;
 
-    bool serial_inc = (serial_clock & SelectClockBit()) && UsingInternalClock();
+    bool serial_inc = SerialClockBitSet();
 
     // When using the internal clock, a falling edge on bit 7 of the serial clock causes the internal transfer
     // signal to be toggled.
@@ -46,13 +62,46 @@ void Serial::UpdateSerial() {
     prev_inc = serial_inc;
 }
 
+unsigned int Serial::CyclesUntilEvent() const {
+    const unsigned int cycles = CyclesUntilShift();
+    return (link != nullptr) ? std::min(cycles, link_poll_countdown) : cycles;
+}
+
+void Serial::FastForward(unsigned int cycles) {
+    serial_clock += cycles;
+    prev_inc = SerialClockBitSet();
+
+    if (link != nullptr) {
+        link_poll_countdown -= cycles;
+    }
+}
+
+unsigned int Serial::CyclesUntilShift() const {
+    if (bits_to_shift != 0 || (serial_control & 0x80)) {
+        return 0;
+    }
+
+    // If SC was written since the last update, there may be a falling edge on the serial clock next cycle.
+    if (prev_inc != SerialClockBitSet() || prev_transfer_signal != transfer_signal) {
+        return 0;
+    }
+
+    if (!UsingInternalClock()) {
+        return no_event;
+    }
+
+    // The selected clock bit next falls when the serial clock reaches a multiple of twice its value.
+    const unsigned int period = SelectClockBit() * 2u;
+    return period - (serial_clock & (period - 1));
+}
+
 void Serial::ShiftSerialBit() {
     // Shift the most significant bit out of SB.
     serial_data <<= 1;
 
-    // Since we are always emulating a disconnected serial port at the moment, place a 1 in the least significant
-    // bit of SB.
-    serial_data |= 0x01;
+    // Shift in the other side's byte, most significant bit first. A disconnected serial port shifts in 1s.
+    serial_data |= incoming_data >> 7;
+    incoming_data <<= 1;
 
     if (--bits_to_shift == 0) {
         // The transfer has completed.
@@ -61,6 +110,22 @@ void Serial::ShiftSerialBit() {
     }
 }
 
+void Serial::PollLink() {
+    link_poll_countdown = link_poll_period;
+
+    const bool waiting = (serial_control & 0x80) && !UsingInternalClock();
+
+    // If we aren't waiting on an externally clocked transfer, the other side still gets a reply, but SB doesn't
+    // shift. Otherwise, the whole byte is exchanged at once.
+    u32 received;
+    if (link->Respond(waiting ? serial_data : 0xFF, received) && waiting) {
+        serial_data = received & 0xFF;
+        bits_to_shift = 0;
+        serial_control &= 0x7F;
+        mem->RequestInterrupt(Interrupt::Serial);
+    }
+}
+
 u8 Serial::SelectClockBit() const {
     // In CBG mode, bit 1 of SC can be used to set the speed of the serial transfer. The transfer runs at the usual 
     // speed (using bit 7 of the serial clock) if it's 0, and runs fast (using bit 2 of the serial clock) if it's 1.
@@ -72,4 +137,17 @@ u8 Serial::SelectClockBit() const {
     }
 }
 
+void Serial::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("SIO ", 2);
+    state.Sync(serial_data);
+    state.Sync(serial_control);
+    state.Sync(serial_clock);
+    state.Sync(bits_to_shift);
+    state.Sync(prev_inc);
+    state.Sync(transfer_signal);
+    state.Sync(prev_transfer_signal);
+    state.Sync(incoming_data);
+    state.EndChunk();
+}
+
 } // End namespace Gb
@@ -19,6 +19,8 @@
 #include "common/CommonTypes.h"
 #include "gb/core/Enums.h"
 
+namespace Common { class StateBuffer; class LinkCable; }
+
 namespace Gb {
 
 class Memory;
@@ -27,6 +29,18 @@ class Serial {
 public:
     void UpdateSerial();
 
+    // The number of cycles that can pass before a transfer bit is shifted or the internal transfer signal toggles.
+    // Until then, only the serial clock changes, so the serial port can be fast-forwarded in a single step.
+    unsigned int CyclesUntilEvent() const;
+    void FastForward(unsigned int cycles);
+
+    // With no cable attached, the serial port behaves as if nothing is plugged into it.
+    void AttachLinkCable(Common::LinkCable* cable) { link = cable; }
+
+    void Serialize(Common::StateBuffer& state);
+
+    static constexpr unsigned int no_event = 0xFFFF'FFFF;
+
     constexpr void InitSerialClock(u8 init_val) { serial_clock = init_val; }
     constexpr void LinkToMemory(Memory* memory) { mem = memory; }
 
@@ -48,9 +62,20 @@ private:
     bool transfer_signal = false;
     bool prev_transfer_signal = false;
 
+    Common::LinkCable* link = nullptr;
+    // The other side's byte, which is shifted into SB during a transfer we clock.
+    u8 incoming_data = 0xFF;
+
+    // While a cable is attached, it's checked for transfers clocked by the other side this often.
+    static constexpr unsigned int link_poll_period = 512;
+    unsigned int link_poll_countdown = link_poll_period;
+
+    unsigned int CyclesUntilShift() const;
     void ShiftSerialBit();
+    void PollLink();
     u8 SelectClockBit() const;
     constexpr bool UsingInternalClock() const { return serial_control & 0x01; }
+    bool SerialClockBitSet() const { return (serial_clock & SelectClockBit()) && UsingInternalClock(); }
 };
 
 } // End namespace Gb
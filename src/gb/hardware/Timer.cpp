@@ -16,10 +16,13 @@
 
 #include "gb/hardware/Timer.h"
 #include "gb/memory/Memory.h"
+#include "common/StateBuffer.h"
+#include "common/Timing.h"
 
 namespace Gb {
 
 void Timer::UpdateTimer() {
+    TIMING_SCOPE(Timers);
     // DIV increments by 1 each clock cycle.
     divider += 4;
 
@@ -62,4 +65,76 @@ void Timer::UpdateTimer() {
     prev_tima_inc = tima_inc;
 }
 
+unsigned int Timer::CyclesUntilEvent() const {
+    if (tima_overflow || tima_overflow_not_interrupted) {
+        return 0;
+    }
+
+    // If DIV or TAC were written since the last update, the edge detector may see a falling edge on the next cycle.
+    if (prev_tima_inc != (DivFrequencyBitSet() && TimerEnabled())) {
+        return 0;
+    }
+
+    if (!TimerEnabled()) {
+        return no_event;
+    }
+
+    // The selected DIV bit next falls when DIV reaches a multiple of twice its value. TIMA increments on each fall,
+    // and the one which overflows it needs to be handled cycle by cycle.
+    const unsigned int period = select_div_bit[tac & 0x03] * 2;
+    return period - (divider & (period - 1)) + (0xFF - tima) * period;
+}
+
+void Timer::FastForward(unsigned int cycles) {
+    if (TimerEnabled()) {
+        const unsigned int period = select_div_bit[tac & 0x03] * 2;
+        const unsigned int falling_edges = (divider + cycles) / period - divider / period;
+        tima += falling_edges;
+    }
+
+    divider += cycles;
+
+    prev_tima_val = tima;
+    prev_tima_inc = DivFrequencyBitSet() && TimerEnabled();
+}
+
+bool Timer::Defer(unsigned int cycles) {
+    if (event_countdown == 0) {
+        event_countdown = CyclesUntilEvent();
+    }
+
+    if (cycles < event_countdown) {
+        event_countdown -= cycles;
+        deferred_cycles += cycles;
+        return true;
+    }
+
+    Sync();
+    return false;
+}
+
+void Timer::Sync() {
+    if (deferred_cycles != 0) {
+        FastForward(deferred_cycles);
+        deferred_cycles = 0;
+    }
+
+    // The registers may be about to change, so the countdown must be recalculated.
+    event_countdown = 0;
+}
+
+void Timer::Serialize(Common::StateBuffer& state) {
+    Sync();
+    state.BeginChunk("TMR ", 1);
+    state.Sync(divider);
+    state.Sync(tima);
+    state.Sync(tma);
+    state.Sync(tac);
+    state.Sync(prev_tima_inc);
+    state.Sync(tima_overflow);
+    state.Sync(tima_overflow_not_interrupted);
+    state.Sync(prev_tima_val);
+    state.EndChunk();
+}
+
 } // End namespace Gb
@@ -20,6 +20,8 @@
 
 #include "common/CommonTypes.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gb {
 
 class Memory;
@@ -30,6 +32,22 @@ class Timer {
 public:
     void UpdateTimer();
 
+    // The number of cycles that can pass before TIMA overflows or the edge detector needs handling. Until then, DIV
+    // and TIMA can be derived from the elapsed cycles, so the timer can be fast-forwarded in a single step.
+    unsigned int CyclesUntilEvent() const;
+    void FastForward(unsigned int cycles);
+
+    // Instead of fast-forwarding the timer every instruction, the elapsed cycles are accumulated until the registers
+    // are accessed or the next event is due. Returns false if the timer needs to be updated every machine cycle
+    // for these cycles.
+    bool Defer(unsigned int cycles);
+    // Brings the registers up to date. Must be called before they are read or written.
+    void Sync();
+
+    void Serialize(Common::StateBuffer& state);
+
+    static constexpr unsigned int no_event = 0xFFFF'FFFF;
+
     constexpr void LinkToMemory(Memory* memory) { mem = memory; }
 
     // ******** Timer I/O registers ********
@@ -51,6 +69,11 @@ private:
     bool tima_overflow_not_interrupted = false;
     u8 prev_tima_val = 0x00;
 
+    // Cycles which have passed but have not yet been applied to the registers, and the number of cycles remaining
+    // until the next event. No cycles are deferred while event_countdown is zero.
+    unsigned int deferred_cycles = 0;
+    unsigned int event_countdown = 0;
+
     const std::array<unsigned int, 4> select_div_bit{{0x0200, 0x0008, 0x0020, 0x0080}};
 
     constexpr bool DivFrequencyBitSet() const { return select_div_bit[tac & 0x03] & divider; }
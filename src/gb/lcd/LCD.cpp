@@ -15,10 +15,14 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
+#include <limits>
 
 #include "gb/lcd/LCD.h"
+#include "gb/lcd/RenderThread.h"
 #include "gb/memory/Memory.h"
 #include "gb/core/GameBoy.h"
+#include "common/StateBuffer.h"
+#include "common/Timing.h"
 
 namespace Gb {
 
@@ -49,7 +53,46 @@ SpriteAttrs::SpriteAttrs(u8 y, u8 x, u8 index, u8 attrs, GameMode game_mode)
     }
 };
 
-LCD::LCD() : back_buffer(160*144) {}
+LCD::LCD()
+        : tile_cache(tiles_per_bank * 2)
+        , back_buffer(160*144) {
+    tile_dirty.fill(true);
+}
+
+void LCD::LinkToMemory(Memory* memory) {
+    mem = memory;
+    vram = mem->VRAMReference().data();
+}
+
+void LCD::ForwardVRAMWrite(std::size_t vram_offset) {
+    render_thread->WriteVRAM(vram_offset, vram[vram_offset]);
+}
+
+void LCD::ForwardOAMWrite(std::size_t index) {
+    render_thread->WriteOAM(index, oam[index]);
+}
+
+void LCD::ForwardPaletteWrite(u16 addr) {
+    switch (addr) {
+    case 0xFF47:
+        render_thread->WritePalette(addr, 0, bg_palette_dmg);
+        break;
+    case 0xFF48:
+        render_thread->WritePalette(addr, 0, obj_palette_dmg0);
+        break;
+    case 0xFF49:
+        render_thread->WritePalette(addr, 0, obj_palette_dmg1);
+        break;
+    case 0xFF69:
+        render_thread->WritePalette(addr, bg_palette_index & 0x3F, bg_palette_data[bg_palette_index & 0x3F]);
+        break;
+    case 0xFF6B:
+        render_thread->WritePalette(addr, obj_palette_index & 0x3F, obj_palette_data[obj_palette_index & 0x3F]);
+        break;
+    default:
+        break;
+    }
+}
 
 void LCD::UpdateLCD() {
     // Check if the LCD has been set on or off.
@@ -81,6 +124,7 @@ void LCD::UpdateLCD() {
             stat_interrupt_signal |= Mode2CheckEnabled();
         } else if (scanline_cycles == 4 << mem->double_speed) {
             mem->RequestInterrupt(Interrupt::VBLANK);
+            mem->ApplyCheatWrites();
             SetSTATMode(1);
             if (mem->IsConsoleDmg()) {
                 // The OAM STAT interrupt is also triggered on entering Mode 1.
@@ -88,13 +132,80 @@ void LCD::UpdateLCD() {
             }
 
             // Swap front and back buffers now that we've completed a frame.
-            gameboy->SwapBuffers(back_buffer);
+            if (render_thread) {
+                render_thread->EndFrame(!skip_frame);
+            } else if (!skip_frame) {
+                gameboy->SwapBuffers(back_buffer);
+            }
+
+            UpdateFrameSkip();
         }
     }
 
     CheckSTATInterruptSignal();
 }
 
+bool LCD::Defer(unsigned int cycles) {
+    const bool power_change = static_cast<bool>(lcdc & 0x80) != lcd_on;
+    if (!lcd_on && !power_change) {
+        // Nothing happens while the LCD is off.
+        return true;
+    }
+
+    if (!settled || power_change) {
+        Sync();
+        settled = true;
+        return false;
+    }
+
+    if (event_countdown == 0) {
+        event_countdown = NextEventCycle() - scanline_cycles;
+    }
+
+    if (cycles < event_countdown) {
+        event_countdown -= cycles;
+        deferred_cycles += cycles;
+        return true;
+    }
+
+    Sync();
+    return false;
+}
+
+void LCD::Sync() {
+    if (deferred_cycles != 0) {
+        // None of the deferred updates changed anything but the cycle count, and repeating the LY=LYC and STAT
+        // signal checks gives the same result as doing them once.
+        scanline_cycles += deferred_cycles;
+        UpdateLYCompareSignal();
+        CheckSTATInterruptSignal();
+        deferred_cycles = 0;
+    }
+
+    event_countdown = 0;
+    settled = false;
+}
+
+int LCD::NextEventCycle() const {
+    // The first few cycles of a line cover the start of mode 2 and VBlank, the early LY wrap on line 153, and the
+    // LY=LYC update lagging a cycle behind LY, so they're always updated normally.
+    if (scanline_cycles < 16) {
+        return scanline_cycles + 4;
+    }
+
+    // Mode 3 starts at one of the first three, and the LY=LYC check changes on the last cycle of CGB lines.
+    const std::array<int, 6> event_cycles{{80, 84, 160, Mode3Cycles(), 452, 456 << mem->double_speed}};
+    int next_event = std::numeric_limits<int>::max();
+    for (int event_cycle : event_cycles) {
+        if (event_cycle > scanline_cycles) {
+            next_event = std::min(next_event, event_cycle);
+        }
+    }
+
+    // The line end is always ahead unless the speed was switched partway through a line.
+    return (next_event == std::numeric_limits<int>::max()) ? scanline_cycles + 4 : next_event;
+}
+
 void LCD::UpdatePowerOnState() {
     bool lcdc_power_on = lcdc & 0x80;
     if (lcdc_power_on != lcd_on) {
@@ -115,8 +226,12 @@ void LCD::UpdatePowerOnState() {
             prev_interrupt_signal = 0;
 
             // Clear the framebuffer.
-            std::fill_n(back_buffer.begin(), 160*144, 0x7FFF);
-            gameboy->SwapBuffers(back_buffer);
+            if (render_thread) {
+                render_thread->ClearFrame();
+            } else {
+                std::fill_n(back_buffer.begin(), 160*144, 0x7FFF);
+                gameboy->SwapBuffers(back_buffer);
+            }
 
             // An in-progress HDMA will transfer one block after the LCD switches off.
             mem->SignalHDMA();
@@ -263,7 +378,37 @@ void LCD::CheckSTATInterruptSignal() {
     stat_interrupt_signal = false;
 }
 
+void LCD::UpdateFrameSkip() {
+    if (++skip_frame_count >= render_skip) {
+        skip_frame_count = 0;
+        skip_frame = false;
+    } else {
+        skip_frame = true;
+    }
+}
+
 void LCD::RenderScanline() {
+    TIMING_SCOPE(Lcd);
+    // On CGB in DMG mode, disabling the background will also disable the window.
+    const bool window_drawn = (mem->IsConsoleCgb() && mem->game_mode == GameMode::DMG)
+                              ? BGEnabled() && WindowEnabled() : WindowEnabled();
+    if (render_thread && !skip_frame) {
+        // The render thread draws the line with the registers as they are at the start of mode 3.
+        render_thread->DrawScanline({ly, lcdc, scroll_y, scroll_x, window_y, window_x, window_progress});
+    }
+
+    if (skip_frame || render_thread) {
+        // The window's internal line counter is the only state drawing a line changes.
+        if (window_drawn) {
+            ++window_progress;
+        }
+        return;
+    }
+
+    if (palettes_dirty) {
+        UpdatePaletteColours();
+    }
+
     std::size_t num_bg_pixels;
     if (WindowEnabled()) {
         num_bg_pixels = (window_x < 7) ? 0 : window_x - 7;
@@ -282,15 +427,8 @@ void LCD::RenderScanline() {
         RenderBackground(num_bg_pixels);
     }
 
-    // On CGB in DMG mode, disabling the background will also disable the window.
-    if (mem->IsConsoleCgb() && mem->game_mode == GameMode::DMG) {
-        if (BGEnabled() && WindowEnabled()) {
-            RenderWindow(num_bg_pixels);
-        }
-    } else {
-        if (WindowEnabled()) {
-            RenderWindow(num_bg_pixels);
-        }
+    if (window_drawn) {
+        RenderWindow(num_bg_pixels);
     }
 
     if (SpritesEnabled()) {
@@ -303,6 +441,7 @@ void LCD::RenderScanline() {
 }
 
 void LCD::RenderBackground(std::size_t num_bg_pixels) {
+    TIMING_SCOPE(Bg);
     // The background is composed of 32x32 tiles. The scroll registers (SCY and SCX) allow the top-left corner of
     // the screen to be positioned anywhere on the background, and the background wraps around when it hits the edge.
 
@@ -310,15 +449,13 @@ void LCD::RenderBackground(std::size_t num_bg_pixels) {
     unsigned int row_num = ((scroll_y + ly) / 8) % tile_map_row_len;
     InitTileMap(BGTileMapStartAddr() + row_num * tile_map_row_len);
 
-    FetchTiles();
-
     // Determine which row of pixels we're on, and in which tile we start reading data.
-    std::size_t tile_row = ((scroll_y + ly) % 8) * 2;
+    std::size_t tile_row = (scroll_y + ly) % 8;
     std::size_t start_tile = scroll_x / 8;
     auto tile_iter = tile_data.begin() + start_tile;
 
     // If necessary, throw away the first few pixels of the first tile, based on SCX.
-    std::size_t row_pixel = RenderFirstTile(0, start_tile, tile_row, scroll_x % 8);
+    std::size_t row_pixel = RenderTile(*tile_iter, 0, tile_row, scroll_x % 8);
 
     // Increment the tile index to the next tile, and wrap around if we hit the end.
     if (++tile_iter == tile_data.end()) {
@@ -326,30 +463,7 @@ void LCD::RenderBackground(std::size_t num_bg_pixels) {
     }
 
     while (row_pixel < num_bg_pixels) {
-        // If this tile has the Y flip flag set, decode the mirrored row in the other half of the tile.
-        DecodePaletteIndices(tile_iter->tile, (tile_iter->y_flip) ? (14 - tile_row) : tile_row);
-
-        // If this tile has the X flip flag set, reverse the pixels.
-        if (tile_iter->x_flip) {
-            std::reverse(pixel_colours.begin(), pixel_colours.end());
-        }
-
-        // Record the palette index for each pixel and the bg priority bit.
-        for (const auto& pixel_colour : pixel_colours) {
-            row_bg_info[row_pixel++] = (pixel_colour << 1) | tile_iter->above_sprites;
-        }
-        row_pixel -= 8;
-
-        if (mem->game_mode == GameMode::DMG) {
-            GetPixelColoursFromPaletteDMG(bg_palette_dmg, false);
-        } else {
-            GetPixelColoursFromPaletteCGB(tile_iter->palette_num, false);
-        }
-
-        // Copy the pixels to the row buffer.
-        for (const auto& pixel_colour : pixel_colours) {
-            row_buffer[row_pixel++] = pixel_colour;
-        }
+        row_pixel = RenderTile(*tile_iter, row_pixel, tile_row, 0);
 
         if (++tile_iter == tile_data.end()) {
             tile_iter = tile_data.begin();
@@ -358,6 +472,7 @@ void LCD::RenderBackground(std::size_t num_bg_pixels) {
 }
 
 void LCD::RenderWindow(std::size_t num_bg_pixels) {
+    TIMING_SCOPE(Bg);
     // The window is composed of 32x32 tiles (of which only 21x18 tiles can be seen). Unlike the background, the
     // window cannot be scrolled; it is always displayed from its top-left corner and does not wrap around.
     // Instead, the position of its top-left corner can be set with the WY and WX registers.
@@ -365,46 +480,20 @@ void LCD::RenderWindow(std::size_t num_bg_pixels) {
     // Determine which row we need to fetch from the current internal value of the window progression.
     InitTileMap(WindowTileMapStartAddr() + (window_progress / 8) * tile_map_row_len);
 
-    FetchTiles();
-
     // While the window is enabled, each row of the window is drawn successively starting from the top. If it is
     // disabled while a frame is being drawn and later re-enabled during the same frame, the window will resume
     // drawing from the row at which it left off; hence, the window progress must be tracked separately of LY.
 
     // Determine which row of pixels we're on.
-    std::size_t tile_row = ((window_progress) % 8) * 2;
+    std::size_t tile_row = window_progress % 8;
     auto tile_iter = tile_data.begin();
 
     // If necessary, throw away the first few pixels of the first tile, based on WX.
-    std::size_t row_pixel = RenderFirstTile(num_bg_pixels, 0, tile_row, (window_x < 7) ? 7 - window_x : 0);
+    std::size_t row_pixel = RenderTile(*tile_iter, num_bg_pixels, tile_row, (window_x < 7) ? 7 - window_x : 0);
     ++tile_iter;
 
     while (row_pixel < 160) {
-        // If this tile has the Y flip flag set, decode the mirrored row in the other half of the tile.
-        DecodePaletteIndices(tile_iter->tile, (tile_iter->y_flip) ? (14 - tile_row) : tile_row);
-
-        // If this tile has the X flip flag set, reverse the pixels.
-        if (tile_iter->x_flip) {
-            std::reverse(pixel_colours.begin(), pixel_colours.end());
-        }
-
-        // Record the palette index for each pixel and the bg priority bit.
-        for (const auto& pixel_colour : pixel_colours) {
-            row_bg_info[row_pixel++] = (pixel_colour << 1) | tile_iter->above_sprites;
-        }
-        row_pixel -= 8;
-
-        if (mem->game_mode == GameMode::DMG) {
-            GetPixelColoursFromPaletteDMG(bg_palette_dmg, false);
-        } else {
-            GetPixelColoursFromPaletteCGB(tile_iter->palette_num, false);
-        }
-
-        // Copy the pixels to the row buffer.
-        for (const auto& pixel_colour : pixel_colours) {
-            row_buffer[row_pixel++] = pixel_colour;
-        }
-
+        row_pixel = RenderTile(*tile_iter, row_pixel, tile_row, 0);
         ++tile_iter;
     }
 
@@ -412,47 +501,84 @@ void LCD::RenderWindow(std::size_t num_bg_pixels) {
     ++window_progress;
 }
 
-std::size_t LCD::RenderFirstTile(std::size_t start_pixel, std::size_t start_tile, std::size_t tile_row,
-                                 std::size_t throwaway) {
-    auto& bg_tile = tile_data[start_tile];
+std::size_t LCD::RenderTile(const BGAttrs& bg_tile, std::size_t row_pixel, std::size_t tile_row,
+                            std::size_t throwaway) {
+    // If this tile has the Y flip flag set, use the mirrored row in the other half of the tile.
+    const auto& indices = TileRow(BGTileNum(bg_tile), (bg_tile.y_flip) ? (7 - tile_row) : tile_row, bg_tile.x_flip);
+    const u16* colours = bg_colours.data() + bg_tile.palette_num * 4;
+
+    // Record the palette index for each pixel and the bg priority bit, and throw away the first pixels of the tile.
+    for (std::size_t pixel = throwaway; pixel < 8; ++pixel) {
+        row_bg_info[row_pixel] = (indices[pixel] << 1) | bg_tile.above_sprites;
+        row_buffer[row_pixel] = colours[indices[pixel]];
+        ++row_pixel;
+    }
 
-    // If this tile has the Y flip flag set, decode the mirrored row in the other half of the tile.
-    DecodePaletteIndices(bg_tile.tile, (bg_tile.y_flip) ? (14 - tile_row) : tile_row);
+    // Return the number of pixels written to the row buffer.
+    return row_pixel;
+}
 
-    // If this tile has the X flip flag set, reverse the pixels.
-    if (bg_tile.x_flip) {
-        std::reverse(pixel_colours.begin(), pixel_colours.end());
+std::size_t LCD::BGTileNum(const BGAttrs& bg_tile) const {
+    // The background tiles are located at either 0x8000-0x8FFF or 0x8800-0x97FF. For the first region, the
+    // tile map indices are unsigned offsets from 0x8000; for the second region, the indices are signed
+    // offsets from 0x9000.
+    const std::size_t bank_start = bg_tile.bank_num * tiles_per_bank;
+    if (TileDataStartAddr() == 0x9000) {
+        return bank_start + 256 + static_cast<s8>(bg_tile.index);
+    } else {
+        return bank_start + bg_tile.index;
     }
+}
 
-    // Record the palette index for each pixel and the bg priority bit.
-    for (std::size_t pixel = throwaway; pixel < 8; ++pixel) {
-        row_bg_info[start_pixel++] = (pixel_colours[pixel] << 1) | bg_tile.above_sprites;
+const std::array<u8, 8>& LCD::TileRow(std::size_t tile_num, std::size_t row, bool x_flip) {
+    DecodedTile& decoded = tile_cache[tile_num];
+
+    if (tile_dirty[tile_num]) {
+        std::array<u8, tile_bytes> tile;
+        const int bank_num = tile_num / tiles_per_bank;
+        const u16 tile_addr = 0x8000 + (tile_num % tiles_per_bank) * tile_bytes;
+        CopyFromVRAM(tile_addr, tile_bytes, bank_num, tile.begin());
+
+        for (std::size_t r = 0; r < 8; ++r) {
+            DecodePaletteIndices(tile, r * 2);
+            for (std::size_t j = 0; j < 8; ++j) {
+                decoded.rows[r][j] = static_cast<u8>(pixel_colours[j]);
+                decoded.flipped_rows[r][7 - j] = static_cast<u8>(pixel_colours[j]);
+            }
+        }
+
+        tile_dirty[tile_num] = false;
     }
-    start_pixel -= 8 - throwaway;
 
+    return (x_flip) ? decoded.flipped_rows[row] : decoded.rows[row];
+}
+
+void LCD::UpdatePaletteColours() {
     if (mem->game_mode == GameMode::DMG) {
-        GetPixelColoursFromPaletteDMG(bg_palette_dmg, false);
+        for (std::size_t i = 0; i < 4; ++i) {
+            bg_colours[i] = shades[(bg_palette_dmg >> (i * 2)) & 0x03];
+            obj_colours[i] = shades[(obj_palette_dmg0 >> (i * 2)) & 0x03];
+            obj_colours[4 + i] = shades[(obj_palette_dmg1 >> (i * 2)) & 0x03];
+        }
     } else {
-        GetPixelColoursFromPaletteCGB(bg_tile.palette_num, false);
-    }
-
-    // Throw away the first pixels of the tile.
-    for (std::size_t pixel = throwaway; pixel < 8; ++pixel) {
-        row_buffer[start_pixel++] = pixel_colours[pixel];
+        for (std::size_t i = 0; i < 32; ++i) {
+            bg_colours[i] = (static_cast<u16>(bg_palette_data[i * 2 + 1] & 0x7F) << 8) | bg_palette_data[i * 2];
+            obj_colours[i] = (static_cast<u16>(obj_palette_data[i * 2 + 1] & 0x7F) << 8) | obj_palette_data[i * 2];
+        }
     }
 
-    // Return the number of pixels written to the row buffer.
-    return start_pixel;
+    palettes_dirty = false;
 }
 
 void LCD::RenderSprites() {
+    TIMING_SCOPE(Sprites);
     SearchOAM();
 
-    FetchSpriteTiles();
-
     // Each row of 8 pixels in a tile is 2 bytes. The first byte contains the low bit of the palette index for
     // each pixel, and the second byte contains the high bit of the palette index.
-    for (const auto& sa : oam_sprites) {
+    for (std::size_t s = 0; s < num_line_sprites; ++s) {
+        const SpriteAttrs& sa = line_sprites[s];
+
         // Determine which row of the sprite tile is being drawn.
         std::size_t tile_row = (ly - (sa.y_pos - 16));
 
@@ -461,20 +587,15 @@ void LCD::RenderSprites() {
             tile_row = (SpriteSize() - 1) - tile_row;
         }
 
-        // Two bytes per tile row.
-        tile_row *= 2;
-
-        DecodePaletteIndices(sa.sprite_tiles, tile_row);
+        // Sprite tiles can only be located in 0x8000-0x8FFF, and the second tile of an 8x16 sprite directly
+        // follows the first. If this sprite has the X flip flag set, the pixels come from the reversed row.
+        const std::size_t tile_num = sa.bank_num * tiles_per_bank + sa.tile_index + tile_row / 8;
+        const auto& indices = TileRow(tile_num, tile_row % 8, sa.x_flip);
+        const u16* colours = obj_colours.data() + sa.palette_num * 4;
 
-        if (mem->game_mode == GameMode::DMG) {
-            GetPixelColoursFromPaletteDMG((sa.palette_num) ? obj_palette_dmg1 : obj_palette_dmg0, true);
-        } else {
-            GetPixelColoursFromPaletteCGB(sa.palette_num, true);
-        }
-
-        // If this sprite has the X flip flag set, reverse the pixels.
-        if (sa.x_flip) {
-            std::reverse(pixel_colours.begin(), pixel_colours.end());
+        for (std::size_t j = 0; j < 8; ++j) {
+            // Palette index 0 is transparent for sprites. Set the alpha bit.
+            pixel_colours[j] = (indices[j] == 0) ? 0x8000 : colours[indices[j]];
         }
 
         auto pixel_iter = pixel_colours.cbegin(), pixel_end_iter = pixel_colours.cend();
@@ -519,41 +640,64 @@ void LCD::RenderSprites() {
     }
 }
 
-void LCD::SearchOAM() {
+void LCD::BinSprites() {
     // The sprite_gap is the distance between the bottom of the sprite and its Y position (8 for 8x8, 0 for 8x16).
-    unsigned int sprite_gap = SpriteSize() % 16;
-    // The tile index mask is 0xFF for 8x8, 0xFE for 8x16.
-    u8 index_mask = (sprite_gap >> 3) | 0xFE;
+    const int sprite_gap = SpriteSize() % 16;
 
-    // Store the first 10 sprites from OAM which are on this scanline.
-    oam_sprites.clear();
+    num_binned_sprites.fill(0);
     for (std::size_t i = 0; i < oam.size(); i += 4) {
         // Check that the sprite is not off the screen.
-        if (oam[i] > sprite_gap && oam[i] < 160) {
-            // Check that the sprite is on the current scanline.
-            if (ly < oam[i] - sprite_gap && static_cast<int>(ly) >= static_cast<int>(oam[i]) - 16) {
-                oam_sprites.emplace_front(oam[i], oam[i+1], oam[i+2] & index_mask, oam[i+3], mem->game_mode);
-            }
+        const int y = oam[i];
+        if (y <= sprite_gap || y >= 160) {
+            continue;
         }
 
-        if (oam_sprites.size() == 10) {
-            break;
+        // Only the first 10 sprites from OAM on each scanline are drawn.
+        const int last_line = std::min(y - sprite_gap, 144);
+        for (int line = std::max(y - 16, 0); line < last_line; ++line) {
+            if (num_binned_sprites[line] < 10) {
+                binned_sprites[line][num_binned_sprites[line]++] = static_cast<u8>(i);
+            }
         }
     }
 
-    // Remove all sprites with an off-screen X position.
-    oam_sprites.erase(std::remove_if(oam_sprites.begin(), oam_sprites.end(), [](SpriteAttrs sa) {
-                          return sa.x_pos >= 168 || sa.x_pos == 0;
-                      }),
-                      oam_sprites.end());
+    binned_sprite_size = SpriteSize();
+    oam_dirty = false;
+}
+
+void LCD::SearchOAM() {
+    if (oam_dirty || binned_sprite_size != SpriteSize()) {
+        BinSprites();
+    }
+
+    // The tile index mask is 0xFF for 8x8, 0xFE for 8x16.
+    const u8 index_mask = (SpriteSize() == 16) ? 0xFE : 0xFF;
+
+    // Store the sprites on this scanline in decreasing OAM position, skipping those with an off-screen X position.
+    num_line_sprites = 0;
+    for (std::size_t s = num_binned_sprites[ly]; s-- > 0; ) {
+        const std::size_t i = binned_sprites[ly][s];
+        if (oam[i+1] >= 168 || oam[i+1] == 0) {
+            continue;
+        }
+
+        line_sprites[num_line_sprites++] = {oam[i], oam[i+1], static_cast<u8>(oam[i+2] & index_mask), oam[i+3],
+                                            mem->game_mode};
+    }
 
     if (mem->game_mode == GameMode::DMG) {
         // Sprite are drawn in descending X order. If two sprites overlap, the one that has a lower position in OAM
-        // is drawn on top. oam_sprites already contains the sprites for this line in decreasing OAM position, so
+        // is drawn on top. line_sprites already contains the sprites for this line in decreasing OAM position, so
         // we sort them by decreasing X position. In CGB mode, sprites are always drawn according to OAM position.
-        std::stable_sort(oam_sprites.begin(), oam_sprites.end(), [](SpriteAttrs sa1, SpriteAttrs sa2) {
-            return sa2.x_pos < sa1.x_pos;
-        });
+        // This is a stable insertion sort, which avoids the allocation std::stable_sort makes for its buffer.
+        for (std::size_t s = 1; s < num_line_sprites; ++s) {
+            const SpriteAttrs sa = line_sprites[s];
+            std::size_t j = s;
+            for (; j > 0 && line_sprites[j - 1].x_pos < sa.x_pos; --j) {
+                line_sprites[j] = line_sprites[j - 1];
+            }
+            line_sprites[j] = sa;
+        }
     }
 }
 
@@ -563,7 +707,7 @@ void LCD::InitTileMap(u16 tile_map_addr) {
 
     // Get the current row of tile indices from VRAM.
     std::array<u8, tile_map_row_len> row_tile_map;
-    mem->CopyFromVRAM(tile_map_addr, tile_map_row_len, 0, row_tile_map.begin());
+    CopyFromVRAM(tile_map_addr, tile_map_row_len, 0, row_tile_map.begin());
 
     tile_data.clear();
 
@@ -574,7 +718,7 @@ void LCD::InitTileMap(u16 tile_map_addr) {
     } else {
         // Get the current row of background tile attributes from VRAM.
         std::array<u8, tile_map_row_len> row_attr_map;
-        mem->CopyFromVRAM(tile_map_addr, tile_map_row_len, 1, row_attr_map.begin());
+        CopyFromVRAM(tile_map_addr, tile_map_row_len, 1, row_attr_map.begin());
 
         for (std::size_t i = 0; i < row_tile_map.size(); ++i) {
             tile_data.emplace_back(row_tile_map[i], row_attr_map[i]);
@@ -603,19 +747,6 @@ void LCD::FetchTiles() {
     }
 }
 
-void LCD::FetchSpriteTiles() {
-    std::size_t tile_size = tile_bytes;
-    if (SpriteSize() == 16) {
-        tile_size *= 2;
-    }
-
-    // Sprite tiles can only be located in 0x8000-0x8FFF.
-    for (auto& sa : oam_sprites) {
-        u16 tile_addr = 0x8000 | (static_cast<u16>(sa.tile_index) << 4);
-        mem->CopyFromVRAM(tile_addr, tile_size, sa.bank_num, sa.sprite_tiles.begin());
-    }
-}
-
 void LCD::GetPixelColoursFromPaletteDMG(u8 palette, bool sprite) {
     for (auto& colour : pixel_colours) {
         if (sprite && colour == 0) {
@@ -646,4 +777,40 @@ void LCD::GetPixelColoursFromPaletteCGB(int palette_num, bool sprite) {
     }
 }
 
+void LCD::Serialize(Common::StateBuffer& state) {
+    Sync();
+    state.BeginChunk("LCD ", 1);
+    state.Sync(oam);
+    if (state.Loading()) {
+        oam_dirty = true;
+        palettes_dirty = true;
+        tile_dirty.fill(true);
+    }
+    state.Sync(lcdc);
+    state.Sync(stat);
+    state.Sync(scroll_y);
+    state.Sync(scroll_x);
+    state.Sync(ly);
+    state.Sync(ly_compare);
+    state.Sync(bg_palette_dmg);
+    state.Sync(obj_palette_dmg0);
+    state.Sync(obj_palette_dmg1);
+    state.Sync(window_y);
+    state.Sync(window_x);
+    state.Sync(bg_palette_index);
+    state.Sync(bg_palette_data);
+    state.Sync(obj_palette_index);
+    state.Sync(obj_palette_data);
+
+    state.Sync(lcd_on);
+    state.Sync(scanline_cycles);
+    state.Sync(current_scanline);
+    state.Sync(stat_interrupt_signal);
+    state.Sync(prev_interrupt_signal);
+    state.Sync(ly_last_cycle);
+    state.Sync(ly_compare_equal_forced_zero);
+    state.Sync(window_progress);
+    state.EndChunk();
+}
+
 } // End namespace Gb
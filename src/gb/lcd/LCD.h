@@ -18,16 +18,19 @@
 
 #include <vector>
 #include <array>
-#include <deque>
+#include <algorithm>
 
 #include "common/CommonTypes.h"
 #include "gb/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gb {
 
 class Memory;
 class GameBoy;
 class Logging;
+class RenderThread;
 
 struct BGAttrs {
     BGAttrs(u8 tile_index);
@@ -41,29 +44,75 @@ struct BGAttrs {
 };
 
 struct SpriteAttrs {
+    SpriteAttrs() = default;
     SpriteAttrs(u8 y, u8 x, u8 index, u8 attrs, GameMode game_mode);
 
     u8 y_pos, x_pos, tile_index;
     bool behind_bg, y_flip, x_flip;
     int palette_num, bank_num;
-
-    std::array<u8, 32> sprite_tiles;
 };
 
 class LCD {
     friend class Logging;
+    friend class RenderThread;
+    friend class Benchmark;
 public:
     LCD();
 
     void UpdateLCD();
 
-    void LinkToMemory(Memory* memory) { mem = memory; }
+    // Between mode and line changes, an LCD update only advances the cycle count. So instead of updating every
+    // machine cycle, the elapsed cycles are accumulated until a register is accessed or the next change is due.
+    // Returns false if the LCD needs to be updated every machine cycle for these cycles.
+    bool Defer(unsigned int cycles);
+    // Brings the LCD up to date. Must be called before its registers are read or written.
+    void Sync();
+
+    void LinkToMemory(Memory* memory);
     void LinkToGameBoy(GameBoy* gb) { gameboy = gb; }
+    // Lines are drawn on the render thread instead of inline, and every write which affects drawing is forwarded
+    // to it.
+    void LinkToRenderThread(RenderThread* thread) { render_thread = thread; }
 
     void SetSTATSignal() { stat_interrupt_signal = true; }
 
     void DumpEverything();
 
+    void Serialize(Common::StateBuffer& state);
+
+    // Called on every VRAM write, with the offset of the written byte from the start of VRAM bank 0.
+    void VRAMWritten(std::size_t vram_offset) {
+        if ((vram_offset & 0x1FFF) < 0x1800) {
+            tile_dirty[(vram_offset >> 13) * tiles_per_bank + ((vram_offset & 0x1FFF) >> 4)] = true;
+        }
+        if (render_thread) {
+            ForwardVRAMWrite(vram_offset);
+        }
+    }
+    // Called on every OAM write, after the byte has been written.
+    void OAMWritten(std::size_t index) {
+        oam_dirty = true;
+        if (render_thread) {
+            ForwardOAMWrite(index);
+        }
+    }
+    // Called on every write to the DMG or CGB palettes, with the register written, before the CGB palette index
+    // auto-increments.
+    void PaletteWritten(u16 addr) {
+        palettes_dirty = true;
+        if (render_thread) {
+            ForwardPaletteWrite(addr);
+        }
+    }
+    // Set on any write to the DMG or CGB palettes, so their colours are looked up again before the next line is drawn.
+    bool palettes_dirty = true;
+
+    // Only every render_skip-th frame is drawn and presented, for fast-forwarding. Skipped frames still run all the
+    // display timing, STAT interrupts, and HDMAs.
+    int render_skip = 1;
+    // Overrides whether the rest of the current frame is drawn, for run-ahead.
+    void SetSkipFrame(bool skip) { skip_frame = skip; }
+
     // ******** OAM ********
     // The Object Attribute Memory (OAM) contains 40 sprite attributes each 4 bytes long.
     // Byte 0: the Y position of the sprite, minus 16.
@@ -80,6 +129,8 @@ public:
     //     Bit 3: Tile VRAM bank (0=bank 0, 1=bank 1) (CGB mode only)
     //     Bit 2-0: Palette number (selects OBP0-7) (CGB mode only)
     std::array<u8, 0xA0> oam{};
+    // Set on any write to OAM, so the sprites are binned by scanline again before the next line is drawn.
+    bool oam_dirty = true;
 
     // ******** LCD I/O registers ********
     // LCDC register: 0xFF40
@@ -151,6 +202,11 @@ public:
 private:
     Memory* mem;
     GameBoy* gameboy;
+    // Only set when drawing on a render thread.
+    RenderThread* render_thread = nullptr;
+    void ForwardVRAMWrite(std::size_t vram_offset);
+    void ForwardOAMWrite(std::size_t index);
+    void ForwardPaletteWrite(u16 addr);
 
     bool lcd_on = true;
     void UpdatePowerOnState();
@@ -165,6 +221,14 @@ private:
     bool stat_interrupt_signal = false, prev_interrupt_signal = false;
     void CheckSTATInterruptSignal();
 
+    // Cycles which have passed but have not yet been applied, and the number of cycles remaining until the next
+    // scanline cycle where something can change. A register write can take effect on the next machine cycle, so
+    // the LCD isn't settled until it has been updated normally once since the last sync.
+    unsigned int deferred_cycles = 0;
+    unsigned int event_countdown = 0;
+    bool settled = false;
+    int NextEventCycle() const;
+
     // LY=LYC interrupt
     u8 ly_last_cycle = 0xFF;
     bool ly_compare_equal_forced_zero = false;
@@ -175,8 +239,43 @@ private:
     static constexpr std::size_t tile_bytes = 16;
     const std::array<u16, 4> shades{{0x7FFF, 0x56B5, 0x294A, 0x0000}};
 
+    // Where lines are drawn from. This is the memory's VRAM, except in the render thread's LCD, which draws from
+    // the render thread's own copy.
+    const u8* vram = nullptr;
+    template<typename DestIter>
+    void CopyFromVRAM(const u16 start_addr, const std::size_t num_bytes, const int bank_num, DestIter dest) const {
+        std::copy_n(vram + (start_addr - 0x8000) + 0x2000 * bank_num, num_bytes, dest);
+    }
+
     std::vector<BGAttrs> tile_data;
-    std::deque<SpriteAttrs> oam_sprites;
+
+    // The palette indices for every row of every tile in VRAM, decoded in both normal and X-flipped order. A tile is
+    // decoded again the next time it is drawn after being written.
+    struct DecodedTile {
+        std::array<std::array<u8, 8>, 8> rows;
+        std::array<std::array<u8, 8>, 8> flipped_rows;
+    };
+    static constexpr std::size_t tiles_per_bank = 384;
+    std::vector<DecodedTile> tile_cache;
+    std::array<bool, tiles_per_bank * 2> tile_dirty;
+    const std::array<u8, 8>& TileRow(std::size_t tile_num, std::size_t row, bool x_flip);
+    std::size_t BGTileNum(const BGAttrs& bg_tile) const;
+
+    // The colours of each palette, four entries per palette. On DMG, the BG colours hold BGP, and the sprite colours
+    // hold OBP0 followed by OBP1.
+    std::array<u16, 32> bg_colours;
+    std::array<u16, 32> obj_colours;
+    void UpdatePaletteColours();
+    // The sprites on the current scanline, in the order they are drawn.
+    std::array<SpriteAttrs, 10> line_sprites;
+    std::size_t num_line_sprites = 0;
+
+    // The OAM indices of the first 10 sprites on each scanline, found with a single pass over OAM whenever it or the
+    // sprite size changes.
+    std::array<std::array<u8, 10>, 144> binned_sprites;
+    std::array<u8, 144> num_binned_sprites;
+    int binned_sprite_size = 0;
+    void BinSprites();
 
     std::array<u16, 8> pixel_colours;
     std::array<u16, 168> row_buffer;
@@ -185,16 +284,19 @@ private:
 
     u8 window_progress = 0x00;
 
+    int skip_frame_count = 0;
+    bool skip_frame = false;
+    void UpdateFrameSkip();
+
     void RenderScanline();
     void RenderBackground(std::size_t num_bg_pixels);
     void RenderWindow(std::size_t num_bg_pixels);
-    std::size_t RenderFirstTile(std::size_t start_pixel, std::size_t start_tile, std::size_t tile_row,
-                                std::size_t throwaway);
+    std::size_t RenderTile(const BGAttrs& bg_tile, std::size_t row_pixel, std::size_t tile_row,
+                           std::size_t throwaway);
     void RenderSprites();
     void SearchOAM();
     void InitTileMap(u16 tile_map_addr);
     void FetchTiles();
-    void FetchSpriteTiles();
     void GetPixelColoursFromPaletteDMG(u8 palette, bool sprite);
     void GetPixelColoursFromPaletteCGB(int palette_num, bool sprite);
     template<std::size_t N>
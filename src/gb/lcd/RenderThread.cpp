@@ -0,0 +1,188 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+
+#include "gb/lcd/RenderThread.h"
+#include "gb/lcd/LCD.h"
+#include "gb/core/GameBoy.h"
+#include "gb/memory/Memory.h"
+#include "common/StateBuffer.h"
+
+namespace Gb {
+
+RenderThread::RenderThread(Memory& mem, LCD& main_lcd, GameBoy& gb)
+        : gameboy(gb)
+        , vram(mem.VRAMReference())
+        , lcd(std::make_unique<LCD>()) {
+
+    // The render-only LCD only uses the memory for the console and game mode, which never change.
+    lcd->LinkToMemory(&mem);
+    lcd->vram = vram.data();
+    Resync(mem, main_lcd);
+
+    // A scanline rarely needs more than a handful of writes, but a DMA to OAM or VRAM can queue a few hundred.
+    pending.reserve(512);
+    queued.reserve(512);
+    running.reserve(512);
+
+    worker = std::thread(&RenderThread::WorkerLoop, this);
+}
+
+RenderThread::~RenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        quit = true;
+    }
+
+    work_available.notify_one();
+    worker.join();
+}
+
+void RenderThread::DrawScanline(const LineRegisters& regs) {
+    pending.push_back({Command::DrawScanline, 0, 0, 0, regs});
+    Submit();
+}
+
+void RenderThread::EndFrame(bool present) {
+    Submit();
+    WaitForIdle();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    // The worker is idle, so its back buffer can be swapped safely.
+    if (present) {
+        gameboy.SwapBuffers(lcd->back_buffer);
+    }
+}
+
+void RenderThread::ClearFrame() {
+    Submit();
+    WaitForIdle();
+
+    std::fill(lcd->back_buffer.begin(), lcd->back_buffer.end(), 0x7FFF);
+    gameboy.SwapBuffers(lcd->back_buffer);
+}
+
+void RenderThread::Resync(const Memory& mem, LCD& main_lcd) {
+    WaitForIdle();
+    pending.clear();
+
+    std::copy(mem.VRAMReference().cbegin(), mem.VRAMReference().cend(), vram.begin());
+
+    Common::StateBuffer saved_lcd;
+    main_lcd.Serialize(saved_lcd);
+    Common::StateBuffer loaded_lcd{saved_lcd.Data()};
+    lcd->Serialize(loaded_lcd);
+}
+
+void RenderThread::Submit() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queued.insert(queued.end(), pending.cbegin(), pending.cend());
+    }
+
+    pending.clear();
+    work_available.notify_one();
+}
+
+void RenderThread::WaitForIdle() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    work_done.wait(lock, [this] { return queued.empty() && !busy; });
+}
+
+void RenderThread::WorkerLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            busy = false;
+            if (queued.empty()) {
+                work_done.notify_one();
+            }
+
+            work_available.wait(lock, [this] { return quit || !queued.empty(); });
+            if (quit) {
+                return;
+            }
+
+            running.swap(queued);
+            busy = true;
+        }
+
+        try {
+            for (const auto& command : running) {
+                Run(command);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            error = std::current_exception();
+        }
+
+        running.clear();
+    }
+}
+
+void RenderThread::Run(const Command& command) {
+    switch (command.type) {
+    case Command::WriteVRAM:
+        vram[command.addr] = command.data;
+        lcd->VRAMWritten(command.addr);
+        break;
+    case Command::WriteOAM:
+        lcd->oam[command.addr] = command.data;
+        lcd->OAMWritten(command.addr);
+        break;
+    case Command::WritePalette:
+        switch (command.addr) {
+        case 0xFF47:
+            lcd->bg_palette_dmg = command.data;
+            break;
+        case 0xFF48:
+            lcd->obj_palette_dmg0 = command.data;
+            break;
+        case 0xFF49:
+            lcd->obj_palette_dmg1 = command.data;
+            break;
+        case 0xFF69:
+            lcd->bg_palette_data[command.index] = command.data;
+            break;
+        case 0xFF6B:
+            lcd->obj_palette_data[command.index] = command.data;
+            break;
+        default:
+            break;
+        }
+        lcd->palettes_dirty = true;
+        break;
+    case Command::DrawScanline:
+        lcd->ly = command.regs.ly;
+        lcd->lcdc = command.regs.lcdc;
+        lcd->scroll_y = command.regs.scroll_y;
+        lcd->scroll_x = command.regs.scroll_x;
+        lcd->window_y = command.regs.window_y;
+        lcd->window_x = command.regs.window_x;
+        lcd->window_progress = command.regs.window_progress;
+        lcd->RenderScanline();
+        break;
+    default:
+        break;
+    }
+}
+
+} // End namespace Gb
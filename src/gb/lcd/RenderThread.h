@@ -0,0 +1,113 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "common/CommonTypes.h"
+
+namespace Gb {
+
+class GameBoy;
+class Memory;
+class LCD;
+
+// Draws scanlines on a worker thread while the CPU keeps running. The render thread owns its own copy of VRAM and
+// its own render-only LCD, with its own OAM and palettes. Every write to them is queued in order alongside the
+// scanlines to be drawn, and each scanline carries the registers latched at the start of its mode 3, so the worker
+// draws exactly what the synchronous renderer would have, and frames stay deterministic.
+class RenderThread {
+public:
+    // The registers a scanline is drawn with.
+    struct LineRegisters {
+        u8 ly;
+        u8 lcdc;
+        u8 scroll_y;
+        u8 scroll_x;
+        u8 window_y;
+        u8 window_x;
+        u8 window_progress;
+    };
+
+    RenderThread(Memory& mem, LCD& main_lcd, GameBoy& gb);
+    ~RenderThread();
+
+    void WriteVRAM(std::size_t offset, u8 value) {
+        pending.push_back({Command::WriteVRAM, static_cast<u16>(offset), 0, value, {}});
+    }
+    void WriteOAM(std::size_t index, u8 value) {
+        pending.push_back({Command::WriteOAM, static_cast<u16>(index), 0, value, {}});
+    }
+    // Index is the palette data index for the CGB palette data registers.
+    void WritePalette(u16 addr, u8 index, u8 value) {
+        pending.push_back({Command::WritePalette, addr, index, value, {}});
+    }
+
+    // Queues a scanline, and hands everything queued so far to the worker.
+    void DrawScanline(const LineRegisters& regs);
+    // Waits for the worker to finish the current frame, then presents it unless the frame was skipped.
+    void EndFrame(bool present);
+    // Waits for the worker, then presents a blank frame, for when the LCD is switched off.
+    void ClearFrame();
+    // Discards anything queued and copies the main thread's VRAM and LCD state, after a save state is loaded.
+    void Resync(const Memory& mem, LCD& main_lcd);
+
+private:
+    struct Command {
+        enum Type {WriteVRAM, WriteOAM, WritePalette, DrawScanline};
+
+        Type type;
+        // The VRAM offset, OAM index, or palette register written.
+        u16 addr;
+        u8 index;
+        u8 data;
+        LineRegisters regs;
+    };
+
+    GameBoy& gameboy;
+
+    std::vector<u8> vram;
+    std::unique_ptr<LCD> lcd;
+
+    // Commands are collected without locking on the CPU thread, and handed over to the worker in batches.
+    std::vector<Command> pending;
+    std::vector<Command> queued;
+    std::vector<Command> running;
+
+    std::mutex queue_mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    bool busy = false;
+    bool quit = false;
+    // An exception thrown while drawing, rethrown on the CPU thread at the end of the frame.
+    std::exception_ptr error;
+
+    std::thread worker;
+
+    void Submit();
+    void WaitForIdle();
+    void WorkerLoop();
+    void Run(const Command& command);
+};
+
+} // End namespace Gb
@@ -23,12 +23,15 @@
 #include "gb/hardware/Timer.h"
 #include "gb/lcd/LCD.h"
 #include "gb/cpu/CPU.h"
+#include "common/Trace.h"
 
 namespace Gb {
 
 Logging::Logging(LogLevel log_lvl) : log_level(log_lvl) {
     // Leave log_stream unopened if logging disabled.
-    if (log_level != LogLevel::None) {
+    if (log_level == LogLevel::Binary) {
+        trace = std::make_unique<Common::TraceWriter>("trace.bin", Common::TraceSystem::Gb, sizeof(TraceRecord));
+    } else if (log_level != LogLevel::None) {
         log_stream = std::ofstream("log.txt");
 
         if (!log_stream) {
@@ -37,6 +40,9 @@ Logging::Logging(LogLevel log_lvl) : log_level(log_lvl) {
     }
 }
 
+// Needed to declare std::unique_ptr with forward-declared type in the header file.
+Logging::~Logging() = default;
+
 void Logging::LogCPURegisterState(const Memory& mem, const CPU& cpu) {
     fmt::MemoryWriter cpu_log;
 
@@ -59,6 +65,23 @@ void Logging::LogCPURegisterState(const Memory& mem, const CPU& cpu) {
     log_stream << cpu_log.c_str();
 }
 
+void Logging::TraceCPU(const Memory& mem, const CPU& cpu, u64 timestamp) {
+    TraceRecord record{};
+    record.timestamp = timestamp;
+    record.pc = cpu.pc;
+    record.sp = cpu.regs.reg16[CPU::SP];
+    record.af = cpu.regs.reg16[CPU::AF];
+    record.bc = cpu.regs.reg16[CPU::BC];
+    record.de = cpu.regs.reg16[CPU::DE];
+    record.hl = cpu.regs.reg16[CPU::HL];
+    record.bytes = {{mem.ReadMem(cpu.pc), mem.ReadMem(cpu.pc + 1), mem.ReadMem(cpu.pc + 2)}};
+    record.interrupt_flags = mem.ReadMem(0xFF0F);
+    record.interrupt_enable = mem.ReadMem(0xFFFF);
+    record.halted = cpu.IsHalted();
+
+    trace->Push(record);
+}
+
 void Logging::LogInterrupt(const Memory& mem) {
     auto InterruptString = [&mem]() {
         if (mem.IsPending(Interrupt::VBLANK)) {
@@ -127,6 +150,8 @@ void Logging::SwitchLogLevel() {
             return "LCD";
         case LogLevel::Timer:
             return "Timer";
+        case LogLevel::Binary:
+            return "Binary";
         default:
             return "";
         }
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <array>
+#include <memory>
 #include <fstream>
 
 #include "common/CommonTypes.h"
@@ -30,6 +32,8 @@ typedef BasicMemoryWriter<char, std::allocator<char>> MemoryWriter;
 
 }
 
+namespace Common { class TraceWriter; }
+
 namespace Gb {
 
 class Memory;
@@ -37,24 +41,42 @@ class CPU;
 class Timer;
 class LCD;
 
+// The opcode and up to two operand bytes of an instruction.
+using InstrBytes = std::array<u8, 3>;
+
+// One record per executed instruction when logging in binary trace mode.
+struct TraceRecord {
+    u64 timestamp;
+    u16 pc, sp, af, bc, de, hl;
+    InstrBytes bytes;
+    u8 interrupt_flags;
+    u8 interrupt_enable;
+    u8 halted;
+    std::array<u8, 6> padding;
+};
+
 class Logging {
 public:
     LogLevel log_level;
 
     Logging(LogLevel log_lvl);
+    ~Logging();
 
     void LogCPURegisterState(const Memory& mem, const CPU& cpu);
+    void TraceCPU(const Memory& mem, const CPU& cpu, u64 timestamp);
     void LogInterrupt(const Memory& mem);
     void LogTimerRegisterState(const Timer& timer);
     void LogLCDRegisterState(const LCD& lcd);
 
     void Disassemble(fmt::MemoryWriter& instr_stream, const Memory& mem, const u16 pc) const;
+    static void Disassemble(fmt::MemoryWriter& instr_stream, const InstrBytes& bytes);
 
     void SwitchLogLevel();
 private:
     LogLevel alt_level = LogLevel::None;
 
     std::ofstream log_stream;
+    std::unique_ptr<Common::TraceWriter> trace;
 };
 
 } // End namespace Gb
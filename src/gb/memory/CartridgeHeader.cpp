@@ -23,7 +23,7 @@
 
 namespace Gb {
 
-CartridgeHeader::CartridgeHeader(Console& console, const std::vector<u8>& rom, bool multicart_requested) {
+CartridgeHeader::CartridgeHeader(Console& console, const Common::RomView<u8>& rom, bool multicart_requested) {
     // Determine if this game enables CGB functions. A value of 0xC0 implies the game is CGB-only, and
     // 0x80 implies it can also run on pre-CGB devices. They both have the same effect, as it's up to
     // the game to test if it is running on a pre-CGB device.
@@ -52,7 +52,7 @@ CartridgeHeader::CartridgeHeader(Console& console, const std::vector<u8>& rom, b
 
     GetRAMSize(rom);
     GetMBCType(rom);
-    if (console == Console::DMG && !CheckNintendoLogo(console, rom)) {
+    if (console == Console::DMG && !CheckNintendoLogo(console, rom.data())) {
         fmt::print("WARNING: Nintendo logo does not match. This ROM would not run on a DMG!\n");
     }
     HeaderChecksum(rom);
@@ -68,7 +68,7 @@ CartridgeHeader::CartridgeHeader(Console& console, const std::vector<u8>& rom, b
     }
 }
 
-void CartridgeHeader::GetRAMSize(const std::vector<u8>& rom) {
+void CartridgeHeader::GetRAMSize(const Common::RomView<u8>& rom) {
     // The RAM size identifier is at 0x0149 in cartridge header.
     switch (rom[0x0149]) {
     case 0x00:
@@ -102,7 +102,7 @@ void CartridgeHeader::GetRAMSize(const std::vector<u8>& rom) {
     }
 }
 
-void CartridgeHeader::GetMBCType(const std::vector<u8>& rom) {
+void CartridgeHeader::GetMBCType(const Common::RomView<u8>& rom) {
     // The MBC type is at 0x0147. The MBC identifier also tells us if this cartridge contains external RAM.
     switch (rom[0x0147]) {
     case 0x00:
@@ -227,7 +227,7 @@ void CartridgeHeader::GetMBCType(const std::vector<u8>& rom) {
     }
 }
 
-void CartridgeHeader::HeaderChecksum(const std::vector<u8>& rom) const {
+void CartridgeHeader::HeaderChecksum(const Common::RomView<u8>& rom) const {
     u8 checksum = 0;
     for (std::size_t i = 0x0134; i < 0x014D; ++i) {
         checksum -= rom[i] + 1;
@@ -240,7 +240,7 @@ void CartridgeHeader::HeaderChecksum(const std::vector<u8>& rom) const {
     }
 }
 
-bool CartridgeHeader::CheckNintendoLogo(const Console console, const std::vector<u8>& rom) noexcept {
+bool CartridgeHeader::CheckNintendoLogo(const Console console, const u8* rom) noexcept {
     // Calculate the FNV-1a hash of the first or second half of the region in the ROM header where the Nintendo logo
     // is supposed to be (0x0104-0x0133) and compare it to a precalculated hash of the expected logo.
     static constexpr u32 logo_first_half_hash = 0x14BDDD1B;
@@ -249,12 +249,12 @@ bool CartridgeHeader::CheckNintendoLogo(const Console console, const std::vector
 
     if (console == Console::CGB) {
         // The CGB boot ROM only checks the first half (24 bytes) of the logo.
-        u32 header_first_half_hash = Fnv1aHash(rom.cbegin() + logo_offset, rom.cbegin() + logo_offset + 24);
+        u32 header_first_half_hash = Fnv1aHash(rom + logo_offset, rom + logo_offset + 24);
         return header_first_half_hash == logo_first_half_hash;
     } else {
         // The DMG boot ROM checks all 48 bytes, but since we always check the first 24 bytes during cart detection,
         // here we only check the last 24 bytes.
-        u32 header_second_half_hash = Fnv1aHash(rom.cbegin() + logo_offset + 24, rom.cbegin() + logo_offset + 48);
+        u32 header_second_half_hash = Fnv1aHash(rom + logo_offset + 24, rom + logo_offset + 48);
         return header_second_half_hash == logo_second_half_hash;
     }
 }
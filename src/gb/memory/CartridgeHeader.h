@@ -19,15 +19,16 @@
 #include <vector>
 
 #include "common/CommonTypes.h"
+#include "common/MappedFile.h"
 #include "gb/core/Enums.h"
 
 namespace Gb {
 
 class CartridgeHeader {
 public:
-    CartridgeHeader(Console& console, const std::vector<u8>& rom, bool multicart_requested);
+    CartridgeHeader(Console& console, const Common::RomView<u8>& rom, bool multicart_requested);
 
-    static bool CheckNintendoLogo(const Console console, const std::vector<u8>& rom) noexcept;
+    static bool CheckNintendoLogo(const Console console, const u8* rom) noexcept;
 
     GameMode game_mode;
     MBC mbc_mode;
@@ -37,9 +38,9 @@ public:
     bool rtc_present = false;
     bool rumble_present = false;
 private:
-    void GetRAMSize(const std::vector<u8>& rom);
-    void GetMBCType(const std::vector<u8>& rom);
-    void HeaderChecksum(const std::vector<u8>& rom) const;
+    void GetRAMSize(const Common::RomView<u8>& rom);
+    void GetMBCType(const Common::RomView<u8>& rom);
+    void HeaderChecksum(const Common::RomView<u8>& rom) const;
 };
 
 } // End namespace Gb
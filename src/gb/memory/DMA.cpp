@@ -18,17 +18,33 @@
 
 #include "gb/memory/Memory.h"
 #include "gb/lcd/LCD.h"
+#include "common/Timing.h"
 
 namespace Gb {
 
 void Memory::UpdateOAM_DMA() {
+    TIMING_SCOPE(Dma);
     if (oam_dma_state == DMAState::Starting) {
         if (bytes_read != 0) {
             oam_transfer_addr = static_cast<u16>(oam_dma_start) << 8;
+            // If a DMA was already active, its last byte stays on the bus until the new one reads.
+            oam_transfer_byte = OAMDMABusByte();
+            oam_dma_bulk = false;
             bytes_read = 0;
         } else {
             // No write on the startup cycle.
-            oam_transfer_byte = DMACopy(oam_transfer_addr);
+            if (oam_transfer_addr >= 0x8000 && oam_transfer_addr < 0xA000) {
+                // VRAM reads depend on the LCD mode at the time of each read, so copy a byte at a time.
+                oam_transfer_byte = DMACopy(oam_transfer_addr);
+            } else {
+                // The CPU can't write to the bus the DMA is reading from, so the source can't change during the
+                // transfer. Copy it all at once.
+                for (unsigned int i = 0; i < 160; ++i) {
+                    lcd.oam[i] = DMACopy(oam_transfer_addr + i);
+                    lcd.OAMWritten(i);
+                }
+                oam_dma_bulk = true;
+            }
             ++bytes_read;
 
             oam_dma_state = DMAState::Active;
@@ -49,23 +65,44 @@ void Memory::UpdateOAM_DMA() {
             }
         }
     } else if (oam_dma_state == DMAState::Active) {
-        // Write the byte which was read last cycle to OAM.
-        lcd.oam[bytes_read - 1] = oam_transfer_byte;
+        if (!oam_dma_bulk) {
+            // Write the byte which was read last cycle to OAM.
+            lcd.oam[bytes_read - 1] = oam_transfer_byte;
+            lcd.OAMWritten(bytes_read - 1);
+        }
 
         if (bytes_read == 160) {
             // Don't read on the last cycle.
+            oam_transfer_byte = OAMDMABusByte();
+            oam_dma_bulk = false;
             oam_dma_state = DMAState::Inactive;
             dma_bus_block = Bus::None;
             return;
         }
 
         // Read the next byte.
-        oam_transfer_byte = DMACopy(oam_transfer_addr + bytes_read);
+        if (!oam_dma_bulk) {
+            oam_transfer_byte = DMACopy(oam_transfer_addr + bytes_read);
+        }
         ++bytes_read;
     }
 }
 
+void Memory::CopyOAM_DMA() {
+    const u16 source = static_cast<u16>(oam_dma_start) << 8;
+    for (unsigned int i = 0; i < 160; ++i) {
+        lcd.oam[i] = DMACopy(source + i);
+        lcd.OAMWritten(i);
+    }
+}
+
+u8 Memory::OAMDMABusByte() const {
+    // After a bulk copy, the byte read on the last cycle has already been written to OAM.
+    return (oam_dma_bulk) ? lcd.oam[bytes_read - 1] : oam_transfer_byte;
+}
+
 void Memory::UpdateHDMA() {
+    TIMING_SCOPE(Dma);
     if (hdma_reg_written) {
         if (hdma_state == DMAState::Inactive) {
             InitHDMA();
@@ -119,8 +156,7 @@ void Memory::InitHDMA() {
 }
 
 void Memory::ExecuteHDMA() {
-    u16 hdma_source = (static_cast<u16>(hdma_source_hi) << 8) | hdma_source_lo;
-    u16 hdma_dest = (static_cast<u16>(hdma_dest_hi | 0x80) << 8) | hdma_dest_lo;
+    TIMING_SCOPE(Dma);
 
     // The HDMA circuit always functions at a fixed speed. Every m-cycle it transfers two bytes in single speed
     // mode and one byte in double speed mode. However, if there is only one byte left to transfer (or one hblank byte
@@ -132,11 +168,32 @@ void Memory::ExecuteHDMA() {
         hblank_bytes -= num_bytes;
     }
 
+    if (hdma_bytes_ahead == 0 && bytes_to_copy % 16 == 0 && (lcd.stat & 0x03) < 2) {
+        // A block started in HBLANK or VBLANK finishes before the LCD can reach mode 3 and lock VRAM, and the CPU
+        // is stalled until then. Copy the whole block now.
+        hdma_bytes_ahead = 16;
+        CopyHDMA(16);
+    }
+
     bytes_to_copy -= num_bytes;
 
+    if (hdma_bytes_ahead != 0) {
+        hdma_bytes_ahead -= num_bytes;
+    } else {
+        CopyHDMA(num_bytes);
+    }
+
+    hdma_control = ((bytes_to_copy / 16) - 1) & 0x7F;
+}
+
+void Memory::CopyHDMA(int num_bytes) {
+    u16 hdma_source = (static_cast<u16>(hdma_source_hi) << 8) | hdma_source_lo;
+    u16 hdma_dest = (static_cast<u16>(hdma_dest_hi | 0x80) << 8) | hdma_dest_lo;
+
     for (int i = 0; i < num_bytes; ++i) {
         if ((lcd.stat & 0x03) != 3) {
-            vram[hdma_dest - 0x8000 + 0x2000 * vram_bank_num] = DMACopy(hdma_source);
+            vram_ptr[hdma_dest - 0x8000] = DMACopy(hdma_source);
+            lcd.VRAMWritten(0x2000 * vram_bank_num + hdma_dest - 0x8000);
         }
 
         // Mask hdma_dest so it wraps around to the beginning of VRAM in case it increments past 0x9FFF.
@@ -148,8 +205,6 @@ void Memory::ExecuteHDMA() {
     hdma_source_hi = hdma_source >> 8;
     hdma_dest_lo = hdma_dest & 0x00FF;
     hdma_dest_hi = (hdma_dest >> 8) & 0x1F;
-
-    hdma_control = ((bytes_to_copy / 16) - 1) & 0x7F;
 }
 
 void Memory::SignalHDMA() {
@@ -162,21 +217,15 @@ void Memory::SignalHDMA() {
 u8 Memory::DMACopy(const u16 addr) const {
     if (addr < 0x4000) {
         // ROM0 bank
-        if (mbc_mode == MBC::MBC1) {
-            return rom[addr + 0x4000 * ((ram_bank_num << 5) & (num_rom_banks - 1))];
-        } else if (mbc_mode == MBC::MBC1M) {
-            return rom[addr + 0x4000 * ((ram_bank_num << 4) & (num_rom_banks - 1))];
-        } else {
-            return rom[addr];
-        }
+        return cheats.PatchRead(addr, rom0_ptr[addr]);
     } else if (addr < 0x8000) {
         // ROM1 bank
-        return rom[addr + 0x4000 * ((rom_bank_num & (num_rom_banks - 1)) - 1)];
+        return cheats.PatchRead(addr, romx_ptr[addr - 0x4000]);
     } else if (addr < 0xA000) {
         // VRAM -- switchable in CGB mode
         // Not accessible during screen mode 3. HDMA/GDMA cannot read VRAM.
         if ((lcd.stat & 0x03) != 3 && hdma_state != DMAState::Active) {
-            return vram[addr - 0x8000 + 0x2000 * vram_bank_num];
+            return vram_ptr[addr - 0x8000];
         } else {
             return 0xFF;
         }
@@ -188,7 +237,7 @@ u8 Memory::DMACopy(const u16 addr) const {
         return wram[addr - 0xC000];
     } else if (addr < 0xE000) {
         // WRAM bank 1 (switchable from 1-7 in CGB mode)
-        return wram[addr - 0xC000 + 0x1000 * ((wram_bank_num == 0) ? 0 : wram_bank_num - 1)];
+        return wram_ptr[addr - 0xD000];
     }
 
     if (hdma_state == DMAState::Active) {
@@ -199,7 +248,7 @@ u8 Memory::DMACopy(const u16 addr) const {
         return wram[addr - 0xE000];
     } else if (addr < 0xF200) {
         // Echo of C000-DDFF
-        return wram[addr - 0xE000 + 0x1000 * ((wram_bank_num == 0) ? 0 : wram_bank_num - 1)];
+        return wram_ptr[addr - 0xF000];
     } else {
         // Only 0x00-0xF1 are valid OAM DMA start addresses (several sources make that claim, at least. I've seen
         // differing ranges mentioned but this seems to work for now).
@@ -14,32 +14,49 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <fstream>
-#include <fmt/format.h>
-
 #include "gb/memory/Memory.h"
 #include "gb/memory/RTC.h"
 
 namespace Gb {
 
-void Memory::SaveExternalRAM(const std::string& save_path) const {
-    if (ext_ram_present) {
-        std::ofstream save_ostream(save_path);
+std::vector<u8> Memory::SaveSnapshot() const {
+    if (!ext_ram_present) {
+        return {};
+    }
 
-        if (!save_ostream) {
-            fmt::print("Error: could not open {} to write save file to disk.\n", save_path);
-        } else {
-            if (rtc_present) {
-                rtc->AppendRTCData(ext_ram);
-            }
+    std::vector<u8> snapshot{ext_ram.begin(), ext_ram.end()};
+    if (rtc_present) {
+        rtc->AppendRTCData(snapshot);
+    }
 
-            save_ostream.write(reinterpret_cast<const char*>(ext_ram.data()), ext_ram.size());
-            save_ostream.flush();
-        }
+    return snapshot;
+}
+
+bool Memory::ExtRAMIdle() {
+    if (ext_ram_written) {
+        ext_ram_written = false;
+        ext_ram_dirty = true;
+        frames_since_ext_ram_write = 0;
+    } else if (ext_ram_dirty && ++frames_since_ext_ram_write == save_idle_frames) {
+        ext_ram_dirty = false;
+        return true;
+    }
+
+    return false;
+}
+
+void Memory::SyncExtRAM() {
+    if (ext_ram_written) {
+        ext_ram_written = false;
+        ext_ram.Sync();
     }
 }
 
 u8 Memory::ReadExternalRAM(const u16 addr) const {
+    if (sram_ptr != nullptr) {
+        return sram_ptr[addr - 0xA000];
+    }
+
     if (ext_ram_enabled) {
         u16 adjusted_addr = addr - 0xA000 + 0x2000 * (ram_bank_num & (num_ram_banks - 1));
 
@@ -112,6 +129,13 @@ u8 Memory::ReadExternalRAM(const u16 addr) const {
 }
 
 void Memory::WriteExternalRAM(const u16 addr, const u8 data) {
+    ext_ram_written = true;
+
+    if (sram_ptr != nullptr) {
+        sram_ptr[addr - 0xA000] = data;
+        return;
+    }
+
     // Writes are ignored if external RAM is disabled or not present.
     if (ext_ram_enabled) {
         u16 adjusted_addr = addr - 0xA000 + 0x2000 * (ram_bank_num & (num_ram_banks - 1));
@@ -328,6 +352,100 @@ void Memory::WriteMBCControlRegisters(const u16 addr, const u8 data) {
         // Carts with no MBC ignore writes here.
         break;
     }
+
+    UpdateBankPointers();
+}
+
+void Memory::UpdateBankPointers() {
+    int rom0_bank = 0;
+    if (mbc_mode == MBC::MBC1) {
+        rom0_bank = (ram_bank_num << 5) & (num_rom_banks - 1);
+    } else if (mbc_mode == MBC::MBC1M) {
+        rom0_bank = (ram_bank_num << 4) & (num_rom_banks - 1);
+    }
+
+    rom0_ptr = rom.data() + 0x4000 * rom0_bank;
+    romx_ptr = rom.data() + 0x4000 * (rom_bank_num & (num_rom_banks - 1));
+    vram_ptr = vram.data() + 0x2000 * vram_bank_num;
+    wram_ptr = wram.data() + 0x1000 * ((wram_bank_num == 0) ? 1 : wram_bank_num);
+
+    // Only plain RAM banks which are fully backed by the save can be accessed directly. MBC2 RAM is 4 bits wide,
+    // and MBC3 maps the RTC registers over the RAM banks.
+    sram_ptr = nullptr;
+    if (ext_ram_enabled && mbc_mode != MBC::MBC2 && !(mbc_mode == MBC::MBC3 && (ram_bank_num & 0x08))) {
+        const int ram_bank = (mbc_mode == MBC::MBC5 && rumble_present) ? (ram_bank_num & 0x07) : ram_bank_num;
+        const std::size_t ram_offset = 0x2000 * static_cast<std::size_t>(ram_bank & (num_ram_banks - 1));
+        if (ram_offset + 0x2000 <= ext_ram.size()) {
+            sram_ptr = ext_ram.data() + ram_offset;
+        }
+    }
+
+    read_pages.fill(nullptr);
+    for (int i = 0; i < 4; ++i) {
+        read_pages[0x0 + i] = rom0_ptr + 0x1000 * i;
+        read_pages[0x4 + i] = romx_ptr + 0x1000 * i;
+    }
+    if (sram_ptr != nullptr) {
+        read_pages[0xA] = sram_ptr;
+        read_pages[0xB] = sram_ptr + 0x1000;
+    }
+    read_pages[0xC] = wram.data();
+    read_pages[0xD] = wram_ptr;
+    read_pages[0xE] = wram.data();
+
+    for (std::size_t page = 0; page < read_pages.size(); ++page) {
+        if (breakpoints.Tagged(page, Common::Breakpoints::Exec | Common::Breakpoints::Read) || cheats.Patched(page)) {
+            read_pages[page] = nullptr;
+        }
+    }
+
+    write_pages.fill(nullptr);
+    for (int i = 0; i < 0x10; ++i) {
+        write_pages[0xC0 + i] = wram.data() + 0x100 * i;
+        write_pages[0xD0 + i] = wram_ptr + 0x100 * i;
+        write_pages[0xE0 + i] = wram.data() + 0x100 * i;
+    }
+    // The echo of 0xD000-0xDDFF ends where OAM starts.
+    for (int i = 0; i < 0x0E; ++i) {
+        write_pages[0xF0 + i] = wram_ptr + 0x100 * i;
+    }
+
+    for (std::size_t page = 0; page < write_pages.size(); ++page) {
+        if (breakpoints.Tagged(page >> 4, Common::Breakpoints::Write)) {
+            write_pages[page] = nullptr;
+        }
+    }
+}
+
+void Memory::AddBreakpoint(u16 addr, Common::Breakpoints::Type type) {
+    breakpoints.Add(addr, type);
+    UpdateBankPointers();
+}
+
+void Memory::RemoveBreakpoint(u16 addr, Common::Breakpoints::Type type) {
+    breakpoints.Remove(addr, type);
+    UpdateBankPointers();
+}
+
+void Memory::AddCheat(const std::string& code) {
+    cheats.AddGbCode(code);
+    UpdateBankPointers();
+}
+
+void Memory::SetCheats(const Common::Cheats& cheat_list) {
+    cheats = cheat_list;
+    UpdateBankPointers();
+}
+
+void Memory::ApplyCheatWrites() {
+    for (const auto& write : cheats.RamWrites()) {
+        const u16 addr = static_cast<u16>(write.addr);
+        if (write.bank != 0 && game_mode == GameMode::CGB && addr >= 0xD000 && addr < 0xE000) {
+            wram[0x1000 * write.bank + (addr - 0xD000)] = static_cast<u8>(write.value);
+        } else {
+            WriteMem(addr, static_cast<u8>(write.value));
+        }
+    }
 }
 
 } // End namespace Gb
@@ -14,6 +14,8 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <stdexcept>
+
 #include "gb/memory/CartridgeHeader.h"
 #include "gb/memory/Memory.h"
 #include "gb/memory/RTC.h"
@@ -22,11 +24,12 @@
 #include "gb/hardware/Timer.h"
 #include "gb/hardware/Serial.h"
 #include "gb/hardware/Joypad.h"
+#include "common/StateBuffer.h"
 
 namespace Gb {
 
 Memory::Memory(const Console gb_type, const CartridgeHeader& header, Timer& tima, Serial& sio, LCD& display,
-               Joypad& pad, Audio& apu, const std::vector<u8>& rom_contents, std::vector<u8>& save_game)
+               Joypad& pad, Audio& apu, const Common::RomView<u8>& rom_contents, Common::SaveBuffer<u8>& save_game)
         : console(gb_type)
         , game_mode(header.game_mode)
         , timer(tima)
@@ -49,6 +52,7 @@ Memory::Memory(const Console gb_type, const CartridgeHeader& header, Timer& tima
 
     IORegisterInit();
     VRAMInit();
+    UpdateBankPointers();
 }
 
 // Needed to declare std::unique_ptr with forward-declared type in the header file.
@@ -147,38 +151,41 @@ void Memory::VRAMInit() {
 }
 
 u8 Memory::ReadMem(const u16 addr) const {
+    const u8* page = read_pages[addr >> 12];
+    if (page != nullptr && dma_bus_block == Bus::None) {
+        return page[addr & 0x0FFF];
+    }
+
+    if (breakpoints.Tagged(addr >> 12, Common::Breakpoints::Read)) {
+        breakpoints.Check(addr, 1, Common::Breakpoints::Read);
+    }
+
     if (addr < 0x8000) {
         // ROM
         if (dma_bus_block != Bus::External) {
             if (addr < 0x4000) {
                 // ROM0 bank
-                if (mbc_mode == MBC::MBC1) {
-                    return rom[addr + 0x4000 * ((ram_bank_num << 5) & (num_rom_banks - 1))];
-                } else if (mbc_mode == MBC::MBC1M) {
-                    return rom[addr + 0x4000 * ((ram_bank_num << 4) & (num_rom_banks - 1))];
-                } else {
-                    return rom[addr];
-                }
+                return cheats.PatchRead(addr, rom0_ptr[addr]);
             } else {
                 // ROM1 bank
-                return rom[addr + 0x4000 * ((rom_bank_num & (num_rom_banks - 1)) - 1)];
+                return cheats.PatchRead(addr, romx_ptr[addr - 0x4000]);
             }
         } else {
             // If OAM DMA is currently transferring from the external bus, return the last byte read by the DMA.
-            return oam_transfer_byte;
+            return OAMDMABusByte();
         }
     } else if (addr < 0xA000) {
         // VRAM -- switchable in CGB mode
         if (dma_bus_block != Bus::VRAM) {
             // Not accessible during screen mode 3.
             if ((lcd.stat & 0x03) != 3) {
-                return vram[addr - 0x8000 + 0x2000 * vram_bank_num];
+                return vram_ptr[addr - 0x8000];
             } else {
                 return 0xFF;
             }
         } else {
             // If OAM DMA is currently transferring from VRAM, return the last byte read by the DMA.
-            return oam_transfer_byte;
+            return OAMDMABusByte();
         }
     } else if (addr < 0xFE00) {
         if (dma_bus_block != Bus::External) {
@@ -190,17 +197,17 @@ u8 Memory::ReadMem(const u16 addr) const {
                 return wram[addr - 0xC000];
             } else if (addr < 0xE000) {
                 // WRAM bank 1 (switchable from 1-7 in CGB mode)
-                return wram[addr - 0xC000 + 0x1000 * ((wram_bank_num == 0) ? 0 : wram_bank_num - 1)];
+                return wram_ptr[addr - 0xD000];
             } else if (addr < 0xF000) {
                 // Echo of C000-DDFF
                 return wram[addr - 0xE000];
             } else {
                 // Echo of C000-DDFF
-                return wram[addr - 0xE000 + 0x1000 * ((wram_bank_num == 0) ? 0 : wram_bank_num - 1)];
+                return wram_ptr[addr - 0xF000];
             }
         } else {
             // If OAM DMA is currently transferring from the external bus, return the last byte read by the DMA.
-            return oam_transfer_byte;
+            return OAMDMABusByte();
         }
     } else if (addr < 0xFF00) {
         if (addr < 0xFEA0) {
@@ -234,7 +241,29 @@ u8 Memory::ReadMem(const u16 addr) const {
 }
 
 void Memory::WriteMem(const u16 addr, const u8 data) {
-    if (addr < 0x8000) {
+    u8* page = write_pages[addr >> 8];
+    if (page != nullptr && dma_bus_block == Bus::None) {
+        page[addr & 0xFF] = data;
+        return;
+    }
+
+    if (breakpoints.Tagged(addr >> 12, Common::Breakpoints::Write)) {
+        breakpoints.Check(addr, 1, Common::Breakpoints::Write);
+    }
+
+    if (addr >= 0xFF00) {
+        // 0xFF00-0xFFFF is still accessible during OAM DMA.
+        if (addr < 0xFF80) {
+            // I/O registers
+            WriteIORegisters(addr, data);
+        } else if (addr < 0xFFFF) {
+            // High RAM
+            hram[addr - 0xFF80] = data;
+        } else {
+            // Interrupt enable (IE) register
+            interrupt_enable = data;
+        }
+    } else if (addr < 0x8000) {
         // MBC control registers -- writes to this region do not write the ROM.
         // If OAM DMA is currently transferring from the external bus, the write is ignored.
         if (dma_bus_block != Bus::External) {
@@ -245,7 +274,8 @@ void Memory::WriteMem(const u16 addr, const u8 data) {
         // If OAM DMA is currently transferring from the VRAM bus, the write is ignored.
         if (dma_bus_block != Bus::VRAM && (lcd.stat & 0x03) != 3) {
             // Not accessible during screen mode 3.
-            vram[addr - 0x8000 + 0x2000 * vram_bank_num] = data;
+            vram_ptr[addr - 0x8000] = data;
+            lcd.VRAMWritten(0x2000 * vram_bank_num + addr - 0x8000);
         }
     } else if (addr < 0xFE00) {
         // If OAM DMA is currently transferring from the external bus, the write is ignored.
@@ -258,44 +288,43 @@ void Memory::WriteMem(const u16 addr, const u8 data) {
                 wram[addr - 0xC000] = data;
             } else if (addr < 0xE000) {
                 // WRAM bank 1 (switchable from 1-7 in CGB mode)
-                wram[addr - 0xC000 + 0x1000 * ((wram_bank_num == 0) ? 0 : wram_bank_num - 1)] = data;
+                wram_ptr[addr - 0xD000] = data;
             } else if (addr < 0xF000) {
                 // Echo of C000-DDFF
                 wram[addr - 0xE000] = data;
             } else {
                 // Echo of C000-DDFF
-                wram[addr - 0xE000 + 0x1000 * ((wram_bank_num == 0) ? 0 : wram_bank_num - 1)] = data;
+                wram_ptr[addr - 0xF000] = data;
             }
         }
-    } else if (addr < 0xFF00) {
+    } else {
         // OAM (Sprite Attribute Table)
         // Inaccessible during OAM DMA.
         if (dma_bus_block == Bus::None && addr < 0xFEA0) {
             // Inaccessible during screen modes 2 and 3.
             if (!(lcd.stat & 0x02)) {
                 lcd.oam[addr - 0xFE00] = data;
+                lcd.OAMWritten(addr - 0xFE00);
             }
         }
         // 0xFEA0-0xFEFF: Unusable region
         // Pre-CGB devices: writes are ignored
         // CGB: writes are *not* ignored, refer to TCAGBD
         // AGB: writes are ignored
-    } else {
-        // 0xFF00-0xFFFF is still accessible during OAM DMA.
-        if (addr < 0xFF80) {
-            // I/O registers
-            WriteIORegisters(addr, data);
-        } else if (addr < 0xFFFF) {
-            // High RAM
-            hram[addr - 0xFF80] = data;
-        } else {
-            // Interrupt enable (IE) register
-            interrupt_enable = data;
-        }
     }
 }
 
 u8 Memory::ReadIORegisters(const u16 addr) const {
+    if (addr >= 0xFF10 && addr < 0xFF40) {
+        return audio.ReadRegister(addr);
+    }
+
+    // VRAM, OAM and CGB palette accesses don't need the LCD synced, since it only reads them when drawing a
+    // scanline, which is never deferred.
+    if (addr >= 0xFF40 && addr <= 0xFF4B) {
+        lcd.Sync();
+    }
+
     switch (addr) {
     // P1 -- Joypad
     case 0xFF00:
@@ -308,9 +337,11 @@ u8 Memory::ReadIORegisters(const u16 addr) const {
         return serial.serial_control | ((game_mode == GameMode::CGB) ? 0x7C : 0x7E);
     // DIV -- Divider Register
     case 0xFF04:
+        timer.Sync();
         return static_cast<u8>(timer.divider >> 8);
     // TIMA -- Timer Counter
     case 0xFF05:
+        timer.Sync();
         return timer.tima;
     // TMA -- Timer Modulo
     case 0xFF06:
@@ -321,90 +352,6 @@ u8 Memory::ReadIORegisters(const u16 addr) const {
     // IF -- Interrupt Flags
     case 0xFF0F:
         return interrupt_flags | 0xE0;
-    // NR10 -- Channel 1 Sweep
-    case 0xFF10:
-        return audio.square1.sweep | 0x80;
-    // NR11 -- Channel 1 Wave Duty & Sound Length
-    case 0xFF11:
-        return audio.square1.sound_length | 0x3F;
-    // NR12 -- Channel 1 Volume Envelope
-    case 0xFF12:
-        return audio.square1.volume_envelope;
-    // NR13 -- Channel 1 Low Frequency
-    case 0xFF13:
-        // This register is write-only.
-        return 0xFF;
-    // NR14 -- Channel 1 Trigger & High Frequency
-    case 0xFF14:
-        return audio.square1.frequency_hi | 0xBF;
-    // NR21 --  Channel 2 Wave Duty & Sound Length
-    case 0xFF16:
-        return audio.square2.sound_length | 0x3F;
-    // NR22 --  Channel 2 Volume Envelope
-    case 0xFF17:
-        return audio.square2.volume_envelope;
-    // NR23 -- Channel 2 Low Frequency
-    case 0xFF18:
-        // This register is write-only.
-        return 0xFF;
-    // NR24 -- Channel 2 Trigger & High Frequency
-    case 0xFF19:
-        return audio.square2.frequency_hi | 0xBF;
-    // NR30 -- Channel 3 On/Off
-    case 0xFF1A:
-        return audio.wave.channel_on | 0x7F;
-    // NR31 -- Channel 3 Sound Length
-    case 0xFF1B:
-        // This register is write-only.
-        return 0xFF;
-    // NR32 -- Channel 3 Volume Shift
-    case 0xFF1C:
-        return audio.wave.volume_envelope | 0x9F;
-    // NR33 -- Channel 3 Low Frequency
-    case 0xFF1D:
-        // This register is write-only.
-        return 0xFF;
-    // NR34 -- Channel 3 Trigger & High Frequency
-    case 0xFF1E:
-        return audio.wave.frequency_hi | 0xBF;
-    // NR41 -- Channel 4 Sound Length
-    case 0xFF20:
-        // This register is write-only.
-        return 0xFF;
-    // NR42 -- Channel 4 Volume Envelope
-    case 0xFF21:
-        return audio.noise.volume_envelope;
-    // NR43 -- Channel 4 Polynomial Counter
-    case 0xFF22:
-        return audio.noise.frequency_lo;
-    // NR44 -- Channel 4 Trigger
-    case 0xFF23:
-        return audio.noise.frequency_hi | 0xBF;
-    // NR50 -- Master Volume
-    case 0xFF24:
-        return audio.master_volume;
-    // NR51 -- Sound Output Terminal Selection
-    case 0xFF25:
-        return audio.sound_select;
-    // NR52 -- Sound On/Off
-    case 0xFF26:
-        return audio.ReadNR52();
-    // Wave Pattern RAM
-    case 0xFF30: case 0xFF31: case 0xFF32: case 0xFF33: case 0xFF34: case 0xFF35: case 0xFF36: case 0xFF37:
-    case 0xFF38: case 0xFF39: case 0xFF3A: case 0xFF3B: case 0xFF3C: case 0xFF3D: case 0xFF3E: case 0xFF3F:
-        if (audio.wave.channel_on) {
-            // While the wave channel is enabled, reads to wave RAM return the byte containing the sample
-            // currently being played.
-            if (console != Console::DMG || audio.wave.reading_sample) {
-                return audio.wave_ram[audio.wave.wave_pos >> 1];
-            } else {
-                // On DMG, the wave RAM can only be accessed within 2 cycles after the sample position has been
-                // incremented, while the APU is reading the sample.
-                return 0xFF;
-            }
-        } else {
-            return audio.wave_ram[addr - 0xFF30];
-        }
     // LCDC -- LCD control
     case 0xFF40:
         return lcd.lcdc;
@@ -512,7 +459,17 @@ u8 Memory::ReadIORegisters(const u16 addr) const {
     }
 }
 
-void Memory::WriteIORegisters(const u16 addr, const u8 data) {
+template<Accuracy profile, u16 addr>
+void Memory::WriteIORegister(const u8 data) {
+    if (addr >= 0xFF10 && addr < 0xFF40) {
+        audio.WriteRegister(addr, data);
+        return;
+    }
+
+    if (addr >= 0xFF40 && addr <= 0xFF4B) {
+        lcd.Sync();
+    }
+
     switch (addr) {
     // P1 -- Joypad
     case 0xFF00:
@@ -529,19 +486,23 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
         break;
     // DIV -- Divider Register
     case 0xFF04:
-        // DIV is set to zero on any write.
+        // DIV is set to zero on any write. Any glitched TIMA increment is picked up by the edge detector next cycle.
+        timer.Sync();
         timer.divider = 0x0000;
         break;
     // TIMA -- Timer Counter
     case 0xFF05:
+        timer.Sync();
         timer.tima = data;
         break;
     // TMA -- Timer Modulo
     case 0xFF06:
+        timer.Sync();
         timer.tma = data;
         break;
     // TAC -- Timer Control
     case 0xFF07:
+        timer.Sync();
         timer.tac = data & 0x07;
         break;
     // IF -- Interrupt Flags
@@ -549,169 +510,7 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
         // If an instruction writes to IF on the same machine cycle an interrupt would have been triggered, the
         // written value remains in IF.
         interrupt_flags = data & 0x1F;
-        IF_written_this_cycle = true;
-        break;
-    // NR10 -- Channel 1 Sweep
-    case 0xFF10:
-        if (audio.IsPoweredOn()) {
-            audio.square1.sweep = data & 0x7F;
-            audio.square1.SweepWriteHandler();
-        }
-        break;
-    // NR11 -- Channel 1 Wave Pattern & Sound Length
-    case 0xFF11:
-        if (audio.IsPoweredOn() || IsConsoleDmg()) {
-            audio.square1.sound_length = data;
-            audio.square1.ReloadLengthCounter();
-            audio.square1.SetDutyCycle();
-        }
-        break;
-    // NR12 -- Channel 1 Volume Envelope
-    case 0xFF12:
-        if (audio.IsPoweredOn()) {
-            audio.square1.volume_envelope = data;
-            if ((audio.square1.volume_envelope & 0xF0) == 0) {
-                audio.square1.channel_enabled = false;
-            }
-        }
-        break;
-    // NR13 -- Channel 1 Low Frequency
-    case 0xFF13:
-        if (audio.IsPoweredOn()) {
-            audio.square1.frequency_lo = data;
-        }
-        break;
-    // NR14 -- Channel 1 Trigger & High Frequency
-    case 0xFF14:
-        if (audio.IsPoweredOn()) {
-            audio.square1.ExtraLengthClocking(data & 0xC7);
-            audio.square1.frequency_hi = data & 0xC7;
-        }
-        break;
-    // NR21 --  Channel 2 Wave Pattern & Sound Length
-    case 0xFF16:
-        if (audio.IsPoweredOn() || IsConsoleDmg()) {
-            audio.square2.sound_length = data;
-            audio.square2.ReloadLengthCounter();
-            audio.square2.SetDutyCycle();
-        }
-        break;
-    // NR22 --  Channel 2 Volume Envelope
-    case 0xFF17:
-        if (audio.IsPoweredOn()) {
-            audio.square2.volume_envelope = data;
-            if ((audio.square2.volume_envelope & 0xF0) == 0) {
-                audio.square2.channel_enabled = false;
-            }
-        }
-        break;
-    // NR23 -- Channel 2 Low Frequency
-    case 0xFF18:
-        if (audio.IsPoweredOn()) {
-            audio.square2.frequency_lo = data;
-        }
-        break;
-    // NR24 -- Channel 2 Trigger & High Frequency
-    case 0xFF19:
-        if (audio.IsPoweredOn()) {
-            audio.square2.ExtraLengthClocking(data & 0xC7);
-            audio.square2.frequency_hi = data & 0xC7;
-        }
-        break;
-    // NR30 -- Channel 3 On/Off
-    case 0xFF1A:
-        if (audio.IsPoweredOn()) {
-            audio.wave.channel_on = data & 0x80;
-            if ((audio.wave.channel_on & 0x80) == 0) {
-                audio.wave.channel_enabled = false;
-            }
-        }
-        break;
-    // NR31 -- Channel 3 Sound Length
-    case 0xFF1B:
-        if (audio.IsPoweredOn() || IsConsoleDmg()) {
-            audio.wave.sound_length = data;
-            audio.wave.ReloadLengthCounter();
-        }
-        break;
-    // NR32 -- Channel 3 Volume Shift
-    case 0xFF1C:
-        if (audio.IsPoweredOn()) {
-            audio.wave.volume_envelope = data & 0x60;
-        }
-        break;
-    // NR33 -- Channel 3 Low Frequency
-    case 0xFF1D:
-        if (audio.IsPoweredOn()) {
-            audio.wave.frequency_lo = data;
-        }
-        break;
-    // NR34 -- Channel 3 Trigger & High Frequency
-    case 0xFF1E:
-        if (audio.IsPoweredOn()) {
-            audio.wave.ExtraLengthClocking(data & 0xC7);
-            audio.wave.frequency_hi = data & 0xC7;
-        }
-        break;
-    // NR41 -- Channel 4 Sound Length
-    case 0xFF20:
-        if (audio.IsPoweredOn() || IsConsoleDmg()) {
-            audio.noise.sound_length = data & 0x3F;
-            audio.noise.ReloadLengthCounter();
-        }
-        break;
-    // NR42 -- Channel 4 Volume Envelope
-    case 0xFF21:
-        if (audio.IsPoweredOn()) {
-            audio.noise.volume_envelope = data;
-            if ((audio.noise.volume_envelope & 0xF0) == 0) {
-                audio.noise.channel_enabled = false;
-            }
-        }
-        break;
-    // NR43 -- Channel 4 Polynomial Counter
-    case 0xFF22:
-        if (audio.IsPoweredOn()) {
-            audio.noise.frequency_lo = data;
-        }
-        break;
-    // NR44 -- Channel 4 Trigger
-    case 0xFF23:
-        if (audio.IsPoweredOn()) {
-            audio.noise.ExtraLengthClocking(data & 0xC0);
-            audio.noise.frequency_hi = data & 0xC0;
-        }
-        break;
-    // NR50 -- Master Volume
-    case 0xFF24:
-        if (audio.IsPoweredOn()) {
-            audio.master_volume = data;
-        }
-        break;
-    // NR51 -- Sound Output Terminal Selection
-    case 0xFF25:
-        if (audio.IsPoweredOn()) {
-            audio.sound_select = data;
-        }
-        break;
-    // NR52 -- Sound On/Off
-    case 0xFF26:
-        audio.sound_on = (audio.sound_on & 0x0F) | (data & 0x80);
-        break;
-    // Wave Pattern RAM
-    case 0xFF30: case 0xFF31: case 0xFF32: case 0xFF33: case 0xFF34: case 0xFF35: case 0xFF36: case 0xFF37:
-    case 0xFF38: case 0xFF39: case 0xFF3A: case 0xFF3B: case 0xFF3C: case 0xFF3D: case 0xFF3E: case 0xFF3F:
-        if (audio.wave.channel_on) {
-            // While the wave channel is enabled, writes to wave RAM write the byte containing the sample
-            // currently being played.
-            if (console != Console::DMG || audio.wave.reading_sample) {
-                // On DMG, the wave RAM can only be accessed within 2 cycles after the sample position has been
-                // incremented, while the APU is reading the sample.
-                audio.wave_ram[audio.wave.wave_pos >> 1] = data;
-            }
-        } else {
-            audio.wave_ram[addr - 0xFF30] = data;
-        }
+        IF_written_this_cycle = profile == Accuracy::Accurate;
         break;
     // LCDC -- LCD control
     case 0xFF40:
@@ -745,19 +544,26 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
     // DMA -- OAM DMA Transfer
     case 0xFF46:
         oam_dma_start = data;
-        oam_dma_state = DMAState::Starting;
+        if (profile == Accuracy::Fast) {
+            CopyOAM_DMA();
+        } else {
+            oam_dma_state = DMAState::Starting;
+        }
         break;
     // BGP -- BG Palette Data
     case 0xFF47:
         lcd.bg_palette_dmg = data;
+        lcd.PaletteWritten(addr);
         break;
     // OBP0 -- Sprite Palette 0 Data
     case 0xFF48:
         lcd.obj_palette_dmg0 = data;
+        lcd.PaletteWritten(addr);
         break;
     // OBP1 -- Sprite Palette 1 Data
     case 0xFF49:
         lcd.obj_palette_dmg1 = data;
+        lcd.PaletteWritten(addr);
         break;
     // WY -- Window Y Position
     case 0xFF4A:
@@ -775,6 +581,7 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
     case 0xFF4F:
         if (game_mode == GameMode::CGB) {
             vram_bank_num = data & 0x01;
+            UpdateBankPointers();
         }
         break;
     // HDMA1 -- HDMA Source High Byte
@@ -817,6 +624,7 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
         // Palette RAM is not accessible during mode 3.
         if (game_mode == GameMode::CGB && (lcd.stat & 0x03) != 3) {
             lcd.bg_palette_data[lcd.bg_palette_index & 0x3F] = data;
+            lcd.PaletteWritten(addr);
             // Increment index if auto-increment specified.
             if (lcd.bg_palette_index & 0x80) {
                 lcd.bg_palette_index = (lcd.bg_palette_index + 1) & 0xBF;
@@ -834,6 +642,7 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
         // Palette RAM is not accessible during mode 3.
         if (game_mode == GameMode::CGB && (lcd.stat & 0x03) != 3) {
             lcd.obj_palette_data[lcd.obj_palette_index & 0x3F] = data;
+            lcd.PaletteWritten(addr);
             // Increment index if auto-increment specified.
             if (lcd.obj_palette_index & 0x80) {
                 lcd.obj_palette_index = (lcd.obj_palette_index + 1) & 0xBF;
@@ -844,6 +653,7 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
     case 0xFF70:
         if (game_mode == GameMode::CGB) {
             wram_bank_num = data & 0x07;
+            UpdateBankPointers();
         }
         break;
     // Undocumented
@@ -878,4 +688,102 @@ void Memory::WriteIORegisters(const u16 addr, const u8 data) {
     }
 }
 
+void Memory::WriteIORegisters(const u16 addr, const u8 data) {
+    (this->*(*io_write_table)[addr - 0xFF00])(data);
+}
+
+template<Accuracy profile, std::size_t... offsets>
+constexpr Memory::IOWriteTable Memory::MakeIOWriteTable(std::index_sequence<offsets...>) {
+    return {{&Memory::WriteIORegister<profile, 0xFF00 + offsets>...}};
+}
+
+const Memory::IOWriteTable Memory::accurate_io_write_table =
+    MakeIOWriteTable<Accuracy::Accurate>(std::make_index_sequence<0x80>{});
+const Memory::IOWriteTable Memory::fast_io_write_table =
+    MakeIOWriteTable<Accuracy::Fast>(std::make_index_sequence<0x80>{});
+
+void Memory::Serialize(Common::StateBuffer& state) {
+    const std::size_t vram_size = vram.size(), wram_size = wram.size(), hram_size = hram.size();
+    const std::size_t ext_ram_size = ext_ram.size();
+
+    state.BeginChunk("MEM ", 2);
+    state.Sync(double_speed);
+    state.Sync(IF_written_this_cycle);
+
+    state.Sync(vram);
+    state.Sync(wram);
+    state.Sync(hram);
+    state.Sync(ext_ram);
+
+    if (!state.Loading()) {
+        // The rest of a bulk OAM DMA is redone byte by byte after loading, so store the current bus byte.
+        oam_transfer_byte = OAMDMABusByte();
+    }
+
+    state.Sync(oam_dma_state);
+    state.Sync(dma_bus_block);
+    state.Sync(oam_transfer_addr);
+    state.Sync(oam_transfer_byte);
+    state.Sync(bytes_read);
+
+    state.Sync(hdma_state);
+    state.Sync(hdma_type);
+    state.Sync(hdma_reg_written);
+    state.Sync(bytes_to_copy);
+    state.Sync(hblank_bytes);
+    state.Sync(hdma_bytes_ahead);
+
+    state.Sync(interrupt_flags);
+    state.Sync(oam_dma_start);
+    state.Sync(speed_switch);
+    state.Sync(hdma_source_hi);
+    state.Sync(hdma_source_lo);
+    state.Sync(hdma_dest_hi);
+    state.Sync(hdma_dest_lo);
+    state.Sync(hdma_control);
+    state.Sync(infrared);
+    state.Sync(vram_bank_num);
+    state.Sync(wram_bank_num);
+    state.Sync(interrupt_enable);
+    state.Sync(undocumented);
+
+    state.Sync(rom_bank_num);
+    state.Sync(ram_bank_num);
+    state.Sync(ext_ram_enabled);
+    state.Sync(upper_bits);
+    state.Sync(ram_bank_mode);
+    state.EndChunk();
+
+    if (state.Loading()) {
+        oam_dma_bulk = false;
+        UpdateBankPointers();
+    }
+
+    if (state.Loading() && (vram.size() != vram_size || wram.size() != wram_size || hram.size() != hram_size
+                            || ext_ram.size() != ext_ram_size)) {
+        throw std::runtime_error("Save state has the wrong memory region sizes.");
+    }
+
+    if (rtc_present) {
+        // The RTC follows the host clock, so it is stored in the same format as in save files.
+        std::vector<u8> rtc_data;
+        if (!state.Loading()) {
+            rtc->AppendRTCData(rtc_data);
+        }
+
+        state.BeginChunk("RTC ", 1);
+        state.Sync(rtc_data);
+        state.Sync(rtc->latch_last_value_written);
+        state.EndChunk();
+
+        if (state.Loading()) {
+            if (rtc_data.size() != 0x30) {
+                throw std::runtime_error("Save state has invalid RTC data.");
+            }
+
+            rtc->LoadRTCData(rtc_data);
+        }
+    }
+}
+
 } // End namespace Gb
@@ -20,10 +20,18 @@
 #include <array>
 #include <algorithm>
 #include <memory>
+#include <utility>
 
 #include "common/CommonTypes.h"
+#include "common/CommonEnums.h"
+#include "common/MappedFile.h"
+#include "common/SaveBuffer.h"
+#include "common/Breakpoints.h"
+#include "common/Cheats.h"
 #include "gb/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gb {
 
 class CartridgeHeader;
@@ -39,7 +47,7 @@ class Memory {
     friend class Logging;
 public:
     Memory(const Console gb_type, const CartridgeHeader& header, Timer& tima, Serial& sio, LCD& display,
-           Joypad& pad, Audio& audio, const std::vector<u8>& rom_contents, std::vector<u8>& save_game);
+           Joypad& pad, Audio& audio, const Common::RomView<u8>& rom_contents, Common::SaveBuffer<u8>& save_game);
     ~Memory();
 
     const Console console;
@@ -48,6 +56,31 @@ public:
 
     u8 ReadMem(const u16 addr) const;
     void WriteMem(const u16 addr, const u8 data);
+    // Equivalent to ReadMem, except that it hits breakpoints.
+    u8 FetchOpcode(const u16 addr) const {
+        const u8* page = read_pages[addr >> 12];
+        if (page != nullptr && dma_bus_block == Bus::None) {
+            return page[addr & 0x0FFF];
+        }
+
+        if (breakpoints.Tagged(addr >> 12, Common::Breakpoints::Exec)) {
+            breakpoints.Check(addr, 1, Common::Breakpoints::Exec);
+        }
+        return ReadMem(addr);
+    }
+
+    // Breakpoints are hit by opcode fetches, and watchpoints by reads and writes from the CPU or DMA.
+    void AddBreakpoint(u16 addr, Common::Breakpoints::Type type);
+    void RemoveBreakpoint(u16 addr, Common::Breakpoints::Type type);
+    bool BreakpointTriggered() const { return breakpoints.Triggered(); }
+    std::vector<Common::Breakpoints::Hit> TakeBreakpointHits() { return breakpoints.TakeHits(); }
+
+    // Throws if the code can't be decoded.
+    void AddCheat(const std::string& code);
+    const Common::Cheats& CheatList() const { return cheats; }
+    void SetCheats(const Common::Cheats& cheat_list);
+    // Called on entering VBlank.
+    void ApplyCheatWrites();
 
     void ToggleCPUSpeed() {
         speed_switch = (speed_switch ^ 0x80) & 0x80;
@@ -57,6 +90,9 @@ public:
     bool IsConsoleDmg() const { return console == Console::DMG; }
     bool IsConsoleCgb() const { return console == Console::CGB || console == Console::AGB; }
 
+    // The ROM bank currently mapped to 0x4000-0x7FFF.
+    int RomBank() const { return rom_bank_num & (num_rom_banks - 1); }
+
     // Interrupt functions
     void RequestInterrupt(Interrupt intr) {
         if (!IF_written_this_cycle) { interrupt_flags |= static_cast<unsigned int>(intr); }
@@ -70,6 +106,15 @@ public:
     bool RequestedEnabledInterrupts() const { return interrupt_flags & interrupt_enable; }
     bool IF_written_this_cycle = false;
 
+    // The fast profile runs OAM DMA all at once when it's started, without blocking either bus, and lets
+    // interrupts which are raised on the same cycle as an IF write through. Both are decided by which I/O write
+    // table is in use, so neither profile checks for the other at runtime.
+    void SetAccuracy(Accuracy profile) {
+        accuracy = profile;
+        io_write_table = (profile == Accuracy::Fast) ? &fast_io_write_table : &accurate_io_write_table;
+    }
+    Accuracy GetAccuracy() const { return accuracy; }
+
     // DMA functions
     void UpdateOAM_DMA();
     void UpdateHDMA();
@@ -83,7 +128,20 @@ public:
     }
 
     // MBC/Saving functions
-    void SaveExternalRAM(const std::string& save_path) const;
+    // Returns external RAM followed by the RTC state, or nothing if the cartridge has no external RAM.
+    std::vector<u8> SaveSnapshot() const;
+    // Called once a frame. Returns true once external RAM has gone save_idle_frames without being written after
+    // a write, so a game saving its progress is written to disk as a single snapshot after it finishes.
+    bool ExtRAMIdle();
+    // When external RAM maps the save file, it's written back by the OS and synced after each frame it's written.
+    bool ExtRAMFileBacked() const { return ext_ram.FileBacked(); }
+    void SyncExtRAM();
+
+    const std::vector<u8>& WramReference() const { return wram; }
+    const std::vector<u8>& HramReference() const { return hram; }
+    const std::vector<u8>& VRAMReference() const { return vram; }
+
+    void Serialize(Common::StateBuffer& state);
 private:
     Timer& timer;
     Serial& serial;
@@ -98,11 +156,11 @@ private:
     const int num_rom_banks;
     const int num_ram_banks;
 
-    const std::vector<u8>& rom;
+    const Common::RomView<u8>& rom;
     std::vector<u8> vram;
     std::vector<u8> wram;
     std::vector<u8> hram;
-    std::vector<u8>& ext_ram;
+    Common::SaveBuffer<u8>& ext_ram;
     std::unique_ptr<RTC> rtc;
 
     // Init functions
@@ -113,31 +171,84 @@ private:
     u8 ReadIORegisters(const u16 addr) const;
     void WriteIORegisters(const u16 addr, const u8 data);
 
+    // Each I/O register is written by its own instantiation of the register switch, which the compiler reduces to
+    // the single case. WriteIORegisters dispatches through a table of these built at compile time, with one table
+    // for each accuracy profile.
+    using IOWriteTable = std::array<void (Memory::*)(const u8), 0x80>;
+    static const IOWriteTable accurate_io_write_table;
+    static const IOWriteTable fast_io_write_table;
+    const IOWriteTable* io_write_table = &accurate_io_write_table;
+
+    template<Accuracy profile, u16 addr>
+    void WriteIORegister(const u8 data);
+    template<Accuracy profile, std::size_t... offsets>
+    static constexpr IOWriteTable MakeIOWriteTable(std::index_sequence<offsets...>);
+
     // DMA utilities
     enum class DMAState {Inactive, Starting, Active, Paused};
     enum class Bus {None, External, VRAM};
     DMAState oam_dma_state = DMAState::Inactive;
     Bus dma_bus_block = Bus::None;
+    Accuracy accuracy = Accuracy::Accurate;
 
     u16 oam_transfer_addr;
     u8 oam_transfer_byte;
     unsigned int bytes_read = 160;
+    // Whether the whole OAM DMA was copied when it started. The transfer still blocks the bus for its full length,
+    // and the byte seen on the blocked bus is found from the progress of the transfer when it's read.
+    bool oam_dma_bulk = false;
+
+    u8 OAMDMABusByte() const;
+    // The fast profile's OAM DMA, which completes immediately.
+    void CopyOAM_DMA();
 
     enum class HDMAType {GDMA, HDMA};
     DMAState hdma_state = DMAState::Inactive;
     HDMAType hdma_type;
     bool hdma_reg_written = false;
     int bytes_to_copy = 0, hblank_bytes = 0;
+    // Bytes of the current 16 byte block which have already been copied. The copy still stalls the CPU for as long
+    // as it would take to copy them one at a time.
+    int hdma_bytes_ahead = 0;
 
     void InitHDMA();
     void ExecuteHDMA();
+    void CopyHDMA(int num_bytes);
     u8 DMACopy(const u16 addr) const;
 
     // MBC functions
     u8 ReadExternalRAM(const u16 addr) const;
     void WriteExternalRAM(const u16 addr, const u8 data);
+
+    static constexpr int save_idle_frames = 30;
+    bool ext_ram_written = false;
+    bool ext_ram_dirty = false;
+    int frames_since_ext_ram_write = 0;
     void WriteMBCControlRegisters(const u16 addr, const u8 data);
 
+    // Host pointers to the currently selected banks. These are updated whenever a bank register or the external RAM
+    // enable is written, so that reads don't need to recompute bank offsets. sram_ptr is null if external RAM reads
+    // and writes need to go through the MBC, e.g. for the RTC registers or out of bounds banks.
+    const u8* rom0_ptr;
+    const u8* romx_ptr;
+    u8* vram_ptr;
+    u8* wram_ptr;
+    u8* sram_ptr;
+    // 4KB pages which can be read directly when OAM DMA isn't blocking a bus. Null pages fall back to the region
+    // checks in ReadMem.
+    std::array<const u8*, 16> read_pages{};
+    // 256 byte pages which can be written directly when OAM DMA isn't blocking a bus. Only WRAM and its echo are
+    // plain memory: VRAM writes depend on the LCD mode and mark tiles for decoding, external RAM writes are tracked
+    // for saving, and the rest of the high pages have side effects. Of the other writes, HRAM and the I/O registers
+    // are checked first.
+    std::array<u8*, 256> write_pages{};
+    // Pages holding a breakpoint, read watchpoint or ROM patch are left out of read_pages, and pages holding a
+    // write watchpoint are left out of write_pages.
+    Common::Breakpoints breakpoints{12, 16};
+    Common::Cheats cheats{12, 16};
+
+    void UpdateBankPointers();
+
     // ******** I/O registers ******** 
     // P1 register: 0xFF00
     //     bit 5: P15 Select Button Keys (0=Select)
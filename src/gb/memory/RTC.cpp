@@ -20,12 +20,12 @@
 
 namespace Gb {
 
-RTC::RTC(std::vector<u8>& save_game) {
+RTC::RTC(Common::SaveBuffer<u8>& save_game) {
     if ((save_game.size() % 0x400) != 0x30) {
         fmt::print("No RTC save data found. RTC initialized to default time.\n");
     } else {
-        LoadRTCData(save_game);
-        save_game.erase(save_game.cend() - 0x30, save_game.cend());
+        LoadRTCData({save_game.cend() - 0x30, save_game.cend()});
+        save_game.resize(save_game.size() - 0x30);
     }
 }
 
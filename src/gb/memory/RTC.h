@@ -20,12 +20,13 @@
 #include <vector>
 
 #include "common/CommonTypes.h"
+#include "common/SaveBuffer.h"
 
 namespace Gb {
 
 class RTC {
 public:
-    RTC(std::vector<u8>& save_game);
+    RTC(Common::SaveBuffer<u8>& save_game);
 
     void LatchCurrentTime();
     u8 GetFlags() const { return flags | 0x3E; }
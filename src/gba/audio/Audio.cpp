@@ -0,0 +1,291 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "gba/audio/Audio.h"
+#include "gba/core/Core.h"
+#include "gba/core/Scheduler.h"
+#include "gba/hardware/Dma.h"
+#include "common/StateBuffer.h"
+#include "common/Timing.h"
+
+namespace Gba {
+
+namespace {
+
+// The GB registers which make up each halfword of the PSG registers, starting at SOUND1CNT_L. An address of zero
+// is an unused byte.
+struct PsgRegister {
+    u16 lo;
+    u16 hi;
+    u16 read_mask;
+};
+
+constexpr std::array<PsgRegister, 19> psg_registers{{
+    {0xFF10, 0x0000, 0x007F}, // SOUND1CNT_L
+    {0xFF11, 0xFF12, 0xFFC0}, // SOUND1CNT_H
+    {0xFF13, 0xFF14, 0x4000}, // SOUND1CNT_X
+    {0x0000, 0x0000, 0x0000},
+    {0xFF16, 0xFF17, 0xFFC0}, // SOUND2CNT_L
+    {0x0000, 0x0000, 0x0000},
+    {0xFF18, 0xFF19, 0x4000}, // SOUND2CNT_H
+    {0x0000, 0x0000, 0x0000},
+    {0xFF1A, 0x0000, 0x00E0}, // SOUND3CNT_L
+    {0xFF1B, 0xFF1C, 0xE000}, // SOUND3CNT_H
+    {0xFF1D, 0xFF1E, 0x4000}, // SOUND3CNT_X
+    {0x0000, 0x0000, 0x0000},
+    {0xFF20, 0xFF21, 0xFF00}, // SOUND4CNT_L
+    {0x0000, 0x0000, 0x0000},
+    {0xFF22, 0xFF23, 0x40FF}, // SOUND4CNT_H
+    {0x0000, 0x0000, 0x0000},
+    {0xFF24, 0xFF25, 0xFF77}, // SOUNDCNT_L
+    {0x0000, 0x0000, 0x0000}, // SOUNDCNT_H, which isn't a PSG register.
+    {0xFF26, 0x0000, 0x008F}, // SOUNDCNT_X
+}};
+
+} // End anonymous namespace
+
+Audio::Audio(Core& _core)
+        : core(_core) {
+    psg.SetConsole(Gb::Console::AGB);
+
+    core.scheduler->RegisterHandler(EventType::AudioFrame, [this](int cycles_late) { EndFrame(cycles_late); });
+    core.scheduler->Schedule(EventType::AudioFrame, cycles_per_frame);
+}
+
+u16 Audio::ReadRegister(const u32 addr) {
+    if (addr >= FIFO_A) {
+        // The FIFOs are write-only.
+        return 0x0000;
+    } else if (addr >= WAVE_RAM) {
+        const u32 index = addr - WAVE_RAM;
+        return wave_bank[index] | (wave_bank[index + 1] << 8);
+    } else if (addr == SOUNDCNT_H) {
+        return control.Read();
+    }
+
+    const PsgRegister& reg = psg_registers[(addr - SOUND1CNT_L) / 2];
+    if (reg.read_mask == 0x0000) {
+        return 0x0000;
+    }
+
+    SyncPsg();
+    u16 value = psg.ReadRegister(reg.lo);
+    if (reg.hi != 0x0000) {
+        value |= psg.ReadRegister(reg.hi) << 8;
+    }
+
+    if (addr == SOUND3CNT_L) {
+        value = (value & 0x80) | wave_control;
+    }
+
+    return value & reg.read_mask;
+}
+
+void Audio::WriteRegister(const u32 addr, const u16 data, const u16 mask) {
+    if (addr >= FIFO_A) {
+        Fifo& fifo = fifos[(addr >= FIFO_B) ? 1 : 0];
+        if (mask & 0x00FF) {
+            fifo.Push(static_cast<s8>(data));
+        }
+        if (mask & 0xFF00) {
+            fifo.Push(static_cast<s8>(data >> 8));
+        }
+        return;
+    } else if (addr >= WAVE_RAM) {
+        const u32 index = addr - WAVE_RAM;
+        if (mask & 0x00FF) {
+            wave_bank[index] = data;
+        }
+        if (mask & 0xFF00) {
+            wave_bank[index + 1] = data >> 8;
+        }
+        return;
+    } else if (addr == SOUNDCNT_H) {
+        // The FIFOs are mixed with the old settings up until now.
+        RenderFifos(core.scheduler->Timestamp());
+        control.Write(data, mask);
+
+        if (data & mask & 0x0800) {
+            fifos[0].Reset();
+        }
+        if (data & mask & 0x8000) {
+            fifos[1].Reset();
+        }
+        return;
+    }
+
+    const PsgRegister& reg = psg_registers[(addr - SOUND1CNT_L) / 2];
+    SyncPsg();
+
+    if (addr == SOUND3CNT_L && (mask & 0x00FF)) {
+        if ((data ^ wave_control) & 0x40) {
+            // Switch which bank is played and which one is accessible.
+            std::swap(psg.wave_ram, wave_bank);
+        }
+        wave_control = data & 0x60;
+    }
+
+    if (reg.lo != 0x0000 && (mask & 0x00FF)) {
+        psg.WriteRegister(reg.lo, data);
+    }
+    if (reg.hi != 0x0000 && (mask & 0xFF00)) {
+        psg.WriteRegister(reg.hi, data >> 8);
+    }
+}
+
+void Audio::TimerOverflow(int timer_id, u64 timestamp) {
+    for (int i = 0; i < 2; ++i) {
+        if (((control >> (10 + 4 * i)) & 0x1) != timer_id) {
+            continue;
+        }
+
+        // The current sample is held until the timer overflows, so everything up to then is mixed before popping.
+        RenderFifos(timestamp);
+
+        Fifo& fifo = fifos[i];
+        fifo.Pop();
+
+        if (fifo.size <= 16) {
+            // Request more samples. Either sound DMA can be used for either FIFO.
+            const u32 fifo_addr = (i == 0) ? FIFO_A : FIFO_B;
+            core.dma[1].TriggerSoundFifo(fifo_addr);
+            core.dma[2].TriggerSoundFifo(fifo_addr);
+        }
+    }
+}
+
+void Audio::Fifo::Push(s8 sample) {
+    if (size == static_cast<int>(buffer.size())) {
+        return;
+    }
+
+    buffer[(read_pos + size) % buffer.size()] = sample;
+    size += 1;
+}
+
+void Audio::Fifo::Pop() {
+    // If the FIFO is empty, the last sample is played again.
+    if (size == 0) {
+        return;
+    }
+
+    level = buffer[read_pos];
+    read_pos = (read_pos + 1) % buffer.size();
+    size -= 1;
+}
+
+void Audio::SyncPsg() {
+    const u64 ticks = (core.scheduler->Timestamp() - psg_timestamp) / cycles_per_tick;
+    psg.Tick(static_cast<unsigned int>(ticks));
+    psg_timestamp += ticks * cycles_per_tick;
+}
+
+void Audio::RenderFifos(u64 timestamp) {
+    if (timestamp <= frame_start) {
+        return;
+    }
+
+    const u64 elapsed = std::min<u64>(timestamp - frame_start, cycles_per_frame);
+    const std::size_t end = elapsed * frame_samples / cycles_per_frame;
+    if (end <= rendered_samples) {
+        return;
+    }
+
+    int left = 0;
+    int right = 0;
+    if (psg.sound_on & 0x80) {
+        for (int i = 0; i < 2; ++i) {
+            // Samples are 8 bits, and are shifted up to the 16 bit output unless the FIFO is at 50% volume.
+            const int sample = fifos[i].level * ((control & (0x0004 << i)) ? 128 : 64);
+            if (control & (0x0200 << (4 * i))) {
+                left += sample;
+            }
+            if (control & (0x0100 << (4 * i))) {
+                right += sample;
+            }
+        }
+    }
+
+    for (std::size_t i = rendered_samples; i < end; ++i) {
+        fifo_mix[i * 2] = left;
+        fifo_mix[i * 2 + 1] = right;
+    }
+
+    rendered_samples = end;
+}
+
+void Audio::EndFrame(int cycles_late) {
+    TIMING_SCOPE(Audio);
+    const u64 frame_end = frame_start + cycles_per_frame;
+
+    RenderFifos(frame_end);
+
+    // Run the PSG up to the end of the frame, so it finishes its own frame at the same time.
+    if (psg_timestamp < frame_end) {
+        psg.Tick(static_cast<unsigned int>((frame_end - psg_timestamp) / cycles_per_tick));
+        psg_timestamp = frame_end;
+    }
+    psg.Sync();
+
+    // The PSG is at half volume at its 100% setting, so it doesn't drown out the FIFOs.
+    const int psg_shift = 3 - std::min(control & 0x3, 2);
+    for (std::size_t i = 0; i < output_buffer.size(); ++i) {
+        const int sample = fifo_mix[i] + (psg.output_buffer[i] >> psg_shift);
+        output_buffer[i] = static_cast<s16>(std::max(-32768, std::min(32767, sample)));
+    }
+
+    frame_start = frame_end;
+    rendered_samples = 0;
+
+    core.scheduler->Schedule(EventType::AudioFrame, cycles_per_frame - cycles_late);
+}
+
+void Audio::Serialize(Common::StateBuffer& state) {
+    SyncPsg();
+
+    state.BeginChunk("AUD ", 1);
+    psg.Serialize(state);
+    for (auto& fifo : fifos) {
+        state.Sync(fifo.buffer);
+        state.Sync(fifo.read_pos);
+        state.Sync(fifo.size);
+        state.Sync(fifo.level);
+
+        if (state.Loading() && (fifo.read_pos < 0 || fifo.read_pos >= static_cast<int>(fifo.buffer.size())
+                                || fifo.size < 0 || fifo.size > static_cast<int>(fifo.buffer.size()))) {
+            throw std::runtime_error("Save state has an invalid sound FIFO.");
+        }
+    }
+    state.Sync(control.v);
+    state.Sync(wave_control);
+    state.Sync(wave_bank);
+    state.Sync(frame_start);
+    state.Sync(psg_timestamp);
+    state.Sync(rendered_samples);
+    state.Sync(fifo_mix);
+    state.EndChunk();
+
+    if (state.Loading() && rendered_samples > frame_samples) {
+        throw std::runtime_error("Save state has an invalid audio frame position.");
+    }
+}
+
+} // End namespace Gba
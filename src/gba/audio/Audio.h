@@ -0,0 +1,105 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <array>
+
+#include "common/CommonTypes.h"
+#include "gb/audio/Audio.h"
+#include "gba/memory/IOReg.h"
+
+namespace Common { class StateBuffer; }
+
+namespace Gba {
+
+class Core;
+
+// The four PSG channels are the Game Boy's, and are run by a band-limited Gb::Audio clocked at the GB APU rate of
+// one tick every 8 cycles. This gives exactly 35112 ticks per frame, the same as on the Game Boy. The two Direct
+// Sound FIFOs are zero-order held at the output rate, and are rendered up to the current time whenever a sample
+// is popped or the control register changes, rather than every cycle.
+class Audio {
+public:
+    Audio(Core& _core);
+
+    static constexpr u32 SOUND1CNT_L = 0x0400'0060;
+    static constexpr u32 SOUND3CNT_L = 0x0400'0070;
+    static constexpr u32 SOUNDCNT_H  = 0x0400'0082;
+    static constexpr u32 SOUNDCNT_X  = 0x0400'0084;
+    static constexpr u32 WAVE_RAM    = 0x0400'0090;
+    static constexpr u32 FIFO_A      = 0x0400'00A0;
+    static constexpr u32 FIFO_B      = 0x0400'00A4;
+
+    std::array<s16, 1600> output_buffer{};
+
+    u16 ReadRegister(const u32 addr);
+    void WriteRegister(const u32 addr, const u16 data, const u16 mask);
+    void TimerOverflow(int timer_id, u64 timestamp);
+
+    void Serialize(Common::StateBuffer& state);
+
+private:
+    Core& core;
+    Gb::Audio psg{AudioFilter::BandLimited};
+
+    struct Fifo {
+        std::array<s8, 32> buffer{};
+        int read_pos = 0;
+        int size = 0;
+        s8 level = 0;
+
+        void Push(s8 sample);
+        void Pop();
+        void Reset() { read_pos = 0; size = 0; }
+    };
+
+    std::array<Fifo, 2> fifos;
+
+    // SOUNDCNT_H register: 0x0400'0082
+    //     bit 15:    FIFO B Reset (Write Only)
+    //     bit 14:    FIFO B Timer Select
+    //     bit 13-12: FIFO B Enable Left/Right
+    //     bit 11:    FIFO A Reset (Write Only)
+    //     bit 10:    FIFO A Timer Select
+    //     bit 9-8:   FIFO A Enable Left/Right
+    //     bit 3:     FIFO B Volume (0=50%, 1=100%)
+    //     bit 2:     FIFO A Volume (0=50%, 1=100%)
+    //     bit 1-0:   PSG Volume (0=25%, 1=50%, 2=100%)
+    IOReg control = {0x0000, 0x770F, 0x770F};
+
+    // Bits 6-5 of SOUND3CNT_L, which select the wave RAM bank to play and the 64 sample mode. The CPU accesses the
+    // bank which isn't being played, which is kept here while the playing bank is in psg.wave_ram. The 64 sample
+    // mode, which plays both banks in turn, is not emulated.
+    u8 wave_control = 0x00;
+    std::array<u8, 0x10> wave_bank{};
+
+    static constexpr int cycles_per_frame = 280896;
+    static constexpr int cycles_per_tick = 8;
+    static constexpr std::size_t frame_samples = 800;
+
+    u64 frame_start = 0;
+    u64 psg_timestamp = 0;
+    std::size_t rendered_samples = 0;
+    std::array<int, frame_samples * 2> fifo_mix{};
+
+    void SyncPsg();
+    void RenderFifos(u64 timestamp);
+    void EndFrame(int cycles_late);
+};
+
+} // End namespace Gba
@@ -15,34 +15,68 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <fmt/format.h>
 
 #include "gba/core/Core.h"
 #include "gba/core/Enums.h"
+#include "gba/core/Scheduler.h"
 #include "gba/memory/Memory.h"
 #include "gba/cpu/Cpu.h"
 #include "gba/cpu/Disassembler.h"
 #include "gba/lcd/Lcd.h"
+#include "gba/lcd/RenderThread.h"
 #include "gba/hardware/Timer.h"
 #include "gba/hardware/Dma.h"
 #include "gba/hardware/Keypad.h"
 #include "gba/hardware/Serial.h"
-#include "emu/SDLContext.h"
+#include "gba/audio/Audio.h"
+#include "emu/Frontend.h"
 #include "common/Screenshot.h"
+#include "common/StateBuffer.h"
+#include "common/Rewind.h"
+#include "common/FrameStats.h"
+#include "common/Movie.h"
+#include "common/SharedMemoryExport.h"
+#include "common/Profiler.h"
+#include "common/Timing.h"
 
 namespace Gba {
 
-Core::Core(Emu::SDLContext& context, const std::vector<u32>& bios, const std::vector<u16>& rom,
-           const std::string& save_path, LogLevel level)
-        : mem(std::make_unique<Memory>(bios, rom, save_path, *this))
-        , cpu(std::make_unique<Cpu>(*mem, *this))
+// Roughly 270 samples per frame.
+constexpr int profile_sample_period = 1024;
+
+Core::Core(Emu::Frontend& context, const Common::RomView<u32>& bios, const Common::RomView<u16>& rom,
+           const std::string& save_path, LogLevel level, bool block_cache, bool threaded_render,
+           std::size_t rewind_capacity, bool enable_profiler, bool idle_skip, bool mmap_saves, bool huge_pages)
+        : scheduler(std::make_unique<Scheduler>())
+        , mem(std::make_unique<Memory>(bios, rom, save_path, mmap_saves, huge_pages, *this))
+        , cpu(std::make_unique<Cpu>(*mem, *this, block_cache, idle_skip))
         , disasm(std::make_unique<Disassembler>(*this, level))
         , lcd(std::make_unique<Lcd>(mem->PramReference(), mem->VramReference(), mem->OamReference(), *this))
+        , render_thread(threaded_render ? std::make_unique<RenderThread>(*mem, *this) : nullptr)
         , timers{{0, *this}, {1, *this}, {2, *this}, {3, *this}}
         , dma{{0, *this}, {1, *this}, {2, *this}, {3, *this}}
+        , audio(std::make_unique<Audio>(*this))
         , keypad(std::make_unique<Keypad>(*this))
         , serial(std::make_unique<Serial>(*this))
-        , sdl_context(context)
-        , front_buffer(Lcd::h_pixels * Lcd::v_pixels, 0x7FFF) {
+        , profiler(enable_profiler ? std::make_unique<Common::Profiler>(profile_sample_period) : nullptr)
+        , clone_settings{bios, rom, level, block_cache, threaded_render, idle_skip, huge_pages}
+        , frontend(context)
+        , front_buffer(Lcd::h_pixels * Lcd::v_pixels, 0x7FFF)
+        , state_path(save_path.substr(0, save_path.rfind('.')) + ".state")
+        , rewind_buffer(rewind_capacity ? std::make_unique<Common::RewindBuffer>(rewind_capacity) : nullptr) {
+
+    for (int i = 0; i < 4; ++i) {
+        const auto overflow_event = static_cast<EventType>(static_cast<int>(EventType::Timer0Overflow) + i);
+        scheduler->RegisterHandler(overflow_event, [this, i](int cycles_late) { timers[i].Overflow(cycles_late); });
+    }
+    scheduler->RegisterHandler(EventType::SerialTransfer, [this](int) { serial->FinishTransfer(); });
+    scheduler->RegisterHandler(EventType::SerialPoll, [this](int cycles_late) { serial->PollLink(cycles_late); });
+
+    mem->MapIO();
 
     RegisterCallbacks();
 }
@@ -51,8 +85,7 @@ Core::Core(Emu::SDLContext& context, const std::vector<u32>& bios, const std::ve
 Core::~Core() = default;
 
 void Core::EmulatorLoop() {
-    constexpr int cycles_per_frame = 280896;
-    int overspent_cycles = 0;
+    frontend.UnpauseAudio();
 
     using namespace std::chrono;
     auto max_frame_time = 0us;
@@ -62,34 +95,128 @@ void Core::EmulatorLoop() {
     while (!quit) {
         const auto start_time = steady_clock::now();
 
-        sdl_context.PollEvents();
+        frontend.PollEvents();
 
         if (pause && !frame_advance) {
-            SDL_Delay(48);
-            sdl_context.RenderFrame(front_buffer.data());
+            frontend.Delay(48);
+            frontend.RenderFrame(front_buffer.data());
             continue;
         }
 
         frame_advance = false;
 
-        keypad->CheckKeypadInterrupt();
+        if (rewinding) {
+            if (!rewind_buffer->Pop(rewind_state.Data())) {
+                // Nothing older to go back to.
+                frontend.Delay(16);
+                frontend.RenderFrame(front_buffer.data());
+                continue;
+            }
 
-        // Overspent cycles is always zero or negative.
-        int target_cycles = cycles_per_frame + overspent_cycles;
-        overspent_cycles = cpu->Execute(target_cycles);
+            // Rerun the restored frame to draw it.
+            rewind_state.BeginLoad();
+            Serialize(rewind_state);
+        } else if (rewind_buffer) {
+            rewind_state.BeginSave();
+            Serialize(rewind_state);
+            rewind_buffer->Push(rewind_state.Data());
+        }
+
+        if (run_ahead && !rewinding) {
+            RunAheadFrame();
+        } else {
+            RunFrame();
+            if (!rewinding && !pacer.FastForwarding()) {
+                frontend.PushBackAudio(audio->output_buffer);
+            }
+        }
 
         auto frame_time = duration_cast<microseconds>(steady_clock::now() - start_time);
+        RecordMetrics(frame_time.count());
         max_frame_time = std::max(max_frame_time, frame_time);
         avg_frame_time += frame_time;
         if (++frame_count == 60) {
-            sdl_context.UpdateFrameTimes(avg_frame_time.count() / 60, max_frame_time.count());
+            frontend.UpdateFrameTimes(avg_frame_time.count() / 60, max_frame_time.count(), pacer.TakeAverageError());
             max_frame_time = 0us;
             avg_frame_time = 0us;
             frame_count = 0;
         }
 
-        sdl_context.RenderFrame(front_buffer.data());
+        frontend.RenderFrame(front_buffer.data());
+        pacer.WaitForNextFrame();
     }
+
+    frontend.PauseAudio();
+
+    WriteProfile();
+}
+
+Common::FrameStats Core::RunHeadless(int num_frames) {
+    using namespace std::chrono;
+    Common::FrameStats stats;
+
+    const auto run_start_time = steady_clock::now();
+    for (; stats.frames < num_frames; ++stats.frames) {
+        const auto start_time = steady_clock::now();
+        RunFrame();
+        const double frame_time = duration<double, std::micro>(steady_clock::now() - start_time).count();
+        RecordMetrics(frame_time);
+        stats.max_frame_time_us = std::max(stats.max_frame_time_us, frame_time);
+    }
+
+    stats.total_seconds = duration<double>(steady_clock::now() - run_start_time).count();
+    if (num_frames > 0) {
+        stats.avg_frame_time_us = stats.total_seconds * 1e6 / num_frames;
+    }
+    stats.framebuffer_hash = Common::HashFrameBuffer(front_buffer);
+
+    WriteProfile();
+
+    return stats;
+}
+
+void Core::RunFrame() {
+    constexpr int cycles_per_frame = 280896;
+
+    if (movie && !speculative) {
+        UpdateMovie();
+    } else if (shm_export && !speculative) {
+        UpdateExternalInput();
+    }
+
+    keypad->CheckKeypadInterrupt();
+
+    // Overspent cycles is always zero or negative.
+    int target_cycles = cycles_per_frame + overspent_cycles;
+    {
+        TIMING_SCOPE(Cpu);
+        overspent_cycles = cpu->Execute(target_cycles);
+    }
+
+    if (speculative) {
+        return;
+    }
+
+    if (mem->BreakpointTriggered()) {
+        ReportBreakpoints();
+    }
+
+    mem->SyncSaveFile();
+
+    if (capture) {
+        capture->Submit(front_buffer);
+    }
+
+    if (shm_export) {
+        shm_export->Publish(front_buffer, {Common::SharedMemoryExport::View(mem->XRamReference()),
+                                           Common::SharedMemoryExport::View(mem->IRamReference())});
+    }
+
+    if (movie && movie->CheckpointDue()) {
+        MovieCheckpoint();
+    }
+
+    TIMING_END_FRAME();
 }
 
 void Core::UpdateHardware(int cycles) {
@@ -97,59 +224,299 @@ void Core::UpdateHardware(int cycles) {
         return;
     }
 
-    lcd->Update(cycles);
+    scheduler->Advance(cycles);
+}
 
-    for (auto& timer : timers) {
-        timer.Tick(cycles);
+int Core::HaltCycles(int remaining_cpu_cycles) const {
+    // Timer overflows are scheduled events, so the scheduler knows when the next interrupt can happen. The clamp
+    // comes before the increment, since an empty queue reports the largest int.
+    return std::min(scheduler->CyclesUntilNextEvent(), remaining_cpu_cycles - 1) + 1;
+}
+
+void Core::RegisterCallbacks() {
+    using Emu::InputEvent;
+
+    frontend.RegisterCallback(InputEvent::Quit,         [this](bool) { quit = true; });
+    frontend.RegisterCallback(InputEvent::Pause,        [this](bool) { pause = !pause; });
+    frontend.RegisterCallback(InputEvent::LogLevel,     [this](bool) { disasm->SwitchLogLevel(); });
+    frontend.RegisterCallback(InputEvent::Fullscreen,   [this](bool) { frontend.ToggleFullscreen(); });
+    frontend.RegisterCallback(InputEvent::Screenshot,   [this](bool) { Screenshot(); });
+    frontend.RegisterCallback(InputEvent::LcdDebug,     [this](bool) { lcd->DumpDebugInfo(); Screenshot(); });
+    frontend.RegisterCallback(InputEvent::HideWindow,   [this](bool) { old_pause = pause; pause = true; });
+    frontend.RegisterCallback(InputEvent::ShowWindow,   [this](bool) { pause = old_pause; });
+    frontend.RegisterCallback(InputEvent::FrameAdvance, [this](bool) { frame_advance = true; });
+    frontend.RegisterCallback(InputEvent::SaveState,    [this](bool) { SaveState(); });
+    frontend.RegisterCallback(InputEvent::LoadState,    [this](bool) { LoadState(); });
+    frontend.RegisterCallback(InputEvent::Turbo,        [this](bool press) { pacer.SetTurbo(press); });
+    frontend.RegisterCallback(InputEvent::Rewind,       [this](bool press) {
+        // Rewinding would make a movie's inputs go out of step with its frames.
+        rewinding = press && rewind_buffer && !movie;
+    });
+
+    frontend.RegisterCallback(InputEvent::Up,     [this](bool press) { PressButton(Keypad::Up, press); });
+    frontend.RegisterCallback(InputEvent::Left,   [this](bool press) { PressButton(Keypad::Left, press); });
+    frontend.RegisterCallback(InputEvent::Down,   [this](bool press) { PressButton(Keypad::Down, press); });
+    frontend.RegisterCallback(InputEvent::Right,  [this](bool press) { PressButton(Keypad::Right, press); });
+    frontend.RegisterCallback(InputEvent::A,      [this](bool press) { PressButton(Keypad::A, press); });
+    frontend.RegisterCallback(InputEvent::B,      [this](bool press) { PressButton(Keypad::B, press); });
+    frontend.RegisterCallback(InputEvent::L,      [this](bool press) { PressButton(Keypad::L, press); });
+    frontend.RegisterCallback(InputEvent::R,      [this](bool press) { PressButton(Keypad::R, press); });
+    frontend.RegisterCallback(InputEvent::Start,  [this](bool press) { PressButton(Keypad::Start, press); });
+    frontend.RegisterCallback(InputEvent::Select, [this](bool press) { PressButton(Keypad::Select, press); });
+}
+
+void Core::Screenshot(const std::string& filename) const {
+    Common::WritePNGFile(Common::BGR5ToRGB8(front_buffer), filename, 240, 160);
+}
+
+void Core::SetRenderSkip(int n) {
+    lcd->render_skip = n;
+}
+
+void Core::StartCapture(const std::string& path_prefix, Common::FrameCapture::Format format) {
+    capture = std::make_unique<Common::FrameCapture>(path_prefix, format, 240, 160);
+}
+
+void Core::ExportMetrics(const Common::Metrics::Settings& settings) {
+    metrics = std::make_unique<Common::Metrics>(settings, "gba", Common::FramePacer::refresh_rate);
+}
+
+void Core::RecordMetrics(double frame_time_us) {
+    if (metrics) {
+        metrics->RecordFrame(frame_time_us, cpu->counters, frontend.AudioUnderruns(), frontend.QueuedAudioFrames());
     }
+}
 
-    mem->DelayedSaveOp(cycles);
+void Core::SetRunAhead(int frames) {
+    run_ahead = frames;
 }
 
-int Core::HaltCycles(int remaining_cpu_cycles) const {
-    int halt_cycles = lcd->NextEvent();
+void Core::RunAheadFrame() {
+    // The real frame is drawn as usual, so captures and screenshots still show what the game really displayed.
+    RunFrame();
+    if (!pacer.FastForwarding()) {
+        frontend.PushBackAudio(audio->output_buffer);
+    }
 
-    for (const auto& timer : timers) {
-        if (!mem->InterruptEnabled(Interrupt::Timer0 << timer.id)) {
-            continue;
-        }
+    run_ahead_state.BeginSave();
+    Serialize(run_ahead_state);
+
+    // Run ahead with the same input, only drawing the last frame, which is the one presented.
+    speculative = true;
+    for (int i = 1; i <= run_ahead; ++i) {
+        lcd->SetSkipFrame(i < run_ahead);
+        RunFrame();
+    }
+    speculative = false;
+    mem->TakeBreakpointHits();
 
-        int next_event_cycles = timer.NextEvent();
-        if (next_event_cycles != 0) {
-            halt_cycles = std::min(halt_cycles, next_event_cycles);
+    // The front buffer isn't part of the state, so it keeps the frame from the future.
+    run_ahead_state.BeginLoad();
+    Serialize(run_ahead_state);
+}
+
+void Core::RecordMovie(const std::string& filename, bool from_current_state) {
+    std::vector<u8> start_state;
+    if (from_current_state) {
+        movie_state.BeginSave();
+        Serialize(movie_state);
+        start_state = movie_state.Data();
+    }
+
+    movie = std::make_unique<Common::Movie>(filename, Common::Movie::Console::Gba, std::move(start_state));
+    rewinding = false;
+    applied_buttons = 0x00;
+}
+
+void Core::PlayMovie(std::unique_ptr<Common::Movie> movie_to_play) {
+    if (movie_to_play->GetConsole() != Common::Movie::Console::Gba) {
+        throw std::runtime_error("Movie was recorded on a different console.");
+    }
+
+    if (!movie_to_play->StartState().empty()) {
+        Common::StateBuffer state{movie_to_play->StartState()};
+        Serialize(state);
+    }
+
+    movie = std::move(movie_to_play);
+    rewinding = false;
+    applied_buttons = 0x00;
+}
+
+void Core::SetHleBios(bool enable) {
+    cpu->hle_bios = enable;
+}
+
+void Core::SetAccuracy(Accuracy profile) {
+    mem->SetAccuracy(profile);
+}
+
+void Core::SkipBios() {
+    cpu->SkipBios();
+    mem->SetPostBootFlag();
+}
+
+void Core::AttachLinkCable(Common::LinkCable* cable) {
+    serial->AttachLinkCable(cable);
+}
+
+void Core::ExportSharedMemory(const std::string& name) {
+    const std::vector<std::size_t> region_sizes{Common::SharedMemoryExport::View(mem->XRamReference()).size,
+                                                Common::SharedMemoryExport::View(mem->IRamReference()).size};
+    shm_export = std::make_unique<Common::SharedMemoryExport>(name, 240, 160, region_sizes);
+    held_buttons = applied_buttons;
+}
+
+void Core::AddBreakpoint(u32 addr, Common::Breakpoints::Type type) {
+    mem->AddBreakpoint(addr, type);
+}
+
+std::unique_ptr<Core> Core::Clone(Emu::Frontend& context) {
+    const auto& settings = clone_settings;
+    auto clone = std::make_unique<Core>(context, settings.bios, settings.rom, "", settings.level,
+                                        settings.block_cache, settings.threaded_render, 0, false, settings.idle_skip,
+                                        false, settings.huge_pages);
+    clone->SetRenderSkip(lcd->render_skip);
+    clone->SetHleBios(cpu->hle_bios);
+    clone->SetAccuracy(mem->GetAccuracy());
+    clone->mem->SetCheats(mem->CheatList());
+    clone->held_buttons = held_buttons;
+    clone->applied_buttons = applied_buttons;
+    clone->front_buffer = front_buffer;
+
+    // The arena is shared first, so the rest of the state loads on top of the right memory contents.
+    mem->ShareArena(*clone->mem);
+
+    Common::StateBuffer clone_state;
+    Serialize(clone_state, false);
+    clone_state.BeginLoad();
+    clone->Serialize(clone_state, false);
+
+    return clone;
+}
+
+void Core::AddCheat(const std::string& code) {
+    mem->AddCheat(code);
+}
+
+void Core::ReportBreakpoints() {
+    for (const auto& hit : mem->TakeBreakpointHits()) {
+        fmt::print("{} hit at 0x{:0>8X}\n", Common::Breakpoints::TypeName(hit.type), hit.addr);
+    }
+    fmt::print("Paused at PC 0x{:0>8X}\n", cpu->GetPc());
+    pause = true;
+}
+
+void Core::PressButton(u16 button, bool pressed) {
+    if (movie || shm_export) {
+        held_buttons = (pressed) ? (held_buttons | button) : (held_buttons & ~button);
+    } else {
+        keypad->Press(static_cast<Keypad::Button>(button), pressed);
+    }
+}
+
+void Core::SetButtons(u16 buttons) {
+    // Buttons are always applied in the same order, so that playback changes the keypad state exactly as
+    // recording did.
+    for (unsigned int i = 0; i < 10; ++i) {
+        const u16 button = 1 << i;
+        if ((buttons ^ applied_buttons) & button) {
+            keypad->Press(static_cast<Keypad::Button>(button), buttons & button);
         }
     }
 
-    return std::min(halt_cycles + 1, remaining_cpu_cycles);
+    applied_buttons = buttons;
 }
 
-void Core::RegisterCallbacks() {
-    using Emu::InputEvent;
+void Core::UpdateExternalInput() {
+    u32 buttons;
+    SetButtons(shm_export->Buttons(buttons) ? static_cast<u16>(buttons) : held_buttons);
+}
+
+void Core::UpdateMovie() {
+    if (movie->Finished()) {
+        // Hand the keypad back to the frontend.
+        fmt::print("Movie finished after {} frames\n", movie->Length());
+        movie.reset();
+        SetButtons(held_buttons);
+        return;
+    }
+
+    SetButtons(static_cast<u16>(movie->NextFrame(held_buttons)));
+}
+
+void Core::MovieCheckpoint() {
+    movie_state.BeginSave();
+    Serialize(movie_state);
+    movie->Checkpoint(Common::Movie::HashState(movie_state.Data()));
+}
+
+void Core::Serialize(Common::StateBuffer& state, bool include_arena) {
+    state.BeginChunk("GBA ", 2);
+    state.Sync(overspent_cycles);
+    scheduler->Serialize(state);
+    mem->Serialize(state, include_arena);
+    cpu->Serialize(state);
+    lcd->Serialize(state);
+    for (auto& timer : timers) {
+        timer.Serialize(state);
+    }
+    for (auto& channel : dma) {
+        channel.Serialize(state);
+    }
+    audio->Serialize(state);
+    keypad->Serialize(state);
+    serial->Serialize(state);
+    state.EndChunk();
+
+    if (state.Loading() && render_thread) {
+        render_thread->Resync(*mem, *lcd);
+    }
 
-    sdl_context.RegisterCallback(InputEvent::Quit,         [this](bool) { quit = true; });
-    sdl_context.RegisterCallback(InputEvent::Pause,        [this](bool) { pause = !pause; });
-    sdl_context.RegisterCallback(InputEvent::LogLevel,     [this](bool) { disasm->SwitchLogLevel(); });
-    sdl_context.RegisterCallback(InputEvent::Fullscreen,   [this](bool) { sdl_context.ToggleFullscreen(); });
-    sdl_context.RegisterCallback(InputEvent::Screenshot,   [this](bool) { Screenshot(); });
-    sdl_context.RegisterCallback(InputEvent::LcdDebug,     [this](bool) { lcd->DumpDebugInfo(); Screenshot(); });
-    sdl_context.RegisterCallback(InputEvent::HideWindow,   [this](bool) { old_pause = pause; pause = true; });
-    sdl_context.RegisterCallback(InputEvent::ShowWindow,   [this](bool) { pause = old_pause; });
-    sdl_context.RegisterCallback(InputEvent::FrameAdvance, [this](bool) { frame_advance = true; });
-
-    sdl_context.RegisterCallback(InputEvent::Up,     [this](bool press) { keypad->Press(Keypad::Up, press); });
-    sdl_context.RegisterCallback(InputEvent::Left,   [this](bool press) { keypad->Press(Keypad::Left, press); });
-    sdl_context.RegisterCallback(InputEvent::Down,   [this](bool press) { keypad->Press(Keypad::Down, press); });
-    sdl_context.RegisterCallback(InputEvent::Right,  [this](bool press) { keypad->Press(Keypad::Right, press); });
-    sdl_context.RegisterCallback(InputEvent::A,      [this](bool press) { keypad->Press(Keypad::A, press); });
-    sdl_context.RegisterCallback(InputEvent::B,      [this](bool press) { keypad->Press(Keypad::B, press); });
-    sdl_context.RegisterCallback(InputEvent::L,      [this](bool press) { keypad->Press(Keypad::L, press); });
-    sdl_context.RegisterCallback(InputEvent::R,      [this](bool press) { keypad->Press(Keypad::R, press); });
-    sdl_context.RegisterCallback(InputEvent::Start,  [this](bool press) { keypad->Press(Keypad::Start, press); });
-    sdl_context.RegisterCallback(InputEvent::Select, [this](bool press) { keypad->Press(Keypad::Select, press); });
-}
-
-void Core::Screenshot() const {
-    Common::WritePPMFile(Common::BGR5ToRGB8(front_buffer), "screenshot.ppm", 240, 160);
+    if (state.Loading() && profiler) {
+        profiler->ResetStack();
+    }
+}
+
+void Core::WriteProfile() const {
+    if (profiler) {
+        profiler->WriteProfile("profile");
+        fmt::print("Wrote guest profile to profile.txt and profile.folded\n");
+    }
+}
+
+void Core::SaveState() {
+    Common::StateBuffer state;
+    Serialize(state);
+
+    std::ofstream state_file(state_path, std::ios::binary);
+    state_file.write(reinterpret_cast<const char*>(state.Data().data()), state.Data().size());
+    if (!state_file) {
+        fmt::print("Error when attempting to write {}\n", state_path);
+    }
+}
+
+void Core::LoadState() {
+    std::ifstream state_file(state_path, std::ios::binary);
+    if (!state_file) {
+        fmt::print("No save state found at {}\n", state_path);
+        return;
+    }
+
+    std::vector<u8> saved_data{std::istreambuf_iterator<char>(state_file), std::istreambuf_iterator<char>()};
+
+    // A bad state is rejected partway through loading, so keep the current state around to go back to.
+    Common::StateBuffer backup;
+    Serialize(backup);
+
+    try {
+        Common::StateBuffer state{std::move(saved_data)};
+        Serialize(state);
+    } catch (const std::runtime_error& e) {
+        fmt::print("{}\n", e.what());
+        Common::StateBuffer restore{backup.Data()};
+        Serialize(restore);
+    }
 }
 
 } // End namespace Gba
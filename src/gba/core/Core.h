@@ -22,44 +22,159 @@
 
 #include "common/CommonTypes.h"
 #include "common/CommonEnums.h"
+#include "common/StateBuffer.h"
+#include "common/MappedFile.h"
+#include "common/FrameCapture.h"
+#include "common/Movie.h"
+#include "common/Breakpoints.h"
+#include "common/FramePacer.h"
+#include "common/Metrics.h"
 
-namespace Emu { class SDLContext; }
+namespace Emu { class Frontend; }
+namespace Common { class RewindBuffer; class Profiler; struct FrameStats; class LinkCable; class SharedMemoryExport; }
 
 namespace Gba {
 
+class Scheduler;
 class Memory;
 class Cpu;
 class Disassembler;
 class Lcd;
+class RenderThread;
 class Timer;
 class Dma;
+class Audio;
 class Keypad;
 class Serial;
 
 class Core {
 public:
-    Core(Emu::SDLContext& context, const std::vector<u32>& bios, const std::vector<u16>& rom,
-         const std::string& save_path, LogLevel level);
+    Core(Emu::Frontend& context, const Common::RomView<u32>& bios, const Common::RomView<u16>& rom,
+         const std::string& save_path, LogLevel level, bool block_cache, bool threaded_render,
+         std::size_t rewind_capacity, bool enable_profiler, bool idle_skip, bool mmap_saves, bool huge_pages);
     ~Core();
 
+    std::unique_ptr<Scheduler> scheduler;
     std::unique_ptr<Memory> mem;
     std::unique_ptr<Cpu> cpu;
     std::unique_ptr<Disassembler> disasm;
     std::unique_ptr<Lcd> lcd;
+    std::unique_ptr<RenderThread> render_thread;
     std::vector<Timer> timers;
     std::vector<Dma> dma;
+    std::unique_ptr<Audio> audio;
     std::unique_ptr<Keypad> keypad;
     std::unique_ptr<Serial> serial;
+    // Only present when profiling.
+    std::unique_ptr<Common::Profiler> profiler;
 
     void EmulatorLoop();
+    // Runs the given number of frames as fast as possible, without presenting frames or playing audio.
+    Common::FrameStats RunHeadless(int num_frames);
     void UpdateHardware(int cycles);
     int HaltCycles(int remaining_cpu_cycles) const;
     void SwapBuffers(std::vector<u16>& back_buffer) { front_buffer.swap(back_buffer); }
 
-    void Screenshot() const;
+    void Screenshot(const std::string& filename = "screenshot.png") const;
+    // Writes every frame from now on to disk, for video capture and screenshot comparison.
+    void StartCapture(const std::string& path_prefix, Common::FrameCapture::Format format);
+    // Periodically writes frame time percentiles, emulation speed, CPU and audio counters to a file.
+    void ExportMetrics(const Common::Metrics::Settings& settings);
+    // Only draws and presents every nth frame, to speed up fast-forwarding.
+    void SetRenderSkip(int n);
+    void SetFramePacing(const Common::FramePacer::Settings& settings) { pacer.SetSettings(settings); }
+    // Emulates this many frames ahead of the real one every frame and presents the last of them, then rolls back.
+    // This hides the game's own input lag.
+    void SetRunAhead(int frames);
+    // Runs the BIOS calls games spend the most time in (copies, decompression, division, affine setup and
+    // IntrWait) natively, rather than in the BIOS. The timing of these calls is only approximate.
+    void SetHleBios(bool enable);
+    // Chooses between the accurate and fast timing profiles. See Memory::SetAccuracy.
+    void SetAccuracy(Accuracy profile);
+    // Starts at the cartridge entry point in the state the BIOS leaves behind, instead of running the boot
+    // animation. The BIOS is still used for SWIs. Must be called before any frames have run.
+    void SkipBios();
+    // Records the buttons held on every frame from now on. The movie starts from the current state if
+    // from_current_state is set, or from power-on otherwise (so no frames must have run yet).
+    void RecordMovie(const std::string& filename, bool from_current_state);
+    // Replays a movie's buttons in place of the frontend's, starting from its save state if it has one.
+    void PlayMovie(std::unique_ptr<Common::Movie> movie_to_play);
+    // Connects the serial port to another instance. The cable has to outlive the core.
+    void AttachLinkCable(Common::LinkCable* cable);
+    // Publishes every frame and the work RAM to the named shared memory segment, and lets other processes hold
+    // buttons through it.
+    void ExportSharedMemory(const std::string& name);
+    // Pauses at the end of any frame which hits the breakpoint or watchpoint. Speculative run-ahead frames never
+    // hit them.
+    void AddBreakpoint(u32 addr, Common::Breakpoints::Type type);
+    // Applies a GameShark or Action Replay code from now on. Throws if the code can't be decoded. Must be called
+    // before any frames have run, since ROM patches don't reach blocks already in the block cache.
+    void AddCheat(const std::string& code);
+
+    // Creates an independent copy of the emulated machine, as of the end of the last frame, which presents to the
+    // given frontend. The clone shares this core's ROM and BIOS, and its guest memory starts out sharing pages with
+    // this core copy-on-write where the platform allows. Only the machine is copied: the clone never writes the save
+    // file, and has no rewind buffer, profiler, movie, capture, metrics export, link cable, shared memory export or
+    // breakpoints. Cheats are kept.
+    std::unique_ptr<Core> Clone(Emu::Frontend& context);
+
+    // Covers the whole emulated machine. States are only saved and loaded between frames.
+    void Serialize(Common::StateBuffer& state) { Serialize(state, true); }
+    void SaveState();
+    void LoadState();
 private:
-    Emu::SDLContext& sdl_context;
+    // What a clone is constructed with.
+    struct CloneSettings {
+        const Common::RomView<u32>& bios;
+        const Common::RomView<u16>& rom;
+        LogLevel level;
+        bool block_cache;
+        bool threaded_render;
+        bool idle_skip;
+        bool huge_pages;
+    };
+    const CloneSettings clone_settings;
+
+    Emu::Frontend& frontend;
     std::vector<u16> front_buffer;
+    const std::string state_path;
+    // Only present when capturing frames.
+    std::unique_ptr<Common::FrameCapture> capture;
+    // Only present when exporting metrics.
+    std::unique_ptr<Common::Metrics> metrics;
+    void RecordMetrics(double frame_time_us);
+    // Only present when exporting to shared memory. While it is, the frontend's buttons are collected in
+    // held_buttons, as with movies.
+    std::unique_ptr<Common::SharedMemoryExport> shm_export;
+
+    // Frames to run ahead of the real frame, if run-ahead is enabled. Speculative frames don't touch anything
+    // outside the emulated machine: saves, movies and captures.
+    int run_ahead = 0;
+    bool speculative = false;
+    Common::StateBuffer run_ahead_state;
+    void RunAheadFrame();
+
+    // Only present while recording or playing back a movie. While it is, the frontend's buttons are collected in
+    // held_buttons and only applied to the keypad at the start of each frame.
+    std::unique_ptr<Common::Movie> movie;
+    Common::StateBuffer movie_state;
+    u16 held_buttons = 0x0000;
+    u16 applied_buttons = 0x0000;
+    void PressButton(u16 button, bool pressed);
+    void SetButtons(u16 buttons);
+    void UpdateExternalInput();
+    void UpdateMovie();
+    void MovieCheckpoint();
+
+    int overspent_cycles = 0;
+
+    // Only present when rewinding is enabled.
+    std::unique_ptr<Common::RewindBuffer> rewind_buffer;
+    Common::StateBuffer rewind_state;
+    bool rewinding = false;
+
+    // Paces EmulatorLoop. Headless runs are never paced.
+    Common::FramePacer pacer;
 
     bool quit = false;
     bool pause = false;
@@ -67,6 +182,10 @@ private:
     bool frame_advance = false;
 
     void RegisterCallbacks();
+    void Serialize(Common::StateBuffer& state, bool include_arena);
+    void RunFrame();
+    void ReportBreakpoints();
+    void WriteProfile() const;
 };
 
 } // End namespace Gba
@@ -0,0 +1,84 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "gba/core/Scheduler.h"
+#include "common/StateBuffer.h"
+
+namespace Gba {
+
+void Scheduler::Schedule(EventType type, int cycles) {
+    Deschedule(type);
+
+    queue.push_back({timestamp + cycles, type});
+    std::push_heap(queue.begin(), queue.end(), LaterEvent);
+}
+
+void Scheduler::Deschedule(EventType type) {
+    const auto itr = std::find_if(queue.begin(), queue.end(), [type](const Event& event) {
+        return event.type == type;
+    });
+
+    if (itr != queue.end()) {
+        queue.erase(itr);
+        std::make_heap(queue.begin(), queue.end(), LaterEvent);
+    }
+}
+
+bool Scheduler::Scheduled(EventType type) const {
+    return std::any_of(queue.cbegin(), queue.cend(), [type](const Event& event) { return event.type == type; });
+}
+
+void Scheduler::RunEvents() {
+    while (!queue.empty() && queue.front().timestamp <= timestamp) {
+        const Event event = queue.front();
+        std::pop_heap(queue.begin(), queue.end(), LaterEvent);
+        queue.pop_back();
+
+        // The handler may schedule new events, including another of the same type.
+        handlers[static_cast<std::size_t>(event.type)](static_cast<int>(timestamp - event.timestamp));
+    }
+}
+
+void Scheduler::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("SCHD", 1);
+    state.Sync(timestamp);
+
+    // The queue is saved in heap order, so it doesn't need to be rebuilt after loading.
+    u32 num_events = queue.size();
+    state.Sync(num_events);
+    if (state.Loading()) {
+        if (num_events > static_cast<u32>(EventType::NumEvents)) {
+            throw std::runtime_error("Save state has too many scheduled events.");
+        }
+
+        queue.resize(num_events);
+    }
+
+    for (auto& event : queue) {
+        state.Sync(event.timestamp);
+        state.Sync(event.type);
+
+        if (state.Loading() && event.type >= EventType::NumEvents) {
+            throw std::runtime_error("Save state has an invalid scheduled event.");
+        }
+    }
+    state.EndChunk();
+}
+
+} // End namespace Gba
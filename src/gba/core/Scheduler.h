@@ -0,0 +1,92 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <functional>
+
+#include "common/CommonTypes.h"
+
+namespace Common { class StateBuffer; }
+
+namespace Gba {
+
+enum class EventType {HBlank,
+                      HBlankFlag,
+                      NextLine,
+                      SaveOp,
+                      SaveFlush,
+                      AudioFrame,
+                      Timer0Overflow,
+                      Timer1Overflow,
+                      Timer2Overflow,
+                      Timer3Overflow,
+                      SerialTransfer,
+                      SerialPoll,
+                      NumEvents};
+
+// A min-heap of timestamped hardware events. The CPU runs freely until the next deadline, at which point every
+// event that has come due is run in timestamp order.
+class Scheduler {
+public:
+    // Handlers are passed the number of cycles by which the event was late, so they can schedule their next
+    // event relative to when this one was supposed to happen.
+    using Handler = std::function<void(int cycles_late)>;
+
+    u64 Timestamp() const { return timestamp; }
+
+    void RegisterHandler(EventType type, Handler handler) { handlers[static_cast<std::size_t>(type)] = handler; }
+
+    // Scheduling an event which is already pending replaces it.
+    void Schedule(EventType type, int cycles);
+    void Deschedule(EventType type);
+    bool Scheduled(EventType type) const;
+
+    int CyclesUntilNextEvent() const {
+        return (queue.empty()) ? max_cycles : static_cast<int>(queue.front().timestamp - timestamp);
+    }
+
+    void Advance(int cycles) {
+        timestamp += cycles;
+
+        if (!queue.empty() && queue.front().timestamp <= timestamp) {
+            RunEvents();
+        }
+    }
+
+    void Serialize(Common::StateBuffer& state);
+
+private:
+    struct Event {
+        u64 timestamp;
+        EventType type;
+    };
+
+    static constexpr int max_cycles = 0x7FFF'FFFF;
+
+    u64 timestamp = 0;
+    std::vector<Event> queue;
+    std::array<Handler, static_cast<std::size_t>(EventType::NumEvents)> handlers;
+
+    void RunEvents();
+
+    // std::push_heap and friends build a max-heap, so compare in reverse to keep the earliest event at the front.
+    static bool LaterEvent(const Event& event1, const Event& event2) { return event1.timestamp > event2.timestamp; }
+};
+
+} // End namespace Gba
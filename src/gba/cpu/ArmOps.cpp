@@ -55,9 +55,7 @@ int Cpu::Arm_ArithReg(Condition cond, bool set_flags, Reg n, Reg d, u32 imm, Shi
         return 0;
     }
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    u32 shifted_reg = Shift(regs[m], shift.type, shift.imm);
+    u32 shifted_reg = ShiftImm(regs[m], type, imm);
     ArithResult result = op(regs[n], shifted_reg, carry);
 
     if (d == pc) {
@@ -115,9 +113,7 @@ int Cpu::Arm_CompareReg(Condition cond, Reg n, u32 imm, ShiftType type, Reg m, A
         return 0;
     }
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    u32 shifted_reg = Shift(regs[m], shift.type, shift.imm);
+    u32 shifted_reg = ShiftImm(regs[m], type, imm);
     ArithResult result = op(regs[n], shifted_reg, carry);
 
     SetAllFlags(result);
@@ -232,9 +228,7 @@ int Cpu::Arm_LogicReg(Condition cond, bool set_flags, Reg n, Reg d, u32 imm, Shi
         return 0;
     }
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    ResultWithCarry shifted_reg = Shift_C(regs[m], shift.type, shift.imm);
+    ResultWithCarry shifted_reg = ShiftImm_C(regs[m], type, imm);
     u32 result = op(regs[n], shifted_reg.result);
 
     if (d == pc) {
@@ -288,9 +282,7 @@ int Cpu::Arm_TestReg(Condition cond, Reg n, u32 imm, ShiftType type, Reg m, Logi
         return 0;
     }
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    ResultWithCarry shifted_reg = Shift_C(regs[m], shift.type, shift.imm);
+    ResultWithCarry shifted_reg = ShiftImm_C(regs[m], type, imm);
     u32 result = op(regs[n], shifted_reg.result);
 
     SetSignZeroCarryFlags(result, shifted_reg.carry);
@@ -324,9 +316,7 @@ int Cpu::Arm_ShiftImm(Condition cond, bool set_flags, Reg d, u32 imm, Reg m, Shi
         return 0;
     }
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    ResultWithCarry shifted_reg = Shift_C(regs[m], shift.type, shift.imm);
+    ResultWithCarry shifted_reg = ShiftImm_C(regs[m], type, imm);
 
     if (d == pc) {
         return AluWritePC(set_flags, shifted_reg.result);
@@ -404,9 +394,7 @@ int Cpu::Arm_LoadReg(Condition cond, bool pre_indexed, bool add, bool writeback,
     assert(t != pc); // Unpredictable
     assert(!(writeback && (n == pc))); // Unpredictable
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    u32 offset = Shift(regs[m], shift.type, shift.imm);
+    u32 offset = ShiftImm(regs[m], type, imm);
 
     if (!add) {
         offset = -offset;
@@ -473,9 +461,7 @@ int Cpu::Arm_StoreReg(Condition cond, bool pre_indexed, bool add, bool writeback
     assert(!(writeback && (n == pc))); // Unpredictable
     assert(!(writeback && (n == t))); // Unpredictable
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    u32 offset = Shift(regs[m], shift.type, shift.imm);
+    u32 offset = ShiftImm(regs[m], type, imm);
 
     if (!add) {
         offset = -offset;
@@ -529,6 +515,7 @@ int Cpu::Arm_WriteStatusReg(Condition cond, bool write_spsr, u32 mask, u32 value
 
         // The thumb bit is masked out when writing the CPSR.
         psr_mask &= ~thumb_mode;
+        MaterializeFlags();
         cpsr = (value & psr_mask) | (cpsr & ~psr_mask);
     }
 
@@ -873,13 +860,10 @@ int Cpu::Arm_Ldm(Condition cond, bool pre_indexed, bool increment, bool exceptio
     // One internal cycle to transfer the last loaded value to the destination register.
     int cycles = 1;
 
-    for (Reg i = 0; i < 15; ++i) {
-        if (rlist[i]) {
-            // Reads must be aligned.
-            regs[i] = mem.ReadMem<u32>(addr);
-            cycles += mem.AccessTime<u32>(addr);
-            addr += 4;
-        }
+    const u32 non_pc_regs = reg_list & 0x7FFF;
+    if (non_pc_regs != 0) {
+        cycles += LoadRegisterBlock(addr, non_pc_regs);
+        addr += 4 * Popcount(non_pc_regs);
     }
 
     if (load_user_regs) {
@@ -947,9 +931,7 @@ int Cpu::Arm_LdrReg(Condition cond, bool pre_indexed, bool add, bool writeback,
     assert(m != pc); // Unpredictable
     assert(!(writeback && (n == pc))); // Unpredictable
 
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    u32 offset = Shift(regs[m], shift.type, shift.imm);
+    u32 offset = ShiftImm(regs[m], type, imm);
 
     if (!add) {
         offset = -offset;
@@ -1137,22 +1119,16 @@ int Cpu::Arm_Stm(Condition cond, bool pre_indexed, bool increment, bool store_us
     regs[pc] += 4;
     pc_written = true;
 
-    int cycles = 0;
-    for (Reg i = 0; i < 16; ++i) {
-        if (rlist[i]) {
-            // Writes are always aligned.
-            if (i == n && writeback && n != LowestSetBit(reg_list)) {
-                // Store the new Rn value if it's not the first register in the list.
-                // Writeback isn't allowed when storing user regs, so we don't have to worry about that.
-                mem.WriteMem(addr, static_cast<u32>(regs[n] + offset));
-            } else {
-                mem.WriteMem(addr, regs[i]);
-            }
-            cycles += mem.AccessTime<u32>(addr);
-            addr += 4;
-        }
+    std::array<u32, 16> values;
+    std::copy(regs.begin(), regs.end(), values.begin());
+    if (rlist[n] && writeback && n != LowestSetBit(reg_list)) {
+        // Store the new Rn value if it's not the first register in the list.
+        // Writeback isn't allowed when storing user regs, so we don't have to worry about that.
+        values[n] = regs[n] + offset;
     }
 
+    const int cycles = StoreRegisterBlock(addr, reg_list, values);
+
     if (store_user_regs) {
         CpuModeSwitch(current_cpu_mode);
     }
@@ -1303,6 +1279,7 @@ int Cpu::Arm_Mrs(Condition cond, bool read_spsr, Reg d) {
         regs[d] = spsr[CurrentCpuModeIndex()];
     } else {
         // The CPSR is read with the thumb bit masked out.
+        MaterializeFlags();
         regs[d] = cpsr & ~thumb_mode;
     }
 
@@ -1317,11 +1294,19 @@ int Cpu::Arm_MsrReg(Condition cond, bool write_spsr, u32 mask, Reg n) {
     return Arm_WriteStatusReg(cond, write_spsr, mask, regs[n]);
 }
 
-int Cpu::Arm_Swi(Condition cond, u32) {
+int Cpu::Arm_Swi(Condition cond, u32 imm) {
     if (!ConditionPassed(cond)) {
         return 0;
     }
 
+    if (hle_bios) {
+        // In ARM state, the BIOS takes the call number from bits 16-23 of the comment field.
+        const int cycles = HleSwi((imm >> 16) & 0xFF);
+        if (cycles >= 0) {
+            return cycles;
+        }
+    }
+
     return TakeException(CpuMode::Svc);
 }
 
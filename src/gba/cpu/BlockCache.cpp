@@ -0,0 +1,119 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "gba/cpu/BlockCache.h"
+
+namespace Gba {
+
+bool BlockCache::Cacheable(u32 addr) {
+    // The BIOS can only be read while executing from it, and the EEPROM region has read side effects.
+    switch (addr >> 24) {
+    case 0x2:
+    case 0x3:
+    case 0x8:
+    case 0x9:
+    case 0xA:
+    case 0xB:
+    case 0xC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+template<typename T>
+std::size_t BlockCache::MaxInstructions(u32 addr) {
+    const std::size_t page_instrs = (page_size - (addr & (page_size - 1))) / sizeof(T);
+    return std::min(page_instrs, max_block_size);
+}
+
+template std::size_t BlockCache::MaxInstructions<Thumb>(u32 addr);
+template std::size_t BlockCache::MaxInstructions<Arm>(u32 addr);
+
+std::size_t BlockCache::PageIndex(u32 addr) {
+    // ROM is never written, so it doesn't need to be tracked.
+    switch (addr >> 24) {
+    case 0x2:
+        return (addr & 0x3'FFFF) / page_size;
+    case 0x3:
+        return xram_pages + (addr & 0x7FFF) / page_size;
+    default:
+        return no_page;
+    }
+}
+
+void BlockCache::InvalidatePage(std::size_t page) {
+    // Blocks from this page are removed lazily, the next time they're looked up.
+    page_gens[page] += 1;
+    page_has_code[page] = false;
+    invalidated = true;
+}
+
+template<>
+std::unordered_map<u32, BlockCache::Block<Thumb>>& BlockCache::Blocks() { return thumb_blocks; }
+template<>
+std::unordered_map<u32, BlockCache::Block<Arm>>& BlockCache::Blocks() { return arm_blocks; }
+template<>
+const std::unordered_map<u32, BlockCache::Block<Thumb>>& BlockCache::Blocks() const { return thumb_blocks; }
+template<>
+const std::unordered_map<u32, BlockCache::Block<Arm>>& BlockCache::Blocks() const { return arm_blocks; }
+
+template<typename T>
+const BlockCache::Block<T>* BlockCache::Find(u32 addr) const {
+    const auto& blocks = Blocks<T>();
+    const auto itr = blocks.find(addr);
+    if (itr == blocks.cend()) {
+        return nullptr;
+    }
+
+    const Block<T>& block = itr->second;
+    for (std::size_t i = 0; i < block.pages.size(); ++i) {
+        if (block.pages[i] != no_page && block.page_gens[i] != page_gens[block.pages[i]]) {
+            // This block was decoded before its page was last written to.
+            return nullptr;
+        }
+    }
+
+    return &block;
+}
+
+template const BlockCache::Block<Thumb>* BlockCache::Find<Thumb>(u32 addr) const;
+template const BlockCache::Block<Arm>* BlockCache::Find<Arm>(u32 addr) const;
+
+template<typename T>
+const BlockCache::Block<T>& BlockCache::Insert(u32 addr, Block<T>&& block) {
+    // The last two opcodes are only used to fill the pipeline, but they can still end up in the next page.
+    block.pages = {{PageIndex(addr), PageIndex(addr + (block.opcodes.size() - 1) * sizeof(T))}};
+
+    for (std::size_t i = 0; i < block.pages.size(); ++i) {
+        if (block.pages[i] != no_page) {
+            block.page_gens[i] = page_gens[block.pages[i]];
+            page_has_code[block.pages[i]] = true;
+        }
+    }
+
+    // Replacing a stale block is safe, as blocks are never looked up while one is executing.
+    auto& slot = Blocks<T>()[addr];
+    slot = std::move(block);
+    return slot;
+}
+
+template const BlockCache::Block<Thumb>& BlockCache::Insert<Thumb>(u32 addr, Block<Thumb>&& block);
+template const BlockCache::Block<Arm>& BlockCache::Insert<Arm>(u32 addr, Block<Arm>&& block);
+
+} // End namespace Gba
@@ -0,0 +1,94 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+#include "common/CommonTypes.h"
+
+namespace Gba {
+
+template<typename T>
+class Instruction;
+
+// Caches straight-line runs of pre-decoded opcodes from ROM, EWRAM, and IWRAM. Writes to EWRAM and IWRAM
+// invalidate every block which was decoded from the written page.
+class BlockCache {
+public:
+    static constexpr std::size_t max_block_size = 32;
+    static constexpr u32 page_size = 0x100;
+
+    template<typename T>
+    struct Block {
+        // Holds two more opcodes than instructions, to fill the pipeline while executing the last instruction.
+        std::vector<T> opcodes;
+        std::vector<const Instruction<T>*> instrs;
+
+        std::array<std::size_t, 2> pages;
+        std::array<u32, 2> page_gens;
+    };
+
+    // Set whenever a write invalidates a page, so the CPU can stop executing a block that may have been modified.
+    bool invalidated = false;
+
+    static bool Cacheable(u32 addr);
+    // The number of instructions which can be decoded starting at addr without leaving its page.
+    template<typename T>
+    static std::size_t MaxInstructions(u32 addr);
+
+    template<typename T>
+    const Block<T>* Find(u32 addr) const;
+    template<typename T>
+    const Block<T>& Insert(u32 addr, Block<T>&& block);
+
+    void InvalidateWrite(u32 addr) {
+        const std::size_t page = PageIndex(addr);
+        if (page != no_page && page_has_code[page]) {
+            InvalidatePage(page);
+        }
+    }
+
+    // Drops every block decoded from EWRAM or IWRAM, after both have been overwritten by loading a save state.
+    void InvalidateRam() {
+        for (std::size_t page = 0; page < page_has_code.size(); ++page) {
+            InvalidatePage(page);
+        }
+    }
+
+private:
+    static constexpr std::size_t no_page = ~static_cast<std::size_t>(0);
+    static constexpr std::size_t xram_pages = 0x40000 / page_size;
+    static constexpr std::size_t iram_pages = 0x8000 / page_size;
+
+    std::unordered_map<u32, Block<Thumb>> thumb_blocks;
+    std::unordered_map<u32, Block<Arm>> arm_blocks;
+
+    std::array<bool, xram_pages + iram_pages> page_has_code{};
+    std::array<u32, xram_pages + iram_pages> page_gens{};
+
+    static std::size_t PageIndex(u32 addr);
+    void InvalidatePage(std::size_t page);
+
+    template<typename T>
+    std::unordered_map<u32, Block<T>>& Blocks();
+    template<typename T>
+    const std::unordered_map<u32, Block<T>>& Blocks() const;
+};
+
+} // End namespace Gba
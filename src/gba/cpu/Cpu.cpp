@@ -20,25 +20,88 @@
 #include "gba/cpu/Cpu.h"
 #include "gba/cpu/Instruction.h"
 #include "gba/cpu/Disassembler.h"
+#include "gba/cpu/BlockCache.h"
 #include "gba/core/Core.h"
+#include "gba/core/Scheduler.h"
 #include "gba/memory/Memory.h"
 #include "gba/hardware/Dma.h"
+#include "gba/hardware/Timer.h"
+#include "common/StateBuffer.h"
+#include "common/Profiler.h"
 
 namespace Gba {
 
-Cpu::Cpu(Memory& _mem, Core& _core)
-        : mem(_mem)
-        , core(_core)
-        , thumb_instructions(Instruction<Thumb>::GetInstructionTable<Cpu>())
-        , arm_instructions(Instruction<Arm>::GetInstructionTable<Cpu>()) {
+namespace {
+
+// Returns a mask with bit n set if the condition passes when the NZCV flags are n.
+constexpr u16 ConditionMask(Condition cond) {
+    u16 mask = 0;
+    for (u32 nzcv = 0; nzcv < 16; ++nzcv) {
+        const bool n = nzcv & 0x8;
+        const bool z = nzcv & 0x4;
+        const bool c = nzcv & 0x2;
+        const bool v = nzcv & 0x1;
+
+        bool passed = true;
+        switch (cond) {
+        case Condition::Equal:         passed = z; break;
+        case Condition::NotEqual:      passed = !z; break;
+        case Condition::CarrySet:      passed = c; break;
+        case Condition::CarryClear:    passed = !c; break;
+        case Condition::Minus:         passed = n; break;
+        case Condition::Plus:          passed = !n; break;
+        case Condition::OverflowSet:   passed = v; break;
+        case Condition::OverflowClear: passed = !v; break;
+        case Condition::Higher:        passed = c && !z; break;
+        case Condition::LowerSame:     passed = !(c && !z); break;
+        case Condition::GreaterEqual:  passed = n == v; break;
+        case Condition::LessThan:      passed = n != v; break;
+        case Condition::GreaterThan:   passed = n == v && !z; break;
+        case Condition::LessEqual:     passed = !(n == v && !z); break;
+        default:                       passed = true; break;
+        }
+
+        mask |= static_cast<u16>(passed) << nzcv;
+    }
 
-    PopulateThumbDecodeTable();
+    return mask;
 }
 
+// Indexed by the condition field, then shifted by the NZCV nibble of the cpsr. Condition 0xF always passes.
+constexpr std::array<u16, 16> condition_table{{
+    ConditionMask(static_cast<Condition>(0x0)), ConditionMask(static_cast<Condition>(0x1)),
+    ConditionMask(static_cast<Condition>(0x2)), ConditionMask(static_cast<Condition>(0x3)),
+    ConditionMask(static_cast<Condition>(0x4)), ConditionMask(static_cast<Condition>(0x5)),
+    ConditionMask(static_cast<Condition>(0x6)), ConditionMask(static_cast<Condition>(0x7)),
+    ConditionMask(static_cast<Condition>(0x8)), ConditionMask(static_cast<Condition>(0x9)),
+    ConditionMask(static_cast<Condition>(0xA)), ConditionMask(static_cast<Condition>(0xB)),
+    ConditionMask(static_cast<Condition>(0xC)), ConditionMask(static_cast<Condition>(0xD)),
+    ConditionMask(static_cast<Condition>(0xE)), ConditionMask(static_cast<Condition>(0xF)),
+}};
+
+} // End anonymous namespace
+
+Cpu::Cpu(Memory& _mem, Core& _core, bool enable_block_cache, bool enable_idle_skip)
+        : block_cache((enable_block_cache) ? std::make_unique<BlockCache>() : nullptr)
+        , mem(_mem)
+        , core(_core)
+        , decode_tables(SharedDecodeTables())
+        , idle_skip(enable_idle_skip) {}
+
 // Needed to declare std::vector with forward-declared type in the header file.
 Cpu::~Cpu() = default;
 
 int Cpu::Execute(int cycles) {
+    // The log level only changes between frames, so pick the loop once per call. The non-tracing loop has every
+    // disassembler and profiler call compiled out.
+    const int overspent_cycles = (core.disasm->Enabled() || core.profiler) ? ExecuteLoop<true>(cycles)
+                                                                           : ExecuteLoop<false>(cycles);
+    counters.cycles += cycles - overspent_cycles;
+    return overspent_cycles;
+}
+
+template<bool tracing>
+int Cpu::ExecuteLoop(int cycles) {
     while (cycles > 0) {
         int cycles_taken = 0;
 
@@ -60,10 +123,17 @@ int Cpu::Execute(int cycles) {
         if (mem.PendingInterrupts()) {
             if (halted) {
                 halted = false;
-                core.disasm->LogHalt();
+                if (tracing) {
+                    core.disasm->LogHalt();
+                }
             }
 
             if (InterruptsEnabled()) {
+                if (tracing && core.profiler) {
+                    // The handler returns to the instruction which was about to execute.
+                    core.profiler->Call(regs[pc] - ((ThumbMode()) ? 4 : 8));
+                }
+                idle_snapshot_valid = false;
                 cycles_taken += TakeException(CpuMode::Irq);
             }
         }
@@ -71,25 +141,58 @@ int Cpu::Execute(int cycles) {
         if (halted) {
             const int halt_cycles = core.HaltCycles(cycles);
             core.UpdateHardware(halt_cycles);
-            core.disasm->IncHaltCycles(halt_cycles);
+            counters.halted_cycles += halt_cycles;
+            if (tracing) {
+                core.disasm->IncHaltCycles(halt_cycles);
+                if (core.profiler) {
+                    core.profiler->Halt(halt_cycles);
+                }
+            }
             cycles -= halt_cycles;
             continue;
         }
 
-        if (ThumbMode()) {
+        if (block_cache) {
+            const u32 instr_addr = regs[pc] - ((ThumbMode()) ? 4 : 8);
+            if (BlockCache::Cacheable(instr_addr) && !mem.ExecBreakpointPage(instr_addr)) {
+                // Hardware only gets synced once the whole block has run.
+                cycles_taken += (ThumbMode()) ? ExecuteBlock<Thumb, tracing>()
+                                               : ExecuteBlock<Arm, tracing>();
+                core.UpdateHardware(cycles_taken);
+                cycles -= cycles_taken;
+
+                if (idle_loop_found) {
+                    idle_loop_found = false;
+                    cycles -= SkipIdleLoop(cycles);
+                }
+                continue;
+            }
+        }
+
+        const bool thumb_instr = ThumbMode();
+        u32 instr_addr;
+        if (thumb_instr) {
             pipeline[0] = pipeline[1];
             pipeline[1] = pipeline[2];
-            pipeline[2] = mem.ReadMem<Thumb>(regs[pc]);
-            cycles_taken += mem.AccessTime<Thumb>(regs[pc], AccessType::Opcode);
+            pipeline[2] = mem.FetchOpcode<Thumb>(regs[pc], cycles_taken);
 
             // Sync hardware after the prefetch.
             core.UpdateHardware(cycles_taken);
             cycles -= cycles_taken;
+            const int fetch_cycles = cycles_taken;
             cycles_taken = 0;
 
-            core.disasm->DisassembleThumb(pipeline[0], regs, cpsr);
-            const auto& impl = DecodeThumb(pipeline[0]);
-            cycles_taken += impl(*this, pipeline[0]);
+            instr_addr = regs[pc] - 4;
+            if (tracing) {
+                MaterializeFlags();
+                core.disasm->DisassembleThumb(pipeline[0], regs, cpsr);
+            }
+            cycles_taken += DecodeThumb(pipeline[0]).Execute(*this, pipeline[0]);
+            ++counters.instructions;
+
+            if (tracing && core.profiler) {
+                Profile(pipeline[0], instr_addr, fetch_cycles + cycles_taken);
+            }
 
             if (!pc_written) {
                 // Only increment the PC if the executing instruction didn't change it.
@@ -98,17 +201,25 @@ int Cpu::Execute(int cycles) {
         } else {
             pipeline[0] = pipeline[1];
             pipeline[1] = pipeline[2];
-            pipeline[2] = mem.ReadMem<Arm>(regs[pc]);
-            cycles_taken += mem.AccessTime<Arm>(regs[pc], AccessType::Opcode);
+            pipeline[2] = mem.FetchOpcode<Arm>(regs[pc], cycles_taken);
 
             // Sync hardware after the prefetch.
             core.UpdateHardware(cycles_taken);
             cycles -= cycles_taken;
+            const int fetch_cycles = cycles_taken;
             cycles_taken = 0;
 
-            core.disasm->DisassembleArm(pipeline[0], regs, cpsr);
-            const auto& impl = DecodeArm(pipeline[0]);
-            cycles_taken += impl(*this, pipeline[0]);
+            instr_addr = regs[pc] - 8;
+            if (tracing) {
+                MaterializeFlags();
+                core.disasm->DisassembleArm(pipeline[0], regs, cpsr);
+            }
+            cycles_taken += DecodeArm(pipeline[0]).Execute(*this, pipeline[0]);
+            ++counters.instructions;
+
+            if (tracing && core.profiler) {
+                Profile(pipeline[0], instr_addr, fetch_cycles + cycles_taken);
+            }
 
             if (!pc_written) {
                 // Only increment the PC if the executing instruction didn't change it.
@@ -120,6 +231,12 @@ int Cpu::Execute(int cycles) {
         core.UpdateHardware(cycles_taken);
         cycles -= cycles_taken;
 
+        if (idle_skip && pc_written && thumb_instr == ThumbMode()) {
+            if ((thumb_instr) ? IdleLoop<Thumb>(instr_addr) : IdleLoop<Arm>(instr_addr)) {
+                cycles -= SkipIdleLoop(cycles);
+            }
+        }
+
         pc_written = false;
     }
 
@@ -127,32 +244,326 @@ int Cpu::Execute(int cycles) {
     return cycles;
 }
 
-void Cpu::PopulateThumbDecodeTable() {
+template<typename T, bool tracing>
+int Cpu::ExecuteBlock() {
+    const u32 block_addr = regs[pc] - 2 * sizeof(T);
+
+    const BlockCache::Block<T>* block = block_cache->Find<T>(block_addr);
+    if (block == nullptr) {
+        BlockCache::Block<T> new_block;
+        const std::size_t num_instrs = BlockCache::MaxInstructions<T>(block_addr);
+
+        for (std::size_t i = 0; i < num_instrs + 2; ++i) {
+            new_block.opcodes.push_back(mem.ReadMem<T>(block_addr + i * sizeof(T)));
+        }
+
+        for (std::size_t i = 0; i < num_instrs; ++i) {
+            new_block.instrs.push_back(&Decode(new_block.opcodes[i]));
+        }
+
+        block = &block_cache->Insert(block_addr, std::move(new_block));
+    }
+
+    block_cache->invalidated = false;
+
+    int cycles_taken = 0;
+    for (std::size_t i = 0; i < block->instrs.size(); ++i) {
+        pipeline[0] = block->opcodes[i];
+        pipeline[1] = block->opcodes[i + 1];
+        pipeline[2] = block->opcodes[i + 2];
+        const int instr_start_cycles = cycles_taken;
+        cycles_taken += mem.AccessTime<T>(regs[pc], AccessType::Opcode);
+
+        if (tracing) {
+            Disassemble(block->opcodes[i]);
+        }
+        cycles_taken += block->instrs[i]->Execute(*this, block->opcodes[i]);
+        ++counters.instructions;
+
+        if (tracing && core.profiler) {
+            Profile(block->opcodes[i], block_addr + i * sizeof(T), cycles_taken - instr_start_cycles);
+        }
+
+        if (pc_written) {
+            if (idle_skip && ThumbMode() == std::is_same<T, Thumb>::value) {
+                idle_loop_found = IdleLoop<T>(block_addr + i * sizeof(T));
+            }
+
+            pc_written = false;
+            break;
+        }
+
+        regs[pc] += sizeof(T);
+
+        // Leave the block early if the rest of it may no longer be valid, or if something needs to interrupt it.
+        if (block_cache->invalidated || dma_active || halted || (mem.PendingInterrupts() && InterruptsEnabled())) {
+            break;
+        }
+    }
+
+    return cycles_taken;
+}
+
+template<typename T>
+bool Cpu::IdleLoop(u32 branch_addr) {
+    MaterializeFlags();
+    const u32 target = regs[pc] - 2 * sizeof(T);
+
+    if (branch_addr == idle_branch_addr) {
+        if (idle_body_ok && idle_snapshot_valid && !idle_reads_overflow && regs == idle_regs && cpsr == idle_cpsr
+                && core.scheduler->Timestamp() < idle_deadline) {
+            return true;
+        }
+    } else if (idle_snapshot_valid && branch_addr >= idle_loop_start && branch_addr < idle_branch_addr
+                                   && target >= idle_loop_start && target <= idle_branch_addr) {
+        // A branch within the body of the loop being watched.
+        return false;
+    } else if (target <= branch_addr && branch_addr - target <= max_idle_loop_bytes) {
+        idle_branch_addr = branch_addr;
+        idle_loop_start = target;
+        idle_body_ok = IdleLoopBody<T>(target, branch_addr);
+    } else {
+        // Left the loop being watched.
+        idle_snapshot_valid = false;
+        return false;
+    }
+
+    // Take a snapshot to compare against at the end of the next iteration.
+    idle_snapshot_valid = idle_body_ok;
+    idle_regs = regs;
+    idle_cpsr = cpsr;
+    idle_snapshot_time = core.scheduler->Timestamp();
+    num_idle_reads = 0;
+    idle_reads_overflow = false;
+    // The timestamp at which the next event will run, whether from the scheduler or a timer interrupt.
+    idle_deadline = core.scheduler->Timestamp() + core.HaltCycles(max_idle_deadline) - 1;
+
+    return false;
+}
+
+template<typename T>
+bool Cpu::IdleLoopBody(u32 start_addr, u32 branch_addr) const {
+    for (u32 addr = start_addr; addr <= branch_addr; addr += sizeof(T)) {
+        if (!IdleLoopInstruction(mem.ReadMem<T>(addr))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Cpu::IdleLoopInstruction(Thumb opcode) {
+    // Loads, branches, and anything which writes the low registers or flags are allowed. Stores, PC writes,
+    // stack operations, mode changes and SWIs are not.
+    if (opcode < 0x4400) {
+        // Shifts, add/subtract, move/compare/add/subtract immediate, and ALU operations.
+        return true;
+    } else if ((opcode & 0xF800) == 0x4800) {
+        // PC-relative load.
+        return true;
+    } else if (opcode >= 0x5000 && opcode < 0x6000) {
+        // Register offset loads.
+        const u16 op = opcode & 0xFE00;
+        return op == 0x5600 || op == 0x5800 || op == 0x5A00 || op == 0x5C00 || op == 0x5E00;
+    } else if (opcode >= 0x6000 && opcode < 0xA000) {
+        // Immediate offset and SP-relative loads.
+        return opcode & 0x0800;
+    } else if (opcode >= 0xA000 && opcode < 0xB000) {
+        // Load address.
+        return true;
+    } else if ((opcode & 0xFF00) == 0xB000) {
+        // Add offset to SP.
+        return true;
+    } else if (opcode >= 0xD000 && opcode < 0xDE00) {
+        // Conditional branch.
+        return true;
+    } else if ((opcode & 0xF800) == 0xE000) {
+        // Unconditional branch.
+        return true;
+    }
+
+    return false;
+}
+
+bool Cpu::IdleLoopInstruction(Arm opcode) {
+    const u32 rd = (opcode >> 12) & 0xF;
+
+    switch ((opcode >> 25) & 0x7) {
+    case 0b000:
+        if ((opcode & 0x90) == 0x90) {
+            // Multiplies, swaps and halfword transfers. Only halfword and signed loads are allowed.
+            return (opcode & 0x0010'0090) == 0x0010'0090 && (opcode & 0x60) != 0 && rd != pc;
+        }
+        // Fall through.
+    case 0b001:
+        // TST, TEQ, CMP and CMN without the S bit are MRS, MSR and BX.
+        return (opcode & 0x0190'0000) != 0x0100'0000 && rd != pc;
+    case 0b010:
+        return (opcode & 0x0010'0000) && rd != pc;
+    case 0b011:
+        // Register offset loads. Bit 4 set is undefined.
+        return (opcode & 0x0010'0000) && !(opcode & 0x10) && rd != pc;
+    case 0b101:
+        // Branches without link.
+        return !(opcode & 0x0100'0000);
+    default:
+        return false;
+    }
+}
+
+void Cpu::RecordTimerRead(int timer, u16 value) {
+    if (!idle_snapshot_valid) {
+        return;
+    }
+
+    // Only the first value read from each counter is kept, as that's the one the snapshot depends on.
+    for (std::size_t i = 0; i < num_idle_reads; ++i) {
+        if (idle_reads[i].timer == timer) {
+            return;
+        }
+    }
+
+    if (num_idle_reads == max_idle_reads) {
+        idle_reads_overflow = true;
+        return;
+    }
+
+    idle_reads[num_idle_reads++] = {timer, value};
+}
+
+bool Cpu::IdleReadsUnchanged() const {
+    for (std::size_t i = 0; i < num_idle_reads; ++i) {
+        if (core.timers[idle_reads[i].timer].ReadCounter() != idle_reads[i].value) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int Cpu::SkipIdleLoop(int remaining_cycles) {
+    int idle_cycles = 0;
+    if (num_idle_reads == 0) {
+        idle_cycles = core.HaltCycles(remaining_cycles);
+        core.UpdateHardware(idle_cycles);
+    } else {
+        // Run the hardware one iteration at a time, so the loop sees the timer tick it polls for at most one
+        // iteration late. Stop once the next event has run, as anything else the loop reads may have changed.
+        const int iteration_cycles = std::max(1, static_cast<int>(core.scheduler->Timestamp() - idle_snapshot_time));
+        while (IdleReadsUnchanged()) {
+            const int event_cycles = core.HaltCycles(remaining_cycles - idle_cycles);
+            const int step_cycles = std::min(iteration_cycles, event_cycles);
+            core.UpdateHardware(step_cycles);
+            idle_cycles += step_cycles;
+            if (step_cycles == event_cycles) {
+                break;
+            }
+        }
+    }
+
+    counters.halted_cycles += idle_cycles;
+    return idle_cycles;
+}
+
+void Cpu::Profile(Thumb opcode, u32 addr, int cycles) {
+    core.profiler->Run(addr, cycles);
+
+    // The second half of a BL.
+    if ((opcode & 0xF800) == 0xF800) {
+        core.profiler->Call(addr + 2);
+    }
+}
+
+void Cpu::Profile(Arm opcode, u32 addr, int cycles) {
+    core.profiler->Run(addr, cycles);
+
+    // A BL whose condition passed.
+    if ((opcode & 0x0F00'0000) == 0x0B00'0000 && (opcode >> 28) != 0xF && pc_written) {
+        core.profiler->Call(addr + 4);
+    }
+}
+
+void Cpu::Disassemble(Thumb opcode) {
+    MaterializeFlags();
+    core.disasm->DisassembleThumb(opcode, regs, cpsr);
+}
+
+void Cpu::Disassemble(Arm opcode) {
+    MaterializeFlags();
+    core.disasm->DisassembleArm(opcode, regs, cpsr);
+}
+
+struct Cpu::DecodeTables {
+    DecodeTables();
+
+    const std::vector<Instruction<Thumb>>& thumb_instructions;
+    const std::vector<Instruction<Arm>>& arm_instructions;
+
+    std::array<const Instruction<Thumb>*, 0x400> thumb_decode_table;
+
+    // Each ARM slot is a run of arm_candidates, given as its first index and its length.
+    std::vector<const Instruction<Arm>*> arm_candidates;
+    std::array<std::pair<u16, u16>, 0x1000> arm_decode_table;
+};
+
+Cpu::DecodeTables::DecodeTables()
+        : thumb_instructions(Instruction<Thumb>::SharedInstructionTable<Cpu>())
+        , arm_instructions(Instruction<Arm>::SharedInstructionTable<Cpu>()) {
     // The lower 6 bits of all Thumb opcodes are variable, so we only need to use the top 10 bits to identify
     // which instruction implementation to use.
     for (u16 opcode = 0; opcode < 0x400; ++opcode) {
         for (const auto& instr : thumb_instructions) {
             if (instr.Match(opcode << 6)) {
-                thumb_decode_table[opcode] = &instr.impl_func;
+                thumb_decode_table[opcode] = &instr;
                 break;
             }
         }
     }
+
+    // Bits 27-20 and 7-4 are enough to identify almost every ARM instruction. The few which also have fixed bits
+    // elsewhere (BX, MRS, MUL, etc.) share a slot with the more general instructions they would otherwise match,
+    // so each slot holds the candidates in match order, ending with the first one guaranteed to match.
+    constexpr Arm decode_bits = 0x0FF0'00F0;
+
+    for (u32 index = 0; index < 0x1000; ++index) {
+        const Arm opcode = ((index & 0xFF0) << 16) | ((index & 0xF) << 4);
+        const std::size_t first = arm_candidates.size();
+
+        for (const auto& instr : arm_instructions) {
+            if (instr.PartialMatch(opcode, decode_bits)) {
+                arm_candidates.push_back(&instr);
+
+                if (instr.FixedBitsWithin(decode_bits)) {
+                    break;
+                }
+            }
+        }
+
+        arm_decode_table[index] = {static_cast<u16>(first), static_cast<u16>(arm_candidates.size() - first)};
+    }
+}
+
+const Cpu::DecodeTables& Cpu::SharedDecodeTables() {
+    static const DecodeTables tables;
+    return tables;
 }
 
-const std::function<int(Cpu& cpu, Thumb opcode)>& Cpu::DecodeThumb(Thumb opcode) const {
-    return *thumb_decode_table[opcode >> 6];
+const Instruction<Thumb>& Cpu::DecodeThumb(Thumb opcode) const {
+    return *decode_tables.thumb_decode_table[opcode >> 6];
 }
 
-const std::function<int(Cpu& cpu, Arm opcode)>& Cpu::DecodeArm(Arm opcode) const {
-    for (const auto& instr : arm_instructions) {
-        if (instr.Match(opcode)) {
-            return instr.impl_func;
+const Instruction<Arm>& Cpu::DecodeArm(Arm opcode) const {
+    const auto slot = decode_tables.arm_decode_table[((opcode >> 16) & 0xFF0) | ((opcode >> 4) & 0xF)];
+    const Instruction<Arm>* const* candidates = &decode_tables.arm_candidates[slot.first];
+
+    for (int i = 0; i < slot.second - 1; ++i) {
+        if (candidates[i]->Match(opcode)) {
+            return *candidates[i];
         }
     }
 
-    // Undefined instruction.
-    return arm_instructions.back().impl_func;
+    // The last candidate in each slot always matches, which is the undefined instruction if nothing else does.
+    return *candidates[slot.second - 1];
 }
 
 bool Cpu::InterruptsEnabled() const {
@@ -189,25 +600,40 @@ void Cpu::CpuModeSwitch(CpuMode new_cpu_mode) {
     cpsr = (cpsr & ~cpu_mode) | static_cast<u32>(new_cpu_mode);
 }
 
+void Cpu::SkipBios() {
+    // The BIOS clears the registers and sets up the IRQ, SVC and System mode stacks at the top of IWRAM, then
+    // jumps to the cartridge in System mode.
+    regs.fill(0);
+    sp_banked[CpuModeIndex(CpuMode::Irq)] = 0x0300'7FA0;
+    sp_banked[CpuModeIndex(CpuMode::Svc)] = 0x0300'7FE0;
+    sp_banked[CpuModeIndex(CpuMode::User)] = 0x0300'7F00;
+    sp_banked[CpuModeIndex(CpuMode::System)] = 0x0300'7F00;
+    lazy_flags = 0;
+    cpsr = static_cast<u32>(CpuMode::System);
+    regs[sp] = 0x0300'7F00;
+
+    // The last BIOS opcode fetched by the boot code, which is what reads from the BIOS return from then on.
+    last_bios_fetch = 0xE129'F000;
+
+    regs[pc] = 0x0800'0000;
+    FlushPipeline();
+}
+
 int Cpu::FlushPipeline() {
     mem.FlushPrefetchBuffer();
 
     int cycles = 0;
     if (ThumbMode()) {
-        pipeline[1] = mem.ReadMem<Thumb>(regs[pc]);
-        cycles += mem.AccessTime<Thumb>(regs[pc], AccessType::Opcode);
+        pipeline[1] = mem.FetchOpcode<Thumb>(regs[pc], cycles);
         regs[pc] += 2;
 
-        pipeline[2] = mem.ReadMem<Thumb>(regs[pc]);
-        cycles += mem.AccessTime<Thumb>(regs[pc], AccessType::Opcode);
+        pipeline[2] = mem.FetchOpcode<Thumb>(regs[pc], cycles);
         regs[pc] += 2;
     } else {
-        pipeline[1] = mem.ReadMem<Arm>(regs[pc]);
-        cycles += mem.AccessTime<Arm>(regs[pc], AccessType::Opcode);
+        pipeline[1] = mem.FetchOpcode<Arm>(regs[pc], cycles);
         regs[pc] += 4;
 
-        pipeline[2] = mem.ReadMem<Arm>(regs[pc]);
-        cycles += mem.AccessTime<Arm>(regs[pc], AccessType::Opcode);
+        pipeline[2] = mem.FetchOpcode<Arm>(regs[pc], cycles);
         regs[pc] += 4;
     }
 
@@ -217,6 +643,7 @@ int Cpu::FlushPipeline() {
 
 int Cpu::TakeException(CpuMode exception_type) {
     // Save current CPSR and switch to the new CPU mode.
+    MaterializeFlags();
     spsr[CpuModeIndex(exception_type)] = cpsr;
     CpuModeSwitch(exception_type);
 
@@ -271,6 +698,7 @@ int Cpu::ReturnFromException(u32 address) {
     u32 spsr_exception = spsr[CurrentCpuModeIndex()];
     CpuModeSwitch(static_cast<CpuMode>(spsr_exception & cpu_mode));
     cpsr = spsr_exception;
+    lazy_flags = 0;
 
     if (ThumbMode()) {
         return Thumb_BranchWritePC(address);
@@ -281,7 +709,7 @@ int Cpu::ReturnFromException(u32 address) {
 
 void Cpu::InternalCycle(int cycles) {
     if (mem.PrefetchEnabled()) {
-        if (regs[pc] >= 0x0800'0000) {
+        if (regs[pc] >= mem.PrefetchPcStart()) {
             mem.RunPrefetch(cycles);
         }
 
@@ -316,6 +744,53 @@ int Cpu::BxWritePC(u32 addr) {
     return FlushPipeline();
 }
 
+int Cpu::LoadRegisterBlock(u32 addr, u32 reg_list) {
+    std::array<u32, 16> values;
+    const int count = Popcount(reg_list);
+
+    // Stack and block copies almost always stay within one region of plain memory, so try to do them in one go.
+    int cycles = mem.ReadBurst(addr, values.data(), count);
+    if (cycles < 0) {
+        cycles = 0;
+        for (int i = 0; i < count; ++i) {
+            // Reads must be aligned.
+            values[i] = mem.ReadMem<u32>(addr + 4 * i);
+            cycles += mem.AccessTime<u32>(addr + 4 * i);
+        }
+    }
+
+    int next = 0;
+    for (Reg r = 0; r < 16; ++r) {
+        if (reg_list & (1 << r)) {
+            regs[r] = values[next++];
+        }
+    }
+
+    return cycles;
+}
+
+int Cpu::StoreRegisterBlock(u32 addr, u32 reg_list, const std::array<u32, 16>& values) {
+    std::array<u32, 16> block;
+    int count = 0;
+    for (Reg r = 0; r < 16; ++r) {
+        if (reg_list & (1 << r)) {
+            block[count++] = values[r];
+        }
+    }
+
+    int cycles = mem.WriteBurst(addr, block.data(), count);
+    if (cycles < 0) {
+        cycles = 0;
+        for (int i = 0; i < count; ++i) {
+            // Writes are always aligned.
+            mem.WriteMem(addr + 4 * i, block[i]);
+            cycles += mem.AccessTime<u32>(addr + 4 * i);
+        }
+    }
+
+    return cycles;
+}
+
 ImmediateShift Cpu::DecodeImmShift(ShiftType type, u32 imm5) {
     if (imm5 == 0) {
         switch (type) {
@@ -388,8 +863,56 @@ Cpu::ResultWithCarry Cpu::Shift_C(u32 value, ShiftType type, int shift_amount) {
     }
 }
 
+u32 Cpu::ShiftImm(u32 value, ShiftType type, u32 imm5) {
+    switch (type) {
+    case ShiftType::LSL:
+        return value << imm5;
+    case ShiftType::LSR:
+        return (imm5 == 0) ? 0 : value >> imm5;
+    case ShiftType::ASR:
+        return static_cast<s32>(value) >> ((imm5 == 0) ? 31 : imm5);
+    case ShiftType::ROR:
+        return (imm5 == 0) ? (value >> 1) | (GetCarry() << 31) : RotateRight(value, imm5);
+    default:
+        assert(false);
+        return 0;
+    }
+}
+
+Cpu::ResultWithCarry Cpu::ShiftImm_C(u32 value, ShiftType type, u32 imm5) {
+    if (imm5 == 0) {
+        switch (type) {
+        case ShiftType::LSL:
+            return {value, GetCarry()};
+        case ShiftType::LSR:
+            return {0, value >> 31};
+        case ShiftType::ASR:
+            return {static_cast<u32>(static_cast<s32>(value) >> 31), value >> 31};
+        case ShiftType::ROR:
+            return RotateRightExtend_C(value, GetCarry());
+        default:
+            assert(false);
+            return {0, 0};
+        }
+    }
+
+    switch (type) {
+    case ShiftType::LSL:
+        return {value << imm5, (value >> (32 - imm5)) & 0x1};
+    case ShiftType::LSR:
+        return {value >> imm5, (value >> (imm5 - 1)) & 0x1};
+    case ShiftType::ASR:
+        return {static_cast<u32>(static_cast<s32>(value) >> imm5), (value >> (imm5 - 1)) & 0x1};
+    case ShiftType::ROR:
+        return RotateRight_C(value, imm5);
+    default:
+        assert(false);
+        return {0, 0};
+    }
+}
+
 Cpu::ResultWithCarry Cpu::LogicalShiftLeft_C(u64 value, int shift_amount) {
-    u32 carry_out = (value << (shift_amount - 1)) >> 31;
+    u32 carry_out = ((value << (shift_amount - 1)) >> 31) & 0x1;
     u32 result = value << shift_amount;
 
     return {result, carry_out};
@@ -419,42 +942,44 @@ Cpu::ResultWithCarry Cpu::RotateRightExtend_C(u32 value, u32 carry_in) {
     return {(value >> 1) | (carry_in << 31), value & 0x1};
 }
 
-bool Cpu::ConditionPassed(Condition cond) const {
-    switch (cond) {
-    case Condition::Equal:         return GetZero();
-    case Condition::NotEqual:      return !GetZero();
-    case Condition::CarrySet:      return GetCarry();
-    case Condition::CarryClear:    return !GetCarry();
-    case Condition::Minus:         return GetSign();
-    case Condition::Plus:          return !GetSign();
-    case Condition::OverflowSet:   return GetOverflow();
-    case Condition::OverflowClear: return !GetOverflow();
-    case Condition::Higher:        return GetCarry() && !GetZero();
-    case Condition::LowerSame:     return !(GetCarry() && !GetZero());
-    case Condition::GreaterEqual:  return GetSign() == GetOverflow();
-    case Condition::LessThan:      return !(GetSign() == GetOverflow());
-    case Condition::GreaterThan:   return GetSign() == GetOverflow() && !GetZero();
-    case Condition::LessEqual:     return !(GetSign() == GetOverflow() && !GetZero());
-    default:                       return true;
-    }
+bool Cpu::ConditionPassed(Condition cond) {
+    MaterializeFlags();
+    return (condition_table[static_cast<int>(cond)] >> (cpsr >> 28)) & 0x1;
+}
+
+void Cpu::UpdateLazyFlags() {
+    u32 flags = lazy_result & sign_flag;
+    flags |= static_cast<u32>(lazy_result == 0) << 30;
+    flags |= static_cast<u32>(lazy_carry != 0) << 29;
+    flags |= static_cast<u32>(lazy_overflow) << 28;
+
+    cpsr = (cpsr & ~lazy_flags) | (flags & lazy_flags);
+    lazy_flags = 0;
 }
 
 void Cpu::SetAllFlags(ArithResult result) {
-    SetSign(result.value & sign_bit);
-    SetZero(static_cast<u32>(result.value) == 0);
-    SetCarry(result.value & carry_bit);
-    SetOverflow(result.overflow);
+    lazy_result = static_cast<u32>(result.value);
+    lazy_carry = result.value & carry_bit;
+    lazy_overflow = result.overflow;
+    lazy_flags = sign_flag | zero_flag | carry_flag | overflow_flag;
 }
 
 void Cpu::SetSignZeroCarryFlags(u32 result, u32 carry) {
-    SetSign(result & sign_bit);
-    SetZero(result == 0);
-    SetCarry(carry);
+    // An out of date overflow flag must be brought up to date before the values it's derived from are replaced.
+    if (lazy_flags & overflow_flag) {
+        UpdateLazyFlags();
+    }
+    lazy_result = result;
+    lazy_carry = carry;
+    lazy_flags = sign_flag | zero_flag | carry_flag;
 }
 
 void Cpu::SetSignZeroFlags(u32 result) {
-    SetSign(result & sign_bit);
-    SetZero(result == 0);
+    if (lazy_flags & (carry_flag | overflow_flag)) {
+        UpdateLazyFlags();
+    }
+    lazy_result = result;
+    lazy_flags = sign_flag | zero_flag;
 }
 
 void Cpu::ConditionalSetAllFlags(bool set_flags, ArithResult result) {
@@ -497,4 +1022,31 @@ int Cpu::MultiplyCycles(u32 operand) {
     return 4;
 }
 
+void Cpu::Serialize(Common::StateBuffer& state) {
+    MaterializeFlags();
+
+    state.BeginChunk("CPU ", 2);
+    state.Sync(regs);
+    state.Sync(cpsr);
+    state.Sync(spsr);
+    state.Sync(sp_banked);
+    state.Sync(lr_banked);
+    state.Sync(fiq_banked_regs);
+    state.Sync(pipeline);
+    state.Sync(pc_written);
+    state.Sync(halted);
+    state.Sync(dma_active);
+    state.Sync(last_bios_fetch);
+    state.Sync(hle_intr_wait);
+    state.EndChunk();
+
+    if (state.Loading() && block_cache) {
+        block_cache->InvalidateRam();
+    }
+
+    if (state.Loading()) {
+        idle_snapshot_valid = false;
+    }
+}
+
 } // End namespace Gba
@@ -19,16 +19,21 @@
 #include <array>
 #include <vector>
 #include <functional>
+#include <memory>
 #include <tuple>
 
 #include "common/CommonTypes.h"
 #include "common/CommonFuncs.h"
+#include "common/Metrics.h"
 #include "gba/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gba {
 
 class Memory;
 class Core;
+class BlockCache;
 
 template<typename T>
 class Instruction;
@@ -41,14 +46,30 @@ struct ImmediateShift {
 
 class Cpu {
 public:
-    Cpu(Memory& _mem, Core& _core);
+    Cpu(Memory& _mem, Core& _core, bool enable_block_cache, bool enable_idle_skip);
     ~Cpu();
 
     bool dma_active = false;
     u32 last_bios_fetch = 0x0;
 
+    // Runs the BIOS calls games spend the most time in natively, instead of in the BIOS. Off by default, since the
+    // timing of the HLE calls and the results of the affine set calls are only approximate.
+    bool hle_bios = false;
+
+    // Only present when running in block cache mode.
+    std::unique_ptr<BlockCache> block_cache;
+
+    // Totals for the metrics export.
+    Common::CpuCounters counters;
+
     int Execute(int cycles);
     void Halt() { halted = true; }
+    // Puts the CPU in the state the BIOS leaves it in once it has booted, at the cartridge entry point.
+    void SkipBios();
+    // Called when a timer counter is read, so idle loop detection can tell when the value a loop polls changes.
+    void RecordTimerRead(int timer, u16 value);
+
+    void Serialize(Common::StateBuffer& state);
 
     u32 GetPc() const { return regs[pc]; };
     u32 GetPrefetchedOpcode(int i) const { return pipeline[i]; }
@@ -72,20 +93,54 @@ private:
     std::array<u32, 16> regs{};
     u32 cpsr = irq_disable | fiq_disable | static_cast<u32>(CpuMode::Svc);
 
+    // Lazily evaluated condition flags. Instructions which set flags only store the values they're derived from,
+    // and the NZCV bits of the CPSR are brought up to date when a condition check, MRS, exception or register dump
+    // reads them. lazy_flags holds the CPSR flag masks which are out of date.
+    u32 lazy_flags = 0;
+    u32 lazy_result = 0;
+    u32 lazy_carry = 0;
+    bool lazy_overflow = false;
+
     std::array<u32, 16> spsr{};
     std::array<u32, 16> sp_banked{};
     std::array<u32, 16> lr_banked{};
     std::array<u32, 5> fiq_banked_regs{};
 
-    const std::vector<Instruction<Thumb>> thumb_instructions;
-    const std::vector<Instruction<Arm>> arm_instructions;
-    std::array<const std::function<int(Cpu& cpu, Thumb opcode)> *, 0x400> thumb_decode_table;
+    // The instruction and decode tables are the same for every core, so they're built once and shared.
+    struct DecodeTables;
+    const DecodeTables& decode_tables;
 
     std::array<u32, 3> pipeline{};
     bool pc_written = false;
 
     bool halted = false;
 
+    // Idle loop detection. A short backward loop which only reads memory is idle if one iteration leaves the
+    // registers and flags exactly as they were, with no hardware event in between; nothing it reads can change
+    // until the next event, so the CPU can skip ahead to it as if halted. Timer counters are the exception, since
+    // they're computed when read rather than clocked by events, so a loop which polls one is only skipped an
+    // iteration at a time while the counters it read still hold the same values.
+    static constexpr u32 max_idle_loop_bytes = 0x40;
+    static constexpr int max_idle_deadline = 0x1000'0000;
+    static constexpr std::size_t max_idle_reads = 4;
+    const bool idle_skip;
+    u32 idle_branch_addr = 0xFFFF'FFFF;
+    u32 idle_loop_start = 0;
+    bool idle_body_ok = false;
+    bool idle_snapshot_valid = false;
+    std::array<u32, 16> idle_regs{};
+    u32 idle_cpsr = 0;
+    u64 idle_deadline = 0;
+    u64 idle_snapshot_time = 0;
+    bool idle_loop_found = false;
+    struct IdleRead {
+        int timer;
+        u16 value;
+    };
+    std::array<IdleRead, max_idle_reads> idle_reads{};
+    std::size_t num_idle_reads = 0;
+    bool idle_reads_overflow = false;
+
     // Constants
     using Reg = std::size_t;
     static constexpr Reg sp = 13, lr = 14, pc = 15;
@@ -142,21 +197,58 @@ private:
     int TakeException(CpuMode exception_type);
     int ReturnFromException(u32 address);
 
-    void InternalCycle(int cycles);
-
-    void SetSign(bool val)     { (val) ? (cpsr |= sign_flag)     : (cpsr &= ~sign_flag); }
-    void SetZero(bool val)     { (val) ? (cpsr |= zero_flag)     : (cpsr &= ~zero_flag); }
-    void SetCarry(bool val)    { (val) ? (cpsr |= carry_flag)    : (cpsr &= ~carry_flag); }
-    void SetOverflow(bool val) { (val) ? (cpsr |= overflow_flag) : (cpsr &= ~overflow_flag); }
+    // Set while an HLE IntrWait is halted, so running the SWI again after an interrupt doesn't discard the flags.
+    bool hle_intr_wait = false;
+    // Returns the cycles taken, or -1 to run the call in the real BIOS.
+    int HleSwi(u32 number);
+    int HleIntrWait(bool discard_old_flags, u16 flags);
+    int HleReturn();
 
-    u32 GetSign()     const { return (cpsr & sign_flag)     >> 31; }
-    u32 GetZero()     const { return (cpsr & zero_flag)     >> 30; }
-    u32 GetCarry()    const { return (cpsr & carry_flag)    >> 29; }
-    u32 GetOverflow() const { return (cpsr & overflow_flag) >> 28; }
+    void InternalCycle(int cycles);
 
-    void PopulateThumbDecodeTable();
-    const std::function<int(Cpu& cpu, Thumb opcode)>& DecodeThumb(Thumb opcode) const;
-    const std::function<int(Cpu& cpu, Arm opcode)>& DecodeArm(Arm opcode) const;
+    void MaterializeFlags() {
+        if (lazy_flags != 0) {
+            UpdateLazyFlags();
+        }
+    }
+    void UpdateLazyFlags();
+
+    void SetSign(bool val)     { MaterializeFlags(); (val) ? (cpsr |= sign_flag)     : (cpsr &= ~sign_flag); }
+    void SetZero(bool val)     { MaterializeFlags(); (val) ? (cpsr |= zero_flag)     : (cpsr &= ~zero_flag); }
+    void SetCarry(bool val)    { MaterializeFlags(); (val) ? (cpsr |= carry_flag)    : (cpsr &= ~carry_flag); }
+    void SetOverflow(bool val) { MaterializeFlags(); (val) ? (cpsr |= overflow_flag) : (cpsr &= ~overflow_flag); }
+
+    u32 GetSign()     { MaterializeFlags(); return (cpsr & sign_flag)     >> 31; }
+    u32 GetZero()     { MaterializeFlags(); return (cpsr & zero_flag)     >> 30; }
+    u32 GetCarry()    { MaterializeFlags(); return (cpsr & carry_flag)    >> 29; }
+    u32 GetOverflow() { MaterializeFlags(); return (cpsr & overflow_flag) >> 28; }
+
+    static const DecodeTables& SharedDecodeTables();
+    const Instruction<Thumb>& DecodeThumb(Thumb opcode) const;
+    const Instruction<Arm>& DecodeArm(Arm opcode) const;
+    const Instruction<Thumb>& Decode(Thumb opcode) const { return DecodeThumb(opcode); }
+    const Instruction<Arm>& Decode(Arm opcode) const { return DecodeArm(opcode); }
+
+    void Disassemble(Thumb opcode);
+    void Disassemble(Arm opcode);
+    // Reports an executed instruction to the guest profiler, along with any call it made.
+    void Profile(Thumb opcode, u32 addr, int cycles);
+    void Profile(Arm opcode, u32 addr, int cycles);
+
+    template<bool tracing>
+    int ExecuteLoop(int cycles);
+    template<typename T, bool tracing>
+    int ExecuteBlock();
+
+    // Called after an instruction at the given address wrote the PC. Returns true if it closed an idle loop.
+    template<typename T>
+    bool IdleLoop(u32 branch_addr);
+    template<typename T>
+    bool IdleLoopBody(u32 start_addr, u32 branch_addr) const;
+    static bool IdleLoopInstruction(Thumb opcode);
+    static bool IdleLoopInstruction(Arm opcode);
+    bool IdleReadsUnchanged() const;
+    int SkipIdleLoop(int remaining_cycles);
 
     // ARM primitives
     static constexpr ResultWithCarry ArmExpandImmediate_C(u32 value) noexcept {
@@ -167,6 +259,10 @@ private:
 
     u32 Shift(u32 value, ShiftType type, int shift_amount);
     ResultWithCarry Shift_C(u32 value, ShiftType type, int shift_amount);
+    // Immediate shift amounts are always below 32, with 0 encoding the special cases, so these skip the clamping
+    // and the separate DecodeImmShift step.
+    u32 ShiftImm(u32 value, ShiftType type, u32 imm5);
+    ResultWithCarry ShiftImm_C(u32 value, ShiftType type, u32 imm5);
     static ResultWithCarry LogicalShiftLeft_C(u64 value, int shift_amount);
     static ResultWithCarry LogicalShiftRight_C(u64 value, int shift_amount);
     static ResultWithCarry ArithmeticShiftRight_C(s32 value, int shift_amount);
@@ -199,7 +295,7 @@ private:
     void ConditionalSetSignZeroFlags(bool set_flags, u32 result);
     void ConditionalSetMultiplyLongFlags(bool set_flags, u64 result);
 
-    bool ConditionPassed(Condition cond) const;
+    bool ConditionPassed(Condition cond);
 
     static int MultiplyCycles(u32 operand);
 
@@ -230,6 +326,11 @@ private:
 
     int AluWritePC(bool set_flags, u32 result);
 
+    // Loads or stores the registers in reg_list, lowest first, at consecutive words from addr. Returns the access
+    // cycles. Stores take their values from a per-register array so the caller can substitute the written-back base.
+    int LoadRegisterBlock(u32 addr, u32 reg_list);
+    int StoreRegisterBlock(u32 addr, u32 reg_list, const std::array<u32, 16>& values);
+
     int Arm_ArithImm(Condition cond, bool set_flags, Reg n, Reg d, u32 imm, ArithOp op, u32 carry);
     int Arm_ArithReg(Condition cond, bool set_flags, Reg n, Reg d, u32 imm, ShiftType type, Reg m, ArithOp op,
                      u32 carry);
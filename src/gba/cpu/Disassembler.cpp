@@ -20,16 +20,22 @@
 #include "gba/cpu/Disassembler.h"
 #include "gba/cpu/Cpu.h"
 #include "gba/cpu/Instruction.h"
+#include "gba/core/Core.h"
+#include "gba/core/Scheduler.h"
+#include "gba/memory/Memory.h"
+#include "common/Trace.h"
 
 namespace Gba {
 
 Disassembler::Disassembler(Core& _core, LogLevel level)
-        : core(_core)
-        , thumb_instructions(Instruction<Thumb>::GetInstructionTable<Disassembler>())
-        , arm_instructions(Instruction<Arm>::GetInstructionTable<Disassembler>())
+        : core(&_core)
+        , thumb_instructions(Instruction<Thumb>::SharedInstructionTable<Disassembler>())
+        , arm_instructions(Instruction<Arm>::SharedInstructionTable<Disassembler>())
         , alt_level(level) {
     // Leave log_stream unopened if logging disabled.
-    if (level != LogLevel::None) {
+    if (level == LogLevel::Binary) {
+        trace = std::make_unique<Common::TraceWriter>("trace.bin", Common::TraceSystem::Gba, sizeof(TraceRecord));
+    } else if (level != LogLevel::None) {
         log_stream = std::ofstream("log.txt");
 
         if (!log_stream) {
@@ -43,44 +49,76 @@ Disassembler::Disassembler(Core& _core, LogLevel level)
     }
 }
 
+Disassembler::Disassembler()
+        : core(nullptr)
+        , thumb_instructions(Instruction<Thumb>::SharedInstructionTable<Disassembler>())
+        , arm_instructions(Instruction<Arm>::SharedInstructionTable<Disassembler>())
+        , alt_level(LogLevel::None) {}
+
 // Needed to declare std::vector with forward-declared type in the header file.
 Disassembler::~Disassembler() = default;
 
 void Disassembler::DisassembleThumb(Thumb opcode, const std::array<u32, 16>& regs, u32 cpsr) {
     if (log_level == LogLevel::None) {
         return;
+    } else if (log_level == LogLevel::Binary) {
+        trace->Push(TraceRecord{core->scheduler->Timestamp(), regs, opcode, cpsr});
+        return;
     }
 
-    for (const auto& instr : thumb_instructions) {
-        if (instr.Match(opcode)) {
-            fmt::print(log_stream, "0x{:0>8X}, T: {}\n", regs[pc], instr.disasm_func(*this, opcode));
-            break;
-        }
+    Thumb prev_opcode = 0, next_opcode = 0;
+    if ((opcode & 0xF000) == 0xF000) {
+        // Only BL halves need their neighbours, so avoid the extra reads for everything else.
+        prev_opcode = core->mem->ReadMem<Thumb>(regs[pc] - 6);
+        next_opcode = core->mem->ReadMem<Thumb>(regs[pc] - 2);
     }
 
+    fmt::print(log_stream, "0x{:0>8X}, T: {}\n", regs[pc], ThumbString(opcode, prev_opcode, next_opcode));
+
     if (log_level == LogLevel::Registers) {
-        LogRegisters(regs, cpsr);
+        fmt::print(log_stream, RegistersString(regs, cpsr));
     }
 }
 
 void Disassembler::DisassembleArm(Arm opcode, const std::array<u32, 16>& regs, u32 cpsr) {
     if (log_level == LogLevel::None) {
         return;
+    } else if (log_level == LogLevel::Binary) {
+        trace->Push(TraceRecord{core->scheduler->Timestamp(), regs, opcode, cpsr});
+        return;
     }
 
-    for (const auto& instr : arm_instructions) {
+    fmt::print(log_stream, "0x{:0>8X}, A: {}\n", regs[pc], ArmString(opcode));
+
+    if (log_level == LogLevel::Registers) {
+        fmt::print(log_stream, RegistersString(regs, cpsr));
+    }
+}
+
+std::string Disassembler::ThumbString(Thumb opcode, Thumb prev_opcode, Thumb next_opcode) {
+    bl_prev_opcode = prev_opcode;
+    bl_next_opcode = next_opcode;
+
+    for (const auto& instr : thumb_instructions) {
         if (instr.Match(opcode)) {
-            fmt::print(log_stream, "0x{:0>8X}, A: {}\n", regs[pc], instr.disasm_func(*this, opcode));
-            break;
+            return instr.disasm_func(*this, opcode);
         }
     }
 
-    if (log_level == LogLevel::Registers) {
-        LogRegisters(regs, cpsr);
+    return "";
+}
+
+std::string Disassembler::ArmString(Arm opcode) {
+    for (const auto& instr : arm_instructions) {
+        if (instr.Match(opcode)) {
+            return instr.disasm_func(*this, opcode);
+        }
     }
+
+    return "";
 }
 
-void Disassembler::LogRegisters(const std::array<u32, 16>& regs, u32 cpsr) {
+std::string Disassembler::RegistersString(const std::array<u32, 16>& regs, u32 cpsr) {
     fmt::MemoryWriter regs_str;
     for (int i = 0; i < 13; ++i) {
         regs_str.write("R{:X}=0x{:0>8X}, ", i, regs[i]);
@@ -96,7 +134,7 @@ void Disassembler::LogRegisters(const std::array<u32, 16>& regs, u32 cpsr) {
     regs_str.write("{}", (cpsr & 0x2000'0000) ? "C" : "");
     regs_str.write("{}\n\n", (cpsr & 0x1000'0000) ? "V" : "");
 
-    fmt::print(log_stream, regs_str.str());
+    return regs_str.str();
 }
 
 void Disassembler::LogHalt() {
@@ -125,6 +163,8 @@ void Disassembler::SwitchLogLevel() {
             return "LCD";
         case LogLevel::Timer:
             return "Timer";
+        case LogLevel::Binary:
+            return "Binary";
         default:
             return "";
         }
@@ -16,8 +16,10 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
 #include <string>
+#include <memory>
 #include <fstream>
 #include <utility>
 #include <fmt/ostream.h>
@@ -27,6 +29,8 @@
 #include "common/CommonEnums.h"
 #include "gba/core/Enums.h"
 
+namespace Common { class TraceWriter; }
+
 namespace Gba {
 
 class Core;
@@ -36,14 +40,30 @@ class Instruction;
 
 struct ImmediateShift;
 
+// One record per executed instruction when logging in binary trace mode. The PC is regs[15], and the Thumb bit of
+// the CPSR says which instruction set the opcode belongs to.
+struct TraceRecord {
+    u64 timestamp;
+    std::array<u32, 16> regs;
+    u32 opcode;
+    u32 cpsr;
+};
+
 class Disassembler {
 public:
     Disassembler(Core& _core, LogLevel level);
+    // A disassembler which isn't attached to a running core, for decoding binary traces offline.
+    Disassembler();
     ~Disassembler();
 
     void DisassembleThumb(Thumb opcode, const std::array<u32, 16>& regs, u32 cpsr);
     void DisassembleArm(Arm opcode, const std::array<u32, 16>& regs, u32 cpsr);
 
+    // The two halves of a Thumb BL are disassembled together, so Thumb opcodes need their neighbours.
+    std::string ThumbString(Thumb opcode, Thumb prev_opcode, Thumb next_opcode);
+    std::string ArmString(Arm opcode);
+    static std::string RegistersString(const std::array<u32, 16>& regs, u32 cpsr);
+
     template<typename... Args>
     void Log(const std::string& log_msg, bool always, Args&&... args) {
         if (always || log_level != LogLevel::None) {
@@ -55,19 +75,25 @@ public:
     void LogHalt();
 
     void SwitchLogLevel();
+    bool Enabled() const { return log_level != LogLevel::None; }
 
 private:
-    Core& core;
+    Core* const core;
 
-    const std::vector<Instruction<Thumb>> thumb_instructions;
-    const std::vector<Instruction<Arm>> arm_instructions;
+    const std::vector<Instruction<Thumb>>& thumb_instructions;
+    const std::vector<Instruction<Arm>>& arm_instructions;
 
     LogLevel log_level = LogLevel::None;
     LogLevel alt_level;
     std::ofstream log_stream;
+    std::unique_ptr<Common::TraceWriter> trace;
 
     int halt_cycles = 0;
 
+    // The neighbours of the Thumb opcode currently being disassembled.
+    Thumb bl_prev_opcode = 0;
+    Thumb bl_next_opcode = 0;
+
     using Reg = std::size_t;
     static constexpr Reg sp = 13, lr = 14, pc = 15;
 
@@ -78,8 +104,6 @@ private:
     static std::string AddrOffset(bool pre_indexed, bool add, bool wb, u32 imm);
     static std::string StatusReg(bool spsr, u32 mask);
 
-    void LogRegisters(const std::array<u32, 16>& regs, u32 cpsr);
-
     // Arm
     std::string AluImm(const char* name, Condition cond, bool sf, Reg n, Reg d, u32 imm);
     std::string AluReg(const char* name, Condition cond, bool sf, Reg n, Reg d, u32 imm, ShiftType type, Reg m);
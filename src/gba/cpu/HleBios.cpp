@@ -0,0 +1,424 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "gba/cpu/Cpu.h"
+#include "gba/memory/Memory.h"
+
+namespace Gba {
+
+namespace {
+
+// The BIOS saves the interrupts its IRQ handler has seen here, for IntrWait.
+constexpr u32 bios_intr_flags = 0x0300'7FF8;
+constexpr u32 ime_addr = 0x0400'0208;
+
+// The BIOS opcode which was last fetched when returning from a SWI, for reads from the BIOS region.
+constexpr u32 swi_return_fetch = 0xE3A0'2004;
+
+// Rough cycle costs of the BIOS routines: the SWI entry and return, plus the time taken per unit of work.
+constexpr int swi_overhead = 30;
+constexpr int div_cycles = 80;
+constexpr int sqrt_cycles = 200;
+constexpr int arctan_cycles = 50;
+constexpr int cpu_set_unit_cycles = 10;
+constexpr int cpu_fast_set_word_cycles = 3;
+constexpr int affine_set_cycles = 60;
+constexpr int lz77_byte_cycles = 20;
+constexpr int rl_byte_cycles = 12;
+constexpr int huff_byte_cycles = 40;
+
+// The BIOS's polynomial approximation, in 1.14 fixed point. The BIOS leaves the negated square of the input in r1,
+// and the final polynomial term in r3.
+s32 ArcTan(s32 i, u32* r1 = nullptr, u32* r3 = nullptr) {
+    const s32 a = -((i * i) >> 14);
+    s32 b = ((0xA9 * a) >> 14) + 0x390;
+    b = ((b * a) >> 14) + 0x91C;
+    b = ((b * a) >> 14) + 0xFB6;
+    b = ((b * a) >> 14) + 0x16AA;
+    b = ((b * a) >> 14) + 0x2081;
+    b = ((b * a) >> 14) + 0x3651;
+    b = ((b * a) >> 14) + 0xA2F9;
+    if (r1) {
+        *r1 = a;
+    }
+    if (r3) {
+        *r3 = b;
+    }
+    return (i * b) >> 16;
+}
+
+u32 ArcTan2(s32 x, s32 y) {
+    if (y == 0) {
+        return (x >= 0) ? 0x0000 : 0x8000;
+    } else if (x == 0) {
+        return (y >= 0) ? 0x4000 : 0xC000;
+    }
+
+    if (y >= 0) {
+        if (x >= 0) {
+            if (x >= y) {
+                return ArcTan((y << 14) / x);
+            }
+        } else if (-x >= y) {
+            return ArcTan((y << 14) / x) + 0x8000;
+        }
+        return 0x4000 - ArcTan((x << 14) / y);
+    } else {
+        if (x <= 0) {
+            if (-x > -y) {
+                return ArcTan((y << 14) / x) + 0x8000;
+            }
+        } else if (x >= -y) {
+            return ArcTan((y << 14) / x) + 0x10000;
+        }
+        return 0xC000 - ArcTan((x << 14) / y);
+    }
+}
+
+struct AffineParams {
+    s16 pa, pb, pc, pd;
+};
+
+// Angles are in units of 2pi/0x10000, though the BIOS only uses the upper 8 bits. Scales are 8.8 fixed point.
+AffineParams RotateScale(s16 scale_x, s16 scale_y, u16 angle) {
+    const double theta = (angle >> 8) / 128.0 * 3.14159265358979323846;
+    const double sx = scale_x / 256.0;
+    const double sy = scale_y / 256.0;
+
+    return {static_cast<s16>(std::cos(theta) * sx * 256), static_cast<s16>(-std::sin(theta) * sx * 256),
+            static_cast<s16>(std::sin(theta) * sy * 256), static_cast<s16>(std::cos(theta) * sy * 256)};
+}
+
+// Writes decompressed data to WRAM a byte at a time, or to VRAM a halfword at a time, since VRAM ignores byte
+// writes.
+void WriteDecompressed(Memory& mem, u32 dest, const std::vector<u8>& data, bool vram) {
+    if (vram) {
+        for (std::size_t i = 0; i + 1 < data.size(); i += 2) {
+            mem.WriteMem<u16>(dest + i, data[i] | (data[i + 1] << 8));
+        }
+        // An odd last byte is written in the low half of a halfword, padded with zero.
+        if (data.size() & 1) {
+            mem.WriteMem<u16>(dest + data.size() - 1, data.back());
+        }
+    } else {
+        for (std::size_t i = 0; i < data.size(); ++i) {
+            mem.WriteMem<u8>(dest + i, data[i]);
+        }
+    }
+}
+
+std::vector<u8> Lz77Decompress(Memory& mem, u32 src) {
+    const u32 size = mem.ReadMem<u32>(src) >> 8;
+    src += 4;
+
+    std::vector<u8> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        const u8 block_types = mem.ReadMem<u8>(src++);
+        for (int block = 7; block >= 0 && data.size() < size; --block) {
+            if (block_types & (1 << block)) {
+                // A back reference of 3-18 bytes, up to 4KB back.
+                const u8 b0 = mem.ReadMem<u8>(src++);
+                const u8 b1 = mem.ReadMem<u8>(src++);
+                const std::size_t disp = (((b0 & 0xF) << 8) | b1) + 1;
+                const int length = (b0 >> 4) + 3;
+
+                for (int i = 0; i < length && data.size() < size; ++i) {
+                    data.push_back((disp <= data.size()) ? data[data.size() - disp] : 0);
+                }
+            } else {
+                data.push_back(mem.ReadMem<u8>(src++));
+            }
+        }
+    }
+
+    return data;
+}
+
+std::vector<u8> RlDecompress(Memory& mem, u32 src) {
+    const u32 size = mem.ReadMem<u32>(src) >> 8;
+    src += 4;
+
+    std::vector<u8> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        const u8 flag = mem.ReadMem<u8>(src++);
+        if (flag & 0x80) {
+            // A run of 3-130 copies of the next byte.
+            const u8 value = mem.ReadMem<u8>(src++);
+            for (int i = 0; i < (flag & 0x7F) + 3 && data.size() < size; ++i) {
+                data.push_back(value);
+            }
+        } else {
+            // 1-128 uncompressed bytes.
+            for (int i = 0; i < (flag & 0x7F) + 1 && data.size() < size; ++i) {
+                data.push_back(mem.ReadMem<u8>(src++));
+            }
+        }
+    }
+
+    return data;
+}
+
+// Returns the number of bytes written.
+u32 HuffDecompress(Memory& mem, u32 src, u32 dest) {
+    const u32 header = mem.ReadMem<u32>(src);
+    const u32 size = header >> 8;
+    const int data_bits = header & 0xF;
+
+    const u32 tree = src + 4;
+    const u32 root = tree + 1;
+    u32 stream = tree + (mem.ReadMem<u8>(tree) + 1) * 2;
+
+    u32 node_addr = root;
+    u32 out_word = 0;
+    int out_bits = 0;
+    u32 written = 0;
+    while (written < size) {
+        const u32 bits = mem.ReadMem<u32>(stream);
+        stream += 4;
+
+        for (int bit = 31; bit >= 0 && written < size; --bit) {
+            // Each node holds the offset to its pair of children, and flags for which of them are leaves.
+            const u8 node = mem.ReadMem<u8>(node_addr);
+            const bool right = (bits >> bit) & 0x1;
+            const bool leaf = node & (right ? 0x40 : 0x80);
+            node_addr = (node_addr & ~0x1) + (node & 0x3F) * 2 + 2 + right;
+
+            if (leaf) {
+                out_word |= (mem.ReadMem<u8>(node_addr) & ((1 << data_bits) - 1)) << out_bits;
+                out_bits += data_bits;
+                node_addr = root;
+
+                if (out_bits == 32) {
+                    mem.WriteMem<u32>(dest + written, out_word);
+                    written += 4;
+                    out_word = 0;
+                    out_bits = 0;
+                }
+            }
+        }
+    }
+
+    return written;
+}
+
+} // End anonymous namespace
+
+int Cpu::HleSwi(u32 number) {
+    int cycles = swi_overhead;
+
+    switch (number) {
+    case 0x02: // Halt
+        halted = true;
+        break;
+
+    case 0x04: // IntrWait
+        return HleIntrWait(regs[0] != 0, regs[1]);
+    case 0x05: // VBlankIntrWait
+        regs[0] = 1;
+        regs[1] = Interrupt::VBlank;
+        return HleIntrWait(true, Interrupt::VBlank);
+
+    case 0x06: // Div
+    case 0x07: { // DivArm
+        const s32 num = (number == 0x06) ? regs[0] : regs[1];
+        const s32 den = (number == 0x06) ? regs[1] : regs[0];
+        if (den == 0 || (num == INT32_MIN && den == -1)) {
+            // Leave the BIOS's own results for these to the BIOS.
+            return -1;
+        }
+
+        regs[0] = num / den;
+        regs[1] = num % den;
+        regs[3] = std::abs(num / den);
+        cycles += div_cycles;
+        break;
+    }
+
+    case 0x08: { // Sqrt
+        u32 value = regs[0];
+        u32 root = 0;
+        for (u32 bit = 1u << 30; bit != 0; bit >>= 2) {
+            if (value >= root + bit) {
+                value -= root + bit;
+                root = (root >> 1) + bit;
+            } else {
+                root >>= 1;
+            }
+        }
+        regs[0] = root;
+        cycles += sqrt_cycles;
+        break;
+    }
+
+    case 0x09: // ArcTan
+        regs[0] = ArcTan(static_cast<s16>(regs[0]), &regs[1], &regs[3]);
+        cycles += arctan_cycles;
+        break;
+    case 0x0A: // ArcTan2
+        // Unlike the BIOS, this leaves r1 and r3 as they were.
+        regs[0] = ArcTan2(static_cast<s16>(regs[0]), static_cast<s16>(regs[1])) & 0xFFFF;
+        cycles += arctan_cycles;
+        break;
+
+    case 0x0B: { // CpuSet
+        // The BIOS refuses to copy from itself.
+        if (regs[0] < 0x0200'0000) {
+            return -1;
+        }
+
+        const u32 count = regs[2] & 0x1F'FFFF;
+        const bool fill = regs[2] & (1 << 24);
+        if (regs[2] & (1 << 26)) {
+            const u32 src = regs[0] & ~0x3, dest = regs[1] & ~0x3;
+            for (u32 i = 0; i < count; ++i) {
+                mem.WriteMem<u32>(dest + i * 4, mem.ReadMem<u32>(src + (fill ? 0 : i * 4)));
+            }
+        } else {
+            const u32 src = regs[0] & ~0x1, dest = regs[1] & ~0x1;
+            for (u32 i = 0; i < count; ++i) {
+                mem.WriteMem<u16>(dest + i * 2, mem.ReadMem<u16>(src + (fill ? 0 : i * 2)));
+            }
+        }
+        cycles += count * cpu_set_unit_cycles;
+        break;
+    }
+
+    case 0x0C: { // CpuFastSet
+        if (regs[0] < 0x0200'0000) {
+            return -1;
+        }
+
+        // Copies in blocks of 8 words, so the count is rounded up.
+        const u32 count = ((regs[2] & 0x1F'FFFF) + 7) & ~0x7;
+        const bool fill = regs[2] & (1 << 24);
+        const u32 src = regs[0] & ~0x3, dest = regs[1] & ~0x3;
+        for (u32 i = 0; i < count; ++i) {
+            mem.WriteMem<u32>(dest + i * 4, mem.ReadMem<u32>(src + (fill ? 0 : i * 4)));
+        }
+        cycles += count * cpu_fast_set_word_cycles;
+        break;
+    }
+
+    case 0x0E: { // BgAffineSet
+        u32 src = regs[0], dest = regs[1];
+        for (u32 i = 0; i < regs[2]; ++i, src += 20, dest += 16) {
+            // Texture origin (19.8), screen origin, scale and angle.
+            const s32 tex_x = mem.ReadMem<u32>(src);
+            const s32 tex_y = mem.ReadMem<u32>(src + 4);
+            const s16 screen_x = mem.ReadMem<u16>(src + 8);
+            const s16 screen_y = mem.ReadMem<u16>(src + 10);
+            const AffineParams p = RotateScale(mem.ReadMem<u16>(src + 12), mem.ReadMem<u16>(src + 14),
+                                               mem.ReadMem<u16>(src + 16));
+
+            mem.WriteMem<u16>(dest, p.pa);
+            mem.WriteMem<u16>(dest + 2, p.pb);
+            mem.WriteMem<u16>(dest + 4, p.pc);
+            mem.WriteMem<u16>(dest + 6, p.pd);
+            mem.WriteMem<u32>(dest + 8, tex_x - (p.pa * screen_x + p.pb * screen_y));
+            mem.WriteMem<u32>(dest + 12, tex_y - (p.pc * screen_x + p.pd * screen_y));
+        }
+        cycles += regs[2] * affine_set_cycles;
+        break;
+    }
+
+    case 0x0F: { // ObjAffineSet
+        // The parameters are written with the given stride, so they can go straight into OAM.
+        u32 src = regs[0], dest = regs[1];
+        const u32 stride = regs[3];
+        for (u32 i = 0; i < regs[2]; ++i, src += 8, dest += stride * 4) {
+            const AffineParams p = RotateScale(mem.ReadMem<u16>(src), mem.ReadMem<u16>(src + 2),
+                                               mem.ReadMem<u16>(src + 4));
+
+            mem.WriteMem<u16>(dest, p.pa);
+            mem.WriteMem<u16>(dest + stride, p.pb);
+            mem.WriteMem<u16>(dest + stride * 2, p.pc);
+            mem.WriteMem<u16>(dest + stride * 3, p.pd);
+        }
+        cycles += regs[2] * affine_set_cycles;
+        break;
+    }
+
+    case 0x11: // LZ77UnCompWram
+    case 0x12: { // LZ77UnCompVram
+        const std::vector<u8> data{Lz77Decompress(mem, regs[0])};
+        WriteDecompressed(mem, regs[1], data, number == 0x12);
+        cycles += data.size() * lz77_byte_cycles;
+        break;
+    }
+
+    case 0x13: // HuffUnComp
+        cycles += HuffDecompress(mem, regs[0], regs[1]) * huff_byte_cycles;
+        break;
+
+    case 0x14: // RLUnCompWram
+    case 0x15: { // RLUnCompVram
+        const std::vector<u8> data{RlDecompress(mem, regs[0])};
+        WriteDecompressed(mem, regs[1], data, number == 0x15);
+        cycles += data.size() * rl_byte_cycles;
+        break;
+    }
+
+    default:
+        // Everything else runs in the real BIOS.
+        return -1;
+    }
+
+    return cycles + HleReturn();
+}
+
+int Cpu::HleIntrWait(bool discard_old_flags, u16 flags) {
+    // IntrWait enables interrupts, then halts until the game's IRQ handler acknowledges one of the given interrupts
+    // in the BIOS's flags. The SWI is run again after every interrupt, until one of them has.
+    mem.WriteMem<u16>(ime_addr, 0x1);
+
+    const u16 seen_flags = mem.ReadMem<u16>(bios_intr_flags);
+    if (!hle_intr_wait && discard_old_flags) {
+        mem.WriteMem<u16>(bios_intr_flags, seen_flags & ~flags);
+    } else if (seen_flags & flags) {
+        mem.WriteMem<u16>(bios_intr_flags, seen_flags & ~flags);
+        hle_intr_wait = false;
+        return swi_overhead + HleReturn();
+    }
+
+    hle_intr_wait = true;
+    halted = true;
+
+    // Branch back to the SWI, which runs again once the halt ends.
+    if (ThumbMode()) {
+        return swi_overhead + Thumb_BranchWritePC(regs[pc] - 4);
+    } else {
+        return swi_overhead + Arm_BranchWritePC(regs[pc] - 8);
+    }
+}
+
+int Cpu::HleReturn() {
+    last_bios_fetch = swi_return_fetch;
+
+    // Return to the instruction after the SWI, as the BIOS would.
+    if (ThumbMode()) {
+        return Thumb_BranchWritePC(regs[pc] - 2);
+    } else {
+        return Arm_BranchWritePC(regs[pc] - 4);
+    }
+}
+
+} // End namespace Gba
@@ -18,6 +18,9 @@
 
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <string>
 #include <functional>
 #include <utility>
@@ -35,8 +38,14 @@ class Instruction {
 public:
     template<typename... Args>
     Instruction(const char* instr_layout, int(Cpu::* impl)(Args...)) {
+        static_assert(sizeof...(Args) <= max_fields, "Too many fields in instruction layout.");
         const auto fields = CreateMasks<sizeof...(Args)>(instr_layout);
-        impl_func = GetImplFunction(impl, fields, std::index_sequence_for<Args...>{});
+        std::copy(fields.begin(), fields.end(), impl_fields.begin());
+
+        // The member function pointer gets copied back out as its real type by InvokeImpl before it's called.
+        static_assert(sizeof(impl) <= sizeof(impl_member), "Member function pointer too large.");
+        std::memcpy(impl_member.data(), &impl, sizeof(impl));
+        impl_invoke = &InvokeImpl<Args...>;
     }
 
     template<typename... Args>
@@ -49,14 +58,33 @@ public:
         return (opcode & fixed_mask) == instr_mask;
     }
 
+    // Only compares the fixed bits of the instruction which are also set in bit_mask.
+    bool PartialMatch(T opcode, T bit_mask) const {
+        return (opcode & fixed_mask & bit_mask) == (instr_mask & bit_mask);
+    }
+
+    bool FixedBitsWithin(T bit_mask) const {
+        return (fixed_mask & ~bit_mask) == 0;
+    }
+
+    int Execute(Cpu& cpu, T opcode) const {
+        return impl_invoke(cpu, *this, opcode);
+    }
+
     template<typename Dispatcher>
     static std::vector<Instruction<T>> GetInstructionTable();
+    // Every Cpu or Disassembler uses the same table, so it's only built once per process.
+    template<typename Dispatcher>
+    static const std::vector<Instruction<T>>& SharedInstructionTable() {
+        static const std::vector<Instruction<T>> table = GetInstructionTable<Dispatcher>();
+        return table;
+    }
 
-    std::function<int(Cpu& cpu, T opcode)> impl_func;
     std::function<std::string(Disassembler& dis, T opcode)> disasm_func;
 
 private:
     static constexpr auto num_bits = sizeof(T) * 8;
+    static constexpr std::size_t max_fields = 10;
 
     T fixed_mask = 0;
     T instr_mask = 0;
@@ -66,14 +94,34 @@ private:
         int shift;
     };
 
+    // The Cpu implementation is called through a plain function pointer instead of a std::function, since this
+    // is on the hot path of every executed instruction.
+    using InvokeFunc = int(*)(Cpu& cpu, const Instruction<T>& instr, T opcode);
+
+    alignas(std::max_align_t) std::array<unsigned char, 2 * sizeof(void*)> impl_member{};
+    InvokeFunc impl_invoke = nullptr;
+    std::array<FieldMask, max_fields> impl_fields{};
+
+    template<typename... Args>
+    static int InvokeImpl(Cpu& cpu, const Instruction<T>& instr, T opcode) {
+        return CallImpl<Args...>(cpu, instr, opcode, std::index_sequence_for<Args...>{});
+    }
+
+    template<typename... Args, std::size_t... Is>
+    static int CallImpl(Cpu& cpu, const Instruction<T>& instr, T opcode, std::index_sequence<Is...>) {
+        int(Cpu::* impl)(Args...);
+        std::memcpy(&impl, instr.impl_member.data(), sizeof(impl));
+        return (cpu.*impl)(static_cast<Args>((opcode & instr.impl_fields[Is].mask) >> instr.impl_fields[Is].shift)...);
+    }
+
     template<std::size_t N>
-    std::array<FieldMask, N> CreateMasks(const std::string& instr_layout) {
+    std::array<FieldMask, N> CreateMasks(const char* instr_layout) {
         char last_bit = '0';
         T current_mask = 0;
         std::array<FieldMask, N> fields;
         int field_index = 0;
 
-        for (std::size_t i = 0; i < instr_layout.size(); ++i) {
+        for (std::size_t i = 0; instr_layout[i] != '\0'; ++i) {
             const char bit = instr_layout[i];
             const int shift = num_bits - 1 - i;
             const T bit_mask = 1 << shift;
@@ -198,7 +198,7 @@ std::string Disassembler::Thumb_BT2(u32 imm11) {
 std::string Disassembler::Thumb_BlH1(u32 imm11) {
     s32 signed_imm32 = SignExtend(imm11 << 12, 23);
 
-    u16 next_instr = core.mem->ReadMem<u16>(core.cpu->GetPc() - 2);
+    const Thumb next_instr = bl_next_opcode;
     if ((next_instr & 0xF800) == 0xF800) {
         // If the next instruction is BlH2, disassemble as full BL.
         u32 imm_lo = (next_instr & ~0xF800) << 1;
@@ -210,7 +210,7 @@ std::string Disassembler::Thumb_BlH1(u32 imm11) {
 }
 
 std::string Disassembler::Thumb_BlH2(u32 imm11) {
-    u16 prev_instr = core.mem->ReadMem<u16>(core.cpu->GetPc() - 6);
+    const Thumb prev_instr = bl_prev_opcode;
     if ((prev_instr & 0xF800) != 0xF000) {
         // If the previous instruction was not BlH1, disassemble as an independent BLH2.
         return fmt::format("BLH2 #{:0>8X}", imm11 << 1);
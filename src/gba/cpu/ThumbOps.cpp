@@ -69,9 +69,7 @@ int Cpu::Thumb_LogicReg(Reg m, Reg d, LogicOp op) {
 }
 
 int Cpu::Thumb_ShiftImm(u32 imm, Reg m, Reg d, ShiftType type) {
-    ImmediateShift shift = DecodeImmShift(type, imm);
-
-    ResultWithCarry shifted_reg = Shift_C(regs[m], shift.type, shift.imm);
+    ResultWithCarry shifted_reg = ShiftImm_C(regs[m], type, imm);
 
     regs[d] = shifted_reg.result;
     SetSignZeroCarryFlags(shifted_reg.result, shifted_reg.carry);
@@ -372,23 +370,14 @@ int Cpu::Thumb_Ldm(Reg n, u32 reg_list) {
     assert(Popcount(reg_list) != 0); // Unpredictable
 
     const std::bitset<8> rlist{reg_list};
-    u32 addr = regs[n];
+    const u32 end_addr = regs[n] + 4 * rlist.count();
 
     // One internal cycle to transfer the last loaded value to the destination register.
-    int cycles = 1;
-
-    for (Reg i = 0; i < 8; ++i) {
-        if (rlist[i]) {
-            // Reads are aligned.
-            regs[i] = mem.ReadMem<u32>(addr);
-            cycles += mem.AccessTime<u32>(addr);
-            addr += 4;
-        }
-    }
+    const int cycles = 1 + LoadRegisterBlock(regs[n], reg_list);
 
     // Only write back to Rn if it wasn't in the register list.
     if (!rlist[n]) {
-        regs[n] = addr;
+        regs[n] = end_addr;
     }
 
     InternalCycle(1);
@@ -485,13 +474,9 @@ int Cpu::Thumb_Pop(bool p, u32 reg_list) {
     // One internal cycle to transfer the last loaded value to the destination register.
     int cycles = 1;
 
-    for (Reg i = 0; i < 8; ++i) {
-        if (rlist[i]) {
-            // Reads are aligned.
-            regs[i] = mem.ReadMem<u32>(addr);
-            cycles += mem.AccessTime<u32>(addr);
-            addr += 4;
-        }
+    if (reg_list != 0) {
+        cycles += LoadRegisterBlock(addr, reg_list);
+        addr += 4 * rlist.count();
     }
 
     if (p) {
@@ -513,48 +498,28 @@ int Cpu::Thumb_Push(bool m, u32 reg_list) {
     if (m) {
         regs[sp] -= 4;
     }
-    u32 addr = regs[sp];
-
-    int cycles = 0;
-    for (Reg i = 0; i < 8; ++i) {
-        if (rlist[i]) {
-            // Writes are always aligned.
-            mem.WriteMem(addr, regs[i]);
-            cycles += mem.AccessTime<u32>(addr);
-            addr += 4;
-        }
-    }
 
-    if (m) {
-        mem.WriteMem(addr, regs[lr]);
-        cycles += mem.AccessTime<u32>(addr);
-    }
-
-    return cycles;
+    // LR is stored above the low registers, which is where it falls in the register order anyway.
+    std::array<u32, 16> values;
+    std::copy(regs.begin(), regs.end(), values.begin());
+    return StoreRegisterBlock(regs[sp], reg_list | ((m) ? (1 << lr) : 0), values);
 }
 
 int Cpu::Thumb_Stm(Reg n, u32 reg_list) {
     assert(Popcount(reg_list) != 0); // Unpredictable
 
     const std::bitset<8> rlist{reg_list};
-    u32 addr = regs[n];
-
-    int cycles = 0;
-    for (Reg i = 0; i < 8; ++i) {
-        if (rlist[i]) {
-            // Writes are always aligned.
-            if (i == n && n != LowestSetBit(reg_list)) {
-                // Store the new Rn value if it's not the first register in the list.
-                mem.WriteMem(addr, static_cast<u32>(regs[n] + 4 * rlist.count()));
-            } else {
-                mem.WriteMem(addr, regs[i]);
-            }
-            cycles += mem.AccessTime<u32>(addr);
-            addr += 4;
-        }
+    const u32 end_addr = regs[n] + 4 * rlist.count();
+
+    std::array<u32, 16> values;
+    std::copy(regs.begin(), regs.end(), values.begin());
+    if (rlist[n] && n != LowestSetBit(reg_list)) {
+        // Store the new Rn value if it's not the first register in the list.
+        values[n] = end_addr;
     }
 
-    regs[n] = addr;
+    const int cycles = StoreRegisterBlock(regs[n], reg_list, values);
+    regs[n] = end_addr;
 
     return cycles;
 }
@@ -616,7 +581,14 @@ int Cpu::Thumb_StrhReg(Reg m, Reg n, Reg t) {
 }
 
 // Misc
-int Cpu::Thumb_Swi(u32) {
+int Cpu::Thumb_Swi(u32 imm) {
+    if (hle_bios) {
+        const int cycles = HleSwi(imm);
+        if (cycles >= 0) {
+            return cycles;
+        }
+    }
+
     return TakeException(CpuMode::Svc);
 }
 
@@ -15,11 +15,14 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
+#include <limits>
 
 #include "gba/hardware/Dma.h"
 #include "gba/core/Core.h"
 #include "gba/memory/Memory.h"
 #include "gba/cpu/Cpu.h"
+#include "common/StateBuffer.h"
+#include "common/Timing.h"
 
 namespace Gba {
 
@@ -77,8 +80,16 @@ void Dma::Trigger(DmaTiming event) {
     }
 }
 
+void Dma::TriggerSoundFifo(u32 fifo_addr) {
+    if (SoundFifoMode() && dest == fifo_addr) {
+        Trigger(Special);
+    }
+}
+
 int Dma::Run() {
+    TIMING_SCOPE(Dma);
     int cycles_taken = 0;
+    int chunks = 1;
 
     if (starting) {
         // Two I-cycles to start the transfer.
@@ -94,13 +105,14 @@ int Dma::Run() {
         starting = false;
     } else {
         if (TransferWidth() == 2) {
-            cycles_taken += Transfer<u16>(AccessType::Sequential);
+            cycles_taken += BulkTransfer<u16>(chunks);
         } else {
-            cycles_taken += Transfer<u32>(AccessType::Sequential);
+            cycles_taken += BulkTransfer<u32>(chunks);
         }
     }
 
-    if (--remaining_chunks == 0) {
+    remaining_chunks -= chunks;
+    if (remaining_chunks == 0) {
         // The transfer has finished.
         if (control & irq_enable) {
             core.mem->RequestInterrupt(Interrupt::Dma0 << id);
@@ -147,39 +159,90 @@ int Dma::Transfer(AccessType sequential) {
 
     int cycles = core.mem->AccessTime<T>(source, sequential) + core.mem->AccessTime<T>(dest, sequential);
 
+    source += SourceStep();
+    dest += DestStep();
+
+    return cycles;
+}
+
+template<typename T>
+int Dma::BulkTransfer(int& chunks) {
+    chunks = 1;
+
+    if (!bad_source && remaining_chunks > 1 && EepromTransfer()) {
+        // EEPROM streams can't be copied directly, but they're at most 81 bits long, so clock them through in one go
+        // rather than returning to the CPU loop after every bit.
+        const int max_cycles = core.HaltCycles(std::numeric_limits<int>::max());
+        int cycles = Transfer<T>(AccessType::Sequential);
+        while (chunks < remaining_chunks && cycles < max_cycles) {
+            cycles += Transfer<T>(AccessType::Sequential);
+            ++chunks;
+        }
+
+        return cycles;
+    }
+
+    // Only immediate and VBlank transfers are long enough to be worth it. HBlank and special transfers are short,
+    // and the sound FIFO transfers are timed against the audio hardware.
+    const int timing = StartTiming();
+    if (bad_source || remaining_chunks == 1 || (timing != Immediate && timing != VBlank)) {
+        return Transfer<T>(AccessType::Sequential);
+    }
+
+    // Stop before the next hardware event, so it sees the transfer as far along as it would have been.
+    const int unit_cycles = core.mem->DmaSequentialCycles<T>(dest, source);
+    const int max_chunks = std::min(remaining_chunks, core.HaltCycles(remaining_chunks * unit_cycles) / unit_cycles);
+    if (max_chunks <= 1 || !core.mem->DmaCopy<T>(dest, source, max_chunks, DestStep(), SourceStep())) {
+        return Transfer<T>(AccessType::Sequential);
+    }
+
+    chunks = max_chunks;
+    source += chunks * SourceStep();
+    dest += chunks * DestStep();
+
+    return chunks * unit_cycles;
+}
+
+bool Dma::EepromTransfer() const {
+    return id == 3 && (core.mem->EepromAccess(dest) || core.mem->EepromAccess(source));
+}
+
+int Dma::SourceStep() const {
     if (source >= BaseAddr::Rom && source < BaseAddr::SRam) {
         // Sequential accesses to ROM always read from the address incrementer.
-        source += TransferWidth();
-    } else {
-        switch (SourceControl()) {
-        case Increment:
-            source += TransferWidth();
-            break;
-        case Decrement:
-            source -= TransferWidth();
-            break;
-        default:
-            break;
-        }
+        return TransferWidth();
+    }
+
+    switch (SourceControl()) {
+    case Increment:
+        return TransferWidth();
+    case Decrement:
+        return -TransferWidth();
+    default:
+        return 0;
+    }
+}
+
+int Dma::DestStep() const {
+    if (SoundFifoMode()) {
+        return 0;
     }
 
     switch (DestControl()) {
     case Increment:
     case Reload:
-        dest += TransferWidth();
-        break;
+        return TransferWidth();
     case Decrement:
-        dest -= TransferWidth();
-        break;
+        return -TransferWidth();
     default:
-        break;
+        return 0;
     }
-
-    return cycles;
 }
 
 void Dma::ReloadWordCount() {
-    if (word_count != 0) {
+    if (SoundFifoMode()) {
+        remaining_chunks = 4;
+    } else if (word_count != 0) {
         remaining_chunks = word_count;
     } else {
         // If the word count register contains 0, the actual count is 0x1'0000 for DMA3 and 0x4000 otherwise.
@@ -189,4 +252,21 @@ void Dma::ReloadWordCount() {
     starting = true;
 }
 
+void Dma::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("DMA ", 1);
+    state.Sync(source_l.v);
+    state.Sync(source_h.v);
+    state.Sync(dest_l.v);
+    state.Sync(dest_h.v);
+    state.Sync(word_count.v);
+    state.Sync(control.v);
+    state.Sync(source);
+    state.Sync(dest);
+    state.Sync(remaining_chunks);
+    state.Sync(bad_source);
+    state.Sync(paused);
+    state.Sync(starting);
+    state.EndChunk();
+}
+
 } // End namespace Gba
@@ -20,6 +20,8 @@
 #include "gba/memory/IOReg.h"
 #include "gba/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gba {
 
 class Core;
@@ -45,6 +47,10 @@ public:
     void WriteControl(const u16 data, const u16 mask);
     bool Active() const { return (control & enable) && !paused; }
     void Trigger(DmaTiming event);
+    // Triggers a DMA1 or DMA2 sound FIFO transfer if this channel's destination is the given FIFO.
+    void TriggerSoundFifo(u32 fifo_addr);
+
+    void Serialize(Common::StateBuffer& state);
 
 private:
     const int id;
@@ -61,6 +67,9 @@ private:
     void ReloadWordCount();
     template<typename T>
     int Transfer(AccessType sequential);
+    // Runs as many sequential transfers as fit before the next hardware event, and sets chunks to the number run.
+    template<typename T>
+    int BulkTransfer(int& chunks);
 
     // Control flags
     static constexpr u16 repeat     = 0x0200;
@@ -75,8 +84,15 @@ private:
 
     int DestControl() const { return (control >> 5) & 0x3; }
     int SourceControl() const { return (control >> 7) & 0x3; }
-    int TransferWidth() const { return (control & 0x0400) ? 4 : 2; }
+    int TransferWidth() const { return ((control & 0x0400) || SoundFifoMode()) ? 4 : 2; }
     int StartTiming() const { return (control >> 12) & 0x3; }
+    // Special timing on DMA1 and DMA2 always transfers four words to a fixed address, ignoring the word count.
+    bool SoundFifoMode() const { return (id == 1 || id == 2) && StartTiming() == Special; }
+
+    int SourceStep() const;
+    int DestStep() const;
+    // DMA3 streams EEPROM commands in and read results out one bit per halfword.
+    bool EepromTransfer() const;
 };
 
 } // End namespace Gba
@@ -18,6 +18,7 @@
 #include "gba/core/Core.h"
 #include "gba/core/Enums.h"
 #include "gba/memory/Memory.h"
+#include "common/StateBuffer.h"
 
 namespace Gba {
 
@@ -44,4 +45,13 @@ void Keypad::CheckKeypadInterrupt() {
     already_requested = interrupt_requested;
 }
 
+void Keypad::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("KEY ", 1);
+    state.Sync(input.v);
+    state.Sync(control.v);
+    state.Sync(already_requested);
+    state.Sync(was_unset);
+    state.EndChunk();
+}
+
 } // End namespace Gba
@@ -19,6 +19,8 @@
 #include "common/CommonTypes.h"
 #include "gba/memory/IOReg.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gba {
 
 class Core;
@@ -42,6 +44,7 @@ public:
                        L      = 0x0200};
 
     void CheckKeypadInterrupt();
+    void Serialize(Common::StateBuffer& state);
     void Press(Button button, bool pressed) {
         if (pressed) {
             // When pressing a directional button, record if the opposite direction was currently pressed and
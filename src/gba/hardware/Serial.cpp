@@ -0,0 +1,116 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gba/hardware/Serial.h"
+#include "gba/core/Core.h"
+#include "gba/core/Enums.h"
+#include "gba/core/Scheduler.h"
+#include "gba/memory/Memory.h"
+#include "common/LinkCable.h"
+#include "common/StateBuffer.h"
+
+namespace Gba {
+
+Serial::Serial(Core& _core)
+        : core(_core) {}
+
+void Serial::WriteControl(u16 data, u16 mask) {
+    const bool was_active = control & cnt_start;
+    control.Write(data, mask);
+
+    if (!NormalMode()) {
+        return;
+    }
+
+    if (!(control & cnt_start)) {
+        core.scheduler->Deschedule(EventType::SerialTransfer);
+    } else if (!was_active && UsingInternalClock()) {
+        // When we supply the clock, the other side's data is exchanged for ours as the transfer starts. It only
+        // shows up in the data registers once all the bits have been shifted, at 256KHz or 2MHz.
+        incoming_data = (link != nullptr) ? link->Transfer(OutgoingData()) : Common::LinkCable::disconnected_data;
+
+        const int cycles_per_bit = (control & cnt_fast_clock) ? 8 : 64;
+        core.scheduler->Schedule(EventType::SerialTransfer, TransferBits() * cycles_per_bit);
+    }
+
+    // With the external clock, the transfer waits for the other side to start one.
+}
+
+void Serial::AttachLinkCable(Common::LinkCable* cable) {
+    link = cable;
+
+    if (link != nullptr) {
+        core.scheduler->Schedule(EventType::SerialPoll, link_poll_period);
+    } else {
+        core.scheduler->Deschedule(EventType::SerialPoll);
+    }
+}
+
+u32 Serial::OutgoingData() const {
+    return (control & cnt_32bit) ? (data0 | (static_cast<u32>(data1) << 16)) : (send & 0xFF);
+}
+
+void Serial::FinishTransfer() {
+    LatchData(incoming_data);
+}
+
+void Serial::LatchData(u32 received) {
+    if (control & cnt_32bit) {
+        data0 = received & 0xFFFF;
+        data1 = received >> 16;
+    } else {
+        send = (send & 0xFF00) | (received & 0xFF);
+    }
+
+    control.v &= ~cnt_start;
+    if (control & cnt_irq_enable) {
+        core.mem->RequestInterrupt(Interrupt::Serial);
+    }
+}
+
+void Serial::PollLink(int cycles_late) {
+    if (link == nullptr) {
+        return;
+    }
+
+    const bool waiting = NormalMode() && (control & cnt_start) && !UsingInternalClock();
+
+    // If we aren't waiting on an externally clocked transfer, the other side still gets a reply, but nothing is
+    // shifted on this side.
+    u32 received;
+    if (link->Respond(waiting ? OutgoingData() : Common::LinkCable::disconnected_data, received) && waiting) {
+        LatchData(received);
+    }
+
+    core.scheduler->Schedule(EventType::SerialPoll, link_poll_period - cycles_late);
+}
+
+void Serial::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("SIO ", 2);
+    for (auto reg : {&data0, &data1, &data2, &data3, &control, &send, &mode, &joybus_control, &joybus_recv_l,
+                     &joybus_recv_h, &joybus_trans_l, &joybus_trans_h, &joybus_status}) {
+        state.Sync(reg->v);
+    }
+    state.Sync(incoming_data);
+    state.EndChunk();
+
+    // Whether a cable is attached isn't part of the emulated machine, so keep polling it (or not) across loads.
+    if (state.Loading()) {
+        AttachLinkCable(link);
+    }
+}
+
+} // End namespace Gba
@@ -19,13 +19,15 @@
 #include "common/CommonTypes.h"
 #include "gba/memory/IOReg.h"
 
+namespace Common { class StateBuffer; class LinkCable; }
+
 namespace Gba {
 
 class Core;
 
 class Serial {
 public:
-    Serial(Core&) {}
+    Serial(Core& _core);
 
     IOReg data0          = {0x0000, 0xFFFF, 0xFFFF};
     IOReg data1          = {0x0000, 0xFFFF, 0xFFFF};
@@ -48,8 +50,42 @@ public:
     static constexpr u16 joystat_trans     = 0x8;
     static constexpr u16 joystat_recv      = 0x2;
 
+    void WriteControl(u16 data, u16 mask);
+
+    // Only normal mode transfers go over the cable. With no cable attached, the serial port behaves as if nothing
+    // is plugged into it.
+    void AttachLinkCable(Common::LinkCable* cable);
+
+    // Runs the scheduled end of a transfer we clock.
+    void FinishTransfer();
+    // Runs the scheduled check for transfers clocked by the other side.
+    void PollLink(int cycles_late);
+
+    void Serialize(Common::StateBuffer& state);
+
 private:
-    //Core& core;
+    Core& core;
+
+    Common::LinkCable* link = nullptr;
+    // The other side's data, which is latched into the data registers when a transfer we clock finishes.
+    u32 incoming_data = 0xFFFF'FFFF;
+
+    // While a cable is attached, it's checked for transfers clocked by the other side this often.
+    static constexpr int link_poll_period = 1024;
+
+    static constexpr u16 cnt_internal_clock = 0x0001;
+    static constexpr u16 cnt_fast_clock     = 0x0002;
+    static constexpr u16 cnt_start          = 0x0080;
+    static constexpr u16 cnt_32bit          = 0x1000;
+    static constexpr u16 cnt_irq_enable     = 0x4000;
+
+    // Multiplayer, UART, and the general purpose and JOY Bus modes aren't emulated.
+    bool NormalMode() const { return !(mode & 0x8000) && !(control & 0x2000); }
+    bool UsingInternalClock() const { return control & cnt_internal_clock; }
+    int TransferBits() const { return (control & cnt_32bit) ? 32 : 8; }
+
+    u32 OutgoingData() const;
+    void LatchData(u32 received);
 };
 
 } // End namespace Gba
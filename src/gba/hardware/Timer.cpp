@@ -14,10 +14,14 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+
 #include "gba/hardware/Timer.h"
 #include "gba/core/Core.h"
 #include "gba/core/Enums.h"
 #include "gba/memory/Memory.h"
+#include "gba/audio/Audio.h"
+#include "common/StateBuffer.h"
 
 namespace Gba {
 
@@ -31,28 +35,9 @@ Timer::Timer(int _id, Core& _core)
     }
 }
 
-void Timer::Tick(int cycles) {
-    if (!TimerRunning() || CascadeEnabled()) {
-        timer_clock += cycles;
-        return;
-    }
-
-    while (cycles-- > 0) {
-        timer_clock += 1;
-        if (delay > 0) {
-            delay -= 1;
-            continue;
-        }
-
-        if ((timer_clock & (CyclesPerTick() - 1)) == 0) {
-            CounterTick();
-        }
-    }
-}
-
 int Timer::CyclesPerTick() const {
     const int prescaler_select = control & 0x0003;
-    
+
     if (prescaler_select == 0) {
         return 1;
     } else {
@@ -60,21 +45,85 @@ int Timer::CyclesPerTick() const {
     }
 }
 
-void Timer::CounterTick() {
+u32 Timer::CounterAt(u64 timestamp) const {
+    if (!Counting() || timestamp < next_tick) {
+        return counter;
+    }
+
+    u64 value = counter + (timestamp - next_tick) / CyclesPerTick() + 1;
+    if (value > 0xFFFF) {
+        // Read by another event before this timer's overflow event has run.
+        value = reload + (value - 0x1'0000) % (0x1'0000 - reload);
+    }
+
+    return static_cast<u32>(value);
+}
+
+u16 Timer::ReadCounter() const {
+    return CounterAt(core.scheduler->Timestamp());
+}
+
+void Timer::SyncCounter(u64 timestamp) {
+    counter = CounterAt(timestamp);
+
+    // Ticks happen on multiples of the prescaler period, which is a power of two.
+    const u64 period = CyclesPerTick();
+    next_tick = (std::max(timestamp + 1, start_time) + period - 1) & ~(period - 1);
+}
+
+void Timer::ScheduleOverflow(u64 timestamp) {
+    if (!Counting()) {
+        core.scheduler->Deschedule(OverflowEvent());
+        return;
+    }
+
+    const u64 overflow_time = next_tick + static_cast<u64>(0xFFFF - counter) * CyclesPerTick();
+    // If an overflow was due in the past, the negative delay makes the scheduler run it straight away.
+    core.scheduler->Schedule(OverflowEvent(), static_cast<int>(overflow_time - timestamp));
+}
+
+void Timer::Overflow(int cycles_late) {
+    const u64 now = core.scheduler->Timestamp();
+    const u64 overflow_time = now - cycles_late;
+
+    counter = reload;
+    next_tick = overflow_time + CyclesPerTick();
+    ScheduleOverflow(now);
+
+    OverflowActions(overflow_time);
+}
+
+void Timer::CounterTick(u64 timestamp) {
+    if (!TimerRunning() || !CascadeEnabled()) {
+        return;
+    }
+
     if (++counter == 0) {
         counter = reload;
+        OverflowActions(timestamp);
+    }
+}
+
+void Timer::OverflowActions(u64 timestamp) {
+    if (InterruptEnabled()) {
+        core.mem->RequestInterrupt(Interrupt::Timer0 << id);
+    }
 
-        if (InterruptEnabled()) {
-            core.mem->RequestInterrupt(Interrupt::Timer0 << id);
-        }
+    if (id < 2) {
+        // Timers 0 and 1 clock the sound FIFOs.
+        core.audio->TimerOverflow(id, timestamp);
+    }
 
-        if (id < 3 && core.timers[id + 1].TimerRunning() && core.timers[id + 1].CascadeEnabled()) {
-            core.timers[id + 1].CounterTick();
-        }
+    if (id < 3) {
+        core.timers[id + 1].CounterTick(timestamp);
     }
 }
 
 void Timer::WriteControl(const u16 data, const u16 mask) {
+    const u64 now = core.scheduler->Timestamp();
+    // Count the ticks made with the old settings.
+    SyncCounter(now);
+
     bool was_stopped = !TimerRunning();
     control.Write(data, mask);
 
@@ -82,20 +131,21 @@ void Timer::WriteControl(const u16 data, const u16 mask) {
         // The counter is reloaded when a timer is enabled.
         counter = reload;
         // Timers have a two cycle start up delay.
-        delay = 2;
+        start_time = now + 3;
     }
+
+    SyncCounter(now);
+    ScheduleOverflow(now);
 }
 
-int Timer::NextEvent() const {
-    if (!TimerRunning()) {
-        return 0;
-    } else if (CascadeEnabled()) {
-        return core.timers[id - 1].NextEvent();
-    } else {
-        int remaining_cycles_this_tick = CyclesPerTick() - (timer_clock & (CyclesPerTick() - 1));
-        int remaining_ticks = (0xFFFF - counter) * CyclesPerTick();
-        return delay + remaining_cycles_this_tick + remaining_ticks;
-    }
+void Timer::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("TMR ", 2);
+    state.Sync(counter.v);
+    state.Sync(reload.v);
+    state.Sync(control.v);
+    state.Sync(next_tick);
+    state.Sync(start_time);
+    state.EndChunk();
 }
 
 } // End namespace Gba
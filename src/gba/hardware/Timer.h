@@ -18,6 +18,9 @@
 
 #include "common/CommonTypes.h"
 #include "gba/memory/IOReg.h"
+#include "gba/core/Scheduler.h"
+
+namespace Common { class StateBuffer; }
 
 namespace Gba {
 
@@ -27,26 +30,44 @@ class Timer {
 public:
     Timer(int _id, Core& _core);
 
+    // While the timer is counting, this holds the counter value as of the last sync rather than the current value.
     IOReg counter = {0x0000, 0xFFFF, 0x0000};
     IOReg reload  = {0x0000, 0x0000, 0xFFFF};
     IOReg control = {0x0000, 0x00C7, 0x00C7};
 
     const int id;
 
-    void Tick(int cycles);
-    void CounterTick();
+    u16 ReadCounter() const;
     void WriteControl(const u16 data, const u16 mask);
     bool CascadeEnabled() const { return control & 0x0004; }
-    int NextEvent() const;
+
+    // Runs the scheduled overflow of a counting timer.
+    void Overflow(int cycles_late);
+    // Clocks a cascaded timer when the previous timer overflows.
+    void CounterTick(u64 timestamp);
+
+    void Serialize(Common::StateBuffer& state);
 private:
     Core& core;
 
-    u32 timer_clock = 0;
-    int delay = 0;
+    // A timer which is running and not cascaded ticks on every cycle which is a multiple of its prescaler period,
+    // starting at next_tick. Rather than being clocked, its value is computed when read, and its overflows are
+    // scheduled as events.
+    u64 next_tick = 0;
+    // Timers have a two cycle start up delay, so they don't tick before this.
+    u64 start_time = 0;
 
     bool TimerRunning() const { return control & 0x0080; }
     bool InterruptEnabled() const { return control & 0x0040; }
+    bool Counting() const { return TimerRunning() && !CascadeEnabled(); }
     int CyclesPerTick() const;
+    EventType OverflowEvent() const { return static_cast<EventType>(static_cast<int>(EventType::Timer0Overflow) + id); }
+
+    u32 CounterAt(u64 timestamp) const;
+    // Folds the ticks up to now into the counter, and finds the next tick with the current prescaler.
+    void SyncCounter(u64 timestamp);
+    void ScheduleOverflow(u64 timestamp);
+    void OverflowActions(u64 timestamp);
 };
 
 } // End namespace Gba
@@ -18,6 +18,8 @@
 
 #include "gba/lcd/Bg.h"
 #include "gba/lcd/Lcd.h"
+#include "common/StateBuffer.h"
+#include "common/Timing.h"
 
 namespace Gba {
 
@@ -87,19 +89,16 @@ void Bg::ReadTileData(std::vector<BgTile>& input_tiles) const {
     for (auto& tile : input_tiles) {
         const int tile_addr = TileBase() + tile.num * tile_bytes;
         if (tile_addr < Lcd::sprite_tile_base) {
-            for (int i = 0; i < tile_bytes; i += 2) {
-                tile.data[i] = lcd.vram[(tile_addr + i) / 2];
-                tile.data[i + 1] = lcd.vram[(tile_addr + i) / 2] >> 8;
-            }
+            tile.data = &lcd.tile_cache.Get(tile_addr, SinglePalette());
         } else {
             // Tiles in OBJ VRAM cannot be used for backgrounds.
-            std::fill_n(tile.data.begin(), tile_bytes, 0x8000);
-            continue;
+            tile.data = &TileCache::blank_tile;
         }
     }
 }
 
 void Bg::DrawRegularScanline() {
+    TIMING_SCOPE(Bg);
     if (Mosaic() && lcd.vcount % lcd.MosaicBgV() != 0) {
         // Reuse the previous scanline.
         return;
@@ -120,7 +119,7 @@ void Bg::DrawRegularScanline() {
         tile_index = (tile_index + 1) % horizontal_tiles;
         const int flip_row = tile.v_flip ? (7 - pixel_row) : pixel_row;
 
-        const std::array<u16, 8> pixel_colours = lcd.GetTilePixels(tile.data, SinglePalette(), tile.h_flip,
+        const std::array<u16, 8> pixel_colours = lcd.GetTilePixels(*tile.data, SinglePalette(), tile.h_flip,
                                                                    flip_row, tile.palette, 0);
 
         // The first and last tiles may be partially scrolled off-screen.
@@ -138,112 +137,169 @@ void Bg::DrawRegularScanline() {
     }
 }
 
+int Bg::ReadVramByte(int addr) const {
+    // The lower byte of each halfword is at the even address.
+    return (lcd.vram[addr / 2] >> (8 * (addr & 0x1))) & 0xFF;
+}
+
 void Bg::DrawAffineScanline() {
+    TIMING_SCOPE(Bg);
     // Affine parameters.
     const int pa = SignExtend<u32>(affine_a, 16);
     const int pb = SignExtend<u32>(affine_b, 16);
     const int pc = SignExtend<u32>(affine_c, 16);
     const int pd = SignExtend<u32>(affine_d, 16);
 
-    const int bg_tile_width = 16 << ScreenSize();
-    const int bg_pixel_width = bg_tile_width * 8;
-
-    int scanline_index = 0;
-    while (scanline_index < Lcd::h_pixels) {
-        int tex_x = (pa * scanline_index + ref_point_x) >> 8;
-        int tex_y = (pc * scanline_index + ref_point_y) >> 8;
-
-        if (tex_x >= bg_pixel_width || tex_x < 0 || tex_y >= bg_pixel_width || tex_y < 0) {
-            if (WrapAround()) {
-                tex_x %= bg_pixel_width;
-                tex_y %= bg_pixel_width;
-
-                if (tex_x < 0) {
-                    tex_x += bg_pixel_width;
-                }
-                if (tex_y < 0) {
-                    tex_y += bg_pixel_width;
-                }
-            } else {
-                // Out-of-bounds texels are transparent.
-                scanline[scanline_index++] = Lcd::alpha_bit;
-                continue;
-            }
-        }
+    if (WrapAround()) {
+        DrawAffineTiles<true>(pa, pc);
+    } else {
+        DrawAffineTiles<false>(pa, pc);
+    }
 
-        const int tile_row = tex_y / 8;
-        const int tile_index = tile_row * bg_tile_width + tex_x / 8;
+    ref_point_x += pb;
+    ref_point_y += pd;
+}
 
-        const int map_addr = MapBase() + tile_index;
-        int hi_shift = 8 * (map_addr & 0x1);
+void Bg::SkipAffineScanline() {
+    const int pb = SignExtend<u32>(affine_b, 16);
+    const int pd = SignExtend<u32>(affine_d, 16);
 
-        const u8 tile_num = (lcd.vram[map_addr / 2] >> hi_shift) & 0xFF;
+    ref_point_x += pb;
+    ref_point_y += pd;
+}
 
-        // Affine backgrounds can only use single-palette mode.
-        constexpr int tile_bytes = 64;
-        const int tile_addr = TileBase() + tile_num * tile_bytes;
+template <bool wrap>
+void Bg::DrawAffineTiles(const int pa, const int pc) {
+    const int bg_tile_width = 16 << ScreenSize();
+    // Affine backgrounds are square with a power of two size, so wrapping and bounds checks are just masks.
+    const int bg_pixel_mask = bg_tile_width * 8 - 1;
+    const int map_base = MapBase();
+    const int tile_base = TileBase();
+
+    int x = ref_point_x;
+    int y = ref_point_y;
+    for (int i = 0; i < Lcd::h_pixels; ++i, x += pa, y += pc) {
+        int tex_x = x >> 8;
+        int tex_y = y >> 8;
+
+        if (wrap) {
+            tex_x &= bg_pixel_mask;
+            tex_y &= bg_pixel_mask;
+        } else if ((tex_x | tex_y) & ~bg_pixel_mask) {
+            // Out-of-bounds texels are transparent.
+            scanline[i] = Lcd::alpha_bit;
+            continue;
+        }
 
-        const int pixel_row = tex_y % 8;
-        const int pixel_addr = tile_addr + pixel_row * 8 + tex_x % 8;
-        hi_shift = 8 * (pixel_addr & 0x1);
+        const int tile_num = ReadVramByte(map_base + (tex_y / 8) * bg_tile_width + tex_x / 8);
 
-        const u8 palette_entry = (lcd.vram[pixel_addr / 2] >> hi_shift) & 0xFF;
-        if (palette_entry == 0) {
-            // Palette entry 0 is transparent.
-            scanline[scanline_index] = Lcd::alpha_bit;
-        } else {
-            scanline[scanline_index] = lcd.pram[palette_entry] & 0x7FFF;
-        }
+        // Affine backgrounds can only use single-palette mode.
+        const int palette_entry = ReadVramByte(tile_base + tile_num * 64 + (tex_y % 8) * 8 + tex_x % 8);
 
-        scanline_index += 1;
+        // Palette entry 0 is transparent.
+        scanline[i] = (palette_entry == 0) ? Lcd::alpha_bit : (lcd.pram[palette_entry] & 0x7FFF);
     }
-
-    ref_point_x += pb;
-    ref_point_y += pd;
 }
 
 void Bg::DrawBitmapScanline(int bg_mode, int base_addr) {
+    TIMING_SCOPE(Bg);
     // Affine parameters.
     const int pa = SignExtend<u32>(affine_a, 16);
     const int pb = SignExtend<u32>(affine_b, 16);
     const int pc = SignExtend<u32>(affine_c, 16);
     const int pd = SignExtend<u32>(affine_d, 16);
 
-    int scanline_index = 0;
-    while (scanline_index < Lcd::h_pixels) {
-        int tex_x = ((pa * scanline_index + ref_point_x) >> 8);
-        int tex_y = ((pc * scanline_index + ref_point_y) >> 8);
+    if (bg_mode == 3) {
+        DrawDirectColourBitmap(0, Lcd::h_pixels, Lcd::v_pixels, pa, pc);
+    } else if (bg_mode == 4) {
+        DrawPalettedBitmap(base_addr, pa, pc);
+    } else if (bg_mode == 5) {
+        DrawDirectColourBitmap(base_addr / 2, 160, 128, pa, pc);
+    }
+
+    ref_point_x += pb;
+    ref_point_y += pd;
+}
+
+void Bg::DrawDirectColourBitmap(const int base_index, const int width, const int height, const int pa, const int pc) {
+    if (pa == 0x100 && pc == 0) {
+        // Unscaled and unrotated lines are a straight copy from VRAM.
+        scanline.fill(Lcd::alpha_bit);
 
-        if (tex_x >= Lcd::h_pixels || tex_x < 0 || tex_y >= Lcd::v_pixels || tex_y < 0) {
+        const int tex_x = ref_point_x >> 8;
+        const int tex_y = ref_point_y >> 8;
+        if (tex_y < 0 || tex_y >= height) {
+            return;
+        }
+
+        const int first = std::max(0, -tex_x);
+        const int last = std::min(static_cast<int>(Lcd::h_pixels), width - tex_x);
+        if (first < last) {
+            const auto row = lcd.vram.cbegin() + base_index + tex_y * width + tex_x;
+            std::transform(row + first, row + last, scanline.begin() + first,
+                           [](u16 colour) -> u16 { return colour & 0x7FFF; });
+        }
+        return;
+    }
+
+    int x = ref_point_x;
+    int y = ref_point_y;
+    for (int i = 0; i < Lcd::h_pixels; ++i, x += pa, y += pc) {
+        const int tex_x = x >> 8;
+        const int tex_y = y >> 8;
+
+        if (static_cast<unsigned>(tex_x) >= static_cast<unsigned>(width)
+                || static_cast<unsigned>(tex_y) >= static_cast<unsigned>(height)) {
             // Out-of-bounds texels are transparent.
-            scanline[scanline_index++] = Lcd::alpha_bit;
-            continue;
+            scanline[i] = Lcd::alpha_bit;
+        } else {
+            scanline[i] = lcd.vram[base_index + tex_y * width + tex_x] & 0x7FFF;
         }
+    }
+}
 
-        if (bg_mode == 3) {
-            scanline[scanline_index++] = lcd.vram[tex_y * Lcd::h_pixels + tex_x] & 0x7FFF;
-        } else if (bg_mode == 4) {
-            // The lower byte is the palette index for even pixels, and the upper byte is for odd pixels.
-            const int pixel_addr = base_addr + tex_y * Lcd::h_pixels + tex_x;
-            const int odd_shift = 8 * (pixel_addr & 0x1);
-            const u8 palette_entry = lcd.vram[pixel_addr / 2] >> odd_shift;
-            if (palette_entry == 0) {
-                // Palette entry 0 is transparent.
-                scanline[scanline_index++] = Lcd::alpha_bit;
-            } else {
-                scanline[scanline_index++] = lcd.pram[palette_entry] & 0x7FFF;
-            }
-        } else if (bg_mode == 5) {
-            if (tex_x >= 160 || tex_x < 0 || tex_y >= 128 || tex_y < 0) {
-                scanline[scanline_index++] = Lcd::alpha_bit;
-            } else {
-                scanline[scanline_index++] = lcd.vram[base_addr + tex_y * 160 + tex_x] & 0x7FFF;
-            }
+void Bg::DrawPalettedBitmap(const int base_addr, const int pa, const int pc) {
+    int x = ref_point_x;
+    int y = ref_point_y;
+    for (int i = 0; i < Lcd::h_pixels; ++i, x += pa, y += pc) {
+        const int tex_x = x >> 8;
+        const int tex_y = y >> 8;
+
+        if (static_cast<unsigned>(tex_x) >= static_cast<unsigned>(Lcd::h_pixels)
+                || static_cast<unsigned>(tex_y) >= static_cast<unsigned>(Lcd::v_pixels)) {
+            // Out-of-bounds texels are transparent.
+            scanline[i] = Lcd::alpha_bit;
+            continue;
         }
+
+        // Palette entry 0 is transparent.
+        const int palette_entry = ReadVramByte(base_addr + tex_y * Lcd::h_pixels + tex_x);
+        scanline[i] = (palette_entry == 0) ? Lcd::alpha_bit : (lcd.pram[palette_entry] & 0x7FFF);
     }
+}
 
-    ref_point_x += pb;
-    ref_point_y += pd;
+void Bg::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("BG  ", 1);
+    state.Sync(control.v);
+    state.Sync(scroll_x.v);
+    state.Sync(scroll_y.v);
+    state.Sync(affine_a.v);
+    state.Sync(affine_b.v);
+    state.Sync(affine_c.v);
+    state.Sync(affine_d.v);
+    state.Sync(offset_x_l.v);
+    state.Sync(offset_x_h.v);
+    state.Sync(offset_y_l.v);
+    state.Sync(offset_y_h.v);
+    state.Sync(ref_point_x);
+    state.Sync(ref_point_y);
+    state.Sync(enable_delay);
+    state.EndChunk();
+
+    if (state.Loading()) {
+        previous_row_num = 0xFF;
+        dirty = true;
+    }
 }
 
 } // End namespace Gba
@@ -22,13 +22,14 @@
 #include "common/CommonTypes.h"
 #include "common/CommonFuncs.h"
 #include "gba/memory/IOReg.h"
+#include "gba/lcd/TileCache.h"
+
+namespace Common { class StateBuffer; }
 
 namespace Gba {
 
 class Lcd;
 
-using Tile = std::array<u8, 64>;
-
 struct BgTile {
     BgTile(u16 map_entry)
             : num(map_entry & 0x3FF)
@@ -41,7 +42,7 @@ struct BgTile {
     bool v_flip;
     int palette;
 
-    Tile data;
+    const Tile* data = &TileCache::blank_tile;
 };
 
 class Bg {
@@ -82,6 +83,8 @@ public:
     void DrawRegularScanline();
     void DrawAffineScanline();
     void DrawBitmapScanline(int bg_mode, int base_addr);
+    // Steps the reference point to the next scanline, as drawing an affine or bitmap scanline does.
+    void SkipAffineScanline();
 
     void LatchReferencePointX() { ref_point_x = SignExtend((static_cast<u32>(offset_x_h) << 16) | offset_x_l, 28); }
     void LatchReferencePointY() { ref_point_y = SignExtend((static_cast<u32>(offset_y_h) << 16) | offset_y_l, 28); }
@@ -92,6 +95,8 @@ public:
 
     void DumpBg() const;
 
+    void Serialize(Common::StateBuffer& state);
+
 private:
     const Lcd& lcd;
 
@@ -101,6 +106,13 @@ private:
     s32 ref_point_y;
 
     void ReadTileMapRow();
+
+    template <bool wrap>
+    void DrawAffineTiles(const int pa, const int pc);
+    void DrawDirectColourBitmap(const int base_index, const int width, const int height, const int pa, const int pc);
+    void DrawPalettedBitmap(const int base_addr, const int pa, const int pc);
+
+    int ReadVramByte(int addr) const;
     void ReadTileData(std::vector<BgTile>& input_tiles) const;
 
     std::vector<BgTile> ReadEntireTileMap() const;
@@ -43,6 +43,10 @@ void Lcd::DumpDebugInfo() const {
 void Lcd::DumpSprites() const {
     std::vector<u16> sprite_buffer;
     for (std::size_t s = 0; s < sprites.size(); ++s) {
+        if (!sprite_active[s]) {
+            continue;
+        }
+
         const auto& sprite = sprites[s];
 
         sprite_buffer.resize(sprite.pixel_width * sprite.pixel_height);
@@ -67,7 +71,7 @@ void Lcd::DumpSprites() const {
             }
 
             while (scanline_index < sprite.pixel_width) {
-                const auto& tile = sprite.tiles[tile_index];
+                const auto& tile = *sprite.tiles[tile_index];
                 tile_index += tile_direction;
                 const std::array<u16, 8> pixel_colours = GetTilePixels(tile, sprite.single_palette, sprite.h_flip,
                                                                        pixel_row, sprite.palette, 256);
@@ -164,7 +168,7 @@ void Bg::DumpBg() const {
             const int pixel_row = (vertical_index) % 8;
             const int flip_row = tile.v_flip ? (7 - pixel_row) : pixel_row;
 
-            std::array<u16, 8> pixel_colours = lcd.GetTilePixels(tile.data, SinglePalette(), tile.h_flip,
+            std::array<u16, 8> pixel_colours = lcd.GetTilePixels(*tile.data, SinglePalette(), tile.h_flip,
                                                                  flip_row, tile.palette, 0);
 
             DrawOverlay(pixel_colours, scanline_index, vertical_index, pixel_width, pixel_height);
@@ -233,13 +237,7 @@ void Lcd::DumpTileset(int base, bool single_palette) const {
     // Get tile data. Each tile is 32 bytes in 16 palette mode, and 64 bytes in single palette mode.
     const int tile_bytes = single_palette ? 64 : 32;
     for (int j = 0; j < 1024; ++j) {
-        const int tile_addr = base + j * tile_bytes;
-        Tile tile;
-        for (int i = 0; i < tile_bytes; i += 2) {
-            tile[i] = vram[(tile_addr + i) / 2];
-            tile[i + 1] = vram[(tile_addr + i) / 2] >> 8;
-        }
-        tileset.push_back(tile);
+        tileset.push_back(tile_cache.Get(base + j * tile_bytes, single_palette));
     }
 
     const int horizontal_tiles = 32;
@@ -262,12 +260,10 @@ void Lcd::DumpTileset(int base, bool single_palette) const {
             if (single_palette) {
                 pixel_colours = GetTilePixels(tile, single_palette, false, pixel_row, 0, 0);
             } else {
-                // Each tile byte specifies the 4-bit palette indices for two pixels.
+                // Draw 16 palette tiles in greyscale.
                 for (int i = 0; i < 8; ++i) {
-                    // The lower 4 bits are the palette index for even pixels, and the upper 4 bits are for odd pixels.
-                    const int odd_shift = 4 * (i & 0x1);
                     // Shift the palette entry left by 1 so it fills the 5 bits needed by the colour channels.
-                    const u8 palette_entry = ((tile[pixel_row * 4 + i / 2] >> odd_shift) & 0xF) << 1;
+                    const u8 palette_entry = tile[pixel_row * 8 + i] << 1;
                     if (palette_entry == 0) {
                         // Palette entry 0 is transparent.
                         pixel_colours[i] = alpha_bit;
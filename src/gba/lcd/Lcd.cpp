@@ -21,99 +21,145 @@
 #include "gba/lcd/Bg.h"
 #include "gba/core/Core.h"
 #include "gba/core/Enums.h"
+#include "gba/core/Scheduler.h"
 #include "gba/memory/Memory.h"
 #include "gba/hardware/Dma.h"
+#include "gba/lcd/RenderThread.h"
+#include "common/StateBuffer.h"
+#include "common/Timing.h"
 
 namespace Gba {
 
-Lcd::Lcd(const std::vector<u16>& _pram, const std::vector<u16>& _vram, const std::vector<u32>& _oam, Core& _core)
+Lcd::Lcd(const Common::ArenaArray<u16>& _pram, const Common::ArenaArray<u16>& _vram,
+         const Common::ArenaArray<u32>& _oam, Core& _core, bool render_only)
         : bgs{{0, *this}, {1, *this}, {2, *this}, {3, *this}}
         , windows(2)
         , pram(_pram)
         , vram(_vram)
         , oam(_oam)
+        , tile_cache(vram)
         , core(_core)
-        , back_buffer(h_pixels * v_pixels, 0x7FFF) {}
+        , back_buffer(h_pixels * v_pixels, 0x7FFF)
+        , sprite_tile_pool(num_sprites * Sprite::max_tiles, &TileCache::blank_tile) {
+
+    oam_entry_dirty.fill(true);
+    sprite_active.fill(false);
+    for (int s = 0; s < num_sprites; ++s) {
+        sprites[s].tiles = &sprite_tile_pool[s * Sprite::max_tiles];
+    }
+
+    if (render_only) {
+        return;
+    }
+
+    core.scheduler->RegisterHandler(EventType::HBlank,     [this](int cycles_late) { BeginHBlank(cycles_late); });
+    core.scheduler->RegisterHandler(EventType::HBlankFlag, [this](int cycles_late) { SetHBlankFlag(cycles_late); });
+    core.scheduler->RegisterHandler(EventType::NextLine,   [this](int cycles_late) { NextLine(cycles_late); });
+
+    core.scheduler->Schedule(EventType::HBlank, hdraw_cycles);
+}
 
 // Needed to declare std::vector with forward-declared type in the header file.
 Lcd::~Lcd() = default;
 
-void Lcd::Update(int cycles) {
-    int updated_cycles = scanline_cycles + cycles;
+void Lcd::BeginHBlank(int cycles_late) {
+    core.scheduler->Schedule(EventType::HBlankFlag, hblank_flag_cycles - cycles_late);
 
-    if (scanline_cycles < 960 && updated_cycles >= 960) {
-        // Begin hblank.
-        if (status & hblank_irq) {
-            core.mem->RequestInterrupt(Interrupt::HBlank);
-        }
+    // Begin hblank.
+    if (status & hblank_irq) {
+        core.mem->RequestInterrupt(Interrupt::HBlank);
+    }
 
-        // Trigger the HBlank and Video Capture DMAs, if any are pending.
-        if (vcount < 160) {
+    // Trigger the HBlank and Video Capture DMAs, if any are pending.
+    if (vcount < 160) {
+        if (core.render_thread) {
+            core.render_thread->DrawScanline(vcount, skip_frame);
+        } else if (skip_frame) {
+            SkipScanline();
+        } else {
             DrawScanline();
-
-            for (auto& dma : core.dma) {
-                dma.Trigger(Dma::HBlank);
-            }
         }
 
-        if (vcount > 1 && vcount < 162) {
-            core.dma[3].Trigger(Dma::Special);
+        for (auto& dma : core.dma) {
+            dma.Trigger(Dma::HBlank);
         }
-    } else if (scanline_cycles < 1006 && updated_cycles >= 1006) {
-        // The hblank flag isn't set until 46 cycles into the hblank period.
-        status |= hblank_flag;
-        // TODO: mGBA triggers the HBlank IRQ and DMAs at this point instead of at 960 cycles, but higan does not.
-        // Need to do more research on the correct timing.
-    } else if (updated_cycles >= 1232) {
-        updated_cycles -= 1232;
+    }
 
-        status &= ~hblank_flag;
+    if (vcount > 1 && vcount < 162) {
+        core.dma[3].Trigger(Dma::Special);
+    }
+}
 
-        if (++vcount == 160) {
-            // Begin vblank.
-            status |= vblank_flag;
+void Lcd::SetHBlankFlag(int cycles_late) {
+    core.scheduler->Schedule(EventType::NextLine, scanline_cycles - hdraw_cycles - hblank_flag_cycles - cycles_late);
 
-            if (status & vblank_irq) {
-                core.mem->RequestInterrupt(Interrupt::VBlank);
-            }
+    // The hblank flag isn't set until 46 cycles into the hblank period.
+    status |= hblank_flag;
+    // TODO: mGBA triggers the HBlank IRQ and DMAs at this point instead of at 960 cycles, but higan does not.
+    // Need to do more research on the correct timing.
+}
 
-            for (auto& dma : core.dma) {
-                dma.Trigger(Dma::VBlank);
-            }
+void Lcd::NextLine(int cycles_late) {
+    core.scheduler->Schedule(EventType::HBlank, hdraw_cycles - cycles_late);
 
-            for (int b = 2; b < 4; ++b) {
-                bgs[b].LatchReferencePointX();
-                bgs[b].LatchReferencePointY();
-            }
+    status &= ~hblank_flag;
 
-            core.SwapBuffers(back_buffer);
-        } else if (vcount == 227) {
-            // Vblank flag is unset one scanline before vblank ends.
-            status &= ~vblank_flag;
-        } else if (vcount == 228) {
-            // Start new frame.
-            vcount = 0;
+    if (++vcount == 160) {
+        // Begin vblank.
+        status |= vblank_flag;
+
+        if (status & vblank_irq) {
+            core.mem->RequestInterrupt(Interrupt::VBlank);
+        }
+
+        for (auto& dma : core.dma) {
+            dma.Trigger(Dma::VBlank);
         }
 
-        if (vcount == VTrigger()) {
-            status |= vcount_flag;
+        core.mem->ApplyCheatWrites();
 
-            if (status & vcount_irq) {
-                core.mem->RequestInterrupt(Interrupt::VCount);
-            }
-        } else {
-            status &= ~vcount_flag;
+        for (int b = 2; b < 4; ++b) {
+            bgs[b].LatchReferencePointX();
+            bgs[b].LatchReferencePointY();
+        }
+
+        if (core.render_thread) {
+            core.render_thread->EndFrame(!skip_frame);
+        } else if (!skip_frame) {
+            core.SwapBuffers(back_buffer);
         }
+
+        UpdateFrameSkip();
+    } else if (vcount == 227) {
+        // Vblank flag is unset one scanline before vblank ends.
+        status &= ~vblank_flag;
+    } else if (vcount == 228) {
+        // Start new frame.
+        vcount = 0;
     }
 
-    scanline_cycles = updated_cycles;
+    if (vcount == VTrigger()) {
+        status |= vcount_flag;
+
+        if (status & vcount_irq) {
+            core.mem->RequestInterrupt(Interrupt::VCount);
+        }
+    } else {
+        status &= ~vcount_flag;
+    }
 }
 
 void Lcd::WriteControl(const u16 data, const u16 mask) {
     const std::array<bool, 4> was_disabled{{!bgs[0].Enabled(), !bgs[1].Enabled(),
                                             !bgs[2].Enabled(), !bgs[3].Enabled()}};
+    const bool was_mapping_1d = ObjMapping1D();
     control.Write(data, mask);
 
+    // The sprite tile pointers depend on the OBJ mapping mode.
+    if (was_mapping_1d != ObjMapping1D()) {
+        obj_dirty = true;
+    }
+
     for (int i = 0; i < 4; ++i) {
         if (was_disabled[i] && bgs[i].Enabled()) {
             if (vcount < 160 && !ForcedBlank()) {
@@ -125,17 +171,8 @@ void Lcd::WriteControl(const u16 data, const u16 mask) {
     }
 }
 
-int Lcd::NextEvent() const {
-    if (scanline_cycles < 960) {
-        return 960 - scanline_cycles;
-    } else if (scanline_cycles < 1006) {
-        return 1006 - scanline_cycles;
-    } else {
-        return 1232 - scanline_cycles;
-    }
-}
-
 void Lcd::DrawScanline() {
+    TIMING_SCOPE(Lcd);
     if (ForcedBlank()) {
         // Scanlines are drawn white when forced blank is enabled.
         std::fill_n(back_buffer.begin() + vcount * h_pixels, h_pixels, 0x7FFF);
@@ -155,7 +192,11 @@ void Lcd::DrawScanline() {
         bg_dirty = false;
     }
 
-    std::array<std::vector<const Bg*>, 4> priorities;
+    LatchColourEffects();
+
+    for (auto& priority_list : priorities) {
+        priority_list.Clear();
+    }
 
     if (BgMode() == 0) {
         for (int b = 0; b < 4; ++b) {
@@ -168,7 +209,7 @@ void Lcd::DrawScanline() {
         // If multiple backgrounds have the same priority value, the lower-numbered background has higher priority.
         for (int b = 3; b >= 0; --b) {
             if (bgs[b].Enabled()) {
-                priorities[bgs[b].Priority()].push_back(&bgs[b]);
+                priorities[bgs[b].Priority()].Push(&bgs[b]);
             }
         }
     } else if (BgMode() == 1) {
@@ -184,7 +225,7 @@ void Lcd::DrawScanline() {
 
         for (int b = 2; b >= 0; --b) {
             if (bgs[b].Enabled()) {
-                priorities[bgs[b].Priority()].push_back(&bgs[b]);
+                priorities[bgs[b].Priority()].Push(&bgs[b]);
             }
         }
     } else if (BgMode() == 2) {
@@ -196,14 +237,14 @@ void Lcd::DrawScanline() {
 
         for (int b = 3; b >= 2; --b) {
             if (bgs[b].Enabled()) {
-                priorities[bgs[b].Priority()].push_back(&bgs[b]);
+                priorities[bgs[b].Priority()].Push(&bgs[b]);
             }
         }
     } else if (BgMode() == 3 || BgMode() == 4 || BgMode() == 5) {
         // Bitmap modes.
         if (bgs[2].Enabled()) {
             bgs[2].DrawBitmapScanline(BgMode(), DisplayFrame1() ? 0xA000 : 0);
-            priorities[0].push_back(&bgs[2]);
+            priorities[0].Push(&bgs[2]);
         }
     } else {
         // It probably just doesn't draw any background in this case, but if this ever happens I'd like to know.
@@ -212,37 +253,42 @@ void Lcd::DrawScanline() {
 
     // The first palette entry is the backdrop colour.
     std::fill_n(back_buffer.begin() + vcount * h_pixels, h_pixels, pram[0] & 0x7FFF);
-    std::vector<int> pixel_layer(240, 5);
+    pixel_layer.fill(5);
+
+    // The target buffers are initialized with non-existent layer 6.
+    highest_second_target.fill(IsSecondTarget(5) ? 5 : 6);
+    highest_first_target.fill(6);
 
-    // The target vectors are initialized with non-existent layer 6.
-    std::vector<int> highest_second_target(240, IsSecondTarget(5) ? 5 : 6);
-    std::vector<int> highest_first_target(240, 6);
+    BuildWindowMask();
 
     // If alpha blending is enabled, or if semi-transparent sprites are present, calculate the highest first target
     // layer and second target layer for each pixel.
-    if (BlendMode() == Effect::AlphaBlend || semi_transparent_used) {
+    const bool alpha_blend = BlendMode() == Effect::AlphaBlend;
+    if (alpha_blend || semi_transparent_used) {
         // Inspect each enabled background, starting with the lowest priority level.
         for (int p = 3; p >= 0; --p) {
             for (const auto& bg : priorities[p]) {
+                const bool first_target = IsFirstTarget(bg->id);
+                if (!first_target && !IsSecondTarget(bg->id)) {
+                    continue;
+                }
+
+                auto& targets = (first_target) ? highest_first_target : highest_second_target;
                 for (int i = 0; i < h_pixels; ++i) {
-                    if ((bg->scanline[i] & alpha_bit) == 0) {
-                        if (IsFirstTarget(bg->id)) {
-                            highest_first_target[i] = bg->id;
-                        } else if (IsSecondTarget(bg->id)) {
-                            highest_second_target[i] = bg->id;
-                        }
-                    }
+                    targets[i] = ((bg->scanline[i] & alpha_bit) == 0) ? bg->id : targets[i];
                 }
             }
 
             if (ObjEnabled() && sprite_scanline_used[p]) {
                 // There is only one sprite layer, even though each sprite can have varying priorities. When
                 // calculating blending effects, the GBA only considers the highest priority sprite on each pixel.
+                const bool first_target = IsFirstTarget(4);
+                const bool second_target = IsSecondTarget(4);
                 for (int i = 0; i < h_pixels; ++i) {
                     if ((sprite_scanlines[p][i] & alpha_bit) == 0) {
-                        if (IsFirstTarget(4) || semi_transparent[i]) {
+                        if (first_target || semi_transparent[i]) {
                             highest_first_target[i] = 4;
-                        } else if (IsSecondTarget(4)) {
+                        } else if (second_target) {
                             highest_second_target[i] = 4;
                         }
                     }
@@ -251,87 +297,100 @@ void Lcd::DrawScanline() {
         }
     }
 
-    auto HighestTargetLayers = [&highest_first_target, &highest_second_target, &pixel_layer](int layer, int i) {
+    auto HighestTargetLayers = [this](int layer, int i) {
         return layer == highest_first_target[i] && pixel_layer[i] == highest_second_target[i];
     };
 
+    // Calls func(i, effects) for each pixel on which the windows show any of the given layers.
+    auto ForVisiblePixels = [this](u8 layer_bits, auto func) {
+        for (int s = 0; s < num_window_spans; ++s) {
+            const WindowSpan& span = window_spans[s];
+            if (span.mask & layer_bits) {
+                const bool effects = span.mask & effects_bit;
+                for (int i = span.start; i < span.end; ++i) {
+                    func(i, effects);
+                }
+            }
+        }
+    };
+
+    u16* const row = &back_buffer[vcount * h_pixels];
+
     // Draw the scanlines from each enabled background, starting with the lowest priority level.
-    std::array<int, 3> channels;
     for (int p = 3; p >= 0; --p) {
         for (const auto& bg : priorities[p]) {
-            for (int i = 0; i < h_pixels; ++i) {
-                if ((bg->scanline[i] & alpha_bit) == 0 && IsWithinWindow(bg->id, i, vcount)) {
-                    auto& buffer_pixel = back_buffer[vcount * h_pixels + i];
-
-                    if (BlendMode() == Effect::AlphaBlend && HighestTargetLayers(bg->id, i)
-                                                          && IsWithinWindow(5, i, vcount)) {
-                        for (int j = 0; j < 3; ++j) {
-                            int channel_target1 = (bg->scanline[i] >> (5 * j)) & 0x1F;
-                            int channel_target2 = (buffer_pixel >> (5 * j)) & 0x1F;
-
-                            channels[j] = Blend(channel_target1, channel_target2);
-                        }
-
-                        buffer_pixel = (channels[2] << 10) | (channels[1] << 5) | channels[0];
-                    } else {
-                        buffer_pixel = bg->scanline[i];
-                    }
-
-                    pixel_layer[i] = bg->id;
+            ForVisiblePixels(1 << bg->id, [&](int i, bool effects) {
+                const u16 pixel = bg->scanline[i];
+                if (pixel & alpha_bit) {
+                    return;
                 }
-            }
+
+                const bool blend = alpha_blend && effects && HighestTargetLayers(bg->id, i);
+                row[i] = (blend) ? Blend(pixel, row[i]) : pixel;
+                pixel_layer[i] = bg->id;
+            });
         }
 
         if (ObjEnabled() && sprite_scanline_used[p]) {
             // Draw sprites of the same priority level.
-            for (int i = 0; i < h_pixels; ++i) {
-                if ((sprite_scanlines[p][i] & alpha_bit) == 0 && IsWithinWindow(4, i, vcount)) {
-                    auto& buffer_pixel = back_buffer[vcount * h_pixels + i];
-
-                    if ((BlendMode() == Effect::AlphaBlend || semi_transparent[i]) && HighestTargetLayers(4, i)
-                                                                                   && IsWithinWindow(5, i, vcount)) {
-                        for (int j = 0; j < 3; ++j) {
-                            int channel_target1 = (sprite_scanlines[p][i] >> (5 * j)) & 0x1F;
-                            int channel_target2 = (buffer_pixel >> (5 * j)) & 0x1F;
+            ForVisiblePixels(obj_bit, [&](int i, bool effects) {
+                const u16 pixel = sprite_scanlines[p][i];
+                if (pixel & alpha_bit) {
+                    return;
+                }
 
-                            channels[j] = Blend(channel_target1, channel_target2);
-                        }
+                const bool blend = (alpha_blend || semi_transparent[i]) && effects && HighestTargetLayers(4, i);
+                if (blend) {
+                    row[i] = Blend(pixel, row[i]);
+                } else {
+                    row[i] = pixel;
 
-                        buffer_pixel = (channels[2] << 10) | (channels[1] << 5) | channels[0];
-                    } else {
-                        buffer_pixel = sprite_scanlines[p][i];
+                    // If a semi-transparent sprite blends, no other blending effects can occur on this pixel.
+                    // So if a sprite pixel doesn't blend, we remove the semi-transparent flag (if present) so
+                    // fade effects can be applied later.
+                    semi_transparent[i] = false;
+                }
 
-                        // If a semi-transparent sprite blends, no other blending effects can occur on this pixel.
-                        // So if a sprite pixel doesn't blend, we remove the semi-transparent flag (if present) so
-                        // fade effects can be applied later.
-                        semi_transparent[i] = false;
-                    }
+                pixel_layer[i] = 4;
+            });
+        }
+    }
 
-                    pixel_layer[i] = 4;
-                }
+    if (BlendMode() == Effect::Brighten || BlendMode() == Effect::Darken) {
+        const bool brighten = BlendMode() == Effect::Brighten;
+        ForVisiblePixels(effects_bit, [&](int i, bool) {
+            if (IsFirstTarget(pixel_layer[i]) && !(pixel_layer[i] == 4 && semi_transparent[i])) {
+                row[i] = (brighten) ? Brighten(row[i]) : Darken(row[i]);
             }
+        });
+    }
+
+    for (auto& bg : bgs) {
+        if (bg.enable_delay > 0) {
+            bg.enable_delay -= 1;
         }
     }
+}
 
-    if (BlendMode() == Effect::Brighten || BlendMode() == Effect::Darken) {
-        for (int i = 0; i < h_pixels; ++i) {
-            if (IsFirstTarget(pixel_layer[i]) && !(pixel_layer[i] == 4 && semi_transparent[i])
-                                              && IsWithinWindow(5, i, vcount)) {
-                auto& buffer_pixel = back_buffer[vcount * h_pixels + i];
-
-                if (BlendMode() == Effect::Brighten) {
-                    for (int j = 0; j < 3; ++j) {
-                        channels[j] = Brighten((buffer_pixel >> (5 * j)) & 0x1F);
-                    }
-                } else if (BlendMode() == Effect::Darken) {
-                    for (int j = 0; j < 3; ++j) {
-                        channels[j] = Darken((buffer_pixel >> (5 * j)) & 0x1F);
-                    }
-                }
+void Lcd::SkipScanline() {
+    if (ForcedBlank()) {
+        return;
+    }
 
-                buffer_pixel = (channels[2] << 10) | (channels[1] << 5) | channels[0];
+    if (BgMode() == 1) {
+        if (bgs[2].Enabled()) {
+            bgs[2].SkipAffineScanline();
+        }
+    } else if (BgMode() == 2) {
+        for (int b = 2; b < 4; ++b) {
+            if (bgs[b].Enabled()) {
+                bgs[b].SkipAffineScanline();
             }
         }
+    } else if (BgMode() >= 3 && BgMode() <= 5) {
+        if (bgs[2].Enabled()) {
+            bgs[2].SkipAffineScanline();
+        }
     }
 
     for (auto& bg : bgs) {
@@ -341,129 +400,162 @@ void Lcd::DrawScanline() {
     }
 }
 
-bool Lcd::IsWithinWindow(int layer_id, int x, int y) const {
+void Lcd::UpdateFrameSkip() {
+    if (++skip_frame_count >= render_skip) {
+        skip_frame_count = 0;
+        skip_frame = false;
+    } else {
+        skip_frame = true;
+    }
+}
+
+void Lcd::BuildWindowMask() {
     if (!WinEnabled(0) && !WinEnabled(1) && !ObjWinEnabled()) {
-        return true;
+        window_mask.fill(0x3F);
+        window_spans[0] = {0, h_pixels, 0x3F};
+        num_window_spans = 1;
+        return;
     }
 
-    if (WinEnabled(0) && windows[0].Contains(x, y)) {
-        return InWindowContent(0, layer_id);
-    } else if (WinEnabled(1) && windows[1].Contains(x, y)) {
-        return InWindowContent(1, layer_id);
-    } else if (ObjWinEnabled() && obj_window[x]) {
-        return InWindowContent(3, layer_id);
-    } else {
-        return InWindowContent(2, layer_id);
+    // Window 0 has the highest priority, then window 1, then the OBJ window, with WINOUT covering everything else.
+    const u8 outside_content = winout & 0x3F;
+    const u8 obj_content = (winout >> 8) & 0x3F;
+    for (int i = 0; i < h_pixels; ++i) {
+        window_mask[i] = (ObjWinEnabled() && obj_window[i]) ? obj_content : outside_content;
     }
-}
 
-bool Lcd::InWindowContent(int win_id, int layer_id) const {
-    switch (win_id) {
-    case 0:
-        return winin & (1 << layer_id);
-    case 1:
-        return (winin >> 8) & (1 << layer_id);
-    case 2:
-        return winout & (1 << layer_id);
-    case 3:
-        return (winout >> 8) & (1 << layer_id);
-    default:
-        return false;
+    for (int w = 1; w >= 0; --w) {
+        if (!WinEnabled(w) || vcount < windows[w].Top() || vcount >= windows[w].Bottom()) {
+            continue;
+        }
+
+        const u8 win_content = (winin >> (8 * w)) & 0x3F;
+        auto FillRange = [this, win_content](int begin, int end) {
+            end = std::min(end, static_cast<int>(h_pixels));
+            if (begin < end) {
+                std::fill(window_mask.begin() + begin, window_mask.begin() + end, win_content);
+            }
+        };
+
+        if (windows[w].Right() >= windows[w].Left()) {
+            FillRange(windows[w].Left(), windows[w].Right());
+        } else {
+            // The window wraps around the side of the screen.
+            FillRange(0, windows[w].Right());
+            FillRange(windows[w].Left(), h_pixels);
+        }
     }
+
+    num_window_spans = 0;
+    int start = 0;
+    for (int i = 1; i <= h_pixels; ++i) {
+        if (i == h_pixels || window_mask[i] != window_mask[start]) {
+            window_spans[num_window_spans++] = {start, i, window_mask[start]};
+            start = i;
+        }
+    }
+}
+
+void Lcd::LatchColourEffects() {
+    eva = FirstAlpha();
+    evb = SecondAlpha();
+    evy = Intensity();
 }
 
 void Lcd::ReadOam() {
-    // Only update our sprite objects if OAM has been written to.
+    // Only reparse the OAM entries which have been written to since the last scanline.
     if (oam_dirty) {
-        sprites.clear();
-
-        // Get all enabled, potentially onscreen sprites.
-        for (std::size_t i = 0; i < oam.size(); i += 2) {
-            if (!Sprite::Disabled(oam[i])) {
-                int y_pos = oam[i] & 0xFF;
-                int pixel_height = Sprite::Height(oam[i]);
-                if (y_pos + pixel_height > 0xFF) {
-                    y_pos -= 0x100;
-                }
-                if (y_pos < 160) {
-                    sprites.emplace_back(oam[i], oam[i + 1]);
-                }
+        for (int s = 0; s < num_sprites; ++s) {
+            if (!oam_entry_dirty[s]) {
+                continue;
             }
+
+            const u32 attr1 = oam[s * 2];
+            const u32 attr2 = oam[s * 2 + 1];
+            Sprite& sprite = sprites[s];
+            const Tile** tiles = sprite.tiles;
+
+            sprite = Sprite(attr1, attr2);
+            sprite.tiles = tiles;
+
+            // Only keep enabled, potentially onscreen sprites.
+            sprite_active[s] = !Sprite::Disabled(attr1) && sprite.y_pos < 160;
+            if (sprite_active[s] && !obj_dirty) {
+                GetTileData(sprite);
+            }
+
+            oam_entry_dirty[s] = false;
         }
 
-        GetTileData();
+        BuildLineSprites();
 
         oam_dirty = false;
-    } else if (obj_dirty) {
-        GetTileData();
+    }
+
+    if (obj_dirty) {
+        for (int s = 0; s < num_sprites; ++s) {
+            if (sprite_active[s]) {
+                GetTileData(sprites[s]);
+            }
+        }
+
+        obj_dirty = false;
+    }
+}
+
+void Lcd::BuildLineSprites() {
+    for (auto& line : line_sprites) {
+        line.Clear();
     }
 
     // The number of sprites that can be drawn on one scanline depends on the number of cycles each sprite takes
     // to render. The maximum rendering time is reduced if HBlank Interval Free is set.
-    const int max_render_cycles = HBlankFree() ? 954 : 1210;
-    int render_cycles_needed = 0;
-    for (auto& sprite : sprites) {
-        if (sprite.y_pos <= vcount && vcount < sprite.y_pos + sprite.pixel_height) {
-            // All sprites, including offscreen ones, contribute to rendering time.
-            if (sprite.affine) {
-                render_cycles_needed += sprite.pixel_width * 2 + 10;
-            } else {
-                render_cycles_needed += sprite.pixel_width;
-            }
+    std::array<int, v_pixels> render_cycles_needed{};
+    for (int s = 0; s < num_sprites; ++s) {
+        if (!sprite_active[s]) {
+            continue;
+        }
 
-            // Don't draw any more sprites once we run out of rendering cycles.
-            if (render_cycles_needed > max_render_cycles) {
-                sprite.drawn = false;
-                continue;
-            }
+        const Sprite& sprite = sprites[s];
+        const int first_line = std::max(sprite.y_pos, 0);
+        const int last_line = std::min(sprite.y_pos + sprite.pixel_height, static_cast<int>(v_pixels));
 
-            // Only onscreen sprites will actually be drawn.
-            // In bitmap BG modes, attempts to use sprite tiles < 512 are not displayed.
-            if (sprite.x_pos < h_pixels && sprite.x_pos + sprite.pixel_width >= 0
-                    && (BgMode() < 3 || sprite.tile_num >= 512)) {
-                sprite.drawn = true;
+        // All sprites, including offscreen ones, contribute to rendering time.
+        const bool onscreen = sprite.x_pos < h_pixels && sprite.x_pos + sprite.pixel_width >= 0;
+        for (int y = first_line; y < last_line; ++y) {
+            render_cycles_needed[y] += sprite.render_cycles;
+            if (onscreen && render_cycles_needed[y] <= max_render_cycles) {
+                line_sprites[y].Push(s, render_cycles_needed[y] <= max_render_cycles_hblank_free);
             }
-        } else {
-            sprite.drawn = false;
         }
     }
 }
 
-void Lcd::GetTileData() {
+void Lcd::GetTileData(Sprite& sprite) {
     // Each tile is 32 bytes in 16 palette mode, and 64 bytes in single palette mode.
-    for (auto& sprite : sprites) {
-        int tile_bytes = 32;
-        if (sprite.single_palette) {
-            tile_bytes = 64;
-            sprite.tile_num &= ~0x1;
-        }
-
-        if (ObjMapping1D()) {
-            for (std::size_t t = 0; t < sprite.tiles.size(); ++t) {
-                const int tile_addr = sprite_tile_base + sprite.tile_num * 32 + t * tile_bytes;
-                for (int i = 0; i < tile_bytes; i += 2) {
-                    sprite.tiles[t][i] = vram[(tile_addr + i) / 2];
-                    sprite.tiles[t][i + 1] = vram[(tile_addr + i) / 2] >> 8;
-                }
-            }
-        } else {
-            for (int h = 0; h < sprite.tile_height; ++h) {
-                for (int w = 0; w < sprite.tile_width; ++w) {
-                    const int tile_addr = sprite_tile_base + sprite.tile_num * 32 + h * 32 * 32 + w * tile_bytes;
-                    const int tile_index = h * sprite.tile_width + w;
-                    for (int i = 0; i < tile_bytes; i += 2) {
-                        sprite.tiles[tile_index][i] = vram[(tile_addr + i) / 2];
-                        sprite.tiles[tile_index][i + 1] = vram[(tile_addr + i) / 2] >> 8;
-                    }
-                }
+    int tile_bytes = 32;
+    if (sprite.single_palette) {
+        tile_bytes = 64;
+        sprite.tile_num &= ~0x1;
+    }
+
+    if (ObjMapping1D()) {
+        for (int t = 0; t < sprite.tile_width * sprite.tile_height; ++t) {
+            const int tile_addr = sprite_tile_base + sprite.tile_num * 32 + t * tile_bytes;
+            sprite.tiles[t] = &tile_cache.Get(tile_addr, sprite.single_palette);
+        }
+    } else {
+        for (int h = 0; h < sprite.tile_height; ++h) {
+            for (int w = 0; w < sprite.tile_width; ++w) {
+                const int tile_addr = sprite_tile_base + sprite.tile_num * 32 + h * 32 * 32 + w * tile_bytes;
+                sprite.tiles[h * sprite.tile_width + w] = &tile_cache.Get(tile_addr, sprite.single_palette);
             }
         }
     }
-
-    obj_dirty = false;
 }
 
 void Lcd::DrawSprites() {
+    TIMING_SCOPE(Sprites);
     // Only clear used sprite scanlines.
     for (int s = 0; s < 4; ++s) {
         if (sprite_scanline_used[s]) {
@@ -482,10 +574,14 @@ void Lcd::DrawSprites() {
         obj_window_used = false;
     }
 
-    for (int s = sprites.size() - 1; s >= 0; --s) {
-        const auto& sprite = sprites[s];
+    // In bitmap BG modes, attempts to use sprite tiles < 512 are not displayed.
+    const int min_tile_num = (BgMode() < 3) ? 0 : 512;
+
+    const SpriteList& line = line_sprites[vcount];
+    for (int i = line.Size(HBlankFree()) - 1; i >= 0; --i) {
+        const auto& sprite = sprites[line[i]];
 
-        if (!sprite.drawn) {
+        if (sprite.tile_num < min_tile_num) {
             continue;
         }
 
@@ -541,7 +637,7 @@ void Lcd::DrawRegularSprite(const Sprite& sprite) {
     }
 
     while (scanline_index < h_pixels && tile_index <= last_tile && tile_index >= first_tile) {
-        const auto& tile = sprite.tiles[tile_index];
+        const auto& tile = *sprite.tiles[tile_index];
         tile_index += tile_direction;
 
         std::array<u16, 8> pixel_colours = GetTilePixels(tile, sprite.single_palette, sprite.h_flip, pixel_row,
@@ -580,14 +676,12 @@ void Lcd::DrawRegularSprite(const Sprite& sprite) {
 void Lcd::DrawAffineSprite(const Sprite& sprite) {
     sprite_scanline_used[sprite.priority] = true;
 
-    const int tex_centre_x = sprite.pixel_width / 2;
-    const int tex_centre_y = sprite.pixel_height / 2;
-
-    const int sprite_centre_x = tex_centre_x + sprite.x_pos;
-    const int sprite_centre_y = tex_centre_y + sprite.y_pos;
-
-    int scanline_index = std::max(sprite.x_pos, 0);
-    const int last_sprite_pixel = std::min(sprite.x_pos + sprite.pixel_width, 240);
+    // The texture is the sprite's normal size, centred in its bounding box, which is twice as big for double size
+    // sprites.
+    const int half_width = sprite.tile_width * 4;
+    const int half_height = sprite.tile_height * 4;
+    const int sprite_centre_x = sprite.pixel_width / 2 + sprite.x_pos;
+    const int sprite_centre_y = sprite.pixel_height / 2 + sprite.y_pos;
 
     // Affine parameters.
     const int pa = static_cast<s32>(oam[sprite.affine_select * 8 + 1]) >> 16;
@@ -595,79 +689,84 @@ void Lcd::DrawAffineSprite(const Sprite& sprite) {
     const int pc = static_cast<s32>(oam[sprite.affine_select * 8 + 5]) >> 16;
     const int pd = static_cast<s32>(oam[sprite.affine_select * 8 + 7]) >> 16;
 
+    // The texture coordinates relative to the texture centre, in 8.8 fixed point, are pa * x + pb * y and
+    // pc * x + pd * y for the screen offset (x, y) from the sprite centre. Clip the span of x offsets on this line
+    // to where both fall inside the texture, so the kernel needs no bounds checks.
     const int sprite_y = vcount - sprite_centre_y;
-    const int pb_sprite_y = pb * sprite_y;
-    const int pd_sprite_y = pd * sprite_y;
+    int first_x = std::max(sprite.x_pos, 0) - sprite_centre_x;
+    int last_x = std::min(sprite.x_pos + sprite.pixel_width, h_pixels) - sprite_centre_x;
+    ClipAffineSpan(pa, pb * sprite_y, half_width, first_x, last_x);
+    ClipAffineSpan(pc, pd * sprite_y, half_height, first_x, last_x);
+    if (first_x >= last_x) {
+        return;
+    }
 
-    while (scanline_index < last_sprite_pixel) {
-        const int sprite_x = scanline_index - sprite_centre_x;
+    const AffineSpan span{first_x + sprite_centre_x, last_x + sprite_centre_x,
+                          pa * first_x + pb * sprite_y + (half_width << 8),
+                          pc * first_x + pd * sprite_y + (half_height << 8), pa, pc};
+    if (ObjWinEnabled() && sprite.mode == Sprite::Mode::ObjWindow) {
+        DrawAffineSpan<true>(sprite, span);
+    } else {
+        DrawAffineSpan<false>(sprite, span);
+    }
+}
 
-        int tex_x = ((pa * sprite_x + pb_sprite_y) >> 8) + tex_centre_x;
-        int tex_y = ((pc * sprite_x + pd_sprite_y) >> 8) + tex_centre_y;
+void Lcd::ClipAffineSpan(int slope, int offset, int half_size, int& first_x, int& last_x) {
+    // Find the x offsets where slope * x + offset lies in [-half_size, half_size) in 8.8 fixed point, and narrow
+    // [first_x, last_x) to them.
+    const int lower = -half_size * 256 - offset;
+    const int upper = half_size * 256 - offset;
+
+    // Rounds towards negative infinity, unlike integer division.
+    auto FloorDiv = [](int a, int b) { return a / b - ((a % b != 0) && ((a < 0) != (b < 0))); };
+
+    if (slope > 0) {
+        first_x = std::max(first_x, -FloorDiv(-lower, slope));
+        last_x = std::min(last_x, -FloorDiv(-upper, slope));
+    } else if (slope < 0) {
+        first_x = std::max(first_x, FloorDiv(upper, slope) + 1);
+        last_x = std::min(last_x, FloorDiv(lower, slope) + 1);
+    } else if (lower > 0 || upper <= 0) {
+        // The coordinate is constant along the line, and outside the texture.
+        last_x = first_x;
+    }
+}
 
-        if (sprite.double_size) {
-            tex_x -= sprite.pixel_width / 4;
-            tex_y -= sprite.pixel_height / 4;
+template <bool obj_window_sprite>
+void Lcd::DrawAffineSpan(const Sprite& sprite, const AffineSpan& span) {
+    // Tiles from the tile cache are already expanded to one palette entry per pixel, and the sprite's tile list
+    // already follows 1D or 2D mapping, so only the palette base differs between 4bpp and 8bpp sprites.
+    const int palette_base = (sprite.single_palette) ? 256 : 256 + sprite.palette * 16;
+    const bool semi_transparent_sprite = sprite.mode == Sprite::Mode::SemiTransparent;
+    auto& scanline = sprite_scanlines[sprite.priority];
+
+    int tex_x = span.tex_x;
+    int tex_y = span.tex_y;
+    for (int x = span.first; x < span.last; ++x, tex_x += span.pa, tex_y += span.pc) {
+        const int pixel_x = tex_x >> 8;
+        const int pixel_y = tex_y >> 8;
+        const Tile& tile = *sprite.tiles[(pixel_y / 8) * sprite.tile_width + pixel_x / 8];
+        const u8 palette_entry = tile[(pixel_y % 8) * 8 + pixel_x % 8];
+        if (palette_entry == 0) {
+            // Palette entry 0 is transparent.
+            continue;
         }
 
-        if (tex_x >= sprite.pixel_width || tex_x < 0 || tex_y >= sprite.pixel_height || tex_y < 0) {
-            scanline_index += 1;
-            continue;
-        } else if (sprite.double_size && (tex_x >= sprite.pixel_width / 2 || tex_y >= sprite.pixel_height / 2)) {
-            scanline_index += 1;
+        if (obj_window_sprite) {
+            obj_window[x] = true;
+            obj_window_used = true;
             continue;
         }
 
-        const int tile_row = tex_y / 8;
-        const int pixel_row = tex_y % 8;
-        const int tile_index = tile_row * sprite.tile_width + tex_x / 8;
-
-        if (sprite.single_palette) {
-            // Each tile byte specifies the 8-bit palette index for a pixel.
-            const int pixel_index = pixel_row * 8 + tex_x % 8;
-            const u8 palette_entry = sprite.tiles[tile_index][pixel_index];
-            if (palette_entry != 0) {
-                // Palette entry 0 is transparent.
-                if (ObjWinEnabled() && sprite.mode == Sprite::Mode::ObjWindow) {
-                    obj_window[scanline_index] = true;
-                    obj_window_used = true;
-                } else {
-                    sprite_scanlines[sprite.priority][scanline_index] = pram[256 + palette_entry] & 0x7FFF;
-
-                    // Erase sprite pixels at a lower priority than this one, since we only have one object plane.
-                    for (int j = sprite.priority + 1; j < 4; ++j) {
-                        sprite_scanlines[j][scanline_index] |= alpha_bit;
-                    }
-
-                    semi_transparent[scanline_index] = sprite.mode == Sprite::Mode::SemiTransparent;
-                    semi_transparent_used = semi_transparent_used || sprite.mode == Sprite::Mode::SemiTransparent;
-                }
-            }
-        } else {
-            // The lower 4 bits are the palette index for even pixels, and the upper 4 bits are for odd pixels.
-            const int odd_shift = 4 * ((tex_x % 8) & 0x1);
-            const int pixel_index = pixel_row * 4 + (tex_x % 8) / 2;
-            const u8 palette_entry = (sprite.tiles[tile_index][pixel_index] >> odd_shift) & 0xF;
-            if (palette_entry != 0) {
-                // Palette entry 0 is transparent.
-                if (ObjWinEnabled() && sprite.mode == Sprite::Mode::ObjWindow) {
-                    obj_window[scanline_index] = true;
-                    obj_window_used = true;
-                } else {
-                    sprite_scanlines[sprite.priority][scanline_index] = pram[256 + sprite.palette * 16 + palette_entry] & 0x7FFF;
-
-                    // Erase sprite pixels at a lower priority than this one, since we only have one object plane.
-                    for (int j = sprite.priority + 1; j < 4; ++j) {
-                        sprite_scanlines[j][scanline_index] |= alpha_bit;
-                    }
+        scanline[x] = pram[palette_base + palette_entry] & 0x7FFF;
 
-                    semi_transparent[scanline_index] = sprite.mode == Sprite::Mode::SemiTransparent;
-                    semi_transparent_used = semi_transparent_used || sprite.mode == Sprite::Mode::SemiTransparent;
-                }
-            }
+        // Erase sprite pixels at a lower priority than this one, since we only have one object plane.
+        for (int j = sprite.priority + 1; j < 4; ++j) {
+            sprite_scanlines[j][x] |= alpha_bit;
         }
 
-        scanline_index += 1;
+        semi_transparent[x] = semi_transparent_sprite;
+        semi_transparent_used = semi_transparent_used || semi_transparent_sprite;
     }
 }
 
@@ -675,35 +774,52 @@ std::array<u16, 8> Lcd::GetTilePixels(const Tile& tile, bool single_palette, boo
                                       int pixel_row, int palette, int base) const {
     std::array<u16, 8> pixel_colours;
 
-    if (single_palette) {
-        // Each tile byte specifies the 8-bit palette index for a pixel.
-        for (int i = 0; i < 8; ++i) {
-            const u8 palette_entry = tile[pixel_row * 8 + i];
-            const int pixel_index = h_flip ? (7 - i) : i;
-            if (palette_entry == 0) {
-                // Palette entry 0 is transparent.
-                pixel_colours[pixel_index] = alpha_bit;
-            } else {
-                pixel_colours[pixel_index] = pram[base + palette_entry] & 0x7FFF;
-            }
-        }
-    } else {
-        // Each tile byte specifies the 4-bit palette indices for two pixels.
-        for (int i = 0; i < 8; ++i) {
-            // The lower 4 bits are the palette index for even pixels, and the upper 4 bits are for odd pixels.
-            const int odd_shift = 4 * (i & 0x1);
-            const u8 palette_entry = (tile[pixel_row * 4 + i / 2] >> odd_shift) & 0xF;
-            const int pixel_index = h_flip ? (7 - i) : i;
-            if (palette_entry == 0) {
-                // Palette entry 0 is transparent.
-                pixel_colours[pixel_index] = alpha_bit;
-            } else {
-                pixel_colours[pixel_index] = pram[base + palette * 16 + palette_entry] & 0x7FFF;
-            }
+    // In 16 palette mode, the palette indices in the tile are offsets into the selected palette.
+    const int palette_base = (single_palette) ? base : base + palette * 16;
+    for (int i = 0; i < 8; ++i) {
+        const u8 palette_entry = tile[pixel_row * 8 + i];
+        const int pixel_index = h_flip ? (7 - i) : i;
+        if (palette_entry == 0) {
+            // Palette entry 0 is transparent.
+            pixel_colours[pixel_index] = alpha_bit;
+        } else {
+            pixel_colours[pixel_index] = pram[palette_base + palette_entry] & 0x7FFF;
         }
     }
 
     return pixel_colours;
 }
 
+void Lcd::Serialize(Common::StateBuffer& state) {
+    state.BeginChunk("LCD ", 1);
+    state.Sync(control.v);
+    state.Sync(green_swap.v);
+    state.Sync(status.v);
+    state.Sync(vcount.v);
+    state.Sync(winin.v);
+    state.Sync(winout.v);
+    state.Sync(mosaic.v);
+    state.Sync(blend_control.v);
+    state.Sync(blend_alpha.v);
+    state.Sync(blend_fade.v);
+
+    for (auto& window : windows) {
+        state.Sync(window.width.v);
+        state.Sync(window.height.v);
+    }
+
+    for (auto& bg : bgs) {
+        bg.Serialize(state);
+    }
+    state.EndChunk();
+
+    if (state.Loading()) {
+        oam_entry_dirty.fill(true);
+        oam_dirty = true;
+        obj_dirty = true;
+        bg_dirty = true;
+        tile_cache.InvalidateAll();
+    }
+}
+
 } // End namespace Gba
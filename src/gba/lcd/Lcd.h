@@ -21,17 +21,22 @@
 
 #include "common/CommonTypes.h"
 #include "common/CommonFuncs.h"
+#include "common/MemoryArena.h"
 #include "gba/memory/IOReg.h"
+#include "gba/lcd/TileCache.h"
+
+namespace Common { class StateBuffer; }
 
 namespace Gba {
 
 class Core;
 class Bg;
-
-using Tile = std::array<u8, 64>;
+class RenderThread;
 
 class Sprite {
 public:
+    // A default sprite is disabled.
+    Sprite() : Sprite(0x0000'0200, 0x0000'0000) {}
     Sprite(u32 attr1, u32 attr2)
             : y_pos(attr1 & 0xFF)
             , affine(attr1 & 0x100)
@@ -51,7 +56,7 @@ public:
             , pixel_height(Height(attr1))
             , tile_width(pixel_width / ((affine && double_size) ? 16 : 8))
             , tile_height(pixel_height / ((affine && double_size) ? 16 : 8))
-            , tiles(tile_width * tile_height) {
+            , render_cycles(affine ? pixel_width * 2 + 10 : pixel_width) {
 
         if (y_pos + pixel_height > 0xFF) {
             y_pos -= 0x100;
@@ -90,9 +95,13 @@ public:
     int tile_width;
     int tile_height;
 
-    bool drawn = false;
+    // The number of OBJ rendering cycles this sprite takes on every scanline it covers.
+    int render_cycles;
 
-    std::vector<Tile> tiles;
+    // Points into the LCD's sprite tile pool. Each OAM entry owns the slice for its index.
+    const Tile** tiles = nullptr;
+
+    static constexpr int max_tiles = 64;
 
     static bool Disabled(u32 attr1) { return (attr1 & 0x200) && !(attr1 & 0x100); }
     static Shape GetShape(u32 attr1) { return static_cast<Shape>((attr1 >> 14) & 0x3); }
@@ -196,7 +205,9 @@ public:
 
 class Lcd {
 public:
-    Lcd(const std::vector<u16>& _pram, const std::vector<u16>& _vram, const std::vector<u32>& _oam, Core& _core);
+    // A render-only LCD draws scanlines on behalf of the render thread and does not drive any display timing.
+    Lcd(const Common::ArenaArray<u16>& _pram, const Common::ArenaArray<u16>& _vram,
+        const Common::ArenaArray<u32>& _oam, Core& _core, bool render_only = false);
     ~Lcd();
 
     IOReg control       = {0x0000, 0xFFF7, 0xFFF7};
@@ -215,22 +226,39 @@ public:
     std::vector<Bg> bgs;
     std::vector<Window> windows;
 
-    const std::vector<u16>& pram;
-    const std::vector<u16>& vram;
-    const std::vector<u32>& oam;
+    const Common::ArenaArray<u16>& pram;
+    const Common::ArenaArray<u16>& vram;
+    const Common::ArenaArray<u32>& oam;
 
     bool bg_dirty = true;
     bool obj_dirty = true;
     bool oam_dirty = true;
 
+    static constexpr int num_sprites = 128;
+    std::array<bool, num_sprites> oam_entry_dirty;
+
+    void MarkOamDirty(u32 oam_addr) {
+        oam_dirty = true;
+        oam_entry_dirty[oam_addr / 8] = true;
+    }
+
+    TileCache tile_cache;
+
+    // Only every render_skip-th frame is drawn and presented, for fast-forwarding. Skipped frames still run all the
+    // display timing, interrupts, and DMAs, and keep the affine reference points up to date.
+    int render_skip = 1;
+    // Overrides whether the rest of the current frame is drawn, for run-ahead.
+    void SetSkipFrame(bool skip) { skip_frame = skip; }
+
     static constexpr int h_pixels = 240;
     static constexpr int v_pixels = 160;
     static constexpr u16 alpha_bit = 0x8000;
     static constexpr int sprite_tile_base = 0x1'0000;
 
-    void Update(int cycles);
     void WriteControl(const u16 data, const u16 mask);
-    int NextEvent() const;
+
+    // Sprites, tiles, and background rows are all decoded again after loading a state.
+    void Serialize(Common::StateBuffer& state);
 
     void DumpDebugInfo() const;
     void DumpSprites() const;
@@ -244,13 +272,51 @@ public:
     int MosaicBgV() const { return ((mosaic >> 4) & 0xF) + 1; }
 
 private:
+    friend class RenderThread;
+    friend class Benchmark;
+
     Core& core;
 
     std::vector<u16> back_buffer;
 
-    int scanline_cycles = 0;
+    static constexpr int scanline_cycles = 1232;
+    static constexpr int hdraw_cycles = 960;
+    static constexpr int hblank_flag_cycles = 46;
+
+    void BeginHBlank(int cycles_late);
+    void SetHBlankFlag(int cycles_late);
+    void NextLine(int cycles_late);
+
+    // One sprite per OAM entry, only reparsed when its entry has been written to.
+    std::array<Sprite, num_sprites> sprites;
+    std::array<bool, num_sprites> sprite_active;
+    std::vector<const Tile*> sprite_tile_pool;
+
+    // The OAM indices of the onscreen sprites which get drawn on each scanline, in OAM order. Sprites past the
+    // OBJ rendering cycle budget are left out, and sprites past the shorter budget used when HBlank Interval
+    // Free is set are at the end of the list.
+    class SpriteList {
+    public:
+        void Clear() { size = 0; hblank_free_size = 0; }
+        void Push(u8 index, bool within_hblank_free) {
+            indices[size++] = index;
+            if (within_hblank_free) {
+                hblank_free_size = size;
+            }
+        }
+
+        int Size(bool hblank_free) const { return hblank_free ? hblank_free_size : size; }
+        u8 operator[](int i) const { return indices[i]; }
+
+    private:
+        std::array<u8, num_sprites> indices;
+        int size = 0;
+        int hblank_free_size = 0;
+    };
+    std::array<SpriteList, 160> line_sprites;
+    static constexpr int max_render_cycles = 1210;
+    static constexpr int max_render_cycles_hblank_free = 954;
 
-    std::vector<Sprite> sprites;
     std::array<std::array<u16, 240>, 4> sprite_scanlines;
     std::array<bool, 4> sprite_scanline_used{{true, true, true, true}};
     std::array<bool, 240> semi_transparent;
@@ -258,23 +324,102 @@ private:
     std::array<bool, 240> obj_window;
     bool obj_window_used = true;
 
+    // Enabled backgrounds sorted by priority value, rebuilt every scanline.
+    class PriorityList {
+    public:
+        void Clear() { size = 0; }
+        void Push(const Bg* bg) { bgs[size++] = bg; }
+
+        const Bg* const* begin() const { return bgs.data(); }
+        const Bg* const* end() const { return bgs.data() + size; }
+
+    private:
+        std::array<const Bg*, 4> bgs;
+        std::size_t size = 0;
+    };
+    std::array<PriorityList, 4> priorities;
+
+    // Per-pixel layer ids for the current scanline. Layers 0-3 are backgrounds, 4 is sprites, 5 is the backdrop,
+    // and 6 is a non-existent layer.
+    std::array<u8, 240> pixel_layer;
+    std::array<u8, 240> highest_first_target;
+    std::array<u8, 240> highest_second_target;
+
     void DrawScanline();
+    // Advances the per-scanline state which DrawScanline would have, without drawing anything.
+    void SkipScanline();
+    void UpdateFrameSkip();
+
+    int skip_frame_count = 0;
+    bool skip_frame = false;
 
     void ReadOam();
-    void GetTileData();
+    void BuildLineSprites();
+    void GetTileData(Sprite& sprite);
     void DrawSprites();
     void DrawRegularSprite(const Sprite& sprite);
     void DrawAffineSprite(const Sprite& sprite);
-
-    bool IsWithinWindow(int layer_id, int x, int y) const;
-    bool InWindowContent(int win_id, int layer_id) const;
+    // One scanline of an affine sprite, clipped to the pixels whose texture coordinates are inside the sprite.
+    // tex_x and tex_y are the texture coordinates of the first pixel in 8.8 fixed point, which step by pa and pc.
+    struct AffineSpan {
+        int first;
+        int last;
+        int tex_x;
+        int tex_y;
+        int pa;
+        int pc;
+    };
+    static void ClipAffineSpan(int slope, int offset, int half_size, int& first_x, int& last_x);
+    template <bool obj_window_sprite>
+    void DrawAffineSpan(const Sprite& sprite, const AffineSpan& span);
+
+    // The layers which are visible on each pixel of the current scanline, as a bitmask of layer ids. Bit 5 is
+    // set if colour effects are enabled on that pixel.
+    std::array<u8, 240> window_mask;
+    static constexpr u8 obj_bit = 0x10;
+    static constexpr u8 effects_bit = 0x20;
+
+    // Runs of pixels on the current scanline which share a window mask, so a line without windows is a single span.
+    struct WindowSpan {
+        int start;
+        int end;
+        u8 mask;
+    };
+    std::array<WindowSpan, 240> window_spans;
+    int num_window_spans = 0;
+
+    void BuildWindowMask();
 
     bool IsFirstTarget(int target) const { return (FirstTargets() >> target) & 0x1; }
     bool IsSecondTarget(int target) const { return (SecondTargets() >> target) & 0x1; }
 
-    int Brighten(int t) const { return t + (31.0 - t) * Intensity(); }
-    int Darken(int t) const { return t * (1.0 - Intensity()); }
-    int Blend(int t1, int t2) const { return std::min(t1 * FirstAlpha() + t2 * SecondAlpha(), 31.0); }
+    // Colour effect coefficients, latched at the start of each scanline.
+    int eva = 0;
+    int evb = 0;
+    int evy = 0;
+
+    void LatchColourEffects();
+
+    // Colour effects operate on all three channels of a BGR555 pixel at once, by spreading the channels into 10-bit
+    // fields so that the intermediate products can't carry into the neighbouring channel.
+    static constexpr u32 channel_mask = 0x01F0'7C1F;
+    static constexpr u32 SpreadChannels(u16 c) { return (c & 0x1F) | ((c & 0x3E0) << 5) | ((c & 0x7C00) << 10); }
+    static constexpr u16 PackChannels(u32 c) { return (c & 0x1F) | ((c >> 5) & 0x3E0) | ((c >> 10) & 0x7C00); }
+
+    u16 Brighten(u16 pixel) const {
+        const u32 t = SpreadChannels(pixel);
+        return PackChannels(t + ((((channel_mask - t) * evy) >> 4) & channel_mask));
+    }
+    u16 Darken(u16 pixel) const {
+        const u32 t = SpreadChannels(pixel);
+        return PackChannels(t - (((t * evy) >> 4) & channel_mask));
+    }
+    u16 Blend(u16 target1, u16 target2) const {
+        // Each channel of the sum can reach 62 after the shift, so keep 6 bits per channel and saturate at 31.
+        u32 t = ((SpreadChannels(target1) * eva + SpreadChannels(target2) * evb) >> 4) & 0x03F0'FC3F;
+        const u32 overflow = t & 0x0200'8020;
+        return PackChannels((t | (overflow - (overflow >> 5))) & channel_mask);
+    }
 
     // Control flags
     int BgMode() const { return control & 0x7; }
@@ -309,10 +454,10 @@ private:
     Effect BlendMode() const { return static_cast<Effect>((blend_control >> 6) & 0x3); }
     int SecondTargets() const { return (blend_control >> 8) & 0x3F; }
 
-    double FirstAlpha() const { return std::min(static_cast<double>(blend_alpha & 0x1F) / 16.0, 1.0); }
-    double SecondAlpha() const { return std::min(static_cast<double>((blend_alpha >> 8) & 0x1F) / 16.0, 1.0); }
+    int FirstAlpha() const { return std::min(blend_alpha & 0x1F, 16); }
+    int SecondAlpha() const { return std::min((blend_alpha >> 8) & 0x1F, 16); }
 
-    double Intensity() const { return std::min(static_cast<double>(blend_fade & 0x1F) / 16.0, 1.0); }
+    int Intensity() const { return std::min(blend_fade & 0x1F, 16); }
 };
 
 } // End namespace Gba
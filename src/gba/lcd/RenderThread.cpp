@@ -0,0 +1,179 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "gba/lcd/RenderThread.h"
+#include "gba/lcd/Lcd.h"
+#include "gba/lcd/Bg.h"
+#include "gba/core/Core.h"
+#include "gba/memory/Memory.h"
+#include "common/StateBuffer.h"
+
+namespace Gba {
+
+RenderThread::RenderThread(const Memory& mem, Core& _core)
+        : core(_core)
+        , arena(Common::MemoryArena::BytesFor<u16>(mem.PramReference().size())
+                + Common::MemoryArena::BytesFor<u16>(mem.VramReference().size())
+                + Common::MemoryArena::BytesFor<u32>(mem.OamReference().size()), false)
+        , pram(arena.Copy(mem.PramReference()))
+        , vram(arena.Copy(mem.VramReference()))
+        , oam(arena.Copy(mem.OamReference()))
+        , lcd(std::make_unique<Lcd>(pram, vram, oam, core, true)) {
+
+    // One scanline rarely needs more than a handful of writes.
+    pending.reserve(256);
+    queued.reserve(256);
+    running.reserve(256);
+
+    worker = std::thread(&RenderThread::WorkerLoop, this);
+}
+
+RenderThread::~RenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        quit = true;
+    }
+
+    work_available.notify_one();
+    worker.join();
+}
+
+void RenderThread::DrawScanline(int vcount, bool skip) {
+    pending.push_back({skip ? Command::SkipScanline : Command::DrawScanline, 0, 0, 0, vcount});
+    Submit();
+}
+
+void RenderThread::EndFrame(bool present) {
+    // The affine reference points are latched at the start of vblank.
+    pending.push_back({Command::LatchReferencePoints, 0, 0, 0, 0});
+    Submit();
+    WaitForIdle();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    // The worker is idle, so its back buffer can be swapped safely.
+    if (present) {
+        core.SwapBuffers(lcd->back_buffer);
+    }
+}
+
+void RenderThread::Resync(const Memory& mem, Lcd& main_lcd) {
+    WaitForIdle();
+    pending.clear();
+
+    std::copy(mem.PramReference().cbegin(), mem.PramReference().cend(), pram.begin());
+    std::copy(mem.VramReference().cbegin(), mem.VramReference().cend(), vram.begin());
+    std::copy(mem.OamReference().cbegin(), mem.OamReference().cend(), oam.begin());
+
+    Common::StateBuffer saved_lcd;
+    main_lcd.Serialize(saved_lcd);
+    Common::StateBuffer loaded_lcd{saved_lcd.Data()};
+    lcd->Serialize(loaded_lcd);
+}
+
+void RenderThread::Submit() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queued.insert(queued.end(), pending.cbegin(), pending.cend());
+    }
+
+    pending.clear();
+    work_available.notify_one();
+}
+
+void RenderThread::WaitForIdle() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    work_done.wait(lock, [this] { return queued.empty() && !busy; });
+}
+
+void RenderThread::WorkerLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            busy = false;
+            if (queued.empty()) {
+                work_done.notify_one();
+            }
+
+            work_available.wait(lock, [this] { return quit || !queued.empty(); });
+            if (quit) {
+                return;
+            }
+
+            running.swap(queued);
+            busy = true;
+        }
+
+        try {
+            for (const auto& command : running) {
+                Run(command);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            error = std::current_exception();
+        }
+
+        running.clear();
+    }
+}
+
+void RenderThread::Run(const Command& command) {
+    switch (command.type) {
+    case Command::WriteIO:
+        // Some register writes depend on the current scanline.
+        lcd->vcount = command.vcount;
+        Memory::WriteLcdIO(*lcd, command.addr, command.data, command.mask);
+        break;
+    case Command::WritePRam:
+        pram[command.addr] = command.data;
+        break;
+    case Command::WriteVRam:
+        vram[command.addr] = command.data;
+        if (command.addr * 2 >= Lcd::sprite_tile_base) {
+            lcd->obj_dirty = true;
+        } else {
+            lcd->bg_dirty = true;
+        }
+        lcd->tile_cache.Invalidate(command.addr * 2);
+        break;
+    case Command::WriteOam:
+        oam[command.addr] = command.data;
+        lcd->MarkOamDirty(command.addr * 4);
+        break;
+    case Command::DrawScanline:
+        lcd->vcount = command.vcount;
+        lcd->DrawScanline();
+        break;
+    case Command::SkipScanline:
+        lcd->vcount = command.vcount;
+        lcd->SkipScanline();
+        break;
+    case Command::LatchReferencePoints:
+        for (int b = 2; b < 4; ++b) {
+            lcd->bgs[b].LatchReferencePointX();
+            lcd->bgs[b].LatchReferencePointY();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+} // End namespace Gba
@@ -0,0 +1,98 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "common/CommonTypes.h"
+#include "common/MemoryArena.h"
+
+namespace Gba {
+
+class Core;
+class Memory;
+class Lcd;
+
+// Draws scanlines on a worker thread while the CPU keeps running. The render thread owns its own copies of PRAM,
+// VRAM, and OAM, and its own render-only Lcd. Every write which affects rendering is queued in order alongside the
+// scanlines to be drawn, so the worker sees exactly the state the synchronous renderer would have seen, and frames
+// stay deterministic.
+class RenderThread {
+public:
+    RenderThread(const Memory& mem, Core& _core);
+    ~RenderThread();
+
+    void WriteIO(u32 addr, u16 data, u16 mask, int vcount) {
+        pending.push_back({Command::WriteIO, addr, data, mask, vcount});
+    }
+    void WritePRam(u32 index, u16 value) { pending.push_back({Command::WritePRam, index, value, 0, 0}); }
+    void WriteVRam(u32 index, u16 value) { pending.push_back({Command::WriteVRam, index, value, 0, 0}); }
+    void WriteOam(u32 index, u32 value) { pending.push_back({Command::WriteOam, index, value, 0, 0}); }
+
+    // Queues a scanline, or the state updates for a skipped one, and hands everything queued so far to the worker.
+    void DrawScanline(int vcount, bool skip);
+    // Waits for the worker to finish the current frame, then presents it unless the frame was skipped.
+    void EndFrame(bool present);
+    // Discards anything queued and copies the main thread's memory and LCD state, after a save state is loaded.
+    void Resync(const Memory& mem, Lcd& main_lcd);
+
+private:
+    struct Command {
+        enum Type {WriteIO, WritePRam, WriteVRam, WriteOam, DrawScanline, SkipScanline, LatchReferencePoints};
+
+        Type type;
+        u32 addr;
+        u32 data;
+        u16 mask;
+        int vcount;
+    };
+
+    Core& core;
+
+    Common::MemoryArena arena;
+    Common::ArenaArray<u16> pram;
+    Common::ArenaArray<u16> vram;
+    Common::ArenaArray<u32> oam;
+    std::unique_ptr<Lcd> lcd;
+
+    // Commands are collected without locking on the CPU thread, and handed over to the worker in batches.
+    std::vector<Command> pending;
+    std::vector<Command> queued;
+    std::vector<Command> running;
+
+    std::mutex queue_mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    bool busy = false;
+    bool quit = false;
+    // An exception thrown while drawing, rethrown on the CPU thread at the end of the frame.
+    std::exception_ptr error;
+
+    std::thread worker;
+
+    void Submit();
+    void WaitForIdle();
+    void WorkerLoop();
+    void Run(const Command& command);
+};
+
+} // End namespace Gba
@@ -0,0 +1,67 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gba/lcd/TileCache.h"
+
+namespace Gba {
+
+const Tile TileCache::blank_tile{};
+
+const Tile& TileCache::Get(int tile_addr, bool single_palette) const {
+    if (tile_addr >= obj_base) {
+        // Tile numbers wrap around within OBJ VRAM.
+        tile_addr = obj_base + ((tile_addr - obj_base) & 0x7FFF);
+    }
+
+    const std::size_t block = tile_addr / block_size;
+    if (single_palette) {
+        Tile& tile = tiles_8bpp[block];
+        if (!valid_8bpp[block]) {
+            // Each tile byte specifies the 8-bit palette index for a pixel.
+            for (int i = 0; i < 64; ++i) {
+                tile[i] = ReadByte(tile_addr + i);
+            }
+
+            valid_8bpp[block] = true;
+        }
+
+        return tile;
+    } else {
+        Tile& tile = tiles_4bpp[block];
+        if (!valid_4bpp[block]) {
+            // The lower 4 bits are the palette index for even pixels, and the upper 4 bits are for odd pixels.
+            for (int i = 0; i < 32; ++i) {
+                const u8 data = ReadByte(tile_addr + i);
+                tile[2 * i] = data & 0xF;
+                tile[2 * i + 1] = data >> 4;
+            }
+
+            valid_4bpp[block] = true;
+        }
+
+        return tile;
+    }
+}
+
+u8 TileCache::ReadByte(int addr) const {
+    if (addr >= obj_base) {
+        addr = obj_base + ((addr - obj_base) & 0x7FFF);
+    }
+
+    return vram[addr / 2] >> (8 * (addr & 0x1));
+}
+
+} // End namespace Gba
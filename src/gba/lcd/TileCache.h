@@ -0,0 +1,78 @@
+// This file is a part of Chroma.
+// Copyright (C) 2017-2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "common/CommonTypes.h"
+#include "common/MemoryArena.h"
+
+namespace Gba {
+
+// One palette index per pixel, in row-major order.
+using Tile = std::array<u8, 64>;
+
+// Tiles decoded from VRAM, shared between the backgrounds and sprites. A tile is only decoded again after a
+// VRAM write touches it.
+class TileCache {
+public:
+    TileCache(const Common::ArenaArray<u16>& _vram) : vram(_vram) {}
+
+    // Returns the tile starting at the given VRAM byte address. 16 palette tiles unpack each nibble of the tile
+    // data into its own byte.
+    const Tile& Get(int tile_addr, bool single_palette) const;
+
+    void Invalidate(u32 vram_addr) {
+        const std::size_t block = vram_addr / block_size;
+        valid_4bpp[block] = false;
+        valid_8bpp[block] = false;
+
+        // Single palette tiles span two blocks, and the last one in OBJ VRAM wraps around to the start.
+        if (block > 0) {
+            valid_8bpp[block - 1] = false;
+        }
+        if (block == obj_first_block) {
+            valid_8bpp[num_blocks - 1] = false;
+        }
+    }
+
+    void InvalidateAll() {
+        valid_4bpp.fill(false);
+        valid_8bpp.fill(false);
+    }
+
+    static const Tile blank_tile;
+
+private:
+    const Common::ArenaArray<u16>& vram;
+
+    // Every tile starts on a 32-byte boundary, the size of a 16 palette tile.
+    static constexpr std::size_t block_size = 32;
+    static constexpr std::size_t num_blocks = 96 * 1024 / block_size;
+    static constexpr int obj_base = 0x1'0000;
+    static constexpr std::size_t obj_first_block = obj_base / block_size;
+
+    mutable std::array<Tile, num_blocks> tiles_4bpp;
+    mutable std::array<Tile, num_blocks> tiles_8bpp;
+    mutable std::array<bool, num_blocks> valid_4bpp{};
+    mutable std::array<bool, num_blocks> valid_8bpp{};
+
+    u8 ReadByte(int addr) const;
+};
+
+} // End namespace Gba
@@ -30,7 +30,7 @@ bool Memory::CheckNintendoLogo(const std::vector<u8>& rom_header) noexcept {
     return header_logo_hash == logo_hash;
 }
 
-void Memory::CheckHeader(const std::vector<u16>& rom_header) {
+void Memory::CheckHeader(const Common::RomView<u16>& rom_header) {
     // Fixed value check. All GBA games must have 0x96 stored at 0xB2.
     if (rom_header[0xB2 / 2] != 0x96) {
         fmt::print("WARNING: Fixed value does not match. This ROM would not run on a GBA!\n");
@@ -0,0 +1,247 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdexcept>
+
+#include "gba/memory/Memory.h"
+#include "gba/core/Core.h"
+#include "gba/cpu/Cpu.h"
+#include "gba/lcd/Lcd.h"
+#include "gba/lcd/Bg.h"
+#include "gba/hardware/Timer.h"
+#include "gba/hardware/Dma.h"
+#include "gba/hardware/Keypad.h"
+#include "gba/hardware/Serial.h"
+#include "gba/audio/Audio.h"
+
+namespace Gba {
+
+void Memory::MapIO() {
+    const auto index = [](u32 addr) { return (addr - DISPCNT) >> 1; };
+    const auto map_read = [&](u32 addr, const IOReg& reg) { io_reads[index(addr)].reg = &reg; };
+    const auto map_write = [&](u32 addr, IOReg& reg) { io_writes[index(addr)].reg = &reg; };
+    const auto map = [&](u32 addr, IOReg& reg) { map_read(addr, reg); map_write(addr, reg); };
+    const auto map_read_handler = [&](u32 addr, IOReadHandler handler) { io_reads[index(addr)].handler = handler; };
+    const auto map_write_handler = [&](u32 addr, IOWriteHandler handler) {
+        io_writes[index(addr)].handler = handler;
+    };
+
+    // LCD
+    Lcd& lcd = *core.lcd;
+    map_read(DISPCNT, lcd.control);
+    map_write_handler(DISPCNT, &Memory::WriteLcdControl);
+    map(GREENSWAP, lcd.green_swap);
+    map(DISPSTAT, lcd.status);
+    map_read(VCOUNT, lcd.vcount);
+    for (int i = 0; i < 4; ++i) {
+        map_read(BG0CNT + i * 2, lcd.bgs[i].control);
+        map_write_handler(BG0CNT + i * 2, &Memory::WriteBgControl);
+        map_write(BG0HOFS + i * 4, lcd.bgs[i].scroll_x);
+        map_write(BG0VOFS + i * 4, lcd.bgs[i].scroll_y);
+    }
+    for (int i = 2; i < 4; ++i) {
+        const u32 base = BG2PA + (i - 2) * 0x10;
+        map_write(base, lcd.bgs[i].affine_a);
+        map_write(base + 2, lcd.bgs[i].affine_b);
+        map_write(base + 4, lcd.bgs[i].affine_c);
+        map_write(base + 6, lcd.bgs[i].affine_d);
+        for (u32 addr = base + 8; addr < base + 0x10; addr += 2) {
+            map_write_handler(addr, &Memory::WriteBgReferencePoint);
+        }
+    }
+    map_write(WIN0H, lcd.windows[0].width);
+    map_write(WIN1H, lcd.windows[1].width);
+    map_write(WIN0V, lcd.windows[0].height);
+    map_write(WIN1V, lcd.windows[1].height);
+    map(WININ, lcd.winin);
+    map(WINOUT, lcd.winout);
+    map_write(MOSAIC, lcd.mosaic);
+    map(BLDCNT, lcd.blend_control);
+    map(BLDALPHA, lcd.blend_alpha);
+    map_write(BLDY, lcd.blend_fade);
+
+    // Sound
+    for (u32 addr = DISPCNT; addr < DISPCNT + io_table_size * 2; addr += 2) {
+        if (SoundIO(addr)) {
+            map_read_handler(addr, &Memory::ReadSoundIO);
+            map_write_handler(addr, &Memory::WriteSoundIO);
+        }
+    }
+    // The halfword after SOUNDCNT_X is unused. It reads as zero and ignores writes.
+    map_read_handler(Audio::SOUNDCNT_X + 2, &Memory::ReadZero);
+    map(SOUNDBIAS, soundbias);
+
+    // DMA
+    for (int i = 0; i < 4; ++i) {
+        const u32 base = DMA0SAD_L + i * 12;
+        Dma& dma = core.dma[i];
+        map_write(base, dma.source_l);
+        map_write(base + 2, dma.source_h);
+        map_write(base + 4, dma.dest_l);
+        map_write(base + 6, dma.dest_h);
+        map_read_handler(base + 8, &Memory::ReadZero);
+        map_write(base + 8, dma.word_count);
+        map_read(base + 10, dma.control);
+        map_write_handler(base + 10, &Memory::WriteDmaControl);
+    }
+
+    // Timers
+    for (int i = 0; i < 4; ++i) {
+        const u32 base = TM0CNT_L + i * 4;
+        map_read_handler(base, &Memory::ReadTimerCounter);
+        map_write(base, core.timers[i].reload);
+        map_read(base + 2, core.timers[i].control);
+        map_write_handler(base + 2, &Memory::WriteTimerControl);
+    }
+
+    // Serial and keypad
+    Serial& serial = *core.serial;
+    map(SIOMULTI0, serial.data0);
+    map(SIOMULTI1, serial.data1);
+    map(SIOMULTI2, serial.data2);
+    map(SIOMULTI3, serial.data3);
+    map_read(SIOCNT, serial.control);
+    map_write_handler(SIOCNT, &Memory::WriteSerialControl);
+    map(SIOMLTSEND, serial.send);
+    map_read(KEYINPUT, core.keypad->input);
+    map(KEYCNT, core.keypad->control);
+    map(RCNT, serial.mode);
+    map_read(JOYCNT, serial.joybus_control);
+    map_write_handler(JOYCNT, &Memory::WriteJoybusControl);
+    map_read_handler(JOYRECV_L, &Memory::ReadJoybusRecv);
+    map_write(JOYRECV_L, serial.joybus_recv_l);
+    map_read_handler(JOYRECV_H, &Memory::ReadJoybusRecv);
+    map_write(JOYRECV_H, serial.joybus_recv_h);
+    map_read(JOYTRANS_L, serial.joybus_trans_l);
+    map_write_handler(JOYTRANS_L, &Memory::WriteJoybusTrans);
+    map_read(JOYTRANS_H, serial.joybus_trans_h);
+    map_write_handler(JOYTRANS_H, &Memory::WriteJoybusTrans);
+    map(JOYSTAT, serial.joybus_status);
+
+    // Interrupts and system control
+    map(IE, intr_enable);
+    map_read(IF, intr_flags);
+    map_write_handler(IF, &Memory::WriteIF);
+    map_read(WAITCNT, waitcnt);
+    map_write_handler(WAITCNT, &Memory::WriteWaitcnt);
+    map(IME, master_enable);
+    map_read(HALTCNT, haltcnt);
+    map_write_handler(HALTCNT, &Memory::WriteHaltcnt);
+}
+
+u16 Memory::ReadSoundIO(u32 addr) const {
+    return core.audio->ReadRegister(addr);
+}
+
+u16 Memory::ReadTimerCounter(u32 addr) const {
+    const int timer = (addr - TM0CNT_L) >> 2;
+    const u16 value = core.timers[timer].ReadCounter();
+    core.cpu->RecordTimerRead(timer, value);
+    return value;
+}
+
+u16 Memory::ReadJoybusRecv(u32 addr) const {
+    core.serial->joybus_status &= ~Serial::joystat_recv;
+    return (addr == JOYRECV_L) ? core.serial->joybus_recv_l.Read() : core.serial->joybus_recv_h.Read();
+}
+
+void Memory::WriteSoundIO(u32 addr, u16 data, u16 mask) {
+    core.audio->WriteRegister(addr, data, mask);
+}
+
+void Memory::WriteLcdControl(u32, u16 data, u16 mask) {
+    core.lcd->WriteControl(data, mask);
+}
+
+void Memory::WriteBgControl(u32 addr, u16 data, u16 mask) {
+    Bg& bg = core.lcd->bgs[(addr - BG0CNT) >> 1];
+    bg.control.Write(data, mask);
+    bg.dirty = true;
+}
+
+void Memory::WriteBgReferencePoint(u32 addr, u16 data, u16 mask) {
+    Bg& bg = core.lcd->bgs[(addr < BG3PA) ? 2 : 3];
+
+    // The reference points are latched whenever either half is written.
+    switch (addr & 0x6) {
+    case 0x0:
+        bg.offset_x_l.Write(data, mask);
+        bg.LatchReferencePointX();
+        break;
+    case 0x2:
+        bg.offset_x_h.Write(data, mask);
+        bg.LatchReferencePointX();
+        break;
+    case 0x4:
+        bg.offset_y_l.Write(data, mask);
+        bg.LatchReferencePointY();
+        break;
+    case 0x6:
+        bg.offset_y_h.Write(data, mask);
+        bg.LatchReferencePointY();
+        break;
+    }
+}
+
+void Memory::WriteDmaControl(u32 addr, u16 data, u16 mask) {
+    core.dma[(addr - DMA0CNT_H) / 12].WriteControl(data, mask);
+}
+
+void Memory::WriteTimerControl(u32 addr, u16 data, u16 mask) {
+    core.timers[(addr - TM0CNT_H) >> 2].WriteControl(data, mask);
+}
+
+void Memory::WriteSerialControl(u32, u16 data, u16 mask) {
+    core.serial->WriteControl(data, mask);
+}
+
+void Memory::WriteJoybusControl(u32, u16 data, u16 mask) {
+    // Bits 0-2 of JOYCNT behave like IF. The IRQ enable bit is normally writeable.
+    core.serial->joybus_control.Clear(data & Serial::joycnt_ack_mask);
+    core.serial->joybus_control.Write(data & Serial::joycnt_irq_enable, mask);
+}
+
+void Memory::WriteJoybusTrans(u32 addr, u16 data, u16 mask) {
+    if (addr == JOYTRANS_L) {
+        core.serial->joybus_trans_l.Write(data, mask);
+    } else {
+        core.serial->joybus_trans_h.Write(data, mask);
+    }
+    core.serial->joybus_status |= Serial::joystat_trans;
+}
+
+void Memory::WriteIF(u32, u16 data, u16) {
+    // Writing "1" to a bit in IF clears that bit.
+    intr_flags.Clear(data);
+}
+
+void Memory::WriteWaitcnt(u32, u16 data, u16 mask) {
+    waitcnt.Write(data, mask);
+    UpdateWaitStates();
+}
+
+void Memory::WriteHaltcnt(u32, u16 data, u16 mask) {
+    haltcnt.Write(data, mask);
+    if ((mask & 0xFF00) == 0xFF00 && (data & 0x8000) == 0) {
+        if (master_enable == 0 && intr_enable == 0) {
+            throw std::runtime_error("The CPU has hung: halt mode entered with interrupts disabled.");
+        }
+
+        core.cpu->Halt();
+    }
+}
+
+} // End namespace Gba
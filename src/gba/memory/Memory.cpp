@@ -18,28 +18,47 @@
 
 #include "gba/memory/Memory.h"
 #include "gba/core/Core.h"
+#include "gba/core/Scheduler.h"
 #include "gba/cpu/Cpu.h"
+#include "gba/cpu/BlockCache.h"
 #include "gba/lcd/Lcd.h"
 #include "gba/lcd/Bg.h"
+#include "gba/lcd/RenderThread.h"
 #include "gba/hardware/Timer.h"
 #include "gba/hardware/Dma.h"
 #include "gba/hardware/Keypad.h"
 #include "gba/hardware/Serial.h"
+#include "gba/audio/Audio.h"
+#include "common/StateBuffer.h"
 
 namespace Gba {
 
-Memory::Memory(const std::vector<u32>& _bios, const std::vector<u16>& _rom, const std::string& _save_path, Core& _core)
+Memory::Memory(const Common::RomView<u32>& _bios, const Common::RomView<u16>& _rom, const std::string& _save_path,
+               bool mmap_saves, bool huge_pages, Core& _core)
         : bios(_bios)
-        , xram(xram_size / sizeof(u16))
-        , iram(iram_size / sizeof(u32))
-        , pram(pram_size / sizeof(u16))
-        , vram(vram_size / sizeof(u16))
-        , oam(oam_size / sizeof(u32))
+        // Every region is a whole number of cache lines, so they're packed back to back.
+        , arena(xram_size + iram_size + pram_size + vram_size + oam_size, huge_pages)
+        , xram(arena.Allocate<u16>(xram_size / sizeof(u16)))
+        , iram(arena.Allocate<u32>(iram_size / sizeof(u32)))
+        , pram(arena.Allocate<u16>(pram_size / sizeof(u16)))
+        , vram(arena.Allocate<u16>(vram_size / sizeof(u16)))
+        , oam(arena.Allocate<u32>(oam_size / sizeof(u32)))
         , rom(_rom)
         , core(_core)
         , save_path(_save_path)
+        , save_writer(save_path)
         , large_rom(rom.size() / 2 > 16 * mbyte) {
 
+    core.scheduler->RegisterHandler(EventType::SaveOp, [this](int) { RunSaveOp(); });
+    core.scheduler->RegisterHandler(EventType::SaveFlush, [this](int) { WriteSaveFile(); });
+
+    if (mmap_saves) {
+        sram.BackWithFile(save_path);
+        eeprom.BackWithFile(save_path);
+    }
+
+    MapPages();
+    UpdateWaitStates();
     ReadSaveFile();
 }
 
@@ -49,39 +68,39 @@ Memory::~Memory() {
 
 // Bus width 16.
 template <>
-u32 Memory::ReadRegion(const std::vector<u16>& region, const AddressMask region_mask, const u32 addr) const {
+u32 Memory::ReadRegion(const u16* region, const AddressMask region_mask, const u32 addr) const {
     // Unaligned accesses are word-aligned.
     const u32 region_addr = ((addr & region_mask) / sizeof(u16)) & ~0x1;
     return region[region_addr] | (region[region_addr + 1] << 16);
 }
 
 template <>
-u16 Memory::ReadRegion(const std::vector<u16>& region, const AddressMask region_mask, const u32 addr) const {
+u16 Memory::ReadRegion(const u16* region, const AddressMask region_mask, const u32 addr) const {
     const u32 region_addr = (addr & region_mask) / sizeof(u16);
     return region[region_addr];
 }
 
 template <>
-u8 Memory::ReadRegion(const std::vector<u16>& region, const AddressMask region_mask, const u32 addr) const {
+u8 Memory::ReadRegion(const u16* region, const AddressMask region_mask, const u32 addr) const {
     const u32 region_addr = (addr & region_mask) / sizeof(u16);
     return region[region_addr] >> (8 * (addr & 0x1));
 }
 
 // Bus width 32.
 template <>
-u32 Memory::ReadRegion(const std::vector<u32>& region, const AddressMask region_mask, const u32 addr) const {
+u32 Memory::ReadRegion(const u32* region, const AddressMask region_mask, const u32 addr) const {
     const u32 region_addr = (addr & region_mask) / sizeof(u32);
     return region[region_addr];
 }
 
 template <>
-u16 Memory::ReadRegion(const std::vector<u32>& region, const AddressMask region_mask, const u32 addr) const {
+u16 Memory::ReadRegion(const u32* region, const AddressMask region_mask, const u32 addr) const {
     const u32 region_addr = (addr & region_mask) / sizeof(u32);
     return region[region_addr] >> (8 * (addr & 0x2));
 }
 
 template <>
-u8 Memory::ReadRegion(const std::vector<u32>& region, const AddressMask region_mask, const u32 addr) const {
+u8 Memory::ReadRegion(const u32* region, const AddressMask region_mask, const u32 addr) const {
     const u32 region_addr = (addr & region_mask) / sizeof(u32);
     return region[region_addr] >> (8 * (addr & 0x3));
 }
@@ -91,7 +110,7 @@ T Memory::ReadBios(const u32 addr) const {
     // The BIOS region is not mirrored, and can only be read if the PC is currently within the BIOS.
     if (addr < bios_size) {
         if (core.cpu->GetPc() < bios_size) {
-            return ReadRegion<T>(bios, bios_addr_mask, addr);
+            return ReadRegion<T>(bios.data(), bios_addr_mask, addr);
         } else {
             return core.cpu->last_bios_fetch;
         }
@@ -105,8 +124,108 @@ template <> u32 Memory::ReadIO(const u32 addr) const;
 template <> u16 Memory::ReadIO(const u32 addr) const;
 template <> u8 Memory::ReadIO(const u32 addr) const;
 
+void Memory::MapPages() {
+    // Each region is mirrored across its whole 16MB area. The BIOS isn't mapped, because whether it can be read
+    // depends on the current PC.
+    auto MapReads = [this](Region region, const void* host, u32 host_size) {
+        const u32 region_base = static_cast<u32>(region) << 24;
+        for (u32 offset = 0; offset < 16 * mbyte; offset += page_size) {
+            read_pages[PageIndex(region_base + offset)] = static_cast<const u8*>(host) + (offset % host_size);
+        }
+
+        page_offset_mask[static_cast<int>(region)] = std::min(host_size, page_size) - 1;
+    };
+
+    auto MapWrites = [this](Region region, void* host, u32 host_size) {
+        const u32 region_base = static_cast<u32>(region) << 24;
+        for (u32 offset = 0; offset < 16 * mbyte; offset += page_size) {
+            write_pages[PageIndex(region_base + offset)] = static_cast<u8*>(host) + (offset % host_size);
+        }
+    };
+
+    MapReads(Region::XRam, xram.data(), xram_size);
+    MapReads(Region::IRam, iram.data(), iram_size);
+    MapReads(Region::PRam, pram.data(), pram_size);
+    MapReads(Region::Oam, oam.data(), oam_size);
+
+    // The upper 32KB of each 128KB VRAM mirror repeats the OBJ region.
+    for (u32 offset = 0; offset < 16 * mbyte; offset += page_size) {
+        const u32 vram_offset = (offset & 0x0001'0000) ? (offset & vram_addr_mask2) : (offset & vram_addr_mask1);
+        read_pages[PageIndex(BaseAddr::VRam + offset)] = reinterpret_cast<const u8*>(vram.data()) + vram_offset;
+    }
+    page_offset_mask[static_cast<int>(Region::VRam)] = page_size - 1;
+
+    // The ROM vector is always at least 16MB. The EEPROM region is left unmapped, since its reads depend on
+    // the save type.
+    MapReads(Region::Rom0_l, rom.data(), 16 * mbyte);
+    MapReads(Region::Rom1_l, rom.data(), 16 * mbyte);
+    MapReads(Region::Rom2_l, rom.data(), 16 * mbyte);
+    if (large_rom) {
+        MapReads(Region::Rom0_h, rom.data() + 8 * mbyte, 16 * mbyte);
+        MapReads(Region::Rom1_h, rom.data() + 8 * mbyte, 16 * mbyte);
+    }
+
+    // Writes to video memory mark the LCD's caches dirty and have special 8-bit behaviour, so only XRAM and IRAM
+    // writes are direct.
+    MapWrites(Region::XRam, xram.data(), xram_size);
+    MapWrites(Region::IRam, iram.data(), iram_size);
+
+    if (!breakpoints.Empty() || cheats.HasRomPatches()) {
+        for (std::size_t page = 0; page < num_pages; ++page) {
+            if (breakpoints.Tagged(page, Common::Breakpoints::Exec | Common::Breakpoints::Read)
+                    || cheats.Patched(page)) {
+                read_pages[page] = nullptr;
+            }
+            if (breakpoints.Tagged(page, Common::Breakpoints::Write)) {
+                write_pages[page] = nullptr;
+            }
+        }
+    }
+}
+
+void Memory::AddBreakpoint(u32 addr, Common::Breakpoints::Type type) {
+    breakpoints.Add(addr, type);
+    MapPages();
+}
+
+void Memory::RemoveBreakpoint(u32 addr, Common::Breakpoints::Type type) {
+    breakpoints.Remove(addr, type);
+    MapPages();
+}
+
+void Memory::AddCheat(const std::string& code) {
+    cheats.AddGbaCode(code);
+    MapPages();
+}
+
+void Memory::SetCheats(const Common::Cheats& cheat_list) {
+    cheats = cheat_list;
+    MapPages();
+}
+
+void Memory::ApplyCheatWrites() {
+    for (const auto& write : cheats.RamWrites()) {
+        if (write.size == 1) {
+            WriteMem<u8>(write.addr, write.value);
+        } else if (write.size == 2) {
+            WriteMem<u16>(write.addr, write.value);
+        } else {
+            WriteMem<u32>(write.addr, write.value);
+        }
+    }
+}
+
 template <typename T>
 T Memory::ReadMem(const u32 addr, bool dma) {
+    const u8* page = read_pages[PageIndex(addr)];
+    if (page != nullptr) {
+        return ReadPage<T>(page, addr);
+    }
+
+    if (breakpoints.Tagged(PageIndex(addr), Common::Breakpoints::Read)) {
+        breakpoints.Check(addr & ~(sizeof(T) - 1), sizeof(T), Common::Breakpoints::Read);
+    }
+
     switch (GetRegion(addr)) {
     case Region::Bios:
         return ReadBios<T>(addr);
@@ -179,7 +298,8 @@ template u32 Memory::ReadMem<u32>(const u32 addr, bool dma);
 
 // Bus width 16.
 template <>
-void Memory::WriteRegion(std::vector<u16>& region, const AddressMask region_mask, const u32 addr, const u32 data) {
+void Memory::WriteRegion(Common::ArenaArray<u16>& region, const AddressMask region_mask, const u32 addr,
+                         const u32 data) {
     // 32 bit writes must be aligned.
     const u32 region_addr = ((addr & region_mask) / sizeof(u16)) & ~0x1;
 
@@ -188,14 +308,16 @@ void Memory::WriteRegion(std::vector<u16>& region, const AddressMask region_mask
 }
 
 template <>
-void Memory::WriteRegion(std::vector<u16>& region, const AddressMask region_mask, const u32 addr, const u16 data) {
+void Memory::WriteRegion(Common::ArenaArray<u16>& region, const AddressMask region_mask, const u32 addr,
+                         const u16 data) {
     const u32 region_addr = (addr & region_mask) / sizeof(u16);
 
     region[region_addr] = data;
 }
 
 template <>
-void Memory::WriteRegion(std::vector<u16>& region, const AddressMask region_mask, const u32 addr, const u8 data) {
+void Memory::WriteRegion(Common::ArenaArray<u16>& region, const AddressMask region_mask, const u32 addr,
+                         const u8 data) {
     const u32 region_addr = (addr & region_mask) / sizeof(u16);
 
     const u32 hi_shift = 8 * (addr & 0x1);
@@ -204,14 +326,16 @@ void Memory::WriteRegion(std::vector<u16>& region, const AddressMask region_mask
 
 // Bus width 32.
 template <>
-void Memory::WriteRegion(std::vector<u32>& region, const AddressMask region_mask, const u32 addr, const u32 data) {
+void Memory::WriteRegion(Common::ArenaArray<u32>& region, const AddressMask region_mask, const u32 addr,
+                         const u32 data) {
     const u32 region_addr = (addr & region_mask) / sizeof(u32);
 
     region[region_addr] = data;
 }
 
 template <>
-void Memory::WriteRegion(std::vector<u32>& region, const AddressMask region_mask, const u32 addr, const u16 data) {
+void Memory::WriteRegion(Common::ArenaArray<u32>& region, const AddressMask region_mask, const u32 addr,
+                         const u16 data) {
     const u32 region_addr = (addr & region_mask) / sizeof(u32);
 
     const u32 hi_shift = 8 * (addr & 0x2);
@@ -219,15 +343,30 @@ void Memory::WriteRegion(std::vector<u32>& region, const AddressMask region_mask
 }
 
 template <>
-void Memory::WriteRegion(std::vector<u32>& region, const AddressMask region_mask, const u32 addr, const u8 data) {
+void Memory::WriteRegion(Common::ArenaArray<u32>& region, const AddressMask region_mask, const u32 addr,
+                         const u8 data) {
     const u32 region_addr = (addr & region_mask) / sizeof(u32);
 
     const u32 hi_shift = 8 * (addr & 0x3);
     region[region_addr] = (region[region_addr] & ~(0xFF << hi_shift)) | (data << hi_shift);
 }
 
+template <typename T>
+void Memory::WritePRam(const u32 addr, const T data) {
+    WriteRegion(pram, pram_addr_mask, addr, data);
+
+    if (core.render_thread) {
+        // Forward every halfword touched by the write to the render thread's copy.
+        const u32 first = ((addr & pram_addr_mask) / sizeof(u16)) & ~(sizeof(T) / sizeof(u16) - 1);
+        for (u32 i = first; i < first + sizeof(T) / sizeof(u16); ++i) {
+            core.render_thread->WritePRam(i, pram[i]);
+        }
+    }
+}
+
 template <typename T>
 void Memory::WriteVRam(const u32 addr, const T data) {
+    const u32 vram_addr = addr & ((addr & 0x0001'0000) ? vram_addr_mask2 : vram_addr_mask1);
     if (addr & 0x0001'0000) {
         WriteRegion(vram, vram_addr_mask2, addr, data);
         core.lcd->obj_dirty = true;
@@ -235,12 +374,25 @@ void Memory::WriteVRam(const u32 addr, const T data) {
         WriteRegion(vram, vram_addr_mask1, addr, data);
         core.lcd->bg_dirty = true;
     }
+    core.lcd->tile_cache.Invalidate(vram_addr);
+
+    if (core.render_thread) {
+        const u32 first = (vram_addr / sizeof(u16)) & ~(sizeof(T) / sizeof(u16) - 1);
+        for (u32 i = first; i < first + sizeof(T) / sizeof(u16); ++i) {
+            core.render_thread->WriteVRam(i, vram[i]);
+        }
+    }
 }
 
 template <typename T>
 void Memory::WriteOam(const u32 addr, const T data) {
     WriteRegion(oam, oam_addr_mask, addr, data);
-    core.lcd->oam_dirty = true;
+    core.lcd->MarkOamDirty(addr & oam_addr_mask);
+
+    if (core.render_thread) {
+        const u32 index = (addr & oam_addr_mask) / sizeof(u32);
+        core.render_thread->WriteOam(index, oam[index]);
+    }
 }
 
 // Specializing 8-bit writes to video memory.
@@ -265,15 +417,34 @@ template <> void Memory::WriteIO(const u32 addr, u8 data, u16 mask);
 
 template <typename T>
 void Memory::WriteMem(const u32 addr, const T data, bool dma) {
+    u8* page = write_pages[PageIndex(addr)];
+    if (page != nullptr) {
+        std::memcpy(page + (addr & (page_size - 1) & ~(sizeof(T) - 1)), &data, sizeof(T));
+        if (core.cpu->block_cache) {
+            core.cpu->block_cache->InvalidateWrite(addr);
+        }
+        return;
+    }
+
+    if (breakpoints.Tagged(PageIndex(addr), Common::Breakpoints::Write)) {
+        breakpoints.Check(addr & ~(sizeof(T) - 1), sizeof(T), Common::Breakpoints::Write);
+    }
+
     switch (GetRegion(addr)) {
     case Region::Bios:
         // Read only.
         break;
     case Region::XRam:
         WriteXRam(addr, data);
+        if (core.cpu->block_cache) {
+            core.cpu->block_cache->InvalidateWrite(addr);
+        }
         break;
     case Region::IRam:
         WriteIRam(addr, data);
+        if (core.cpu->block_cache) {
+            core.cpu->block_cache->InvalidateWrite(addr);
+        }
         break;
     case Region::IO:
         WriteIO(addr, data);
@@ -301,7 +472,7 @@ void Memory::WriteMem(const u32 addr, const T data, bool dma) {
             }
 
             if (save_type == SaveType::Eeprom && eeprom_ready) {
-                eeprom_bitstream.push_back(data & 0x1);
+                PushEepromBit(data);
             }
         }
         break;
@@ -317,6 +488,7 @@ void Memory::WriteMem(const u32 addr, const T data, bool dma) {
 
         if (save_type == SaveType::SRam) {
             WriteSRam(addr, data);
+            SaveWritten();
         } else if (save_type == SaveType::Flash) {
             WriteFlash(addr, data);
         }
@@ -336,83 +508,228 @@ int Memory::AccessTime(const u32 addr, AccessType access_type) {
     bool sequential = access_type == AccessType::Sequential || (addr - last_addr) <= 4;
     last_addr = addr;
 
-    auto RomTime = [this, sequential, access_type](int i) -> int {
-        if (PrefetchEnabled() && access_type == AccessType::Opcode && prefetched_opcodes > 0) {
-            prefetched_opcodes -= 1;
-            return 1;
+    const Region region = GetRegion(addr);
+    const bool rom_access = region >= Region::Rom0_l && region <= Region::Eeprom;
+    const bool opcode_prefetch = rom_access && PrefetchEnabled() && access_type == AccessType::Opcode;
+
+    if (opcode_prefetch && prefetched_opcodes > 0) {
+        prefetched_opcodes -= 1;
+        return 1;
+    }
+
+    int access_cycles = (sequential) ? seq_cycles[u32_access][static_cast<int>(region)]
+                                     : nonseq_cycles[u32_access][static_cast<int>(region)];
+
+    if (opcode_prefetch) {
+        int free_cycles = std::min(access_cycles - (1 << u32_access), prefetch_cycles);
+        access_cycles -= free_cycles;
+        prefetch_cycles -= free_cycles;
+    }
+
+    if (PrefetchEnabled() && access_type == AccessType::Normal
+                          && addr < BaseAddr::Rom
+                          && core.cpu->GetPc() >= prefetch_pc_start) {
+        RunPrefetch(access_cycles);
+    }
+
+    return access_cycles;
+}
+
+template <typename T>
+T Memory::FetchOpcode(const u32 addr, int& cycles) {
+    const Region region = GetRegion(addr);
+    const u8* page = read_pages[PageIndex(addr)];
+
+    if (page != nullptr) {
+        if (region == Region::IRam) {
+            // IWRAM opcode fetches always take a single cycle and never touch the prefetch buffer.
+            last_addr = addr;
+            cycles += 1;
+            return ReadPage<T>(page, addr);
         }
 
-        int access_cycles;
-        if (sequential) {
-            access_cycles = wait_state_s[i] << u32_access;
-        } else {
-            access_cycles = wait_state_n[i] + wait_state_s[i] * u32_access;
+        if (region >= Region::Rom0_l && region <= Region::Rom2_l && PrefetchEnabled() && (addr - last_addr) <= 4) {
+            // Sequential ROM fetch with the prefetch buffer enabled, the common case when running from the cart.
+            last_addr = addr;
+            if (prefetched_opcodes > 0) {
+                prefetched_opcodes -= 1;
+                cycles += 1;
+            } else {
+                constexpr int u32_access = sizeof(T) / 4;
+                int access_cycles = seq_cycles[u32_access][static_cast<int>(region)];
+                int free_cycles = std::min(access_cycles - (1 << u32_access), prefetch_cycles);
+                prefetch_cycles -= free_cycles;
+                cycles += access_cycles - free_cycles;
+            }
+
+            return ReadPage<T>(page, addr);
+        }
+    }
+
+    if (breakpoints.Tagged(PageIndex(addr), Common::Breakpoints::Exec)) {
+        breakpoints.Check(addr, sizeof(T), Common::Breakpoints::Exec);
+    }
+
+    cycles += AccessTime<T>(addr, AccessType::Opcode);
+    return ReadMem<T>(addr);
+}
+
+template u16 Memory::FetchOpcode<u16>(const u32 addr, int& cycles);
+template u32 Memory::FetchOpcode<u32>(const u32 addr, int& cycles);
+
+int Memory::ReadBurst(u32 addr, u32* data, int count) {
+    if (!BurstMapped(addr, count, false)) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const u32 word_addr = addr + 4 * i;
+        data[i] = ReadPage<u32>(read_pages[PageIndex(word_addr)], word_addr);
+    }
+
+    return BurstCycles(addr, count);
+}
+
+int Memory::WriteBurst(u32 addr, const u32* data, int count) {
+    if (!BurstMapped(addr, count, true)) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const u32 word_addr = addr + 4 * i;
+        std::memcpy(write_pages[PageIndex(word_addr)] + (word_addr & (page_size - 1) & ~0x3), &data[i], sizeof(u32));
+        if (core.cpu->block_cache) {
+            core.cpu->block_cache->InvalidateWrite(word_addr);
+        }
+    }
+
+    return BurstCycles(addr, count);
+}
+
+bool Memory::BurstMapped(u32 addr, int count, bool write) const {
+    if (count <= 0) {
+        return false;
+    }
+
+    const u32 last_addr_in_block = addr + 4 * (count - 1);
+    const Region region = GetRegion(addr);
+    if (GetRegion(last_addr_in_block) != region) {
+        return false;
+    }
+
+    const bool ram_region = region == Region::XRam || region == Region::IRam;
+    const bool rom_region = region >= Region::Rom0_l && region <= Region::Rom2_l;
+    if (!ram_region && !(rom_region && !write)) {
+        return false;
+    }
+
+    for (std::size_t page = PageIndex(addr); page <= PageIndex(last_addr_in_block); ++page) {
+        if ((write) ? write_pages[page] == nullptr : read_pages[page] == nullptr) {
+            return false;
         }
+    }
 
-        if (PrefetchEnabled() && access_type == AccessType::Opcode) {
-            int free_cycles = std::min(access_cycles - (1 << u32_access), prefetch_cycles);
-            access_cycles -= free_cycles;
-            prefetch_cycles -= free_cycles;
+    return true;
+}
+
+int Memory::BurstCycles(u32 addr, int count) {
+    // The first access is nonsequential unless it follows on from the last one, and the rest are sequential.
+    const int region = static_cast<int>(GetRegion(addr));
+    const int first_cycles = ((addr - last_addr) <= 4) ? seq_cycles[1][region] : nonseq_cycles[1][region];
+    const int seq = seq_cycles[1][region];
+    last_addr = addr + 4 * (count - 1);
+
+    // Data accesses outside ROM give the prefetcher time to run, as in AccessTime.
+    if (PrefetchEnabled() && addr < BaseAddr::Rom && core.cpu->GetPc() >= prefetch_pc_start) {
+        RunPrefetch(first_cycles);
+        for (int i = 1; i < count; ++i) {
+            RunPrefetch(seq);
         }
+    }
+
+    return first_cycles + (count - 1) * seq;
+}
+
+template <typename T>
+bool Memory::DmaCopy(u32 dest, u32 source, int count, int dest_step, int source_step) {
+    const u32 source_last = source + (count - 1) * source_step;
+    const u32 dest_last = dest + (count - 1) * dest_step;
+    const Region source_region = GetRegion(source);
+    const Region dest_region = GetRegion(dest);
 
-        return access_cycles;
+    // Every page in a region is mapped in the same way, unless some of them hold watchpoints or ROM patches.
+    if (!breakpoints.Empty() || cheats.HasRomPatches() || source_region != GetRegion(source_last)
+            || dest_region != GetRegion(dest_last) || read_pages[PageIndex(source)] == nullptr) {
+        return false;
+    }
+
+    auto SourcePointer = [this, source_region](u32 addr) {
+        return read_pages[PageIndex(addr)] + (addr & page_offset_mask[static_cast<int>(source_region)]);
     };
 
-    int access_cycles;
-    switch (GetRegion(addr)) {
-    case Region::Bios:
-        access_cycles = 1;
-        break;
+    // Increasing copies which don't wrap around a mirror in either region can be done in one go.
+    const u32 last_offset = (count - 1) * sizeof(T);
+    const bool contiguous = source_step == sizeof(T) && dest_step == sizeof(T) && !core.render_thread
+                            && static_cast<u32>(SourcePointer(source_last) - SourcePointer(source)) == last_offset;
+
+    auto CopyEach = [&](auto write) {
+        for (int i = 0; i < count; ++i) {
+            write(dest, ReadPage<T>(read_pages[PageIndex(source)], source));
+            dest += dest_step;
+            source += source_step;
+        }
+    };
+
+    switch (dest_region) {
     case Region::XRam:
-        access_cycles = 3 << u32_access;
-        break;
     case Region::IRam:
-        access_cycles = 1;
-        break;
-    case Region::IO:
-        // Despite being 16 bits wide, 32-bit accesses to IO registers do not incur an extra wait state.
-        // Apparently the 16-bit registers are packaged together in pairs.
-        access_cycles = 1;
+        CopyEach([this](u32 addr, T data) { WriteMem<T>(addr, data); });
         break;
     case Region::PRam:
-        access_cycles = 1 << u32_access;
+        if (contiguous && (dest_last & pram_addr_mask) - (dest & pram_addr_mask) == last_offset) {
+            std::memmove(reinterpret_cast<u8*>(pram.data()) + (dest & pram_addr_mask), SourcePointer(source),
+                         last_offset + sizeof(T));
+        } else {
+            CopyEach([this](u32 addr, T data) { WritePRam<T>(addr, data); });
+        }
         break;
-    case Region::VRam:
-        access_cycles = 1 << u32_access;
+    case Region::VRam: {
+        auto VramOffset = [](u32 addr) { return addr & ((addr & 0x0001'0000) ? vram_addr_mask2 : vram_addr_mask1); };
+        const u32 first = VramOffset(dest);
+        const u32 last = VramOffset(dest_last);
+        if (contiguous && last - first == last_offset) {
+            std::memmove(reinterpret_cast<u8*>(vram.data()) + first, SourcePointer(source), last_offset + sizeof(T));
+
+            core.lcd->bg_dirty = core.lcd->bg_dirty || first < 0x0001'0000;
+            core.lcd->obj_dirty = core.lcd->obj_dirty || last >= 0x0001'0000;
+            for (u32 addr = first & ~0x1F; addr <= last; addr += 0x20) {
+                core.lcd->tile_cache.Invalidate(addr);
+            }
+        } else {
+            CopyEach([this](u32 addr, T data) { WriteVRam<T>(addr, data); });
+        }
         break;
+    }
     case Region::Oam:
-        access_cycles = 1;
-        break;
-    case Region::Rom0_l:
-    case Region::Rom0_h:
-        access_cycles = RomTime(0);
-        break;
-    case Region::Rom1_l:
-    case Region::Rom1_h:
-        access_cycles = RomTime(1);
-        break;
-    case Region::Rom2_l:
-    case Region::Eeprom:
-        access_cycles = RomTime(2);
-        break;
-    case Region::SRam_l:
-    case Region::SRam_h:
-        access_cycles = wait_state_sram;
+        CopyEach([this](u32 addr, T data) { WriteOam<T>(addr, data); });
         break;
     default:
-        access_cycles = 1;
-        break;
+        return false;
     }
 
-    if (PrefetchEnabled() && access_type == AccessType::Normal
-                          && addr < BaseAddr::Rom
-                          && core.cpu->GetPc() >= BaseAddr::Rom) {
-        RunPrefetch(access_cycles);
+    // Leave the bus as the last transfer would have.
+    transfer_reg = ReadPage<T>(read_pages[PageIndex(source_last)], source_last);
+    if (sizeof(T) == sizeof(u16)) {
+        transfer_reg |= transfer_reg << 16;
     }
+    last_addr = dest_last;
 
-    return access_cycles;
+    return true;
 }
 
+template bool Memory::DmaCopy<u16>(u32 dest, u32 source, int count, int dest_step, int source_step);
+template bool Memory::DmaCopy<u32>(u32 dest, u32 source, int count, int dest_step, int source_step);
+
 template int Memory::AccessTime<u8>(const u32 addr, AccessType access_type);
 template int Memory::AccessTime<u16>(const u32 addr, AccessType access_type);
 template int Memory::AccessTime<u32>(const u32 addr, AccessType access_type);
@@ -427,6 +744,8 @@ void Memory::UpdateWaitStates() {
         }
     };
 
+    const bool prefetch_fast = PrefetchEnabled() && accuracy == Accuracy::Fast;
+
     wait_state_sram = 1 + WaitStates(0);
     wait_state_n[0] = 1 + WaitStates(2);
     wait_state_s[0] = 1 + ((waitcnt & 0x010) ? 1 : 2);
@@ -434,6 +753,34 @@ void Memory::UpdateWaitStates() {
     wait_state_s[1] = 1 + ((waitcnt & 0x080) ? 1 : 4);
     wait_state_n[2] = 1 + WaitStates(8);
     wait_state_s[2] = 1 + ((waitcnt & 0x400) ? 1 : 8);
+
+    for (int u32_access = 0; u32_access < 2; ++u32_access) {
+        // Most regions don't distinguish between sequential and nonsequential accesses.
+        auto& cycles = nonseq_cycles[u32_access];
+        cycles.fill(1);
+        cycles[static_cast<int>(Region::XRam)] = 3 << u32_access;
+        cycles[static_cast<int>(Region::PRam)] = 1 << u32_access;
+        cycles[static_cast<int>(Region::VRam)] = 1 << u32_access;
+        cycles[static_cast<int>(Region::SRam_l)] = wait_state_sram;
+        cycles[static_cast<int>(Region::SRam_h)] = wait_state_sram;
+
+        seq_cycles[u32_access] = cycles;
+
+        // Each ROM wait state setting covers two 16MB regions.
+        for (int i = 0; i < 3; ++i) {
+            const int rom_region = static_cast<int>(Region::Rom0_l) + 2 * i;
+            for (int r = rom_region; r < rom_region + 2; ++r) {
+                nonseq_cycles[u32_access][r] = wait_state_n[i] + wait_state_s[i] * u32_access;
+                seq_cycles[u32_access][r] = (prefetch_fast) ? 1 << u32_access : wait_state_s[i] << u32_access;
+            }
+        }
+    }
+}
+
+void Memory::SetAccuracy(Accuracy profile) {
+    accuracy = profile;
+    prefetch_pc_start = (profile == Accuracy::Fast) ? 0xFFFF'FFFF : static_cast<u32>(BaseAddr::Rom);
+    UpdateWaitStates();
 }
 
 void Memory::RunPrefetch(int cycles) {
@@ -498,424 +845,189 @@ void Memory::WriteIO(const u32 addr, const u8 data, const u16) {
 
 template <>
 u16 Memory::ReadIO(const u32 addr) const {
-    switch (addr & ~0x1) {
-    case DISPCNT:
-        return core.lcd->control.Read();
-    case GREENSWAP:
-        return core.lcd->green_swap.Read();
-    case DISPSTAT:
-        return core.lcd->status.Read();
-    case VCOUNT:
-        return core.lcd->vcount.Read();
-    case BG0CNT:
-        return core.lcd->bgs[0].control.Read();
-    case BG1CNT:
-        return core.lcd->bgs[1].control.Read();
-    case BG2CNT:
-        return core.lcd->bgs[2].control.Read();
-    case BG3CNT:
-        return core.lcd->bgs[3].control.Read();
-    case WININ:
-        return core.lcd->winin.Read();
-    case WINOUT:
-        return core.lcd->winout.Read();
-    case BLDCNT:
-        return core.lcd->blend_control.Read();
-    case BLDALPHA:
-        return core.lcd->blend_alpha.Read();
-    case SOUNDBIAS:
-        return soundbias.Read();
-    case DMA0CNT_L:
-        return 0x0000;
-    case DMA0CNT_H:
-        return core.dma[0].control.Read();
-    case DMA1CNT_L:
-        return 0x0000;
-    case DMA1CNT_H:
-        return core.dma[1].control.Read();
-    case DMA2CNT_L:
-        return 0x0000;
-    case DMA2CNT_H:
-        return core.dma[2].control.Read();
-    case DMA3CNT_L:
-        return 0x0000;
-    case DMA3CNT_H:
-        return core.dma[3].control.Read();
-    case TM0CNT_L:
-        return core.timers[0].counter.Read();
-    case TM0CNT_H:
-        return core.timers[0].control.Read();
-    case TM1CNT_L:
-        return core.timers[1].counter.Read();
-    case TM1CNT_H:
-        return core.timers[1].control.Read();
-    case TM2CNT_L:
-        return core.timers[2].counter.Read();
-    case TM2CNT_H:
-        return core.timers[2].control.Read();
-    case TM3CNT_L:
-        return core.timers[3].counter.Read();
-    case TM3CNT_H:
-        return core.timers[3].control.Read();
-    case SIOMULTI0:
-        return core.serial->data0.Read();
-    case SIOMULTI1:
-        return core.serial->data1.Read();
-    case SIOMULTI2:
-        return core.serial->data2.Read();
-    case SIOMULTI3:
-        return core.serial->data3.Read();
-    case SIOCNT:
-        return core.serial->control.Read();
-    case SIOMLTSEND:
-        return core.serial->send.Read();
-    case KEYINPUT:
-        return core.keypad->input.Read();
-    case KEYCNT:
-        return core.keypad->control.Read();
-    case RCNT:
-        return core.serial->mode.Read();
-    case JOYCNT:
-        return core.serial->joybus_control.Read();
-    case JOYRECV_L:
-        core.serial->joybus_status &= ~Serial::joystat_recv;
-        return core.serial->joybus_recv_l.Read();
-    case JOYRECV_H:
-        core.serial->joybus_status &= ~Serial::joystat_recv;
-        return core.serial->joybus_recv_h.Read();
-    case JOYTRANS_L:
-        return core.serial->joybus_trans_l.Read();
-    case JOYTRANS_H:
-        return core.serial->joybus_trans_h.Read();
-    case JOYSTAT:
-        return core.serial->joybus_status.Read();
-    case IE:
-        return intr_enable.Read();
-    case IF:
-        return intr_flags.Read();
-    case WAITCNT:
-        return waitcnt.Read();
-    case IME:
-        return master_enable.Read();
-    case HALTCNT:
-        return haltcnt.Read();
-    default:
+    const u32 index = (addr - DISPCNT) >> 1;
+    if (index >= io_table_size) {
+        return ReadOpenBus();
+    }
+
+    const IOReadEntry& entry = io_reads[index];
+    if (entry.reg) {
+        return entry.reg->Read();
+    } else if (entry.handler) {
+        return (this->*entry.handler)(addr & ~0x1);
+    } else {
         return ReadOpenBus();
     }
 }
 
-template <>
-void Memory::WriteIO(const u32 addr, const u16 data, const u16 mask) {
+void Memory::WriteLcdIO(Lcd& lcd, const u32 addr, const u16 data, const u16 mask) {
     switch (addr & ~0x1) {
     case DISPCNT:
-        core.lcd->WriteControl(data, mask);
+        lcd.WriteControl(data, mask);
         break;
     case GREENSWAP:
-        core.lcd->green_swap.Write(data, mask);
+        lcd.green_swap.Write(data, mask);
         break;
     case DISPSTAT:
-        core.lcd->status.Write(data, mask);
+        lcd.status.Write(data, mask);
         break;
     case BG0CNT:
-        core.lcd->bgs[0].control.Write(data, mask);
-        core.lcd->bgs[0].dirty = true;
+        lcd.bgs[0].control.Write(data, mask);
+        lcd.bgs[0].dirty = true;
         break;
     case BG1CNT:
-        core.lcd->bgs[1].control.Write(data, mask);
-        core.lcd->bgs[1].dirty = true;
+        lcd.bgs[1].control.Write(data, mask);
+        lcd.bgs[1].dirty = true;
         break;
     case BG2CNT:
-        core.lcd->bgs[2].control.Write(data, mask);
-        core.lcd->bgs[2].dirty = true;
+        lcd.bgs[2].control.Write(data, mask);
+        lcd.bgs[2].dirty = true;
         break;
     case BG3CNT:
-        core.lcd->bgs[3].control.Write(data, mask);
-        core.lcd->bgs[3].dirty = true;
+        lcd.bgs[3].control.Write(data, mask);
+        lcd.bgs[3].dirty = true;
         break;
     case BG0HOFS:
-        core.lcd->bgs[0].scroll_x.Write(data, mask);
+        lcd.bgs[0].scroll_x.Write(data, mask);
         break;
     case BG0VOFS:
-        core.lcd->bgs[0].scroll_y.Write(data, mask);
+        lcd.bgs[0].scroll_y.Write(data, mask);
         break;
     case BG1HOFS:
-        core.lcd->bgs[1].scroll_x.Write(data, mask);
+        lcd.bgs[1].scroll_x.Write(data, mask);
         break;
     case BG1VOFS:
-        core.lcd->bgs[1].scroll_y.Write(data, mask);
+        lcd.bgs[1].scroll_y.Write(data, mask);
         break;
     case BG2HOFS:
-        core.lcd->bgs[2].scroll_x.Write(data, mask);
+        lcd.bgs[2].scroll_x.Write(data, mask);
         break;
     case BG2VOFS:
-        core.lcd->bgs[2].scroll_y.Write(data, mask);
+        lcd.bgs[2].scroll_y.Write(data, mask);
         break;
     case BG3HOFS:
-        core.lcd->bgs[3].scroll_x.Write(data, mask);
+        lcd.bgs[3].scroll_x.Write(data, mask);
         break;
     case BG3VOFS:
-        core.lcd->bgs[3].scroll_y.Write(data, mask);
+        lcd.bgs[3].scroll_y.Write(data, mask);
         break;
     case BG2PA:
-        core.lcd->bgs[2].affine_a.Write(data, mask);
+        lcd.bgs[2].affine_a.Write(data, mask);
         break;
     case BG2PB:
-        core.lcd->bgs[2].affine_b.Write(data, mask);
+        lcd.bgs[2].affine_b.Write(data, mask);
         break;
     case BG2PC:
-        core.lcd->bgs[2].affine_c.Write(data, mask);
+        lcd.bgs[2].affine_c.Write(data, mask);
         break;
     case BG2PD:
-        core.lcd->bgs[2].affine_d.Write(data, mask);
+        lcd.bgs[2].affine_d.Write(data, mask);
         break;
     case BG2X_L:
-        core.lcd->bgs[2].offset_x_l.Write(data, mask);
-        core.lcd->bgs[2].LatchReferencePointX();
+        lcd.bgs[2].offset_x_l.Write(data, mask);
+        lcd.bgs[2].LatchReferencePointX();
         break;
     case BG2X_H:
-        core.lcd->bgs[2].offset_x_h.Write(data, mask);
-        core.lcd->bgs[2].LatchReferencePointX();
+        lcd.bgs[2].offset_x_h.Write(data, mask);
+        lcd.bgs[2].LatchReferencePointX();
         break;
     case BG2Y_L:
-        core.lcd->bgs[2].offset_y_l.Write(data, mask);
-        core.lcd->bgs[2].LatchReferencePointY();
+        lcd.bgs[2].offset_y_l.Write(data, mask);
+        lcd.bgs[2].LatchReferencePointY();
         break;
     case BG2Y_H:
-        core.lcd->bgs[2].offset_y_h.Write(data, mask);
-        core.lcd->bgs[2].LatchReferencePointY();
+        lcd.bgs[2].offset_y_h.Write(data, mask);
+        lcd.bgs[2].LatchReferencePointY();
         break;
     case BG3PA:
-        core.lcd->bgs[3].affine_a.Write(data, mask);
+        lcd.bgs[3].affine_a.Write(data, mask);
         break;
     case BG3PB:
-        core.lcd->bgs[3].affine_b.Write(data, mask);
+        lcd.bgs[3].affine_b.Write(data, mask);
         break;
     case BG3PC:
-        core.lcd->bgs[3].affine_c.Write(data, mask);
+        lcd.bgs[3].affine_c.Write(data, mask);
         break;
     case BG3PD:
-        core.lcd->bgs[3].affine_d.Write(data, mask);
+        lcd.bgs[3].affine_d.Write(data, mask);
         break;
     case BG3X_L:
-        core.lcd->bgs[3].offset_x_l.Write(data, mask);
-        core.lcd->bgs[3].LatchReferencePointX();
+        lcd.bgs[3].offset_x_l.Write(data, mask);
+        lcd.bgs[3].LatchReferencePointX();
         break;
     case BG3X_H:
-        core.lcd->bgs[3].offset_x_h.Write(data, mask);
-        core.lcd->bgs[3].LatchReferencePointX();
+        lcd.bgs[3].offset_x_h.Write(data, mask);
+        lcd.bgs[3].LatchReferencePointX();
         break;
     case BG3Y_L:
-        core.lcd->bgs[3].offset_y_l.Write(data, mask);
-        core.lcd->bgs[3].LatchReferencePointY();
+        lcd.bgs[3].offset_y_l.Write(data, mask);
+        lcd.bgs[3].LatchReferencePointY();
         break;
     case BG3Y_H:
-        core.lcd->bgs[3].offset_y_h.Write(data, mask);
-        core.lcd->bgs[3].LatchReferencePointY();
+        lcd.bgs[3].offset_y_h.Write(data, mask);
+        lcd.bgs[3].LatchReferencePointY();
         break;
     case WIN0H:
-        core.lcd->windows[0].width.Write(data, mask);
+        lcd.windows[0].width.Write(data, mask);
         break;
     case WIN1H:
-        core.lcd->windows[1].width.Write(data, mask);
+        lcd.windows[1].width.Write(data, mask);
         break;
     case WIN0V:
-        core.lcd->windows[0].height.Write(data, mask);
+        lcd.windows[0].height.Write(data, mask);
         break;
     case WIN1V:
-        core.lcd->windows[1].height.Write(data, mask);
+        lcd.windows[1].height.Write(data, mask);
         break;
     case WININ:
-        core.lcd->winin.Write(data, mask);
+        lcd.winin.Write(data, mask);
         break;
     case WINOUT:
-        core.lcd->winout.Write(data, mask);
+        lcd.winout.Write(data, mask);
         break;
     case MOSAIC:
-        core.lcd->mosaic.Write(data, mask);
+        lcd.mosaic.Write(data, mask);
         break;
     case BLDCNT:
-        core.lcd->blend_control.Write(data, mask);
+        lcd.blend_control.Write(data, mask);
         break;
     case BLDALPHA:
-        core.lcd->blend_alpha.Write(data, mask);
+        lcd.blend_alpha.Write(data, mask);
         break;
     case BLDY:
-        core.lcd->blend_fade.Write(data, mask);
-        break;
-    case SOUNDBIAS:
-        soundbias.Write(data, mask);
-        break;
-    case DMA0SAD_L:
-        core.dma[0].source_l.Write(data, mask);
-        break;
-    case DMA0SAD_H:
-        core.dma[0].source_h.Write(data, mask);
-        break;
-    case DMA0DAD_L:
-        core.dma[0].dest_l.Write(data, mask);
-        break;
-    case DMA0DAD_H:
-        core.dma[0].dest_h.Write(data, mask);
-        break;
-    case DMA0CNT_L:
-        core.dma[0].word_count.Write(data, mask);
-        break;
-    case DMA0CNT_H:
-        core.dma[0].WriteControl(data, mask);
-        break;
-    case DMA1SAD_L:
-        core.dma[1].source_l.Write(data, mask);
-        break;
-    case DMA1SAD_H:
-        core.dma[1].source_h.Write(data, mask);
-        break;
-    case DMA1DAD_L:
-        core.dma[1].dest_l.Write(data, mask);
-        break;
-    case DMA1DAD_H:
-        core.dma[1].dest_h.Write(data, mask);
-        break;
-    case DMA1CNT_L:
-        core.dma[1].word_count.Write(data, mask);
-        break;
-    case DMA1CNT_H:
-        core.dma[1].WriteControl(data, mask);
-        break;
-    case DMA2SAD_L:
-        core.dma[2].source_l.Write(data, mask);
-        break;
-    case DMA2SAD_H:
-        core.dma[2].source_h.Write(data, mask);
-        break;
-    case DMA2DAD_L:
-        core.dma[2].dest_l.Write(data, mask);
-        break;
-    case DMA2DAD_H:
-        core.dma[2].dest_h.Write(data, mask);
-        break;
-    case DMA2CNT_L:
-        core.dma[2].word_count.Write(data, mask);
-        break;
-    case DMA2CNT_H:
-        core.dma[2].WriteControl(data, mask);
-        break;
-    case DMA3SAD_L:
-        core.dma[3].source_l.Write(data, mask);
-        break;
-    case DMA3SAD_H:
-        core.dma[3].source_h.Write(data, mask);
-        break;
-    case DMA3DAD_L:
-        core.dma[3].dest_l.Write(data, mask);
-        break;
-    case DMA3DAD_H:
-        core.dma[3].dest_h.Write(data, mask);
-        break;
-    case DMA3CNT_L:
-        core.dma[3].word_count.Write(data, mask);
-        break;
-    case DMA3CNT_H:
-        core.dma[3].WriteControl(data, mask);
-        break;
-    case TM0CNT_L:
-        core.timers[0].reload.Write(data, mask);
-        break;
-    case TM0CNT_H:
-        core.timers[0].WriteControl(data, mask);
-        break;
-    case TM1CNT_L:
-        core.timers[1].reload.Write(data, mask);
-        break;
-    case TM1CNT_H:
-        core.timers[1].WriteControl(data, mask);
-        break;
-    case TM2CNT_L:
-        core.timers[2].reload.Write(data, mask);
-        break;
-    case TM2CNT_H:
-        core.timers[2].WriteControl(data, mask);
-        break;
-    case TM3CNT_L:
-        core.timers[3].reload.Write(data, mask);
-        break;
-    case TM3CNT_H:
-        core.timers[3].WriteControl(data, mask);
-        break;
-    case SIOMULTI0:
-        core.serial->data0.Write(data, mask);
-        break;
-    case SIOMULTI1:
-        core.serial->data1.Write(data, mask);
-        break;
-    case SIOMULTI2:
-        core.serial->data2.Write(data, mask);
-        break;
-    case SIOMULTI3:
-        core.serial->data3.Write(data, mask);
-        break;
-    case SIOCNT:
-        core.serial->control.Write(data, mask);
-        break;
-    case SIOMLTSEND:
-        core.serial->send.Write(data, mask);
-        break;
-    case KEYCNT:
-        core.keypad->control.Write(data, mask);
-        break;
-    case RCNT:
-        core.serial->mode.Write(data, mask);
-        break;
-    case JOYCNT:
-        // Bits 0-2 of JOYCNT behave like IF. The IRQ enable bit is normally writeable.
-        core.serial->joybus_control.Clear(data & Serial::joycnt_ack_mask);
-        core.serial->joybus_control.Write(data & Serial::joycnt_irq_enable, mask);
-        break;
-    case JOYRECV_L:
-        core.serial->joybus_recv_l.Write(data, mask);
-        break;
-    case JOYRECV_H:
-        core.serial->joybus_recv_h.Write(data, mask);
-        break;
-    case JOYTRANS_L:
-        core.serial->joybus_trans_l.Write(data, mask);
-        core.serial->joybus_status |= Serial::joystat_trans;
-        break;
-    case JOYTRANS_H:
-        core.serial->joybus_trans_h.Write(data, mask);
-        core.serial->joybus_status |= Serial::joystat_trans;
-        break;
-    case JOYSTAT:
-        core.serial->joybus_status.Write(data, mask);
-        break;
-    case IE:
-        intr_enable.Write(data, mask);
-        break;
-    case IF:
-        // Writing "1" to a bit in IF clears that bit.
-        intr_flags.Clear(data);
-        break;
-    case WAITCNT:
-        waitcnt.Write(data, mask);
-        UpdateWaitStates();
-        break;
-    case IME:
-        master_enable.Write(data, mask);
-        break;
-    case HALTCNT:
-        haltcnt.Write(data, mask);
-        if ((mask & 0xFF00) == 0xFF00 && (data & 0x8000) == 0) {
-            if (master_enable == 0 && intr_enable == 0) {
-                throw std::runtime_error("The CPU has hung: halt mode entered with interrupts disabled.");
-            }
-
-            core.cpu->Halt();
-        }
+        lcd.blend_fade.Write(data, mask);
         break;
     default:
         break;
     }
 }
 
+template <>
+void Memory::WriteIO(const u32 addr, const u16 data, const u16 mask) {
+    const u32 index = (addr - DISPCNT) >> 1;
+    if (index >= io_table_size) {
+        return;
+    }
+
+    const IOWriteEntry& entry = io_writes[index];
+    if (entry.reg) {
+        entry.reg->Write(data, mask);
+    } else if (entry.handler) {
+        (this->*entry.handler)(addr & ~0x1, data, mask);
+    }
+
+    // The render thread keeps its own copy of the LCD registers.
+    if (core.render_thread && (addr & ~0x1) <= BLDY) {
+        core.render_thread->WriteIO(addr, data, mask, core.lcd->vcount);
+    }
+}
+
+bool Memory::SoundIO(const u32 addr) {
+    const u32 reg = addr & ~0x1;
+    return (reg >= Audio::SOUND1CNT_L && reg <= Audio::SOUNDCNT_X)
+           || (reg >= Audio::WAVE_RAM && reg < Audio::FIFO_B + 4);
+}
+
 u32 Memory::ReadOpenBus() const {
     if (core.cpu->ArmMode()) {
         return core.cpu->GetPrefetchedOpcode(2);
@@ -960,4 +1072,55 @@ u32 Memory::ReadOpenBus() const {
     }
 }
 
+void Memory::Serialize(Common::StateBuffer& state, bool include_arena) {
+    state.BeginChunk("MEM ", 2);
+    // The regions are stored as the raw arena. Like ReadPage, this relies on a little-endian host.
+    if (include_arena) {
+        state.SyncBytes(arena.Data(), arena.Size());
+    }
+    state.Sync(transfer_reg);
+
+    state.Sync(last_addr);
+    state.Sync(prefetch_cycles);
+    state.Sync(prefetched_opcodes);
+
+    state.Sync(soundbias.v);
+    state.Sync(intr_enable.v);
+    state.Sync(intr_flags.v);
+    state.Sync(waitcnt.v);
+    state.Sync(master_enable.v);
+    state.Sync(haltcnt.v);
+    state.EndChunk();
+
+    // The save chip is only detected once the game first accesses it, so its type and size are part of the state.
+    state.BeginChunk("SAVE", 2);
+    state.Sync(save_type);
+    state.Sync(sram);
+    state.Sync(eeprom);
+    state.Sync(sram_addr_mask);
+
+    state.Sync(eeprom_addr_len);
+    state.Sync(eeprom_stream);
+    state.Sync(eeprom_stream_len);
+    state.Sync(eeprom_ready);
+    state.Sync(eeprom_read_pos);
+    state.Sync(eeprom_read_buffer);
+
+    state.Sync(flash_state);
+    state.Sync(last_flash_cmd);
+    state.Sync(flash_id_mode);
+    state.Sync(chip_id);
+    state.Sync(bank_num);
+
+    state.Sync(delayed_save_op);
+    state.Sync(save_op_addr);
+    state.Sync(save_op_data);
+    state.EndChunk();
+
+    if (state.Loading()) {
+        UpdateWaitStates();
+        MapPages();
+    }
+}
+
 } // End namespace Gba
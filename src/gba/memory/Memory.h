@@ -19,20 +19,31 @@
 #include <vector>
 #include <array>
 #include <string>
-#include <functional>
+#include <cstring>
 
 #include "common/CommonTypes.h"
+#include "common/CommonEnums.h"
 #include "common/CommonFuncs.h"
+#include "common/Breakpoints.h"
+#include "common/Cheats.h"
+#include "common/MappedFile.h"
+#include "common/SaveWriter.h"
+#include "common/SaveBuffer.h"
+#include "common/MemoryArena.h"
 #include "gba/memory/IOReg.h"
 #include "gba/core/Enums.h"
 
+namespace Common { class StateBuffer; }
+
 namespace Gba {
 
 class Core;
+class Lcd;
 
 class Memory {
 public:
-    Memory(const std::vector<u32>& _bios, const std::vector<u16>& _rom, const std::string& _save_path, Core& _core);
+    Memory(const Common::RomView<u32>& _bios, const Common::RomView<u16>& _rom, const std::string& _save_path,
+           bool mmap_saves, bool huge_pages, Core& _core);
     ~Memory();
 
     u32 transfer_reg = 0x0;
@@ -43,11 +54,39 @@ public:
     void WriteMem(const u32 addr, const T data, bool dma = false);
     template <typename T>
     int AccessTime(const u32 addr, AccessType access_type = AccessType::Normal);
+    // Reads an opcode and adds its access time to cycles. Equivalent to ReadMem followed by an opcode AccessTime.
+    template <typename T>
+    T FetchOpcode(const u32 addr, int& cycles);
+    // Transfers count consecutive words starting at addr, with the same effect as a ReadMem or WriteMem and an
+    // AccessTime for each. Returns the total access cycles, or -1 without accessing anything if the block isn't
+    // directly mapped within IWRAM, EWRAM or (for reads) ROM.
+    int ReadBurst(u32 addr, u32* data, int count);
+    int WriteBurst(u32 addr, const u32* data, int count);
+
+    // Performs count DMA transfers between directly mapped regions, with the same effect as the equivalent ReadMem
+    // and WriteMem calls. Returns false without transferring anything if either range isn't directly mapped or
+    // leaves its region.
+    template <typename T>
+    bool DmaCopy(u32 dest, u32 source, int count, int dest_step, int source_step);
+    // The cycles taken by each sequential DMA transfer between the given regions.
+    template <typename T>
+    int DmaSequentialCycles(const u32 dest, const u32 source) const {
+        constexpr int u32_access = sizeof(T) / 4;
+        return seq_cycles[u32_access][static_cast<int>(GetRegion(source))]
+               + seq_cycles[u32_access][static_cast<int>(GetRegion(dest))];
+    }
 
     void MakeNextAccessSequential(u32 addr) { last_addr = addr; }
     void MakeNextAccessNonsequential() { last_addr = 0; }
 
     bool PrefetchEnabled() const { return waitcnt & 0x4000; }
+    // The fast profile doesn't model the prefetch buffer filling up. With prefetch enabled, sequential ROM
+    // accesses instead always take one cycle per halfword, as if the buffer had the next opcode ready. Open bus
+    // reads are the same in both profiles, since they decide the value read rather than the timing.
+    void SetAccuracy(Accuracy profile);
+    Accuracy GetAccuracy() const { return accuracy; }
+    // The prefetcher only runs while the PC is at or above this address.
+    u32 PrefetchPcStart() const { return prefetch_pc_start; }
     void RunPrefetch(int cycles);
     void FlushPrefetchBuffer() { prefetch_cycles = 0; prefetched_opcodes = 0; last_addr = 0; }
 
@@ -56,46 +95,125 @@ public:
     void RequestInterrupt(u16 intr) { intr_flags |= intr; };
     bool InterruptEnabled(u16 intr) const { return intr_enable & intr; };
 
+    // The BIOS sets POSTFLG at the end of boot, which games check to tell power-on from a soft reset.
+    void SetPostBootFlag() { haltcnt = 0x0001; }
+
     bool EepromAddr(u32 addr) const { return !large_rom || addr >= 0x0DFF'FF00; }
+    bool EepromAccess(u32 addr) const { return addr >= BaseAddr::Eeprom && addr < BaseAddr::SRam && EepromAddr(addr); }
     void ParseEepromCommand();
 
-    void DelayedSaveOp(int cycles);
-
-    const std::vector<u16>& PramReference() const { return pram; }
-    const std::vector<u16>& VramReference() const { return vram; }
-    const std::vector<u32>& OamReference() const { return oam; }
+    // Breakpoints are hit by opcode fetches, and watchpoints by reads and writes from the CPU or DMA.
+    void AddBreakpoint(u32 addr, Common::Breakpoints::Type type);
+    void RemoveBreakpoint(u32 addr, Common::Breakpoints::Type type);
+    bool ExecBreakpointPage(u32 addr) const { return breakpoints.Tagged(PageIndex(addr), Common::Breakpoints::Exec); }
+    bool BreakpointTriggered() const { return breakpoints.Triggered(); }
+    std::vector<Common::Breakpoints::Hit> TakeBreakpointHits() { return breakpoints.TakeHits(); }
+
+    // Throws if the code can't be decoded.
+    void AddCheat(const std::string& code);
+    const Common::Cheats& CheatList() const { return cheats; }
+    void SetCheats(const Common::Cheats& cheat_list);
+    // Called on entering VBlank.
+    void ApplyCheatWrites();
+
+    const Common::ArenaArray<u16>& XRamReference() const { return xram; }
+    const Common::ArenaArray<u32>& IRamReference() const { return iram; }
+    const Common::ArenaArray<u16>& PramReference() const { return pram; }
+    const Common::ArenaArray<u16>& VramReference() const { return vram; }
+    const Common::ArenaArray<u32>& OamReference() const { return oam; }
+    // Holds all of the regions above. Save memory isn't included, since it may be mapped from the save file.
+    const Common::MemoryArena& Arena() const { return arena; }
+    // Gives other's regions this memory's contents, sharing the pages copy-on-write where possible. Used for
+    // cloning, along with a state which leaves the arena out.
+    void ShareArena(Memory& other) { arena.ShareCopyOnWrite(other.arena); }
 
     static bool CheckNintendoLogo(const std::vector<u8>& rom_header) noexcept;
-    static void CheckHeader(const std::vector<u16>& rom_header);
+    static void CheckHeader(const Common::RomView<u16>& rom_header);
+
+    // Fills in the IO dispatch tables. The core calls this once every component which owns IO registers exists.
+    void MapIO();
+
+    // Applies a write to one of the LCD registers between DISPCNT and BLDY to the given LCD.
+    static void WriteLcdIO(Lcd& lcd, const u32 addr, const u16 data, const u16 mask);
+
+    void Serialize(Common::StateBuffer& state, bool include_arena = true);
+
+    // When the save memory maps the save file, starts writing back anything the game saved this frame.
+    void SyncSaveFile();
 
 private:
-    const std::vector<u32>& bios;
-    std::vector<u16> xram;
-    std::vector<u32> iram;
-    std::vector<u16> pram;
-    std::vector<u16> vram;
-    std::vector<u32> oam;
-    const std::vector<u16>& rom;
-    std::vector<u8> sram;
-    std::vector<u64> eeprom;
+    const Common::RomView<u32>& bios;
+    Common::MemoryArena arena;
+    Common::ArenaArray<u16> xram;
+    Common::ArenaArray<u32> iram;
+    Common::ArenaArray<u16> pram;
+    Common::ArenaArray<u16> vram;
+    Common::ArenaArray<u32> oam;
+    const Common::RomView<u16>& rom;
+    Common::SaveBuffer<u8> sram;
+    Common::SaveBuffer<u64> eeprom;
 
     Core& core;
 
     u32 last_addr = 0x0;
     int prefetch_cycles = 0;
     int prefetched_opcodes = 0;
+    Accuracy accuracy = Accuracy::Accurate;
+    // The start of ROM, or past the end of the address space under the fast profile. The profile is only applied
+    // through this and the wait state tables, so the prefetch checks are the same ones made without profiles.
+    u32 prefetch_pc_start = BaseAddr::Rom;
 
     std::array<int, 3> wait_state_n;
     std::array<int, 3> wait_state_s;
     int wait_state_sram;
 
+    // Access cycles for each region, indexed by [32-bit access][region]. Rebuilt whenever WAITCNT is written.
+    std::array<std::array<int, 16>, 2> nonseq_cycles;
+    std::array<std::array<int, 16>, 2> seq_cycles;
+
+    // Host pointers for each 16KB page of the address space, for the regions which can be accessed directly.
+    // A null page falls back to the region switch in ReadMem and WriteMem.
+    static constexpr int page_shift = 14;
+    static constexpr u32 page_size = 1 << page_shift;
+    static constexpr std::size_t num_pages = BaseAddr::Max >> page_shift;
+
+    std::array<const u8*, num_pages> read_pages{};
+    std::array<u8*, num_pages> write_pages{};
+    // PRAM and OAM are smaller than a page, so the offset mask within a page depends on the region.
+    std::array<u32, 16> page_offset_mask{};
+
+    static constexpr std::size_t PageIndex(const u32 addr) { return (addr & (BaseAddr::Max - 1)) >> page_shift; }
+
+    // Pages holding a breakpoint are left out of the page tables for the accesses it applies to.
+    Common::Breakpoints breakpoints{page_shift, num_pages};
+    // Likewise, pages with ROM patches aren't in read_pages.
+    Common::Cheats cheats{page_shift, num_pages};
+    void MapPages();
+    bool BurstMapped(u32 addr, int count, bool write) const;
+    int BurstCycles(u32 addr, int count);
+
+    template <typename T>
+    T ReadPage(const u8* page, const u32 addr) const {
+        // Unaligned accesses are aligned to the access width. This relies on a little-endian host.
+        T data;
+        std::memcpy(&data, page + (addr & page_offset_mask[static_cast<int>(GetRegion(addr))] & ~(sizeof(T) - 1)),
+                    sizeof(T));
+        return data;
+    }
+
     enum class SaveType;
     SaveType save_type;
     const std::string& save_path;
+    Common::SaveWriter save_writer;
+    // Set when the game writes to file-backed save memory, and cleared once the write has been synced.
+    bool save_file_dirty = false;
     const bool large_rom;
 
     int eeprom_addr_len = 0;
-    std::vector<u8> eeprom_bitstream;
+    // The bits of the command being clocked in by DMA, in the order they arrived. The longest valid command is 81
+    // bits; anything past the end is only counted, so oversized streams still get rejected.
+    std::array<u64, 2> eeprom_stream{};
+    int eeprom_stream_len = 0;
     u16 eeprom_ready = 0x1;
 
     int eeprom_read_pos = 64;
@@ -129,15 +247,21 @@ private:
     u16 chip_id = panasonic_id;
     int bank_num = 0;
 
-    struct DelayedOp {
-        DelayedOp(int _cycles, std::function<void()> _action)
-                : cycles(_cycles)
-                , action(_action) {}
+    // Run by the scheduler once the pending EEPROM or flash operation completes. Kept as plain data rather than
+    // a closure so that it can be saved in a save state.
+    enum class SaveOp {None, EepromReady, FlashWrite, FlashEraseSector, FlashEraseChip};
+    SaveOp delayed_save_op = SaveOp::None;
+    u32 save_op_addr = 0x0;
+    u8 save_op_data = 0x0;
 
-        int cycles;
-        std::function<void()> action;
-    };
-    DelayedOp delayed_op{0, [](){}};
+    void DelaySaveOp(int cycles, SaveOp op, u32 addr = 0x0, u8 data = 0x0);
+    void RunSaveOp();
+
+    // The save is written to disk in the background once the save chip has gone this long without being written,
+    // so a game saving its progress is flushed as a single write about half a second after it finishes.
+    static constexpr int save_idle_cycles = 280896 * 30;
+    void SaveWritten();
+    std::vector<u8> SaveSnapshot() const;
 
     static constexpr unsigned int kbyte = 1024;
     static constexpr unsigned int mbyte = kbyte * kbyte;
@@ -190,30 +314,36 @@ private:
     }
 
     template <typename AccessWidth, typename BusWidth>
-    AccessWidth ReadRegion(const std::vector<BusWidth>& region, const AddressMask region_mask, const u32 addr) const;
+    AccessWidth ReadRegion(const BusWidth* region, const AddressMask region_mask, const u32 addr) const;
     template <typename AccessWidth, typename BusWidth>
-    void WriteRegion(std::vector<BusWidth>& region, const AddressMask region_mask, const u32 addr, const AccessWidth data);
+    void WriteRegion(Common::ArenaArray<BusWidth>& region, const AddressMask region_mask, const u32 addr,
+                     const AccessWidth data);
 
     template <typename T>
     T ReadBios(const u32 addr) const;
     template <typename T>
-    T ReadXRam(const u32 addr) const { return ReadRegion<T>(xram, xram_addr_mask, addr); }
+    T ReadXRam(const u32 addr) const { return ReadRegion<T>(xram.data(), xram_addr_mask, addr); }
     template <typename T>
-    T ReadIRam(const u32 addr) const { return ReadRegion<T>(iram, iram_addr_mask, addr); }
+    T ReadIRam(const u32 addr) const { return ReadRegion<T>(iram.data(), iram_addr_mask, addr); }
     template <typename T>
     T ReadIO(const u32 addr) const;
     template <typename T>
-    T ReadPRam(const u32 addr) const { return ReadRegion<T>(pram, pram_addr_mask, addr); }
+    T ReadPRam(const u32 addr) const { return ReadRegion<T>(pram.data(), pram_addr_mask, addr); }
     template <typename T>
     T ReadVRam(const u32 addr) const {
-        return ReadRegion<T>(vram, (addr & 0x0001'0000) ? vram_addr_mask2 : vram_addr_mask1, addr);
+        return ReadRegion<T>(vram.data(), (addr & 0x0001'0000) ? vram_addr_mask2 : vram_addr_mask1, addr);
     }
     template <typename T>
-    T ReadOam(const u32 addr) const { return ReadRegion<T>(oam, oam_addr_mask, addr); }
+    T ReadOam(const u32 addr) const { return ReadRegion<T>(oam.data(), oam_addr_mask, addr); }
     template <typename T>
-    T ReadRomLo(const u32 addr) const { return ReadRegion<T>(rom, rom_addr_mask, addr); }
+    T ReadRomLo(const u32 addr) const {
+        return cheats.PatchRead(addr & ~(sizeof(T) - 1), ReadRegion<T>(rom.data(), rom_addr_mask, addr));
+    }
     template <typename T>
-    T ReadRomHi(const u32 addr) const { return (large_rom) ? ReadRegion<T>(rom, rom_addr_mask, addr) : 0; }
+    T ReadRomHi(const u32 addr) const {
+        return (large_rom) ? cheats.PatchRead(addr & ~(sizeof(T) - 1), ReadRegion<T>(rom.data(), rom_addr_mask, addr))
+                           : 0;
+    }
     template <typename T>
     T ReadSRam(const u32 addr) const { return sram[bank_num * flash_size + (addr & sram_addr_mask)] * 0x0101'0101; }
 
@@ -224,7 +354,7 @@ private:
     template <typename T>
     void WriteIO(const u32 addr, const T data, const u16 mask = 0xFFFF);
     template <typename T>
-    void WritePRam(const u32 addr, const T data) { WriteRegion(pram, pram_addr_mask, addr, data); }
+    void WritePRam(const u32 addr, const T data);
     template <typename T>
     void WriteVRam(const u32 addr, const T data);
     template <typename T>
@@ -238,14 +368,65 @@ private:
 
     void UpdateWaitStates();
     u32 ReadOpenBus() const;
+    // SOUNDBIAS is kept here, while the rest of the sound registers belong to the APU.
+    static bool SoundIO(const u32 addr);
+
+    // IO accesses are dispatched through tables indexed by halfword. Registers without side effects are read and
+    // written through their IOReg directly, using its masks, and only the rest have handlers. Unmapped addresses
+    // read as open bus and ignore writes.
+    using IOReadHandler = u16 (Memory::*)(u32 addr) const;
+    using IOWriteHandler = void (Memory::*)(u32 addr, u16 data, u16 mask);
+
+    struct IOReadEntry {
+        const IOReg* reg = nullptr;
+        IOReadHandler handler = nullptr;
+    };
+
+    struct IOWriteEntry {
+        IOReg* reg = nullptr;
+        IOWriteHandler handler = nullptr;
+    };
+
+    static constexpr std::size_t io_table_size = 0x200;
+    std::array<IOReadEntry, io_table_size> io_reads{};
+    std::array<IOWriteEntry, io_table_size> io_writes{};
+
+    u16 ReadSoundIO(u32 addr) const;
+    u16 ReadZero(u32) const { return 0x0000; }
+    u16 ReadTimerCounter(u32 addr) const;
+    u16 ReadJoybusRecv(u32 addr) const;
+
+    void WriteSoundIO(u32 addr, u16 data, u16 mask);
+    void WriteLcdControl(u32 addr, u16 data, u16 mask);
+    void WriteBgControl(u32 addr, u16 data, u16 mask);
+    void WriteBgReferencePoint(u32 addr, u16 data, u16 mask);
+    void WriteDmaControl(u32 addr, u16 data, u16 mask);
+    void WriteTimerControl(u32 addr, u16 data, u16 mask);
+    void WriteSerialControl(u32 addr, u16 data, u16 mask);
+    void WriteJoybusControl(u32 addr, u16 data, u16 mask);
+    void WriteJoybusTrans(u32 addr, u16 data, u16 mask);
+    void WriteIF(u32 addr, u16 data, u16 mask);
+    void WriteWaitcnt(u32 addr, u16 data, u16 mask);
+    void WriteHaltcnt(u32 addr, u16 data, u16 mask);
 
     void ReadSaveFile();
-    void WriteSaveFile() const;
+    void WriteSaveFile();
     void InitSRam();
 
     void InitFlash();
 
     u16 ParseEepromAddr(int stream_size, int non_addr_bits);
+    void PushEepromBit(u16 data) {
+        if (eeprom_stream_len < 128) {
+            eeprom_stream[eeprom_stream_len / 64] |= static_cast<u64>(data & 0x1) << (eeprom_stream_len % 64);
+        }
+        ++eeprom_stream_len;
+    }
+    u64 EepromBit(int i) const { return (eeprom_stream[i / 64] >> (i % 64)) & 0x1; }
+    void ClearEepromStream() {
+        eeprom_stream.fill(0);
+        eeprom_stream_len = 0;
+    }
     void InitEeprom(int stream_size, int non_addr_bits);
 
     // IO registers
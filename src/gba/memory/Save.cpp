@@ -19,11 +19,19 @@
 #include <fmt/format.h>
 
 #include "gba/memory/Memory.h"
-#include "emu/ParseOptions.h"
+#include "gba/core/Core.h"
+#include "gba/core/Scheduler.h"
+#include "common/FileUtils.h"
 
 namespace Gba {
 
 void Memory::ReadSaveFile() {
+    if (save_path.empty()) {
+        // Clones have no save file. Their save memory comes from the state of the core they were cloned from.
+        save_type = SaveType::Unknown;
+        return;
+    }
+
     std::ifstream save_file(save_path);
     if (!save_file) {
         // Save file doesn't exist.
@@ -45,23 +53,27 @@ void Memory::ReadSaveFile() {
         return;
     }
 
-    Emu::CheckPathIsRegularFile(save_path);
+    Common::CheckPathIsRegularFile(save_path);
 
-    const auto save_size = Emu::GetFileSize(save_file);
+    const auto save_size = Common::GetFileSize(save_file);
 
     if (save_size == 32 * kbyte) {
         fmt::print("Found SRAM save\n");
 
         save_type = SaveType::SRam;
         sram.resize(save_size);
-        save_file.read(reinterpret_cast<char*>(sram.data()), save_size);
+        if (!sram.FileBacked()) {
+            save_file.read(reinterpret_cast<char*>(sram.data()), save_size);
+        }
         sram_addr_mask = sram_size - 1;
     } else if (save_size == 8 * kbyte || save_size == 512) {
         fmt::print("Found EEPROM save\n");
 
         save_type = SaveType::Eeprom;
         eeprom.resize(save_size / sizeof(u64));
-        save_file.read(reinterpret_cast<char*>(eeprom.data()), save_size);
+        if (!eeprom.FileBacked()) {
+            save_file.read(reinterpret_cast<char*>(eeprom.data()), save_size);
+        }
 
         if (save_size == 8 * kbyte) {
             eeprom_addr_len = 14;
@@ -73,7 +85,9 @@ void Memory::ReadSaveFile() {
 
         save_type = SaveType::Flash;
         sram.resize(save_size);
-        save_file.read(reinterpret_cast<char*>(sram.data()), save_size);
+        if (!sram.FileBacked()) {
+            save_file.read(reinterpret_cast<char*>(sram.data()), save_size);
+        }
         sram_addr_mask = flash_size - 1;
 
         if (save_size == flash_size * 2) {
@@ -85,24 +99,45 @@ void Memory::ReadSaveFile() {
     } else {
         throw std::runtime_error(fmt::format("Invalid save game size: {} bytes.", save_size));
     }
+
+    if (!sram.FileBacked()) {
+        save_writer.SetWritten(SaveSnapshot());
+    }
 }
 
-void Memory::WriteSaveFile() const {
-    if (save_type == SaveType::Unknown) {
+void Memory::WriteSaveFile() {
+    if (save_type == SaveType::Unknown || sram.FileBacked()) {
+        // A file-backed save is written back by the OS, and synced when the mapping is destroyed.
         return;
     }
 
-    std::ofstream save_file(save_path);
+    save_writer.Submit(SaveSnapshot());
+}
 
-    if (!save_file) {
-        fmt::print("Error: could not open {} to write save file to disk.\n", save_path);
+std::vector<u8> Memory::SaveSnapshot() const {
+    if (save_type == SaveType::Eeprom) {
+        const u8* eeprom_bytes = reinterpret_cast<const u8*>(eeprom.data());
+        return {eeprom_bytes, eeprom_bytes + eeprom.size() * sizeof(u64)};
     } else {
-        if (save_type == SaveType::SRam || save_type == SaveType::Flash) {
-            save_file.write(reinterpret_cast<const char*>(sram.data()), sram.size());
-        } else if (save_type == SaveType::Eeprom) {
-            save_file.write(reinterpret_cast<const char*>(eeprom.data()), eeprom.size() * sizeof(u64));
-        }
-        save_file.flush();
+        return {sram.begin(), sram.end()};
+    }
+}
+
+void Memory::SaveWritten() {
+    if (sram.FileBacked()) {
+        save_file_dirty = true;
+        return;
+    }
+
+    // Rescheduling replaces the pending flush, so it only runs once writes stop.
+    core.scheduler->Schedule(EventType::SaveFlush, save_idle_cycles);
+}
+
+void Memory::SyncSaveFile() {
+    if (save_file_dirty) {
+        sram.Sync();
+        eeprom.Sync();
+        save_file_dirty = false;
     }
 }
 
@@ -122,13 +157,36 @@ void Memory::InitFlash() {
     sram_addr_mask = flash_size - 1;
 }
 
-void Memory::DelayedSaveOp(int cycles) {
-    if (delayed_op.cycles > 0) {
-        delayed_op.cycles -= cycles;
-        if (delayed_op.cycles <= 0) {
-            delayed_op.action();
-        }
+void Memory::DelaySaveOp(int cycles, SaveOp op, u32 addr, u8 data) {
+    delayed_save_op = op;
+    save_op_addr = addr;
+    save_op_data = data;
+    core.scheduler->Schedule(EventType::SaveOp, cycles);
+}
+
+void Memory::RunSaveOp() {
+    switch (delayed_save_op) {
+    case SaveOp::EepromReady:
+        eeprom_ready = 1;
+        SaveWritten();
+        break;
+    case SaveOp::FlashWrite:
+        WriteSRam(save_op_addr, save_op_data);
+        SaveWritten();
+        break;
+    case SaveOp::FlashEraseSector:
+        std::fill_n(sram.begin() + bank_num * flash_size + (save_op_addr & 0x0000'F000), 0x1000, 0xFF);
+        SaveWritten();
+        break;
+    case SaveOp::FlashEraseChip:
+        std::fill(sram.begin(), sram.end(), 0xFF);
+        SaveWritten();
+        break;
+    default:
+        break;
     }
+
+    delayed_save_op = SaveOp::None;
 }
 
 void Memory::ParseEepromCommand() {
@@ -136,28 +194,28 @@ void Memory::ParseEepromCommand() {
         return;
     }
 
-    const auto stream_size = eeprom_bitstream.size();
+    const int stream_size = eeprom_stream_len;
     if (!eeprom_ready || stream_size < 9) {
         if (!eeprom_ready) {
             fmt::print("ParseEepromCommand when eeprom not ready\n");
         } else {
             fmt::print("ParseEepromCommand when stream size too small: {}\n", stream_size);
         }
-        eeprom_bitstream.clear();
+        ClearEepromStream();
         return;
     }
 
-    if (eeprom_bitstream[0] != 1) {
+    if (EepromBit(0) != 1) {
         // Malformed request type.
         fmt::print("First bit of bitstream not 1.\n");
-        eeprom_bitstream.clear();
+        ClearEepromStream();
         return;
     }
 
-    const bool read_request = eeprom_bitstream[1] == 1;
+    const bool read_request = EepromBit(1) == 1;
     u16 eeprom_addr = ParseEepromAddr(stream_size, read_request ? 3 : 67);
     if (eeprom_addr == 0xFFFF) {
-        eeprom_bitstream.clear();
+        ClearEepromStream();
         return;
     }
 
@@ -171,19 +229,14 @@ void Memory::ParseEepromCommand() {
         eeprom_read_pos = 0;
     } else if (eeprom_addr <= 0x3FF) {
         // OOB EEPROM writes are ignored.
-        u64 value = 0;
-        for (int i = 0; i < 64; ++i) {
-            value |= static_cast<u64>(eeprom_bitstream[i + 2 + eeprom_addr_len]) << i;
-        }
-
-        eeprom[eeprom_addr] = value;
+        // The 64 data bits follow the address, LSB first, so they can be shifted straight out of the stream.
+        const int data_start = 2 + eeprom_addr_len;
+        eeprom[eeprom_addr] = (eeprom_stream[0] >> data_start) | (eeprom_stream[1] << (64 - data_start));
         eeprom_ready = 0;
-        delayed_op = {108368, [this]() {
-            eeprom_ready = 1;
-        }};
+        DelaySaveOp(108368, SaveOp::EepromReady);
     }
 
-    eeprom_bitstream.clear();
+    ClearEepromStream();
 }
 
 u16 Memory::ParseEepromAddr(int stream_size, int non_addr_bits) {
@@ -194,14 +247,14 @@ u16 Memory::ParseEepromAddr(int stream_size, int non_addr_bits) {
     if (stream_size != non_addr_bits + eeprom_addr_len) {
         // Invalid size.
         fmt::print("Invalid bitstream size: {}.\n", stream_size);
-        eeprom_bitstream.clear();
+        ClearEepromStream();
         return 0xFFFF;
     }
 
     u16 eeprom_addr = 0;
     for (int i = 0; i < eeprom_addr_len; ++i) {
         // The EEPROM address is written MSB first.
-        eeprom_addr |= static_cast<u16>(eeprom_bitstream[i + 2]) << (eeprom_addr_len - 1 - i);
+        eeprom_addr |= static_cast<u16>(EepromBit(i + 2)) << (eeprom_addr_len - 1 - i);
     }
 
     return eeprom_addr;
@@ -228,9 +281,9 @@ void Memory::WriteFlash(const u32 addr, const T data) {
     switch (flash_state) {
     case FlashState::Command:
         if (last_flash_cmd == FlashCmd::Write) {
-            delayed_op = {flash_write_cycles, [this, addr, data]() {
-                WriteSRam(addr, data);
-            }};
+            // Flash is on an 8-bit bus, so only the byte which would be written to this address matters.
+            DelaySaveOp(flash_write_cycles, SaveOp::FlashWrite, addr,
+                        RotateRight(data, (addr & (sizeof(T) - 1)) * 8));
         } else if (last_flash_cmd == FlashCmd::BankSwitch) {
             if (sram.size() == flash_size * 2) {
                 bank_num = data & 0x1;
@@ -260,9 +313,7 @@ void Memory::WriteFlash(const u32 addr, const T data) {
 
     case FlashState::Ready:
         if (last_flash_cmd == FlashCmd::Erase && data == FlashCmd::EraseSector) {
-            delayed_op = {flash_erase_cycles, [this, addr]() {
-                std::fill_n(sram.begin() + bank_num * flash_size + (addr & 0x0000'F000), 0x1000, 0xFF);
-            }};
+            DelaySaveOp(flash_erase_cycles, SaveOp::FlashEraseSector, addr);
 
             flash_state = FlashState::NotStarted;
         } else if (addr == flash_cmd_addr1) {
@@ -279,9 +330,7 @@ void Memory::WriteFlash(const u32 addr, const T data) {
                 break;
             case EraseChip:
                 if (last_flash_cmd == FlashCmd::Erase) {
-                    delayed_op = {flash_erase_cycles, [this]() {
-                        std::fill(sram.begin(), sram.end(), 0xFF);
-                    }};
+                    DelaySaveOp(flash_erase_cycles, SaveOp::FlashEraseChip);
                 }
                 break;
             case EraseSector:
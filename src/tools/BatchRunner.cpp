@@ -0,0 +1,454 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <fmt/format.h>
+
+#include "common/CommonTypes.h"
+#include "common/CommonEnums.h"
+#include "common/FrameStats.h"
+#include "common/MappedFile.h"
+#include "common/SaveBuffer.h"
+#include "common/ThreadPool.h"
+#include "common/Movie.h"
+#include "gb/core/Enums.h"
+#include "gb/core/GameBoy.h"
+#include "gb/logging/Logging.h"
+#include "gb/memory/CartridgeHeader.h"
+#include "gba/core/Core.h"
+#include "gba/memory/Memory.h"
+#include "emu/ParseOptions.h"
+#include "emu/Frontend.h"
+
+// Runs many short headless sessions in parallel, for regression testing and other batch workloads. Each line of the
+// manifest names a ROM, the number of frames to run it for, and optionally an input movie to play back:
+//     path/to/game.gba 600 path/to/inputs.mov
+// Blank lines and lines starting with '#' are ignored. Every task gets its own core instance, and all tasks running
+// the same ROM share one mapping of it. Once every task has finished, the results are printed as CSV.
+//
+// For comparing performance before and after a change, --repeat keeps the fastest of several runs of each task, and
+// --baseline compares the times against the CSV printed by an earlier run of the same manifest.
+//
+// Tasks aren't run in lockstep, with the registers and RAM of many GB cores interleaved and a shared decode. The GB
+// core's state is spread over CPU, Memory, LCD, Timer, Audio and Serial objects which call into each other on every
+// machine cycle, so that would be a rewrite of the whole core, and instances given different inputs soon diverge
+// through branches, interrupts and LCD/DMA timing, so a shared decode would rarely cover more than one of them.
+// Independent cores on the thread pool already scale with the number of hardware threads.
+
+namespace {
+
+struct Task {
+    std::string rom_path;
+    int frames;
+    std::string movie_path;
+};
+
+struct Result {
+    Common::FrameStats stats;
+    std::string error;
+};
+
+void DisplayHelp() {
+    fmt::print("Usage: chroma_batch [options] <path/to/manifest>\n\n");
+    fmt::print("Options:\n");
+    fmt::print("  -h                           display help\n");
+    fmt::print("  -j [1-256]                   number of worker threads (default: one per hardware thread)\n");
+    fmt::print("  -o <prefix>                  prefix for each task's save file and screenshot\n");
+    fmt::print("                                   (default: batch), task N writes <prefix>_N.sav and starts\n");
+    fmt::print("                                   without one\n");
+    fmt::print("  --screenshots                write the final frame of each task to <prefix>_N.png\n");
+    fmt::print("  --repeat [1-100]             run each task N times and report the fastest, checking that every\n");
+    fmt::print("                                   run ends on the same frame\n");
+    fmt::print("  --baseline <csv>             report each task's speedup over the results of an earlier run\n");
+    fmt::print("  --skip-bios                  start GBA tasks at the cartridge entry point, without running\n");
+    fmt::print("                                   the BIOS boot animation\n");
+    fmt::print("  --accuracy [accurate, fast]  fast drops timing details finer than an instruction, for tasks\n");
+    fmt::print("                                   which only need approximate timing (default: accurate)\n");
+}
+
+std::vector<Task> ReadManifest(const std::string& filename) {
+    std::ifstream manifest{filename};
+    if (!manifest) {
+        throw std::runtime_error("Error when attempting to open " + filename);
+    }
+
+    std::vector<Task> tasks;
+    std::string line;
+    for (int line_num = 1; std::getline(manifest, line); ++line_num) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream fields{line};
+        Task task;
+        if (!(fields >> task.rom_path >> task.frames) || task.frames < 0) {
+            throw std::runtime_error(fmt::format("Invalid manifest entry on line {}: {}", line_num, line));
+        }
+        fields >> task.movie_path;
+
+        tasks.push_back(task);
+    }
+
+    return tasks;
+}
+
+unsigned int GetThreadCount(const std::vector<std::string>& tokens) {
+    const std::string thread_string = Emu::GetOptionParam(tokens, "-j");
+    if (thread_string.empty()) {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    const int threads = std::stoi(thread_string);
+    if (threads < 1 || threads > 256) {
+        throw std::invalid_argument("Invalid thread count specified: " + thread_string);
+    }
+
+    return threads;
+}
+
+int GetRepeatCount(const std::vector<std::string>& tokens) {
+    const std::string repeat_string = Emu::GetOptionParam(tokens, "--repeat");
+    if (repeat_string.empty()) {
+        return 1;
+    }
+
+    int repeats;
+    try {
+        repeats = std::stoi(repeat_string);
+    } catch (const std::logic_error&) {
+        throw std::invalid_argument("Invalid repeat count specified: " + repeat_string);
+    }
+
+    if (repeats < 1 || repeats > 100) {
+        throw std::invalid_argument("Invalid repeat count specified: " + repeat_string);
+    }
+
+    return repeats;
+}
+
+// Paths and error messages are quoted if they contain a comma, quote or line break, with any quotes doubled.
+std::string CsvField(const std::string& text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        return text;
+    }
+
+    std::string quoted{"\""};
+    for (char c : text) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+// Reads one CSV record, which may span several lines if a quoted field contains a line break. Returns false at the
+// end of the file.
+bool ReadCsvRecord(std::istream& input, std::vector<std::string>& fields) {
+    fields.clear();
+    std::string line;
+    if (!std::getline(input, line)) {
+        return false;
+    }
+
+    std::string field;
+    bool quoted = false;
+    while (true) {
+        for (std::size_t i = 0; i < line.size(); ++i) {
+            const char c = line[i];
+            if (quoted) {
+                if (c != '"') {
+                    field += c;
+                } else if (i + 1 < line.size() && line[i + 1] == '"') {
+                    field += '"';
+                    ++i;
+                } else {
+                    quoted = false;
+                }
+            } else if (c == '"') {
+                quoted = true;
+            } else if (c == ',') {
+                fields.push_back(std::move(field));
+                field.clear();
+            } else {
+                field += c;
+            }
+        }
+
+        if (!quoted || !std::getline(input, line)) {
+            break;
+        }
+        field += '\n';
+    }
+
+    fields.push_back(std::move(field));
+    return true;
+}
+
+// Reads the seconds taken by each task from the CSV printed by an earlier run.
+std::map<std::size_t, double> ReadBaseline(const std::string& filename) {
+    std::ifstream baseline{filename};
+    if (!baseline) {
+        throw std::runtime_error("Error when attempting to open " + filename);
+    }
+
+    // The columns are found from the header, so baselines from versions with other columns still load.
+    std::vector<std::string> fields;
+    if (!ReadCsvRecord(baseline, fields)) {
+        throw std::runtime_error("Baseline " + filename + " is empty.");
+    }
+    auto column = [&fields](const char* name) -> std::size_t {
+        return std::find(fields.cbegin(), fields.cend(), name) - fields.cbegin();
+    };
+    const std::size_t seconds_column = column("seconds");
+    const std::size_t error_column = column("error");
+    if (fields[0] != "task" || seconds_column == fields.size()) {
+        throw std::runtime_error("Baseline " + filename + " has no task and seconds columns.");
+    }
+
+    std::map<std::size_t, double> seconds;
+    while (ReadCsvRecord(baseline, fields)) {
+        // Skip the summary, and failed tasks.
+        if (fields.size() <= seconds_column || fields[0].empty() || fields[0][0] == '#'
+                || (error_column < fields.size() && !fields[error_column].empty())) {
+            continue;
+        }
+
+        try {
+            seconds[std::stoul(fields[0])] = std::stod(fields[seconds_column]);
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("Invalid baseline entry for task " + fields[0]);
+        }
+    }
+
+    return seconds;
+}
+
+// ROM images are loaded once, before any task starts, and only read afterwards.
+class RomCache {
+public:
+    const Common::RomView<u8>& GbRom(const std::string& rom_path) {
+        auto iter = gb_roms.find(rom_path);
+        if (iter == gb_roms.end()) {
+            iter = gb_roms.emplace(rom_path, Emu::LoadRom<u8>(rom_path, Gb::Console::CGB)).first;
+        }
+        return iter->second;
+    }
+
+    const Common::RomView<u16>& GbaRom(const std::string& rom_path) {
+        auto iter = gba_roms.find(rom_path);
+        if (iter == gba_roms.end()) {
+            iter = gba_roms.emplace(rom_path, Emu::LoadRom<u16>(rom_path, Gb::Console::AGB)).first;
+            Gba::Memory::CheckHeader(iter->second);
+        }
+        return iter->second;
+    }
+
+    const Common::RomView<u32>& Bios() {
+        if (bios.empty()) {
+            bios = Emu::LoadGbaBios();
+        }
+        return bios;
+    }
+
+private:
+    std::map<std::string, Common::RomView<u8>> gb_roms;
+    std::map<std::string, Common::RomView<u16>> gba_roms;
+    Common::RomView<u32> bios;
+};
+
+Common::FrameStats RunGbTask(const Task& task, const Common::RomView<u8>& rom, const std::string& output_prefix,
+                             bool screenshot, Accuracy accuracy) {
+    // The header picks the console from the cart type.
+    Gb::Console console = Gb::Console::Default;
+    const Gb::CartridgeHeader cart_header{console, rom, false};
+    const std::string save_path{output_prefix + ".sav"};
+    Common::SaveBuffer<u8> save_game{Emu::LoadSaveGame(cart_header, save_path, false)};
+
+    Gb::Logging logger{LogLevel::None};
+    Emu::NullFrontend frontend;
+    Gb::GameBoy gameboy_core{console, cart_header, logger, frontend, save_path, rom, save_game,
+                             AudioFilter::Nearest, false, 0, false, false};
+    gameboy_core.SetAccuracy(accuracy);
+    if (!task.movie_path.empty()) {
+        gameboy_core.PlayMovie(std::make_unique<Common::Movie>(task.movie_path));
+    }
+
+    const Common::FrameStats stats = gameboy_core.RunHeadless(task.frames);
+    if (screenshot) {
+        gameboy_core.Screenshot(output_prefix + ".png");
+    }
+
+    return stats;
+}
+
+Common::FrameStats RunGbaTask(const Task& task, const Common::RomView<u32>& bios, const Common::RomView<u16>& rom,
+                              const std::string& output_prefix, bool screenshot, bool skip_bios, Accuracy accuracy) {
+    const std::string save_path{output_prefix + ".sav"};
+
+    Emu::NullFrontend frontend;
+    Gba::Core gba_core{frontend, bios, rom, save_path, LogLevel::None, false, false, 0, false, false, false, false};
+    gba_core.SetAccuracy(accuracy);
+    if (skip_bios) {
+        gba_core.SkipBios();
+    }
+    if (!task.movie_path.empty()) {
+        gba_core.PlayMovie(std::make_unique<Common::Movie>(task.movie_path));
+    }
+
+    const Common::FrameStats stats = gba_core.RunHeadless(task.frames);
+    if (screenshot) {
+        gba_core.Screenshot(output_prefix + ".png");
+    }
+
+    return stats;
+}
+
+void PrintResults(const std::vector<Task>& tasks, const std::vector<Result>& results, double total_seconds,
+                  const std::map<std::size_t, double>& baseline) {
+    fmt::print("task,rom,frames,hash,seconds,fps,avg_frame_us,max_frame_us,error,speedup\n");
+
+    int total_frames = 0;
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+        const Result& result = results[i];
+        const Common::FrameStats& stats = result.stats;
+        const double fps = (stats.total_seconds > 0.0) ? stats.frames / stats.total_seconds : 0.0;
+
+        // Left empty if the task failed, or the baseline has no time for it.
+        std::string speedup;
+        const auto baseline_iter = baseline.find(i);
+        if (baseline_iter != baseline.end() && result.error.empty() && stats.total_seconds > 0.0) {
+            speedup = fmt::format("{:.3f}", baseline_iter->second / stats.total_seconds);
+        }
+
+        fmt::print("{},{},{},{:016x},{:.3f},{:.1f},{:.1f},{:.1f},{},{}\n", i, CsvField(tasks[i].rom_path),
+                   stats.frames, stats.framebuffer_hash, stats.total_seconds, fps, stats.avg_frame_time_us,
+                   stats.max_frame_time_us, CsvField(result.error), speedup);
+        total_frames += stats.frames;
+    }
+
+    fmt::print("# {} tasks, {} frames in {:.3f}s ({:.1f} fps)\n", tasks.size(), total_frames, total_seconds,
+               total_frames / total_seconds);
+}
+
+} // End anonymous namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> tokens = Emu::GetTokens(argv, argv + argc);
+
+    if (tokens.size() == 1 || Emu::ContainsOption(tokens, "-h")) {
+        DisplayHelp();
+        return 1;
+    }
+
+    unsigned int num_threads;
+    std::string output_prefix{"batch"};
+    bool screenshots;
+    int repeats;
+    std::string baseline_path;
+    bool skip_bios;
+    Accuracy accuracy;
+    try {
+        num_threads = GetThreadCount(tokens);
+        if (Emu::ContainsOption(tokens, "-o")) {
+            output_prefix = Emu::GetOptionParam(tokens, "-o");
+        }
+        screenshots = Emu::ContainsOption(tokens, "--screenshots");
+        repeats = GetRepeatCount(tokens);
+        baseline_path = Emu::GetOptionParam(tokens, "--baseline");
+        skip_bios = Emu::ContainsOption(tokens, "--skip-bios");
+        accuracy = Emu::GetAccuracy(tokens);
+    } catch (const std::invalid_argument& e) {
+        fmt::print("{}\n\n", e.what());
+        DisplayHelp();
+        return 1;
+    }
+
+    try {
+        const std::vector<Task> tasks{ReadManifest(tokens.back())};
+        std::vector<Result> results(tasks.size());
+        const std::map<std::size_t, double> baseline{baseline_path.empty() ? std::map<std::size_t, double>{}
+                                                                           : ReadBaseline(baseline_path)};
+
+        // Map every ROM up front, so the workers only ever read from the cache.
+        RomCache rom_cache;
+        std::vector<Gb::Console> consoles;
+        for (const auto& task : tasks) {
+            consoles.push_back(Emu::CheckRomFile(task.rom_path));
+            if (consoles.back() == Gb::Console::AGB) {
+                rom_cache.Bios();
+                rom_cache.GbaRom(task.rom_path);
+            } else {
+                rom_cache.GbRom(task.rom_path);
+            }
+        }
+
+        std::vector<Common::WorkStealingPool::Task> pool_tasks;
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            pool_tasks.emplace_back([&, i]() {
+                const std::string task_prefix{fmt::format("{}_{}", output_prefix, i)};
+                try {
+                    for (int run = 0; run < repeats; ++run) {
+                        // A save left by an earlier batch or the previous run would change how this one plays out.
+                        std::remove((task_prefix + ".sav").c_str());
+
+                        Common::FrameStats stats;
+                        if (consoles[i] == Gb::Console::AGB) {
+                            stats = RunGbaTask(tasks[i], rom_cache.Bios(), rom_cache.GbaRom(tasks[i].rom_path),
+                                               task_prefix, screenshots, skip_bios, accuracy);
+                        } else {
+                            stats = RunGbTask(tasks[i], rom_cache.GbRom(tasks[i].rom_path), task_prefix,
+                                              screenshots, accuracy);
+                        }
+
+                        if (run != 0 && stats.framebuffer_hash != results[i].stats.framebuffer_hash) {
+                            throw std::runtime_error("Repeated runs ended on different frames.");
+                        }
+                        if (run == 0 || stats.total_seconds < results[i].stats.total_seconds) {
+                            results[i].stats = stats;
+                        }
+                    }
+                } catch (const std::runtime_error& e) {
+                    // A bad save, ROM or movie, or a movie desync, only fails its own task.
+                    results[i].error = e.what();
+                }
+            });
+        }
+
+        using namespace std::chrono;
+        const auto start_time = steady_clock::now();
+        Common::WorkStealingPool{num_threads}.Run(std::move(pool_tasks));
+        const double total_seconds = duration<double>(steady_clock::now() - start_time).count();
+
+        PrintResults(tasks, results, total_seconds, baseline);
+    } catch (const std::runtime_error& e) {
+        fmt::print("{}\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,707 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string>
+#include <array>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/format.h>
+
+#include "common/CommonTypes.h"
+#include "common/CommonEnums.h"
+#include "common/FrameStats.h"
+#include "common/MappedFile.h"
+#include "common/SaveBuffer.h"
+#include "gb/core/Enums.h"
+#include "gb/core/GameBoy.h"
+#include "gb/cpu/CPU.h"
+#include "gb/lcd/LCD.h"
+#include "gb/audio/Audio.h"
+#include "gb/logging/Logging.h"
+#include "gb/memory/Memory.h"
+#include "gb/memory/CartridgeHeader.h"
+#include "gba/core/Core.h"
+#include "gba/core/Enums.h"
+#include "gba/memory/Memory.h"
+#include "gba/cpu/Cpu.h"
+#include "gba/lcd/Lcd.h"
+#include "gba/lcd/Bg.h"
+#include "emu/ParseOptions.h"
+#include "emu/Frontend.h"
+
+// Times the hot paths of both cores in isolation, for before and after numbers on performance changes. Each
+// microbenchmark runs one kernel (a frame of CPU emulation, a frame of scanlines, a pass over a memory region, or a
+// frame of audio resampling) on a core set up with a synthetic ROM, and reports the mean time per operation as CSV.
+// The synthetic ROMs are written next to the given prefix, and need no BIOS or game. Any ROMs given on the command
+// line are also run headless for a number of frames, as macro benchmarks.
+
+namespace {
+
+// Kernel results are stored here so the compiler can't drop the work that produced them.
+volatile u32 sink = 0;
+
+// A fixed linear congruential generator, so every run fills memory with the same data.
+class Lcg {
+public:
+    u32 Next() {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+
+private:
+    u32 state = 0x1234'5678;
+};
+
+void WriteImage(const std::string& filename, const std::vector<u8>& data) {
+    std::ofstream file{filename, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!file) {
+        throw std::runtime_error("Error when attempting to write " + filename);
+    }
+}
+
+void PlaceBytes(std::vector<u8>& image, u32 offset, const std::vector<u8>& bytes) {
+    std::copy(bytes.cbegin(), bytes.cend(), image.begin() + offset);
+}
+
+template<typename T>
+void PlaceOpcodes(std::vector<u8>& image, u32 offset, const std::vector<T>& opcodes) {
+    for (const T opcode : opcodes) {
+        for (std::size_t i = 0; i < sizeof(T); ++i) {
+            image[offset++] = (opcode >> (8 * i)) & 0xFF;
+        }
+    }
+}
+
+} // End anonymous namespace
+
+namespace Gba {
+
+// Owns a core which starts at the cartridge entry point of a synthetic ROM, with a blank BIOS. A friend of Lcd, to
+// draw scanlines without running the display timing around them.
+class Benchmark {
+public:
+    Benchmark(const std::string& rom_path, const Common::RomView<u32>& bios, Accuracy accuracy)
+            : rom(Emu::LoadRom<u16>(rom_path, Gb::Console::AGB))
+            , core(frontend, bios, rom, "", LogLevel::None, false, false, 0, false, false, false, false) {
+        core.SetAccuracy(accuracy);
+        core.SkipBios();
+    }
+
+    static constexpr int cycles_per_frame = 280896;
+
+    // Loops over a mix of ALU, multiply, load, store and branch instructions in ROM, with IWRAM as the data.
+    static std::vector<u8> ArmRom() {
+        std::vector<u8> image(0x1'0000);
+        constexpr u32 loop = 0x0800'0004;
+        PlaceOpcodes<u32>(image, 0, {
+            0xE3A01403,  // mov r1, #0x03000000
+            0xE2800001,  // loop: add r0, r0, #1
+            0xE0402003,  // sub r2, r0, r3
+            0xE1833100,  // orr r3, r3, r0, lsl #2
+            0xE0204002,  // eor r4, r0, r2
+            0xE0050290,  // mul r5, r0, r2
+            0xE5810000,  // str r0, [r1]
+            0xE5916000,  // ldr r6, [r1]
+            0xE881001D,  // stmia r1, {r0, r2-r4}
+            0xE8910060,  // ldmia r1, {r5, r6}
+            0xE1500002,  // cmp r0, r2
+            0x03A00000,  // moveq r0, #0
+            0xEA000000 | (((loop - (0x0800'0030 + 8)) >> 2) & 0xFF'FFFF),  // b loop
+        });
+        return image;
+    }
+
+    // The same mix of instructions as ArmRom, in Thumb state.
+    static std::vector<u8> ThumbRom() {
+        std::vector<u8> image(0x1'0000);
+        PlaceOpcodes<u32>(image, 0, {
+            0xE28F0001,  // add r0, pc, #1
+            0xE12FFF10,  // bx r0
+        });
+        constexpr u32 loop = 0x0800'000C;
+        PlaceOpcodes<u16>(image, 8, {
+            0x2103,  // movs r1, #3
+            0x0609,  // lsls r1, r1, #24
+            0x3001,  // loop: adds r0, #1
+            0x1AC2,  // subs r2, r0, r3
+            0x0083,  // lsls r3, r0, #2
+            0x4054,  // eors r4, r2
+            0x4355,  // muls r5, r2
+            0x6008,  // str r0, [r1]
+            0x680E,  // ldr r6, [r1]
+            0xB405,  // push {r0, r2}
+            0xBC30,  // pop {r4, r5}
+            0x4290,  // cmp r0, r2
+            0xD1FF,  // bne next
+            static_cast<u16>(0xE000 | ((((loop - (0x0800'0022 + 4)) >> 1)) & 0x7FF)),  // next: b loop
+        });
+        return image;
+    }
+
+    // Runs a frame's worth of cycles, and returns the number of instructions executed.
+    u64 RunFrame() {
+        const u64 start = core.cpu->counters.instructions;
+        core.cpu->Execute(cycles_per_frame);
+        return core.cpu->counters.instructions - start;
+    }
+
+    template<typename T>
+    u64 ReadRegion(u32 base, u32 size) {
+        u32 sum = 0;
+        for (u32 addr = base; addr < base + size; addr += sizeof(T)) {
+            sum += core.mem->ReadMem<T>(addr);
+        }
+        sink = sum;
+        return size / sizeof(T);
+    }
+
+    template<typename T>
+    u64 TimeRegion(u32 base, u32 size) {
+        int cycles = 0;
+        for (u32 addr = base; addr < base + size; addr += sizeof(T)) {
+            cycles += core.mem->AccessTime<T>(addr);
+        }
+        sink = cycles;
+        return size / sizeof(T);
+    }
+
+    // Fills palette RAM, VRAM and OAM with pseudorandom data, so the tile numbers, flips, palettes and colours all
+    // vary from pixel to pixel.
+    void FillVideoMemory() {
+        Lcg lcg;
+        for (u32 addr = 0; addr < 0x400; addr += 4) {
+            core.mem->WriteMem<u32>(BaseAddr::PRam + addr, lcg.Next());
+        }
+        for (u32 addr = 0; addr < 0x1'8000; addr += 4) {
+            core.mem->WriteMem<u32>(BaseAddr::VRam + addr, lcg.Next());
+        }
+        for (u32 addr = 0; addr < 0x400; addr += 4) {
+            core.mem->WriteMem<u32>(BaseAddr::Oam + addr, lcg.Next());
+        }
+    }
+
+    // Enables every background the mode has, with sprites off. Regular backgrounds alternate between 4bpp and 8bpp
+    // and have their own tile maps, and affine backgrounds are scaled, rotated and wrap around.
+    void SetBgMode(int mode) {
+        static constexpr std::array<u16, 6> enabled_bgs{{0x0F00, 0x0700, 0x0C00, 0x0400, 0x0400, 0x0400}};
+        Lcd& lcd = *core.lcd;
+        lcd.control = enabled_bgs[mode] | mode;
+        for (int i = 0; i < 4; ++i) {
+            Bg& bg = lcd.bgs[i];
+            const bool affine = (mode == 1 && i == 2) || (mode == 2 && i >= 2);
+            const int screen_base = 28 + i;
+            if (affine) {
+                bg.control = 0x4000 | 0x2000 | (screen_base << 8) | i;
+            } else {
+                bg.control = (screen_base << 8) | ((i >= 2) ? 0x80 : 0x00) | ((i & 0x1) << 2) | i;
+            }
+            bg.scroll_x = 13 * i;
+            bg.scroll_y = 7 * i;
+
+            // Bitmap modes draw BG2 with an identity transform.
+            const bool bitmap = mode >= 3;
+            bg.affine_a = bitmap ? 0x0100 : 0x00F0;
+            bg.affine_b = bitmap ? 0x0000 : 0x0040;
+            bg.affine_c = bitmap ? 0x0000 : 0xFFC0;
+            bg.affine_d = bitmap ? 0x0100 : 0x00F0;
+            bg.enable_delay = 0;
+        }
+        lcd.bg_dirty = true;
+    }
+
+    // Fills OAM with 128 onscreen sprites of mixed sizes, palette modes, flips and priorities, either all regular or
+    // all affine, with half the affine ones double size. Backgrounds are off.
+    void SetSprites(bool affine) {
+        Lcg lcg;
+        for (u32 s = 0; s < Lcd::num_sprites; ++s) {
+            const u32 y = (s * 11) % Lcd::v_pixels;
+            const u32 x = (s * 37) % Lcd::h_pixels;
+            const u32 size = s % 3;
+            u32 attr0 = y | ((s & 0x4) ? 0x2000 : 0x0000);
+            u32 attr1 = x | (size << 14);
+            if (affine) {
+                attr0 |= 0x100 | ((s & 0x1) ? 0x200 : 0x000);
+                attr1 |= (s % 32) << 9;
+            } else {
+                attr1 |= (s & 0x3) << 12;
+            }
+            const u32 attr2 = ((s * 8) % 1024) | ((s % 4) << 10) | ((s % 16) << 12);
+
+            core.mem->WriteMem<u32>(BaseAddr::Oam + s * 8, attr0 | (attr1 << 16));
+            core.mem->WriteMem<u16>(BaseAddr::Oam + s * 8 + 4, attr2);
+            // The affine parameters are interleaved with the attributes, one per sprite.
+            core.mem->WriteMem<u16>(BaseAddr::Oam + s * 8 + 6, ((s & 0x3) == 0) ? 0x0100 : lcg.Next() & 0x01FF);
+        }
+
+        Lcd& lcd = *core.lcd;
+        // Sprites on, with 1D tile mapping.
+        lcd.control = 0x1040;
+        lcd.obj_dirty = true;
+    }
+
+    // Draws all 160 scanlines, and returns the number drawn.
+    u64 DrawFrame() {
+        Lcd& lcd = *core.lcd;
+        LatchReferencePoints();
+        for (int line = 0; line < Lcd::v_pixels; ++line) {
+            lcd.vcount = line;
+            lcd.DrawScanline();
+        }
+        return Lcd::v_pixels;
+    }
+
+    u64 DrawAffineBg() {
+        Lcd& lcd = *core.lcd;
+        LatchReferencePoints();
+        for (int line = 0; line < Lcd::v_pixels; ++line) {
+            lcd.vcount = line;
+            lcd.bgs[2].DrawAffineScanline();
+        }
+        return Lcd::v_pixels;
+    }
+
+    u64 DrawSprites() {
+        Lcd& lcd = *core.lcd;
+        for (int line = 0; line < Lcd::v_pixels; ++line) {
+            lcd.vcount = line;
+            lcd.ReadOam();
+            lcd.DrawSprites();
+        }
+        return Lcd::v_pixels;
+    }
+
+private:
+    Emu::NullFrontend frontend;
+    const Common::RomView<u16> rom;
+    Core core;
+
+    // The reference points are latched at the start of every frame.
+    void LatchReferencePoints() {
+        for (auto& bg : core.lcd->bgs) {
+            bg.LatchReferencePointX();
+            bg.LatchReferencePointY();
+        }
+    }
+};
+
+} // End namespace Gba
+
+namespace Gb {
+
+// Owns a Game Boy running a synthetic ROM. A friend of GameBoy and LCD, to draw scanlines without running the
+// display timing around them, and of Audio, to resample a frame of samples on its own.
+class Benchmark {
+public:
+    Benchmark(const std::string& rom_path, Console gb_type, Accuracy accuracy)
+            : console(gb_type)
+            , rom(Emu::LoadRom<u8>(rom_path, console))
+            , header(console, rom, false)
+            , logger(LogLevel::None)
+            , gameboy(console, header, logger, frontend, "", rom, save_game, AudioFilter::Nearest, false, 0, false,
+                      false) {
+        gameboy.SetAccuracy(accuracy);
+    }
+
+    static constexpr int cycles_per_frame = 70224;
+
+    // A 32KB cartridge with no MBC, which jumps to the given code at 0x0150 and has a subroutine at 0x0200. Works
+    // in both DMG and CGB mode.
+    static std::vector<u8> Rom(const std::vector<u8>& code, const std::vector<u8>& subroutine) {
+        std::vector<u8> image(0x8000);
+        // nop; jp 0x0150
+        PlaceBytes(image, 0x0100, {0x00, 0xC3, 0x50, 0x01});
+        PlaceBytes(image, 0x0104, {0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83,
+                                   0x00, 0x0C, 0x00, 0x0D, 0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
+                                   0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99, 0xBB, 0xBB, 0x67, 0x63,
+                                   0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E});
+        image[0x0143] = 0x80;
+
+        u8 checksum = 0;
+        for (std::size_t i = 0x0134; i < 0x014D; ++i) {
+            checksum -= image[i] + 1;
+        }
+        image[0x014D] = checksum;
+
+        PlaceBytes(image, 0x0150, code);
+        PlaceBytes(image, 0x0200, subroutine);
+        return image;
+    }
+
+    // Loops over ALU, rotate, CB-prefixed and WRAM load/store instructions.
+    static std::vector<u8> AluRom() {
+        return Rom({0xF3,              // di
+                    0x21, 0x00, 0xC0,  // ld hl, 0xC000
+                    0x3C,              // loop: inc a
+                    0x80,              // add a, b
+                    0x91,              // sub c
+                    0xA2,              // and d
+                    0xB3,              // or e
+                    0xAB,              // xor e
+                    0x77,              // ld (hl), a
+                    0x46,              // ld b, (hl)
+                    0x2C,              // inc l
+                    0x07,              // rlca
+                    0xCB, 0x37,        // swap a
+                    0xCB, 0x11,        // rl c
+                    0x1B,              // dec de
+                    0x18, 0xEF},       // jr loop
+                   {});
+    }
+
+    // Loops over calls, returns, stack operations and taken and untaken conditional branches.
+    static std::vector<u8> BranchRom() {
+        return Rom({0xF3,              // di
+                    0xCD, 0x00, 0x02,  // loop: call 0x0200
+                    0xC5,              // push bc
+                    0xD1,              // pop de
+                    0x05,              // dec b
+                    0x20, 0x01,        // jr nz, skip
+                    0x04,              // inc b
+                    0x00,              // skip: nop
+                    0x18, 0xF4},       // jr loop
+                   {0x0C,              // inc c
+                    0xC9});            // ret
+    }
+
+    // Runs a frame's worth of cycles, and returns the number of instructions executed.
+    u64 RunFrame() {
+        const u64 start = gameboy.cpu->counters.instructions;
+        gameboy.cpu->RunFor(cycles_per_frame);
+        return gameboy.cpu->counters.instructions - start;
+    }
+
+    // Fills VRAM bank 0, OAM and the palettes with pseudorandom data, and turns on the background, the window over
+    // the bottom right quarter of the screen, and sprites.
+    void FillVideoMemory() {
+        Lcg lcg;
+        for (u16 addr = 0x8000; addr < 0xA000; ++addr) {
+            gameboy.mem->WriteMem(addr, lcg.Next() >> 24);
+        }
+
+        LCD& lcd = *gameboy.lcd;
+        for (std::size_t s = 0; s < 40; ++s) {
+            lcd.oam[s * 4] = 16 + (s * 7) % 144;
+            lcd.oam[s * 4 + 1] = 8 + (s * 17) % 160;
+            lcd.oam[s * 4 + 2] = s;
+            lcd.oam[s * 4 + 3] = lcg.Next() >> 24;
+        }
+        lcd.oam_dirty = true;
+
+        for (auto& byte : lcd.bg_palette_data) {
+            byte = lcg.Next() >> 24;
+        }
+        for (auto& byte : lcd.obj_palette_data) {
+            byte = lcg.Next() >> 24;
+        }
+        lcd.bg_palette_dmg = 0xE4;
+        lcd.obj_palette_dmg0 = 0xE4;
+        lcd.obj_palette_dmg1 = 0x1B;
+        lcd.palettes_dirty = true;
+
+        lcd.lcdc = 0xF3;
+        lcd.scroll_x = 3;
+        lcd.scroll_y = 5;
+        lcd.window_x = 87;
+        lcd.window_y = 72;
+    }
+
+    // Draws all 144 scanlines, and returns the number drawn.
+    u64 DrawFrame() {
+        LCD& lcd = *gameboy.lcd;
+        lcd.window_progress = 0;
+        for (u8 line = 0; line < 144; ++line) {
+            lcd.ly = line;
+            lcd.SearchOAM();
+            lcd.RenderScanline();
+        }
+        return 144;
+    }
+
+    // Fills a frame's worth of pre-downsampled samples, as the channels would have queued them.
+    static void FillSamples(Audio& audio) {
+        Lcg lcg;
+        audio.sample_buffer.resize(Audio::num_samples * 2);
+        for (auto& sample : audio.sample_buffer) {
+            sample = lcg.Next() >> 28;
+        }
+    }
+
+    static u64 Resample(Audio& audio) {
+        audio.Resample();
+        sink = audio.output_buffer[0];
+        return 1;
+    }
+
+private:
+    Console console;
+    const Common::RomView<u8> rom;
+    const CartridgeHeader header;
+    Common::SaveBuffer<u8> save_game;
+    Logging logger;
+    Emu::NullFrontend frontend;
+    GameBoy gameboy;
+};
+
+} // End namespace Gb
+
+namespace {
+
+void DisplayHelp() {
+    fmt::print("Usage: chroma_bench [options] [path/to/rom ...]\n\n");
+    fmt::print("Options:\n");
+    fmt::print("  -h                           display help\n");
+    fmt::print("  -f <filter>                  only run the microbenchmarks whose names contain the filter\n");
+    fmt::print("  -t <seconds>                 minimum time to run each microbenchmark for (default: 0.5)\n");
+    fmt::print("  -o <prefix>                  prefix for the synthetic ROM images the microbenchmarks run\n");
+    fmt::print("                                   (default: bench)\n");
+    fmt::print("  --frames <frames>            frames to run each given ROM for (default: 600)\n");
+    fmt::print("  --skip-bios                  start given GBA ROMs at the cartridge entry point, without running\n");
+    fmt::print("                                   the BIOS boot animation\n");
+    fmt::print("  --accuracy [accurate, fast]  timing profile for every core (default: accurate)\n");
+}
+
+double GetMinSeconds(const std::vector<std::string>& tokens) {
+    const std::string seconds_string = Emu::GetOptionParam(tokens, "-t");
+    if (seconds_string.empty()) {
+        return 0.5;
+    }
+
+    double seconds;
+    try {
+        seconds = std::stod(seconds_string);
+    } catch (const std::logic_error&) {
+        throw std::invalid_argument("Invalid time specified: " + seconds_string);
+    }
+
+    if (seconds <= 0.0 || seconds > 60.0) {
+        throw std::invalid_argument("Invalid time specified: " + seconds_string);
+    }
+
+    return seconds;
+}
+
+// Every token which isn't an option or an option's parameter.
+std::vector<std::string> GetRomPaths(const std::vector<std::string>& tokens) {
+    static const std::vector<std::string> param_options{"-f", "-t", "-o", "--frames", "--accuracy"};
+
+    std::vector<std::string> rom_paths;
+    for (std::size_t i = 1; i < tokens.size(); ++i) {
+        if (std::find(param_options.cbegin(), param_options.cend(), tokens[i]) != param_options.cend()) {
+            ++i;
+        } else if (tokens[i][0] != '-') {
+            rom_paths.push_back(tokens[i]);
+        }
+    }
+
+    return rom_paths;
+}
+
+class Runner {
+public:
+    Runner(const std::string& _filter, double _min_seconds)
+            : filter(_filter)
+            , min_seconds(_min_seconds) {}
+
+    // Calls the kernel, which returns how many operations it did, until at least min_seconds have passed. One
+    // untimed call first warms up the caches and the branch predictors.
+    template<typename Kernel>
+    void Run(const std::string& name, Kernel kernel) const {
+        if (name.find(filter) == std::string::npos) {
+            return;
+        }
+
+        kernel();
+
+        using namespace std::chrono;
+        u64 ops = 0;
+        double seconds = 0.0;
+        const auto start_time = steady_clock::now();
+        do {
+            ops += kernel();
+            seconds = duration<double>(steady_clock::now() - start_time).count();
+        } while (seconds < min_seconds);
+
+        fmt::print("{},{},{:.3f},{:.2f}\n", name, ops, seconds, seconds * 1e9 / ops);
+    }
+
+private:
+    const std::string filter;
+    const double min_seconds;
+};
+
+void RunGbaBenchmarks(const Runner& runner, const std::string& prefix, Accuracy accuracy) {
+    const std::string bios_path{prefix + "_bios.bin"};
+    const std::string arm_path{prefix + "_arm.gba"};
+    const std::string thumb_path{prefix + "_thumb.gba"};
+    WriteImage(bios_path, std::vector<u8>(0x4000));
+    WriteImage(arm_path, Gba::Benchmark::ArmRom());
+    WriteImage(thumb_path, Gba::Benchmark::ThumbRom());
+    const Common::RomView<u32> bios{Common::MappedFile{bios_path, 0x4000, 0x4000}};
+
+    Gba::Benchmark arm{arm_path, bios, accuracy};
+    runner.Run("gba/Cpu::Execute/arm", [&]() { return arm.RunFrame(); });
+    Gba::Benchmark thumb{thumb_path, bios, accuracy};
+    runner.Run("gba/Cpu::Execute/thumb", [&]() { return thumb.RunFrame(); });
+
+    struct Region {
+        const char* name;
+        u32 base;
+        u32 size;
+    };
+    static constexpr std::array<Region, 8> regions{{{"bios", Gba::BaseAddr::Bios, 0x4000},
+                                                    {"xram", Gba::BaseAddr::XRam, 0x4000},
+                                                    {"iram", Gba::BaseAddr::IRam, 0x4000},
+                                                    {"io", Gba::BaseAddr::IO, 0x60},
+                                                    {"pram", Gba::BaseAddr::PRam, 0x400},
+                                                    {"vram", Gba::BaseAddr::VRam, 0x4000},
+                                                    {"oam", Gba::BaseAddr::Oam, 0x400},
+                                                    {"rom", Gba::BaseAddr::Rom, 0x4000}}};
+    for (const auto& region : regions) {
+        runner.Run(fmt::format("gba/Memory::ReadMem/{}", region.name),
+                   [&]() { return arm.ReadRegion<u32>(region.base, region.size); });
+        runner.Run(fmt::format("gba/Memory::AccessTime/{}", region.name),
+                   [&]() { return arm.TimeRegion<u32>(region.base, region.size); });
+    }
+    // The save chip has an 8-bit bus.
+    runner.Run("gba/Memory::ReadMem/sram", [&]() { return arm.ReadRegion<u8>(Gba::BaseAddr::SRam, 0x1000); });
+    runner.Run("gba/Memory::AccessTime/sram", [&]() { return arm.TimeRegion<u8>(Gba::BaseAddr::SRam, 0x1000); });
+
+    arm.FillVideoMemory();
+    for (int mode = 0; mode < 6; ++mode) {
+        arm.SetBgMode(mode);
+        runner.Run(fmt::format("gba/Lcd::DrawScanline/mode{}", mode), [&]() { return arm.DrawFrame(); });
+    }
+
+    arm.SetBgMode(1);
+    runner.Run("gba/Bg::DrawAffineScanline", [&]() { return arm.DrawAffineBg(); });
+
+    arm.SetSprites(false);
+    runner.Run("gba/Lcd::DrawSprites/regular", [&]() { return arm.DrawSprites(); });
+    arm.SetSprites(true);
+    runner.Run("gba/Lcd::DrawSprites/affine", [&]() { return arm.DrawSprites(); });
+}
+
+void RunGbBenchmarks(const Runner& runner, const std::string& prefix, Accuracy accuracy) {
+    const std::string alu_path{prefix + "_alu.gb"};
+    const std::string branch_path{prefix + "_branch.gb"};
+    WriteImage(alu_path, Gb::Benchmark::AluRom());
+    WriteImage(branch_path, Gb::Benchmark::BranchRom());
+
+    Gb::Benchmark alu{alu_path, Gb::Console::DMG, accuracy};
+    runner.Run("gb/CPU::RunFor/alu", [&]() { return alu.RunFrame(); });
+    Gb::Benchmark branch{branch_path, Gb::Console::DMG, accuracy};
+    runner.Run("gb/CPU::RunFor/branch", [&]() { return branch.RunFrame(); });
+
+    alu.FillVideoMemory();
+    runner.Run("gb/LCD::RenderScanline/dmg", [&]() { return alu.DrawFrame(); });
+    Gb::Benchmark cgb{alu_path, Gb::Console::CGB, accuracy};
+    cgb.FillVideoMemory();
+    runner.Run("gb/LCD::RenderScanline/cgb", [&]() { return cgb.DrawFrame(); });
+
+    Gb::Audio iir{AudioFilter::Iir};
+    Gb::Benchmark::FillSamples(iir);
+    runner.Run("gb/Audio::Resample/iir", [&]() { return Gb::Benchmark::Resample(iir); });
+    Gb::Audio polyphase{AudioFilter::Polyphase};
+    Gb::Benchmark::FillSamples(polyphase);
+    runner.Run("gb/Audio::Resample/polyphase", [&]() { return Gb::Benchmark::Resample(polyphase); });
+}
+
+Common::FrameStats RunRom(const std::string& rom_path, int frames, bool skip_bios, Accuracy accuracy) {
+    Emu::NullFrontend frontend;
+    if (Emu::CheckRomFile(rom_path) == Gb::Console::AGB) {
+        const Common::RomView<u32> bios{Emu::LoadGbaBios()};
+        const Common::RomView<u16> rom{Emu::LoadRom<u16>(rom_path, Gb::Console::AGB)};
+        Gba::Memory::CheckHeader(rom);
+
+        Gba::Core gba_core{frontend, bios, rom, "", LogLevel::None, false, false, 0, false, false, false, false};
+        gba_core.SetAccuracy(accuracy);
+        if (skip_bios) {
+            gba_core.SkipBios();
+        }
+        return gba_core.RunHeadless(frames);
+    } else {
+        const Common::RomView<u8> rom{Emu::LoadRom<u8>(rom_path, Gb::Console::CGB)};
+        Gb::Console console = Gb::Console::Default;
+        const Gb::CartridgeHeader cart_header{console, rom, false};
+        Common::SaveBuffer<u8> save_game{Emu::LoadSaveGame(cart_header, "", false)};
+
+        Gb::Logging logger{LogLevel::None};
+        Gb::GameBoy gameboy_core{console, cart_header, logger, frontend, "", rom, save_game,
+                                 AudioFilter::Nearest, false, 0, false, false};
+        gameboy_core.SetAccuracy(accuracy);
+        return gameboy_core.RunHeadless(frames);
+    }
+}
+
+} // End anonymous namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> tokens = Emu::GetTokens(argv, argv + argc);
+
+    if (Emu::ContainsOption(tokens, "-h")) {
+        DisplayHelp();
+        return 1;
+    }
+
+    std::string filter;
+    double min_seconds;
+    std::string prefix{"bench"};
+    int frames = 600;
+    bool skip_bios;
+    Accuracy accuracy;
+    std::vector<std::string> rom_paths;
+    try {
+        filter = Emu::GetOptionParam(tokens, "-f");
+        min_seconds = GetMinSeconds(tokens);
+        if (Emu::ContainsOption(tokens, "-o")) {
+            prefix = Emu::GetOptionParam(tokens, "-o");
+        }
+        if (Emu::ContainsOption(tokens, "--frames")) {
+            frames = Emu::GetFrameCount(tokens);
+        }
+        skip_bios = Emu::ContainsOption(tokens, "--skip-bios");
+        accuracy = Emu::GetAccuracy(tokens);
+        rom_paths = GetRomPaths(tokens);
+    } catch (const std::invalid_argument& e) {
+        fmt::print("{}\n\n", e.what());
+        DisplayHelp();
+        return 1;
+    }
+
+    try {
+        fmt::print("benchmark,ops,seconds,ns_per_op\n");
+        const Runner runner{filter, min_seconds};
+        RunGbaBenchmarks(runner, prefix, accuracy);
+        RunGbBenchmarks(runner, prefix, accuracy);
+
+        // The macro benchmarks count frames as their operations.
+        for (const auto& rom_path : rom_paths) {
+            const Common::FrameStats stats = RunRom(rom_path, frames, skip_bios, accuracy);
+            fmt::print("{},{},{:.3f},{:.2f}\n", rom_path, stats.frames, stats.total_seconds,
+                       stats.total_seconds * 1e9 / stats.frames);
+        }
+    } catch (const std::runtime_error& e) {
+        fmt::print("{}\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+// This file is a part of Chroma.
+// Copyright (C) 2018 Matthew Murray
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <fmt/format.h>
+
+#include "common/CommonTypes.h"
+#include "common/Trace.h"
+#include "gb/logging/Logging.h"
+#include "gba/cpu/Disassembler.h"
+
+// Decodes a binary trace written with "-l binary" into the same text the text log levels produce, with a cycle
+// timestamp on every instruction.
+
+namespace {
+
+template<typename Record>
+bool ReadRecord(std::ifstream& trace_file, Record& record) {
+    trace_file.read(reinterpret_cast<char*>(&record), sizeof(Record));
+    return static_cast<bool>(trace_file);
+}
+
+template<typename Record>
+void CheckRecordSize(const Common::TraceHeader& header) {
+    if (header.record_size != sizeof(Record)) {
+        throw std::runtime_error(fmt::format("Trace records are {} bytes, expected {}.", header.record_size,
+                                             sizeof(Record)));
+    }
+}
+
+void DumpGbTrace(std::ifstream& trace_file) {
+    Gb::TraceRecord record;
+    while (ReadRecord(trace_file, record)) {
+        fmt::MemoryWriter line;
+
+        if (record.halted) {
+            line.write("\nHalted\n");
+        } else {
+            Gb::Logging::Disassemble(line, record.bytes);
+        }
+
+        line.write( "PC=0x{0:0>4X}", record.pc);
+        line.write(" SP=0x{0:0>4X}", record.sp);
+        line.write(" AF=0x{0:0>4X}", record.af);
+        line.write(" BC=0x{0:0>4X}", record.bc);
+        line.write(" DE=0x{0:0>4X}", record.de);
+        line.write(" HL=0x{0:0>4X}", record.hl);
+        line.write(" IF=0x{0:0>4X}", record.interrupt_flags);
+        line.write(" IE=0x{0:0>4X}", record.interrupt_enable);
+        line.write(" cycle={}\n", record.timestamp);
+
+        fmt::print(line.str());
+    }
+}
+
+void DumpGbaTrace(std::ifstream& trace_file) {
+    constexpr u32 thumb_bit = 0x20;
+    constexpr std::size_t pc = 15;
+
+    Gba::Disassembler disasm;
+
+    // Thumb BLs are disassembled from both halves, so keep one record of lookahead.
+    Gba::TraceRecord record, next_record;
+    bool have_next = ReadRecord(trace_file, next_record);
+    Thumb prev_opcode = 0;
+
+    while (have_next) {
+        record = next_record;
+        have_next = ReadRecord(trace_file, next_record);
+
+        std::string instr;
+        if (record.cpsr & thumb_bit) {
+            const Thumb opcode = record.opcode;
+            const Thumb next_opcode = (have_next) ? next_record.opcode : 0;
+            instr = fmt::format("T: {}", disasm.ThumbString(opcode, prev_opcode, next_opcode));
+            prev_opcode = opcode;
+        } else {
+            instr = fmt::format("A: {}", disasm.ArmString(record.opcode));
+            prev_opcode = 0;
+        }
+
+        fmt::print("{:>12} 0x{:0>8X}, {}\n", record.timestamp, record.regs[pc], instr);
+        fmt::print(Gba::Disassembler::RegistersString(record.regs, record.cpsr));
+    }
+}
+
+} // End anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fmt::print("Usage: chroma_trace <path/to/trace.bin>\n");
+        return 1;
+    }
+
+    try {
+        const std::string trace_path{argv[1]};
+        std::ifstream trace_file{trace_path, std::ios_base::binary};
+        if (!trace_file) {
+            throw std::runtime_error("Error when attempting to open " + trace_path + " for reading.");
+        }
+
+        const Common::TraceHeader header{Common::ReadTraceHeader(trace_file)};
+
+        switch (header.system) {
+        case Common::TraceSystem::Gb:
+            CheckRecordSize<Gb::TraceRecord>(header);
+            DumpGbTrace(trace_file);
+            break;
+        case Common::TraceSystem::Gba:
+            CheckRecordSize<Gba::TraceRecord>(header);
+            DumpGbaTrace(trace_file);
+            break;
+        default:
+            throw std::runtime_error("Unknown system in trace header.");
+        }
+    } catch (const std::runtime_error& e) {
+        fmt::print("{}\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}